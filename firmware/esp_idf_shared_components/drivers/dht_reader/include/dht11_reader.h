@@ -5,19 +5,36 @@
 
 #include "driver/gpio.h"
 #include "dht.h"
+#include "dht_rmt.h"
 #include "esp_err.h"
+#include "sensor_sched.h"
 
 typedef struct
 {
-    dht_sensor_type_t type; // Sensor type (DHT11 or DHT22)
-    gpio_num_t pin;         // GPIO pin connected to DHT11
+    dht_sensor_type_t type; // DHT_TYPE_DHT11 or DHT_TYPE_AM2301 (DHT22)
+    gpio_num_t pin;         // GPIO pin connected to the sensor
     int16_t temperature;    // Temperature in tenths of degrees Celsius
     int16_t humidity;       // Humidity in tenths of percent
+    dht_rmt_handle_t rmt;   // RMT capture (CONFIG_DHT_READER_DRIVER_RMT), else NULL
 } dht11_t;
 
+// Name the sensor registers under in sensor_hub
+#define DHT_SENSOR_NAME "dht"
+
+#define DHT11_MIN_PERIOD_MS 1000 // the DHT11 needs 1 s between reads
+#define DHT22_MIN_PERIOD_MS 2000 // the DHT22 2 s
+#define DHT_DEFAULT_PERIOD_MS 2000
+
+dht11_t dht_init(gpio_num_t pin, dht_sensor_type_t type);
+// DHT11, or the type chosen in menuconfig (CONFIG_DHT_READER_SENSOR)
 dht11_t dht11_init(gpio_num_t pin);
+
+// Through the RMT capture or the bit-banged esp-idf-lib driver, per
+// CONFIG_DHT_READER_DRIVER
 esp_err_t dht11_read(dht11_t *sensor);
-void read_dht11_task(void *pvParameter);
-void read_dht11_and_update_globals_task(void *pvParameter);
 
-#endif // DHT11_READER_H
\ No newline at end of file
+// sensor_hub driver for `sensor` (SENSOR_ID_TEMPERATURE, SENSOR_ID_HUMIDITY,
+// at DHT_DEFAULT_PERIOD_MS). Both must outlive the registration.
+void dht_sensor_driver(dht11_t *sensor, sensor_driver_t *out);
+
+#endif // DHT11_READER_H
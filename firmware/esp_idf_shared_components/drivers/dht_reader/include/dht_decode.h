@@ -0,0 +1,67 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// DHT11/DHT22 frame decoding from captured line levels: the host side of the
+// RMT driver (dht_rmt.c) and host_tools/dht_decode_check share it. Plain
+// C, no ESP-IDF dependency.
+//
+// After the start pulse the sensor answers low 80 us / high 80 us, then
+// sends 40 bits, each a ~50 us low followed by a high of ~27 us (0) or
+// ~70 us (1), and ends with a ~50 us low: humidity, temperature (2 bytes
+// each) and a checksum byte.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define DHT_FRAME_BITS 40
+#define DHT_BIT_THRESHOLD_US 48 // high longer than this is a 1
+#define DHT_BIT_MAX_HIGH_US 110
+#define DHT_BIT_MIN_LOW_US 20
+#define DHT_BIT_MAX_LOW_US 120
+
+    typedef enum
+    {
+        DHT_MODEL_DHT11, // 1 C / 1 %RH resolution, tenths in the 2nd byte of each pair
+        DHT_MODEL_DHT22, // AM2302/AM2301: 16-bit tenths, sign bit on temperature
+    } dht_model_t;
+
+    typedef enum
+    {
+        DHT_DECODE_OK = 0,
+        DHT_DECODE_NO_RESPONSE, // no low/high pulse pair at all
+        DHT_DECODE_SHORT,       // fewer than 40 bits
+        DHT_DECODE_BAD_TIMING,  // a bit pulse outside the limits above
+        DHT_DECODE_CHECKSUM,
+    } dht_decode_result_t;
+
+    // One stretch of constant line level, as a capture peripheral reports it
+    typedef struct
+    {
+        uint16_t us;
+        uint8_t level; // 0 low, 1 high
+    } dht_span_t;
+
+    typedef struct
+    {
+        int16_t temp_dc;  // 0.1 C
+        int16_t hum_dpct; // 0.1 %RH
+    } dht_reading_t;
+
+    // Decodes the last 40 low/high pairs of `spans`: the response pulse and
+    // anything before it may be cut off. Adjacent spans of the same level are
+    // merged. `raw` (optional) gets the 5 frame bytes whenever 40 bits were
+    // found, even on a checksum error.
+    dht_decode_result_t dht_decode_spans(const dht_span_t *spans, size_t n, dht_model_t model, dht_reading_t *out,
+                                         uint8_t raw[5]);
+
+    // Checks the checksum of 5 frame bytes and converts them
+    dht_decode_result_t dht_decode_bytes(const uint8_t raw[5], dht_model_t model, dht_reading_t *out);
+
+    const char *dht_decode_result_name(dht_decode_result_t r);
+
+#ifdef __cplusplus
+}
+#endif
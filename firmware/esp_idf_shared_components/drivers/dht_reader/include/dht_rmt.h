@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "dht_decode.h"
+
+// DHT11/DHT22 reads through the RMT receiver: the start pulse is driven on
+// the open-drain GPIO while the task sleeps, the RMT captures the answer in
+// hardware and its done callback wakes the task. No busy waiting and no
+// interrupt masking, unlike the bit-banged esp-idf-lib driver. The captured
+// symbols go through dht_decode.h.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct dht_rmt *dht_rmt_handle_t;
+
+    // Claims an RMT RX channel on `pin` and sets the pin up as open drain with
+    // the internal pull-up
+    esp_err_t dht_rmt_new(gpio_num_t pin, dht_model_t model, dht_rmt_handle_t *out);
+
+    // One read takes about 30 ms, nearly all of it asleep.
+    // ESP_ERR_TIMEOUT: no answer, ESP_ERR_INVALID_SIZE: frame cut short,
+    // ESP_ERR_INVALID_RESPONSE: bad pulse timing, ESP_ERR_INVALID_CRC: checksum.
+    esp_err_t dht_rmt_read(dht_rmt_handle_t h, dht_reading_t *out);
+
+    void dht_rmt_del(dht_rmt_handle_t h);
+
+#ifdef __cplusplus
+}
+#endif
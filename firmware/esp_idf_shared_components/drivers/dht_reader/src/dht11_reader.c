@@ -1,67 +1,89 @@
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
 
 #include "dht11_reader.h"
-#include "global.h"
+#include "sensor_registry.h"
 
 static const char *TAG = "DHT11_READER";
 
-dht11_t dht11_init(gpio_num_t pin)
+static const char *type_name(dht_sensor_type_t type)
+{
+    return type == DHT_TYPE_DHT11 ? "DHT11" : "DHT22";
+}
+
+dht11_t dht_init(gpio_num_t pin, dht_sensor_type_t type)
 {
     dht11_t sensor = {
-        .type = DHT_TYPE_DHT11,
+        .type = type,
         .pin = pin,
         .temperature = 0x7FFF, // Uninitialized state
-        .humidity = 0x7FFF     // Uninitialized state
+        .humidity = 0x7FFF,    // Uninitialized state
+        .rmt = NULL,
     };
 
+#if CONFIG_DHT_READER_DRIVER_RMT
+    const dht_model_t model = type == DHT_TYPE_DHT11 ? DHT_MODEL_DHT11 : DHT_MODEL_DHT22;
+    if (dht_rmt_new(pin, model, &sensor.rmt) == ESP_OK)
+    {
+        ESP_LOGI(TAG, "%s sensor initialized on GPIO %d (RMT capture)", type_name(type), pin);
+        return sensor;
+    }
+    ESP_LOGW(TAG, "No RMT channel, falling back to the bit-banged driver");
+#endif
+
     // Configure the GPIO pin
     gpio_set_direction(pin, GPIO_MODE_INPUT);
 
-    ESP_LOGI(TAG, "DHT11 sensor initialized on GPIO %d", pin);
+    ESP_LOGI(TAG, "%s sensor initialized on GPIO %d", type_name(type), pin);
     return sensor;
 }
 
-esp_err_t dht11_read(dht11_t *sensor)
+dht11_t dht11_init(gpio_num_t pin)
 {
-    return dht_read_data(sensor->type, sensor->pin, &sensor->humidity, &sensor->temperature);
+#if CONFIG_DHT_READER_SENSOR_DHT22
+    return dht_init(pin, DHT_TYPE_AM2301);
+#else
+    return dht_init(pin, DHT_TYPE_DHT11);
+#endif
 }
 
-void read_dht11_task(void *pvParameter)
+esp_err_t dht11_read(dht11_t *sensor)
 {
-    dht11_t *sensor = (dht11_t *)pvParameter;
-    while (1)
+    if (sensor->rmt)
     {
-        if (dht11_read(sensor) == ESP_OK)
-        {
-            ESP_LOGI(TAG, "Humidity: %.1f%%, Temperature: %.1f°C",
-                     (float)sensor->humidity / 10, (float)sensor->temperature / 10);
-        }
-        else
+        dht_reading_t r;
+        esp_err_t err = dht_rmt_read(sensor->rmt, &r);
+        if (err == ESP_OK)
         {
-            ESP_LOGW(TAG, "Could not read data from sensor");
+            sensor->temperature = r.temp_dc;
+            sensor->humidity = r.hum_dpct;
         }
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        return err;
     }
+    return dht_read_data(sensor->type, sensor->pin, &sensor->humidity, &sensor->temperature);
 }
 
-void read_dht11_and_update_globals_task(void *pvParameter)
+/*========== sensor_hub driver ==========*/
+static int driver_read(void *ctx, int32_t *values)
 {
-    dht11_t *sensor = (dht11_t *)pvParameter;
-    while (1)
-    {
-        if (dht11_read(sensor) == ESP_OK)
-        {
-            ESP_LOGI(TAG, "Humidity: %.1f%%, Temperature: %.1f°C",
-                     (float)sensor->humidity / 10, (float)sensor->temperature / 10);
-            global_humidity = sensor->humidity;
-            global_temperature = sensor->temperature;
-        }
-        else
-        {
-            ESP_LOGW(TAG, "Could not read data from sensor");
-        }
-        vTaskDelay(pdMS_TO_TICKS(2000));
-    }
+    dht11_t *sensor = (dht11_t *)ctx;
+    esp_err_t err = dht11_read(sensor);
+    if (err != ESP_OK)
+        return err;
+    // Cap bits in ascending sensor_id_t order
+    values[0] = sensor->temperature;
+    values[1] = sensor->humidity;
+    return ESP_OK;
+}
+
+void dht_sensor_driver(dht11_t *sensor, sensor_driver_t *out)
+{
+    *out = (sensor_driver_t){
+        .name = DHT_SENSOR_NAME,
+        .caps = SENSOR_CAP(SENSOR_ID_TEMPERATURE) | SENSOR_CAP(SENSOR_ID_HUMIDITY),
+        .min_period_ms = sensor->type == DHT_TYPE_DHT11 ? DHT11_MIN_PERIOD_MS : DHT22_MIN_PERIOD_MS,
+        .default_period_ms = DHT_DEFAULT_PERIOD_MS,
+        .read = driver_read,
+        .ctx = sensor,
+    };
 }
@@ -0,0 +1,102 @@
+#include <string.h>
+
+#include "dht_decode.h"
+
+dht_decode_result_t dht_decode_bytes(const uint8_t raw[5], dht_model_t model, dht_reading_t *out)
+{
+    const uint8_t sum = (uint8_t)(raw[0] + raw[1] + raw[2] + raw[3]);
+    if (sum != raw[4])
+        return DHT_DECODE_CHECKSUM;
+
+    if (model == DHT_MODEL_DHT11)
+    {
+        // Integer part, then tenths; newer DHT11 set bit 7 of the temperature
+        // tenths byte below 0 C
+        out->hum_dpct = (int16_t)(raw[0] * 10 + raw[1] % 10);
+        int16_t t = (int16_t)(raw[2] * 10 + (raw[3] & 0x7F) % 10);
+        out->temp_dc = (raw[3] & 0x80) ? (int16_t)-t : t;
+    }
+    else
+    {
+        out->hum_dpct = (int16_t)((raw[0] << 8) | raw[1]);
+        int16_t t = (int16_t)(((raw[2] & 0x7F) << 8) | raw[3]);
+        out->temp_dc = (raw[2] & 0x80) ? (int16_t)-t : t;
+    }
+    return DHT_DECODE_OK;
+}
+
+dht_decode_result_t dht_decode_spans(const dht_span_t *spans, size_t n, dht_model_t model, dht_reading_t *out,
+                                     uint8_t raw[5])
+{
+    // Low/high pairs, newest last; only the last DHT_FRAME_BITS are kept. A
+    // pair counts once the next low starts (the sensor's closing low ends
+    // the last bit), so a trailing high of any length is ignored.
+    uint16_t low[DHT_FRAME_BITS], high[DHT_FRAME_BITS];
+    size_t pairs = 0;
+    uint32_t cur_low = 0, cur_high = 0;
+    int state = -1; // -1 before the first low, 0 in a low, 1 in the high after it
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (spans[i].level == 0)
+        {
+            if (state == 1)
+            {
+                if (pairs == DHT_FRAME_BITS)
+                {
+                    memmove(low, low + 1, sizeof(low) - sizeof(low[0]));
+                    memmove(high, high + 1, sizeof(high) - sizeof(high[0]));
+                    pairs--;
+                }
+                low[pairs] = (uint16_t)(cur_low > 0xFFFF ? 0xFFFF : cur_low);
+                high[pairs] = (uint16_t)(cur_high > 0xFFFF ? 0xFFFF : cur_high);
+                pairs++;
+                cur_low = 0;
+                cur_high = 0;
+            }
+            cur_low += spans[i].us;
+            state = 0;
+        }
+        else if (state >= 0)
+        {
+            cur_high += spans[i].us;
+            state = 1;
+        }
+    }
+
+    if (pairs == 0)
+        return DHT_DECODE_NO_RESPONSE;
+    if (pairs < DHT_FRAME_BITS)
+        return DHT_DECODE_SHORT;
+
+    uint8_t bytes[5] = {0};
+    for (size_t b = 0; b < DHT_FRAME_BITS; b++)
+    {
+        if (low[b] < DHT_BIT_MIN_LOW_US || low[b] > DHT_BIT_MAX_LOW_US || high[b] > DHT_BIT_MAX_HIGH_US)
+            return DHT_DECODE_BAD_TIMING;
+        if (high[b] > DHT_BIT_THRESHOLD_US)
+            bytes[b / 8] |= (uint8_t)(0x80 >> (b % 8));
+    }
+    if (raw)
+        memcpy(raw, bytes, sizeof(bytes));
+    return dht_decode_bytes(bytes, model, out);
+}
+
+const char *dht_decode_result_name(dht_decode_result_t r)
+{
+    switch (r)
+    {
+    case DHT_DECODE_OK:
+        return "ok";
+    case DHT_DECODE_NO_RESPONSE:
+        return "no response";
+    case DHT_DECODE_SHORT:
+        return "short frame";
+    case DHT_DECODE_BAD_TIMING:
+        return "bad timing";
+    case DHT_DECODE_CHECKSUM:
+        return "checksum";
+    default:
+        return "?";
+    }
+}
@@ -0,0 +1,171 @@
+#include "sdkconfig.h"
+#if CONFIG_DHT_READER_DRIVER_RMT
+
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "driver/rmt_rx.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "dht_rmt.h"
+
+static const char *TAG = "DHT_RMT";
+
+#define DHT_RMT_RESOLUTION_HZ 1000000 // 1 tick = 1 us, what dht_decode expects
+#define DHT_RMT_SYMBOLS 64            // a frame is ~43 symbols
+#define DHT_RMT_START_MS 20           // DHT11 needs >= 18 ms, AM230x accept it too
+#define DHT_RMT_FRAME_TIMEOUT_MS 20   // the frame itself lasts < 6 ms
+
+// Glitches shorter than 1 us are dropped; 200 us without an edge ends the
+// capture (the longest valid level is the 80 us response)
+static const rmt_receive_config_t s_rx_cfg = {
+    .signal_range_min_ns = 1000,
+    .signal_range_max_ns = 200 * 1000,
+};
+
+struct dht_rmt
+{
+    gpio_num_t pin;
+    dht_model_t model;
+    rmt_channel_handle_t rx;
+    QueueHandle_t done; // rmt_rx_done_event_data_t from the ISR
+    rmt_symbol_word_t symbols[DHT_RMT_SYMBOLS];
+    dht_span_t spans[DHT_RMT_SYMBOLS * 2];
+};
+
+/*========== Helpers ==========*/
+static bool rx_done_cb(rmt_channel_handle_t ch, const rmt_rx_done_event_data_t *edata, void *user_ctx)
+{
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR((QueueHandle_t)user_ctx, edata, &woken);
+    return woken == pdTRUE;
+}
+
+static esp_err_t decode_result_to_err(dht_decode_result_t r)
+{
+    switch (r)
+    {
+    case DHT_DECODE_OK:
+        return ESP_OK;
+    case DHT_DECODE_NO_RESPONSE:
+        return ESP_ERR_TIMEOUT;
+    case DHT_DECODE_SHORT:
+        return ESP_ERR_INVALID_SIZE;
+    case DHT_DECODE_CHECKSUM:
+        return ESP_ERR_INVALID_CRC;
+    default:
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+}
+
+/*========== Public APIs ==========*/
+esp_err_t dht_rmt_new(gpio_num_t pin, dht_model_t model, dht_rmt_handle_t *out)
+{
+    ESP_RETURN_ON_FALSE(out, ESP_ERR_INVALID_ARG, TAG, "out is NULL");
+    struct dht_rmt *h = calloc(1, sizeof(*h));
+    ESP_RETURN_ON_FALSE(h, ESP_ERR_NO_MEM, TAG, "no memory");
+    h->pin = pin;
+    h->model = model;
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    h->done = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
+    if (!h->done)
+        goto fail;
+
+    const rmt_rx_channel_config_t rx_cfg = {
+        .gpio_num = pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = DHT_RMT_RESOLUTION_HZ,
+        .mem_block_symbols = DHT_RMT_SYMBOLS,
+    };
+    err = rmt_new_rx_channel(&rx_cfg, &h->rx);
+    if (err != ESP_OK)
+        goto fail;
+    const rmt_rx_event_callbacks_t cbs = {.on_recv_done = rx_done_cb};
+    err = rmt_rx_register_event_callbacks(h->rx, &cbs, h->done);
+    if (err == ESP_OK)
+        err = rmt_enable(h->rx);
+    if (err != ESP_OK)
+        goto fail;
+
+    // The channel set the pin up as an input; add the open-drain output for
+    // the start pulse on top, idle released
+    gpio_set_level(pin, 1);
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_pullup_en(pin);
+
+    *out = h;
+    return ESP_OK;
+
+fail:
+    ESP_LOGE(TAG, "Init on GPIO %d failed: %s", pin, esp_err_to_name(err));
+    dht_rmt_del(h);
+    return err;
+}
+
+esp_err_t dht_rmt_read(dht_rmt_handle_t h, dht_reading_t *out)
+{
+    if (!h || !out)
+        return ESP_ERR_INVALID_ARG;
+
+    xQueueReset(h->done);
+
+    // Start pulse: hold the line low while the task sleeps
+    gpio_set_level(h->pin, 0);
+    vTaskDelay(pdMS_TO_TICKS(DHT_RMT_START_MS) + 1);
+
+    // Arm before releasing so the response can't slip past; the few us of
+    // our own low at the head of the capture fall out in the decoder
+    esp_err_t err = rmt_receive(h->rx, h->symbols, sizeof(h->symbols), &s_rx_cfg);
+    gpio_set_level(h->pin, 1);
+    if (err != ESP_OK)
+        return err;
+
+    rmt_rx_done_event_data_t ev;
+    if (xQueueReceive(h->done, &ev, pdMS_TO_TICKS(DHT_RMT_FRAME_TIMEOUT_MS) + 1) != pdTRUE)
+    {
+        // No edge at all (sensor missing): the receiver is still armed,
+        // restart the channel to cancel it
+        rmt_disable(h->rx);
+        rmt_enable(h->rx);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < ev.num_symbols; i++)
+    {
+        const rmt_symbol_word_t *s = &ev.received_symbols[i];
+        if (s->duration0)
+            h->spans[n++] = (dht_span_t){.us = s->duration0, .level = s->level0};
+        if (s->duration1)
+            h->spans[n++] = (dht_span_t){.us = s->duration1, .level = s->level1};
+    }
+
+    uint8_t raw[5];
+    const dht_decode_result_t r = dht_decode_spans(h->spans, n, h->model, out, raw);
+    if (r != DHT_DECODE_OK)
+    {
+        ESP_LOGD(TAG, "Decode failed (%s), %u symbols", dht_decode_result_name(r), (unsigned)ev.num_symbols);
+        if (r == DHT_DECODE_CHECKSUM)
+            ESP_LOGD(TAG, "Frame %02x %02x %02x %02x %02x", raw[0], raw[1], raw[2], raw[3], raw[4]);
+    }
+    return decode_result_to_err(r);
+}
+
+void dht_rmt_del(dht_rmt_handle_t h)
+{
+    if (!h)
+        return;
+    if (h->rx)
+    {
+        rmt_disable(h->rx);
+        rmt_del_channel(h->rx);
+    }
+    if (h->done)
+        vQueueDelete(h->done);
+    free(h);
+}
+
+#endif // CONFIG_DHT_READER_DRIVER_RMT
@@ -2,20 +2,55 @@
 #define OLED_DISPLAY_H
 
 #include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#if CONFIG_I2C_OLED_BACKEND_LVGL
 #include "lvgl.h"
+#endif
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
-    lv_display_t *oled_display_init(int i2c_port, int sda_io, int scl_io,
-                                    uint8_t i2c_addr, int width, int height);
+    // Display handle: the LVGL display with the LVGL backend, opaque with the
+    // native one (Kconfig I2C_OLED_BACKEND)
+#if CONFIG_I2C_OLED_BACKEND_LVGL
+    typedef lv_display_t oled_display_t;
+#else
+    typedef struct oled_native_display oled_display_t;
+#endif
+
+    oled_display_t *oled_display_init(int i2c_port, int sda_io, int scl_io,
+                                      uint8_t i2c_addr, int width, int height);
 
-    void oled_display_create_basic_ui(lv_display_t *disp);
+    void oled_display_create_basic_ui(oled_display_t *disp);
 
+    // Shows the climate screen with these values (NAN: no reading)
     void oled_display_update(float temp_c, float hum_pct);
 
+    // Shows the status screen: `line1` large ("AP MODE", "CONNECTING"),
+    // `line2` small below it. The climate screen keeps `line2` as its footer.
+    void oled_display_show_status(const char *line1, const char *line2);
+
+    // Frame timing of the LVGL refresh and the I2C flush, and LVGL task load,
+    // since boot
+    typedef struct
+    {
+        uint32_t frames;         // refreshes that changed the panel
+        uint32_t frames_skipped; // refreshes whose output already matched the panel
+        uint32_t flushes;        // areas flushed (LVGL) or page spans sent (native)
+        uint32_t bytes;          // pixel bytes sent to the panel
+        uint32_t render_us_last; // LVGL time of the last refresh, waits for the bus excluded
+        uint32_t render_us_max;
+        uint32_t flush_us_last; // flush callback to last transfer done, last area
+        uint32_t flush_us_max;
+        uint32_t wakeups; // LVGL task wakeups (LVGL backend)
+        uint64_t busy_us; // time spent in lv_timer_handler() (LVGL backend)
+    } oled_display_stats_t;
+
+    esp_err_t oled_display_get_stats(oled_display_stats_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,54 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Conversion of LVGL I1 frames (row-major, 1 bit/pixel, MSB = leftmost) to
+// SSD1306 GDDRAM layout (pages of 8 rows, one byte per column, LSB = top
+// row), with a shadow of the panel RAM so a flush only sends what changed.
+// Plain C with no ESP-IDF dependency: host_tools/oled_flush_bench compiles
+// this file as-is.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define OLED_PACK_MAX_PAGES 8 // 64 rows
+
+    // Transposes an 8x8 bit block: `rows[r]` is row r (MSB = left column),
+    // `cols[c]` gets column c (bit r = row r). Lit LVGL pixels (1) become 0
+    // bits, matching how the panel is driven.
+    void oled_pack_block(const uint8_t rows[8], uint8_t cols[8]);
+
+    typedef struct
+    {
+        int16_t x0; // first changed column, -1 if the page is clean
+        int16_t x1; // last changed column
+    } oled_dirty_span_t;
+
+    typedef struct
+    {
+        int width;   // multiple of 8
+        int height;  // multiple of 8, <= 8 * OLED_PACK_MAX_PAGES
+        uint8_t *fb; // width * height / 8 bytes: what the panel shows
+        bool valid;  // false until the panel RAM matches fb
+    } oled_shadow_t;
+
+    // `fb` must hold width * height / 8 bytes and is cleared to an all-off
+    // panel. Until `valid` is set (by the caller after sending fb, or by a
+    // full screen update) every update reports its whole area dirty.
+    bool oled_shadow_init(oled_shadow_t *sh, int width, int height, uint8_t *fb);
+    void oled_shadow_invalidate(oled_shadow_t *sh);
+
+    // Packs the area x1..x2, y1..y2 of an I1 image into the shadow and fills
+    // `dirty[page]` with the changed column span of each page. `px` points at
+    // the area's first pixel, `stride` bytes per row; the area must be 8x8
+    // block aligned (x1, y1 multiples of 8, x2 + 1, y2 + 1 too). Returns the
+    // number of dirty pages, or -1 for an unaligned or out of screen area.
+    int oled_shadow_update(oled_shadow_t *sh, const uint8_t *px, size_t stride, int x1, int y1, int x2, int y2,
+                           oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES]);
+
+#ifdef __cplusplus
+}
+#endif
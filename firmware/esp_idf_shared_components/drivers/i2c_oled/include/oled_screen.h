@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+
+#include "oled_text.h"
+
+// Status screens of the native backend as layout tables over an oled_canvas:
+// each item is a fixed caption or a text field at a page/column with a font
+// and a width in cells. Setting a field redraws only that field, so the
+// dirty spans cover just the characters that changed. Plain C, shared with
+// host_tools/oled_render.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define OLED_FIELD_MAX_LEN 21 // small cells across 128 columns
+
+    typedef enum
+    {
+        OLED_SCREEN_STATUS,  // LINE1 large, LINE2 below ("AP MODE", SSID)
+        OLED_SCREEN_CLIMATE, // temperature, humidity, FOOTER at the bottom
+        OLED_SCREEN_COUNT,
+    } oled_screen_id_t;
+
+    typedef enum
+    {
+        OLED_FIELD_LINE1,
+        OLED_FIELD_LINE2,
+        OLED_FIELD_TEMP,
+        OLED_FIELD_HUM,
+        OLED_FIELD_FOOTER,
+        OLED_FIELD_COUNT,
+    } oled_field_t;
+
+#define OLED_FIELD_CAPTION (-1)
+
+    typedef struct
+    {
+        int8_t field;        // oled_field_t, or OLED_FIELD_CAPTION
+        uint8_t x;           // column
+        uint8_t page;        // top page
+        uint8_t font;        // oled_font_t
+        uint8_t cells;       // width; shorter text is blank padded
+        const char *caption; // text of a caption
+    } oled_layout_item_t;
+
+    typedef struct
+    {
+        const oled_layout_item_t *items;
+        int count;
+    } oled_layout_t;
+
+    // Layout of `id` for a panel `height` rows tall (32 or 64)
+    const oled_layout_t *oled_screen_layout(oled_screen_id_t id, int height);
+
+    typedef struct
+    {
+        oled_canvas_t *cv;
+        int shown; // oled_screen_id_t, -1 before the first show
+        char text[OLED_FIELD_COUNT][OLED_FIELD_MAX_LEN + 1];
+    } oled_screen_t;
+
+    void oled_screen_init(oled_screen_t *s, oled_canvas_t *cv);
+
+    // Stores the field text (truncated to OLED_FIELD_MAX_LEN) and draws it if
+    // the shown screen has that field
+    void oled_screen_set(oled_screen_t *s, oled_field_t field, const char *text);
+
+    // Draws screen `id` from the stored field texts; no-op if already shown
+    void oled_screen_show(oled_screen_t *s, oled_screen_id_t id);
+
+    // A reading as both backends show it: one decimal and `unit`, or "--.-"
+    // when there is none (NAN, or any value that is not finite)
+    void oled_screen_format_value(char *buf, size_t len, float v, const char *unit);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oled_pack.h"
+
+// Text drawn straight into SSD1306 GDDRAM layout (pages of 8 rows, one byte
+// per column, LSB = top row, 1 = lit) from page-aligned glyph atlases: the
+// native backend's renderer. Glyphs land on whole pages, so a blit is a
+// byte copy and no frame conversion is needed. Plain C like oled_pack.c:
+// host_tools/oled_render compiles it as-is.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum
+    {
+        OLED_FONT_SMALL, // 5x7 glyphs in 6x8 cells: one page
+        OLED_FONT_LARGE, // the same glyphs doubled, 12x16 cells: two pages
+    } oled_font_t;
+
+    int oled_font_cell_width(oled_font_t font);
+    int oled_font_pages(oled_font_t font);
+    // Flash taken by both atlases
+    size_t oled_font_atlas_bytes(void);
+
+    typedef struct
+    {
+        int width;   // multiple of 8
+        int height;  // multiple of 8, <= 8 * OLED_PACK_MAX_PAGES
+        uint8_t *fb; // width * height / 8 bytes in page layout
+        oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES]; // columns changed since the last take
+    } oled_canvas_t;
+
+    // Clears `fb` and marks the whole canvas dirty, since the panel content
+    // is unknown.
+    bool oled_canvas_init(oled_canvas_t *cv, int width, int height, uint8_t *fb);
+
+    // Blanks the canvas; only columns that were lit become dirty.
+    void oled_canvas_clear(oled_canvas_t *cv);
+
+    // Draws `text` with its top-left corner at column `x` of `page`, then
+    // blank cells up to `cells` cells so a shorter text erases a longer one.
+    // Clipped at the right and bottom edges; characters outside the font show
+    // as '?'. Only bytes that change are marked dirty. Returns how many.
+    int oled_canvas_text(oled_canvas_t *cv, int x, int page, oled_font_t font, const char *text, int cells);
+
+    // Copies the dirty spans to `dirty` and marks the canvas clean. Returns
+    // the number of dirty pages.
+    int oled_canvas_take_dirty(oled_canvas_t *cv, oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,22 +1,33 @@
+#include "sdkconfig.h"
+#if CONFIG_I2C_OLED_BACKEND_LVGL
+// LVGL backend of i2c_oled_display.h; oled_native_display.c is the other one
+
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/lock.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_timer.h"
-#include "driver/i2c_master.h"
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_ops.h"
-#include "esp_lcd_panel_vendor.h"
 #include "i2c_oled_display.h"
+#include "oled_pack.h"
+#include "oled_panel.h"
+#include "oled_screen.h"
 
 // ====== Module Configuration ======
-#define LVGL_TICK_MS 5
 #define LVGL_TASK_STACK (4 * 1024)
 #define LVGL_TASK_PRIO 2
 #define LVGL_PALETTE_BYTES 8
+#define OLED_TX_TASK_STACK (3 * 1024)
+#define OLED_TX_TASK_PRIO (LVGL_TASK_PRIO + 1) // keep the bus busy while LVGL renders
+#define OLED_FLUSH_WAIT_MS 100
+#define LVGL_LOAD_LOG_MS (60 * 1000) // wakeup/busy summary, logged on the next wakeup after this
 
 static const char *TAG = "OLED";
 
@@ -27,26 +38,161 @@ static _lock_t s_lvgl_lock;
 // UI elements
 static lv_obj_t *s_label = NULL;    // Label to display Temp/Hum
 static lv_display_t *s_disp = NULL; // Display handle for updating UI
+static char s_label_text[48];       // What s_label shows, to skip no-op updates
+static lv_obj_t *s_climate_scr = NULL;
+static lv_obj_t *s_footer = NULL; // Status line2 under the readings
+static lv_obj_t *s_status_scr = NULL;
+static lv_obj_t *s_status_l1 = NULL, *s_status_l2 = NULL;
+
+// The LVGL task sleeps until notified: on an invalidated area, or when the
+// next LVGL timer (animations) is due
+static TaskHandle_t s_lvgl_task = NULL;
 
 // OLED panel resources
-// Buffer for 1-bit pixel data to send to panel (allocated after knowing width/height)
+// Buffer for 1-bit pixel data to send to panel (allocated after knowing width/height).
+// Holds what the panel shows, so each flush only sends the changed spans.
 static uint8_t *s_oled_buffer = NULL;
+static oled_shadow_t s_shadow;
+
+// Spans of the current flush, sent by the tx task so the LVGL task can render
+// the next area meanwhile. s_flush_pending counts transfers still in flight;
+// the last one to finish tells LVGL the buffer is free again.
+static oled_dirty_span_t s_tx_dirty[OLED_PACK_MAX_PAGES];
+static TaskHandle_t s_tx_task = NULL;
+static SemaphoreHandle_t s_flush_done = NULL;
+static volatile int s_flush_pending = 0;
+static int64_t s_flush_start_us = 0;
+static volatile bool s_resync = false; // a transfer failed: redraw everything
+
+// Frame timing. Refresh fields are written by the LVGL task, flush fields
+// from the transfer-done callback.
+static oled_display_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct
+{
+    int64_t start_us;
+    int64_t wait_us; // spent blocked in lvgl_flush_wait_cb
+    uint32_t flushes;
+    uint32_t bytes;
+} s_frame;
 
 // Width and height of the panel (for flush)
 static int s_w = 0, s_h = 0;
 
 // ====== Callback and task implementations ======
-// ====== Callback when color transfer is done: call lv_display_flush_ready() ======
+// ====== One span of the current flush is on the panel (or failed) ======
+static bool flush_span_done(lv_display_t *disp)
+{
+    if (s_flush_pending <= 0 || --s_flush_pending > 0)
+        return false;
+
+    const uint32_t us = (uint32_t)(esp_timer_get_time() - s_flush_start_us);
+    portENTER_CRITICAL_SAFE(&s_stats_lock);
+    s_stats.flush_us_last = us;
+    if (us > s_stats.flush_us_max)
+        s_stats.flush_us_max = us;
+    portEXIT_CRITICAL_SAFE(&s_stats_lock);
+
+    lv_display_flush_ready(disp); // Inform LVGL that flushing is done --> can continue now
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(s_flush_done, &woken);
+    return woken == pdTRUE;
+}
+
+// ====== Callback when color transfer is done ======
 static bool on_color_trans_done(esp_lcd_panel_io_handle_t io,
                                 esp_lcd_panel_io_event_data_t *edata,
                                 void *user_ctx)
 {
-    lv_display_t *disp = (lv_display_t *)user_ctx;
-    lv_display_flush_ready(disp); // Inform LVGL that flushing is done --> can continue now
-    return false;                 // No need to yield from ISR
+    return flush_span_done((lv_display_t *)user_ctx);
+}
+
+// ====== Transfer task: push the dirty spans of each flush to the panel ======
+static void oled_tx_task(void *arg)
+{
+    lv_display_t *disp = (lv_display_t *)arg;
+    esp_lcd_panel_handle_t panel = lv_display_get_user_data(disp);
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (int p = 0; p < s_h / 8; p++)
+        {
+            if (s_tx_dirty[p].x0 < 0)
+                continue;
+            // One page tall, so contiguous in the shadow
+            esp_err_t err = esp_lcd_panel_draw_bitmap(panel, s_tx_dirty[p].x0, p * 8, s_tx_dirty[p].x1 + 1,
+                                                      p * 8 + 8, s_oled_buffer + s_w * p + s_tx_dirty[p].x0);
+            if (err != ESP_OK)
+            {
+                // No done callback will come for this span. Flip its shadow
+                // bytes so they differ from anything LVGL renders next, and
+                // have the LVGL task redraw the screen.
+                ESP_LOGW(TAG, "Page %d transfer failed: %s", p, esp_err_to_name(err));
+                for (int x = s_tx_dirty[p].x0; x <= s_tx_dirty[p].x1; x++)
+                    s_oled_buffer[s_w * p + x] ^= 0xFF;
+                s_resync = true;
+                flush_span_done(disp);
+            }
+        }
+    }
 }
 
-// ====== Flush function of LVGL: convert px_map to 1-bit buffer and push to panel ======
+// ====== Flush wait of LVGL: block instead of spinning until the transfers end ======
+static void lvgl_flush_wait_cb(lv_display_t *disp)
+{
+    const int64_t t0 = esp_timer_get_time();
+    while (s_flush_pending > 0)
+        xSemaphoreTake(s_flush_done, pdMS_TO_TICKS(OLED_FLUSH_WAIT_MS));
+    s_frame.wait_us += esp_timer_get_time() - t0;
+}
+
+// ====== Invalidated area: round it to whole 8x8 blocks, as the packer needs, and wake the LVGL task ======
+static void lvgl_invalidate_cb(lv_event_t *e)
+{
+    lv_area_t *area = lv_event_get_param(e);
+    area->x1 &= ~7;
+    area->x2 |= 7;
+    area->y1 &= ~7;
+    area->y2 |= 7;
+
+    lv_timer_resume(lv_display_get_refr_timer(lv_event_get_target(e)));
+    if (s_lvgl_task)
+        xTaskNotifyGive(s_lvgl_task);
+}
+
+// ====== Refresh start/end: frame timing ======
+static void lvgl_refr_event_cb(lv_event_t *e)
+{
+    const int64_t now = esp_timer_get_time();
+    if (lv_event_get_code(e) == LV_EVENT_REFR_START)
+    {
+        memset(&s_frame, 0, sizeof(s_frame));
+        s_frame.start_us = now;
+        return;
+    }
+
+    // LV_EVENT_REFR_READY: nothing left to draw, so stop the refresh timer
+    // until the next invalidation (animations invalidate as they run)
+    lv_timer_pause(lv_display_get_refr_timer(lv_event_get_target(e)));
+    if (s_frame.flushes == 0)
+        return; // Nothing was invalid
+    int64_t us = now - s_frame.start_us - s_frame.wait_us;
+    if (us < 0)
+        us = 0;
+    taskENTER_CRITICAL(&s_stats_lock);
+    if (s_frame.bytes)
+        s_stats.frames++;
+    else
+        s_stats.frames_skipped++;
+    s_stats.flushes += s_frame.flushes;
+    s_stats.bytes += s_frame.bytes;
+    s_stats.render_us_last = (uint32_t)us;
+    if ((uint32_t)us > s_stats.render_us_max)
+        s_stats.render_us_max = (uint32_t)us;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+// ====== Flush function of LVGL: convert px_map to 1-bit buffer and hand it to the tx task ======
 static void lvgl_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
 {
     // Safety check
@@ -56,129 +202,130 @@ static void lvgl_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px
         return;
     }
 
-    // Get panel handle stored in user_data of disp
-    esp_lcd_panel_handle_t panel = lv_display_get_user_data(disp);
+    const int64_t t0 = esp_timer_get_time();
 
     // LVGL (I1) uses first 2x4 bytes of buffer as palette → skip it
     px_map += LVGL_PALETTE_BYTES;
 
-    // Physical horizontal resolution of display
-    uint16_t hor_res = lv_display_get_physical_horizontal_resolution(disp);
-
-    // Area to flush
-    const int x1 = area->x1, x2 = area->x2, y1 = area->y1, y2 = area->y2;
-
-    // Iterate through each pixel in the area, convert from "row-major bit" of LVGL
-    // to "column-major/8-pixel-chunk bit" required by SSD1306
-    for (int y = y1; y <= y2; y++)
+    // px_map holds just the area (the whole screen in full render mode)
+    const uint32_t stride = lv_draw_buf_width_to_stride(lv_area_get_width(area), LV_COLOR_FORMAT_I1);
+
+    // Convert 8x8 blocks at a time from "row-major bit" of LVGL to the
+    // "column-major/8-pixel-chunk bit" of SSD1306, and keep only the column
+    // span of each page that differs from what the panel already shows
+    oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES];
+    const int n_dirty =
+        oled_shadow_update(&s_shadow, px_map, stride, area->x1, area->y1, area->x2, area->y2, dirty);
+    s_frame.flushes++;
+    if (n_dirty <= 0)
     {
-        for (int x = x1; x <= x2; x++)
-        {
-            // Each byte in px_map contains 8 horizontal pixels (MSB is leftmost pixel)
-            bool pixel_on = (px_map[(hor_res >> 3) * y + (x >> 3)] & (1 << (7 - (x & 7)))) != 0;
-
-            // SSD1306: byte_offset = (width * (y / 8)) + x
-            // Locate destination byte in buffer
-            uint8_t *dst = s_oled_buffer + s_w * (y >> 3) + x;
-
-            // Assume pixel_on = 1 means "black" (pixel lit)
-            if (pixel_on)
-            {
-                (*dst) &= ~(1 << (y & 7)); // Set pixel (turn on)
-            }
-            else
-            {
-                (*dst) |= (1 << (y & 7)); // Clear pixel (turn off)
-            }
-        }
+        if (n_dirty < 0)
+            ESP_LOGE(TAG, "Flush cb: area (%d,%d)-(%d,%d) not on 8x8 blocks", (int)area->x1, (int)area->y1,
+                     (int)area->x2, (int)area->y2);
+        lv_display_flush_ready(disp); // Nothing changed on the panel
+        return;
     }
 
-    // Push the prepared buffer to the panel
-    esp_lcd_panel_draw_bitmap(panel, x1, y1, x2 + 1, y2 + 1, s_oled_buffer);
+    for (int p = 0; p < s_h / 8; p++)
+    {
+        s_tx_dirty[p] = dirty[p];
+        if (dirty[p].x0 >= 0)
+            s_frame.bytes += (uint32_t)(dirty[p].x1 - dirty[p].x0 + 1);
+    }
+    s_flush_start_us = t0;
+    s_flush_pending = n_dirty; // before the tx task can complete any of them
+    xTaskNotifyGive(s_tx_task);
 }
 
-// ====== Timer callback: increment LVGL tick ======
-static void lvgl_tick_cb(void *arg)
+// ====== Tick source: LVGL reads the time instead of being ticked ======
+static uint32_t lvgl_tick_get_cb(void)
 {
-    lv_tick_inc(LVGL_TICK_MS); // Tell LVGL that LVGL_TICK_MS ms have passed
+    return (uint32_t)(esp_timer_get_time() / 1000);
 }
 
 // ====== LGVL task loop: handle timers, animations, events ======
 static void lvgl_task(void *arg)
 {
     ESP_LOGI(TAG, "LVGL loop start");
+    int64_t log_start_us = esp_timer_get_time();
+    uint32_t log_wakeups = 0, log_busy_us = 0;
     while (1)
     {
+        const int64_t t0 = esp_timer_get_time();
+
         // LGVL is not thread-safe → need to lock
         _lock_acquire(&s_lvgl_lock);        // Lock before call API LVGL
         uint32_t wait = lv_timer_handler(); // Handle timers, animations, events, etc.
-        _lock_release(&s_lvgl_lock);        // Unlock after done
-
-        // Limited wait time to avoid WDT and for smoothness
-        if (wait < 5)
-            wait = 5;
-        if (wait > 500)
-            wait = 500;
-        vTaskDelay(pdMS_TO_TICKS(wait));
+        if (s_resync)
+        {
+            s_resync = false;
+            lv_obj_invalidate(lv_display_get_screen_active(s_disp)); // Resend what a failed transfer lost
+        }
+        _lock_release(&s_lvgl_lock); // Unlock after done
+
+        const int64_t t1 = esp_timer_get_time();
+        const uint32_t busy_us = (uint32_t)(t1 - t0);
+        taskENTER_CRITICAL(&s_stats_lock);
+        s_stats.wakeups++;
+        s_stats.busy_us += busy_us;
+        taskEXIT_CRITICAL(&s_stats_lock);
+        log_wakeups++;
+        log_busy_us += busy_us;
+        if (t1 - log_start_us >= LVGL_LOAD_LOG_MS * 1000LL)
+        {
+            const uint32_t s = (uint32_t)((t1 - log_start_us) / 1000000);
+            ESP_LOGI(TAG, "LVGL: %" PRIu32 " wakeups, %" PRIu32 " ms busy in %" PRIu32 " s", log_wakeups,
+                     log_busy_us / 1000, s);
+            log_start_us = t1;
+            log_wakeups = log_busy_us = 0;
+        }
+
+        // Sleep until the next LVGL timer is due; with nothing to redraw and
+        // no animation running, until an invalidation notifies us
+        TickType_t ticks = portMAX_DELAY;
+        if (wait != LV_NO_TIMER_READY)
+        {
+            ticks = pdMS_TO_TICKS(wait);
+            if (ticks == 0)
+                ticks = 1;
+        }
+        ulTaskNotifyTake(pdTRUE, ticks);
     }
 }
 
 // ====== Public APIs ======
 
-lv_display_t *oled_display_init(int i2c_port, int sda_io, int scl_io,
-                                uint8_t i2c_addr, int width, int height)
+oled_display_t *oled_display_init(int i2c_port, int sda_io, int scl_io,
+                                  uint8_t i2c_addr, int width, int height)
 {
     // Store width/height for flush use
     s_w = width;
     s_h = height;
 
-    // 1. Configure I2C bus
-    i2c_master_bus_handle_t i2c_bus = NULL;
-    i2c_master_bus_config_t bus_cfg = {
-        .clk_source = I2C_CLK_SRC_DEFAULT, // Use default clock source
-        .glitch_ignore_cnt = 7,            // Ignore glitches < 7 cycles
-        .i2c_port = i2c_port,              // I2C port number
-        .sda_io_num = sda_io,              // GPIO SDA
-        .scl_io_num = scl_io,              // GPIO SCL
-        .flags.enable_internal_pullup = true,
-    };
-    ESP_ERROR_CHECK(i2c_new_master_bus(&bus_cfg, &i2c_bus));
-
-    // 2. Configure panel IO for SSD1306
+    // 1-3. I2C bus, panel IO and SSD1306 panel
     esp_lcd_panel_io_handle_t io = NULL;
-    esp_lcd_panel_io_i2c_config_t io_cfg = {
-        .dev_addr = i2c_addr,
-        .scl_speed_hz = 400 * 1000, // 400kHz
-        .control_phase_bytes = 1,   // According to datasheet SSD1306
-        .lcd_cmd_bits = 8,          // 8-bit Command
-        .lcd_param_bits = 8,        // 8-bit Parameter
-        .dc_bit_offset = 6,         // According datasheet SSD1306
-    };
-    ESP_ERROR_CHECK(esp_lcd_new_panel_io_i2c(i2c_bus, &io_cfg, &io));
-
-    // 3. Configure panel for SSD1306
     esp_lcd_panel_handle_t panel = NULL;
-    esp_lcd_panel_dev_config_t panel_cfg = {
-        .bits_per_pixel = 1,  // 1 bit per pixel (monochrome)
-        .reset_gpio_num = -1, // if not used
-    };
-    esp_lcd_panel_ssd1306_config_t vendor_cfg = {
-        .height = height, // 64 or 32
-    };
-    panel_cfg.vendor_config = &vendor_cfg;
-
-    ESP_ERROR_CHECK(esp_lcd_new_panel_ssd1306(io, &panel_cfg, &panel));
-    ESP_ERROR_CHECK(esp_lcd_panel_reset(panel));             // Reset panel
-    ESP_ERROR_CHECK(esp_lcd_panel_init(panel));              // Init panel
-    ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(panel, true)); // Turn on display
+    ESP_ERROR_CHECK(oled_panel_open(i2c_port, sda_io, scl_io, i2c_addr, height, &io, &panel));
 
     // 4. Initialize LVGL
-    lv_init(); // Initialize LVGL library
+    lv_init();                        // Initialize LVGL library
+    lv_tick_set_cb(lvgl_tick_get_cb); // Time from esp_timer: no periodic tick interrupt
 
     // Allocate buffer for panel (1 bit/pixel) for flush (outside LVGL buffer)
     size_t oled_buf_sz = (size_t)width * (size_t)height / 8;
     s_oled_buffer = heap_caps_calloc(1, oled_buf_sz, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
     assert(s_oled_buffer);
+    if (!oled_shadow_init(&s_shadow, width, height, s_oled_buffer))
+    {
+        ESP_LOGE(TAG, "Unsupported panel size %dx%d", width, height);
+        return NULL;
+    }
+    // Panel RAM is random after power up: clear it once so the shadow is
+    // right and partial flushes can diff against it (no callback yet)
+    ESP_ERROR_CHECK(esp_lcd_panel_draw_bitmap(panel, 0, 0, width, height, s_oled_buffer));
+    s_shadow.valid = true;
+    s_flush_done = xSemaphoreCreateBinary();
+    assert(s_flush_done);
 
     // Create LVGL display and configure it
     lv_display_t *disp = lv_display_create(width, height);
@@ -186,12 +333,28 @@ lv_display_t *oled_display_init(int i2c_port, int sda_io, int scl_io,
     lv_display_set_user_data(disp, panel); // Store panel handle in user_data of disp
 
     // LVGL use 1-bit I1 format → need extra 8-byte palette in LVGL buffer
+    lv_display_set_color_format(disp, LV_COLOR_FORMAT_I1); // Set color format to 1-bit I1
+#if CONFIG_I2C_OLED_RENDER_PARTIAL
+    // Two bands of whole pages: LVGL renders into one while the other is sent
+    int lines = CONFIG_I2C_OLED_BUF_LINES & ~7;
+    if (lines > height)
+        lines = height;
+    size_t lv_buf_sz = (size_t)width * lines / 8 + LVGL_PALETTE_BYTES;
+    void *lv_buf = heap_caps_calloc(1, lv_buf_sz, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    void *lv_buf2 = heap_caps_calloc(1, lv_buf_sz, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    assert(lv_buf && lv_buf2);
+    lv_display_set_buffers(disp, lv_buf, lv_buf2, lv_buf_sz, LV_DISPLAY_RENDER_MODE_PARTIAL);
+#else
     size_t lv_buf_sz = width * height / 8 + LVGL_PALETTE_BYTES;
     void *lv_buf = heap_caps_calloc(1, lv_buf_sz, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
     assert(lv_buf);
-    lv_display_set_color_format(disp, LV_COLOR_FORMAT_I1); // Set color format to 1-bit I1
     lv_display_set_buffers(disp, lv_buf, NULL, lv_buf_sz, LV_DISPLAY_RENDER_MODE_FULL);
-    lv_display_set_flush_cb(disp, lvgl_flush_cb); // Set flush function
+#endif
+    lv_display_set_flush_cb(disp, lvgl_flush_cb);           // Set flush function
+    lv_display_set_flush_wait_cb(disp, lvgl_flush_wait_cb); // Sleep, not spin, while the bus is busy
+    lv_display_add_event_cb(disp, lvgl_invalidate_cb, LV_EVENT_INVALIDATE_AREA, NULL);
+    lv_display_add_event_cb(disp, lvgl_refr_event_cb, LV_EVENT_REFR_START, NULL);
+    lv_display_add_event_cb(disp, lvgl_refr_event_cb, LV_EVENT_REFR_READY, NULL);
 
     // Register callback for "transfer done" to call lv_display_flush_ready()
     const esp_lcd_panel_io_callbacks_t cbs = {
@@ -199,30 +362,38 @@ lv_display_t *oled_display_init(int i2c_port, int sda_io, int scl_io,
     };
     esp_lcd_panel_io_register_event_callbacks(io, &cbs, disp);
 
-    // 5. Create timer to increment LVGL tick
-    const esp_timer_create_args_t tick_args = {
-        .callback = lvgl_tick_cb,
-        .name = "lvgl_tick"};
-    esp_timer_handle_t tick_tmr = NULL;
-    ESP_ERROR_CHECK(esp_timer_create(&tick_args, &tick_tmr));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(tick_tmr, LVGL_TICK_MS * 1000)); // us
-
-    // 6. Create loop task to handle LVGL
-    xTaskCreate(lvgl_task, "lvgl", LVGL_TASK_STACK, NULL, LVGL_TASK_PRIO, NULL);
+    // 5. Create the transfer task and the loop task to handle LVGL
+    xTaskCreate(oled_tx_task, "oled_tx", OLED_TX_TASK_STACK, disp, OLED_TX_TASK_PRIO, &s_tx_task);
+    xTaskCreate(lvgl_task, "lvgl", LVGL_TASK_STACK, NULL, LVGL_TASK_PRIO, &s_lvgl_task);
 
     ESP_LOGI(TAG, "OLED/LVGL initialized");
     return disp; // Return display handle for creating UI
 }
 
-void oled_display_create_basic_ui(lv_display_t *disp)
+void oled_display_create_basic_ui(oled_display_t *disp)
 {
     // Store display for UI update use
     _lock_acquire(&s_lvgl_lock);                              // Lock before call API LVGL
     lv_obj_t *scr = lv_display_get_screen_active(disp);       // Get active screen
     s_label = lv_label_create(scr);                           // Create label on screen
     lv_obj_align(s_label, LV_ALIGN_TOP_LEFT, 0, 0);           // Align to top-left
-    lv_label_set_text(s_label, "Temp: --.- C\nHum : --.- %"); // Initial text
+    lv_label_set_text(s_label, "");                           // Set below, with no reading
+    s_label_text[0] = '\0';
+    s_footer = lv_label_create(scr);
+    lv_obj_align(s_footer, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    lv_label_set_text(s_footer, "");
+    s_climate_scr = scr;
+
+    // Status screen, loaded by oled_display_show_status()
+    s_status_scr = lv_obj_create(NULL);
+    s_status_l1 = lv_label_create(s_status_scr);
+    lv_obj_align(s_status_l1, LV_ALIGN_LEFT_MID, 0, -8);
+    lv_label_set_text(s_status_l1, "");
+    s_status_l2 = lv_label_create(s_status_scr);
+    lv_obj_align(s_status_l2, LV_ALIGN_LEFT_MID, 0, 10);
+    lv_label_set_text(s_status_l2, "");
     _lock_release(&s_lvgl_lock);
+    oled_display_update(NAN, NAN);
 }
 
 void oled_display_update(float temp_c, float hum_pct)
@@ -230,10 +401,47 @@ void oled_display_update(float temp_c, float hum_pct)
     if (!s_disp || !s_label)
         return; // Not initialized yet → ignore
 
-    char buf[48];
-    snprintf(buf, sizeof(buf), "Temp: %.1f C\nHum : %.1f %%", temp_c, hum_pct);
+    char temp[16], hum[16], buf[sizeof(s_label_text)];
+    oled_screen_format_value(temp, sizeof(temp), temp_c, "C");
+    oled_screen_format_value(hum, sizeof(hum), hum_pct, "%");
+    snprintf(buf, sizeof(buf), "Temp: %s\nHum : %s", temp, hum);
+
+    _lock_acquire(&s_lvgl_lock); // Lock before call API LVGL
+    if (strcmp(buf, s_label_text) != 0)
+    {
+        // Only a real change invalidates the label and wakes the LVGL task
+        lv_label_set_text(s_label, buf); // Update label text
+        strcpy(s_label_text, buf);
+    }
+    if (lv_display_get_screen_active(s_disp) != s_climate_scr)
+        lv_screen_load(s_climate_scr);
+    _lock_release(&s_lvgl_lock);
+}
+
+void oled_display_show_status(const char *line1, const char *line2)
+{
+    if (!s_disp || !s_status_scr)
+        return; // Not initialized yet → ignore
 
-    _lock_acquire(&s_lvgl_lock);     // Lock before call API LVGL
-    lv_label_set_text(s_label, buf); // Update label text
+    _lock_acquire(&s_lvgl_lock); // Lock before call API LVGL
+    lv_label_set_text(s_status_l1, line1 ? line1 : "");
+    lv_label_set_text(s_status_l2, line2 ? line2 : "");
+    lv_label_set_text(s_footer, line2 ? line2 : "");
+    if (lv_display_get_screen_active(s_disp) != s_status_scr)
+        lv_screen_load(s_status_scr);
     _lock_release(&s_lvgl_lock);
 }
+
+esp_err_t oled_display_get_stats(oled_display_stats_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_disp)
+        return ESP_ERR_INVALID_STATE;
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    return ESP_OK;
+}
+
+#endif // CONFIG_I2C_OLED_BACKEND_LVGL
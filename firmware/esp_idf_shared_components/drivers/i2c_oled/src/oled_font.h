@@ -0,0 +1,106 @@
+#pragma once
+
+// 5x7 ASCII font (0x20..0x7E), one byte per column, LSB = top row: already
+// SSD1306 page layout, so glyphs are copied to GDDRAM as they are. Expanded
+// with X(c0, c1, c2, c3, c4) per glyph; oled_text.c builds both atlases from
+// it at compile time.
+#define OLED_FONT_FIRST 0x20
+#define OLED_FONT_LAST 0x7E
+#define OLED_FONT_COLS 5
+
+#define OLED_FONT_5X7(X) \
+    X(0x00, 0x00, 0x00, 0x00, 0x00) /* space */ \
+    X(0x00, 0x00, 0x5F, 0x00, 0x00) /* ! */ \
+    X(0x00, 0x07, 0x00, 0x07, 0x00) /* " */ \
+    X(0x14, 0x7F, 0x14, 0x7F, 0x14) /* # */ \
+    X(0x24, 0x2A, 0x7F, 0x2A, 0x12) /* $ */ \
+    X(0x23, 0x13, 0x08, 0x64, 0x62) /* % */ \
+    X(0x36, 0x49, 0x55, 0x22, 0x50) /* & */ \
+    X(0x00, 0x05, 0x03, 0x00, 0x00) /* ' */ \
+    X(0x00, 0x1C, 0x22, 0x41, 0x00) /* ( */ \
+    X(0x00, 0x41, 0x22, 0x1C, 0x00) /* ) */ \
+    X(0x08, 0x2A, 0x1C, 0x2A, 0x08) /* asterisk */ \
+    X(0x08, 0x08, 0x3E, 0x08, 0x08) /* + */ \
+    X(0x00, 0x50, 0x30, 0x00, 0x00) /* , */ \
+    X(0x08, 0x08, 0x08, 0x08, 0x08) /* - */ \
+    X(0x00, 0x60, 0x60, 0x00, 0x00) /* . */ \
+    X(0x20, 0x10, 0x08, 0x04, 0x02) /* / */ \
+    X(0x3E, 0x51, 0x49, 0x45, 0x3E) /* 0 */ \
+    X(0x00, 0x42, 0x7F, 0x40, 0x00) /* 1 */ \
+    X(0x42, 0x61, 0x51, 0x49, 0x46) /* 2 */ \
+    X(0x21, 0x41, 0x45, 0x4B, 0x31) /* 3 */ \
+    X(0x18, 0x14, 0x12, 0x7F, 0x10) /* 4 */ \
+    X(0x27, 0x45, 0x45, 0x45, 0x39) /* 5 */ \
+    X(0x3C, 0x4A, 0x49, 0x49, 0x30) /* 6 */ \
+    X(0x01, 0x71, 0x09, 0x05, 0x03) /* 7 */ \
+    X(0x36, 0x49, 0x49, 0x49, 0x36) /* 8 */ \
+    X(0x06, 0x49, 0x49, 0x29, 0x1E) /* 9 */ \
+    X(0x00, 0x36, 0x36, 0x00, 0x00) /* : */ \
+    X(0x00, 0x56, 0x36, 0x00, 0x00) /* ; */ \
+    X(0x08, 0x14, 0x22, 0x41, 0x00) /* < */ \
+    X(0x14, 0x14, 0x14, 0x14, 0x14) /* = */ \
+    X(0x00, 0x41, 0x22, 0x14, 0x08) /* > */ \
+    X(0x02, 0x01, 0x51, 0x09, 0x06) /* ? */ \
+    X(0x32, 0x49, 0x79, 0x41, 0x3E) /* @ */ \
+    X(0x7E, 0x11, 0x11, 0x11, 0x7E) /* A */ \
+    X(0x7F, 0x49, 0x49, 0x49, 0x36) /* B */ \
+    X(0x3E, 0x41, 0x41, 0x41, 0x22) /* C */ \
+    X(0x7F, 0x41, 0x41, 0x22, 0x1C) /* D */ \
+    X(0x7F, 0x49, 0x49, 0x49, 0x41) /* E */ \
+    X(0x7F, 0x09, 0x09, 0x09, 0x01) /* F */ \
+    X(0x3E, 0x41, 0x49, 0x49, 0x7A) /* G */ \
+    X(0x7F, 0x08, 0x08, 0x08, 0x7F) /* H */ \
+    X(0x00, 0x41, 0x7F, 0x41, 0x00) /* I */ \
+    X(0x20, 0x40, 0x41, 0x3F, 0x01) /* J */ \
+    X(0x7F, 0x08, 0x14, 0x22, 0x41) /* K */ \
+    X(0x7F, 0x40, 0x40, 0x40, 0x40) /* L */ \
+    X(0x7F, 0x02, 0x0C, 0x02, 0x7F) /* M */ \
+    X(0x7F, 0x04, 0x08, 0x10, 0x7F) /* N */ \
+    X(0x3E, 0x41, 0x41, 0x41, 0x3E) /* O */ \
+    X(0x7F, 0x09, 0x09, 0x09, 0x06) /* P */ \
+    X(0x3E, 0x41, 0x51, 0x21, 0x5E) /* Q */ \
+    X(0x7F, 0x09, 0x19, 0x29, 0x46) /* R */ \
+    X(0x46, 0x49, 0x49, 0x49, 0x31) /* S */ \
+    X(0x01, 0x01, 0x7F, 0x01, 0x01) /* T */ \
+    X(0x3F, 0x40, 0x40, 0x40, 0x3F) /* U */ \
+    X(0x1F, 0x20, 0x40, 0x20, 0x1F) /* V */ \
+    X(0x3F, 0x40, 0x38, 0x40, 0x3F) /* W */ \
+    X(0x63, 0x14, 0x08, 0x14, 0x63) /* X */ \
+    X(0x07, 0x08, 0x70, 0x08, 0x07) /* Y */ \
+    X(0x61, 0x51, 0x49, 0x45, 0x43) /* Z */ \
+    X(0x00, 0x7F, 0x41, 0x41, 0x00) /* [ */ \
+    X(0x02, 0x04, 0x08, 0x10, 0x20) /* backslash */ \
+    X(0x00, 0x41, 0x41, 0x7F, 0x00) /* ] */ \
+    X(0x04, 0x02, 0x01, 0x02, 0x04) /* ^ */ \
+    X(0x40, 0x40, 0x40, 0x40, 0x40) /* _ */ \
+    X(0x00, 0x01, 0x02, 0x04, 0x00) /* ` */ \
+    X(0x20, 0x54, 0x54, 0x54, 0x78) /* a */ \
+    X(0x7F, 0x48, 0x44, 0x44, 0x38) /* b */ \
+    X(0x38, 0x44, 0x44, 0x44, 0x20) /* c */ \
+    X(0x38, 0x44, 0x44, 0x48, 0x7F) /* d */ \
+    X(0x38, 0x54, 0x54, 0x54, 0x18) /* e */ \
+    X(0x08, 0x7E, 0x09, 0x01, 0x02) /* f */ \
+    X(0x0C, 0x52, 0x52, 0x52, 0x3E) /* g */ \
+    X(0x7F, 0x08, 0x04, 0x04, 0x78) /* h */ \
+    X(0x00, 0x44, 0x7D, 0x40, 0x00) /* i */ \
+    X(0x20, 0x40, 0x44, 0x3D, 0x00) /* j */ \
+    X(0x7F, 0x10, 0x28, 0x44, 0x00) /* k */ \
+    X(0x00, 0x41, 0x7F, 0x40, 0x00) /* l */ \
+    X(0x7C, 0x04, 0x18, 0x04, 0x78) /* m */ \
+    X(0x7C, 0x08, 0x04, 0x04, 0x78) /* n */ \
+    X(0x38, 0x44, 0x44, 0x44, 0x38) /* o */ \
+    X(0x7C, 0x14, 0x14, 0x14, 0x08) /* p */ \
+    X(0x08, 0x14, 0x14, 0x18, 0x7C) /* q */ \
+    X(0x7C, 0x08, 0x04, 0x04, 0x08) /* r */ \
+    X(0x48, 0x54, 0x54, 0x54, 0x20) /* s */ \
+    X(0x04, 0x3F, 0x44, 0x40, 0x20) /* t */ \
+    X(0x3C, 0x40, 0x40, 0x20, 0x7C) /* u */ \
+    X(0x1C, 0x20, 0x40, 0x20, 0x1C) /* v */ \
+    X(0x3C, 0x40, 0x30, 0x40, 0x3C) /* w */ \
+    X(0x44, 0x28, 0x10, 0x28, 0x44) /* x */ \
+    X(0x0C, 0x50, 0x50, 0x50, 0x3C) /* y */ \
+    X(0x44, 0x64, 0x54, 0x4C, 0x44) /* z */ \
+    X(0x00, 0x08, 0x36, 0x41, 0x00) /* { */ \
+    X(0x00, 0x00, 0x7F, 0x00, 0x00) /* | */ \
+    X(0x00, 0x41, 0x36, 0x08, 0x00) /* } */ \
+    X(0x08, 0x04, 0x08, 0x10, 0x08) /* ~ */
@@ -0,0 +1,164 @@
+#include "sdkconfig.h"
+#if CONFIG_I2C_OLED_BACKEND_NATIVE
+// Native backend of i2c_oled_display.h: oled_screen layouts drawn by
+// oled_text straight into a page-layout canvas, and only the changed columns
+// sent. No LVGL and no task; the calling task does the (blocking) transfer.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+#include "i2c_oled_display.h"
+#include "oled_panel.h"
+#include "oled_screen.h"
+
+static const char *TAG = "OLED";
+
+struct oled_native_display
+{
+    esp_lcd_panel_handle_t panel;
+    oled_canvas_t canvas;
+    oled_screen_t screen;
+};
+
+static struct oled_native_display s_disp;
+static bool s_ready = false;
+static SemaphoreHandle_t s_lock = NULL; // canvas, screen and the bus
+
+static oled_display_stats_t s_stats;
+
+/*========== Helpers ==========*/
+// Sends the dirty spans of the canvas; call with s_lock held
+static void flush_locked(int64_t t0)
+{
+    oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES];
+    const int n = oled_canvas_take_dirty(&s_disp.canvas, dirty);
+    const int64_t t1 = esp_timer_get_time();
+    const uint32_t render_us = (uint32_t)(t1 - t0);
+    s_stats.render_us_last = render_us;
+    if (render_us > s_stats.render_us_max)
+        s_stats.render_us_max = render_us;
+    if (n == 0)
+    {
+        s_stats.frames_skipped++;
+        return;
+    }
+
+    const int w = s_disp.canvas.width;
+    for (int p = 0; p < s_disp.canvas.height / 8; p++)
+    {
+        if (dirty[p].x0 < 0)
+            continue;
+        // One page tall, so contiguous in the canvas
+        esp_err_t err = esp_lcd_panel_draw_bitmap(s_disp.panel, dirty[p].x0, p * 8, dirty[p].x1 + 1, p * 8 + 8,
+                                                  s_disp.canvas.fb + w * p + dirty[p].x0);
+        if (err != ESP_OK)
+        {
+            // Keep the span dirty so the next update retries it
+            ESP_LOGW(TAG, "Page %d transfer failed: %s", p, esp_err_to_name(err));
+            s_disp.canvas.dirty[p] = dirty[p];
+            continue;
+        }
+        s_stats.bytes += (uint32_t)(dirty[p].x1 - dirty[p].x0 + 1);
+        s_stats.flushes++;
+    }
+    s_stats.frames++;
+
+    const uint32_t flush_us = (uint32_t)(esp_timer_get_time() - t1);
+    s_stats.flush_us_last = flush_us;
+    if (flush_us > s_stats.flush_us_max)
+        s_stats.flush_us_max = flush_us;
+}
+
+/*========== Public APIs ==========*/
+oled_display_t *oled_display_init(int i2c_port, int sda_io, int scl_io,
+                                  uint8_t i2c_addr, int width, int height)
+{
+    esp_lcd_panel_io_handle_t io = NULL;
+    ESP_ERROR_CHECK(oled_panel_open(i2c_port, sda_io, scl_io, i2c_addr, height, &io, &s_disp.panel));
+
+    uint8_t *fb = heap_caps_calloc(1, (size_t)width * height / 8, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_lock = xSemaphoreCreateMutex();
+    if (!fb || !s_lock)
+    {
+        ESP_LOGE(TAG, "Out of memory");
+        return NULL;
+    }
+    if (!oled_canvas_init(&s_disp.canvas, width, height, fb))
+    {
+        ESP_LOGE(TAG, "Unsupported panel size %dx%d", width, height);
+        return NULL;
+    }
+    oled_screen_init(&s_disp.screen, &s_disp.canvas);
+
+    // Panel RAM is random after power up: the canvas starts all dirty
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    flush_locked(esp_timer_get_time());
+    xSemaphoreGive(s_lock);
+    s_ready = true;
+
+    ESP_LOGI(TAG, "OLED/native renderer initialized (%u B font atlas)", (unsigned)oled_font_atlas_bytes());
+    return &s_disp;
+}
+
+void oled_display_create_basic_ui(oled_display_t *disp)
+{
+    (void)disp;
+    if (!s_ready)
+        return;
+    oled_display_update(NAN, NAN);
+}
+
+void oled_display_update(float temp_c, float hum_pct)
+{
+    if (!s_ready)
+        return; // Not initialized yet → ignore
+
+    char temp[16], hum[16];
+    oled_screen_format_value(temp, sizeof(temp), temp_c, "C");
+    oled_screen_format_value(hum, sizeof(hum), hum_pct, "%");
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const int64_t t0 = esp_timer_get_time();
+    // Unchanged text redraws to the same bytes, so nothing becomes dirty
+    oled_screen_set(&s_disp.screen, OLED_FIELD_TEMP, temp);
+    oled_screen_set(&s_disp.screen, OLED_FIELD_HUM, hum);
+    oled_screen_show(&s_disp.screen, OLED_SCREEN_CLIMATE);
+    flush_locked(t0);
+    xSemaphoreGive(s_lock);
+}
+
+void oled_display_show_status(const char *line1, const char *line2)
+{
+    if (!s_ready)
+        return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const int64_t t0 = esp_timer_get_time();
+    oled_screen_set(&s_disp.screen, OLED_FIELD_LINE1, line1);
+    oled_screen_set(&s_disp.screen, OLED_FIELD_LINE2, line2);
+    oled_screen_set(&s_disp.screen, OLED_FIELD_FOOTER, line2);
+    oled_screen_show(&s_disp.screen, OLED_SCREEN_STATUS);
+    flush_locked(t0);
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t oled_display_get_stats(oled_display_stats_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_ready)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+#endif // CONFIG_I2C_OLED_BACKEND_NATIVE
@@ -0,0 +1,107 @@
+#include <string.h>
+
+#include "oled_pack.h"
+
+/*========== 8x8 transpose ==========*/
+// Bit 8*r + b of the word is bit b of row r; three swap steps (2x2, 4x4,
+// 8x8 blocks) move it to bit 8*b + r. See Hacker's Delight, 7-3.
+static inline uint64_t transpose8(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+static inline uint64_t load_rows(const uint8_t *p, size_t stride)
+{
+    uint64_t x = 0;
+    for (int r = 0; r < 8; r++)
+        x |= (uint64_t)p[r * stride] << (8 * r);
+    return x;
+}
+
+static inline void store_cols(uint64_t t, uint8_t *cols)
+{
+    // Byte b holds bit b of each row, and bit 7 is the left column
+    t = ~t;
+    for (int c = 0; c < 8; c++)
+        cols[c] = (uint8_t)(t >> (8 * (7 - c)));
+}
+
+void oled_pack_block(const uint8_t rows[8], uint8_t cols[8])
+{
+    store_cols(transpose8(load_rows(rows, 1)), cols);
+}
+
+/*========== Shadow framebuffer ==========*/
+bool oled_shadow_init(oled_shadow_t *sh, int width, int height, uint8_t *fb)
+{
+    if (!sh || !fb || width <= 0 || height <= 0 || (width & 7) || (height & 7) ||
+        height > 8 * OLED_PACK_MAX_PAGES)
+        return false;
+    sh->width = width;
+    sh->height = height;
+    sh->fb = fb;
+    sh->valid = false;
+    memset(fb, 0, (size_t)width * height / 8);
+    return true;
+}
+
+void oled_shadow_invalidate(oled_shadow_t *sh)
+{
+    sh->valid = false;
+}
+
+int oled_shadow_update(oled_shadow_t *sh, const uint8_t *px, size_t stride, int x1, int y1, int x2, int y2,
+                       oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES])
+{
+    const int pages = sh->height / 8;
+    for (int p = 0; p < pages; p++)
+        dirty[p].x0 = dirty[p].x1 = -1;
+
+    if (x1 < 0 || y1 < 0 || x2 >= sh->width || y2 >= sh->height || x1 > x2 || y1 > y2 || (x1 & 7) ||
+        (y1 & 7) || ((x2 + 1) & 7) || ((y2 + 1) & 7))
+        return -1;
+
+    // Panel RAM unknown: send the whole area
+    const bool known = sh->valid;
+
+    int n_dirty = 0;
+    for (int p = y1 / 8; p <= y2 / 8; p++)
+    {
+        const uint8_t *src = px + (size_t)(p - y1 / 8) * 8 * stride;
+        uint8_t *dst = sh->fb + (size_t)p * sh->width;
+        int x0 = -1, xl = -1;
+        for (int bx = x1 / 8; bx <= x2 / 8; bx++)
+        {
+            uint8_t cols[8];
+            store_cols(transpose8(load_rows(src + (bx - x1 / 8), stride)), cols);
+            // Compare the block as one word before touching single bytes
+            if (known && !memcmp(dst + bx * 8, cols, 8))
+                continue;
+            for (int c = 0; c < 8; c++)
+            {
+                if (known && dst[bx * 8 + c] == cols[c])
+                    continue;
+                if (x0 < 0)
+                    x0 = bx * 8 + c;
+                xl = bx * 8 + c;
+            }
+            memcpy(dst + bx * 8, cols, 8);
+        }
+        if (x0 >= 0)
+        {
+            dirty[p].x0 = (int16_t)x0;
+            dirty[p].x1 = (int16_t)xl;
+            n_dirty++;
+        }
+    }
+    if (x1 == 0 && y1 == 0 && x2 == sh->width - 1 && y2 == sh->height - 1)
+        sh->valid = true;
+    return n_dirty;
+}
@@ -0,0 +1,51 @@
+#include "esp_check.h"
+#include "driver/i2c_master.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_lcd_panel_vendor.h"
+#include "oled_panel.h"
+
+static const char *TAG = "OLED";
+
+esp_err_t oled_panel_open(int i2c_port, int sda_io, int scl_io, uint8_t i2c_addr, int height,
+                          esp_lcd_panel_io_handle_t *io_out, esp_lcd_panel_handle_t *panel_out)
+{
+    // 1. Configure I2C bus
+    i2c_master_bus_handle_t i2c_bus = NULL;
+    i2c_master_bus_config_t bus_cfg = {
+        .clk_source = I2C_CLK_SRC_DEFAULT, // Use default clock source
+        .glitch_ignore_cnt = 7,            // Ignore glitches < 7 cycles
+        .i2c_port = i2c_port,              // I2C port number
+        .sda_io_num = sda_io,              // GPIO SDA
+        .scl_io_num = scl_io,              // GPIO SCL
+        .flags.enable_internal_pullup = true,
+    };
+    ESP_RETURN_ON_ERROR(i2c_new_master_bus(&bus_cfg, &i2c_bus), TAG, "I2C bus");
+
+    // 2. Configure panel IO for SSD1306
+    esp_lcd_panel_io_i2c_config_t io_cfg = {
+        .dev_addr = i2c_addr,
+        .scl_speed_hz = 400 * 1000, // 400kHz
+        .control_phase_bytes = 1,   // According to datasheet SSD1306
+        .lcd_cmd_bits = 8,          // 8-bit Command
+        .lcd_param_bits = 8,        // 8-bit Parameter
+        .dc_bit_offset = 6,         // According datasheet SSD1306
+    };
+    ESP_RETURN_ON_ERROR(esp_lcd_new_panel_io_i2c(i2c_bus, &io_cfg, io_out), TAG, "panel IO");
+
+    // 3. Configure panel for SSD1306
+    esp_lcd_panel_dev_config_t panel_cfg = {
+        .bits_per_pixel = 1,  // 1 bit per pixel (monochrome)
+        .reset_gpio_num = -1, // if not used
+    };
+    esp_lcd_panel_ssd1306_config_t vendor_cfg = {
+        .height = height, // 64 or 32
+    };
+    panel_cfg.vendor_config = &vendor_cfg;
+
+    ESP_RETURN_ON_ERROR(esp_lcd_new_panel_ssd1306(*io_out, &panel_cfg, panel_out), TAG, "SSD1306 panel");
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_reset(*panel_out), TAG, "reset");          // Reset panel
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_init(*panel_out), TAG, "init");            // Init panel
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_disp_on_off(*panel_out, true), TAG, "on"); // Turn on display
+    return ESP_OK;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_lcd_panel_io.h"
+
+// I2C bus, panel IO and SSD1306 panel bring-up shared by both backends
+esp_err_t oled_panel_open(int i2c_port, int sda_io, int scl_io, uint8_t i2c_addr, int height,
+                          esp_lcd_panel_io_handle_t *io_out, esp_lcd_panel_handle_t *panel_out);
@@ -0,0 +1,100 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "oled_screen.h"
+
+#define ARRAY_LEN(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+/*========== Layouts ==========*/
+// 128x64: values in the large font next to small captions
+static const oled_layout_item_t s_status_64[] = {
+    {OLED_FIELD_LINE1, 0, 2, OLED_FONT_LARGE, 10, NULL},
+    {OLED_FIELD_LINE2, 0, 5, OLED_FONT_SMALL, 21, NULL},
+};
+
+static const oled_layout_item_t s_climate_64[] = {
+    {OLED_FIELD_CAPTION, 0, 0, OLED_FONT_SMALL, 4, "Temp"},
+    {OLED_FIELD_TEMP, 32, 0, OLED_FONT_LARGE, 8, NULL},
+    {OLED_FIELD_CAPTION, 0, 3, OLED_FONT_SMALL, 4, "Hum"},
+    {OLED_FIELD_HUM, 32, 3, OLED_FONT_LARGE, 8, NULL},
+    {OLED_FIELD_FOOTER, 0, 7, OLED_FONT_SMALL, 21, NULL},
+};
+
+// 128x32: one page per line
+static const oled_layout_item_t s_status_32[] = {
+    {OLED_FIELD_LINE1, 0, 0, OLED_FONT_LARGE, 10, NULL},
+    {OLED_FIELD_LINE2, 0, 3, OLED_FONT_SMALL, 21, NULL},
+};
+
+static const oled_layout_item_t s_climate_32[] = {
+    {OLED_FIELD_CAPTION, 0, 0, OLED_FONT_SMALL, 6, "Temp: "},
+    {OLED_FIELD_TEMP, 36, 0, OLED_FONT_SMALL, 15, NULL},
+    {OLED_FIELD_CAPTION, 0, 1, OLED_FONT_SMALL, 6, "Hum : "},
+    {OLED_FIELD_HUM, 36, 1, OLED_FONT_SMALL, 15, NULL},
+    {OLED_FIELD_FOOTER, 0, 3, OLED_FONT_SMALL, 21, NULL},
+};
+
+static const oled_layout_t s_layouts_64[OLED_SCREEN_COUNT] = {
+    [OLED_SCREEN_STATUS] = {s_status_64, ARRAY_LEN(s_status_64)},
+    [OLED_SCREEN_CLIMATE] = {s_climate_64, ARRAY_LEN(s_climate_64)},
+};
+
+static const oled_layout_t s_layouts_32[OLED_SCREEN_COUNT] = {
+    [OLED_SCREEN_STATUS] = {s_status_32, ARRAY_LEN(s_status_32)},
+    [OLED_SCREEN_CLIMATE] = {s_climate_32, ARRAY_LEN(s_climate_32)},
+};
+
+const oled_layout_t *oled_screen_layout(oled_screen_id_t id, int height)
+{
+    if ((int)id < 0 || id >= OLED_SCREEN_COUNT)
+        return NULL;
+    return height >= 64 ? &s_layouts_64[id] : &s_layouts_32[id];
+}
+
+/*========== Rendering ==========*/
+static void draw_item(oled_screen_t *s, const oled_layout_item_t *it)
+{
+    const char *text = it->field == OLED_FIELD_CAPTION ? it->caption : s->text[it->field];
+    oled_canvas_text(s->cv, it->x, it->page, (oled_font_t)it->font, text, it->cells);
+}
+
+void oled_screen_init(oled_screen_t *s, oled_canvas_t *cv)
+{
+    memset(s, 0, sizeof(*s));
+    s->cv = cv;
+    s->shown = -1;
+}
+
+void oled_screen_set(oled_screen_t *s, oled_field_t field, const char *text)
+{
+    if ((int)field < 0 || field >= OLED_FIELD_COUNT)
+        return;
+    snprintf(s->text[field], sizeof(s->text[field]), "%s", text ? text : "");
+
+    if (s->shown < 0)
+        return;
+    const oled_layout_t *l = oled_screen_layout((oled_screen_id_t)s->shown, s->cv->height);
+    for (int i = 0; i < l->count; i++)
+        if (l->items[i].field == (int8_t)field)
+            draw_item(s, &l->items[i]);
+}
+
+void oled_screen_show(oled_screen_t *s, oled_screen_id_t id)
+{
+    const oled_layout_t *l = oled_screen_layout(id, s->cv->height);
+    if (!l || s->shown == (int)id)
+        return;
+    oled_canvas_clear(s->cv);
+    for (int i = 0; i < l->count; i++)
+        draw_item(s, &l->items[i]);
+    s->shown = (int)id;
+}
+
+void oled_screen_format_value(char *buf, size_t len, float v, const char *unit)
+{
+    if (!isfinite(v))
+        snprintf(buf, len, "--.- %s", unit);
+    else
+        snprintf(buf, len, "%.1f %s", v, unit);
+}
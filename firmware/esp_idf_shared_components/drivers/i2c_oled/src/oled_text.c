@@ -0,0 +1,138 @@
+#include <string.h>
+
+#include "oled_font.h"
+#include "oled_text.h"
+
+#define SMALL_CELL_W 6
+#define LARGE_CELL_W 12
+#define FONT_GLYPHS (OLED_FONT_LAST - OLED_FONT_FIRST + 1)
+
+/*========== Atlases ==========*/
+// Small: the 5 font columns plus one blank spacing column
+#define SMALL_GLYPH(c0, c1, c2, c3, c4) {c0, c1, c2, c3, c4, 0},
+static const uint8_t s_small[FONT_GLYPHS][SMALL_CELL_W] = {OLED_FONT_5X7(SMALL_GLYPH)};
+
+// Large: every column doubled in width, and every bit doubled in height,
+// which splits a column byte into a top page (bits 0-3) and a bottom page
+// (bits 4-7)
+#define DBL4(n) ((((n) & 1) ? 0x03 : 0) | (((n) & 2) ? 0x0C : 0) | (((n) & 4) ? 0x30 : 0) | (((n) & 8) ? 0xC0 : 0))
+#define TOP(c) DBL4((c) & 0x0F), DBL4((c) & 0x0F)
+#define BOT(c) DBL4((c) >> 4), DBL4((c) >> 4)
+#define LARGE_GLYPH(c0, c1, c2, c3, c4)                                                                                \
+    {{TOP(c0), TOP(c1), TOP(c2), TOP(c3), TOP(c4), 0, 0}, {BOT(c0), BOT(c1), BOT(c2), BOT(c3), BOT(c4), 0, 0}},
+static const uint8_t s_large[FONT_GLYPHS][2][LARGE_CELL_W] = {OLED_FONT_5X7(LARGE_GLYPH)};
+
+static const uint8_t s_blank[LARGE_CELL_W];
+
+int oled_font_cell_width(oled_font_t font)
+{
+    return font == OLED_FONT_LARGE ? LARGE_CELL_W : SMALL_CELL_W;
+}
+
+int oled_font_pages(oled_font_t font)
+{
+    return font == OLED_FONT_LARGE ? 2 : 1;
+}
+
+size_t oled_font_atlas_bytes(void)
+{
+    return sizeof(s_small) + sizeof(s_large);
+}
+
+static int glyph_index(char c)
+{
+    const unsigned char u = (unsigned char)c;
+    if (u < OLED_FONT_FIRST || u > OLED_FONT_LAST)
+        return '?' - OLED_FONT_FIRST;
+    return u - OLED_FONT_FIRST;
+}
+
+/*========== Canvas ==========*/
+static void mark_dirty(oled_canvas_t *cv, int page, int x0, int x1)
+{
+    oled_dirty_span_t *d = &cv->dirty[page];
+    if (d->x0 < 0 || x0 < d->x0)
+        d->x0 = (int16_t)x0;
+    if (x1 > d->x1)
+        d->x1 = (int16_t)x1;
+}
+
+// Copies `n` columns into the canvas at (x, page), keeping the changed range
+static int put_cols(oled_canvas_t *cv, int x, int page, const uint8_t *cols, int n)
+{
+    if (x + n > cv->width)
+        n = cv->width - x;
+    uint8_t *dst = cv->fb + (size_t)page * cv->width + x;
+    int first = -1, last = -1, changed = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (dst[i] == cols[i])
+            continue;
+        dst[i] = cols[i];
+        if (first < 0)
+            first = i;
+        last = i;
+        changed++;
+    }
+    if (changed)
+        mark_dirty(cv, page, x + first, x + last);
+    return changed;
+}
+
+bool oled_canvas_init(oled_canvas_t *cv, int width, int height, uint8_t *fb)
+{
+    if (!cv || !fb || width <= 0 || height <= 0 || (width & 7) || (height & 7) ||
+        height > 8 * OLED_PACK_MAX_PAGES)
+        return false;
+    cv->width = width;
+    cv->height = height;
+    cv->fb = fb;
+    memset(fb, 0, (size_t)width * height / 8);
+    for (int p = 0; p < OLED_PACK_MAX_PAGES; p++)
+    {
+        cv->dirty[p].x0 = p < height / 8 ? 0 : -1;
+        cv->dirty[p].x1 = p < height / 8 ? (int16_t)(width - 1) : -1;
+    }
+    return true;
+}
+
+void oled_canvas_clear(oled_canvas_t *cv)
+{
+    for (int p = 0; p < cv->height / 8; p++)
+        for (int x = 0; x < cv->width; x += LARGE_CELL_W)
+            put_cols(cv, x, p, s_blank, LARGE_CELL_W);
+}
+
+int oled_canvas_text(oled_canvas_t *cv, int x, int page, oled_font_t font, const char *text, int cells)
+{
+    const int cell_w = oled_font_cell_width(font);
+    const int pages = oled_font_pages(font);
+    if (x < 0 || page < 0)
+        return 0;
+
+    int changed = 0;
+    for (int i = 0; i < cells && x < cv->width; i++, x += cell_w)
+    {
+        const char c = (text && *text) ? *text++ : ' ';
+        const int g = glyph_index(c);
+        for (int p = 0; p < pages && page + p < cv->height / 8; p++)
+        {
+            const uint8_t *cols = font == OLED_FONT_LARGE ? s_large[g][p] : s_small[g];
+            changed += put_cols(cv, x, page + p, cols, cell_w);
+        }
+    }
+    return changed;
+}
+
+int oled_canvas_take_dirty(oled_canvas_t *cv, oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES])
+{
+    int n = 0;
+    for (int p = 0; p < OLED_PACK_MAX_PAGES; p++)
+    {
+        dirty[p] = cv->dirty[p];
+        if (dirty[p].x0 >= 0)
+            n++;
+        cv->dirty[p].x0 = cv->dirty[p].x1 = -1;
+    }
+    return n;
+}
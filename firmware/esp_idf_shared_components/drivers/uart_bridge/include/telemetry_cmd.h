@@ -0,0 +1,146 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry_frame.h"
+
+// Request/response channel multiplexed with the sample frames of the
+// uart_bridge link. Plain C like telemetry_frame.c: the node runs the
+// server, host_tools/telemetry_link the client.
+//
+//   REQUEST body:   varint msg_id, u8 cmd, args
+//   RESPONSE body:  varint msg_id, u8 cmd, u8 status, result
+//
+// The response is the acknowledgement. The host resends a request with the
+// same msg_id when no response arrives in time; the server answers a resend
+// of the last request from its cache instead of running the command again.
+// msg_id 0 is reserved.
+//
+// Args and results are lists of varints, in the order given per command
+// below. A 0 argument to SET_RATES leaves that rate unchanged.
+//
+//   PING               args: any            result: args echoed
+//   SET_RATES          args: uart_interval_ms, sample_period_ms
+//                      result: uart_interval_ms, sample_period_ms (applied)
+//   GET_STATS          result: see telemetry_cmd_stat_t
+//   DUMP_HISTORY       args: from_seq, max_count
+//                      result: varint next_seq, then a sample list
+//                      (telemetry_frame_put_samples) of readings >= from_seq
+//   START_PROVISIONING result: none
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TELEMETRY_CMD_MAX_ARGS 8
+// Largest history page, sized so a response stays around 1 KB
+#define TELEMETRY_CMD_MAX_HISTORY 32
+// DUMP_HISTORY result of n samples: next_seq, then the sample list
+#define TELEMETRY_CMD_HISTORY_RESULT_SIZE(n) (TELEMETRY_FRAME_VARINT_MAX(32) + TELEMETRY_FRAME_SAMPLES_SIZE(n))
+#define TELEMETRY_CMD_MAX_RESULT TELEMETRY_CMD_HISTORY_RESULT_SIZE(TELEMETRY_CMD_MAX_HISTORY)
+// Request payloads are small; anything longer is not a request
+#define TELEMETRY_CMD_MAX_REQUEST_PAYLOAD (TELEMETRY_FRAME_BODY_OFFSET + 8 + TELEMETRY_CMD_MAX_ARGS * 10)
+#define TELEMETRY_CMD_MAX_RESPONSE_PAYLOAD (TELEMETRY_FRAME_BODY_OFFSET + 8 + TELEMETRY_CMD_MAX_RESULT)
+
+    typedef enum
+    {
+        TELEMETRY_CMD_PING = 0,
+        TELEMETRY_CMD_SET_RATES = 1,
+        TELEMETRY_CMD_GET_STATS = 2,
+        TELEMETRY_CMD_DUMP_HISTORY = 3,
+        TELEMETRY_CMD_START_PROVISIONING = 4,
+    } telemetry_cmd_t;
+
+    typedef enum
+    {
+        TELEMETRY_STATUS_OK = 0,
+        TELEMETRY_STATUS_UNKNOWN_CMD,
+        TELEMETRY_STATUS_BAD_ARGS,
+        TELEMETRY_STATUS_UNAVAILABLE, // not supported on this node, or busy
+        TELEMETRY_STATUS_FAILED,
+    } telemetry_status_t;
+
+    // Result fields of GET_STATS
+    typedef enum
+    {
+        TELEMETRY_STAT_UPTIME_MS = 0,
+        TELEMETRY_STAT_FRAMES,
+        TELEMETRY_STAT_SAMPLES,
+        TELEMETRY_STAT_BYTES,
+        TELEMETRY_STAT_DROPPED,
+        TELEMETRY_STAT_REQUESTS,
+        TELEMETRY_STAT_BAD_REQUESTS,
+        TELEMETRY_STAT_UART_INTERVAL_MS,
+        TELEMETRY_STAT_SAMPLE_PERIOD_MS,
+        TELEMETRY_STAT_COUNT
+    } telemetry_cmd_stat_t;
+
+    /*========== Messages ==========*/
+    // Body of a REQUEST frame. Returns its length, 0 if `cap` is too small.
+    size_t telemetry_cmd_put_request(uint32_t msg_id, uint8_t cmd, const uint64_t *args, size_t n_args,
+                                     uint8_t *out, size_t cap);
+
+    typedef struct
+    {
+        uint32_t msg_id;
+        uint8_t cmd;
+        uint8_t status;       // responses only
+        const uint8_t *data;  // args / result, points into the frame
+        size_t data_len;
+    } telemetry_cmd_msg_t;
+
+    bool telemetry_cmd_parse_request(const telemetry_frame_view_t *view, telemetry_cmd_msg_t *out);
+    bool telemetry_cmd_parse_response(const telemetry_frame_view_t *view, telemetry_cmd_msg_t *out);
+
+    // Varint list of args/results. Returns the number of values, -1 if
+    // malformed or longer than `cap`.
+    int telemetry_cmd_get_values(const uint8_t *in, size_t len, uint64_t *out, size_t cap);
+    // Returns bytes written (n * 10 at most)
+    size_t telemetry_cmd_put_values(const uint64_t *values, size_t n, uint8_t *out);
+
+    /*========== Server (node side) ==========*/
+    // Runs one command: writes the result into `result` (up to `cap`) and
+    // its length into `result_len`.
+    typedef telemetry_status_t (*telemetry_cmd_handler_t)(uint8_t cmd, const uint64_t *args, size_t n_args,
+                                                          uint8_t *result, size_t cap, size_t *result_len,
+                                                          void *ctx);
+    // Writes one encoded frame to the link
+    typedef void (*telemetry_cmd_write_t)(const uint8_t *data, size_t len, void *ctx);
+
+    typedef struct
+    {
+        const char *device_id;
+        telemetry_cmd_handler_t handler;
+        void *handler_ctx;
+        telemetry_cmd_write_t write;
+        void *write_ctx;
+    } telemetry_cmd_server_config_t;
+
+    typedef struct
+    {
+        telemetry_cmd_server_config_t cfg;
+        uint32_t requests;     // valid requests handled
+        uint32_t bad_requests; // COBS/CRC/format errors and overruns
+        uint32_t duplicates;   // resends answered from the cache
+
+        uint32_t frame_seq;
+        uint8_t rx[TELEMETRY_FRAME_MAX_WIRE(TELEMETRY_CMD_MAX_REQUEST_PAYLOAD)];
+        size_t rx_len;
+        bool rx_overrun; // dropping bytes until the next delimiter
+        uint8_t payload[TELEMETRY_CMD_MAX_RESPONSE_PAYLOAD];
+        // Last response as sent, replayed on a resend of its request
+        bool have_last;
+        uint32_t last_msg_id;
+        uint8_t last_wire[TELEMETRY_FRAME_MAX_WIRE(TELEMETRY_CMD_MAX_RESPONSE_PAYLOAD)];
+        size_t last_wire_len;
+    } telemetry_cmd_server_t;
+
+    void telemetry_cmd_server_init(telemetry_cmd_server_t *srv, const telemetry_cmd_server_config_t *cfg);
+    // Bytes from the link in any split; handles every complete request
+    void telemetry_cmd_server_feed(telemetry_cmd_server_t *srv, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary telemetry frames of the uart_bridge link. Plain C with no ESP-IDF
+// dependency: host_tools/telemetry_link compiles this file as-is.
+//
+// On the wire every frame is COBS encoded between 0x00 delimiters, so the
+// receiver can resync after noise or console output. Decoded payload:
+//
+//   u8      version (TELEMETRY_FRAME_VERSION)
+//   u8      type (telemetry_frame_type_t)
+//   u8      device id length, then the id bytes (no terminator)
+//   varint  frame seq
+//   ...     type specific body
+//   u16     CRC-16/CCITT-FALSE (LE) of everything before it
+//
+// TELEMETRY_FRAME_SAMPLES body, delta coded against the previous sample:
+//   varint  count
+//   varint  seq,  varint ts_us,  zigzag temp_dc,  zigzag hum_dpct   (first)
+//   varint  dseq, zigzag dts_us, zigzag dtemp,    zigzag dhum       (rest)
+//
+// REQUEST / RESPONSE frames carry the command channel, see telemetry_cmd.h.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_FRAME_DELIMITER 0x00
+#define TELEMETRY_FRAME_MAX_DEVICE_ID 31
+#define TELEMETRY_FRAME_MAX_SAMPLES 64
+
+// Longest varint of a value of `bits` bits
+#define TELEMETRY_FRAME_VARINT_MAX(bits) (((bits) + 6) / 7)
+// Longest coded sample: seq or dseq (32 bits), ts_us or its zigzag delta
+// (64), then temp and hum as zigzag deltas of 32 bit values (33)
+#define TELEMETRY_FRAME_MAX_SAMPLE_BYTES                                                         \
+    (TELEMETRY_FRAME_VARINT_MAX(32) + TELEMETRY_FRAME_VARINT_MAX(64) + 2 * TELEMETRY_FRAME_VARINT_MAX(33))
+// Sample list bound: the count (below 2^32), then n samples
+#define TELEMETRY_FRAME_SAMPLES_SIZE(n) (TELEMETRY_FRAME_VARINT_MAX(32) + (n) * TELEMETRY_FRAME_MAX_SAMPLE_BYTES)
+// Header + CRC bound; also where a body may be built in place, see
+// telemetry_frame_build()
+#define TELEMETRY_FRAME_BODY_OFFSET 48
+// Payload bound for a batch of n samples
+#define TELEMETRY_FRAME_MAX_PAYLOAD(n) (TELEMETRY_FRAME_BODY_OFFSET + TELEMETRY_FRAME_SAMPLES_SIZE(n))
+// Encoded frame bound: COBS overhead plus both delimiters
+#define TELEMETRY_FRAME_MAX_WIRE(payload) ((payload) + (payload) / 254 + 3)
+
+    typedef enum
+    {
+        TELEMETRY_FRAME_SAMPLES = 1,
+        TELEMETRY_FRAME_REQUEST = 2,  // host -> node
+        TELEMETRY_FRAME_RESPONSE = 3, // node -> host
+    } telemetry_frame_type_t;
+
+    typedef struct
+    {
+        uint32_t seq;      // publish counter at the source, gaps = lost samples
+        int64_t ts_us;     // source timestamp (esp_timer)
+        int32_t temp_dc;   // tenths of degree C
+        int32_t hum_dpct;  // tenths of %RH
+    } telemetry_sample_t;
+
+    // Parsed frame header; `body` points into the payload buffer
+    typedef struct
+    {
+        uint8_t type;
+        char device_id[TELEMETRY_FRAME_MAX_DEVICE_ID + 1];
+        uint32_t frame_seq;
+        const uint8_t *body;
+        size_t body_len;
+    } telemetry_frame_view_t;
+
+    /*========== Primitives ==========*/
+    uint16_t telemetry_frame_crc16(const uint8_t *data, size_t len);
+    // Returns bytes written (<= 10)
+    size_t telemetry_frame_put_varint(uint8_t *out, uint64_t v);
+    // Returns bytes consumed, 0 on truncated/overlong input
+    size_t telemetry_frame_get_varint(const uint8_t *in, size_t len, uint64_t *v);
+
+    // `out` needs TELEMETRY_FRAME_MAX_WIRE(len) bytes. Writes the leading
+    // and trailing delimiter. Returns bytes written.
+    size_t telemetry_frame_cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+    // Decodes one frame without delimiters. Returns decoded length, 0 on error.
+    size_t telemetry_frame_cobs_decode(const uint8_t *in, size_t len, uint8_t *out);
+
+    /*========== Frames ==========*/
+    // Builds a payload of any type around `body` (with CRC). `body` may sit
+    // in `out` at TELEMETRY_FRAME_BODY_OFFSET or later to skip a copy.
+    // Returns the length, 0 if it does not fit `cap` or the arguments are invalid.
+    size_t telemetry_frame_build(uint8_t type, const char *device_id, uint32_t frame_seq,
+                                 const uint8_t *body, size_t body_len, uint8_t *out, size_t cap);
+
+    // Builds a SAMPLES payload (with CRC). Returns its length, 0 if it does
+    // not fit `cap` or the arguments are invalid.
+    size_t telemetry_frame_build_samples(const char *device_id, uint32_t frame_seq,
+                                         const telemetry_sample_t *samples, size_t count,
+                                         uint8_t *out, size_t cap);
+
+    // Checks version and CRC and parses the header
+    bool telemetry_frame_parse(const uint8_t *payload, size_t len, telemetry_frame_view_t *view);
+
+    // Decodes the body of a SAMPLES frame into `out` (up to `cap` samples).
+    // Returns the number of samples, -1 on a malformed body.
+    int telemetry_frame_read_samples(const telemetry_frame_view_t *view, telemetry_sample_t *out, size_t cap);
+
+    // The delta coded sample list on its own, as embedded in SAMPLES frames
+    // and history responses. `out` needs TELEMETRY_FRAME_SAMPLES_SIZE(count)
+    // bytes; returns bytes written.
+    size_t telemetry_frame_put_samples(const telemetry_sample_t *samples, size_t count, uint8_t *out);
+    // Must consume `len` exactly. Returns the number of samples, -1 on error.
+    int telemetry_frame_get_samples(const uint8_t *in, size_t len, telemetry_sample_t *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
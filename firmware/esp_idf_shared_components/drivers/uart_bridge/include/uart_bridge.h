@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -6,9 +7,36 @@ extern "C"
 {
 #endif
 
-    // Start uart_bridge_task, print JSON line to stdout (UART) every interval_ms
+    typedef struct
+    {
+        uint32_t frames;  // binary frames written (JSON lines in console mode)
+        uint32_t samples; // readings sent
+        uint32_t bytes;   // bytes handed to the UART driver
+        uint32_t dropped; // readings never sent (queue full, or superseded in console mode)
+    } uart_bridge_stats_t;
+
+    // Start uart_bridge_task, fed by climate readings from the event bus.
+    // Console transport: one JSON line on stdout per reading, at most one
+    // every interval_ms. Binary transport: batched frames on the dedicated
+    // UART, a batch is flushed when full or interval_ms after its first sample,
+    // and the host can send commands back (telemetry_cmd.h).
     esp_err_t uart_bridge_start(int interval_ms);
 
+    esp_err_t uart_bridge_get_stats(uart_bridge_stats_t *out);
+
+    // What the command channel (binary transport, telemetry_cmd.h) can
+    // change outside the bridge. A NULL hook answers "unavailable".
+    typedef struct
+    {
+        esp_err_t (*set_sample_period)(uint32_t period_ms, void *ctx);
+        uint32_t (*get_sample_period)(void *ctx);
+        esp_err_t (*start_provisioning)(void *ctx);
+        void *ctx;
+    } uart_bridge_cmd_hooks_t;
+
+    // Copies `hooks` (NULL clears them). No effect in console mode.
+    void uart_bridge_set_cmd_hooks(const uart_bridge_cmd_hooks_t *hooks);
+
 #ifdef __cplusplus
 }
 #endif
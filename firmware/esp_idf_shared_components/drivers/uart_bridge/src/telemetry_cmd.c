@@ -0,0 +1,165 @@
+#include <string.h>
+
+#include "telemetry_cmd.h"
+
+/*========== Messages ==========*/
+size_t telemetry_cmd_put_values(const uint64_t *values, size_t n, uint8_t *out)
+{
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++)
+        len += telemetry_frame_put_varint(out + len, values[i]);
+    return len;
+}
+
+int telemetry_cmd_get_values(const uint8_t *in, size_t len, uint64_t *out, size_t cap)
+{
+    size_t n = 0;
+    while (len)
+    {
+        uint64_t v;
+        const size_t used = telemetry_frame_get_varint(in, len, &v);
+        if (!used || n == cap)
+            return -1;
+        out[n++] = v;
+        in += used;
+        len -= used;
+    }
+    return (int)n;
+}
+
+size_t telemetry_cmd_put_request(uint32_t msg_id, uint8_t cmd, const uint64_t *args, size_t n_args,
+                                 uint8_t *out, size_t cap)
+{
+    if (n_args > TELEMETRY_CMD_MAX_ARGS || cap < 6 + n_args * 10)
+        return 0;
+    size_t n = telemetry_frame_put_varint(out, msg_id);
+    out[n++] = cmd;
+    return n + telemetry_cmd_put_values(args, n_args, out + n);
+}
+
+// msg_id, cmd and (responses) status in front of the data
+static bool parse_msg(const telemetry_frame_view_t *view, bool response, telemetry_cmd_msg_t *out)
+{
+    uint64_t id;
+    const size_t used = telemetry_frame_get_varint(view->body, view->body_len, &id);
+    const size_t head = used + (response ? 2 : 1);
+    if (!used || id == 0 || id > UINT32_MAX || view->body_len < head)
+        return false;
+    out->msg_id = (uint32_t)id;
+    out->cmd = view->body[used];
+    out->status = response ? view->body[used + 1] : TELEMETRY_STATUS_OK;
+    out->data = view->body + head;
+    out->data_len = view->body_len - head;
+    return true;
+}
+
+bool telemetry_cmd_parse_request(const telemetry_frame_view_t *view, telemetry_cmd_msg_t *out)
+{
+    return view->type == TELEMETRY_FRAME_REQUEST && parse_msg(view, false, out);
+}
+
+bool telemetry_cmd_parse_response(const telemetry_frame_view_t *view, telemetry_cmd_msg_t *out)
+{
+    return view->type == TELEMETRY_FRAME_RESPONSE && parse_msg(view, true, out);
+}
+
+/*========== Server ==========*/
+void telemetry_cmd_server_init(telemetry_cmd_server_t *srv, const telemetry_cmd_server_config_t *cfg)
+{
+    memset(srv, 0, sizeof(*srv));
+    srv->cfg = *cfg;
+}
+
+static void respond(telemetry_cmd_server_t *srv, const telemetry_cmd_msg_t *req, telemetry_status_t status,
+                    size_t result_len)
+{
+    // Body is built in place behind the header room, see telemetry_frame_build()
+    uint8_t *body = srv->payload + TELEMETRY_FRAME_BODY_OFFSET;
+    uint8_t head[7];
+    size_t head_len = telemetry_frame_put_varint(head, req->msg_id);
+    head[head_len++] = req->cmd;
+    head[head_len++] = (uint8_t)status;
+    if (status != TELEMETRY_STATUS_OK)
+        result_len = 0;
+    // The handler wrote its result at body + sizeof(head); close the gap
+    memmove(body + head_len, body + sizeof(head), result_len);
+    memcpy(body, head, head_len);
+
+    const size_t len = telemetry_frame_build(TELEMETRY_FRAME_RESPONSE, srv->cfg.device_id, srv->frame_seq++, body,
+                                             head_len + result_len, srv->payload, sizeof(srv->payload));
+    if (!len)
+        return;
+    srv->last_wire_len = telemetry_frame_cobs_encode(srv->payload, len, srv->last_wire);
+    srv->last_msg_id = req->msg_id;
+    srv->have_last = true;
+    srv->cfg.write(srv->last_wire, srv->last_wire_len, srv->cfg.write_ctx);
+}
+
+static void handle_frame(telemetry_cmd_server_t *srv)
+{
+    // COBS never grows the data, so it decodes in place
+    const size_t n = telemetry_frame_cobs_decode(srv->rx, srv->rx_len, srv->rx);
+    telemetry_frame_view_t view;
+    telemetry_cmd_msg_t req;
+    if (!n || !telemetry_frame_parse(srv->rx, n, &view))
+    {
+        srv->bad_requests++;
+        return;
+    }
+    if (!telemetry_cmd_parse_request(&view, &req))
+    {
+        // Our own sample frames looped back, or a malformed request
+        if (view.type == TELEMETRY_FRAME_REQUEST)
+            srv->bad_requests++;
+        return;
+    }
+
+    if (srv->have_last && req.msg_id == srv->last_msg_id)
+    {
+        // Resend: the response got lost, the command already ran
+        srv->duplicates++;
+        srv->cfg.write(srv->last_wire, srv->last_wire_len, srv->cfg.write_ctx);
+        return;
+    }
+    srv->requests++;
+
+    uint64_t args[TELEMETRY_CMD_MAX_ARGS];
+    const int n_args = telemetry_cmd_get_values(req.data, req.data_len, args, TELEMETRY_CMD_MAX_ARGS);
+    if (n_args < 0)
+    {
+        respond(srv, &req, TELEMETRY_STATUS_BAD_ARGS, 0);
+        return;
+    }
+
+    uint8_t *result = srv->payload + TELEMETRY_FRAME_BODY_OFFSET + 7;
+    size_t result_len = 0;
+    const telemetry_status_t status = srv->cfg.handler(req.cmd, args, (size_t)n_args, result,
+                                                       TELEMETRY_CMD_MAX_RESULT, &result_len,
+                                                       srv->cfg.handler_ctx);
+    respond(srv, &req, status, result_len <= TELEMETRY_CMD_MAX_RESULT ? result_len : 0);
+}
+
+void telemetry_cmd_server_feed(telemetry_cmd_server_t *srv, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] == TELEMETRY_FRAME_DELIMITER)
+        {
+            if (srv->rx_overrun)
+                srv->bad_requests++;
+            else if (srv->rx_len)
+                handle_frame(srv);
+            srv->rx_len = 0;
+            srv->rx_overrun = false;
+            continue;
+        }
+        if (srv->rx_overrun)
+            continue;
+        if (srv->rx_len == sizeof(srv->rx))
+        {
+            srv->rx_overrun = true;
+            continue;
+        }
+        srv->rx[srv->rx_len++] = data[i];
+    }
+}
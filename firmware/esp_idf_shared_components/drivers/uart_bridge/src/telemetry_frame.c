@@ -0,0 +1,295 @@
+#include <string.h>
+
+#include "telemetry_frame.h"
+
+/*========== CRC-16/CCITT-FALSE ==========*/
+// Table driven: at multi-megabaud the host decodes MB/s of frames and the
+// 512 bytes live in flash on the ESP32
+static const uint16_t s_crc_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6, 0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485, 0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4, 0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823, 0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12, 0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41, 0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70, 0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F, 0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E, 0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D, 0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C, 0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB, 0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A, 0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9, 0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8, 0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+uint16_t telemetry_frame_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+        crc = (uint16_t)((crc << 8) ^ s_crc_table[(uint8_t)((crc >> 8) ^ data[i])]);
+    return crc;
+}
+
+/*========== Varints ==========*/
+size_t telemetry_frame_put_varint(uint8_t *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+size_t telemetry_frame_get_varint(const uint8_t *in, size_t len, uint64_t *v)
+{
+    uint64_t r = 0;
+    for (size_t i = 0; i < len && i < 10; i++)
+    {
+        r |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80))
+        {
+            *v = r;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/*========== COBS ==========*/
+size_t telemetry_frame_cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t o = 0;
+    out[o++] = TELEMETRY_FRAME_DELIMITER; // lets the receiver drop a partial frame
+    size_t code_at = o++;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (in[i] == 0)
+        {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+            continue;
+        }
+        out[o++] = in[i];
+        if (++code == 0xFF)
+        {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+        }
+    }
+    out[code_at] = code;
+    out[o++] = TELEMETRY_FRAME_DELIMITER;
+    return o;
+}
+
+size_t telemetry_frame_cobs_decode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t i = 0, o = 0;
+    while (i < len)
+    {
+        const uint8_t code = in[i++];
+        if (code == 0)
+            return 0;
+        if ((size_t)(code - 1) > len - i)
+            return 0;
+        for (uint8_t j = 1; j < code; j++)
+        {
+            if (in[i] == 0)
+                return 0;
+            out[o++] = in[i++];
+        }
+        if (code < 0xFF && i < len)
+            out[o++] = 0;
+    }
+    return o;
+}
+
+/*========== Frames ==========*/
+static size_t put_header(uint8_t *out, uint8_t type, const char *device_id, uint32_t frame_seq)
+{
+    const size_t id_len = strlen(device_id);
+    size_t n = 0;
+    out[n++] = TELEMETRY_FRAME_VERSION;
+    out[n++] = type;
+    out[n++] = (uint8_t)id_len;
+    memcpy(out + n, device_id, id_len);
+    n += id_len;
+    n += telemetry_frame_put_varint(out + n, frame_seq);
+    return n;
+}
+
+static size_t seal(uint8_t *out, size_t n)
+{
+    const uint16_t crc = telemetry_frame_crc16(out, n);
+    out[n++] = (uint8_t)(crc & 0xFF);
+    out[n++] = (uint8_t)(crc >> 8);
+    return n;
+}
+
+// TELEMETRY_FRAME_MAX_SAMPLE_BYTES counts the varints below by these widths
+_Static_assert(sizeof(((telemetry_sample_t *)0)->seq) == 4 && sizeof(((telemetry_sample_t *)0)->ts_us) == 8 &&
+                   sizeof(((telemetry_sample_t *)0)->temp_dc) == 4 && sizeof(((telemetry_sample_t *)0)->hum_dpct) == 4,
+               "telemetry_sample_t changed: update TELEMETRY_FRAME_MAX_SAMPLE_BYTES");
+
+size_t telemetry_frame_put_samples(const telemetry_sample_t *samples, size_t count, uint8_t *out)
+{
+    size_t n = telemetry_frame_put_varint(out, count);
+    if (!count)
+        return n;
+
+    const telemetry_sample_t *s = &samples[0];
+    n += telemetry_frame_put_varint(out + n, s->seq);
+    n += telemetry_frame_put_varint(out + n, (uint64_t)s->ts_us);
+    n += telemetry_frame_put_varint(out + n, zigzag(s->temp_dc));
+    n += telemetry_frame_put_varint(out + n, zigzag(s->hum_dpct));
+    for (size_t i = 1; i < count; i++)
+    {
+        const telemetry_sample_t *p = &samples[i - 1];
+        s = &samples[i];
+        n += telemetry_frame_put_varint(out + n, (uint32_t)(s->seq - p->seq));
+        n += telemetry_frame_put_varint(out + n, zigzag(s->ts_us - p->ts_us));
+        n += telemetry_frame_put_varint(out + n, zigzag((int64_t)s->temp_dc - p->temp_dc));
+        n += telemetry_frame_put_varint(out + n, zigzag((int64_t)s->hum_dpct - p->hum_dpct));
+    }
+    return n;
+}
+
+size_t telemetry_frame_build(uint8_t type, const char *device_id, uint32_t frame_seq,
+                             const uint8_t *body, size_t body_len, uint8_t *out, size_t cap)
+{
+    if (!device_id || !out || (body_len && !body))
+        return 0;
+    const size_t id_len = strlen(device_id);
+    // version, type, id length, id, frame seq (<= 5), body, CRC
+    if (id_len > TELEMETRY_FRAME_MAX_DEVICE_ID || cap < 3 + id_len + 5 + body_len + 2)
+        return 0;
+
+    size_t n = put_header(out, type, device_id, frame_seq);
+    if (body_len)
+        memmove(out + n, body, body_len);
+    return seal(out, n + body_len);
+}
+
+size_t telemetry_frame_build_samples(const char *device_id, uint32_t frame_seq,
+                                     const telemetry_sample_t *samples, size_t count,
+                                     uint8_t *out, size_t cap)
+{
+    if (!device_id || strlen(device_id) > TELEMETRY_FRAME_MAX_DEVICE_ID || !out ||
+        count == 0 || count > TELEMETRY_FRAME_MAX_SAMPLES || !samples ||
+        cap < TELEMETRY_FRAME_MAX_PAYLOAD(count))
+        return 0;
+
+    // Encode in place, after the header
+    size_t n = put_header(out, TELEMETRY_FRAME_SAMPLES, device_id, frame_seq);
+    n += telemetry_frame_put_samples(samples, count, out + n);
+    return seal(out, n);
+}
+
+bool telemetry_frame_parse(const uint8_t *payload, size_t len, telemetry_frame_view_t *view)
+{
+    if (len < 6)
+        return false;
+    const size_t body_end = len - 2;
+    const uint16_t crc = (uint16_t)payload[body_end] | ((uint16_t)payload[body_end + 1] << 8);
+    if (telemetry_frame_crc16(payload, body_end) != crc)
+        return false;
+    if (payload[0] != TELEMETRY_FRAME_VERSION)
+        return false;
+
+    size_t n = 1;
+    view->type = payload[n++];
+    const uint8_t id_len = payload[n++];
+    if (id_len > TELEMETRY_FRAME_MAX_DEVICE_ID || id_len > body_end - n)
+        return false;
+    memcpy(view->device_id, payload + n, id_len);
+    view->device_id[id_len] = '\0';
+    n += id_len;
+
+    uint64_t v;
+    const size_t used = telemetry_frame_get_varint(payload + n, body_end - n, &v);
+    if (!used || v > UINT32_MAX)
+        return false;
+    view->frame_seq = (uint32_t)v;
+    n += used;
+
+    view->body = payload + n;
+    view->body_len = body_end - n;
+    return true;
+}
+
+int telemetry_frame_read_samples(const telemetry_frame_view_t *view, telemetry_sample_t *out, size_t cap)
+{
+    if (view->type != TELEMETRY_FRAME_SAMPLES)
+        return -1;
+    const int count = telemetry_frame_get_samples(view->body, view->body_len, out, cap);
+    return count > 0 ? count : -1;
+}
+
+int telemetry_frame_get_samples(const uint8_t *in, size_t len, telemetry_sample_t *out, size_t cap)
+{
+    const uint8_t *p = in;
+    size_t left = len;
+    uint64_t v[4];
+
+#define TF_TAKE(dst)                                                     \
+    do                                                                   \
+    {                                                                    \
+        const size_t used = telemetry_frame_get_varint(p, left, &(dst)); \
+        if (!used)                                                       \
+            return -1;                                                   \
+        p += used;                                                       \
+        left -= used;                                                    \
+    } while (0)
+
+    uint64_t count;
+    TF_TAKE(count);
+    if (count > TELEMETRY_FRAME_MAX_SAMPLES)
+        return -1;
+
+    telemetry_sample_t prev = {0};
+    for (size_t i = 0; i < count; i++)
+    {
+        TF_TAKE(v[0]);
+        TF_TAKE(v[1]);
+        TF_TAKE(v[2]);
+        TF_TAKE(v[3]);
+        telemetry_sample_t s;
+        if (i == 0)
+        {
+            s.seq = (uint32_t)v[0];
+            s.ts_us = (int64_t)v[1];
+            s.temp_dc = (int32_t)unzigzag(v[2]);
+            s.hum_dpct = (int32_t)unzigzag(v[3]);
+        }
+        else
+        {
+            s.seq = prev.seq + (uint32_t)v[0];
+            s.ts_us = prev.ts_us + unzigzag(v[1]);
+            s.temp_dc = (int32_t)(prev.temp_dc + unzigzag(v[2]));
+            s.hum_dpct = (int32_t)(prev.hum_dpct + unzigzag(v[3]));
+        }
+        if (i < cap)
+            out[i] = s;
+        prev = s;
+    }
+#undef TF_TAKE
+
+    return left == 0 ? (int)(count < cap ? count : cap) : -1;
+}
@@ -1,41 +1,408 @@
 #include <stdio.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
-#include "global.h" // for global_temperature, global_humidity
+#include "event_bus.h"
+#include "uart_bridge.h"
+
+#if CONFIG_UART_BRIDGE_TRANSPORT_BINARY
+#include "freertos/semphr.h"
+#include "driver/uart.h"
+#include "esp_timer.h"
+#include "telemetry_cmd.h"
+#include "telemetry_frame.h"
+#endif
 
 static const char *TAG = "UART_BRIDGE";
 
+#define UART_BRIDGE_MIN_INTERVAL_MS 100
+#define UART_BRIDGE_MAX_INTERVAL_MS 60000
+
+static event_bus_sub_handle_t s_sub = NULL;
+static uart_bridge_stats_t s_stats;          // written by the bridge task only
+static volatile uint32_t s_interval_ms = 0; // set at start and by SET_RATES
+
+static uint32_t clamp_interval(uint32_t ms)
+{
+    if (ms < UART_BRIDGE_MIN_INTERVAL_MS)
+        return UART_BRIDGE_MIN_INTERVAL_MS;
+    if (ms > UART_BRIDGE_MAX_INTERVAL_MS)
+        return UART_BRIDGE_MAX_INTERVAL_MS;
+    return ms;
+}
+
+#if CONFIG_UART_BRIDGE_TRANSPORT_BINARY
+/*========== Binary transport ==========*/
+#define BATCH_MAX CONFIG_UART_BRIDGE_BATCH_MAX
+#define HISTORY_LEN CONFIG_UART_BRIDGE_HISTORY_LEN
+#define PAYLOAD_CAP TELEMETRY_FRAME_MAX_PAYLOAD(BATCH_MAX)
+
+static uint8_t s_payload[PAYLOAD_CAP];
+static uint8_t s_wire[TELEMETRY_FRAME_MAX_WIRE(PAYLOAD_CAP)];
+
+// Samples sent so far, for DUMP_HISTORY. Guarded by s_history_lock.
+static telemetry_sample_t s_history[HISTORY_LEN];
+static size_t s_history_head = 0; // next slot
+static size_t s_history_count = 0;
+static SemaphoreHandle_t s_history_lock = NULL;
+
+static telemetry_cmd_server_t s_cmd_server; // rx task only
+static uart_bridge_cmd_hooks_t s_hooks;
+
+static esp_err_t transport_init(void)
+{
+    const uart_config_t cfg = {
+        .baud_rate = CONFIG_UART_BRIDGE_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    s_history_lock = xSemaphoreCreateMutex();
+    if (!s_history_lock)
+        return ESP_ERR_NO_MEM;
+    // RX only carries the small command requests
+    esp_err_t err = uart_driver_install(CONFIG_UART_BRIDGE_UART_NUM, 512, CONFIG_UART_BRIDGE_TX_BUFFER, 0, NULL, 0);
+    if (err != ESP_OK)
+        return err;
+    err = uart_param_config(CONFIG_UART_BRIDGE_UART_NUM, &cfg);
+    if (err != ESP_OK)
+        return err;
+    return uart_set_pin(CONFIG_UART_BRIDGE_UART_NUM, CONFIG_UART_BRIDGE_TX_GPIO, CONFIG_UART_BRIDGE_RX_GPIO,
+                        UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+}
+
+static void history_add(const telemetry_sample_t *batch, size_t n)
+{
+    xSemaphoreTake(s_history_lock, portMAX_DELAY);
+    for (size_t i = 0; i < n; i++)
+    {
+        s_history[s_history_head] = batch[i];
+        s_history_head = (s_history_head + 1) % HISTORY_LEN;
+        if (s_history_count < HISTORY_LEN)
+            s_history_count++;
+    }
+    xSemaphoreGive(s_history_lock);
+}
+
+// Copies up to `max` samples with seq >= from_seq, oldest first. Returns
+// the count and the seq to ask for next.
+static size_t history_read(uint32_t from_seq, size_t max, telemetry_sample_t *out, uint32_t *next_seq)
+{
+    size_t n = 0;
+    *next_seq = from_seq;
+    xSemaphoreTake(s_history_lock, portMAX_DELAY);
+    const size_t oldest = (s_history_head + HISTORY_LEN - s_history_count) % HISTORY_LEN;
+    for (size_t i = 0; i < s_history_count && n < max; i++)
+    {
+        const telemetry_sample_t *s = &s_history[(oldest + i) % HISTORY_LEN];
+        if ((int32_t)(s->seq - from_seq) < 0)
+            continue;
+        out[n++] = *s;
+        *next_seq = s->seq + 1;
+    }
+    xSemaphoreGive(s_history_lock);
+    return n;
+}
+
+static void send_batch(const telemetry_sample_t *batch, size_t n)
+{
+    const size_t len = telemetry_frame_build_samples(CONFIG_UART_BRIDGE_DEVICE_ID, s_stats.frames, batch, n,
+                                                     s_payload, sizeof(s_payload));
+    if (!len)
+    {
+        ESP_LOGE(TAG, "frame build failed (device id too long?)");
+        return;
+    }
+    const size_t wire = telemetry_frame_cobs_encode(s_payload, len, s_wire);
+    // Copies into the TX ring buffer and returns; only blocks if the link
+    // is slower than the sample rate. The driver keeps each write whole, so
+    // command responses never interleave with it.
+    const int written = uart_write_bytes(CONFIG_UART_BRIDGE_UART_NUM, s_wire, wire);
+    if (written > 0)
+        s_stats.bytes += (uint32_t)written;
+    s_stats.frames++;
+    s_stats.samples += (uint32_t)n;
+    history_add(batch, n);
+}
+
+static void uart_bridge_task(void *arg)
+{
+    (void)arg;
+    ESP_LOGI(TAG, "UART bridge started: binary on UART%d @ %d baud, batch %d, flush %ums",
+             CONFIG_UART_BRIDGE_UART_NUM, CONFIG_UART_BRIDGE_BAUD, BATCH_MAX, (unsigned)s_interval_ms);
+
+    telemetry_sample_t batch[BATCH_MAX];
+    size_t n = 0;
+    TickType_t first = 0;
+
+    while (1)
+    {
+        TickType_t wait = portMAX_DELAY;
+        if (n)
+        {
+            // Re-read each time: SET_RATES may change it
+            const TickType_t interval = pdMS_TO_TICKS(s_interval_ms);
+            const TickType_t age = xTaskGetTickCount() - first;
+            wait = age >= interval ? 0 : interval - age;
+        }
+
+        event_bus_msg_t msg;
+        if (event_bus_receive(s_sub, &msg, wait) == ESP_OK)
+        {
+            if (!n)
+                first = xTaskGetTickCount();
+            batch[n++] = (telemetry_sample_t){
+                .seq = msg.seq,
+                .ts_us = msg.data.climate.sample_us,
+                .temp_dc = msg.data.climate.temp_dc,
+                .hum_dpct = msg.data.climate.hum_dpct,
+            };
+            if (n < BATCH_MAX)
+                continue;
+        }
+        else if (!n)
+        {
+            continue;
+        }
+
+        send_batch(batch, n);
+        n = 0;
+    }
+}
+
+/*========== Command channel ==========*/
+static uint32_t sample_period_ms(void)
+{
+    return s_hooks.get_sample_period ? s_hooks.get_sample_period(s_hooks.ctx) : 0;
+}
+
+// `cap` is TELEMETRY_CMD_MAX_RESULT: a full history page fits, and so do the
+// echo and the stats, written without a look at it
+_Static_assert(TELEMETRY_CMD_HISTORY_RESULT_SIZE(TELEMETRY_CMD_MAX_HISTORY) <= TELEMETRY_CMD_MAX_RESULT &&
+                   TELEMETRY_CMD_MAX_ARGS * TELEMETRY_FRAME_VARINT_MAX(64) <= TELEMETRY_CMD_MAX_RESULT &&
+                   TELEMETRY_STAT_COUNT * TELEMETRY_FRAME_VARINT_MAX(64) <= TELEMETRY_CMD_MAX_RESULT,
+               "command results outgrow TELEMETRY_CMD_MAX_RESULT");
+
+static telemetry_status_t handle_command(uint8_t cmd, const uint64_t *args, size_t n_args, uint8_t *result,
+                                         size_t cap, size_t *result_len, void *ctx)
+{
+    (void)ctx;
+    switch (cmd)
+    {
+    case TELEMETRY_CMD_PING:
+        *result_len = telemetry_cmd_put_values(args, n_args, result);
+        return TELEMETRY_STATUS_OK;
+
+    case TELEMETRY_CMD_SET_RATES:
+    {
+        if (n_args != 2 || args[0] > UINT32_MAX || args[1] > UINT32_MAX)
+            return TELEMETRY_STATUS_BAD_ARGS;
+        if (args[1])
+        {
+            if (!s_hooks.set_sample_period)
+                return TELEMETRY_STATUS_UNAVAILABLE;
+            if (s_hooks.set_sample_period((uint32_t)args[1], s_hooks.ctx) != ESP_OK)
+                return TELEMETRY_STATUS_BAD_ARGS;
+        }
+        if (args[0])
+            s_interval_ms = clamp_interval((uint32_t)args[0]);
+        ESP_LOGI(TAG, "rates: uart interval %ums, sample period %ums", (unsigned)s_interval_ms,
+                 (unsigned)sample_period_ms());
+        const uint64_t applied[2] = {s_interval_ms, sample_period_ms()};
+        *result_len = telemetry_cmd_put_values(applied, 2, result);
+        return TELEMETRY_STATUS_OK;
+    }
+
+    case TELEMETRY_CMD_GET_STATS:
+    {
+        uart_bridge_stats_t st;
+        uart_bridge_get_stats(&st);
+        uint64_t v[TELEMETRY_STAT_COUNT];
+        v[TELEMETRY_STAT_UPTIME_MS] = (uint64_t)(esp_timer_get_time() / 1000);
+        v[TELEMETRY_STAT_FRAMES] = st.frames;
+        v[TELEMETRY_STAT_SAMPLES] = st.samples;
+        v[TELEMETRY_STAT_BYTES] = st.bytes;
+        v[TELEMETRY_STAT_DROPPED] = st.dropped;
+        v[TELEMETRY_STAT_REQUESTS] = s_cmd_server.requests;
+        v[TELEMETRY_STAT_BAD_REQUESTS] = s_cmd_server.bad_requests;
+        v[TELEMETRY_STAT_UART_INTERVAL_MS] = s_interval_ms;
+        v[TELEMETRY_STAT_SAMPLE_PERIOD_MS] = sample_period_ms();
+        *result_len = telemetry_cmd_put_values(v, TELEMETRY_STAT_COUNT, result);
+        return TELEMETRY_STATUS_OK;
+    }
+
+    case TELEMETRY_CMD_DUMP_HISTORY:
+    {
+        if (n_args != 2 || args[0] > UINT32_MAX)
+            return TELEMETRY_STATUS_BAD_ARGS;
+        size_t max = args[1] < TELEMETRY_CMD_MAX_HISTORY ? (size_t)args[1] : TELEMETRY_CMD_MAX_HISTORY;
+        telemetry_sample_t page[TELEMETRY_CMD_MAX_HISTORY];
+        uint32_t next_seq;
+        const size_t n = history_read((uint32_t)args[0], max, page, &next_seq);
+        if (cap < TELEMETRY_CMD_HISTORY_RESULT_SIZE(n))
+            return TELEMETRY_STATUS_FAILED;
+        size_t len = telemetry_frame_put_varint(result, next_seq);
+        len += telemetry_frame_put_samples(page, n, result + len);
+        *result_len = len;
+        return TELEMETRY_STATUS_OK;
+    }
+
+    case TELEMETRY_CMD_START_PROVISIONING:
+        if (!s_hooks.start_provisioning)
+            return TELEMETRY_STATUS_UNAVAILABLE;
+        return s_hooks.start_provisioning(s_hooks.ctx) == ESP_OK ? TELEMETRY_STATUS_OK
+                                                                 : TELEMETRY_STATUS_UNAVAILABLE;
+
+    default:
+        return TELEMETRY_STATUS_UNKNOWN_CMD;
+    }
+}
+
+static void write_response(const uint8_t *data, size_t len, void *ctx)
+{
+    (void)ctx;
+    uart_write_bytes(CONFIG_UART_BRIDGE_UART_NUM, data, len);
+}
+
+static void uart_bridge_rx_task(void *arg)
+{
+    (void)arg;
+    uint8_t buf[128];
+    while (1)
+    {
+        const int n = uart_read_bytes(CONFIG_UART_BRIDGE_UART_NUM, buf, sizeof(buf), pdMS_TO_TICKS(20));
+        if (n > 0)
+            telemetry_cmd_server_feed(&s_cmd_server, buf, (size_t)n);
+    }
+}
+
+static esp_err_t start_rx(void)
+{
+    const telemetry_cmd_server_config_t cfg = {
+        .device_id = CONFIG_UART_BRIDGE_DEVICE_ID,
+        .handler = handle_command,
+        .write = write_response,
+    };
+    telemetry_cmd_server_init(&s_cmd_server, &cfg);
+    BaseType_t ok = xTaskCreate(uart_bridge_rx_task, "uart_bridge_rx", 4096, NULL, 4, NULL);
+    return (ok == pdPASS) ? ESP_OK : ESP_FAIL;
+}
+
+void uart_bridge_set_cmd_hooks(const uart_bridge_cmd_hooks_t *hooks)
+{
+    if (hooks)
+        s_hooks = *hooks;
+    else
+        memset(&s_hooks, 0, sizeof(s_hooks));
+}
+
+#else
+/*========== Console transport ==========*/
+static esp_err_t transport_init(void)
+{
+    return ESP_OK;
+}
+
+static esp_err_t start_rx(void)
+{
+    return ESP_OK; // no command channel on the shared console
+}
+
+void uart_bridge_set_cmd_hooks(const uart_bridge_cmd_hooks_t *hooks)
+{
+    (void)hooks;
+}
+
 static void uart_bridge_task(void *arg)
 {
-    const int interval_ms = (int)(intptr_t)arg;
-    ESP_LOGI(TAG, "UART bridge started, interval=%dms", interval_ms);
+    (void)arg;
+    ESP_LOGI(TAG, "UART bridge started, min interval=%ums", (unsigned)s_interval_ms);
 
     while (1)
     {
-        // Read from global.h
-        const float temp_c = (float)global_temperature / 10.0f;
-        const float hum_pct = (float)global_humidity / 10.0f;
+        // Sleeps until the next DHT read is published
+        event_bus_msg_t msg;
+        if (event_bus_receive(s_sub, &msg, portMAX_DELAY) != ESP_OK)
+            continue;
+        const float temp_c = (float)msg.data.climate.temp_dc / 10.0f;
+        const float hum_pct = (float)msg.data.climate.hum_dpct / 10.0f;
 
         // Print JSON line, PC will add system timestamp automatically
         // {"device_id":"esp32_1","temp_c":28.0,"humidity":80.0}
-        printf("{\"device_id\":\"esp32_1\",\"temp_c\":%.1f,\"humidity\":%.1f}\n", temp_c, hum_pct);
+        const int len = printf("{\"device_id\":\"%s\",\"temp_c\":%.1f,\"humidity\":%.1f}\n",
+                               CONFIG_UART_BRIDGE_DEVICE_ID, temp_c, hum_pct);
         fflush(stdout);
+        s_stats.frames++;
+        s_stats.samples++;
+        if (len > 0)
+            s_stats.bytes += (uint32_t)len;
 
-        vTaskDelay(pdMS_TO_TICKS(interval_ms));
+        // Rate limit: readings published meanwhile overwrite each other in
+        // the depth-1 queue, the newest one goes out next
+        vTaskDelay(pdMS_TO_TICKS(s_interval_ms));
     }
 }
+#endif
 
 esp_err_t uart_bridge_start(int interval_ms)
 {
-    if (interval_ms < 100)
-        interval_ms = 100;
+    s_interval_ms = clamp_interval(interval_ms > 0 ? (uint32_t)interval_ms : 0);
+
+    esp_err_t err = event_bus_init();
+    if (err != ESP_OK)
+        return err;
+    err = transport_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "transport init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+#if CONFIG_UART_BRIDGE_TRANSPORT_BINARY
+    // Every reading is sent, so queue a batch worth and count what falls off
+    const event_bus_sub_config_t sub_cfg = {
+        .name = "uart_bridge",
+        .topics = EVENT_TOPIC_BIT(EVENT_TOPIC_CLIMATE),
+        .depth = 2 * BATCH_MAX,
+        .policy = EVENT_BUS_DROP_NEWEST,
+    };
+#else
+    const event_bus_sub_config_t sub_cfg = {
+        .name = "uart_bridge",
+        .topics = EVENT_TOPIC_BIT(EVENT_TOPIC_CLIMATE),
+        .depth = 1,
+        .policy = EVENT_BUS_OVERWRITE_OLDEST,
+    };
+#endif
+    err = event_bus_subscribe(&sub_cfg, &s_sub);
+    if (err != ESP_OK)
+        return err;
+
     BaseType_t ok = xTaskCreate(
         uart_bridge_task,
         "uart_bridge",
         3072,
-        (void *)(intptr_t)interval_ms,
+        NULL,
         4,
         NULL);
-    return (ok == pdPASS) ? ESP_OK : ESP_FAIL;
+    if (ok != pdPASS)
+        return ESP_FAIL;
+    return start_rx();
+}
+
+esp_err_t uart_bridge_get_stats(uart_bridge_stats_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_sub)
+        return ESP_ERR_INVALID_STATE;
+    *out = s_stats;
+
+    event_bus_sub_stats_t bus;
+    if (event_bus_get_stats(s_sub, &bus) == ESP_OK)
+        out->dropped = bus.dropped + bus.overwritten;
+    return ESP_OK;
 }
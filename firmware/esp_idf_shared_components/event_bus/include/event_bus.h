@@ -0,0 +1,109 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /** Topics and their payload types. Add a topic here, its payload struct
+     *  below and a member in event_bus_msg_t. */
+    typedef enum
+    {
+        EVENT_TOPIC_CLIMATE = 0, // event_climate_t
+        EVENT_TOPIC_SENSOR_ERROR, // event_sensor_error_t
+        EVENT_TOPIC_COUNT
+    } event_topic_t;
+
+#define EVENT_TOPIC_BIT(t) (1u << (t))
+#define EVENT_TOPIC_ALL ((1u << EVENT_TOPIC_COUNT) - 1u)
+
+    /** One DHT read: temperature and humidity from the same sample */
+    typedef struct
+    {
+        int32_t temp_dc;   // tenths of degree C
+        int32_t hum_dpct;  // tenths of %RH
+        int64_t sample_us; // time of the read
+    } event_climate_t;
+
+    typedef struct
+    {
+        int32_t err;        // esp_err_t of the failed read
+        uint32_t fail_count; // consecutive failures
+    } event_sensor_error_t;
+
+    typedef struct
+    {
+        event_topic_t topic;
+        uint32_t seq;       // per-topic publish counter, gaps = drops upstream of this subscriber
+        int64_t publish_us; // time of event_bus_publish()
+        union
+        {
+            event_climate_t climate;
+            event_sensor_error_t sensor_error;
+        } data;
+    } event_bus_msg_t;
+
+    /** What happens when a subscriber's queue is full */
+    typedef enum
+    {
+        EVENT_BUS_DROP_NEWEST = 0, // keep the backlog, drop the new event (loggers, links)
+        EVENT_BUS_OVERWRITE_OLDEST // make room by dropping the oldest (displays want the latest)
+    } event_bus_policy_t;
+
+    typedef struct
+    {
+        const char *name;   // for logs/stats, not copied
+        uint32_t topics;    // EVENT_TOPIC_BIT() mask
+        size_t depth;       // queue length, >= 1
+        event_bus_policy_t policy;
+    } event_bus_sub_config_t;
+
+    typedef struct
+    {
+        uint32_t delivered;   // events taken by the subscriber
+        uint32_t dropped;     // DROP_NEWEST: events refused on a full queue
+        uint32_t overwritten; // OVERWRITE_OLDEST: queued events replaced
+        uint32_t high_water;  // max queue fill seen at publish
+        uint32_t latency_min_us; // publish -> event_bus_receive() return
+        uint32_t latency_max_us;
+        uint32_t latency_avg_us;
+    } event_bus_sub_stats_t;
+
+    typedef struct event_bus_sub *event_bus_sub_handle_t;
+
+    /** Create the bus. Safe to call more than once. */
+    esp_err_t event_bus_init(void);
+
+    /** Register a subscriber; events published from now on are queued for it. */
+    esp_err_t event_bus_subscribe(const event_bus_sub_config_t *cfg, event_bus_sub_handle_t *out);
+    esp_err_t event_bus_unsubscribe(event_bus_sub_handle_t sub);
+
+    /** Copy `payload` (the topic's payload type) to every subscriber of
+     *  `topic`. Never blocks on a slow subscriber. */
+    esp_err_t event_bus_publish(event_topic_t topic, const void *payload, size_t size);
+
+    static inline esp_err_t event_bus_publish_climate(const event_climate_t *c)
+    {
+        return event_bus_publish(EVENT_TOPIC_CLIMATE, c, sizeof(*c));
+    }
+
+    /** Wait up to `timeout` for the next event. ESP_ERR_TIMEOUT if none. */
+    esp_err_t event_bus_receive(event_bus_sub_handle_t sub, event_bus_msg_t *out, TickType_t timeout);
+
+    esp_err_t event_bus_get_stats(event_bus_sub_handle_t sub, event_bus_sub_stats_t *out);
+
+    /** Publishes per topic since init */
+    uint32_t event_bus_published(event_topic_t topic);
+
+    /** Log one line of stats per subscriber */
+    void event_bus_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "event_bus.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+static const char *TAG = "EVENT_BUS";
+
+struct event_bus_sub
+{
+    struct event_bus_sub *next;
+    const char *name;
+    uint32_t topics;
+    event_bus_policy_t policy;
+    QueueHandle_t queue;
+
+    // Guarded by s_lock
+    event_bus_sub_stats_t stats;
+    uint64_t latency_sum_us;
+};
+
+// Payload size per topic, checked on publish
+static const size_t s_payload_size[EVENT_TOPIC_COUNT] = {
+    [EVENT_TOPIC_CLIMATE] = sizeof(event_climate_t),
+    [EVENT_TOPIC_SENSOR_ERROR] = sizeof(event_sensor_error_t),
+};
+
+static SemaphoreHandle_t s_lock = NULL; // subscriber list, seqs and stats
+static struct event_bus_sub *s_subs = NULL;
+static uint32_t s_published[EVENT_TOPIC_COUNT];
+
+static int64_t now_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+esp_err_t event_bus_init(void)
+{
+    if (s_lock)
+        return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/*========== Subscribers ==========*/
+esp_err_t event_bus_subscribe(const event_bus_sub_config_t *cfg, event_bus_sub_handle_t *out)
+{
+    if (!cfg || !out || cfg->depth == 0 || !(cfg->topics & EVENT_TOPIC_ALL))
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+
+    struct event_bus_sub *sub = calloc(1, sizeof(*sub));
+    if (!sub)
+        return ESP_ERR_NO_MEM;
+    sub->queue = xQueueCreate(cfg->depth, sizeof(event_bus_msg_t));
+    if (!sub->queue)
+    {
+        free(sub);
+        return ESP_ERR_NO_MEM;
+    }
+    sub->name = cfg->name ? cfg->name : "?";
+    sub->topics = cfg->topics & EVENT_TOPIC_ALL;
+    sub->policy = cfg->policy;
+    sub->stats.latency_min_us = UINT32_MAX;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sub->next = s_subs;
+    s_subs = sub;
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "'%s' subscribed (topics 0x%02x, depth %u, %s)", sub->name, (unsigned)sub->topics,
+             (unsigned)cfg->depth, sub->policy == EVENT_BUS_OVERWRITE_OLDEST ? "overwrite" : "drop");
+    *out = sub;
+    return ESP_OK;
+}
+
+esp_err_t event_bus_unsubscribe(event_bus_sub_handle_t sub)
+{
+    if (!sub || !s_lock)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    struct event_bus_sub **pp = &s_subs;
+    while (*pp && *pp != sub)
+        pp = &(*pp)->next;
+    const bool found = *pp != NULL;
+    if (found)
+        *pp = sub->next;
+    xSemaphoreGive(s_lock);
+
+    if (!found)
+        return ESP_ERR_NOT_FOUND;
+    // The caller owns the handle: no receive may be pending on it
+    vQueueDelete(sub->queue);
+    free(sub);
+    return ESP_OK;
+}
+
+/*========== Publish ==========*/
+esp_err_t event_bus_publish(event_topic_t topic, const void *payload, size_t size)
+{
+    if ((unsigned)topic >= EVENT_TOPIC_COUNT || !payload || size != s_payload_size[topic])
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+
+    event_bus_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.topic = topic;
+    memcpy(&msg.data, payload, size);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    msg.seq = ++s_published[topic];
+    msg.publish_us = now_us();
+    for (struct event_bus_sub *sub = s_subs; sub; sub = sub->next)
+    {
+        if (!(sub->topics & EVENT_TOPIC_BIT(topic)))
+            continue;
+
+        if (xQueueSend(sub->queue, &msg, 0) != pdPASS)
+        {
+            if (sub->policy == EVENT_BUS_OVERWRITE_OLDEST)
+            {
+                // The subscriber may have drained a slot meanwhile; either
+                // way the second send finds room
+                event_bus_msg_t old;
+                if (xQueueReceive(sub->queue, &old, 0) == pdPASS)
+                    sub->stats.overwritten++;
+                xQueueSend(sub->queue, &msg, 0);
+            }
+            else
+            {
+                sub->stats.dropped++;
+            }
+        }
+
+        const uint32_t fill = (uint32_t)uxQueueMessagesWaiting(sub->queue);
+        if (fill > sub->stats.high_water)
+            sub->stats.high_water = fill;
+    }
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+/*========== Receive ==========*/
+esp_err_t event_bus_receive(event_bus_sub_handle_t sub, event_bus_msg_t *out, TickType_t timeout)
+{
+    if (!sub || !out)
+        return ESP_ERR_INVALID_ARG;
+    if (xQueueReceive(sub->queue, out, timeout) != pdPASS)
+        return ESP_ERR_TIMEOUT;
+
+    int64_t latency = now_us() - out->publish_us;
+    if (latency < 0)
+        latency = 0;
+    if (latency > UINT32_MAX)
+        latency = UINT32_MAX;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    event_bus_sub_stats_t *st = &sub->stats;
+    st->delivered++;
+    sub->latency_sum_us += (uint64_t)latency;
+    if ((uint32_t)latency < st->latency_min_us)
+        st->latency_min_us = (uint32_t)latency;
+    if ((uint32_t)latency > st->latency_max_us)
+        st->latency_max_us = (uint32_t)latency;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+/*========== Stats ==========*/
+esp_err_t event_bus_get_stats(event_bus_sub_handle_t sub, event_bus_sub_stats_t *out)
+{
+    if (!sub || !out || !s_lock)
+        return ESP_ERR_INVALID_ARG;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = sub->stats;
+    out->latency_avg_us = sub->stats.delivered ? (uint32_t)(sub->latency_sum_us / sub->stats.delivered) : 0;
+    if (!sub->stats.delivered)
+        out->latency_min_us = 0;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+uint32_t event_bus_published(event_topic_t topic)
+{
+    if ((unsigned)topic >= EVENT_TOPIC_COUNT || !s_lock)
+        return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const uint32_t n = s_published[topic];
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+void event_bus_log_stats(void)
+{
+    if (!s_lock)
+        return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (struct event_bus_sub *sub = s_subs; sub; sub = sub->next)
+    {
+        const event_bus_sub_stats_t *st = &sub->stats;
+        ESP_LOGI(TAG, "%s: delivered=%u dropped=%u overwritten=%u hw=%u latency us min/avg/max=%u/%u/%u",
+                 sub->name, (unsigned)st->delivered, (unsigned)st->dropped, (unsigned)st->overwritten,
+                 (unsigned)st->high_water, st->delivered ? (unsigned)st->latency_min_us : 0,
+                 st->delivered ? (unsigned)(sub->latency_sum_us / st->delivered) : 0,
+                 (unsigned)st->latency_max_us);
+    }
+    xSemaphoreGive(s_lock);
+}
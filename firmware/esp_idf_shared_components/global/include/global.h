@@ -3,7 +3,8 @@
 
 #include <stdint.h>
 
-extern int16_t global_temperature;
-extern int16_t global_humidity;
+// Shared state between tasks lives in the sensor registry: seqlock
+// protected, timestamped snapshots per sensor (see sensor_registry.h).
+#include "sensor_registry.h"
 
-#endif
\ No newline at end of file
+#endif
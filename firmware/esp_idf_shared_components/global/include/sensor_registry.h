@@ -0,0 +1,72 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Every value published on the node has a fixed slot here
+    typedef enum
+    {
+        SENSOR_ID_TEMPERATURE = 0,
+        SENSOR_ID_HUMIDITY,
+        SENSOR_ID_COUNT
+    } sensor_id_t;
+
+    typedef enum
+    {
+        SENSOR_UNIT_NONE = 0,
+        SENSOR_UNIT_DECI_CELSIUS, // value 253 = 25.3 C
+        SENSOR_UNIT_DECI_PERCENT  // value 601 = 60.1 %RH
+    } sensor_unit_t;
+
+    typedef enum
+    {
+        SENSOR_STATUS_NO_DATA = 0, // never published
+        SENSOR_STATUS_OK,
+        SENSOR_STATUS_READ_ERROR // last read failed, value is the previous good one
+    } sensor_status_t;
+
+    typedef struct
+    {
+        int32_t value;
+        sensor_unit_t unit;
+        sensor_status_t status;
+        int64_t timestamp_us; // esp_timer_get_time() of the publish
+        uint32_t seq;         // number of publishes so far
+    } sensor_snapshot_t;
+
+    // Writers. `ids` must be ascending; all entries change as one update, so
+    // readers of several ids never see half of it.
+    esp_err_t sensor_registry_publish(sensor_id_t id, int32_t value);
+    esp_err_t sensor_registry_publish_many(const sensor_id_t *ids, const int32_t *values, size_t n);
+    // Marks entries as failed, keeping their last value
+    esp_err_t sensor_registry_set_error(const sensor_id_t *ids, size_t n);
+
+    // Readers: lock-free, callable from any task on either core. A read only
+    // repeats if it raced a publish, which is a handful of stores.
+    esp_err_t sensor_registry_read(sensor_id_t id, sensor_snapshot_t *out);
+    // Snapshot of several entries as of one instant (ids in any order)
+    esp_err_t sensor_registry_read_many(const sensor_id_t *ids, size_t n, sensor_snapshot_t *out);
+    // Temperature and humidity from the same DHT read
+    esp_err_t sensor_registry_read_climate(sensor_snapshot_t *temp, sensor_snapshot_t *hum);
+
+    static inline bool sensor_snapshot_ok(const sensor_snapshot_t *s)
+    {
+        return s->status == SENSOR_STATUS_OK;
+    }
+
+    const char *sensor_unit_str(sensor_unit_t unit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SENSOR_REGISTRY_H
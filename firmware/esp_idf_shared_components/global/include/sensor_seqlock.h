@@ -0,0 +1,120 @@
+#ifndef SENSOR_SEQLOCK_H
+#define SENSOR_SEQLOCK_H
+
+// Seqlock used by the sensor registry. Plain C11 atomics with no ESP-IDF
+// dependency, so the same code runs on both cores of the ESP32 and in the
+// host stress test (host_tools/sensor_registry_stress).
+//
+// Writers make the sequence odd, store the payload words, then make it even
+// again. Readers never lock: they copy the words between two loads of the
+// sequence and retry if it moved or was odd.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SENSOR_SEQLOCK_WORDS 4
+
+// Spin hint while waiting on a writer; override before including
+#ifndef SENSOR_SEQLOCK_RELAX
+#define SENSOR_SEQLOCK_RELAX() ((void)0)
+#endif
+
+typedef struct
+{
+    _Atomic uint32_t seq; // odd while a write is in flight
+    _Atomic uint32_t words[SENSOR_SEQLOCK_WORDS];
+} sensor_seqlock_t;
+
+/*========== Writer ==========*/
+// Concurrent writers are serialised by the even->odd CAS
+static inline void sensor_seqlock_write_begin(sensor_seqlock_t *l)
+{
+    uint32_t s = atomic_load_explicit(&l->seq, memory_order_relaxed);
+    for (;;)
+    {
+        if (!(s & 1u) &&
+            atomic_compare_exchange_weak_explicit(&l->seq, &s, s + 1u,
+                                                  memory_order_acquire, memory_order_relaxed))
+            break;
+        SENSOR_SEQLOCK_RELAX();
+        s = atomic_load_explicit(&l->seq, memory_order_relaxed);
+    }
+    // Payload stores must not become visible before the odd sequence
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void sensor_seqlock_store(sensor_seqlock_t *l, const uint32_t *words)
+{
+    for (size_t i = 0; i < SENSOR_SEQLOCK_WORDS; i++)
+        atomic_store_explicit(&l->words[i], words[i], memory_order_relaxed);
+}
+
+static inline void sensor_seqlock_write_end(sensor_seqlock_t *l)
+{
+    atomic_fetch_add_explicit(&l->seq, 1u, memory_order_release);
+}
+
+/*========== Reader ==========*/
+static inline uint32_t sensor_seqlock_read_begin(sensor_seqlock_t *l)
+{
+    uint32_t s;
+    while ((s = atomic_load_explicit(&l->seq, memory_order_acquire)) & 1u)
+        SENSOR_SEQLOCK_RELAX();
+    return s;
+}
+
+static inline void sensor_seqlock_load(sensor_seqlock_t *l, uint32_t *words)
+{
+    for (size_t i = 0; i < SENSOR_SEQLOCK_WORDS; i++)
+        words[i] = atomic_load_explicit(&l->words[i], memory_order_relaxed);
+}
+
+// true if a write overlapped the copy and it must be redone
+static inline bool sensor_seqlock_read_retry(sensor_seqlock_t *l, uint32_t start)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&l->seq, memory_order_relaxed) != start;
+}
+
+/*========== Multi-entry ==========*/
+// Several entries published as one update (e.g. temperature + humidity of
+// one DHT read). Writers must pass the locks in a consistent order.
+static inline void sensor_seqlock_write_many(sensor_seqlock_t *const *locks, size_t n,
+                                             const uint32_t (*words)[SENSOR_SEQLOCK_WORDS])
+{
+    for (size_t i = 0; i < n; i++)
+        sensor_seqlock_write_begin(locks[i]);
+    for (size_t i = 0; i < n; i++)
+        sensor_seqlock_store(locks[i], words[i]);
+    for (size_t i = 0; i < n; i++)
+        sensor_seqlock_write_end(locks[i]);
+}
+
+// Copies all entries as of one instant: no write to any of them overlapped
+// the copy. `starts` is scratch space for n sequences; the even sequences
+// that were read are left in it. Returns the number of retries.
+static inline uint32_t sensor_seqlock_read_many(sensor_seqlock_t *const *locks, size_t n,
+                                                uint32_t (*words)[SENSOR_SEQLOCK_WORDS],
+                                                uint32_t *starts)
+{
+    uint32_t retries = 0;
+    for (;;)
+    {
+        for (size_t i = 0; i < n; i++)
+            starts[i] = sensor_seqlock_read_begin(locks[i]);
+        for (size_t i = 0; i < n; i++)
+            sensor_seqlock_load(locks[i], words[i]);
+
+        atomic_thread_fence(memory_order_acquire);
+        bool stable = true;
+        for (size_t i = 0; i < n && stable; i++)
+            stable = atomic_load_explicit(&locks[i]->seq, memory_order_relaxed) == starts[i];
+        if (stable)
+            return retries;
+        retries++;
+    }
+}
+
+#endif // SENSOR_SEQLOCK_H
@@ -1,4 +0,0 @@
-#include "global.h"
-
-int16_t global_temperature = 0x7FFF; // Use 0x7FFF to indicate uninitialized state
-int16_t global_humidity = 0x7FFF;    // Use 0x7FFF to indicate uninitialized state
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "sensor_registry.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sensor_seqlock.h"
+
+// Payload layout of one entry
+enum
+{
+    W_VALUE = 0,
+    W_STATUS,
+    W_TS_LO,
+    W_TS_HI,
+};
+
+static sensor_seqlock_t s_entries[SENSOR_ID_COUNT];
+
+static const sensor_unit_t s_units[SENSOR_ID_COUNT] = {
+    [SENSOR_ID_TEMPERATURE] = SENSOR_UNIT_DECI_CELSIUS,
+    [SENSOR_ID_HUMIDITY] = SENSOR_UNIT_DECI_PERCENT,
+};
+
+// Publishes run with preemption off on their core, so a reader can never
+// find a write stalled half way: at worst it spins for the few stores a
+// writer on the other core has left.
+static portMUX_TYPE s_write_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool ids_ascending(const sensor_id_t *ids, size_t n)
+{
+    if (!ids || n == 0 || n > SENSOR_ID_COUNT)
+        return false;
+    for (size_t i = 0; i < n; i++)
+    {
+        if ((unsigned)ids[i] >= SENSOR_ID_COUNT || (i && ids[i] <= ids[i - 1]))
+            return false;
+    }
+    return true;
+}
+
+/*========== Writers ==========*/
+static void commit(const sensor_id_t *ids, const int32_t *values, size_t n, sensor_status_t status)
+{
+    const int64_t now = esp_timer_get_time();
+    sensor_seqlock_t *locks[SENSOR_ID_COUNT];
+    uint32_t words[SENSOR_ID_COUNT][SENSOR_SEQLOCK_WORDS];
+
+    taskENTER_CRITICAL(&s_write_mux);
+    for (size_t i = 0; i < n; i++)
+    {
+        locks[i] = &s_entries[ids[i]];
+        // Error updates keep the last good value
+        words[i][W_VALUE] = values ? (uint32_t)values[i]
+                                   : atomic_load_explicit(&locks[i]->words[W_VALUE], memory_order_relaxed);
+        words[i][W_STATUS] = (uint32_t)status;
+        words[i][W_TS_LO] = (uint32_t)now;
+        words[i][W_TS_HI] = (uint32_t)((uint64_t)now >> 32);
+    }
+    sensor_seqlock_write_many(locks, n, (const uint32_t(*)[SENSOR_SEQLOCK_WORDS])words);
+    taskEXIT_CRITICAL(&s_write_mux);
+}
+
+esp_err_t sensor_registry_publish(sensor_id_t id, int32_t value)
+{
+    return sensor_registry_publish_many(&id, &value, 1);
+}
+
+esp_err_t sensor_registry_publish_many(const sensor_id_t *ids, const int32_t *values, size_t n)
+{
+    if (!ids_ascending(ids, n) || !values)
+        return ESP_ERR_INVALID_ARG;
+    commit(ids, values, n, SENSOR_STATUS_OK);
+    return ESP_OK;
+}
+
+esp_err_t sensor_registry_set_error(const sensor_id_t *ids, size_t n)
+{
+    if (!ids_ascending(ids, n))
+        return ESP_ERR_INVALID_ARG;
+    commit(ids, NULL, n, SENSOR_STATUS_READ_ERROR);
+    return ESP_OK;
+}
+
+/*========== Readers ==========*/
+static void decode(sensor_id_t id, const uint32_t *words, uint32_t seq, sensor_snapshot_t *out)
+{
+    out->value = (int32_t)words[W_VALUE];
+    out->unit = s_units[id];
+    out->status = (sensor_status_t)words[W_STATUS];
+    out->timestamp_us = (int64_t)(((uint64_t)words[W_TS_HI] << 32) | words[W_TS_LO]);
+    out->seq = seq / 2;
+}
+
+esp_err_t sensor_registry_read(sensor_id_t id, sensor_snapshot_t *out)
+{
+    return sensor_registry_read_many(&id, 1, out);
+}
+
+esp_err_t sensor_registry_read_many(const sensor_id_t *ids, size_t n, sensor_snapshot_t *out)
+{
+    if (!ids || !out || n == 0 || n > SENSOR_ID_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    sensor_seqlock_t *locks[SENSOR_ID_COUNT];
+    uint32_t words[SENSOR_ID_COUNT][SENSOR_SEQLOCK_WORDS];
+    uint32_t seqs[SENSOR_ID_COUNT];
+    for (size_t i = 0; i < n; i++)
+    {
+        if ((unsigned)ids[i] >= SENSOR_ID_COUNT)
+            return ESP_ERR_INVALID_ARG;
+        locks[i] = &s_entries[ids[i]];
+    }
+
+    (void)sensor_seqlock_read_many(locks, n, words, seqs);
+    for (size_t i = 0; i < n; i++)
+        decode(ids[i], words[i], seqs[i], &out[i]);
+    return ESP_OK;
+}
+
+esp_err_t sensor_registry_read_climate(sensor_snapshot_t *temp, sensor_snapshot_t *hum)
+{
+    if (!temp || !hum)
+        return ESP_ERR_INVALID_ARG;
+    static const sensor_id_t ids[2] = {SENSOR_ID_TEMPERATURE, SENSOR_ID_HUMIDITY};
+    sensor_snapshot_t snap[2];
+    const esp_err_t err = sensor_registry_read_many(ids, 2, snap);
+    if (err != ESP_OK)
+        return err;
+    *temp = snap[0];
+    *hum = snap[1];
+    return ESP_OK;
+}
+
+const char *sensor_unit_str(sensor_unit_t unit)
+{
+    switch (unit)
+    {
+    case SENSOR_UNIT_DECI_CELSIUS:
+        return "C";
+    case SENSOR_UNIT_DECI_PERCENT:
+        return "%";
+    default:
+        return "";
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "req_gate.h"
+
+// Worker pool for esp_http_server handlers. A handler submitted through
+// httpd_async_submit() is detached from the httpd task with
+// httpd_req_async_handler_begin() and runs on one of
+// CONFIG_HTTPD_ASYNC_WORKERS tasks: a handler waiting on a slow client's
+// body or socket holds its worker, not the server. Admission is per route
+// (req_gate.h), so one slow endpoint cannot take every worker. One pool
+// for every server of the node (wifi_prov_http, telemetry_http).
+//
+// Headers are still read by the httpd task: keep the server's
+// recv_wait_timeout short.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HTTPD_ASYNC_TIMEOUT (-100) // httpd_async_recv(): the deadline passed
+
+    typedef esp_err_t (*httpd_async_handler_t)(httpd_req_t *req);
+
+    // Starts the workers. Safe to call more than once.
+    esp_err_t httpd_async_init(void);
+
+    // Route id for httpd_async_submit(), at most `max_inflight` requests
+    // queued or running; -1 on error. `name` is not copied. Registering a
+    // name again returns the same route.
+    int httpd_async_route(const char *name, uint16_t max_inflight);
+
+    // From a URI handler: queues `handler` for `req` and returns, or
+    // answers 503 with Retry-After when the route or the queue is full.
+    // Runs `handler` right away if the pool is not started.
+    esp_err_t httpd_async_submit(httpd_req_t *req, int route, httpd_async_handler_t handler);
+
+    // Reads `len` bytes of the body, giving up `timeout_ms` after the call
+    // however the client trickles them in. Returns `len`,
+    // HTTPD_ASYNC_TIMEOUT, or another negative value if the socket failed.
+    // After a timeout the session is closed once the handler returns: send
+    // the error reply, nothing more is read.
+    int httpd_async_recv(httpd_req_t *req, char *buf, size_t len, uint32_t timeout_ms);
+
+    // The same against a deadline from httpd_async_deadline(), for a body
+    // read in pieces
+    int64_t httpd_async_deadline(uint32_t timeout_ms);
+    int httpd_async_recv_until(httpd_req_t *req, char *buf, size_t len, int64_t deadline);
+
+    // Queue depth, busy workers and per-route counters
+    esp_err_t httpd_async_get_stats(req_gate_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Admission control of the HTTP worker pool: a request of a route is only
+// queued while the route is under its concurrency limit and the shared
+// queue has room; otherwise the server answers 503 at once instead of
+// holding the request. Counts queue depth, waits and service times per
+// route for /metrics.
+//
+// Plain C and not thread-safe: httpd_async.c calls it under its lock,
+// host_tools/httpd_async from its server model.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define REQ_GATE_MAX_ROUTES 8
+
+    typedef struct
+    {
+        const char *name;      // not copied
+        uint16_t max_inflight; // queued + running
+        uint16_t inflight;
+        uint16_t inflight_max;
+        uint32_t accepted;
+        uint32_t rejected;  // at the limit or the queue was full
+        uint32_t timed_out; // the handler gave up on a slow client
+        uint64_t wait_us;   // queued, summed over accepted requests
+        uint64_t service_us;
+        uint32_t wait_us_max;
+        uint32_t service_us_max;
+    } req_gate_route_t;
+
+    typedef struct
+    {
+        uint16_t queue_cap;
+        uint16_t queued; // waiting for a worker
+        uint16_t queued_max;
+        uint16_t workers;
+        uint16_t busy; // workers running a request
+        req_gate_route_t routes[REQ_GATE_MAX_ROUTES];
+        size_t n_routes;
+    } req_gate_t;
+
+    void req_gate_init(req_gate_t *g, uint16_t workers, uint16_t queue_cap);
+
+    // Route id, or -1 when REQ_GATE_MAX_ROUTES are taken or the limit is 0.
+    // A name already added keeps its id and counters and takes the new limit.
+    int req_gate_add_route(req_gate_t *g, const char *name, uint16_t max_inflight);
+
+    // True if a request of `route` may be queued; it is then counted until
+    // req_gate_done()
+    bool req_gate_admit(req_gate_t *g, int route);
+
+    // An admitted request that could not be queued after all
+    void req_gate_cancel(req_gate_t *g, int route);
+
+    // A worker took the request after `wait_us` in the queue
+    void req_gate_start(req_gate_t *g, int route, uint32_t wait_us);
+
+    // The worker finished it after `service_us`
+    void req_gate_done(req_gate_t *g, int route, uint32_t service_us, bool timed_out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "httpd_async.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+static const char *TAG = "HTTPD_ASYNC";
+
+typedef struct
+{
+    httpd_req_t *req; // the async copy
+    httpd_async_handler_t handler;
+    int route;
+    int64_t queued_us;
+} job_t;
+
+typedef struct
+{
+    TaskHandle_t task;
+    bool timed_out; // set by httpd_async_recv() for the running job
+} worker_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static QueueHandle_t s_jobs = NULL;
+static volatile bool s_running = false; // every worker started
+static req_gate_t s_gate; // s_lock
+static worker_t s_workers[CONFIG_HTTPD_ASYNC_WORKERS];
+
+static int64_t now_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+static worker_t *current_worker(void)
+{
+    const TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (size_t i = 0; i < CONFIG_HTTPD_ASYNC_WORKERS; i++)
+        if (s_workers[i].task == self)
+            return &s_workers[i];
+    return NULL;
+}
+
+static esp_err_t reply_busy(httpd_req_t *req)
+{
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    return httpd_resp_sendstr(req, "busy\n");
+}
+
+/*========== Workers ==========*/
+static void worker_task(void *arg)
+{
+    worker_t *w = arg;
+    for (;;)
+    {
+        job_t job;
+        if (xQueueReceive(s_jobs, &job, portMAX_DELAY) != pdTRUE)
+            continue;
+        const int64_t t0 = now_us();
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        req_gate_start(&s_gate, job.route, (uint32_t)(t0 - job.queued_us));
+        xSemaphoreGive(s_lock);
+
+        w->timed_out = false;
+        job.handler(job.req);
+        // Hands the socket back to the server, whatever the handler did
+        httpd_req_async_handler_complete(job.req);
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        req_gate_done(&s_gate, job.route, (uint32_t)(now_us() - t0), w->timed_out);
+        xSemaphoreGive(s_lock);
+    }
+}
+
+/*========== Public APIs ==========*/
+esp_err_t httpd_async_init(void)
+{
+    if (s_running)
+        return ESP_OK;
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    QueueHandle_t jobs = xQueueCreate(CONFIG_HTTPD_ASYNC_QUEUE, sizeof(job_t));
+    if (!lock || !jobs)
+    {
+        if (lock)
+            vSemaphoreDelete(lock);
+        if (jobs)
+            vQueueDelete(jobs);
+        return ESP_ERR_NO_MEM;
+    }
+    req_gate_init(&s_gate, CONFIG_HTTPD_ASYNC_WORKERS, CONFIG_HTTPD_ASYNC_QUEUE);
+    s_lock = lock;
+    s_jobs = jobs;
+
+    for (size_t i = 0; i < CONFIG_HTTPD_ASYNC_WORKERS; i++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "httpd_worker%u", (unsigned)i);
+        // Priority of the httpd task: neither starves the other
+        if (xTaskCreate(worker_task, name, CONFIG_HTTPD_ASYNC_STACK_SIZE, &s_workers[i], 5, &s_workers[i].task) !=
+            pdPASS)
+        {
+            ESP_LOGE(TAG, "Failed to start worker %u", (unsigned)i);
+            // Nothing was queued yet: the workers started are all blocked
+            // on the empty queue, none holds the lock
+            for (size_t j = 0; j < i; j++)
+                vTaskDelete(s_workers[j].task);
+            memset(s_workers, 0, sizeof(s_workers));
+            s_jobs = NULL;
+            s_lock = NULL;
+            vQueueDelete(jobs);
+            vSemaphoreDelete(lock);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // Handlers only queue once every worker exists
+    s_running = true;
+    ESP_LOGI(TAG, "%d workers, %d queued requests", CONFIG_HTTPD_ASYNC_WORKERS, CONFIG_HTTPD_ASYNC_QUEUE);
+    return ESP_OK;
+}
+
+int httpd_async_route(const char *name, uint16_t max_inflight)
+{
+    if (!s_lock || !name)
+        return -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const int route = req_gate_add_route(&s_gate, name, max_inflight);
+    xSemaphoreGive(s_lock);
+    return route;
+}
+
+esp_err_t httpd_async_submit(httpd_req_t *req, int route, httpd_async_handler_t handler)
+{
+    if (!s_running || route < 0)
+        return handler(req);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const bool admitted = req_gate_admit(&s_gate, route);
+    xSemaphoreGive(s_lock);
+    if (!admitted)
+        return reply_busy(req);
+
+    httpd_req_t *copy = NULL;
+    esp_err_t e = httpd_req_async_handler_begin(req, &copy);
+    if (e == ESP_OK)
+    {
+        const job_t job = {.req = copy, .handler = handler, .route = route, .queued_us = now_us()};
+        // Admission keeps the queue from filling up
+        if (xQueueSend(s_jobs, &job, 0) == pdTRUE)
+            return ESP_OK;
+        httpd_req_async_handler_complete(copy);
+        e = ESP_ERR_NO_MEM;
+    }
+    ESP_LOGW(TAG, "Cannot queue %s: %s", req->uri, esp_err_to_name(e));
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    req_gate_cancel(&s_gate, route);
+    xSemaphoreGive(s_lock);
+    return reply_busy(req);
+}
+
+int httpd_async_recv(httpd_req_t *req, char *buf, size_t len, uint32_t timeout_ms)
+{
+    return httpd_async_recv_until(req, buf, len, httpd_async_deadline(timeout_ms));
+}
+
+int64_t httpd_async_deadline(uint32_t timeout_ms)
+{
+    return now_us() + (int64_t)timeout_ms * 1000;
+}
+
+int httpd_async_recv_until(httpd_req_t *req, char *buf, size_t len, int64_t deadline)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        // Each call waits at most the server's recv_wait_timeout
+        const int r = httpd_req_recv(req, buf + got, len - got);
+        if (r > 0)
+            got += (size_t)r;
+        else if (r != HTTPD_SOCK_ERR_TIMEOUT)
+            return r < 0 ? r : HTTPD_SOCK_ERR_FAIL;
+        if (got < len && now_us() >= deadline)
+        {
+            worker_t *w = current_worker();
+            if (w)
+                w->timed_out = true;
+            // The server would drain the rest of the body at the client's pace
+            httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+            return HTTPD_ASYNC_TIMEOUT;
+        }
+    }
+    return (int)len;
+}
+
+esp_err_t httpd_async_get_stats(req_gate_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_gate;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include "req_gate.h"
+
+static req_gate_route_t *route_of(req_gate_t *g, int route)
+{
+    return route >= 0 && (size_t)route < g->n_routes ? &g->routes[route] : NULL;
+}
+
+/*========== Public APIs ==========*/
+void req_gate_init(req_gate_t *g, uint16_t workers, uint16_t queue_cap)
+{
+    memset(g, 0, sizeof(*g));
+    g->workers = workers;
+    g->queue_cap = queue_cap;
+}
+
+int req_gate_add_route(req_gate_t *g, const char *name, uint16_t max_inflight)
+{
+    if (!max_inflight)
+        return -1;
+    // Servers register their routes on every start
+    for (size_t i = 0; i < g->n_routes; i++)
+    {
+        if (!strcmp(g->routes[i].name, name))
+        {
+            g->routes[i].max_inflight = max_inflight;
+            return (int)i;
+        }
+    }
+    if (g->n_routes == REQ_GATE_MAX_ROUTES)
+        return -1;
+    req_gate_route_t *r = &g->routes[g->n_routes];
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    r->max_inflight = max_inflight;
+    return (int)g->n_routes++;
+}
+
+bool req_gate_admit(req_gate_t *g, int route)
+{
+    req_gate_route_t *r = route_of(g, route);
+    if (!r)
+        return false;
+    if (r->inflight >= r->max_inflight || g->queued >= g->queue_cap)
+    {
+        r->rejected++;
+        return false;
+    }
+    r->accepted++;
+    if (++r->inflight > r->inflight_max)
+        r->inflight_max = r->inflight;
+    if (++g->queued > g->queued_max)
+        g->queued_max = g->queued;
+    return true;
+}
+
+void req_gate_cancel(req_gate_t *g, int route)
+{
+    req_gate_route_t *r = route_of(g, route);
+    g->queued--;
+    if (!r)
+        return;
+    r->inflight--;
+    r->accepted--;
+}
+
+void req_gate_start(req_gate_t *g, int route, uint32_t wait_us)
+{
+    req_gate_route_t *r = route_of(g, route);
+    g->queued--;
+    g->busy++;
+    if (!r)
+        return;
+    r->wait_us += wait_us;
+    if (wait_us > r->wait_us_max)
+        r->wait_us_max = wait_us;
+}
+
+void req_gate_done(req_gate_t *g, int route, uint32_t service_us, bool timed_out)
+{
+    req_gate_route_t *r = route_of(g, route);
+    g->busy--;
+    if (!r)
+        return;
+    r->inflight--;
+    r->service_us += service_us;
+    if (service_us > r->service_us_max)
+        r->service_us_max = service_us;
+    r->timed_out += timed_out;
+}
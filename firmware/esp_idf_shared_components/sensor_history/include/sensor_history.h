@@ -0,0 +1,38 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sensor_registry.h"
+#include "tseries.h"
+
+// On-device history of every sensor_registry value: one tseries.h series
+// per sensor id, sized by menuconfig (CONFIG_SENSOR_HISTORY_*) and placed
+// in PSRAM when the board has it. Timestamps are seconds since boot.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Allocates all series. Safe to call more than once.
+    esp_err_t sensor_history_init(void);
+
+    // `sample_us` is esp_timer time, e.g. sensor_stats_t.last_ok_us.
+    // ESP_ERR_INVALID_STATE before init, ESP_ERR_INVALID_ARG if older than
+    // the previous sample of `id`.
+    esp_err_t sensor_history_add(sensor_id_t id, int64_t sample_us, int32_t value);
+
+    // tseries_query() on the series of `id`; 0 before init or for a bad id
+    size_t sensor_history_query(sensor_id_t id, uint32_t t0_s, uint32_t t1_s, tseries_point_t *out,
+                                size_t max_points, tseries_res_t *res);
+
+    // The clock of the timestamps
+    uint32_t sensor_history_now_s(void);
+
+    // Bytes allocated for all series
+    size_t sensor_history_mem_size(void);
+
+#ifdef __cplusplus
+}
+#endif
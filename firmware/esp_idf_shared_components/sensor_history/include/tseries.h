@@ -0,0 +1,117 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fixed-memory history of one value at three resolutions: a ring of raw
+// samples, a ring of 1-minute min/avg/max rollups and a ring of 1-hour
+// rollups. Both rollups are updated with every sample, so nothing is
+// recomputed when a bucket closes, and the oldest entries of each ring are
+// overwritten once it is full. Plain C on caller-provided memory: the
+// sensor_history component runs it on the gateway, host_tools/history_bench
+// on the PC.
+//
+// Timestamps are seconds on any clock that does not go backwards.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TSERIES_MINUTE_S 60u
+#define TSERIES_HOUR_S 3600u
+
+    typedef enum
+    {
+        TSERIES_RES_RAW = 0,
+        TSERIES_RES_MINUTE,
+        TSERIES_RES_HOUR,
+        TSERIES_RES_COUNT,
+    } tseries_res_t;
+
+    typedef struct
+    {
+        uint32_t t_s;
+        int32_t v;
+    } tseries_raw_t;
+
+    typedef struct
+    {
+        uint32_t t_s; // start of the bucket
+        int32_t min;
+        int32_t max;
+        int32_t avg; // rounded to nearest
+        uint32_t count;
+    } tseries_rollup_t;
+
+    // Query result; raw samples come back as min == avg == max, count 1
+    typedef struct
+    {
+        uint32_t t_s;
+        int32_t min;
+        int32_t avg;
+        int32_t max;
+        uint32_t count;
+    } tseries_point_t;
+
+    typedef struct
+    {
+        uint32_t raw;     // raw samples kept
+        uint32_t minutes; // 1-minute rollups kept
+        uint32_t hours;   // 1-hour rollups kept
+    } tseries_caps_t;
+
+    typedef struct
+    {
+        void *buf; // tseries_raw_t or tseries_rollup_t
+        uint32_t cap;
+        uint32_t head; // next write
+        uint32_t len;
+        bool wrapped; // has overwritten entries
+    } tseries_ring_t;
+
+    // Bucket being filled
+    typedef struct
+    {
+        uint32_t start_s;
+        int32_t min;
+        int32_t max;
+        int64_t sum;
+        uint32_t count; // 0: no open bucket
+    } tseries_acc_t;
+
+    typedef struct
+    {
+        tseries_ring_t ring[TSERIES_RES_COUNT];
+        tseries_acc_t open[TSERIES_RES_COUNT]; // MINUTE and HOUR only
+        uint32_t last_t_s;
+        uint32_t samples; // accepted since init
+    } tseries_t;
+
+    // Bytes of memory tseries_init needs for `caps`
+    size_t tseries_mem_size(const tseries_caps_t *caps);
+
+    // `mem` must be tseries_mem_size(caps) bytes, 4-byte aligned, and stay
+    // valid as long as `ts`
+    void tseries_init(tseries_t *ts, const tseries_caps_t *caps, void *mem);
+
+    // False (sample dropped) if `t_s` is older than the previous sample
+    bool tseries_add(tseries_t *ts, uint32_t t_s, int32_t v);
+
+    // Points in [t0_s, t1_s], oldest first, at the finest resolution that
+    // still holds t0_s (or everything since the first sample) and has at
+    // most `max_points` points in the range; failing that, the coarsest
+    // one, cut after `max_points` (continue from the last t_s + 1).
+    // Rollups include the bucket still being filled. Returns the number of
+    // points written; `res` (optional) gets the resolution used.
+    size_t tseries_query(const tseries_t *ts, uint32_t t0_s, uint32_t t1_s, tseries_point_t *out, size_t max_points,
+                         tseries_res_t *res);
+
+    // Oldest timestamp held at `res`; false if that tier is empty
+    bool tseries_oldest(const tseries_t *ts, tseries_res_t res, uint32_t *t_s);
+
+    const char *tseries_res_name(tseries_res_t res);
+
+#ifdef __cplusplus
+}
+#endif
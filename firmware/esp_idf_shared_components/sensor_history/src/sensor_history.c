@@ -0,0 +1,116 @@
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "sensor_history.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+static const char *TAG = "SENSOR_HISTORY";
+
+static SemaphoreHandle_t s_lock = NULL; // s_series
+static tseries_t s_series[SENSOR_ID_COUNT];
+static size_t s_mem_size = 0;
+
+static int64_t now_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+static void *alloc_series(size_t size)
+{
+#if CONFIG_SPIRAM
+    void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p)
+        return p;
+    ESP_LOGW(TAG, "No PSRAM for %u B, using internal RAM", (unsigned)size);
+#endif
+    return heap_caps_malloc(size, MALLOC_CAP_8BIT);
+}
+
+/*========== Public APIs ==========*/
+esp_err_t sensor_history_init(void)
+{
+    if (s_lock)
+        return ESP_OK;
+
+    const tseries_caps_t caps = {
+        .raw = CONFIG_SENSOR_HISTORY_RAW_SAMPLES,
+        .minutes = CONFIG_SENSOR_HISTORY_MINUTES,
+        .hours = CONFIG_SENSOR_HISTORY_HOURS,
+    };
+    const size_t size = tseries_mem_size(&caps);
+    void *mem[SENSOR_ID_COUNT] = {0};
+    for (int i = 0; i < SENSOR_ID_COUNT; i++)
+    {
+        mem[i] = alloc_series(size);
+        if (!mem[i])
+        {
+            ESP_LOGE(TAG, "Out of memory (%u B per series)", (unsigned)size);
+            for (int j = 0; j < i; j++)
+                heap_caps_free(mem[j]);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (!lock)
+    {
+        for (int i = 0; i < SENSOR_ID_COUNT; i++)
+            heap_caps_free(mem[i]);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < SENSOR_ID_COUNT; i++)
+        tseries_init(&s_series[i], &caps, mem[i]);
+    s_mem_size = size * SENSOR_ID_COUNT;
+    s_lock = lock;
+    ESP_LOGI(TAG, "%d series, %u raw / %u min / %u h each, %u B", SENSOR_ID_COUNT, (unsigned)caps.raw,
+             (unsigned)caps.minutes, (unsigned)caps.hours, (unsigned)s_mem_size);
+    return ESP_OK;
+}
+
+esp_err_t sensor_history_add(sensor_id_t id, int64_t sample_us, int32_t value)
+{
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    if ((int)id < 0 || id >= SENSOR_ID_COUNT || sample_us < 0)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const bool ok = tseries_add(&s_series[id], (uint32_t)(sample_us / 1000000), value);
+    xSemaphoreGive(s_lock);
+    return ok ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+size_t sensor_history_query(sensor_id_t id, uint32_t t0_s, uint32_t t1_s, tseries_point_t *out,
+                            size_t max_points, tseries_res_t *res)
+{
+    if (!s_lock || (int)id < 0 || id >= SENSOR_ID_COUNT || !out)
+        return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const size_t n = tseries_query(&s_series[id], t0_s, t1_s, out, max_points, res);
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+uint32_t sensor_history_now_s(void)
+{
+    return (uint32_t)(now_us() / 1000000);
+}
+
+size_t sensor_history_mem_size(void)
+{
+    return s_mem_size;
+}
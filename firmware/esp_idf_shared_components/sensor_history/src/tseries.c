@@ -0,0 +1,225 @@
+#include <string.h>
+
+#include "tseries.h"
+
+static const uint32_t s_width_s[TSERIES_RES_COUNT] = {
+    [TSERIES_RES_RAW] = 1,
+    [TSERIES_RES_MINUTE] = TSERIES_MINUTE_S,
+    [TSERIES_RES_HOUR] = TSERIES_HOUR_S,
+};
+
+/*========== Rings ==========*/
+static size_t elem_size(tseries_res_t res)
+{
+    return res == TSERIES_RES_RAW ? sizeof(tseries_raw_t) : sizeof(tseries_rollup_t);
+}
+
+static uint32_t phys_index(const tseries_ring_t *r, uint32_t i)
+{
+    return (r->head + r->cap - r->len + i) % r->cap;
+}
+
+static void *ring_push(tseries_ring_t *r, size_t size)
+{
+    if (r->cap == 0)
+    {
+        r->wrapped = true;
+        return NULL;
+    }
+    void *slot = (uint8_t *)r->buf + (size_t)r->head * size;
+    r->head = (r->head + 1) % r->cap;
+    if (r->len < r->cap)
+        r->len++;
+    else
+        r->wrapped = true;
+    return slot;
+}
+
+static int32_t acc_avg(const tseries_acc_t *a)
+{
+    const int64_t c = a->count;
+    return (int32_t)(a->sum >= 0 ? (a->sum + c / 2) / c : -((-a->sum + c / 2) / c));
+}
+
+// Entries of a tier as seen by queries: the ring, then the open bucket
+static uint32_t view_len(const tseries_t *ts, tseries_res_t res)
+{
+    return ts->ring[res].len + (res != TSERIES_RES_RAW && ts->open[res].count ? 1 : 0);
+}
+
+static void view_get(const tseries_t *ts, tseries_res_t res, uint32_t i, tseries_point_t *p)
+{
+    const tseries_ring_t *r = &ts->ring[res];
+    if (i >= r->len)
+    {
+        const tseries_acc_t *a = &ts->open[res];
+        *p = (tseries_point_t){a->start_s, a->min, acc_avg(a), a->max, a->count};
+        return;
+    }
+    if (res == TSERIES_RES_RAW)
+    {
+        const tseries_raw_t *e = (const tseries_raw_t *)r->buf + phys_index(r, i);
+        *p = (tseries_point_t){e->t_s, e->v, e->v, e->v, 1};
+    }
+    else
+    {
+        const tseries_rollup_t *e = (const tseries_rollup_t *)r->buf + phys_index(r, i);
+        *p = (tseries_point_t){e->t_s, e->min, e->avg, e->max, e->count};
+    }
+}
+
+static uint32_t view_time(const tseries_t *ts, tseries_res_t res, uint32_t i)
+{
+    const tseries_ring_t *r = &ts->ring[res];
+    if (i >= r->len)
+        return ts->open[res].start_s;
+    if (res == TSERIES_RES_RAW)
+        return ((const tseries_raw_t *)r->buf)[phys_index(r, i)].t_s;
+    return ((const tseries_rollup_t *)r->buf)[phys_index(r, i)].t_s;
+}
+
+// First index whose time is >= t (upper: > t)
+static uint32_t view_bound(const tseries_t *ts, tseries_res_t res, uint32_t t, bool upper)
+{
+    uint32_t lo = 0, hi = view_len(ts, res);
+    while (lo < hi)
+    {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        const uint32_t mt = view_time(ts, res, mid);
+        if (upper ? mt <= t : mt < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*========== Public APIs ==========*/
+size_t tseries_mem_size(const tseries_caps_t *caps)
+{
+    return (size_t)caps->raw * sizeof(tseries_raw_t) +
+           ((size_t)caps->minutes + caps->hours) * sizeof(tseries_rollup_t);
+}
+
+void tseries_init(tseries_t *ts, const tseries_caps_t *caps, void *mem)
+{
+    memset(ts, 0, sizeof(*ts));
+    uint8_t *p = (uint8_t *)mem;
+    const uint32_t cap[TSERIES_RES_COUNT] = {caps->raw, caps->minutes, caps->hours};
+    for (int res = 0; res < TSERIES_RES_COUNT; res++)
+    {
+        ts->ring[res].buf = p;
+        ts->ring[res].cap = cap[res];
+        p += (size_t)cap[res] * elem_size((tseries_res_t)res);
+    }
+}
+
+bool tseries_add(tseries_t *ts, uint32_t t_s, int32_t v)
+{
+    if (ts->samples && t_s < ts->last_t_s)
+        return false;
+
+    tseries_raw_t *raw = ring_push(&ts->ring[TSERIES_RES_RAW], sizeof(tseries_raw_t));
+    if (raw)
+        *raw = (tseries_raw_t){t_s, v};
+
+    for (int res = TSERIES_RES_MINUTE; res < TSERIES_RES_COUNT; res++)
+    {
+        tseries_acc_t *a = &ts->open[res];
+        const uint32_t start = t_s - t_s % s_width_s[res];
+        if (a->count && a->start_s != start)
+        {
+            // The sample opens a new bucket: the open one is final
+            tseries_rollup_t *e = ring_push(&ts->ring[res], sizeof(tseries_rollup_t));
+            if (e)
+                *e = (tseries_rollup_t){a->start_s, a->min, a->max, acc_avg(a), a->count};
+            a->count = 0;
+        }
+        if (a->count == 0)
+        {
+            *a = (tseries_acc_t){.start_s = start, .min = v, .max = v};
+        }
+        else
+        {
+            if (v < a->min)
+                a->min = v;
+            if (v > a->max)
+                a->max = v;
+        }
+        a->sum += v;
+        a->count++;
+    }
+
+    ts->last_t_s = t_s;
+    ts->samples++;
+    return true;
+}
+
+bool tseries_oldest(const tseries_t *ts, tseries_res_t res, uint32_t *t_s)
+{
+    if ((int)res < 0 || res >= TSERIES_RES_COUNT || view_len(ts, res) == 0)
+        return false;
+    *t_s = view_time(ts, res, 0);
+    return true;
+}
+
+size_t tseries_query(const tseries_t *ts, uint32_t t0_s, uint32_t t1_s, tseries_point_t *out, size_t max_points,
+                     tseries_res_t *res_out)
+{
+    if (t1_s < t0_s || max_points == 0 || ts->samples == 0)
+        return 0;
+
+    int chosen = -1;
+    uint32_t first = 0, end = 0;
+    for (int res = 0; res < TSERIES_RES_COUNT; res++)
+    {
+        const tseries_ring_t *r = &ts->ring[res];
+        uint32_t oldest;
+        if (!tseries_oldest(ts, (tseries_res_t)res, &oldest))
+            continue;
+        // A tier that dropped entries only counts if it still reaches t0
+        if (r->wrapped && oldest > t0_s)
+            continue;
+
+        // Buckets that started before t0 but reach into it count too
+        const uint32_t w = s_width_s[res];
+        const uint32_t lo = t0_s >= w - 1 ? t0_s - (w - 1) : 0;
+        const uint32_t f = view_bound(ts, (tseries_res_t)res, lo, false);
+        const uint32_t e = view_bound(ts, (tseries_res_t)res, t1_s, true);
+        chosen = res;
+        first = f;
+        end = e;
+        if (e - f <= max_points)
+            break;
+    }
+    if (chosen < 0)
+    {
+        // Every tier has dropped t0: the coarsest still has the most
+        chosen = TSERIES_RES_HOUR;
+        const uint32_t w = s_width_s[chosen];
+        first = view_bound(ts, (tseries_res_t)chosen, t0_s >= w - 1 ? t0_s - (w - 1) : 0, false);
+        end = view_bound(ts, (tseries_res_t)chosen, t1_s, true);
+    }
+
+    size_t n = 0;
+    for (uint32_t i = first; i < end && n < max_points; i++)
+        view_get(ts, (tseries_res_t)chosen, i, &out[n++]);
+    if (res_out)
+        *res_out = (tseries_res_t)chosen;
+    return n;
+}
+
+const char *tseries_res_name(tseries_res_t res)
+{
+    switch (res)
+    {
+    case TSERIES_RES_RAW:
+        return "raw";
+    case TSERIES_RES_MINUTE:
+        return "1min";
+    case TSERIES_RES_HOUR:
+        return "1h";
+    default:
+        return "?";
+    }
+}
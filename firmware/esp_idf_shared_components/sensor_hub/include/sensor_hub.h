@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sensor_sched.h"
+
+// One task reads every registered sensor at its own period (sensor_sched.h)
+// and hands each result to a sink, which stores/publishes it. Periods can
+// be changed at any time; the task wakes up to apply them.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SENSOR_HUB_TASK_STACK 3072
+#define SENSOR_HUB_TASK_PRIO 5
+
+    // Called from the hub task after every read. `values` (one per cap bit)
+    // is only valid when err == ESP_OK.
+    typedef void (*sensor_hub_sink_t)(int id, const sensor_driver_t *drv, esp_err_t err, const int32_t *values,
+                                      const sensor_stats_t *stats, void *ctx);
+
+    // Safe to call more than once
+    esp_err_t sensor_hub_init(void);
+
+    // `drv` must stay valid. ESP_ERR_NO_MEM when SENSOR_SCHED_MAX_DRIVERS are
+    // registered, ESP_ERR_INVALID_ARG for a driver without read/caps or with
+    // a default period below its minimum.
+    esp_err_t sensor_hub_register(const sensor_driver_t *drv, int *out_id);
+
+    // Starts the scheduler task; sensors registered later are picked up too
+    esp_err_t sensor_hub_start(sensor_hub_sink_t sink, void *ctx);
+
+    // ESP_ERR_INVALID_ARG for an unknown id or a period outside
+    // [min_period_ms, SENSOR_MAX_PERIOD_MS]
+    esp_err_t sensor_hub_set_period_ms(int id, uint32_t period_ms);
+    uint32_t sensor_hub_get_period_ms(int id); // 0 for an unknown id
+
+    // Id of the driver called `name`, -1 if none
+    int sensor_hub_find(const char *name);
+    int sensor_hub_count(void);
+
+    esp_err_t sensor_hub_get_stats(int id, sensor_stats_t *out);
+
+    // One line per sensor: success rate, latency, last error
+    void sensor_hub_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
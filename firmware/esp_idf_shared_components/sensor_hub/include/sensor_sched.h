@@ -0,0 +1,101 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Scheduler core of sensor_hub: which registered sensor to read next, and
+// the per-sensor statistics. No RTOS and no clock of its own (the caller
+// passes the time), so it runs unchanged under the linux target and in
+// host_tools/sensor_sched_check.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SENSOR_SCHED_MAX_DRIVERS 8
+#define SENSOR_MAX_VALUES 4         // values one read may return
+#define SENSOR_MAX_PERIOD_MS 3600000
+#define SENSOR_LAT_BUCKETS 8
+
+// Capability bit of a sensor_registry.h sensor_id_t
+#define SENSOR_CAP(id) (1u << (id))
+
+    // Fills one value per bit of `caps`, lowest bit first. Returns 0, or an
+    // error code (esp_err_t on the device) that ends up in the stats.
+    typedef int (*sensor_read_fn_t)(void *ctx, int32_t *values);
+
+    typedef struct
+    {
+        const char *name;           // for lookups and logs, not copied
+        uint32_t caps;              // SENSOR_CAP() of every value one read returns
+        uint32_t min_period_ms;     // fastest the part can be read
+        uint32_t default_period_ms; // >= min_period_ms
+        sensor_read_fn_t read;
+        void *ctx;
+    } sensor_driver_t;
+
+    // Upper bounds of the latency histogram buckets; the last bucket takes
+    // the rest
+    extern const uint32_t sensor_latency_bucket_us[SENSOR_LAT_BUCKETS - 1];
+
+    typedef struct
+    {
+        uint32_t reads;
+        uint32_t failures;
+        uint32_t consecutive_failures;
+        int32_t last_error; // 0 before the first failure
+        int64_t last_error_us;
+        int64_t last_ok_us;
+        uint32_t latency_us_last;
+        uint32_t latency_us_max;
+        uint32_t latency_hist[SENSOR_LAT_BUCKETS];
+    } sensor_stats_t;
+
+    typedef struct
+    {
+        const sensor_driver_t *drv;
+        uint32_t period_ms;
+        int64_t next_due_us;
+        int64_t last_start_us; // -1 before the first read
+        sensor_stats_t stats;
+    } sensor_slot_t;
+
+    typedef struct
+    {
+        sensor_slot_t slots[SENSOR_SCHED_MAX_DRIVERS];
+        int count;
+    } sensor_sched_t;
+
+    void sensor_sched_init(sensor_sched_t *s);
+
+    // Adds a driver at its default period, first read due at `now_us`.
+    // Returns its id, or -1 if the table is full or the driver invalid.
+    int sensor_sched_add(sensor_sched_t *s, const sensor_driver_t *drv, int64_t now_us);
+
+    // Applies from the last read: a shorter period can make the next read
+    // due right away. False for a bad id or a period outside
+    // [min_period_ms, SENSOR_MAX_PERIOD_MS].
+    bool sensor_sched_set_period(sensor_sched_t *s, int id, uint32_t period_ms, int64_t now_us);
+
+    // Time until the next read is due: 0 if one is due, -1 without drivers
+    int64_t sensor_sched_wait_us(const sensor_sched_t *s, int64_t now_us);
+
+    // Id of the most overdue sensor, or -1 if none is due. Its next read is
+    // scheduled one period on, or one period from now if that has already
+    // passed (no burst of catch-up reads), and never closer than
+    // min_period_ms.
+    int sensor_sched_take_due(sensor_sched_t *s, int64_t now_us);
+
+    // Records the outcome of the read started by take_due. If the read took
+    // past its next due time, the next one waits min_period_ms from now.
+    void sensor_sched_complete(sensor_sched_t *s, int id, int err, uint32_t latency_us, int64_t now_us);
+
+    // Successful reads per thousand, 0 before the first read
+    uint32_t sensor_stats_success_permille(const sensor_stats_t *st);
+
+    // Number of values a driver with `caps` returns
+    int sensor_caps_count(uint32_t caps);
+
+#ifdef __cplusplus
+}
+#endif
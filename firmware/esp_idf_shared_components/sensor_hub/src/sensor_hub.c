@@ -0,0 +1,226 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "sensor_hub.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+static const char *TAG = "SENSOR_HUB";
+
+static SemaphoreHandle_t s_lock = NULL; // s_sched
+static sensor_sched_t s_sched;
+static TaskHandle_t s_task = NULL;
+static sensor_hub_sink_t s_sink = NULL;
+static void *s_sink_ctx = NULL;
+
+static int64_t now_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+/*========== Scheduler task ==========*/
+static TickType_t wait_ticks(int64_t wait_us)
+{
+    if (wait_us < 0)
+        return portMAX_DELAY; // nothing registered yet
+    // Round up: waking a tick early would only loop once more
+    const int64_t ms = (wait_us + 999) / 1000;
+    return (TickType_t)((ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+}
+
+static void hub_task(void *arg)
+{
+    (void)arg;
+    int32_t values[SENSOR_MAX_VALUES];
+    while (1)
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        const int64_t t0 = now_us();
+        const int id = sensor_sched_take_due(&s_sched, t0);
+        const int64_t wait_us = id < 0 ? sensor_sched_wait_us(&s_sched, t0) : 0;
+        const sensor_driver_t *drv = id < 0 ? NULL : s_sched.slots[id].drv;
+        xSemaphoreGive(s_lock);
+
+        if (id < 0)
+        {
+            // Woken early by register/set_period
+            ulTaskNotifyTake(pdTRUE, wait_ticks(wait_us));
+            continue;
+        }
+
+        // The read runs unlocked: setters and stats readers never wait on it
+        memset(values, 0, sizeof(values));
+        const esp_err_t err = drv->read(drv->ctx, values);
+        const int64_t t1 = now_us();
+
+        sensor_stats_t st;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        const uint32_t failed_before = s_sched.slots[id].stats.consecutive_failures;
+        sensor_sched_complete(&s_sched, id, err, (uint32_t)(t1 - t0), t1);
+        st = s_sched.slots[id].stats;
+        xSemaphoreGive(s_lock);
+
+        if (err == ESP_OK)
+        {
+            if (failed_before)
+                ESP_LOGI(TAG, "%s: back after %u failed reads", drv->name, (unsigned)failed_before);
+            else
+                ESP_LOGD(TAG, "%s: ok in %u us", drv->name, (unsigned)st.latency_us_last);
+        }
+        else if ((st.consecutive_failures & (st.consecutive_failures - 1)) == 0)
+        {
+            // 1st, 2nd, 4th, 8th, ... failure in a row
+            ESP_LOGW(TAG, "%s: read failed (%s), %u in a row", drv->name, esp_err_to_name(err),
+                     (unsigned)st.consecutive_failures);
+        }
+
+        if (s_sink)
+            s_sink(id, drv, err, values, &st, s_sink_ctx);
+    }
+}
+
+/*========== Public APIs ==========*/
+esp_err_t sensor_hub_init(void)
+{
+    if (s_lock)
+        return ESP_OK;
+    sensor_sched_init(&s_sched);
+    s_lock = xSemaphoreCreateMutex();
+    return s_lock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t sensor_hub_register(const sensor_driver_t *drv, int *out_id)
+{
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    if (!drv)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const bool full = s_sched.count >= SENSOR_SCHED_MAX_DRIVERS;
+    const int id = full ? -1 : sensor_sched_add(&s_sched, drv, now_us());
+    xSemaphoreGive(s_lock);
+    if (id < 0)
+        return full ? ESP_ERR_NO_MEM : ESP_ERR_INVALID_ARG;
+
+    ESP_LOGI(TAG, "%s registered: id %d, caps 0x%x, every %u ms (min %u)", drv->name ? drv->name : "?", id,
+             (unsigned)drv->caps, (unsigned)drv->default_period_ms, (unsigned)drv->min_period_ms);
+    if (out_id)
+        *out_id = id;
+    if (s_task)
+        xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+esp_err_t sensor_hub_start(sensor_hub_sink_t sink, void *ctx)
+{
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    if (s_task)
+        return ESP_OK;
+    s_sink = sink;
+    s_sink_ctx = ctx;
+    if (xTaskCreate(hub_task, "sensor_hub", SENSOR_HUB_TASK_STACK, NULL, SENSOR_HUB_TASK_PRIO, &s_task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Create sensor_hub task failed");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sensor_hub_set_period_ms(int id, uint32_t period_ms)
+{
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const bool ok = sensor_sched_set_period(&s_sched, id, period_ms, now_us());
+    const char *name = ok ? s_sched.slots[id].drv->name : NULL;
+    xSemaphoreGive(s_lock);
+    if (!ok)
+        return ESP_ERR_INVALID_ARG;
+
+    ESP_LOGI(TAG, "%s: read period %u ms", name ? name : "?", (unsigned)period_ms);
+    if (s_task)
+        xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+uint32_t sensor_hub_get_period_ms(int id)
+{
+    if (!s_lock)
+        return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const uint32_t p = (id >= 0 && id < s_sched.count) ? s_sched.slots[id].period_ms : 0;
+    xSemaphoreGive(s_lock);
+    return p;
+}
+
+int sensor_hub_find(const char *name)
+{
+    if (!s_lock || !name)
+        return -1;
+    int found = -1;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < s_sched.count && found < 0; i++)
+        if (s_sched.slots[i].drv->name && strcmp(s_sched.slots[i].drv->name, name) == 0)
+            found = i;
+    xSemaphoreGive(s_lock);
+    return found;
+}
+
+int sensor_hub_count(void)
+{
+    if (!s_lock)
+        return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const int n = s_sched.count;
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+esp_err_t sensor_hub_get_stats(int id, sensor_stats_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (id >= 0 && id < s_sched.count)
+    {
+        *out = s_sched.slots[id].stats;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void sensor_hub_log_stats(void)
+{
+    const int n = sensor_hub_count();
+    for (int id = 0; id < n; id++)
+    {
+        sensor_stats_t st;
+        if (sensor_hub_get_stats(id, &st) != ESP_OK)
+            continue;
+        const uint32_t permille = sensor_stats_success_permille(&st);
+        ESP_LOGI(TAG, "%s: %u reads, %u.%u%% ok, latency last %u us max %u us, last error %s",
+                 s_sched.slots[id].drv->name, (unsigned)st.reads, (unsigned)(permille / 10),
+                 (unsigned)(permille % 10), (unsigned)st.latency_us_last, (unsigned)st.latency_us_max,
+                 st.last_error ? esp_err_to_name(st.last_error) : "none");
+    }
+}
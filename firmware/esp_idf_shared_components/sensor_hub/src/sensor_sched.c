@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include "sensor_sched.h"
+
+const uint32_t sensor_latency_bucket_us[SENSOR_LAT_BUCKETS - 1] = {
+    1000, 5000, 10000, 20000, 50000, 100000, 500000,
+};
+
+void sensor_sched_init(sensor_sched_t *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+int sensor_caps_count(uint32_t caps)
+{
+    int n = 0;
+    for (; caps; caps &= caps - 1)
+        n++;
+    return n;
+}
+
+int sensor_sched_add(sensor_sched_t *s, const sensor_driver_t *drv, int64_t now_us)
+{
+    if (s->count >= SENSOR_SCHED_MAX_DRIVERS || !drv || !drv->read || !drv->caps)
+        return -1;
+    if (sensor_caps_count(drv->caps) > SENSOR_MAX_VALUES)
+        return -1;
+    if (drv->default_period_ms < drv->min_period_ms || drv->default_period_ms > SENSOR_MAX_PERIOD_MS ||
+        drv->default_period_ms == 0)
+        return -1;
+
+    sensor_slot_t *slot = &s->slots[s->count];
+    memset(slot, 0, sizeof(*slot));
+    slot->drv = drv;
+    slot->period_ms = drv->default_period_ms;
+    slot->next_due_us = now_us;
+    slot->last_start_us = -1;
+    return s->count++;
+}
+
+bool sensor_sched_set_period(sensor_sched_t *s, int id, uint32_t period_ms, int64_t now_us)
+{
+    if (id < 0 || id >= s->count)
+        return false;
+    sensor_slot_t *slot = &s->slots[id];
+    if (period_ms < slot->drv->min_period_ms || period_ms > SENSOR_MAX_PERIOD_MS || period_ms == 0)
+        return false;
+
+    slot->period_ms = period_ms;
+    if (slot->last_start_us >= 0)
+    {
+        const int64_t due = slot->last_start_us + (int64_t)period_ms * 1000;
+        slot->next_due_us = due > now_us ? due : now_us;
+    }
+    return true;
+}
+
+int64_t sensor_sched_wait_us(const sensor_sched_t *s, int64_t now_us)
+{
+    if (s->count == 0)
+        return -1;
+    int64_t first = s->slots[0].next_due_us;
+    for (int i = 1; i < s->count; i++)
+        if (s->slots[i].next_due_us < first)
+            first = s->slots[i].next_due_us;
+    return first > now_us ? first - now_us : 0;
+}
+
+int sensor_sched_take_due(sensor_sched_t *s, int64_t now_us)
+{
+    int best = -1;
+    for (int i = 0; i < s->count; i++)
+    {
+        if (s->slots[i].next_due_us > now_us)
+            continue;
+        if (best < 0 || s->slots[i].next_due_us < s->slots[best].next_due_us)
+            best = i;
+    }
+    if (best < 0)
+        return -1;
+
+    sensor_slot_t *slot = &s->slots[best];
+    const int64_t period_us = (int64_t)slot->period_ms * 1000;
+    const int64_t min_next = now_us + (int64_t)slot->drv->min_period_ms * 1000;
+    int64_t next = slot->next_due_us + period_us;
+    if (next <= now_us)
+        next = now_us + period_us;
+    if (next < min_next)
+        next = min_next;
+    slot->next_due_us = next;
+    slot->last_start_us = now_us;
+    return best;
+}
+
+void sensor_sched_complete(sensor_sched_t *s, int id, int err, uint32_t latency_us, int64_t now_us)
+{
+    if (id < 0 || id >= s->count)
+        return;
+    sensor_slot_t *slot = &s->slots[id];
+    sensor_stats_t *st = &slot->stats;
+
+    // The read outlasted its period: give the part its minimum rest instead
+    // of starting the next read straight away
+    if (slot->next_due_us <= now_us)
+        slot->next_due_us = now_us + (int64_t)slot->drv->min_period_ms * 1000;
+
+    st->reads++;
+    st->latency_us_last = latency_us;
+    if (latency_us > st->latency_us_max)
+        st->latency_us_max = latency_us;
+    int b = 0;
+    while (b < SENSOR_LAT_BUCKETS - 1 && latency_us >= sensor_latency_bucket_us[b])
+        b++;
+    st->latency_hist[b]++;
+
+    if (err == 0)
+    {
+        st->consecutive_failures = 0;
+        st->last_ok_us = now_us;
+    }
+    else
+    {
+        st->failures++;
+        st->consecutive_failures++;
+        st->last_error = err;
+        st->last_error_us = now_us;
+    }
+}
+
+uint32_t sensor_stats_success_permille(const sensor_stats_t *st)
+{
+    if (st->reads == 0)
+        return 0;
+    return (uint32_t)((uint64_t)(st->reads - st->failures) * 1000 / st->reads);
+}
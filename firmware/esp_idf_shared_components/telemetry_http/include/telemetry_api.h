@@ -0,0 +1,176 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tlog.h"
+#include "tseries.h"
+
+// Request handling of the gateway's telemetry HTTP API. Plain C with no
+// HTTP stack of its own: the telemetry_http component runs it behind
+// esp_http_server, host_tools/telemetry_http behind a socket shim.
+//
+//   GET /status.json   newest reading and Wi-Fi state:
+//                      {"temp":25.3,"hum":60.1,"ok":true,"t":T,"seq":N,
+//                       "wifi_state":"connected"}
+//   GET /history       ?sensor=temperature|humidity, sensor_history points
+//                      at the finest resolution that fits `max`:
+//                      {"sensor":..,"res":"raw","from":T0,"to":T1,
+//                       "points":[[t,v],..]}   raw
+//                       "points":[[t,min,avg,max,count],..]   rollups
+//   GET /history       ?source=log, samples of the flash log (the default
+//                      source=history is sensor_history):
+//                      {"source":"log","from":T0,"to":T1,
+//                       "samples":[[t,temp,hum],..]}
+//   GET /metrics       Prometheus text format
+//
+// /history takes either from=T0&to=T1 or last=S (default 3600): the S
+// seconds up to the newest reading. Times are on the clock of the source,
+// seconds since boot for sensor_history and the telemetry_log clock for
+// source=log. `max` caps the points/samples; a reply that hit it ends with
+// "next":T, the `from` of the following page.
+//
+// A body is built in one caller-provided buffer and handed to the transport
+// whenever the buffer fills, so nothing is allocated per request and a
+// reply that fits goes out in one piece. /status.json and /history carry
+// an ETag that only changes with a new reading (or, for /status.json, the
+// Wi-Fi state): pollers sending If-None-Match get a bodyless 304 between
+// readings.
+//
+// One request at a time per telemetry_api_t: telemetry_http keeps one for
+// each request its workers may run at once.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TELEMETRY_API_CHANNELS 2 // temperature, humidity in tenths
+#define TELEMETRY_API_ETAG_MAX 24
+#define TELEMETRY_API_MIN_BUFFER 256
+#define TELEMETRY_API_LOG_BATCH 64 // log samples collected per tlog_query() call
+
+    typedef enum
+    {
+        TELEMETRY_API_TEMP = 0,
+        TELEMETRY_API_HUM,
+    } telemetry_api_channel_t;
+
+    typedef enum
+    {
+        TELEMETRY_API_ROUTE_STATUS = 0,
+        TELEMETRY_API_ROUTE_HISTORY,
+        TELEMETRY_API_ROUTE_METRICS,
+        TELEMETRY_API_ROUTE_OTHER, // 404
+        TELEMETRY_API_ROUTE_COUNT
+    } telemetry_api_route_t;
+
+    typedef struct
+    {
+        bool valid;   // a reading was taken
+        bool ok;      // the last read succeeded
+        int32_t value[TELEMETRY_API_CHANNELS];
+        uint32_t t_s; // time of the reading, sensor_history clock
+        uint32_t seq; // changes with every reading
+        const char *wifi_state;
+    } telemetry_api_status_t;
+
+    typedef struct telemetry_api telemetry_api_t;
+
+    typedef struct
+    {
+        uint32_t requests[TELEMETRY_API_ROUTE_COUNT];
+        uint32_t not_modified; // 304
+        uint32_t bad_requests; // 400
+        uint32_t unavailable;  // 503
+        uint32_t aborted;      // the transport failed mid-reply
+        uint64_t body_bytes;
+    } telemetry_api_stats_t;
+
+    // Where the data comes from; every callback must not block for long.
+    // log_query and log_range may be NULL (no flash log: source=log is 503).
+    typedef struct
+    {
+        void (*status)(telemetry_api_status_t *out, void *ctx);
+        size_t (*history)(telemetry_api_channel_t ch, uint32_t t0_s, uint32_t t1_s, tseries_point_t *out,
+                          size_t max_points, tseries_res_t *res, void *ctx);
+        size_t (*log_query)(uint32_t t0_s, uint32_t t1_s, tlog_sample_cb_t cb, void *cb_ctx, void *ctx);
+        bool (*log_range)(uint32_t *t_first, uint32_t *t_last, void *ctx);
+        // Adds node metrics with telemetry_api_metric_*() (optional)
+        void (*metrics)(telemetry_api_t *api, void *ctx);
+        // Request counters for /metrics when several instances serve one
+        // API (optional: the instance's own)
+        void (*stats)(telemetry_api_stats_t *out, void *ctx);
+        void *ctx;
+    } telemetry_api_source_t;
+
+    typedef struct
+    {
+        const char *status; // "200 OK", "304 Not Modified", ...
+        const char *content_type;
+        const char *etag;   // NULL: none
+    } telemetry_api_head_t;
+
+    // The HTTP side of one request. `head` runs once, before any body.
+    // `body` gets the body in order; `last` marks the final piece, which
+    // may be empty. A reply with a single piece is complete: it can go out
+    // with a Content-Length instead of chunked. Non-zero returns abort.
+    typedef struct
+    {
+        int (*head)(const telemetry_api_head_t *h, void *ctx);
+        int (*body)(const char *data, size_t len, bool last, void *ctx);
+        void *ctx;
+    } telemetry_api_transport_t;
+
+    typedef struct
+    {
+        size_t buffer_size;  // response buffer, >= TELEMETRY_API_MIN_BUFFER
+        size_t max_points;   // /history points per reply (sensor_history)
+        size_t max_samples;  // /history samples per reply (source=log)
+        telemetry_api_source_t source;
+    } telemetry_api_config_t;
+
+    struct telemetry_api
+    {
+        telemetry_api_config_t cfg;
+        char *buf;
+        size_t len;
+        tseries_point_t *points; // max_points
+        void *batch;             // TELEMETRY_API_LOG_BATCH log samples
+        size_t batch_len;
+        const telemetry_api_transport_t *tr; // of the request being handled
+        bool failed;
+        char etag[TELEMETRY_API_ETAG_MAX];
+        telemetry_api_stats_t stats;
+    };
+
+    // Bytes of memory telemetry_api_init needs
+    size_t telemetry_api_mem_size(const telemetry_api_config_t *cfg);
+
+    // `mem` must be telemetry_api_mem_size() bytes, 4-byte aligned, and
+    // stay valid as long as `api`. False for a bad config.
+    bool telemetry_api_init(telemetry_api_t *api, const telemetry_api_config_t *cfg, void *mem);
+
+    // Handles one GET. `uri` is the request target (path and query),
+    // `if_none_match` the header value or NULL. Returns 0, -1 if the
+    // transport failed.
+    int telemetry_api_handle(telemetry_api_t *api, const char *uri, const char *if_none_match,
+                             const telemetry_api_transport_t *tr);
+
+    // For the source's metrics callback: a metric's HELP/TYPE lines (type
+    // "gauge" or "counter"), then one line per sample. `labels` is the
+    // inside of the braces, e.g. "sensor=\"dht\"", or NULL.
+    void telemetry_api_metric_help(telemetry_api_t *api, const char *name, const char *type, const char *help);
+    void telemetry_api_metric(telemetry_api_t *api, const char *name, const char *labels, int64_t value);
+    // Same, value in tenths: 253 -> 25.3
+    void telemetry_api_metric_dec1(telemetry_api_t *api, const char *name, const char *labels, int32_t value);
+
+    // True if `if_none_match` (a header value) matches `etag`: any listed
+    // tag, weak or not, or "*"
+    bool telemetry_api_etag_match(const char *if_none_match, const char *etag);
+
+    const char *telemetry_api_route_name(telemetry_api_route_t route);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+#include "esp_err.h"
+#include "telemetry_api.h"
+#include "telemetry_push.h"
+
+// The gateway's telemetry API (telemetry_api.h) on esp_http_server, port
+// CONFIG_TELEMETRY_HTTP_PORT: /status.json, /history and /metrics from
+// sensor_registry, sensor_history and telemetry_log, and with
+// CONFIG_TELEMETRY_HTTP_WS every climate reading pushed to WebSocket
+// clients of /ws (telemetry_push.h). /history and /metrics run on the
+// httpd_async workers, at most CONFIG_TELEMETRY_HTTP_CONCURRENCY at once,
+// so a long reply to a slow reader does not hold up /status.json or /ws.
+// Runs while the gateway is a station; wifi_prov_http takes port 80 in
+// provisioning mode, so stop this server first.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Starts the server; the response buffers are allocated on the first
+    // start and kept. Safe to call more than once.
+    esp_err_t telemetry_http_start(void);
+
+    esp_err_t telemetry_http_stop(void);
+
+    // Counters of the API since the first start
+    esp_err_t telemetry_http_get_stats(telemetry_api_stats_t *out);
+
+    // Counters of /ws since the first start; ESP_ERR_NOT_SUPPORTED without
+    // CONFIG_TELEMETRY_HTTP_WS
+    esp_err_t telemetry_http_get_push_stats(telemetry_push_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
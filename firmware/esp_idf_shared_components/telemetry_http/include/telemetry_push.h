@@ -0,0 +1,115 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry_api.h"
+
+// Live readings pushed to WebSocket clients (GET /ws), one text frame per
+// reading in the format host_app's dashboard already reads:
+//
+//   {"seq":N,"temp_c":25.3,"humidity":60.1,"sample_us":T}
+//
+// Every update is serialized and framed once, into a ring of the last
+// `depth` + 1 frames shared by all clients. A client is only a cursor into
+// that ring (the frame it is on and how much of it went out), so the
+// transport can write to each socket without blocking and continue where
+// it stopped. A client more than `depth` frames behind skips to the
+// newest `depth` once its current frame is out; the skipped frames count
+// as dropped, and `seq` gaps show them to the client. A client that has
+// not finished a frame for `depth` + 1 updates is marked `closing`, as is
+// one still in the middle of the frame whose slot the ring needs.
+//
+// Plain C and not thread-safe: the telemetry_http component drives it
+// from its push task under a lock, host_tools/telemetry_http from its
+// poll loop.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TELEMETRY_PUSH_FRAME_HEADER 4 // text frame, payload < 64 KiB
+#define TELEMETRY_PUSH_PAYLOAD_MAX 120
+
+    typedef struct
+    {
+        size_t max_clients;
+        uint32_t depth; // frames queued per client before the oldest is dropped, >= 1
+    } telemetry_push_config_t;
+
+    typedef struct
+    {
+        int fd;            // -1: free slot
+        bool closing;      // too slow, the transport should close it
+        uint16_t offset;   // bytes of frame `next` already sent
+        uint32_t next;     // sequence number of the frame being sent
+        uint32_t progress; // head when it last finished a frame or was up to date
+        uint32_t frames;   // frames sent
+        uint32_t dropped;
+        uint32_t latency_max_us; // publish -> last byte handed to the socket
+        uint64_t latency_sum_us;
+    } telemetry_push_client_t;
+
+    typedef struct
+    {
+        uint32_t published;
+        uint32_t frames_sent;
+        uint32_t dropped;     // frames skipped by clients that fell behind
+        uint32_t slow_closed; // clients marked closing
+        uint32_t refused;     // connections over max_clients
+        uint32_t clients;     // connected now
+        uint32_t clients_max;
+        uint32_t latency_max_us;
+        uint64_t latency_sum_us; // over frames_sent
+        uint64_t bytes_sent;
+    } telemetry_push_stats_t;
+
+    typedef struct
+    {
+        uint8_t data[TELEMETRY_PUSH_FRAME_HEADER + TELEMETRY_PUSH_PAYLOAD_MAX];
+        uint16_t len;
+        int64_t publish_us;
+    } telemetry_push_frame_t;
+
+    typedef struct
+    {
+        telemetry_push_config_t cfg;
+        telemetry_push_client_t *clients; // max_clients
+        telemetry_push_frame_t *ring;     // depth + 1
+        uint32_t head;                    // sequence number of the next frame
+        telemetry_push_stats_t stats;
+    } telemetry_push_t;
+
+    // Bytes of memory telemetry_push_init needs
+    size_t telemetry_push_mem_size(const telemetry_push_config_t *cfg);
+
+    // `mem` must be telemetry_push_mem_size() bytes, 8-byte aligned, and
+    // stay valid as long as `p`. False for a bad config.
+    bool telemetry_push_init(telemetry_push_t *p, const telemetry_push_config_t *cfg, void *mem);
+
+    // A client on socket `fd`, after the WebSocket handshake. It starts
+    // with the newest frame. NULL when max_clients are connected.
+    telemetry_push_client_t *telemetry_push_add(telemetry_push_t *p, int fd);
+
+    // Forgets the client on `fd`, if any
+    void telemetry_push_remove(telemetry_push_t *p, int fd);
+
+    // Frames `payload` as one WebSocket text message and queues it for
+    // every client. False if it is longer than TELEMETRY_PUSH_PAYLOAD_MAX.
+    bool telemetry_push_publish(telemetry_push_t *p, const char *payload, size_t len, int64_t now_us);
+
+    // Publishes a reading (tenths, telemetry_api channel order) taken at
+    // `sample_us`
+    bool telemetry_push_reading(telemetry_push_t *p, const int32_t value[TELEMETRY_API_CHANNELS], int64_t sample_us,
+                                int64_t now_us);
+
+    // The bytes `c` should be sent next; 0 when it is up to date or closing
+    size_t telemetry_push_pending(telemetry_push_t *p, telemetry_push_client_t *c, const uint8_t **data);
+
+    // `n` of the pending bytes were written to the socket
+    void telemetry_push_sent(telemetry_push_t *p, telemetry_push_client_t *c, size_t n, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,667 @@
+#include <string.h>
+
+#include "telemetry_api.h"
+
+#define DEFAULT_LAST_S 3600u
+#define ALIGN4(x) (((x) + 3u) & ~(size_t)3u)
+
+typedef struct
+{
+    uint32_t t;
+    int32_t v[TELEMETRY_API_CHANNELS];
+} log_sample_t;
+
+static const char *const s_channel_names[TELEMETRY_API_CHANNELS] = {"temperature", "humidity"};
+
+/*========== Output ==========*/
+static void send_buffer(telemetry_api_t *api, bool last)
+{
+    if (api->failed)
+        return;
+    if (api->tr->body(api->buf, api->len, last, api->tr->ctx) != 0)
+    {
+        api->failed = true;
+        api->stats.aborted++;
+    }
+    api->stats.body_bytes += api->len;
+    api->len = 0;
+}
+
+static void put(telemetry_api_t *api, const char *s, size_t n)
+{
+    while (n && !api->failed)
+    {
+        if (api->len == api->cfg.buffer_size)
+            send_buffer(api, false);
+        size_t k = api->cfg.buffer_size - api->len;
+        if (k > n)
+            k = n;
+        memcpy(api->buf + api->len, s, k);
+        api->len += k;
+        s += k;
+        n -= k;
+    }
+}
+
+static void put_str(telemetry_api_t *api, const char *s)
+{
+    put(api, s, strlen(s));
+}
+
+static void put_u64(telemetry_api_t *api, uint64_t v)
+{
+    char tmp[20];
+    size_t i = sizeof(tmp);
+    do
+    {
+        tmp[--i] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    put(api, tmp + i, sizeof(tmp) - i);
+}
+
+static void put_i64(telemetry_api_t *api, int64_t v)
+{
+    if (v < 0)
+    {
+        put(api, "-", 1);
+        put_u64(api, (uint64_t)0 - (uint64_t)v);
+        return;
+    }
+    put_u64(api, (uint64_t)v);
+}
+
+// Tenths as a decimal: -5 -> -0.5
+static void put_dec1(telemetry_api_t *api, int32_t v)
+{
+    uint32_t m = (uint32_t)v;
+    if (v < 0)
+    {
+        put(api, "-", 1);
+        m = 0u - m;
+    }
+    put_u64(api, m / 10);
+    const char frac[2] = {'.', (char)('0' + m % 10)};
+    put(api, frac, 2);
+}
+
+static void put_json_str(telemetry_api_t *api, const char *s)
+{
+    put(api, "\"", 1);
+    for (; s && *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            put(api, "\\", 1);
+        if ((unsigned char)*s >= 0x20)
+            put(api, s, 1);
+    }
+    put(api, "\"", 1);
+}
+
+static int begin(telemetry_api_t *api, const char *status, const char *type, bool etag)
+{
+    const telemetry_api_head_t h = {.status = status, .content_type = type, .etag = etag ? api->etag : NULL};
+    if (api->tr->head(&h, api->tr->ctx) != 0)
+    {
+        api->failed = true;
+        api->stats.aborted++;
+        return -1;
+    }
+    return 0;
+}
+
+static int end(telemetry_api_t *api)
+{
+    send_buffer(api, true);
+    return api->failed ? -1 : 0;
+}
+
+static int reply_error(telemetry_api_t *api, const char *status, const char *msg)
+{
+    if (begin(api, status, "text/plain", false) != 0)
+        return -1;
+    put_str(api, msg);
+    put(api, "\n", 1);
+    return end(api);
+}
+
+static int reply_not_modified(telemetry_api_t *api)
+{
+    api->stats.not_modified++;
+    if (begin(api, "304 Not Modified", NULL, true) != 0)
+        return -1;
+    return end(api);
+}
+
+/*========== ETag ==========*/
+// FNV-1a
+#define FNV_INIT 2166136261u
+
+static uint32_t fnv(uint32_t h, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+static uint32_t fnv_u32(uint32_t h, uint32_t v)
+{
+    return fnv(h, &v, sizeof(v));
+}
+
+static void put_hex(char **p, uint32_t v, int min_digits)
+{
+    char tmp[8];
+    int n = 0;
+    do
+    {
+        tmp[n++] = "0123456789abcdef"[v & 0xF];
+        v >>= 4;
+    } while (v || n < min_digits);
+    while (n)
+        *(*p)++ = tmp[--n];
+}
+
+// "<seq>-<hash of everything else the body depends on>"
+static void make_etag(telemetry_api_t *api, uint32_t seq, uint32_t hash)
+{
+    char *p = api->etag;
+    *p++ = '"';
+    put_hex(&p, seq, 1);
+    *p++ = '-';
+    put_hex(&p, hash, 8);
+    *p++ = '"';
+    *p = 0;
+}
+
+// One entity tag of a list, without the W/ prefix; NULL at the end
+static const char *next_tag(const char *p, const char **tag, size_t *len)
+{
+    while (*p == ' ' || *p == '\t' || *p == ',')
+        p++;
+    if (!*p)
+        return NULL;
+    if (p[0] == 'W' && p[1] == '/')
+        p += 2;
+    const char *start = p;
+    if (*p == '"')
+    {
+        p = strchr(p + 1, '"');
+        p = p ? p + 1 : start + strlen(start);
+    }
+    else
+    {
+        while (*p && *p != ',' && *p != ' ' && *p != '\t')
+            p++;
+    }
+    *tag = start;
+    *len = (size_t)(p - start);
+    return p;
+}
+
+/*========== Query string ==========*/
+typedef enum
+{
+    PARAM_ABSENT = 0,
+    PARAM_OK,
+    PARAM_BAD,
+} param_t;
+
+// Value of `key` (not URL-decoded: every value here is a word or a number)
+static bool query_get(const char *q, const char *key, const char **val, size_t *len)
+{
+    const size_t klen = strlen(key);
+    while (q && *q)
+    {
+        const char *amp = strchr(q, '&');
+        const char *end = amp ? amp : q + strlen(q);
+        if ((size_t)(end - q) > klen && !strncmp(q, key, klen) && q[klen] == '=')
+        {
+            *val = q + klen + 1;
+            *len = (size_t)(end - *val);
+            return true;
+        }
+        q = amp ? amp + 1 : NULL;
+    }
+    return false;
+}
+
+static param_t query_u32(const char *q, const char *key, uint32_t *out)
+{
+    const char *v;
+    size_t len;
+    if (!query_get(q, key, &v, &len))
+        return PARAM_ABSENT;
+    if (len == 0 || len > 10)
+        return PARAM_BAD;
+    uint64_t n = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (v[i] < '0' || v[i] > '9')
+            return PARAM_BAD;
+        n = n * 10 + (uint64_t)(v[i] - '0');
+    }
+    if (n > UINT32_MAX)
+        return PARAM_BAD;
+    *out = (uint32_t)n;
+    return PARAM_OK;
+}
+
+// Index of the query value in `words`, -1 if absent, -2 if unknown
+static int query_word(const char *q, const char *key, const char *const *words, int n)
+{
+    const char *v;
+    size_t len;
+    if (!query_get(q, key, &v, &len))
+        return -1;
+    for (int i = 0; i < n; i++)
+        if (strlen(words[i]) == len && !strncmp(v, words[i], len))
+            return i;
+    return -2;
+}
+
+/*========== Routes ==========*/
+static int serve_status(telemetry_api_t *api, const char *if_none_match)
+{
+    telemetry_api_status_t st = {0};
+    api->cfg.source.status(&st, api->cfg.source.ctx);
+    const char *wifi = st.wifi_state ? st.wifi_state : "";
+    uint32_t h = fnv_u32(FNV_INIT, TELEMETRY_API_ROUTE_STATUS);
+    h = fnv_u32(h, (uint32_t)st.valid | (uint32_t)st.ok << 1);
+    h = fnv(h, wifi, strlen(wifi));
+    make_etag(api, st.seq, h);
+    if (if_none_match && telemetry_api_etag_match(if_none_match, api->etag))
+        return reply_not_modified(api);
+
+    if (begin(api, "200 OK", "application/json", true) != 0)
+        return -1;
+    for (int c = 0; c < TELEMETRY_API_CHANNELS; c++)
+    {
+        put_str(api, c == TELEMETRY_API_TEMP ? "{\"temp\":" : ",\"hum\":");
+        if (st.valid)
+            put_dec1(api, st.value[c]);
+        else
+            put_str(api, "null");
+    }
+    put_str(api, st.ok ? ",\"ok\":true,\"t\":" : ",\"ok\":false,\"t\":");
+    if (st.valid)
+        put_u64(api, st.t_s);
+    else
+        put_str(api, "null");
+    put_str(api, ",\"seq\":");
+    put_u64(api, st.seq);
+    put_str(api, ",\"wifi_state\":");
+    put_json_str(api, wifi);
+    put_str(api, "}\n");
+    return end(api);
+}
+
+static bool collect_sample(uint32_t t, const int32_t *values, void *ctx)
+{
+    telemetry_api_t *api = ctx;
+    log_sample_t *s = (log_sample_t *)api->batch + api->batch_len++;
+    s->t = t;
+    memcpy(s->v, values, sizeof(s->v));
+    return api->batch_len < TELEMETRY_API_LOG_BATCH;
+}
+
+// Log samples in [t0, t1], in batches: the log lock is held while a batch
+// is collected, never while the network is written
+static void put_log_samples(telemetry_api_t *api, uint32_t t0, uint32_t t1, size_t max)
+{
+    const log_sample_t *batch = (const log_sample_t *)api->batch;
+    size_t sent = 0;
+    bool more = true, has_next = false;
+    uint32_t t = t0, next = 0;
+    put_str(api, "\"samples\":[");
+    while (more && !api->failed)
+    {
+        api->batch_len = 0;
+        api->cfg.source.log_query(t, t1, collect_sample, api, api->cfg.source.ctx);
+        size_t n = api->batch_len;
+        more = n == TELEMETRY_API_LOG_BATCH;
+        if (more)
+        {
+            // More samples of the batch's last second may follow: leave
+            // them all to the next batch, unless the batch is nothing else
+            const uint32_t t_end = batch[n - 1].t;
+            size_t keep = n;
+            while (keep && batch[keep - 1].t == t_end)
+                keep--;
+            if (keep)
+            {
+                n = keep;
+                t = t_end;
+            }
+            else
+            {
+                more = t_end < t1;
+                t = t_end + 1;
+            }
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            if (sent == max)
+            {
+                has_next = true;
+                next = batch[i].t;
+                more = false;
+                break;
+            }
+            put_str(api, sent ? ",[" : "[");
+            put_u64(api, batch[i].t);
+            for (int c = 0; c < TELEMETRY_API_CHANNELS; c++)
+            {
+                put(api, ",", 1);
+                put_dec1(api, batch[i].v[c]);
+            }
+            put(api, "]", 1);
+            sent++;
+        }
+    }
+    put(api, "]", 1);
+    if (has_next)
+    {
+        put_str(api, ",\"next\":");
+        put_u64(api, next);
+    }
+}
+
+static void put_points(telemetry_api_t *api, const tseries_point_t *p, size_t n, tseries_res_t res)
+{
+    put_str(api, "\"points\":[");
+    for (size_t i = 0; i < n && !api->failed; i++)
+    {
+        put_str(api, i ? ",[" : "[");
+        put_u64(api, p[i].t_s);
+        put(api, ",", 1);
+        if (res == TSERIES_RES_RAW)
+        {
+            put_dec1(api, p[i].avg);
+        }
+        else
+        {
+            put_dec1(api, p[i].min);
+            put(api, ",", 1);
+            put_dec1(api, p[i].avg);
+            put(api, ",", 1);
+            put_dec1(api, p[i].max);
+            put(api, ",", 1);
+            put_u64(api, p[i].count);
+        }
+        put(api, "]", 1);
+    }
+    put(api, "]", 1);
+}
+
+static int serve_history(telemetry_api_t *api, const char *q, const char *if_none_match)
+{
+    static const char *const sources[] = {"history", "log"};
+    const telemetry_api_source_t *src = &api->cfg.source;
+    const int source = query_word(q, "source", sources, 2);
+    const int sensor = query_word(q, "sensor", s_channel_names, TELEMETRY_API_CHANNELS);
+    const bool from_log = source == 1;
+    if (source == -2 || sensor == -2 || (!from_log && sensor < 0))
+    {
+        api->stats.bad_requests++;
+        return reply_error(api, "400 Bad Request", "need sensor=temperature|humidity or source=log");
+    }
+    if (from_log && (!src->log_query || !src->log_range))
+    {
+        api->stats.unavailable++;
+        return reply_error(api, "503 Service Unavailable", "no flash log");
+    }
+
+    uint32_t from = 0, to = 0, last = DEFAULT_LAST_S;
+    const size_t cap = from_log ? api->cfg.max_samples : api->cfg.max_points;
+    uint32_t max = (uint32_t)cap;
+    const param_t p_from = query_u32(q, "from", &from);
+    const param_t p_to = query_u32(q, "to", &to);
+    const param_t p_last = query_u32(q, "last", &last);
+    const param_t p_max = query_u32(q, "max", &max);
+    if (p_from == PARAM_BAD || p_to == PARAM_BAD || p_last == PARAM_BAD || p_max == PARAM_BAD || max == 0 ||
+        (p_last == PARAM_OK && (p_from == PARAM_OK || p_to == PARAM_OK)))
+    {
+        api->stats.bad_requests++;
+        return reply_error(api, "400 Bad Request", "bad from/to/last/max");
+    }
+    if (max > cap)
+        max = (uint32_t)cap;
+
+    // The newest reading anchors `last` and a missing `to`
+    telemetry_api_status_t st = {0};
+    src->status(&st, src->ctx);
+    uint32_t first = 0, newest = st.valid ? st.t_s : 0;
+    if (from_log && !src->log_range(&first, &newest, src->ctx))
+        first = newest = 0;
+    uint32_t t0, t1;
+    if (p_from == PARAM_OK || p_to == PARAM_OK)
+    {
+        t0 = from;
+        t1 = p_to == PARAM_OK ? to : newest;
+    }
+    else
+    {
+        t1 = newest;
+        t0 = newest > last ? newest - last : 0;
+    }
+    if (t0 > t1)
+    {
+        api->stats.bad_requests++;
+        return reply_error(api, "400 Bad Request", "from > to");
+    }
+
+    uint32_t h = fnv_u32(FNV_INIT, TELEMETRY_API_ROUTE_HISTORY);
+    const uint32_t key[] = {(uint32_t)source, (uint32_t)sensor, t0, t1, max, first};
+    h = fnv(h, key, sizeof(key));
+    make_etag(api, st.seq, h);
+    if (if_none_match && telemetry_api_etag_match(if_none_match, api->etag))
+        return reply_not_modified(api);
+
+    // Query before the reply starts: a 200 is final
+    size_t n = 0;
+    tseries_res_t res = TSERIES_RES_RAW;
+    if (!from_log)
+        n = src->history((telemetry_api_channel_t)sensor, t0, t1, api->points, max, &res, src->ctx);
+
+    if (begin(api, "200 OK", "application/json", true) != 0)
+        return -1;
+    if (from_log)
+    {
+        put_str(api, "{\"source\":\"log\"");
+    }
+    else
+    {
+        put_str(api, "{\"sensor\":\"");
+        put_str(api, s_channel_names[sensor]);
+        put_str(api, "\",\"res\":\"");
+        put_str(api, tseries_res_name(res));
+        put(api, "\"", 1);
+    }
+    put_str(api, ",\"from\":");
+    put_u64(api, t0);
+    put_str(api, ",\"to\":");
+    put_u64(api, t1);
+    put(api, ",", 1);
+    if (from_log)
+    {
+        put_log_samples(api, t0, t1, max);
+    }
+    else
+    {
+        put_points(api, api->points, n, res);
+        if (n == max && api->points[n - 1].t_s < t1)
+        {
+            put_str(api, ",\"next\":");
+            put_u64(api, (uint64_t)api->points[n - 1].t_s + 1);
+        }
+    }
+    put_str(api, "}\n");
+    return end(api);
+}
+
+static int serve_metrics(telemetry_api_t *api)
+{
+    telemetry_api_status_t st = {0};
+    api->cfg.source.status(&st, api->cfg.source.ctx);
+
+    if (begin(api, "200 OK", "text/plain; version=0.0.4", false) != 0)
+        return -1;
+    if (st.valid)
+    {
+        telemetry_api_metric_help(api, "gateway_temperature_celsius", "gauge", "Newest temperature reading");
+        telemetry_api_metric_dec1(api, "gateway_temperature_celsius", NULL, st.value[TELEMETRY_API_TEMP]);
+        telemetry_api_metric_help(api, "gateway_humidity_percent", "gauge", "Newest relative humidity reading");
+        telemetry_api_metric_dec1(api, "gateway_humidity_percent", NULL, st.value[TELEMETRY_API_HUM]);
+    }
+    telemetry_api_metric_help(api, "gateway_reading_ok", "gauge", "1 if the last sensor read succeeded");
+    telemetry_api_metric(api, "gateway_reading_ok", NULL, st.ok);
+
+    telemetry_api_stats_t merged;
+    const telemetry_api_stats_t *s = &api->stats;
+    if (api->cfg.source.stats)
+    {
+        api->cfg.source.stats(&merged, api->cfg.source.ctx);
+        s = &merged;
+    }
+    telemetry_api_metric_help(api, "gateway_http_requests_total", "counter", "Telemetry API requests by route");
+    static const char *const route_labels[TELEMETRY_API_ROUTE_COUNT] = {
+        "route=\"status\"", "route=\"history\"", "route=\"metrics\"", "route=\"other\""};
+    for (int r = 0; r < TELEMETRY_API_ROUTE_COUNT; r++)
+        telemetry_api_metric(api, "gateway_http_requests_total", route_labels[r], s->requests[r]);
+    telemetry_api_metric_help(api, "gateway_http_not_modified_total", "counter", "304 replies to If-None-Match");
+    telemetry_api_metric(api, "gateway_http_not_modified_total", NULL, s->not_modified);
+    telemetry_api_metric_help(api, "gateway_http_errors_total", "counter", "Failed requests by cause");
+    telemetry_api_metric(api, "gateway_http_errors_total", "cause=\"bad_request\"", s->bad_requests);
+    telemetry_api_metric(api, "gateway_http_errors_total", "cause=\"unavailable\"", s->unavailable);
+    telemetry_api_metric(api, "gateway_http_errors_total", "cause=\"aborted\"", s->aborted);
+    telemetry_api_metric_help(api, "gateway_http_body_bytes_total", "counter", "Response body bytes sent");
+    telemetry_api_metric(api, "gateway_http_body_bytes_total", NULL, (int64_t)s->body_bytes);
+
+    if (api->cfg.source.metrics)
+        api->cfg.source.metrics(api, api->cfg.source.ctx);
+    return end(api);
+}
+
+/*========== Public APIs ==========*/
+size_t telemetry_api_mem_size(const telemetry_api_config_t *cfg)
+{
+    return ALIGN4(cfg->buffer_size) + cfg->max_points * sizeof(tseries_point_t) +
+           TELEMETRY_API_LOG_BATCH * sizeof(log_sample_t);
+}
+
+bool telemetry_api_init(telemetry_api_t *api, const telemetry_api_config_t *cfg, void *mem)
+{
+    if (!api || !cfg || !mem || cfg->buffer_size < TELEMETRY_API_MIN_BUFFER || !cfg->max_points ||
+        !cfg->max_samples || !cfg->source.status || !cfg->source.history)
+        return false;
+    memset(api, 0, sizeof(*api));
+    api->cfg = *cfg;
+    uint8_t *p = mem;
+    api->buf = (char *)p;
+    p += ALIGN4(cfg->buffer_size);
+    api->points = (tseries_point_t *)p;
+    p += cfg->max_points * sizeof(tseries_point_t);
+    api->batch = (void *)p;
+    return true;
+}
+
+int telemetry_api_handle(telemetry_api_t *api, const char *uri, const char *if_none_match,
+                         const telemetry_api_transport_t *tr)
+{
+    static const char *const paths[] = {"/status.json", "/history", "/metrics"};
+    api->tr = tr;
+    api->len = 0;
+    api->failed = false;
+
+    const char *q = strchr(uri, '?');
+    const size_t path_len = q ? (size_t)(q - uri) : strlen(uri);
+    telemetry_api_route_t route = TELEMETRY_API_ROUTE_OTHER;
+    for (int r = 0; r < TELEMETRY_API_ROUTE_OTHER; r++)
+        if (strlen(paths[r]) == path_len && !strncmp(uri, paths[r], path_len))
+            route = (telemetry_api_route_t)r;
+    api->stats.requests[route]++;
+
+    switch (route)
+    {
+    case TELEMETRY_API_ROUTE_STATUS:
+        return serve_status(api, if_none_match);
+    case TELEMETRY_API_ROUTE_HISTORY:
+        return serve_history(api, q ? q + 1 : "", if_none_match);
+    case TELEMETRY_API_ROUTE_METRICS:
+        return serve_metrics(api);
+    default:
+        return reply_error(api, "404 Not Found", "not found");
+    }
+}
+
+void telemetry_api_metric_help(telemetry_api_t *api, const char *name, const char *type, const char *help)
+{
+    put_str(api, "# HELP ");
+    put_str(api, name);
+    put(api, " ", 1);
+    put_str(api, help);
+    put_str(api, "\n# TYPE ");
+    put_str(api, name);
+    put(api, " ", 1);
+    put_str(api, type);
+    put(api, "\n", 1);
+}
+
+static void put_metric_name(telemetry_api_t *api, const char *name, const char *labels)
+{
+    put_str(api, name);
+    if (labels)
+    {
+        put(api, "{", 1);
+        put_str(api, labels);
+        put(api, "}", 1);
+    }
+    put(api, " ", 1);
+}
+
+void telemetry_api_metric(telemetry_api_t *api, const char *name, const char *labels, int64_t value)
+{
+    put_metric_name(api, name, labels);
+    put_i64(api, value);
+    put(api, "\n", 1);
+}
+
+void telemetry_api_metric_dec1(telemetry_api_t *api, const char *name, const char *labels, int32_t value)
+{
+    put_metric_name(api, name, labels);
+    put_dec1(api, value);
+    put(api, "\n", 1);
+}
+
+bool telemetry_api_etag_match(const char *if_none_match, const char *etag)
+{
+    // Weak comparison (RFC 9110 13.1.2): W/ prefixes are ignored
+    if (etag[0] == 'W' && etag[1] == '/')
+        etag += 2;
+    const size_t etag_len = strlen(etag);
+    const char *tag;
+    size_t len;
+    for (const char *p = if_none_match; (p = next_tag(p, &tag, &len));)
+    {
+        if ((len == 1 && tag[0] == '*') || (len == etag_len && !strncmp(tag, etag, len)))
+            return true;
+    }
+    return false;
+}
+
+const char *telemetry_api_route_name(telemetry_api_route_t route)
+{
+    switch (route)
+    {
+    case TELEMETRY_API_ROUTE_STATUS:
+        return "status";
+    case TELEMETRY_API_ROUTE_HISTORY:
+        return "history";
+    case TELEMETRY_API_ROUTE_METRICS:
+        return "metrics";
+    default:
+        return "other";
+    }
+}
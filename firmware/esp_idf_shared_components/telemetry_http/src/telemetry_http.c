@@ -0,0 +1,756 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "event_bus.h"
+#include "httpd_async.h"
+#include "sensor_history.h"
+#include "sensor_hub.h"
+#include "sensor_registry.h"
+#include "telemetry_http.h"
+#include "telemetry_log.h"
+#include "telemetry_push.h"
+#include "wifi_connect.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+static const char *TAG = "TELEMETRY_HTTP";
+
+// wifi_prov_http keeps the default control port
+#define TELEMETRY_HTTP_CTRL_PORT (ESP_HTTPD_DEF_CTRL_PORT + 1)
+
+// /status.json is answered on the httpd task by slot 0, a small instance;
+// /history and /metrics run on httpd_async workers, each request on a
+// free one of the other slots
+#define API_SLOTS (1 + CONFIG_TELEMETRY_HTTP_CONCURRENCY)
+#define STATUS_BUFFER_SIZE TELEMETRY_API_MIN_BUFFER
+#define STATUS_MAX_POINTS 16
+
+typedef struct
+{
+    telemetry_api_t api;
+    bool busy; // s_api_lock
+} api_slot_t;
+
+static httpd_handle_t s_server = NULL;
+static api_slot_t s_slots[API_SLOTS];
+static SemaphoreHandle_t s_api_lock = NULL;
+static void *s_api_mem = NULL;
+static int s_route = -1; // httpd_async route of the slow requests
+
+// Handler time, for /metrics; s_api_lock
+static uint64_t s_handler_us_total = 0;
+static uint32_t s_handler_us_max = 0;
+
+#if CONFIG_TELEMETRY_HTTP_WS
+// Retry period of sockets that took part of a frame
+#define PUSH_RETRY_MS 20
+
+static telemetry_push_t s_push;          // s_push_lock
+static SemaphoreHandle_t s_push_lock = NULL;
+static httpd_handle_t s_push_server = NULL; // s_push_lock: NULL while stopping
+static event_bus_sub_handle_t s_push_sub = NULL;
+#endif
+
+static int64_t now_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+/*========== Sources ==========*/
+static const char *wifi_state_name(wifi_conn_state_t st)
+{
+    switch (st)
+    {
+    case WIFI_CONN_STATE_CONNECTING:
+        return "connecting";
+    case WIFI_CONN_STATE_GOT_IP:
+        return "connected";
+    case WIFI_CONN_STATE_FAILED:
+        return "failed";
+    case WIFI_CONN_STATE_DISCONNECTED:
+        return "disconnected";
+    default:
+        return "idle";
+    }
+}
+
+static void src_status(telemetry_api_status_t *out, void *ctx)
+{
+    (void)ctx;
+    sensor_snapshot_t temp, hum;
+    if (sensor_registry_read_climate(&temp, &hum) == ESP_OK && temp.status != SENSOR_STATUS_NO_DATA)
+    {
+        out->valid = true;
+        out->ok = sensor_snapshot_ok(&temp) && sensor_snapshot_ok(&hum);
+        out->value[TELEMETRY_API_TEMP] = temp.value;
+        out->value[TELEMETRY_API_HUM] = hum.value;
+        out->t_s = (uint32_t)(temp.timestamp_us / 1000000);
+        out->seq = temp.seq;
+    }
+    out->wifi_state = wifi_state_name(wifi_conn_get_state());
+}
+
+static size_t src_history(telemetry_api_channel_t ch, uint32_t t0_s, uint32_t t1_s, tseries_point_t *out,
+                          size_t max_points, tseries_res_t *res, void *ctx)
+{
+    (void)ctx;
+    const sensor_id_t id = ch == TELEMETRY_API_TEMP ? SENSOR_ID_TEMPERATURE : SENSOR_ID_HUMIDITY;
+    return sensor_history_query(id, t0_s, t1_s, out, max_points, res);
+}
+
+static size_t src_log_query(uint32_t t0_s, uint32_t t1_s, tlog_sample_cb_t cb, void *cb_ctx, void *ctx)
+{
+    (void)ctx;
+    return telemetry_log_query(t0_s, t1_s, cb, cb_ctx);
+}
+
+static bool src_log_range(uint32_t *t_first, uint32_t *t_last, void *ctx)
+{
+    (void)ctx;
+    return telemetry_log_range(t_first, t_last);
+}
+
+// Counters of all slots, for /metrics and telemetry_http_get_stats(). Each
+// moves on the task handling its request; a torn read is off by one.
+static void src_stats(telemetry_api_stats_t *out, void *ctx)
+{
+    (void)ctx;
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < API_SLOTS; i++)
+    {
+        const telemetry_api_stats_t *s = &s_slots[i].api.stats;
+        for (int r = 0; r < TELEMETRY_API_ROUTE_COUNT; r++)
+            out->requests[r] += s->requests[r];
+        out->not_modified += s->not_modified;
+        out->bad_requests += s->bad_requests;
+        out->unavailable += s->unavailable;
+        out->aborted += s->aborted;
+        out->body_bytes += s->body_bytes;
+    }
+}
+
+// Labels of a series of httpd_async route `route`, `result` if not NULL.
+// Route names are not bounded: one too long for `out` leaves its series
+// out, logged once, since a cut label breaks the whole scrape
+static bool route_labels(char *out, size_t size, const char *route, const char *result)
+{
+    static bool warned = false;
+    const int n = result ? snprintf(out, size, "route=\"%s\",result=\"%s\"", route, result)
+                         : snprintf(out, size, "route=\"%s\"", route);
+    if (n >= 0 && (size_t)n < size)
+        return true;
+    if (!warned)
+        ESP_LOGW(TAG, "/metrics: route name \"%s\" too long, its series left out", route);
+    warned = true;
+    return false;
+}
+
+static void src_metrics(telemetry_api_t *api, void *ctx)
+{
+    (void)ctx;
+    char labels[64];
+
+    telemetry_api_metric_help(api, "gateway_uptime_seconds", "counter", "Seconds since boot");
+    telemetry_api_metric(api, "gateway_uptime_seconds", NULL, now_us() / 1000000);
+    telemetry_api_metric_help(api, "gateway_heap_free_bytes", "gauge", "Free heap, now and lowest since boot");
+    telemetry_api_metric(api, "gateway_heap_free_bytes", NULL, esp_get_free_heap_size());
+    telemetry_api_metric(api, "gateway_heap_free_bytes", "kind=\"min\"", esp_get_minimum_free_heap_size());
+
+    wifi_ap_record_t ap;
+    if (wifi_conn_get_state() == WIFI_CONN_STATE_GOT_IP && esp_wifi_sta_get_ap_info(&ap) == ESP_OK)
+    {
+        telemetry_api_metric_help(api, "gateway_wifi_rssi_dbm", "gauge", "Signal of the access point");
+        telemetry_api_metric(api, "gateway_wifi_rssi_dbm", NULL, ap.rssi);
+    }
+    wifi_conn_stats_t ws;
+    if (wifi_conn_get_stats(&ws) == ESP_OK)
+    {
+        if (ws.boot_to_ip_us)
+        {
+            telemetry_api_metric_help(api, "gateway_wifi_boot_to_ip_microseconds", "gauge", "Boot to the first IP");
+            telemetry_api_metric(api, "gateway_wifi_boot_to_ip_microseconds", NULL, ws.boot_to_ip_us);
+        }
+        telemetry_api_metric_help(api, "gateway_wifi_reconnect_microseconds", "gauge",
+                                  "Lost link to IP, last and slowest");
+        telemetry_api_metric(api, "gateway_wifi_reconnect_microseconds", NULL, ws.reconnect_last_us);
+        telemetry_api_metric(api, "gateway_wifi_reconnect_microseconds", "kind=\"max\"", ws.reconnect_max_us);
+        telemetry_api_metric_help(api, "gateway_wifi_reconnects_total", "counter", "Links lost and got back");
+        telemetry_api_metric(api, "gateway_wifi_reconnects_total", NULL, ws.reconnects);
+        telemetry_api_metric_help(api, "gateway_wifi_joins_total", "counter",
+                                  "Joins of the last access point, and full scans that gave an IP");
+        telemetry_api_metric(api, "gateway_wifi_joins_total", "kind=\"fast\"", ws.fast_hits);
+        telemetry_api_metric(api, "gateway_wifi_joins_total", "kind=\"fast_miss\"", ws.fast_misses);
+        telemetry_api_metric(api, "gateway_wifi_joins_total", "kind=\"scan\"", ws.scans);
+        telemetry_api_metric(api, "gateway_wifi_joins_total", "kind=\"failed\"", ws.failures);
+        telemetry_api_metric(api, "gateway_wifi_joins_total", "kind=\"refused\"", ws.refused);
+        telemetry_api_metric(api, "gateway_wifi_joins_total", "kind=\"timed_out\"", ws.timeouts);
+        telemetry_api_metric_help(api, "gateway_wifi_retries_total", "counter", "Joins after a failed one");
+        telemetry_api_metric(api, "gateway_wifi_retries_total", NULL, ws.retries);
+        telemetry_api_metric_help(api, "gateway_wifi_retry_airtime_microseconds_total", "counter",
+                                  "Radio time in joins that failed");
+        telemetry_api_metric(api, "gateway_wifi_retry_airtime_microseconds_total", NULL, ws.retry_airtime_us);
+        telemetry_api_metric_help(api, "gateway_wifi_backoff_microseconds_total", "counter",
+                                  "Time waited between joins");
+        telemetry_api_metric(api, "gateway_wifi_backoff_microseconds_total", NULL, ws.backoff_us);
+        telemetry_api_metric_help(api, "gateway_wifi_fallbacks_total", "counter", "Falls back to the provisioning AP");
+        telemetry_api_metric(api, "gateway_wifi_fallbacks_total", NULL, ws.fallbacks);
+        static const char *const reason_labels[WIFI_CONN_REASON_COUNT] = {
+            "reason=\"other\"", "reason=\"not_found\"", "reason=\"auth\"", "reason=\"link_lost\""};
+        telemetry_api_metric_help(api, "gateway_wifi_disconnects_total", "counter", "Disconnects by kind of reason");
+        for (int i = 0; i < WIFI_CONN_REASON_COUNT; i++)
+            telemetry_api_metric(api, "gateway_wifi_disconnects_total", reason_labels[i], ws.reasons[i]);
+    }
+
+    const int sensors = sensor_hub_count();
+    telemetry_api_metric_help(api, "gateway_sensor_reads_total", "counter", "Sensor reads by sensor_hub id");
+    for (int id = 0; id < sensors; id++)
+    {
+        sensor_stats_t st;
+        if (sensor_hub_get_stats(id, &st) != ESP_OK)
+            continue;
+        snprintf(labels, sizeof(labels), "sensor=\"%d\"", id);
+        telemetry_api_metric(api, "gateway_sensor_reads_total", labels, st.reads);
+        snprintf(labels, sizeof(labels), "sensor=\"%d\",result=\"fail\"", id);
+        telemetry_api_metric(api, "gateway_sensor_reads_total", labels, st.failures);
+    }
+
+    telemetry_api_metric_help(api, "gateway_events_published_total", "counter", "Event bus publishes by topic");
+    for (int t = 0; t < EVENT_TOPIC_COUNT; t++)
+    {
+        snprintf(labels, sizeof(labels), "topic=\"%d\"", t);
+        telemetry_api_metric(api, "gateway_events_published_total", labels, event_bus_published((event_topic_t)t));
+    }
+
+    tlog_stats_t ls;
+    if (telemetry_log_get_stats(&ls) == ESP_OK)
+    {
+        telemetry_api_metric_help(api, "gateway_log_samples_total", "counter", "Flash log samples since boot");
+        telemetry_api_metric(api, "gateway_log_samples_total", NULL, ls.samples_appended);
+        telemetry_api_metric(api, "gateway_log_samples_total", "kind=\"lost\"", ls.samples_lost);
+        telemetry_api_metric_help(api, "gateway_log_flash_bytes_total", "counter", "Bytes written to the log");
+        telemetry_api_metric(api, "gateway_log_flash_bytes_total", NULL, ls.bytes_written);
+        telemetry_api_metric_help(api, "gateway_log_erases_total", "counter", "Log sectors erased");
+        telemetry_api_metric(api, "gateway_log_erases_total", NULL, ls.sectors_erased);
+        telemetry_api_metric_help(api, "gateway_log_flash_errors_total", "counter", "Failed log flash operations");
+        telemetry_api_metric(api, "gateway_log_flash_errors_total", NULL, ls.flash_errors);
+    }
+
+    xSemaphoreTake(s_api_lock, portMAX_DELAY);
+    const uint64_t handler_us_total = s_handler_us_total;
+    const uint32_t handler_us_max = s_handler_us_max;
+    xSemaphoreGive(s_api_lock);
+    telemetry_api_metric_help(api, "gateway_http_handler_microseconds_total", "counter",
+                              "Time spent in API handlers, sending included");
+    telemetry_api_metric(api, "gateway_http_handler_microseconds_total", NULL, (int64_t)handler_us_total);
+    telemetry_api_metric_help(api, "gateway_http_handler_max_microseconds", "gauge", "Slowest API request");
+    telemetry_api_metric(api, "gateway_http_handler_max_microseconds", NULL, handler_us_max);
+
+    req_gate_t gate;
+    if (httpd_async_get_stats(&gate) == ESP_OK)
+    {
+        telemetry_api_metric_help(api, "gateway_http_queue_depth", "gauge", "Requests waiting for a worker");
+        telemetry_api_metric(api, "gateway_http_queue_depth", NULL, gate.queued);
+        telemetry_api_metric(api, "gateway_http_queue_depth", "kind=\"max\"", gate.queued_max);
+        telemetry_api_metric_help(api, "gateway_http_workers_busy", "gauge", "Workers running a request");
+        telemetry_api_metric(api, "gateway_http_workers_busy", NULL, gate.busy);
+        telemetry_api_metric_help(api, "gateway_http_queue_requests_total", "counter",
+                                  "Requests handed to the workers by route and outcome");
+        for (size_t i = 0; i < gate.n_routes; i++)
+        {
+            const req_gate_route_t *r = &gate.routes[i];
+            if (route_labels(labels, sizeof(labels), r->name, "accepted"))
+                telemetry_api_metric(api, "gateway_http_queue_requests_total", labels, r->accepted);
+            if (route_labels(labels, sizeof(labels), r->name, "rejected"))
+                telemetry_api_metric(api, "gateway_http_queue_requests_total", labels, r->rejected);
+            if (route_labels(labels, sizeof(labels), r->name, "timeout"))
+                telemetry_api_metric(api, "gateway_http_queue_requests_total", labels, r->timed_out);
+        }
+        telemetry_api_metric_help(api, "gateway_http_queue_inflight_max", "gauge",
+                                  "Most requests of a route queued or running at once");
+        for (size_t i = 0; i < gate.n_routes; i++)
+        {
+            if (route_labels(labels, sizeof(labels), gate.routes[i].name, NULL))
+                telemetry_api_metric(api, "gateway_http_queue_inflight_max", labels, gate.routes[i].inflight_max);
+        }
+        telemetry_api_metric_help(api, "gateway_http_queue_wait_microseconds_total", "counter",
+                                  "Time accepted requests spent queued");
+        for (size_t i = 0; i < gate.n_routes; i++)
+        {
+            if (route_labels(labels, sizeof(labels), gate.routes[i].name, NULL))
+                telemetry_api_metric(api, "gateway_http_queue_wait_microseconds_total", labels,
+                                     (int64_t)gate.routes[i].wait_us);
+        }
+        telemetry_api_metric_help(api, "gateway_http_queue_wait_max_microseconds", "gauge", "Longest queue wait");
+        for (size_t i = 0; i < gate.n_routes; i++)
+        {
+            if (route_labels(labels, sizeof(labels), gate.routes[i].name, NULL))
+                telemetry_api_metric(api, "gateway_http_queue_wait_max_microseconds", labels,
+                                     gate.routes[i].wait_us_max);
+        }
+    }
+
+#if CONFIG_TELEMETRY_HTTP_WS
+    if (!s_push_lock)
+        return;
+    xSemaphoreTake(s_push_lock, portMAX_DELAY);
+    const telemetry_push_stats_t ps = s_push.stats;
+    xSemaphoreGive(s_push_lock);
+    telemetry_api_metric_help(api, "gateway_ws_clients", "gauge", "WebSocket clients on /ws");
+    telemetry_api_metric(api, "gateway_ws_clients", NULL, ps.clients);
+    telemetry_api_metric(api, "gateway_ws_clients", "kind=\"max\"", ps.clients_max);
+    telemetry_api_metric_help(api, "gateway_ws_frames_total", "counter", "Readings pushed on /ws");
+    telemetry_api_metric(api, "gateway_ws_frames_total", "kind=\"published\"", ps.published);
+    telemetry_api_metric(api, "gateway_ws_frames_total", "kind=\"sent\"", ps.frames_sent);
+    telemetry_api_metric(api, "gateway_ws_frames_total", "kind=\"dropped\"", ps.dropped);
+    telemetry_api_metric_help(api, "gateway_ws_closed_total", "counter", "WebSocket clients closed or refused");
+    telemetry_api_metric(api, "gateway_ws_closed_total", "reason=\"slow\"", ps.slow_closed);
+    telemetry_api_metric(api, "gateway_ws_closed_total", "reason=\"full\"", ps.refused);
+    telemetry_api_metric_help(api, "gateway_ws_latency_microseconds_total", "counter",
+                              "Publish to last byte written, over sent frames");
+    telemetry_api_metric(api, "gateway_ws_latency_microseconds_total", NULL, (int64_t)ps.latency_sum_us);
+    telemetry_api_metric_help(api, "gateway_ws_latency_max_microseconds", "gauge", "Slowest frame");
+    telemetry_api_metric(api, "gateway_ws_latency_max_microseconds", NULL, ps.latency_max_us);
+#endif
+}
+
+/*========== esp_http_server transport ==========*/
+typedef struct
+{
+    httpd_req_t *req;
+    bool chunked;
+} req_ctx_t;
+
+static int tr_head(const telemetry_api_head_t *h, void *ctx)
+{
+    httpd_req_t *req = ((req_ctx_t *)ctx)->req;
+    // Header values are sent with the reply: `h` points into the slot's api or to literals
+    httpd_resp_set_status(req, h->status);
+    if (h->content_type)
+        httpd_resp_set_type(req, h->content_type);
+    if (h->etag)
+    {
+        httpd_resp_set_hdr(req, "ETag", h->etag);
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    }
+    return 0;
+}
+
+static int tr_body(const char *data, size_t len, bool last, void *ctx)
+{
+    req_ctx_t *rc = ctx;
+    // A body that fits the buffer goes out with a Content-Length
+    if (last && !rc->chunked)
+        return httpd_resp_send(rc->req, data, (ssize_t)len) == ESP_OK ? 0 : -1;
+    rc->chunked = true;
+    if (len && httpd_resp_send_chunk(rc->req, data, (ssize_t)len) != ESP_OK)
+        return -1;
+    if (last && httpd_resp_send_chunk(rc->req, NULL, 0) != ESP_OK)
+        return -1;
+    return 0;
+}
+
+static esp_err_t api_handle(telemetry_api_t *api, httpd_req_t *req)
+{
+    char if_none_match[96];
+    const int64_t t0 = now_us();
+    const bool has_inm =
+        httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK;
+
+    req_ctx_t rc = {.req = req};
+    const telemetry_api_transport_t tr = {.head = tr_head, .body = tr_body, .ctx = &rc};
+    const int r = telemetry_api_handle(api, req->uri, has_inm ? if_none_match : NULL, &tr);
+
+    const uint32_t us = (uint32_t)(now_us() - t0);
+    xSemaphoreTake(s_api_lock, portMAX_DELAY);
+    s_handler_us_total += us;
+    if (us > s_handler_us_max)
+        s_handler_us_max = us;
+    xSemaphoreGive(s_api_lock);
+    return r == 0 ? ESP_OK : ESP_FAIL;
+}
+
+// /status.json: a few hundred bytes from memory, not worth a worker
+static esp_err_t status_get_handler(httpd_req_t *req)
+{
+    return api_handle(&s_slots[0].api, req);
+}
+
+// On a worker, or on the httpd task if the pool did not start
+static esp_err_t api_worker(httpd_req_t *req)
+{
+    api_slot_t *slot = NULL;
+    xSemaphoreTake(s_api_lock, portMAX_DELAY);
+    for (size_t i = 1; i < API_SLOTS && !slot; i++)
+    {
+        if (!s_slots[i].busy)
+        {
+            slot = &s_slots[i];
+            slot->busy = true;
+        }
+    }
+    xSemaphoreGive(s_api_lock);
+    // The route limit keeps one free
+    if (!slot)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        return httpd_resp_sendstr(req, "busy\n");
+    }
+
+    const esp_err_t e = api_handle(&slot->api, req);
+    xSemaphoreTake(s_api_lock, portMAX_DELAY);
+    slot->busy = false;
+    xSemaphoreGive(s_api_lock);
+    return e;
+}
+
+// /history and /metrics: a long log range or a slow reader keeps a worker
+// busy, not the server
+static esp_err_t api_get_handler(httpd_req_t *req)
+{
+    return httpd_async_submit(req, s_route, api_worker);
+}
+
+/*========== WebSocket push ==========*/
+#if CONFIG_TELEMETRY_HTTP_WS
+// Writes what `c` can take without blocking; s_push_lock held. True if
+// part of a frame is left for later.
+static bool push_flush_client(telemetry_push_client_t *c)
+{
+    if (c->closing)
+    {
+        // Only requests the close: on_close() runs on the httpd task
+        if (s_push_server)
+            httpd_sess_trigger_close(s_push_server, c->fd);
+        telemetry_push_remove(&s_push, c->fd);
+        return false;
+    }
+    const uint8_t *data;
+    size_t n;
+    while (s_push_server && (n = telemetry_push_pending(&s_push, c, &data)) > 0)
+    {
+        const int r = httpd_socket_send(s_push_server, c->fd, (const char *)data, n, MSG_DONTWAIT);
+        if (r == HTTPD_SOCK_ERR_TIMEOUT)
+            return true; // socket buffer full
+        if (r <= 0)
+        {
+            c->closing = true;
+            return push_flush_client(c);
+        }
+        telemetry_push_sent(&s_push, c, (size_t)r, now_us());
+    }
+    return false;
+}
+
+// `arg`: the lock, s_push_lock is only set once this task exists
+static void push_task(void *arg)
+{
+    SemaphoreHandle_t lock = arg;
+    bool backlog = false;
+    for (;;)
+    {
+        event_bus_msg_t msg;
+        const esp_err_t e = event_bus_receive(s_push_sub, &msg, backlog ? pdMS_TO_TICKS(PUSH_RETRY_MS) : portMAX_DELAY);
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        if (e == ESP_OK)
+        {
+            const int32_t value[TELEMETRY_API_CHANNELS] = {msg.data.climate.temp_dc, msg.data.climate.hum_dpct};
+            telemetry_push_reading(&s_push, value, msg.data.climate.sample_us, now_us());
+        }
+        // Each frame is written once per client; a slow socket only
+        // delays its own client
+        backlog = false;
+        for (size_t i = 0; i < s_push.cfg.max_clients; i++)
+        {
+            if (s_push.clients[i].fd >= 0)
+                backlog |= push_flush_client(&s_push.clients[i]);
+        }
+        xSemaphoreGive(lock);
+    }
+}
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    const int fd = httpd_req_to_sockfd(req);
+    if (req->method == HTTP_GET)
+    {
+        // Handshake done: the client gets the newest reading right away
+        xSemaphoreTake(s_push_lock, portMAX_DELAY);
+        telemetry_push_client_t *c = telemetry_push_add(&s_push, fd);
+        if (c)
+            push_flush_client(c);
+        xSemaphoreGive(s_push_lock);
+        if (!c)
+            ESP_LOGW(TAG, "/ws: %u clients already, refused", (unsigned)s_push.cfg.max_clients);
+        return c ? ESP_OK : ESP_FAIL;
+    }
+
+    // Client messages (the dashboard's "ping") are read and dropped
+    uint8_t buf[32];
+    httpd_ws_frame_t frame = {0};
+    esp_err_t e = httpd_ws_recv_frame(req, &frame, 0);
+    if (e != ESP_OK || frame.len > sizeof(buf))
+        return ESP_FAIL;
+    frame.payload = buf;
+    if (frame.len && (e = httpd_ws_recv_frame(req, &frame, frame.len)) != ESP_OK)
+        return e;
+    if (frame.type == HTTPD_WS_TYPE_CLOSE)
+        return ESP_FAIL; // closes the session
+    if (frame.type != HTTPD_WS_TYPE_PING)
+        return ESP_OK;
+
+    // A pong must not land inside a frame the push task is half way through
+    xSemaphoreTake(s_push_lock, portMAX_DELAY);
+    bool mid_frame = false;
+    for (size_t i = 0; i < s_push.cfg.max_clients; i++)
+        mid_frame |= s_push.clients[i].fd == fd && s_push.clients[i].offset;
+    if (!mid_frame)
+    {
+        frame.type = HTTPD_WS_TYPE_PONG;
+        e = httpd_ws_send_frame(req, &frame);
+    }
+    xSemaphoreGive(s_push_lock);
+    return e;
+}
+
+// Session close of the server, WebSocket or not
+static void on_close(httpd_handle_t hd, int sockfd)
+{
+    (void)hd;
+    xSemaphoreTake(s_push_lock, portMAX_DELAY);
+    telemetry_push_remove(&s_push, sockfd);
+    xSemaphoreGive(s_push_lock);
+    close(sockfd);
+}
+
+static esp_err_t push_init(void)
+{
+    const telemetry_push_config_t cfg = {
+        .max_clients = CONFIG_TELEMETRY_HTTP_WS_MAX_CLIENTS,
+        .depth = CONFIG_TELEMETRY_HTTP_WS_DEPTH,
+    };
+    const size_t size = telemetry_push_mem_size(&cfg);
+    void *mem = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (!mem || !lock || !telemetry_push_init(&s_push, &cfg, mem))
+    {
+        heap_caps_free(mem);
+        if (lock)
+            vSemaphoreDelete(lock);
+        return mem && lock ? ESP_ERR_INVALID_ARG : ESP_ERR_NO_MEM;
+    }
+
+    // A dashboard wants the latest reading, not a backlog
+    const event_bus_sub_config_t sub_cfg = {
+        .name = "telemetry_ws",
+        .topics = EVENT_TOPIC_BIT(EVENT_TOPIC_CLIMATE),
+        .depth = 2,
+        .policy = EVENT_BUS_OVERWRITE_OLDEST,
+    };
+    esp_err_t err = event_bus_init();
+    if (err == ESP_OK)
+        err = event_bus_subscribe(&sub_cfg, &s_push_sub);
+    if (err == ESP_OK && xTaskCreate(push_task, "telemetry_ws", 3072, lock, 4, NULL) != pdPASS)
+        err = ESP_ERR_NO_MEM;
+    if (err != ESP_OK)
+    {
+        // No /ws then: nothing may stay subscribed without a reader
+        if (s_push_sub)
+            event_bus_unsubscribe(s_push_sub);
+        s_push_sub = NULL;
+        heap_caps_free(mem);
+        vSemaphoreDelete(lock);
+        return err;
+    }
+
+    s_push_lock = lock;
+    ESP_LOGI(TAG, "/ws: %u B for %u clients, %u frames queued each", (unsigned)size, (unsigned)cfg.max_clients,
+             (unsigned)cfg.depth);
+    return ESP_OK;
+}
+#endif
+
+/*========== Public APIs ==========*/
+esp_err_t telemetry_http_start(void)
+{
+    if (s_server)
+        return ESP_OK;
+
+    if (!s_api_mem)
+    {
+        tlog_stats_t ls;
+        const bool have_log = telemetry_log_get_stats(&ls) == ESP_OK;
+        telemetry_api_config_t cfg = {
+            .buffer_size = CONFIG_TELEMETRY_HTTP_BUFFER_SIZE,
+            .max_points = CONFIG_TELEMETRY_HTTP_MAX_POINTS,
+            .max_samples = CONFIG_TELEMETRY_HTTP_MAX_SAMPLES,
+            .source =
+                {
+                    .status = src_status,
+                    .history = src_history,
+                    .log_query = have_log ? src_log_query : NULL,
+                    .log_range = have_log ? src_log_range : NULL,
+                    .metrics = src_metrics,
+                    .stats = src_stats,
+                },
+        };
+        telemetry_api_config_t status_cfg = cfg;
+        status_cfg.buffer_size = STATUS_BUFFER_SIZE;
+        status_cfg.max_points = STATUS_MAX_POINTS;
+        const size_t status_size = (telemetry_api_mem_size(&status_cfg) + 3) & ~(size_t)3;
+        const size_t slot_size = (telemetry_api_mem_size(&cfg) + 3) & ~(size_t)3;
+        const size_t size = status_size + CONFIG_TELEMETRY_HTTP_CONCURRENCY * slot_size;
+        uint8_t *mem = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+        SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+        if (!mem || !lock)
+        {
+            heap_caps_free(mem);
+            if (lock)
+                vSemaphoreDelete(lock);
+            return ESP_ERR_NO_MEM;
+        }
+        bool ok = telemetry_api_init(&s_slots[0].api, &status_cfg, mem);
+        for (size_t i = 1; i < API_SLOTS; i++)
+            ok = ok && telemetry_api_init(&s_slots[i].api, &cfg, mem + status_size + (i - 1) * slot_size);
+        if (!ok)
+        {
+            heap_caps_free(mem);
+            vSemaphoreDelete(lock);
+            return ESP_ERR_INVALID_ARG;
+        }
+        s_api_lock = lock;
+        s_api_mem = mem;
+        ESP_LOGI(TAG, "%u B of buffers for %d requests%s", (unsigned)size, CONFIG_TELEMETRY_HTTP_CONCURRENCY,
+                 have_log ? "" : ", no flash log");
+
+        // Without workers every request runs on the httpd task as before
+        const esp_err_t ae = httpd_async_init();
+        if (ae == ESP_OK)
+            s_route = httpd_async_route("telemetry", CONFIG_TELEMETRY_HTTP_CONCURRENCY);
+        else
+            ESP_LOGW(TAG, "No HTTP workers: %s", esp_err_to_name(ae));
+
+#if CONFIG_TELEMETRY_HTTP_WS
+        const esp_err_t pe = push_init();
+        if (pe != ESP_OK)
+            ESP_LOGW(TAG, "/ws disabled: %s", esp_err_to_name(pe));
+#endif
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_TELEMETRY_HTTP_PORT;
+    config.ctrl_port = TELEMETRY_HTTP_CTRL_PORT;
+    config.lru_purge_enable = true;
+    // Bounds each wait of the httpd task on a client's headers
+    config.recv_wait_timeout = 2;
+#if CONFIG_TELEMETRY_HTTP_WS
+    if (s_push_lock)
+        config.close_fn = on_close;
+#endif
+    esp_err_t e = httpd_start(&s_server, &config);
+    if (e != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start HTTP server: %s", esp_err_to_name(e));
+        s_server = NULL;
+        return e;
+    }
+
+    const httpd_uri_t status = {.uri = "/status.json", .method = HTTP_GET, .handler = status_get_handler};
+    httpd_register_uri_handler(s_server, &status);
+    static const char *const uris[] = {"/history", "/metrics"};
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+    {
+        const httpd_uri_t uri = {.uri = uris[i], .method = HTTP_GET, .handler = api_get_handler};
+        httpd_register_uri_handler(s_server, &uri);
+    }
+#if CONFIG_TELEMETRY_HTTP_WS
+    if (s_push_lock)
+    {
+        const httpd_uri_t ws = {
+            .uri = "/ws",
+            .method = HTTP_GET,
+            .handler = ws_handler,
+            .is_websocket = true,
+            .handle_ws_control_frames = true,
+        };
+        httpd_register_uri_handler(s_server, &ws);
+        xSemaphoreTake(s_push_lock, portMAX_DELAY);
+        s_push_server = s_server;
+        xSemaphoreGive(s_push_lock);
+    }
+#endif
+    ESP_LOGI(TAG, "Telemetry API on port %d", config.server_port);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_http_stop(void)
+{
+    if (!s_server)
+        return ESP_OK;
+#if CONFIG_TELEMETRY_HTTP_WS
+    // The push task must not send through a server being torn down; the
+    // sessions it closes reach on_close(), which takes the lock
+    if (s_push_lock)
+    {
+        xSemaphoreTake(s_push_lock, portMAX_DELAY);
+        s_push_server = NULL;
+        xSemaphoreGive(s_push_lock);
+    }
+#endif
+    const esp_err_t e = httpd_stop(s_server);
+    if (e != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to stop HTTP server: %s", esp_err_to_name(e));
+        return e;
+    }
+    s_server = NULL;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_http_get_stats(telemetry_api_stats_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_api_mem)
+        return ESP_ERR_INVALID_STATE;
+    src_stats(out, NULL);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_http_get_push_stats(telemetry_push_stats_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+#if CONFIG_TELEMETRY_HTTP_WS
+    if (!s_push_lock)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_push_lock, portMAX_DELAY);
+    *out = s_push.stats;
+    xSemaphoreGive(s_push_lock);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
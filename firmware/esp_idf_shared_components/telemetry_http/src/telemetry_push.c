@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry_push.h"
+
+#define ALIGN8(x) (((x) + 7u) & ~(size_t)7u)
+
+static uint32_t ring_size(const telemetry_push_t *p)
+{
+    return p->cfg.depth + 1;
+}
+
+static telemetry_push_frame_t *frame(const telemetry_push_t *p, uint32_t seq)
+{
+    return &p->ring[seq % ring_size(p)];
+}
+
+// Between frames a client that fell behind jumps to the newest `depth`
+static void skip_ahead(telemetry_push_t *p, telemetry_push_client_t *c)
+{
+    const uint32_t behind = p->head - c->next;
+    if (behind > p->cfg.depth)
+    {
+        const uint32_t skip = behind - p->cfg.depth;
+        c->next += skip;
+        c->dropped += skip;
+        p->stats.dropped += skip;
+    }
+}
+
+// Tenths as a decimal: -5 -> -0.5
+static int format_dec1(char *out, size_t cap, int32_t v)
+{
+    const uint32_t m = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+    return snprintf(out, cap, "%s%lu.%lu", v < 0 ? "-" : "", (unsigned long)(m / 10), (unsigned long)(m % 10));
+}
+
+/*========== Public APIs ==========*/
+size_t telemetry_push_mem_size(const telemetry_push_config_t *cfg)
+{
+    return ALIGN8(cfg->max_clients * sizeof(telemetry_push_client_t)) +
+           ((size_t)cfg->depth + 1) * sizeof(telemetry_push_frame_t);
+}
+
+bool telemetry_push_init(telemetry_push_t *p, const telemetry_push_config_t *cfg, void *mem)
+{
+    if (!p || !cfg || !mem || !cfg->max_clients || !cfg->depth || cfg->depth > 0xFFFF)
+        return false;
+    memset(p, 0, sizeof(*p));
+    p->cfg = *cfg;
+    uint8_t *m = mem;
+    p->clients = (telemetry_push_client_t *)m;
+    m += ALIGN8(cfg->max_clients * sizeof(telemetry_push_client_t));
+    p->ring = (telemetry_push_frame_t *)m;
+    for (size_t i = 0; i < cfg->max_clients; i++)
+        p->clients[i] = (telemetry_push_client_t){.fd = -1};
+    return true;
+}
+
+telemetry_push_client_t *telemetry_push_add(telemetry_push_t *p, int fd)
+{
+    telemetry_push_client_t *free_slot = NULL;
+    for (size_t i = 0; i < p->cfg.max_clients; i++)
+    {
+        telemetry_push_client_t *c = &p->clients[i];
+        if (c->fd == fd)
+            return c; // already registered
+        if (c->fd < 0 && !free_slot)
+            free_slot = c;
+    }
+    if (!free_slot)
+    {
+        p->stats.refused++;
+        return NULL;
+    }
+    // The newest reading first, so a new dashboard has a value at once
+    *free_slot = (telemetry_push_client_t){.fd = fd, .next = p->head ? p->head - 1 : 0, .progress = p->head};
+    if (++p->stats.clients > p->stats.clients_max)
+        p->stats.clients_max = p->stats.clients;
+    return free_slot;
+}
+
+void telemetry_push_remove(telemetry_push_t *p, int fd)
+{
+    for (size_t i = 0; i < p->cfg.max_clients; i++)
+    {
+        telemetry_push_client_t *c = &p->clients[i];
+        if (c->fd == fd && fd >= 0)
+        {
+            c->fd = -1;
+            p->stats.clients--;
+            return;
+        }
+    }
+}
+
+bool telemetry_push_publish(telemetry_push_t *p, const char *payload, size_t len, int64_t now_us)
+{
+    if (len > TELEMETRY_PUSH_PAYLOAD_MAX)
+        return false;
+
+    // Close clients that have not finished a frame for a ring of updates,
+    // and any still writing the frame whose slot is about to be reused
+    const uint32_t evicted = p->head - ring_size(p);
+    for (size_t i = 0; i < p->cfg.max_clients; i++)
+    {
+        telemetry_push_client_t *c = &p->clients[i];
+        if (c->fd < 0 || c->closing)
+            continue;
+        if (c->next == p->head)
+            c->progress = p->head; // up to date
+        else if (p->head - c->progress >= ring_size(p) || (c->offset && c->next == evicted))
+        {
+            c->closing = true;
+            p->stats.slow_closed++;
+        }
+    }
+
+    // Server frames are unmasked: FIN + text opcode, then the length
+    telemetry_push_frame_t *f = frame(p, p->head);
+    size_t h = 0;
+    f->data[h++] = 0x81;
+    if (len < 126)
+    {
+        f->data[h++] = (uint8_t)len;
+    }
+    else
+    {
+        f->data[h++] = 126;
+        f->data[h++] = (uint8_t)(len >> 8);
+        f->data[h++] = (uint8_t)len;
+    }
+    memcpy(f->data + h, payload, len);
+    f->len = (uint16_t)(h + len);
+    f->publish_us = now_us;
+    p->head++;
+    p->stats.published++;
+    return true;
+}
+
+bool telemetry_push_reading(telemetry_push_t *p, const int32_t value[TELEMETRY_API_CHANNELS], int64_t sample_us,
+                            int64_t now_us)
+{
+    char temp[16], hum[16], json[TELEMETRY_PUSH_PAYLOAD_MAX + 1];
+    format_dec1(temp, sizeof(temp), value[TELEMETRY_API_TEMP]);
+    format_dec1(hum, sizeof(hum), value[TELEMETRY_API_HUM]);
+    const int n = snprintf(json, sizeof(json), "{\"seq\":%lu,\"temp_c\":%s,\"humidity\":%s,\"sample_us\":%lld}",
+                           (unsigned long)p->head, temp, hum, (long long)sample_us);
+    return n > 0 && (size_t)n < sizeof(json) && telemetry_push_publish(p, json, (size_t)n, now_us);
+}
+
+size_t telemetry_push_pending(telemetry_push_t *p, telemetry_push_client_t *c, const uint8_t **data)
+{
+    if (c->fd < 0 || c->closing)
+        return 0;
+    if (!c->offset)
+        skip_ahead(p, c);
+    if (c->next == p->head)
+        return 0;
+    const telemetry_push_frame_t *f = frame(p, c->next);
+    *data = f->data + c->offset;
+    return f->len - c->offset;
+}
+
+void telemetry_push_sent(telemetry_push_t *p, telemetry_push_client_t *c, size_t n, int64_t now_us)
+{
+    const telemetry_push_frame_t *f = frame(p, c->next);
+    c->offset = (uint16_t)(c->offset + n);
+    p->stats.bytes_sent += n;
+    if (c->offset < f->len)
+        return;
+
+    const uint32_t us = (uint32_t)(now_us - f->publish_us);
+    c->offset = 0;
+    c->next++;
+    c->progress = p->head;
+    c->frames++;
+    c->latency_sum_us += us;
+    if (us > c->latency_max_us)
+        c->latency_max_us = us;
+    p->stats.frames_sent++;
+    p->stats.latency_sum_us += us;
+    if (us > p->stats.latency_max_us)
+        p->stats.latency_max_us = us;
+}
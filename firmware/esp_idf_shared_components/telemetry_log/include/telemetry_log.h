@@ -0,0 +1,48 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "tlog.h"
+
+// Every climate reading from the event bus, kept on a dedicated flash
+// partition (CONFIG_TELEMETRY_LOG_PARTITION_LABEL) in tlog.h format, so
+// readings survive while no host is listening and across resets. Each
+// sample holds temperature and humidity in tenths.
+//
+// Timestamps are Unix seconds once the system clock is set. Before that
+// they continue from the newest logged sample plus the uptime, so they
+// still never go backwards. host_tools/telemetry_log/tlog_extract turns a
+// partition image into CSV.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TELEMETRY_LOG_CHANNELS 2 // temp_dc, hum_dpct
+
+    // Mounts the partition (repairing an interrupted write) and starts the
+    // logger task. ESP_ERR_NOT_FOUND without the partition.
+    esp_err_t telemetry_log_start(void);
+
+    // Writes the staged samples now (also done on esp_restart())
+    esp_err_t telemetry_log_flush(void);
+
+    // tlog_query() under the log lock: `cb` runs for every sample in
+    // [t0_s, t1_s] until it returns false, and must not block. 0 before
+    // start.
+    size_t telemetry_log_query(uint32_t t0_s, uint32_t t1_s, tlog_sample_cb_t cb, void *ctx);
+
+    // Time range held; false if empty or not started
+    bool telemetry_log_range(uint32_t *t_first, uint32_t *t_last);
+
+    // The clock of the timestamps
+    uint32_t telemetry_log_now_s(void);
+
+    esp_err_t telemetry_log_get_stats(tlog_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ts_codec.h"
+
+// Append-only sample log on raw NOR flash: a ring of erase sectors holding
+// ts_codec blocks. Sectors are filled and erased strictly in turn, so every
+// sector sees the same number of erase cycles. Once the ring is full the
+// oldest sector is erased for the newest. Plain C over tlog_flash_t:
+// the telemetry_log component runs it on an esp_partition,
+// host_tools/telemetry_log on a file-backed flash emulator.
+//
+// Sector layout (little endian):
+//
+//   0   u32 TLOG_MAGIC, u32 seq (+1 per sector opened), u8 channels,
+//       u8 TLOG_VERSION, u16 0xFFFF, u16 CRC-16 of the 12 bytes before,
+//       u16 0xFFFF
+//   16  seal, programmed once the sector is full: u32 t_first, u32 t_last,
+//       u32 samples, u16 bytes of blocks, u16 CRC-16 of the 14 before
+//   32  ts_codec blocks, each starting 4-byte aligned; 0xFF after the last
+//
+// Samples are staged in RAM and written as one block when the block is
+// full or on tlog_flush(). A power cut loses at most the staged samples.
+// Whatever reached flash is recovered on mount: the open sector is
+// scanned up to the first block failing its CRC, and a sector with a torn
+// write is closed so nothing is ever programmed over it.
+//
+// The in-RAM index keeps the time range of every sector (from the seal, or
+// the scan), and block headers carry their own range, so a query reads
+// only the sectors and blocks overlapping it.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TLOG_MAGIC 0x474F4C54u // "TLOG"
+#define TLOG_VERSION 1
+#define TLOG_SECTOR_HEADER 32
+#define TLOG_MIN_SECTORS 2
+#define TLOG_MIN_BLOCK 64
+#define TLOG_NO_SECTOR UINT32_MAX
+
+    typedef enum
+    {
+        TLOG_OK = 0,
+        TLOG_ERR_ARG,   // bad geometry, channels or block size
+        TLOG_ERR_IO,    // a flash operation failed
+        TLOG_ERR_ORDER, // timestamp older than the previous sample
+    } tlog_status_t;
+
+    // Flash access; each callback returns 0 on success. Writes only clear
+    // bits (NOR), erase sets a whole sector to 0xFF.
+    typedef struct
+    {
+        uint32_t size;        // bytes, a multiple of sector_size
+        uint32_t sector_size; // erase unit, e.g. 4096
+        int (*read)(void *ctx, uint32_t off, void *buf, size_t len);
+        int (*write)(void *ctx, uint32_t off, const void *buf, size_t len);
+        int (*erase)(void *ctx, uint32_t off); // the sector at `off`
+        void *ctx;
+    } tlog_flash_t;
+
+    typedef struct
+    {
+        uint32_t seq;     // 0: free
+        uint32_t t_first; // valid when samples > 0
+        uint32_t t_last;
+        uint32_t samples;
+        uint16_t used;    // bytes of blocks after the header
+        bool sealed;      // no more writes (seal programmed, or torn write)
+    } tlog_sector_t;
+
+    typedef struct
+    {
+        uint32_t samples_appended; // since mount
+        uint32_t blocks_written;
+        uint32_t bytes_written;    // blocks, headers and seals
+        uint32_t sectors_erased;
+        uint32_t samples_lost;     // dropped with erased sectors
+        uint32_t recovered_blocks; // valid blocks found at mount
+        uint32_t torn_sectors;     // closed at mount after a torn write
+        uint32_t flash_errors;
+    } tlog_stats_t;
+
+    typedef struct
+    {
+        uint32_t blocks_read;   // decoded
+        uint32_t blocks_skipped; // header only
+        uint32_t bytes_read;
+    } tlog_query_stats_t;
+
+    typedef struct
+    {
+        tlog_flash_t flash;
+        uint32_t sectors;
+        uint8_t channels;
+        size_t block_cap;
+
+        tlog_sector_t *index; // one per sector
+        uint32_t head;        // newest sector, TLOG_NO_SECTOR if none
+        uint32_t next_seq;
+        uint32_t last_t;
+        bool any;             // a sample was logged (last_t valid)
+
+        ts_codec_encoder_t enc; // staged block, in `stage`
+        uint8_t *stage;
+        uint8_t *read_buf;      // one sector's worth, for scans and queries
+        tlog_stats_t stats;
+    } tlog_t;
+
+    // Bytes of memory tlog_mount needs
+    size_t tlog_mem_size(const tlog_flash_t *flash, size_t block_cap);
+
+    // Rebuilds the index from `flash` and repairs an interrupted write.
+    // Sectors written with another channel count count as free.
+    // `block_cap` (TLOG_MIN_BLOCK .. sector_size - TLOG_SECTOR_HEADER) bounds
+    // a block, and so the staged samples a power cut can lose. `mem` must be
+    // tlog_mem_size() bytes, 4-byte aligned, and stay valid as long as `log`.
+    tlog_status_t tlog_mount(tlog_t *log, const tlog_flash_t *flash, int channels, size_t block_cap, void *mem);
+
+    // Stages one sample; writes the staged block first if it is full
+    tlog_status_t tlog_append(tlog_t *log, uint32_t t, const int32_t *values);
+
+    // Writes the staged samples, if any, as one block
+    tlog_status_t tlog_flush(tlog_t *log);
+
+    // Calls `cb` for every sample in [t0, t1], oldest first, staged ones
+    // included, until it returns false. Returns the count of samples passed
+    // to `cb`; `qs` (optional) gets what was read.
+    typedef bool (*tlog_sample_cb_t)(uint32_t t, const int32_t *values, void *ctx);
+    size_t tlog_query(tlog_t *log, uint32_t t0, uint32_t t1, tlog_sample_cb_t cb, void *ctx, tlog_query_stats_t *qs);
+
+    // Time range of everything held; false if empty
+    bool tlog_range(const tlog_t *log, uint32_t *t_first, uint32_t *t_last);
+
+    // Timestamp of the newest sample; false if none was ever logged
+    bool tlog_last_time(const tlog_t *log, uint32_t *t);
+
+    // Wipes the log (erases every sector)
+    tlog_status_t tlog_format(tlog_t *log);
+
+    const char *tlog_status_name(tlog_status_t s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,245 @@
+#include <time.h>
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+
+#include "event_bus.h"
+#include "telemetry_log.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_timer.h"
+#endif
+
+static const char *TAG = "TELEMETRY_LOG";
+
+// Earlier system times mean the clock was never set
+#define WALL_CLOCK_MIN 1000000000 // 2001-09-09
+
+static SemaphoreHandle_t s_lock = NULL; // s_log
+static tlog_t s_log;
+static const esp_partition_t *s_part = NULL;
+static event_bus_sub_handle_t s_sub = NULL;
+static uint32_t s_clock_base = 0; // log clock = base + uptime until the wall clock is set
+
+static int64_t now_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+/*========== Flash ==========*/
+static int part_read(void *ctx, uint32_t off, void *buf, size_t len)
+{
+    return esp_partition_read(ctx, off, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_write(void *ctx, uint32_t off, const void *buf, size_t len)
+{
+    return esp_partition_write(ctx, off, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_erase(void *ctx, uint32_t off)
+{
+    const esp_partition_t *p = ctx;
+    return esp_partition_erase_range(p, off, p->erase_size) == ESP_OK ? 0 : -1;
+}
+
+/*========== Clock ==========*/
+// Log time of a reading taken at esp_timer time `sample_us`
+static uint32_t log_time(int64_t sample_us)
+{
+    const time_t wall = time(NULL);
+    if (wall >= WALL_CLOCK_MIN)
+        return (uint32_t)(wall - (now_us() - sample_us) / 1000000);
+    return s_clock_base + (uint32_t)(sample_us / 1000000);
+}
+
+/*========== Logger task ==========*/
+static void append_reading(const event_climate_t *c)
+{
+    const int32_t v[TELEMETRY_LOG_CHANNELS] = {c->temp_dc, c->hum_dpct};
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t t = log_time(c->sample_us), last;
+    if (tlog_last_time(&s_log, &last) && t < last)
+        t = last; // wall clock stepped back
+    const tlog_status_t st = tlog_append(&s_log, t, v);
+    xSemaphoreGive(s_lock);
+    if (st != TLOG_OK)
+        ESP_LOGW(TAG, "append failed: %s", tlog_status_name(st));
+}
+
+static void telemetry_log_task(void *arg)
+{
+    (void)arg;
+    // Until telemetry_log_start() has published s_lock
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    const TickType_t period = pdMS_TO_TICKS(CONFIG_TELEMETRY_LOG_FLUSH_S * 1000);
+    TickType_t last_flush = xTaskGetTickCount();
+    while (1)
+    {
+        const TickType_t age = xTaskGetTickCount() - last_flush;
+        event_bus_msg_t msg;
+        if (event_bus_receive(s_sub, &msg, age >= period ? 0 : period - age) == ESP_OK)
+            append_reading(&msg.data.climate);
+
+        if (xTaskGetTickCount() - last_flush >= period)
+        {
+            telemetry_log_flush();
+            last_flush = xTaskGetTickCount();
+        }
+    }
+}
+
+static void flush_on_restart(void)
+{
+    // Runs in esp_restart(): don't wait on a lock held by a stopped task
+    if (s_lock && xSemaphoreTake(s_lock, pdMS_TO_TICKS(100)) == pdTRUE)
+    {
+        tlog_flush(&s_log);
+        xSemaphoreGive(s_lock);
+    }
+}
+
+/*========== Public APIs ==========*/
+esp_err_t telemetry_log_start(void)
+{
+    if (s_lock)
+        return ESP_OK;
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                      CONFIG_TELEMETRY_LOG_PARTITION_LABEL);
+    if (!s_part)
+    {
+        ESP_LOGW(TAG, "No \"%s\" partition, not logging", CONFIG_TELEMETRY_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const tlog_flash_t flash = {
+        .size = s_part->size - s_part->size % s_part->erase_size,
+        .sector_size = s_part->erase_size,
+        .read = part_read,
+        .write = part_write,
+        .erase = part_erase,
+        .ctx = (void *)s_part,
+    };
+    const size_t mem_size = tlog_mem_size(&flash, CONFIG_TELEMETRY_LOG_BLOCK_SIZE);
+    void *mem = heap_caps_malloc(mem_size, MALLOC_CAP_8BIT);
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (!mem || !lock)
+    {
+        heap_caps_free(mem);
+        if (lock)
+            vSemaphoreDelete(lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    const int64_t t0 = now_us();
+    const tlog_status_t st = tlog_mount(&s_log, &flash, TELEMETRY_LOG_CHANNELS, CONFIG_TELEMETRY_LOG_BLOCK_SIZE, mem);
+    if (st != TLOG_OK)
+    {
+        ESP_LOGE(TAG, "mount failed: %s", tlog_status_name(st));
+        heap_caps_free(mem);
+        vSemaphoreDelete(lock);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint32_t first = 0, last = 0;
+    const bool any = tlog_range(&s_log, &first, &last);
+    // Without a wall clock, carry on from the newest sample
+    s_clock_base = any ? last + 1 : 0;
+    ESP_LOGI(TAG, "%u KB, %u sectors, %u B RAM; %s %u..%u; mount %lld ms, %u blocks rescanned, %u torn",
+             (unsigned)(flash.size / 1024), (unsigned)s_log.sectors, (unsigned)mem_size, any ? "holds" : "empty",
+             (unsigned)first, (unsigned)last, (long long)((now_us() - t0) / 1000),
+             (unsigned)s_log.stats.recovered_blocks, (unsigned)s_log.stats.torn_sectors);
+
+    // Every reading is logged; a backlog only builds up during a flush
+    const event_bus_sub_config_t sub_cfg = {
+        .name = "telemetry_log",
+        .topics = EVENT_TOPIC_BIT(EVENT_TOPIC_CLIMATE),
+        .depth = 16,
+        .policy = EVENT_BUS_DROP_NEWEST,
+    };
+    TaskHandle_t task = NULL;
+    esp_err_t err = event_bus_init();
+    if (err == ESP_OK)
+        err = event_bus_subscribe(&sub_cfg, &s_sub);
+    if (err == ESP_OK && xTaskCreate(telemetry_log_task, "telemetry_log", 3072, NULL, 3, &task) != pdPASS)
+        err = ESP_ERR_NO_MEM;
+    if (err != ESP_OK)
+    {
+        // Not started: nothing was written since the mount, nothing to keep
+        if (s_sub)
+            event_bus_unsubscribe(s_sub);
+        s_sub = NULL;
+        heap_caps_free(mem);
+        vSemaphoreDelete(lock);
+        return err;
+    }
+
+    s_lock = lock;
+    esp_register_shutdown_handler(flush_on_restart);
+    xTaskNotifyGive(task);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_log_flush(void)
+{
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const tlog_status_t st = tlog_flush(&s_log);
+    xSemaphoreGive(s_lock);
+    if (st != TLOG_OK)
+    {
+        ESP_LOGW(TAG, "flush failed: %s", tlog_status_name(st));
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+size_t telemetry_log_query(uint32_t t0_s, uint32_t t1_s, tlog_sample_cb_t cb, void *ctx)
+{
+    if (!s_lock || !cb)
+        return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const size_t n = tlog_query(&s_log, t0_s, t1_s, cb, ctx, NULL);
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+bool telemetry_log_range(uint32_t *t_first, uint32_t *t_last)
+{
+    if (!s_lock)
+        return false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const bool any = tlog_range(&s_log, t_first, t_last);
+    xSemaphoreGive(s_lock);
+    return any;
+}
+
+uint32_t telemetry_log_now_s(void)
+{
+    return log_time(now_us());
+}
+
+esp_err_t telemetry_log_get_stats(tlog_stats_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_log.stats;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,516 @@
+#include <string.h>
+
+#include "tlog.h"
+
+#define SEAL_OFFSET 16
+#define ALIGN4(x) (((x) + 3u) & ~3u)
+
+/*========== Helpers ==========*/
+static uint16_t crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static bool all_erased(const uint8_t *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        if (p[i] != 0xFF)
+            return false;
+    return true;
+}
+
+static inline uint32_t sector_base(const tlog_t *log, uint32_t s)
+{
+    return s * log->flash.sector_size;
+}
+
+// Room left for blocks in sector `s`
+static inline uint32_t sector_free(const tlog_t *log, uint32_t s)
+{
+    const uint32_t used = ALIGN4((uint32_t)log->index[s].used);
+    const uint32_t room = log->flash.sector_size - TLOG_SECTOR_HEADER;
+    return used < room ? room - used : 0;
+}
+
+static bool flash_read(tlog_t *log, uint32_t off, void *buf, size_t len)
+{
+    if (log->flash.read(log->flash.ctx, off, buf, len) == 0)
+        return true;
+    log->stats.flash_errors++;
+    return false;
+}
+
+static bool flash_write(tlog_t *log, uint32_t off, const void *buf, size_t len)
+{
+    if (log->flash.write(log->flash.ctx, off, buf, len) == 0)
+    {
+        log->stats.bytes_written += (uint32_t)len;
+        return true;
+    }
+    log->stats.flash_errors++;
+    return false;
+}
+
+/*========== Mount ==========*/
+static tlog_status_t seal_sector(tlog_t *log, uint32_t s);
+
+typedef enum
+{
+    SEAL_ERASED = 0, // open sector
+    SEAL_VALID,
+    SEAL_TORN,
+} seal_state_t;
+
+// Header and seal of sector `s` into the index
+static seal_state_t load_header(tlog_t *log, uint32_t s)
+{
+    tlog_sector_t *e = &log->index[s];
+    uint8_t h[TLOG_SECTOR_HEADER];
+    memset(e, 0, sizeof(*e));
+    if (!flash_read(log, sector_base(log, s), h, sizeof(h)))
+        return SEAL_TORN;
+    if (get_le32(h) != TLOG_MAGIC || h[8] != log->channels || h[9] != TLOG_VERSION ||
+        get_le16(h + 12) != crc16(h, 12) || get_le32(h + 4) == 0)
+        return SEAL_TORN;
+    e->seq = get_le32(h + 4);
+
+    const uint8_t *seal = h + SEAL_OFFSET;
+    if (all_erased(seal, 16))
+        return SEAL_ERASED;
+    e->sealed = true; // even a torn seal means "closed"
+    if (get_le16(seal + 14) != crc16(seal, 14))
+        return SEAL_TORN;
+    e->t_first = get_le32(seal);
+    e->t_last = get_le32(seal + 4);
+    e->samples = get_le32(seal + 8);
+    e->used = get_le16(seal + 12);
+    return SEAL_VALID;
+}
+
+// Walks the blocks of sector `s` up to the first invalid one and fills the
+// index from them. True if everything after the last block is erased.
+static bool scan_sector(tlog_t *log, uint32_t s)
+{
+    tlog_sector_t *e = &log->index[s];
+    const uint32_t base = sector_base(log, s);
+    const uint32_t end = log->flash.sector_size;
+    uint8_t *buf = log->read_buf;
+    e->t_first = e->t_last = 0;
+    e->samples = 0;
+    e->used = 0;
+
+    uint32_t off = TLOG_SECTOR_HEADER;
+    while (off + TS_CODEC_HEADER_SIZE <= end)
+    {
+        if (!flash_read(log, base + off, buf, TS_CODEC_HEADER_SIZE))
+            return false;
+        if (all_erased(buf, TS_CODEC_HEADER_SIZE))
+            break;
+        ts_codec_block_info_t info;
+        ts_codec_decoder_t dec;
+        if (ts_codec_block_info(buf, end - off, &info) != TS_CODEC_OK || info.channels != log->channels ||
+            info.count == 0 || (e->samples && info.t_first < e->t_last))
+            return false;
+        if (!flash_read(log, base + off + TS_CODEC_HEADER_SIZE, buf + TS_CODEC_HEADER_SIZE,
+                        info.size - TS_CODEC_HEADER_SIZE) ||
+            ts_codec_decoder_init(&dec, buf, info.size) != TS_CODEC_OK)
+            return false;
+
+        if (!e->samples)
+            e->t_first = info.t_first;
+        e->t_last = info.t_last;
+        e->samples += info.count;
+        e->used = (uint16_t)(off + info.size - TLOG_SECTOR_HEADER);
+        log->stats.recovered_blocks++;
+        off = ALIGN4(off + (uint32_t)info.size);
+    }
+
+    // Anything programmed after the last good block is a torn write
+    if (off >= end)
+        return true;
+    return flash_read(log, base + off, buf, end - off) && all_erased(buf, end - off);
+}
+
+size_t tlog_mem_size(const tlog_flash_t *flash, size_t block_cap)
+{
+    const size_t sectors = flash->sector_size ? flash->size / flash->sector_size : 0;
+    return ALIGN4(sectors * sizeof(tlog_sector_t)) + ALIGN4(block_cap) + flash->sector_size;
+}
+
+tlog_status_t tlog_mount(tlog_t *log, const tlog_flash_t *flash, int channels, size_t block_cap, void *mem)
+{
+    if (!log || !flash || !mem || !flash->read || !flash->write || !flash->erase || flash->sector_size < 256 ||
+        flash->sector_size - TLOG_SECTOR_HEADER > 0xFFFF || flash->size % flash->sector_size ||
+        flash->size / flash->sector_size < TLOG_MIN_SECTORS || channels < 1 || channels > TS_CODEC_MAX_CHANNELS ||
+        block_cap < TLOG_MIN_BLOCK || block_cap > flash->sector_size - TLOG_SECTOR_HEADER)
+        return TLOG_ERR_ARG;
+
+    memset(log, 0, sizeof(*log));
+    log->flash = *flash;
+    log->sectors = flash->size / flash->sector_size;
+    log->channels = (uint8_t)channels;
+    log->block_cap = block_cap;
+    log->index = mem;
+    log->stage = (uint8_t *)mem + ALIGN4(log->sectors * sizeof(tlog_sector_t));
+    log->read_buf = log->stage + ALIGN4(block_cap);
+    log->head = TLOG_NO_SECTOR;
+
+    // Sealed sectors cost one header read; open ones are scanned. The
+    // newest sector is the head.
+    uint32_t max_seq = 0;
+    for (uint32_t s = 0; s < log->sectors; s++)
+    {
+        tlog_sector_t *e = &log->index[s];
+        const seal_state_t seal = load_header(log, s);
+        if (!e->seq)
+            continue;
+        if (seal != SEAL_VALID && !scan_sector(log, s) && seal == SEAL_ERASED)
+        {
+            // Torn block write: close the sector where the good data ends
+            log->stats.torn_sectors++;
+            seal_sector(log, s);
+        }
+        if (e->seq > max_seq)
+        {
+            max_seq = e->seq;
+            log->head = s;
+        }
+    }
+    log->next_seq = max_seq + 1;
+
+    // Only the head may take more blocks; seal any other open sector (left
+    // by a cut during the switch) so the next mount need not scan it
+    for (uint32_t s = 0; s < log->sectors; s++)
+        if (s != log->head && log->index[s].seq && !log->index[s].sealed)
+            seal_sector(log, s);
+
+    // Newest sample on flash
+    for (uint32_t k = 0; log->head != TLOG_NO_SECTOR && k < log->sectors; k++)
+    {
+        const uint32_t s = (log->head + log->sectors - k) % log->sectors;
+        if (log->index[s].seq && log->index[s].samples)
+        {
+            log->last_t = log->index[s].t_last;
+            log->any = true;
+            break;
+        }
+    }
+    return TLOG_OK;
+}
+
+/*========== Writing ==========*/
+static tlog_status_t seal_sector(tlog_t *log, uint32_t s)
+{
+    tlog_sector_t *e = &log->index[s];
+    if (e->sealed)
+        return TLOG_OK;
+    e->sealed = true;
+    uint8_t seal[16];
+    put_le32(seal, e->t_first);
+    put_le32(seal + 4, e->t_last);
+    put_le32(seal + 8, e->samples);
+    put_le16(seal + 12, e->used);
+    put_le16(seal + 14, crc16(seal, 14));
+    return flash_write(log, sector_base(log, s) + SEAL_OFFSET, seal, sizeof(seal)) ? TLOG_OK : TLOG_ERR_IO;
+}
+
+// Seals the head and starts the next sector, erasing the oldest data
+static tlog_status_t open_next_sector(tlog_t *log)
+{
+    uint32_t s = 0;
+    if (log->head != TLOG_NO_SECTOR)
+    {
+        seal_sector(log, log->head); // a failed seal only costs a scan at mount
+        s = (log->head + 1) % log->sectors;
+    }
+    tlog_sector_t *e = &log->index[s];
+    if (e->seq)
+        log->stats.samples_lost += e->samples;
+    memset(e, 0, sizeof(*e));
+    log->head = s; // even if the rest fails: never write into the old data
+    e->sealed = true;
+
+    if (log->flash.erase(log->flash.ctx, sector_base(log, s)) != 0)
+    {
+        log->stats.flash_errors++;
+        return TLOG_ERR_IO;
+    }
+    log->stats.sectors_erased++;
+
+    uint8_t h[16];
+    memset(h, 0xFF, sizeof(h));
+    put_le32(h, TLOG_MAGIC);
+    put_le32(h + 4, log->next_seq);
+    h[8] = log->channels;
+    h[9] = TLOG_VERSION;
+    put_le16(h + 12, crc16(h, 12));
+    if (!flash_write(log, sector_base(log, s), h, sizeof(h)))
+        return TLOG_ERR_IO;
+    e->seq = log->next_seq++;
+    e->sealed = false;
+    return TLOG_OK;
+}
+
+// Starts a staged block in the head, or in a new sector when the head is
+// closed or nearly full
+static tlog_status_t start_block(tlog_t *log)
+{
+    if (log->head == TLOG_NO_SECTOR || log->index[log->head].sealed ||
+        sector_free(log, log->head) < TLOG_MIN_BLOCK)
+    {
+        const tlog_status_t st = open_next_sector(log);
+        if (st != TLOG_OK)
+            return st;
+    }
+    const uint32_t room = sector_free(log, log->head);
+    const size_t cap = room < log->block_cap ? room : log->block_cap;
+    return ts_codec_encoder_init(&log->enc, log->stage, cap, log->channels) == TS_CODEC_OK ? TLOG_OK
+                                                                                           : TLOG_ERR_ARG;
+}
+
+tlog_status_t tlog_flush(tlog_t *log)
+{
+    if (!log->enc.buf || !log->enc.count)
+        return TLOG_OK;
+
+    tlog_sector_t *e = &log->index[log->head];
+    const size_t len = ts_codec_finish(&log->enc);
+    if (e->sealed || sector_free(log, log->head) < len)
+    {
+        // The head was closed after a failed write: the block (at most
+        // block_cap) fits any fresh sector
+        const tlog_status_t st = open_next_sector(log);
+        if (st != TLOG_OK)
+            return st;
+        e = &log->index[log->head];
+    }
+
+    const uint32_t off = TLOG_SECTOR_HEADER + ALIGN4((uint32_t)e->used);
+    if (!flash_write(log, sector_base(log, log->head) + off, log->stage, len))
+    {
+        // Part of it may be programmed; keep the samples for a fresh sector
+        e->sealed = true;
+        return TLOG_ERR_IO;
+    }
+    if (!e->samples)
+        e->t_first = log->enc.t_first;
+    e->t_last = log->enc.t_prev;
+    e->samples += log->enc.count;
+    e->used = (uint16_t)(off + len - TLOG_SECTOR_HEADER);
+    log->stats.blocks_written++;
+    memset(&log->enc, 0, sizeof(log->enc));
+    return TLOG_OK;
+}
+
+tlog_status_t tlog_append(tlog_t *log, uint32_t t, const int32_t *values)
+{
+    if (log->any && t < log->last_t)
+        return TLOG_ERR_ORDER;
+
+    tlog_status_t st;
+    if (!log->enc.buf && (st = start_block(log)) != TLOG_OK)
+        return st;
+    ts_codec_status_t cs = ts_codec_append(&log->enc, t, values);
+    if (cs == TS_CODEC_FULL)
+    {
+        if ((st = tlog_flush(log)) != TLOG_OK || (st = start_block(log)) != TLOG_OK)
+            return st;
+        cs = ts_codec_append(&log->enc, t, values);
+    }
+    if (cs != TS_CODEC_OK)
+        return TLOG_ERR_ARG;
+
+    log->last_t = t;
+    log->any = true;
+    log->stats.samples_appended++;
+    return TLOG_OK;
+}
+
+tlog_status_t tlog_format(tlog_t *log)
+{
+    tlog_status_t st = TLOG_OK;
+    for (uint32_t s = 0; s < log->sectors; s++)
+    {
+        memset(&log->index[s], 0, sizeof(log->index[s]));
+        if (log->flash.erase(log->flash.ctx, sector_base(log, s)) != 0)
+        {
+            log->stats.flash_errors++;
+            st = TLOG_ERR_IO;
+        }
+        else
+        {
+            log->stats.sectors_erased++;
+        }
+    }
+    log->head = TLOG_NO_SECTOR;
+    log->next_seq = 1;
+    log->any = false;
+    log->last_t = 0;
+    memset(&log->enc, 0, sizeof(log->enc));
+    return st;
+}
+
+/*========== Reading ==========*/
+typedef struct
+{
+    uint32_t t0, t1;
+    tlog_sample_cb_t cb;
+    void *ctx;
+    size_t count;
+} query_t;
+
+// Decodes one block; false once past t1 or stopped by the callback
+static bool emit_block(const uint8_t *block, size_t len, query_t *q)
+{
+    ts_codec_decoder_t dec;
+    if (ts_codec_decoder_init(&dec, block, len) != TS_CODEC_OK)
+        return true; // corrupt since mount: skip it
+    uint32_t t;
+    int32_t v[TS_CODEC_MAX_CHANNELS];
+    while (ts_codec_next(&dec, &t, v) == TS_CODEC_OK)
+    {
+        if (t > q->t1)
+            return false;
+        if (t < q->t0)
+            continue;
+        q->count++;
+        if (!q->cb(t, v, q->ctx))
+            return false;
+    }
+    return true;
+}
+
+size_t tlog_query(tlog_t *log, uint32_t t0, uint32_t t1, tlog_sample_cb_t cb, void *ctx, tlog_query_stats_t *qs)
+{
+    tlog_query_stats_t stats = {0};
+    query_t q = {t0, t1, cb, ctx, 0};
+    bool more = t0 <= t1;
+
+    // Oldest sector first: the one after the head
+    for (uint32_t k = 1; more && log->head != TLOG_NO_SECTOR && k <= log->sectors; k++)
+    {
+        const uint32_t s = (log->head + k) % log->sectors;
+        const tlog_sector_t *e = &log->index[s];
+        if (!e->seq || !e->samples || e->t_last < t0)
+            continue;
+        if (e->t_first > t1)
+            break;
+
+        const uint32_t base = sector_base(log, s);
+        const uint32_t end = TLOG_SECTOR_HEADER + e->used;
+        for (uint32_t off = TLOG_SECTOR_HEADER; more && off + TS_CODEC_HEADER_SIZE <= end;)
+        {
+            uint8_t *buf = log->read_buf;
+            ts_codec_block_info_t info;
+            if (!flash_read(log, base + off, buf, TS_CODEC_HEADER_SIZE) ||
+                ts_codec_block_info(buf, end - off, &info) != TS_CODEC_OK)
+                break;
+            stats.bytes_read += TS_CODEC_HEADER_SIZE;
+            if (info.t_first > t1)
+            {
+                more = false;
+                break;
+            }
+            if (info.t_last >= t0)
+            {
+                if (!flash_read(log, base + off + TS_CODEC_HEADER_SIZE, buf + TS_CODEC_HEADER_SIZE,
+                                info.size - TS_CODEC_HEADER_SIZE))
+                    break;
+                stats.bytes_read += (uint32_t)(info.size - TS_CODEC_HEADER_SIZE);
+                stats.blocks_read++;
+                more = emit_block(buf, info.size, &q);
+            }
+            else
+            {
+                stats.blocks_skipped++;
+            }
+            off = ALIGN4(off + (uint32_t)info.size);
+        }
+    }
+
+    // Then the samples not written yet
+    if (more && log->enc.buf && log->enc.count && log->enc.t_prev >= t0)
+    {
+        const size_t len = ts_codec_finish(&log->enc);
+        emit_block(log->stage, len, &q);
+    }
+    if (qs)
+        *qs = stats;
+    return q.count;
+}
+
+bool tlog_range(const tlog_t *log, uint32_t *t_first, uint32_t *t_last)
+{
+    if (!log->any)
+        return false;
+    bool found = false;
+    for (uint32_t k = 1; log->head != TLOG_NO_SECTOR && k <= log->sectors && !found; k++)
+    {
+        const tlog_sector_t *e = &log->index[(log->head + k) % log->sectors];
+        if (e->seq && e->samples)
+        {
+            *t_first = e->t_first;
+            found = true;
+        }
+    }
+    if (!found && log->enc.buf && log->enc.count)
+    {
+        *t_first = log->enc.t_first;
+        found = true;
+    }
+    *t_last = log->last_t;
+    return found;
+}
+
+bool tlog_last_time(const tlog_t *log, uint32_t *t)
+{
+    if (log->any)
+        *t = log->last_t;
+    return log->any;
+}
+
+const char *tlog_status_name(tlog_status_t s)
+{
+    switch (s)
+    {
+    case TLOG_OK:
+        return "ok";
+    case TLOG_ERR_ARG:
+        return "bad argument";
+    case TLOG_ERR_IO:
+        return "flash error";
+    case TLOG_ERR_ORDER:
+        return "out of order";
+    default:
+        return "?";
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressed blocks of time-series samples: one timestamp and 1..4 int32
+// channels per sample (e.g. temperature and humidity in tenths). Plain C
+// with no ESP-IDF dependency, for on-device history, the flash log and
+// uplink batches; host_tools/ts_codec builds the same file.
+//
+// Every block decodes on its own, and its header carries the time range and
+// sample count, so a reader can skip to any block without decoding the ones
+// before it. Block layout (little endian):
+//
+//   u8      TS_CODEC_MAGIC
+//   u8      channels
+//   u16     sample count
+//   u32     first timestamp
+//   u32     last timestamp
+//   u16     payload bytes
+//   u16     CRC-16/CCITT-FALSE of the header bytes before it and the payload
+//   ...     payload, a bit stream (MSB first):
+//
+// Timestamps (any unit; uint32, never decreasing), Gorilla style:
+//   first sample   in the header only
+//   then           delta-of-delta d = (t - t_prev) - (t_prev - t_prev2),
+//                  the first delta taken against 0:
+//                  '0' d == 0 | '10' 7 bits | '110' 9 bits | '1110' 12 bits
+//                  | '1111' 33 bits, each a zig-zag coded d
+//
+// Values, per channel, zig-zag coded delta to the previous sample (the
+// first sample: the value itself):
+//   '0' delta == 0 | '1' then a varint of 4-bit groups: continue flag and
+//                    3 value bits, least significant group first
+//
+// A steady 2 s cadence with unchanged values costs 1 bit for the
+// timestamp plus 1 bit per channel.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TS_CODEC_MAGIC 0xD5
+#define TS_CODEC_MAX_CHANNELS 4
+#define TS_CODEC_HEADER_SIZE 16
+#define TS_CODEC_MAX_BLOCK (TS_CODEC_HEADER_SIZE + 0xFFFF)
+
+    typedef enum
+    {
+        TS_CODEC_OK = 0,
+        TS_CODEC_FULL,       // the sample does not fit; the block is unchanged
+        TS_CODEC_END,        // no more samples in the block
+        TS_CODEC_ERR_ARG,    // bad channel count, buffer, ...
+        TS_CODEC_ERR_ORDER,  // timestamp older than the previous one
+        TS_CODEC_ERR_FORMAT, // not a block, CRC mismatch or truncated
+    } ts_codec_status_t;
+
+    typedef struct
+    {
+        uint8_t channels;
+        uint16_t count;
+        uint32_t t_first;
+        uint32_t t_last;
+        size_t size; // header + payload bytes
+    } ts_codec_block_info_t;
+
+    typedef struct
+    {
+        uint8_t *buf;
+        size_t cap;
+        uint32_t bits; // payload bits written
+        uint16_t count;
+        uint8_t channels;
+        uint32_t t_first;
+        uint32_t t_prev;
+        uint32_t delta_prev;
+        int32_t v_prev[TS_CODEC_MAX_CHANNELS];
+    } ts_codec_encoder_t;
+
+    typedef struct
+    {
+        const uint8_t *payload;
+        uint32_t payload_bits;
+        uint32_t pos;
+        uint16_t count;
+        uint16_t index;
+        uint8_t channels;
+        uint32_t t_prev;
+        uint32_t delta_prev;
+        int32_t v_prev[TS_CODEC_MAX_CHANNELS];
+    } ts_codec_decoder_t;
+
+    /*========== Encoder ==========*/
+    // Starts an empty block in `buf` (`cap` bytes, at least the header and at
+    // most TS_CODEC_MAX_BLOCK)
+    ts_codec_status_t ts_codec_encoder_init(ts_codec_encoder_t *enc, uint8_t *buf, size_t cap, int channels);
+
+    // Appends one sample (`channels` values). TS_CODEC_FULL: start the next
+    // block with it.
+    ts_codec_status_t ts_codec_append(ts_codec_encoder_t *enc, uint32_t t, const int32_t *values);
+
+    // Writes the header and CRC; returns the block size. Appending after it is
+    // allowed (finish again afterwards).
+    size_t ts_codec_finish(ts_codec_encoder_t *enc);
+
+    // Block size if finished now
+    size_t ts_codec_size(const ts_codec_encoder_t *enc);
+
+    /*========== Decoder ==========*/
+    // Header only, no CRC check: for skipping through blocks
+    ts_codec_status_t ts_codec_block_info(const uint8_t *block, size_t len, ts_codec_block_info_t *info);
+
+    // Checks the header and CRC
+    ts_codec_status_t ts_codec_decoder_init(ts_codec_decoder_t *dec, const uint8_t *block, size_t len);
+
+    // Next sample, or TS_CODEC_END
+    ts_codec_status_t ts_codec_next(ts_codec_decoder_t *dec, uint32_t *t, int32_t *values);
+
+    const char *ts_codec_status_name(ts_codec_status_t s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,320 @@
+#include <string.h>
+
+#include "ts_codec.h"
+
+/*========== Helpers ==========*/
+static inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static uint16_t crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static uint32_t payload_cap_bits(const ts_codec_encoder_t *enc)
+{
+    size_t bytes = enc->cap - TS_CODEC_HEADER_SIZE;
+    if (bytes > 0xFFFF)
+        bytes = 0xFFFF;
+    return (uint32_t)bytes * 8;
+}
+
+/*========== Bit stream ==========*/
+// MSB first into a zeroed payload; false (nothing written) on overflow
+static bool put_bits(ts_codec_encoder_t *enc, uint64_t v, int n)
+{
+    if (enc->bits + (uint32_t)n > payload_cap_bits(enc))
+        return false;
+    uint8_t *p = enc->buf + TS_CODEC_HEADER_SIZE;
+    while (n > 0)
+    {
+        const int room = 8 - (int)(enc->bits & 7);
+        const int k = n < room ? n : room;
+        const uint8_t chunk = (uint8_t)((v >> (n - k)) & ((1u << k) - 1));
+        p[enc->bits >> 3] |= (uint8_t)(chunk << (room - k));
+        enc->bits += (uint32_t)k;
+        n -= k;
+    }
+    return true;
+}
+
+static bool get_bits(ts_codec_decoder_t *dec, int n, uint64_t *v)
+{
+    if (dec->pos + (uint32_t)n > dec->payload_bits)
+        return false;
+    uint64_t out = 0;
+    while (n > 0)
+    {
+        const int avail = 8 - (int)(dec->pos & 7);
+        const int k = n < avail ? n : avail;
+        const uint8_t byte = dec->payload[dec->pos >> 3];
+        out = (out << k) | ((byte >> (avail - k)) & ((1u << k) - 1));
+        dec->pos += (uint32_t)k;
+        n -= k;
+    }
+    *v = out;
+    return true;
+}
+
+static bool put_dod(ts_codec_encoder_t *enc, int64_t dod)
+{
+    const uint64_t zz = zigzag(dod);
+    if (zz == 0)
+        return put_bits(enc, 0x0, 1);
+    if (zz < (1u << 7))
+        return put_bits(enc, 0x2, 2) && put_bits(enc, zz, 7);
+    if (zz < (1u << 9))
+        return put_bits(enc, 0x6, 3) && put_bits(enc, zz, 9);
+    if (zz < (1u << 12))
+        return put_bits(enc, 0xE, 4) && put_bits(enc, zz, 12);
+    return put_bits(enc, 0xF, 4) && put_bits(enc, zz, 33);
+}
+
+static bool get_dod(ts_codec_decoder_t *dec, int64_t *dod)
+{
+    // Count the leading ones of the prefix, at most 4
+    int ones = 0;
+    uint64_t bit;
+    while (ones < 4)
+    {
+        if (!get_bits(dec, 1, &bit))
+            return false;
+        if (!bit)
+            break;
+        ones++;
+    }
+    static const int width[5] = {0, 7, 9, 12, 33};
+    uint64_t zz = 0;
+    if (ones && !get_bits(dec, width[ones], &zz))
+        return false;
+    *dod = unzigzag(zz);
+    return true;
+}
+
+static bool put_value(ts_codec_encoder_t *enc, int64_t delta)
+{
+    uint64_t zz = zigzag(delta);
+    if (zz == 0)
+        return put_bits(enc, 0x0, 1);
+    if (!put_bits(enc, 0x1, 1))
+        return false;
+    do
+    {
+        const uint64_t group = zz & 0x7;
+        zz >>= 3;
+        if (!put_bits(enc, (zz ? 0x8 : 0x0) | group, 4))
+            return false;
+    } while (zz);
+    return true;
+}
+
+static bool get_value(ts_codec_decoder_t *dec, int64_t *delta)
+{
+    uint64_t flag, group, zz = 0;
+    if (!get_bits(dec, 1, &flag))
+        return false;
+    for (int shift = 0; flag; shift += 3)
+    {
+        if (shift > 33 || !get_bits(dec, 4, &group))
+            return false;
+        zz |= (group & 0x7) << shift;
+        flag = group & 0x8;
+    }
+    *delta = unzigzag(zz);
+    return true;
+}
+
+/*========== Encoder ==========*/
+ts_codec_status_t ts_codec_encoder_init(ts_codec_encoder_t *enc, uint8_t *buf, size_t cap, int channels)
+{
+    if (!enc || !buf || cap < TS_CODEC_HEADER_SIZE || cap > TS_CODEC_MAX_BLOCK || channels < 1 ||
+        channels > TS_CODEC_MAX_CHANNELS)
+        return TS_CODEC_ERR_ARG;
+    memset(enc, 0, sizeof(*enc));
+    enc->buf = buf;
+    enc->cap = cap;
+    enc->channels = (uint8_t)channels;
+    memset(buf, 0, cap);
+    return TS_CODEC_OK;
+}
+
+ts_codec_status_t ts_codec_append(ts_codec_encoder_t *enc, uint32_t t, const int32_t *values)
+{
+    if (enc->count && t < enc->t_prev)
+        return TS_CODEC_ERR_ORDER;
+    if (enc->count == 0xFFFF)
+        return TS_CODEC_FULL;
+
+    const uint32_t bits0 = enc->bits;
+    const uint32_t delta = enc->count ? t - enc->t_prev : 0;
+    bool ok = true;
+    if (enc->count)
+        ok = put_dod(enc, (int64_t)delta - (int64_t)enc->delta_prev);
+    for (int c = 0; ok && c < enc->channels; c++)
+        ok = put_value(enc, (int64_t)values[c] - enc->v_prev[c]);
+
+    if (!ok)
+    {
+        // Roll back to the last whole sample: clear what was written after it
+        uint8_t *p = enc->buf + TS_CODEC_HEADER_SIZE;
+        const uint32_t end_byte = (enc->bits + 7) >> 3;
+        if (bits0 & 7)
+            p[bits0 >> 3] &= (uint8_t)(0xFF << (8 - (bits0 & 7)));
+        else if ((bits0 >> 3) < end_byte)
+            p[bits0 >> 3] = 0;
+        for (uint32_t i = (bits0 >> 3) + 1; i < end_byte; i++)
+            p[i] = 0;
+        enc->bits = bits0;
+        return TS_CODEC_FULL;
+    }
+
+    if (enc->count == 0)
+        enc->t_first = t;
+    enc->delta_prev = delta;
+    enc->t_prev = t;
+    for (int c = 0; c < enc->channels; c++)
+        enc->v_prev[c] = values[c];
+    enc->count++;
+    return TS_CODEC_OK;
+}
+
+size_t ts_codec_size(const ts_codec_encoder_t *enc)
+{
+    return TS_CODEC_HEADER_SIZE + ((enc->bits + 7) >> 3);
+}
+
+size_t ts_codec_finish(ts_codec_encoder_t *enc)
+{
+    uint8_t *h = enc->buf;
+    const uint16_t payload = (uint16_t)((enc->bits + 7) >> 3);
+    h[0] = TS_CODEC_MAGIC;
+    h[1] = enc->channels;
+    put_le16(h + 2, enc->count);
+    put_le32(h + 4, enc->t_first);
+    put_le32(h + 8, enc->t_prev);
+    put_le16(h + 12, payload);
+    uint16_t crc = crc16(0xFFFF, h, 14);
+    crc = crc16(crc, h + TS_CODEC_HEADER_SIZE, payload);
+    put_le16(h + 14, crc);
+    return TS_CODEC_HEADER_SIZE + payload;
+}
+
+/*========== Decoder ==========*/
+ts_codec_status_t ts_codec_block_info(const uint8_t *block, size_t len, ts_codec_block_info_t *info)
+{
+    if (!block || !info || len < TS_CODEC_HEADER_SIZE || block[0] != TS_CODEC_MAGIC || block[1] < 1 ||
+        block[1] > TS_CODEC_MAX_CHANNELS)
+        return TS_CODEC_ERR_FORMAT;
+    info->channels = block[1];
+    info->count = get_le16(block + 2);
+    info->t_first = get_le32(block + 4);
+    info->t_last = get_le32(block + 8);
+    info->size = TS_CODEC_HEADER_SIZE + get_le16(block + 12);
+    return info->size <= len ? TS_CODEC_OK : TS_CODEC_ERR_FORMAT;
+}
+
+ts_codec_status_t ts_codec_decoder_init(ts_codec_decoder_t *dec, const uint8_t *block, size_t len)
+{
+    ts_codec_block_info_t info;
+    ts_codec_status_t st = ts_codec_block_info(block, len, &info);
+    if (st != TS_CODEC_OK)
+        return st;
+    const size_t payload = info.size - TS_CODEC_HEADER_SIZE;
+    uint16_t crc = crc16(0xFFFF, block, 14);
+    crc = crc16(crc, block + TS_CODEC_HEADER_SIZE, payload);
+    if (crc != get_le16(block + 14))
+        return TS_CODEC_ERR_FORMAT;
+
+    memset(dec, 0, sizeof(*dec));
+    dec->payload = block + TS_CODEC_HEADER_SIZE;
+    dec->payload_bits = (uint32_t)payload * 8;
+    dec->count = info.count;
+    dec->channels = info.channels;
+    dec->t_prev = info.t_first;
+    return TS_CODEC_OK;
+}
+
+ts_codec_status_t ts_codec_next(ts_codec_decoder_t *dec, uint32_t *t, int32_t *values)
+{
+    if (dec->index >= dec->count)
+        return TS_CODEC_END;
+
+    if (dec->index > 0)
+    {
+        int64_t dod;
+        if (!get_dod(dec, &dod))
+            return TS_CODEC_ERR_FORMAT;
+        const int64_t delta = (int64_t)dec->delta_prev + dod;
+        if (delta < 0 || delta > UINT32_MAX)
+            return TS_CODEC_ERR_FORMAT;
+        dec->delta_prev = (uint32_t)delta;
+        dec->t_prev += (uint32_t)delta;
+    }
+    for (int c = 0; c < dec->channels; c++)
+    {
+        int64_t delta;
+        if (!get_value(dec, &delta))
+            return TS_CODEC_ERR_FORMAT;
+        dec->v_prev[c] = (int32_t)((int64_t)dec->v_prev[c] + delta);
+        values[c] = dec->v_prev[c];
+    }
+    *t = dec->t_prev;
+    dec->index++;
+    return TS_CODEC_OK;
+}
+
+const char *ts_codec_status_name(ts_codec_status_t s)
+{
+    switch (s)
+    {
+    case TS_CODEC_OK:
+        return "ok";
+    case TS_CODEC_FULL:
+        return "full";
+    case TS_CODEC_END:
+        return "end";
+    case TS_CODEC_ERR_ARG:
+        return "bad argument";
+    case TS_CODEC_ERR_ORDER:
+        return "out of order";
+    case TS_CODEC_ERR_FORMAT:
+        return "bad block";
+    default:
+        return "?";
+    }
+}
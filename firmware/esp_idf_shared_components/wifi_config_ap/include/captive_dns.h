@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Replies of the provisioning AP's captive DNS: every name resolves to the
+// AP, so whatever a phone looks up (its captive-portal probe first) lands
+// on the provisioning page. Plain C, no allocation: the wifi_config_ap task
+// feeds it each UDP query, host_tools/captive_dns checks and times it.
+//
+// A and ANY questions of class IN get one A record with the AP address;
+// other types (AAAA above all) an empty NOERROR answer, so clients fall
+// back to IPv4 instead of waiting. Non-queries get NOTIMP, a question that
+// does not parse FORMERR, and packets without a usable header no reply.
+// EDNS and other extra records are left out of the reply.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define CAPTIVE_DNS_PORT 53
+#define CAPTIVE_DNS_MAX_PACKET 512 // plain UDP DNS
+#define CAPTIVE_DNS_TTL_S 10       // short: nothing sticks once the phone moves on
+
+    // Builds the reply to `query` in `out` (which may be `query` itself);
+    // its length, 0 to send nothing (not a query, or `cap` too small).
+    // `ip` is the AP address in network order.
+    size_t captive_dns_reply(const uint8_t *query, size_t len, const uint8_t ip[4], uint8_t *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,8 +1,13 @@
 #pragma once
 #include "esp_wifi.h"
 #include "esp_err.h"
+#include "wifi_scan_list.h"
 #include <stdbool.h>
 
+#ifndef CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS
+#define CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS 16
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -24,21 +29,36 @@ extern "C"
         bool auto_start;
     } wifi_config_ap_settings_t;
 
-    /** Initialize Wi-Fi in Access Point mode with given settings **/
+    /**
+     * Initialize the Access Point with given settings, on the Wi-Fi driver
+     * shared with wifi_connect (see wifi_stack.h). Again: stops a running AP
+     * and takes the new settings, nothing is created twice.
+     **/
     esp_err_t wifi_config_ap_init(wifi_config_ap_settings_t *settings);
 
-    /** Start the Wi-Fi Access Point **/
+    /** Start the Wi-Fi Access Point (the driver runs in AP or AP+STA mode) **/
     esp_err_t wifi_config_ap_start(void);
 
-    /** Stop the Wi-Fi Access Point **/
+    /** Stop the Wi-Fi Access Point; a running STA keeps the driver up **/
     esp_err_t wifi_config_ap_stop(void);
 
+    /** Stop, unregister the handler, free timer and event group, release the driver; init again to reuse **/
+    esp_err_t wifi_config_ap_deinit(void);
+
     /** Get current Wi-Fi Access Point state **/
     wifi_config_ap_state_t wifi_config_ap_get_state(void);
 
     /** Get current netif */
     esp_netif_t *wifi_config_ap_get_netif(void);
 
+    /**
+     * Copy the networks of the latest scan, strongest first (up to `cap`,
+     * CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS holds them all). `*age_ms` is the age
+     * of that scan, -1 while the first one runs. ESP_ERR_NOT_SUPPORTED if
+     * scanning is off in Kconfig.
+     */
+    esp_err_t wifi_config_ap_get_scan(wifi_scan_ap_t *out, size_t cap, size_t *n, int32_t *age_ms);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Networks heard by the provisioning AP's scans: one entry per SSID, that
+// of its strongest BSS, strongest first. Plain C, filled from the scan
+// records by wifi_config_ap and read by the /scan.json handler.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Room wifi_scan_ap_json() needs at most: 32 SSID bytes escaped as \u00XX and the rest
+#define WIFI_SCAN_AP_JSON_MAX 256
+
+    typedef struct
+    {
+        char ssid[33];    // UTF-8, NUL-terminated, never empty
+        int8_t rssi;      // dBm
+        uint8_t channel;
+        const char *auth; // "open", "wpa2", ...: a static string
+    } wifi_scan_ap_t;
+
+    typedef struct
+    {
+        wifi_scan_ap_t *aps;
+        size_t cap;
+        size_t n;
+    } wifi_scan_list_t;
+
+    void wifi_scan_list_init(wifi_scan_list_t *l, wifi_scan_ap_t *aps, size_t cap);
+
+    // Adds a BSS; false if it was dropped: hidden, not valid UTF-8 (the form
+    // could not send it back), no stronger than a BSS of the same SSID, or
+    // weaker than all of a full list
+    bool wifi_scan_list_add(wifi_scan_list_t *l, const uint8_t *ssid, size_t ssid_len, int8_t rssi,
+                            uint8_t channel, const char *auth);
+
+    // Writes {"ssid":"...","rssi":-60,"ch":6,"auth":"wpa2"} to `out`;
+    // its length, 0 if it did not fit in `cap` with the NUL
+    size_t wifi_scan_ap_json(const wifi_scan_ap_t *ap, char *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
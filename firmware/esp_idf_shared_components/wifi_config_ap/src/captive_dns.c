@@ -0,0 +1,104 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "captive_dns.h"
+
+#define HDR_LEN 12
+#define FLAG_QR 0x8000
+#define FLAG_OPCODE 0x7800
+#define FLAG_AA 0x0400
+#define FLAG_RD 0x0100
+#define FLAG_RA 0x0080
+#define RCODE_FORMERR 1
+#define RCODE_NOTIMP 4
+#define TYPE_A 1
+#define TYPE_ANY 255
+#define CLASS_IN 1
+#define ANSWER_LEN 16 // name pointer, type, class, TTL, length, address
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, (uint16_t)(v >> 16));
+    put16(p + 2, (uint16_t)v);
+}
+
+// End of the question that follows the header, 0 if it does not parse
+static size_t question_end(const uint8_t *q, size_t len)
+{
+    size_t pos = HDR_LEN, name_len = 1;
+    while (pos < len && q[pos] != 0)
+    {
+        // Labels only: a compression pointer has nothing to point at yet
+        if (q[pos] > 63)
+            return 0;
+        name_len += 1u + q[pos];
+        if (name_len > 255)
+            return 0;
+        pos += 1u + q[pos];
+    }
+    pos += 1 + 4; // root label, type, class
+    return pos <= len ? pos : 0;
+}
+
+// Header alone, with `rcode` and the `echo` bits of the query's flags
+static size_t reply_header(const uint8_t *query, uint8_t *out, size_t cap, uint16_t echo, uint8_t rcode)
+{
+    if (cap < HDR_LEN)
+        return 0;
+    const uint16_t flags = get16(query + 2);
+    memmove(out, query, 2); // id
+    put16(out + 2, FLAG_QR | FLAG_RA | (flags & echo) | rcode);
+    memset(out + 4, 0, HDR_LEN - 4);
+    return HDR_LEN;
+}
+
+/*========== Public APIs ==========*/
+size_t captive_dns_reply(const uint8_t *query, size_t len, const uint8_t ip[4], uint8_t *out, size_t cap)
+{
+    if (len < HDR_LEN)
+        return 0;
+    const uint16_t flags = get16(query + 2);
+    // Never answer an answer: two responders would bounce it forever
+    if (flags & FLAG_QR)
+        return 0;
+    if (flags & FLAG_OPCODE)
+        return reply_header(query, out, cap, FLAG_OPCODE | FLAG_RD, RCODE_NOTIMP);
+    const size_t q_end = get16(query + 4) == 1 ? question_end(query, len) : 0;
+    if (!q_end)
+        return reply_header(query, out, cap, FLAG_RD, RCODE_FORMERR);
+
+    const uint16_t qtype = get16(query + q_end - 4);
+    const bool answer = get16(query + q_end - 2) == CLASS_IN && (qtype == TYPE_A || qtype == TYPE_ANY);
+    const size_t total = q_end + (answer ? ANSWER_LEN : 0);
+    if (cap < total)
+        return 0;
+
+    // Header and question as asked, extra records dropped
+    memmove(out, query, q_end);
+    put16(out + 2, FLAG_QR | FLAG_AA | FLAG_RA | (flags & FLAG_RD));
+    put16(out + 6, answer ? 1 : 0);
+    put16(out + 8, 0);
+    put16(out + 10, 0);
+    if (answer)
+    {
+        uint8_t *a = out + q_end;
+        put16(a, 0xC000 | HDR_LEN); // the name of the question
+        put16(a + 2, TYPE_A);
+        put16(a + 4, CLASS_IN);
+        put32(a + 6, CAPTIVE_DNS_TTL_S);
+        put16(a + 10, 4);
+        memcpy(a + 12, ip, 4);
+    }
+    return total;
+}
@@ -1,22 +1,29 @@
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "wifi_config_ap.h"
+#include "captive_dns.h"
+#include "wifi_stack.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 
 #include "esp_mac.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
 #include "esp_event.h"
+#include "esp_idf_version.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
-#include "nvs_flash.h"
-
+#include "dhcpserver/dhcpserver.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "lwip/ip4_addr.h"
+#include "lwip/sockets.h"
 
 static const char *TAG = "wifi_config_ap";
 
@@ -30,10 +37,13 @@ static EventGroupHandle_t s_wifi_event_group;
 /* Event bits */
 #define WIFI_AP_STARTED_BIT BIT0
 #define WIFI_AP_STOPPED_BIT BIT1
+#define WIFI_AP_DNS_STOPPED_BIT BIT2
 
 /* State and netif */
 static wifi_config_ap_state_t s_state = WIFI_CONFIG_AP_STATE_IDLE;
-static esp_netif_t *s_netif = NULL;
+static esp_netif_t *s_netif = NULL; // owned by wifi_stack
+static bool s_inited = false;
+static esp_event_handler_instance_t s_handler = NULL;
 
 /* Default config */
 #ifndef CONFIG_WIFI_CONFIG_AP_SSID
@@ -58,6 +68,246 @@ static int s_ap_max_connections = CONFIG_WIFI_CONFIG_AP_MAX_CONNECTIONS;
 /* Wi-Fi Configuration struct */
 static wifi_config_t s_wifi_ap_cfg = {0};
 
+/*========== Network scan ==========*/
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+#ifndef CONFIG_WIFI_CONFIG_AP_SCAN_INTERVAL_S
+#define CONFIG_WIFI_CONFIG_AP_SCAN_INTERVAL_S 30
+#endif
+
+// Per channel visited, then back on the AP's channel long enough for a
+// beacon (100 TU) and the clients' frames in between
+#define SCAN_ACTIVE_MAX_MS 60
+#define SCAN_HOME_DWELL_MS 110
+// After a scan that could not start (the driver was busy)
+#define SCAN_RETRY_MS 2000
+
+static wifi_scan_ap_t s_scan_aps[CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS]; // published, under s_scan_lock
+static size_t s_scan_n = 0;
+static int64_t s_scan_done_us = -1;
+static wifi_scan_ap_t s_scan_fresh[CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS]; // event task only
+static SemaphoreHandle_t s_scan_lock = NULL; // for good: the list outlives deinit
+static esp_timer_handle_t s_scan_timer = NULL;
+// A scan of ours is under way: only its SCAN_DONE is ours to read and
+// free, another component's records stay in the driver for it
+static volatile bool s_scan_ours = false;
+
+static const char *auth_name(wifi_auth_mode_t mode)
+{
+    switch (mode)
+    {
+    case WIFI_AUTH_OPEN:
+        return "open";
+    case WIFI_AUTH_OWE:
+        return "owe";
+    case WIFI_AUTH_WEP:
+        return "wep";
+    case WIFI_AUTH_WPA_PSK:
+        return "wpa";
+    case WIFI_AUTH_WPA2_PSK:
+    case WIFI_AUTH_WPA_WPA2_PSK:
+        return "wpa2";
+    case WIFI_AUTH_WPA3_PSK:
+    case WIFI_AUTH_WPA2_WPA3_PSK:
+        return "wpa3";
+    case WIFI_AUTH_WPA2_ENTERPRISE:
+    case WIFI_AUTH_WPA3_ENTERPRISE:
+    case WIFI_AUTH_WPA2_WPA3_ENTERPRISE:
+    case WIFI_AUTH_WPA3_ENT_192:
+        return "enterprise";
+    default:
+        return "other";
+    }
+}
+
+static void scan_schedule(uint32_t delay_ms)
+{
+    esp_timer_stop(s_scan_timer); // not running is fine
+    esp_timer_start_once(s_scan_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void scan_start(void)
+{
+    const wifi_scan_config_t cfg = {
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = {.min = 0, .max = SCAN_ACTIVE_MAX_MS},
+        .home_chan_dwell_time = SCAN_HOME_DWELL_MS,
+    };
+    // Before the start: its SCAN_DONE may be dispatched before it returns
+    s_scan_ours = true;
+    esp_err_t err = esp_wifi_scan_start(&cfg, false);
+    if (err != ESP_OK)
+    {
+        s_scan_ours = false;
+        ESP_LOGW(TAG, "Scan not started: %s", esp_err_to_name(err));
+        scan_schedule(SCAN_RETRY_MS);
+    }
+    // WIFI_EVENT_SCAN_DONE will be handled in event handler
+}
+
+static void scan_timer_cb(void *arg)
+{
+    (void)arg;
+    if (s_state == WIFI_CONFIG_AP_STATE_STARTED)
+        scan_start();
+}
+
+// Folds the records of a finished scan into the published list
+static void scan_collect(const wifi_event_sta_scan_done_t *done)
+{
+    if (done->status != 0)
+    {
+        // Keep the last list; the next scan is due anyway
+        esp_wifi_clear_ap_list();
+        return;
+    }
+    wifi_scan_list_t fresh;
+    wifi_scan_list_init(&fresh, s_scan_fresh, CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS);
+    // One record at a time, each freed by the driver as it is read: no
+    // buffer for a crowded band
+    wifi_ap_record_t rec;
+    while (esp_wifi_scan_get_ap_record(&rec) == ESP_OK)
+    {
+        wifi_scan_list_add(&fresh, rec.ssid, strnlen((const char *)rec.ssid, sizeof(rec.ssid)), rec.rssi,
+                           rec.primary, auth_name(rec.authmode));
+    }
+    esp_wifi_clear_ap_list();
+
+    xSemaphoreTake(s_scan_lock, portMAX_DELAY);
+    memcpy(s_scan_aps, s_scan_fresh, fresh.n * sizeof(s_scan_aps[0]));
+    s_scan_n = fresh.n;
+    s_scan_done_us = esp_timer_get_time();
+    xSemaphoreGive(s_scan_lock);
+    ESP_LOGI(TAG, "Scan done: %u BSS heard, %u networks listed", done->number, (unsigned)fresh.n);
+}
+
+static esp_err_t scan_init(void)
+{
+    if (!s_scan_lock)
+    {
+        s_scan_lock = xSemaphoreCreateMutex();
+        if (!s_scan_lock)
+            return ESP_ERR_NO_MEM;
+    }
+    if (!s_scan_timer)
+    {
+        const esp_timer_create_args_t args = {
+            .callback = scan_timer_cb,
+            .name = "ap_scan",
+        };
+        return esp_timer_create(&args, &s_scan_timer);
+    }
+    return ESP_OK;
+}
+
+static void scan_deinit(void)
+{
+    if (!s_scan_timer)
+        return;
+    esp_timer_stop(s_scan_timer);
+    esp_timer_delete(s_scan_timer);
+    s_scan_timer = NULL;
+    s_scan_ours = false; // its SCAN_DONE, if still to come, finds no handler
+}
+#endif // CONFIG_WIFI_CONFIG_AP_SCAN
+
+/*========== Captive DNS ==========*/
+#if CONFIG_WIFI_CONFIG_AP_CAPTIVE_DNS
+#define DNS_TASK_STACK 3072
+#define DNS_TASK_PRIO 5
+// How soon the task notices a stop request
+#define DNS_POLL_MS 250
+// Queries served per wake-up before looking at the stop flag again
+#define DNS_BURST 16
+
+static volatile bool s_dns_run = false;
+static TaskHandle_t s_dns_task = NULL;
+static uint8_t s_dns_ip[4];
+
+static void dns_task(void *arg)
+{
+    (void)arg;
+    // Query and reply share one buffer: the reply is built in place
+    static uint8_t buf[CAPTIVE_DNS_MAX_PACKET];
+
+    const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CAPTIVE_DNS_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        fcntl(sock, F_SETFL, O_NONBLOCK) != 0)
+    {
+        ESP_LOGE(TAG, "Captive DNS socket failed: errno %d", errno);
+        s_dns_run = false;
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Captive DNS answering with " IPSTR, s_dns_ip[0], s_dns_ip[1], s_dns_ip[2], s_dns_ip[3]);
+    }
+
+    while (s_dns_run)
+    {
+        fd_set rd;
+        FD_ZERO(&rd);
+        FD_SET(sock, &rd);
+        struct timeval tv = {.tv_sec = 0, .tv_usec = DNS_POLL_MS * 1000};
+        if (select(sock + 1, &rd, NULL, NULL, &tv) <= 0)
+            continue;
+        // A phone asks A and AAAA for a few names at once: serve what is queued
+        for (int i = 0; i < DNS_BURST; i++)
+        {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            const int n = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+            if (n < 0)
+                break; // EWOULDBLOCK: drained
+            const size_t len = captive_dns_reply(buf, (size_t)n, s_dns_ip, buf, sizeof(buf));
+            if (len)
+                sendto(sock, buf, len, 0, (struct sockaddr *)&from, from_len);
+        }
+    }
+
+    if (sock >= 0)
+        close(sock);
+    xEventGroupSetBits(s_wifi_event_group, WIFI_AP_DNS_STOPPED_BIT);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t dns_start(void)
+{
+    if (s_dns_task)
+        return ESP_OK;
+    esp_netif_ip_info_t ip_info;
+    esp_err_t err = esp_netif_get_ip_info(s_netif, &ip_info);
+    if (err != ESP_OK)
+        return err;
+    memcpy(s_dns_ip, &ip_info.ip.addr, sizeof(s_dns_ip));
+
+    xEventGroupClearBits(s_wifi_event_group, WIFI_AP_DNS_STOPPED_BIT);
+    s_dns_run = true;
+    if (xTaskCreate(dns_task, "captive_dns", DNS_TASK_STACK, NULL, DNS_TASK_PRIO, &s_dns_task) != pdPASS)
+    {
+        s_dns_run = false;
+        s_dns_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static void dns_stop(void)
+{
+    if (!s_dns_task)
+        return;
+    s_dns_run = false;
+    // The port is free again once the task has closed its socket; it leaves
+    // within DNS_POLL_MS, and after it nothing touches the event group
+    xEventGroupWaitBits(s_wifi_event_group, WIFI_AP_DNS_STOPPED_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
+    s_dns_task = NULL;
+}
+#endif // CONFIG_WIFI_CONFIG_AP_CAPTIVE_DNS
+
 static void wifi_ap_event_handler(void *arg, esp_event_base_t event_base,
                                   int32_t event_id, void *event_data)
 {
@@ -66,13 +316,29 @@ static void wifi_ap_event_handler(void *arg, esp_event_base_t event_base,
         s_state = WIFI_CONFIG_AP_STATE_STARTED;
         xEventGroupSetBits(s_wifi_event_group, WIFI_AP_STARTED_BIT);
         ESP_LOGI(TAG, "Wi-Fi AP started");
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+        // The list is ready by the time a phone has joined and opened the page
+        scan_start();
+#endif
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STOP)
     {
         s_state = WIFI_CONFIG_AP_STATE_STOPPED;
         xEventGroupSetBits(s_wifi_event_group, WIFI_AP_STOPPED_BIT);
         ESP_LOGI(TAG, "Wi-Fi AP stopped");
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+        esp_timer_stop(s_scan_timer);
+#endif
+    }
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE && s_scan_ours)
+    {
+        s_scan_ours = false;
+        scan_collect((const wifi_event_sta_scan_done_t *)event_data);
+        if (s_state == WIFI_CONFIG_AP_STATE_STARTED)
+            scan_schedule(CONFIG_WIFI_CONFIG_AP_SCAN_INTERVAL_S * 1000);
     }
+#endif
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STACONNECTED)
     {
         wifi_event_ap_staconnected_t *event = (wifi_event_ap_staconnected_t *)event_data;
@@ -87,18 +353,6 @@ static void wifi_ap_event_handler(void *arg, esp_event_base_t event_base,
     }
 }
 
-/*========== NVS Storage Initialize ==========*/
-static esp_err_t ensure_nvs_init(void)
-{
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
-    {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    return ret;
-}
-
 static esp_err_t dhcp_server_configure(esp_netif_t *netif)
 {
     if (!netif)
@@ -130,6 +384,24 @@ static esp_err_t dhcp_server_configure(esp_netif_t *netif)
     dns.ip.u_addr.ip4 = ip_info.gw; // main DNS = 192.168.4.1
     dns.ip.type = ESP_IPADDR_TYPE_V4;
     esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns);
+#endif
+#if CONFIG_WIFI_CONFIG_AP_CAPTIVE_DNS
+    // Hand that DNS to the clients, so the captive DNS gets their lookups
+    dhcps_offer_t offer_dns = OFFER_DNS;
+    err = esp_netif_dhcps_option(netif, ESP_NETIF_OP_SET, ESP_NETIF_DOMAIN_NAME_SERVER, &offer_dns,
+                                 sizeof(offer_dns));
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "DHCP DNS offer not set: %s", esp_err_to_name(err));
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+    // RFC 8910: recent phones open the portal from the lease alone, before
+    // any probe. The server keeps the pointer.
+    static char portal_uri[24];
+    snprintf(portal_uri, sizeof(portal_uri), "http://" IPSTR "/", IP2STR(&ip_info.ip));
+    err = esp_netif_dhcps_option(netif, ESP_NETIF_OP_SET, ESP_NETIF_CAPTIVEPORTAL_URI, portal_uri,
+                                 strlen(portal_uri));
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "DHCP captive portal URI not set: %s", esp_err_to_name(err));
+#endif
 #endif
     ESP_LOGI(TAG, "DHCP server configured: IP=" IPSTR " GW=" IPSTR " MASK=" IPSTR,
              IP2STR(&ip_info.ip), IP2STR(&ip_info.gw), IP2STR(&ip_info.netmask));
@@ -176,46 +448,71 @@ static esp_err_t dhcp_server_stop(esp_netif_t *netif)
     return ESP_OK;
 }
 
-/*========== Public Functions ==========*/
-esp_err_t wifi_config_ap_init(wifi_config_ap_settings_t *settings)
+// Gives back whatever owned_init() got, in reverse
+static esp_err_t teardown(void)
+{
+    if (s_handler)
+    {
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, s_handler);
+        s_handler = NULL;
+    }
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+    scan_deinit();
+#endif
+    if (s_netif)
+    {
+        dhcp_server_stop(s_netif);
+        s_netif = NULL;
+    }
+    if (s_wifi_event_group)
+    {
+        vEventGroupDelete(s_wifi_event_group);
+        s_wifi_event_group = NULL;
+    }
+    return wifi_stack_release(WIFI_STACK_USER_AP);
+}
+
+// Handles of the module, once until wifi_config_ap_deinit()
+static esp_err_t owned_init(void)
 {
     s_wifi_event_group = xEventGroupCreate();
     if (!s_wifi_event_group)
         return ESP_ERR_NO_MEM;
 
-    /* Initilize Netif and NVS */
-    esp_err_t err = esp_netif_init();
+    /* esp_netif, NVS, event loop, driver: shared with wifi_connect */
+    esp_err_t err = wifi_stack_acquire(WIFI_STACK_USER_AP);
     if (err != ESP_OK)
         return err;
+    s_netif = wifi_stack_get_netif(WIFI_STACK_USER_AP);
 
-    err = ensure_nvs_init();
+    /* Event instances register */
+    err = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_ap_event_handler, NULL, &s_handler);
     if (err != ESP_OK)
         return err;
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+    err = scan_init();
+#endif
+    return err;
+}
 
-    err = esp_event_loop_create_default();
-    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
-        return err;
-
-    if (!s_netif)
+/*========== Public Functions ==========*/
+esp_err_t wifi_config_ap_init(wifi_config_ap_settings_t *settings)
+{
+    if (!s_inited)
     {
-        s_netif = esp_netif_create_default_wifi_ap();
+        esp_err_t err = owned_init();
+        if (err != ESP_OK)
+        {
+            teardown();
+            return err;
+        }
+        s_inited = true;
+    }
+    else if (s_state == WIFI_CONFIG_AP_STATE_STARTED)
+    {
+        // Again: the new settings take effect at the next start
+        wifi_config_ap_stop();
     }
-
-    /* Initialize Wi-Fi */
-    wifi_init_config_t wicfg = WIFI_INIT_CONFIG_DEFAULT();
-    err = esp_wifi_init(&wicfg);
-    if (err != ESP_OK)
-        return err;
-
-    /* Event instances register */
-    esp_event_handler_instance_t instance_any_id;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &wifi_ap_event_handler,
-                                                        NULL,
-                                                        &instance_any_id));
-    // Set Wi-Fi mode to AP
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
 
     /* Select SSID, Password, Max Retry from cfg or Kconfig */
     const char *ssid = (settings && settings->ssid) ? settings->ssid : CONFIG_WIFI_CONFIG_AP_SSID;
@@ -252,15 +549,13 @@ esp_err_t wifi_config_ap_init(wifi_config_ap_settings_t *settings)
         s_wifi_ap_cfg.ap.pmf_cfg.required = false;
     }
 
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &s_wifi_ap_cfg));
-
     /* Update state */
     s_state = WIFI_CONFIG_AP_STATE_IDLE;
     ESP_LOGI(TAG, "Wifi_init_softap finished. SSID:%s password:%s channel:%d",
              s_ap_ssid, s_ap_password, s_ap_channel);
 
     /* Configure and start DHCP server */
-    err = dhcp_server_configure(s_netif);
+    esp_err_t err = dhcp_server_configure(s_netif);
     if (err != ESP_OK)
     {
         return err;
@@ -281,25 +576,57 @@ esp_err_t wifi_config_ap_init(wifi_config_ap_settings_t *settings)
 
 esp_err_t wifi_config_ap_start(void)
 {
-    // Ensure that Wi-Fi EvenGroup had been initialized
-    if (!s_wifi_event_group)
+    if (!s_inited)
         return ESP_ERR_INVALID_STATE;
-    esp_err_t start_err = esp_wifi_start();
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+    // AP, with the STA side for scans only (wifi_connect, if it runs, shares it)
+    const wifi_mode_t mode = WIFI_MODE_APSTA;
+#else
+    const wifi_mode_t mode = WIFI_MODE_AP;
+#endif
+    // AP added to the driver's mode: a mode change if the STA runs
+    esp_err_t start_err = wifi_stack_start(WIFI_STACK_USER_AP, mode, WIFI_IF_AP, &s_wifi_ap_cfg);
     if (start_err != ESP_OK)
         return start_err;
     // WIFI_EVENT_AP_START will be handled in event handler
+#if CONFIG_WIFI_CONFIG_AP_CAPTIVE_DNS
+    // Without it the page is still at the AP address; only the redirect is lost
+    esp_err_t dns_err = dns_start();
+    if (dns_err != ESP_OK)
+        ESP_LOGW(TAG, "Captive DNS not started: %s", esp_err_to_name(dns_err));
+#endif
     return ESP_OK;
 }
 
 esp_err_t wifi_config_ap_stop(void)
 {
-    esp_err_t stop_err = esp_wifi_stop();
+    if (!s_inited)
+        return ESP_ERR_INVALID_STATE;
+#if CONFIG_WIFI_CONFIG_AP_CAPTIVE_DNS
+    dns_stop();
+#endif
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+    esp_timer_stop(s_scan_timer);
+#endif
+    // Only the AP leaves the mode; the driver stops if nothing else runs
+    esp_err_t stop_err = wifi_stack_stop(WIFI_STACK_USER_AP);
     if (stop_err != ESP_OK)
         return stop_err;
     // WIFI_EVENT_AP_STOP will be handled in event handler
     return ESP_OK;
 }
 
+esp_err_t wifi_config_ap_deinit(void)
+{
+    if (!s_inited)
+        return ESP_OK;
+    wifi_config_ap_stop();
+    const esp_err_t err = teardown();
+    s_state = WIFI_CONFIG_AP_STATE_IDLE;
+    s_inited = false;
+    return err;
+}
+
 wifi_config_ap_state_t wifi_config_ap_get_state(void)
 {
     return s_state;
@@ -308,4 +635,25 @@ wifi_config_ap_state_t wifi_config_ap_get_state(void)
 esp_netif_t *wifi_config_ap_get_netif(void)
 {
     return s_netif;
+}
+
+esp_err_t wifi_config_ap_get_scan(wifi_scan_ap_t *out, size_t cap, size_t *n, int32_t *age_ms)
+{
+    if (!out || !n || !age_ms)
+        return ESP_ERR_INVALID_ARG;
+#if CONFIG_WIFI_CONFIG_AP_SCAN
+    if (!s_scan_lock)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_scan_lock, portMAX_DELAY);
+    *n = s_scan_n < cap ? s_scan_n : cap;
+    memcpy(out, s_scan_aps, *n * sizeof(out[0]));
+    *age_ms = s_scan_done_us < 0 ? -1 : (int32_t)((esp_timer_get_time() - s_scan_done_us) / 1000);
+    xSemaphoreGive(s_scan_lock);
+    return ESP_OK;
+#else
+    (void)cap;
+    *n = 0;
+    *age_ms = -1;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
\ No newline at end of file
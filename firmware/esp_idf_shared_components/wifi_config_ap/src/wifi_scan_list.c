@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "wifi_scan_list.h"
+
+// Well-formed UTF-8 without NULs: what a browser can show and post back
+static bool utf8_valid(const uint8_t *s, size_t n)
+{
+    size_t i = 0;
+    while (i < n)
+    {
+        const uint8_t c = s[i];
+        if (c == 0)
+            return false;
+        if (c < 0x80)
+        {
+            i++;
+            continue;
+        }
+        size_t len;
+        uint8_t lo = 0x80, hi = 0xBF; // range of the second byte
+        if (c >= 0xC2 && c <= 0xDF)
+            len = 2;
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            len = 3;
+            if (c == 0xE0)
+                lo = 0xA0; // overlong
+            else if (c == 0xED)
+                hi = 0x9F; // surrogates
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            len = 4;
+            if (c == 0xF0)
+                lo = 0x90; // overlong
+            else if (c == 0xF4)
+                hi = 0x8F; // past U+10FFFF
+        }
+        else
+            return false;
+        if (i + len > n || s[i + 1] < lo || s[i + 1] > hi)
+            return false;
+        for (size_t k = 2; k < len; k++)
+        {
+            if ((s[i + k] & 0xC0) != 0x80)
+                return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+/*========== Public APIs ==========*/
+void wifi_scan_list_init(wifi_scan_list_t *l, wifi_scan_ap_t *aps, size_t cap)
+{
+    l->aps = aps;
+    l->cap = cap;
+    l->n = 0;
+}
+
+bool wifi_scan_list_add(wifi_scan_list_t *l, const uint8_t *ssid, size_t ssid_len, int8_t rssi,
+                        uint8_t channel, const char *auth)
+{
+    if (ssid_len == 0 || ssid_len >= sizeof(l->aps[0].ssid) || !utf8_valid(ssid, ssid_len))
+        return false;
+
+    // Mesh nodes and dual-band routers: one SSID, many BSSs
+    for (size_t i = 0; i < l->n; i++)
+    {
+        if (strlen(l->aps[i].ssid) == ssid_len && memcmp(l->aps[i].ssid, ssid, ssid_len) == 0)
+        {
+            if (rssi <= l->aps[i].rssi)
+                return false;
+            memmove(&l->aps[i], &l->aps[i + 1], (l->n - i - 1) * sizeof(l->aps[0]));
+            l->n--;
+            break;
+        }
+    }
+
+    size_t pos = 0;
+    while (pos < l->n && l->aps[pos].rssi >= rssi)
+        pos++;
+    if (pos >= l->cap)
+        return false;
+    if (l->n == l->cap)
+        l->n--; // the weakest makes room
+    memmove(&l->aps[pos + 1], &l->aps[pos], (l->n - pos) * sizeof(l->aps[0]));
+    l->n++;
+
+    wifi_scan_ap_t *ap = &l->aps[pos];
+    memcpy(ap->ssid, ssid, ssid_len);
+    ap->ssid[ssid_len] = 0;
+    ap->rssi = rssi;
+    ap->channel = channel;
+    ap->auth = auth;
+    return true;
+}
+
+size_t wifi_scan_ap_json(const wifi_scan_ap_t *ap, char *out, size_t cap)
+{
+    static const char hex[] = "0123456789abcdef";
+    char ssid[6 * 32 + 1];
+    size_t o = 0;
+    for (const uint8_t *s = (const uint8_t *)ap->ssid; *s && o + 6 < sizeof(ssid); s++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            ssid[o++] = '\\';
+            ssid[o++] = (char)*s;
+        }
+        else if (*s < 0x20 || *s == 0x7F)
+        {
+            memcpy(ssid + o, "\\u00", 4);
+            ssid[o + 4] = hex[*s >> 4];
+            ssid[o + 5] = hex[*s & 0xF];
+            o += 6;
+        }
+        else
+        {
+            ssid[o++] = (char)*s;
+        }
+    }
+    ssid[o] = 0;
+
+    const int n = snprintf(out, cap, "{\"ssid\":\"%s\",\"rssi\":%d,\"ch\":%u,\"auth\":\"%s\"}", ssid, ap->rssi,
+                           (unsigned)ap->channel, ap->auth ? ap->auth : "other");
+    return n < 0 || (size_t)n >= cap ? 0 : (size_t)n;
+}
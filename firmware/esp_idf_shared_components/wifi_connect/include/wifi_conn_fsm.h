@@ -0,0 +1,173 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Connection logic of wifi_connect, without the driver: plain C fed with
+// events and the time they happened, answering with what to do next, so
+// host_tools/wifi_conn_fsm can replay Wi-Fi event sequences on a PC.
+//
+// A start (or a lost link) first joins the cached access point directly:
+// its BSSID on its channel, no scan, optionally with the cached address
+// instead of DHCP. Only when that misses `fast_tries` times does it scan
+// all channels for the strongest access point with the SSID. A round is
+// that plus up to `max_retry` more scans; rounds repeat for as long as it
+// takes. Every failed join waits before the next one, twice as long each
+// time from `backoff_min_us` up to `backoff_max_us`, half of it random so
+// stations that lost the same access point spread out. Disconnect reasons
+// are classified: `auth_fallback` rejections in a row (a wrong password)
+// or `fallback_rounds` rounds without an IP give up and ask for the
+// provisioning AP. A join the driver refuses fails at once; one that gets
+// no answer by `join_timeout_us`, or no IP `dhcp_timeout_us` after the
+// association, is left and fails too, so no phase waits for an event that
+// never comes. Every IP updates the cache (saved only when it changed) and
+// the boot-to-IP and reconnect timings.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Last access point that gave an IP, and the address it gave
+    typedef struct
+    {
+        uint8_t bssid[6];
+        uint8_t channel; // 0: nothing cached
+        uint32_t ip;     // network order, 0: no lease
+        uint32_t netmask;
+        uint32_t gw;
+        uint32_t dns;
+    } wifi_conn_cache_t;
+
+    // What a disconnect reason (WIFI_REASON_*) says about the next join
+    typedef enum
+    {
+        WIFI_CONN_REASON_OTHER = 0,
+        WIFI_CONN_REASON_NOT_FOUND, // no access point with the SSID (or the cached BSSID)
+        WIFI_CONN_REASON_AUTH,      // rejected: most likely a wrong password
+        WIFI_CONN_REASON_LINK_LOST, // beacons or acks lost, access point left
+        WIFI_CONN_REASON_COUNT,
+    } wifi_conn_reason_class_t;
+
+    typedef struct
+    {
+        int64_t boot_to_ip_us;     // time of the first IP since boot, 0 before
+        int64_t connect_us;        // start or lost link to IP, last time
+        int64_t reconnect_last_us; // lost link to IP, last and slowest
+        int64_t reconnect_max_us;
+        int64_t retry_airtime_us; // radio time in joins that failed
+        int64_t backoff_us;       // time waited between joins
+        uint32_t reconnects;      // links lost and got back
+        uint32_t fast_hits;       // IPs from the cached access point
+        uint32_t fast_misses;     // failed joins of it
+        uint32_t scans;           // IPs after a full scan
+        uint32_t retries;         // joins after a failed one
+        uint32_t failures;        // rounds without an IP
+        uint32_t fallbacks;       // times it gave up for the provisioning AP
+        uint32_t refused;         // joins the driver refused
+        uint32_t timeouts;        // joins left without an answer or an IP in time
+        uint32_t reasons[WIFI_CONN_REASON_COUNT]; // disconnects by class
+    } wifi_conn_stats_t;
+
+    typedef enum
+    {
+        WIFI_CONN_FSM_IDLE = 0,
+        WIFI_CONN_FSM_CONNECTING, // a join is under way
+        WIFI_CONN_FSM_ASSOCIATED, // waiting for the IP
+        WIFI_CONN_FSM_GOT_IP,
+        WIFI_CONN_FSM_BACKOFF, // waiting for retry_at_us
+        WIFI_CONN_FSM_FAILED,  // gave up until the next start
+    } wifi_conn_fsm_phase_t;
+
+    typedef enum
+    {
+        WIFI_CONN_EV_START = 0,
+        WIFI_CONN_EV_STOP,
+        WIFI_CONN_EV_CONNECTED,    // bssid, channel
+        WIFI_CONN_EV_DISCONNECTED, // reason
+        WIFI_CONN_EV_GOT_IP,       // lease
+        WIFI_CONN_EV_TIMER,        // retry_at_us has come
+        WIFI_CONN_EV_JOIN_REFUSED, // esp_wifi_connect() failed: no event will follow
+    } wifi_conn_ev_type_t;
+
+    typedef struct
+    {
+        wifi_conn_ev_type_t type;
+        int64_t now_us; // since boot
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint16_t reason; // WIFI_REASON_*
+        uint32_t ip;     // network order, with the rest of the lease
+        uint32_t netmask;
+        uint32_t gw;
+        uint32_t dns;
+    } wifi_conn_ev_t;
+
+    // Actions, as bits: the address ones come before the join
+#define WIFI_CONN_ACT_STATIC_IP (1u << 0)   // stop DHCP, set the cached lease
+#define WIFI_CONN_ACT_DHCP (1u << 1)        // (re)start the DHCP client
+#define WIFI_CONN_ACT_JOIN_CACHED (1u << 2) // connect to the cached BSSID and channel
+#define WIFI_CONN_ACT_JOIN_SCAN (1u << 3)   // connect after a scan of all channels
+#define WIFI_CONN_ACT_SAVE_CACHE (1u << 4)  // the cache changed: persist it
+#define WIFI_CONN_ACT_SIGNAL_IP (1u << 5)   // wake wifi_conn_wait_ip()
+#define WIFI_CONN_ACT_SIGNAL_FAIL (1u << 6) // a round failed, wake wifi_conn_wait_ip()
+#define WIFI_CONN_ACT_WAIT (1u << 7)        // feed WIFI_CONN_EV_TIMER at retry_at_us
+#define WIFI_CONN_ACT_FALLBACK (1u << 8)    // gave up: bring up the provisioning AP
+#define WIFI_CONN_ACT_LINK_LOST (1u << 9)   // the IP is gone
+#define WIFI_CONN_ACT_LEAVE (1u << 10)      // disconnect first: the join timed out
+
+    typedef struct
+    {
+        int max_retry;          // scans per round after the first one
+        int fast_tries;         // joins of the cached access point, 0: never
+        bool reuse_lease;       // with its address instead of DHCP
+        int64_t backoff_min_us; // wait after the first failed join, 0: none
+        int64_t backoff_max_us;
+        int fallback_rounds; // rounds without an IP that give up, 0: never
+        int auth_fallback;   // rejections in a row that give up, 0: never
+        int64_t join_timeout_us; // no CONNECTED or DISCONNECTED by then: leave, 0: never
+        int64_t dhcp_timeout_us; // associated without an IP by then: leave, 0: never
+        uint32_t seed;           // of the jitter
+    } wifi_conn_fsm_config_t;
+
+    typedef struct
+    {
+        wifi_conn_fsm_config_t cfg;
+        wifi_conn_cache_t cache;
+        wifi_conn_fsm_phase_t phase;
+        int64_t now_us;      // of the event being handled
+        bool cached_join;    // the join under way is to the cached access point
+        bool static_ip;      // the cached lease is set instead of DHCP
+        int tries;           // of the join kind under way
+        uint8_t bssid[6];    // of the association under way
+        uint8_t channel;
+        int64_t start_us;    // start or lost link, 0 after an IP
+        bool was_up;         // start_us is a lost link
+        int64_t join_us;     // start of the join under way
+        int64_t retry_at_us; // BACKOFF: when to join again; CONNECTING, ASSOCIATED: the deadline, 0: none
+        bool next_round;     // BACKOFF: the join after it starts a round
+        int backoff_n;       // failed joins since the last IP
+        int rounds_failed;   // since the last IP
+        int auth_fails;      // in a row
+        bool fail_signalled; // since the last IP
+        bool leaving;        // the next DISCONNECTED answers a LEAVE
+        wifi_conn_reason_class_t last_reason;
+        uint32_t rng;
+        wifi_conn_stats_t stats;
+    } wifi_conn_fsm_t;
+
+    // Starts idle with `cache` (NULL: empty); keeps the stats if `keep_stats`
+    void wifi_conn_fsm_init(wifi_conn_fsm_t *f, const wifi_conn_fsm_config_t *cfg, const wifi_conn_cache_t *cache,
+                            bool keep_stats);
+
+    // Feeds one event; the WIFI_CONN_ACT_* bits to carry out, in bit order
+    uint32_t wifi_conn_fsm_handle(wifi_conn_fsm_t *f, const wifi_conn_ev_t *ev);
+
+    // Forgets the access point and lease (other network, other credentials)
+    void wifi_conn_fsm_forget(wifi_conn_fsm_t *f);
+
+    // Class of a WIFI_REASON_* code
+    wifi_conn_reason_class_t wifi_conn_fsm_classify(uint16_t reason);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,10 +3,29 @@
 #include "esp_netif_ip_addr.h"
 #include <stdbool.h>
 #include "esp_wifi.h"
+#include "wifi_conn_fsm.h"
 
 #ifndef CONFIG_WIFI_CONN_MAX_RETRY
 #define CONFIG_WIFI_CONN_MAX_RETRY 5
 #endif
+#ifndef CONFIG_WIFI_CONN_BACKOFF_MIN_MS
+#define CONFIG_WIFI_CONN_BACKOFF_MIN_MS 1000
+#endif
+#ifndef CONFIG_WIFI_CONN_BACKOFF_MAX_MS
+#define CONFIG_WIFI_CONN_BACKOFF_MAX_MS 300000
+#endif
+#ifndef CONFIG_WIFI_CONN_FALLBACK_ROUNDS
+#define CONFIG_WIFI_CONN_FALLBACK_ROUNDS 3
+#endif
+#ifndef CONFIG_WIFI_CONN_AUTH_FALLBACK
+#define CONFIG_WIFI_CONN_AUTH_FALLBACK 3
+#endif
+#ifndef CONFIG_WIFI_CONN_JOIN_TIMEOUT_MS
+#define CONFIG_WIFI_CONN_JOIN_TIMEOUT_MS 15000
+#endif
+#ifndef CONFIG_WIFI_CONN_DHCP_TIMEOUT_MS
+#define CONFIG_WIFI_CONN_DHCP_TIMEOUT_MS 30000
+#endif
 
 #ifdef __cplusplus
 extern "C"
@@ -30,9 +49,16 @@ extern "C"
         WIFI_CONN_STATE_DISCONNECTED,
     } wifi_conn_state_t;
 
-    /** Initialize Wi-Fi STA (esp_netif, nvs, wifi driver). */
+    /** Called from the supervisor task when it gives up, with the class of the last disconnect. */
+    typedef void (*wifi_conn_fallback_cb_t)(wifi_conn_reason_class_t why, void *ctx);
+
+    /** Initialize Wi-Fi STA: its task, event handlers and a hold on the shared driver (wifi_stack.h).
+     *  Again before wifi_conn_deinit(): only the new configuration (a running STA starts over). */
     esp_err_t wifi_conn_init(const wifi_conn_config_t *cfg);
 
+    /** Stop, unregister the handlers, end the task and let go of the driver. Not initialized: nothing. */
+    esp_err_t wifi_conn_deinit(void);
+
     /** Set Wi-Fi Configuration **/
     esp_err_t wifi_conn_set_wifi_config(const wifi_config_t *wifi_cfg);
 
@@ -42,10 +68,10 @@ extern "C"
     /** Get current Wi-Fi Configuration **/
     const wifi_config_t *wifi_conn_get_wifi_config(void);
 
-    /** Start Wi-fi connnection (if haven't start, auto_start = false). */
+    /** Start Wi-fi connnection (if haven't start, auto_start = false): STA joins the driver's mode. */
     esp_err_t wifi_conn_start(void);
 
-    /** Stop Wi-Fi connection. */
+    /** Stop Wi-Fi connection: STA leaves the driver's mode, the AP (if any) keeps running. */
     esp_err_t wifi_conn_stop(void);
 
     /** Return current state. */
@@ -58,6 +84,13 @@ extern "C"
     /** Get current IPv4 (if have). Return true if successful */
     bool wifi_conn_get_ipv4(uint32_t *ip_u32); // network-byte-order
 
+    /** Connect timings and fast-reconnect counters since boot (for /metrics). */
+    esp_err_t wifi_conn_get_stats(wifi_conn_stats_t *out);
+
+    /** Set the callback for the fallback policy (CONFIG_WIFI_CONN_FALLBACK_ROUNDS,
+     *  CONFIG_WIFI_CONN_AUTH_FALLBACK): bring up the provisioning AP. NULL: none. */
+    void wifi_conn_register_fallback_handler(wifi_conn_fallback_cb_t cb, void *ctx);
+
 #ifdef __cplusplus
 }
 #endif
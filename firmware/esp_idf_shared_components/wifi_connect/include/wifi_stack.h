@@ -0,0 +1,47 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+// The one Wi-Fi driver of the app, shared by wifi_connect (STA) and
+// wifi_config_ap (AP). The first user to acquire it brings up esp_netif,
+// NVS, the default event loop and the driver; each user gets its own
+// netif, created once; the last user to release it stops and deinits the
+// driver and destroys the netifs. esp_netif, NVS and the event loop stay
+// up for good (esp_netif cannot be deinitialised).
+//
+// The driver runs in the union of the modes of the users that started:
+// going from STA to AP (or having both) is a mode change, the driver is
+// only stopped when no user runs and only deinitialised when no user
+// holds it.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum
+    {
+        WIFI_STACK_USER_STA = 0, // wifi_connect
+        WIFI_STACK_USER_AP,      // wifi_config_ap
+        WIFI_STACK_USER_COUNT,
+    } wifi_stack_user_t;
+
+    /** Hold the driver for `user`; again while held: nothing. */
+    esp_err_t wifi_stack_acquire(wifi_stack_user_t user);
+
+    /** Stop `user`, destroy its netif and, if it was the last, deinit the driver. Not held: nothing. */
+    esp_err_t wifi_stack_release(wifi_stack_user_t user);
+
+    /** Netif of `user` (STA or AP), NULL if not held. */
+    esp_netif_t *wifi_stack_get_netif(wifi_stack_user_t user);
+
+    /** Run `user` in `mode`, with `cfg` (if not NULL) set on `ifx` before the driver starts. */
+    esp_err_t wifi_stack_start(wifi_stack_user_t user, wifi_mode_t mode, wifi_interface_t ifx, wifi_config_t *cfg);
+
+    /** Take the mode of `user` away; the driver stops when no user runs. Not running: nothing. */
+    esp_err_t wifi_stack_stop(wifi_stack_user_t user);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,336 @@
+#include <string.h>
+
+#include "wifi_conn_fsm.h"
+
+#define BACKOFF_DOUBLINGS_MAX 30 // beyond any backoff_max_us
+
+static bool cache_equal(const wifi_conn_cache_t *a, const wifi_conn_cache_t *b)
+{
+    return memcmp(a->bssid, b->bssid, sizeof(a->bssid)) == 0 && a->channel == b->channel && a->ip == b->ip &&
+           a->netmask == b->netmask && a->gw == b->gw && a->dns == b->dns;
+}
+
+static uint32_t next_rand(wifi_conn_fsm_t *f)
+{
+    // xorshift32: plenty for jitter
+    f->rng ^= f->rng << 13;
+    f->rng ^= f->rng >> 17;
+    f->rng ^= f->rng << 5;
+    return f->rng;
+}
+
+// Deadline of the phase just entered, fed back as WIFI_CONN_EV_TIMER
+static uint32_t arm(wifi_conn_fsm_t *f, int64_t timeout_us)
+{
+    f->retry_at_us = timeout_us > 0 ? f->now_us + timeout_us : 0;
+    return timeout_us > 0 ? WIFI_CONN_ACT_WAIT : 0;
+}
+
+// Join of all channels, back on DHCP if the cached lease was set
+static uint32_t join_scan(wifi_conn_fsm_t *f, bool again)
+{
+    uint32_t act = WIFI_CONN_ACT_JOIN_SCAN;
+    if (f->static_ip)
+    {
+        f->static_ip = false;
+        act |= WIFI_CONN_ACT_DHCP;
+    }
+    f->phase = WIFI_CONN_FSM_CONNECTING;
+    f->cached_join = false;
+    f->tries = again ? f->tries + 1 : 1;
+    f->join_us = f->now_us;
+    return act | arm(f, f->cfg.join_timeout_us);
+}
+
+// First join of a round: the cached access point if any
+static uint32_t join_first(wifi_conn_fsm_t *f)
+{
+    if (f->cfg.fast_tries <= 0 || f->cache.channel == 0)
+        return join_scan(f, false);
+
+    uint32_t act = WIFI_CONN_ACT_JOIN_CACHED;
+    if (f->cfg.reuse_lease && f->cache.ip)
+    {
+        f->static_ip = true;
+        act |= WIFI_CONN_ACT_STATIC_IP;
+    }
+    else if (f->static_ip)
+    {
+        f->static_ip = false;
+        act |= WIFI_CONN_ACT_DHCP;
+    }
+    f->phase = WIFI_CONN_FSM_CONNECTING;
+    f->cached_join = true;
+    f->tries = 1;
+    f->join_us = f->now_us;
+    return act | arm(f, f->cfg.join_timeout_us);
+}
+
+// Every join after a failed one starts here, the one place it is counted
+static uint32_t retry_now(wifi_conn_fsm_t *f)
+{
+    f->stats.retries++;
+    if (f->next_round)
+        return join_first(f);
+    if (!f->cached_join)
+        return join_scan(f, true);
+    // A miss costs one channel: try again or scan straight away
+    if (f->tries >= f->cfg.fast_tries)
+        return join_scan(f, false);
+    f->tries++;
+    f->phase = WIFI_CONN_FSM_CONNECTING;
+    f->join_us = f->now_us;
+    return WIFI_CONN_ACT_JOIN_CACHED | arm(f, f->cfg.join_timeout_us);
+}
+
+// Capped exponential backoff with equal jitter: half fixed, half random
+static uint32_t retry_later(wifi_conn_fsm_t *f, bool next_round)
+{
+    f->next_round = next_round;
+    int64_t wait = f->cfg.backoff_min_us;
+    for (int i = 0; i < f->backoff_n && i < BACKOFF_DOUBLINGS_MAX && wait < f->cfg.backoff_max_us; i++)
+        wait *= 2;
+    if (wait > f->cfg.backoff_max_us)
+        wait = f->cfg.backoff_max_us;
+    f->backoff_n++;
+    if (wait <= 0)
+        return retry_now(f);
+
+    const int64_t half = wait / 2;
+    wait = wait - half + (int64_t)(next_rand(f) % (uint64_t)(half + 1));
+    f->phase = WIFI_CONN_FSM_BACKOFF;
+    f->retry_at_us = f->now_us + wait;
+    f->stats.backoff_us += wait;
+    return WIFI_CONN_ACT_WAIT;
+}
+
+static uint32_t give_up(wifi_conn_fsm_t *f)
+{
+    uint32_t act = WIFI_CONN_ACT_FALLBACK;
+    if (!f->fail_signalled)
+    {
+        f->fail_signalled = true;
+        act |= WIFI_CONN_ACT_SIGNAL_FAIL;
+    }
+    f->phase = WIFI_CONN_FSM_FAILED;
+    f->stats.fallbacks++;
+    return act;
+}
+
+static uint32_t on_join_failed(wifi_conn_fsm_t *f, wifi_conn_reason_class_t cls)
+{
+    f->stats.retry_airtime_us += f->now_us - f->join_us;
+    f->auth_fails = cls == WIFI_CONN_REASON_AUTH ? f->auth_fails + 1 : 0;
+    if (f->cfg.auth_fallback > 0 && f->auth_fails >= f->cfg.auth_fallback)
+    {
+        f->stats.failures++;
+        return give_up(f);
+    }
+
+    if (f->cached_join)
+    {
+        // No backoff after a miss of the cached access point
+        f->stats.fast_misses++;
+        f->next_round = false;
+        return retry_now(f);
+    }
+    if (f->tries <= f->cfg.max_retry)
+        return retry_later(f, false);
+
+    // Round over: signal the first one, give up or go round again
+    uint32_t act = 0;
+    f->rounds_failed++;
+    f->stats.failures++;
+    if (f->cfg.fallback_rounds > 0 && f->rounds_failed >= f->cfg.fallback_rounds)
+        return give_up(f);
+    if (!f->fail_signalled)
+    {
+        f->fail_signalled = true;
+        act |= WIFI_CONN_ACT_SIGNAL_FAIL;
+    }
+    return act | retry_later(f, true);
+}
+
+static uint32_t on_got_ip(wifi_conn_fsm_t *f, const wifi_conn_ev_t *ev)
+{
+    uint32_t act = 0;
+    if (f->phase != WIFI_CONN_FSM_GOT_IP)
+    {
+        f->phase = WIFI_CONN_FSM_GOT_IP;
+        act |= WIFI_CONN_ACT_SIGNAL_IP;
+        if (f->cached_join)
+            f->stats.fast_hits++;
+        else
+            f->stats.scans++;
+
+        const int64_t took = ev->now_us - f->start_us;
+        f->stats.connect_us = took;
+        if (f->was_up)
+        {
+            f->stats.reconnect_last_us = took;
+            if (took > f->stats.reconnect_max_us)
+                f->stats.reconnect_max_us = took;
+            f->stats.reconnects++;
+        }
+        if (!f->stats.boot_to_ip_us)
+            f->stats.boot_to_ip_us = ev->now_us;
+        f->start_us = 0;
+        f->was_up = false;
+        f->backoff_n = 0;
+        f->rounds_failed = 0;
+        f->auth_fails = 0;
+        f->fail_signalled = false;
+    }
+
+    // Also for a renewal that changed the address
+    wifi_conn_cache_t c = {
+        .channel = f->channel,
+        .ip = ev->ip,
+        .netmask = ev->netmask,
+        .gw = ev->gw,
+        .dns = ev->dns,
+    };
+    memcpy(c.bssid, f->bssid, sizeof(c.bssid));
+    if (c.channel && !cache_equal(&c, &f->cache))
+    {
+        f->cache = c;
+        act |= WIFI_CONN_ACT_SAVE_CACHE;
+    }
+    return act;
+}
+
+/*========== Public APIs ==========*/
+void wifi_conn_fsm_init(wifi_conn_fsm_t *f, const wifi_conn_fsm_config_t *cfg, const wifi_conn_cache_t *cache,
+                        bool keep_stats)
+{
+    const wifi_conn_stats_t stats = f->stats;
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    f->rng = cfg->seed ? cfg->seed : 1;
+    if (cache)
+        f->cache = *cache;
+    if (keep_stats)
+        f->stats = stats;
+}
+
+uint32_t wifi_conn_fsm_handle(wifi_conn_fsm_t *f, const wifi_conn_ev_t *ev)
+{
+    f->now_us = ev->now_us;
+    switch (ev->type)
+    {
+    case WIFI_CONN_EV_START:
+        if (f->phase != WIFI_CONN_FSM_IDLE && f->phase != WIFI_CONN_FSM_FAILED)
+            return 0;
+        f->start_us = ev->now_us;
+        f->was_up = false;
+        f->backoff_n = 0;
+        f->rounds_failed = 0;
+        f->auth_fails = 0;
+        f->fail_signalled = false;
+        f->leaving = false;
+        return join_first(f);
+
+    case WIFI_CONN_EV_STOP:
+        f->phase = WIFI_CONN_FSM_IDLE;
+        f->start_us = 0;
+        f->was_up = false;
+        f->leaving = false;
+        return 0;
+
+    case WIFI_CONN_EV_CONNECTED:
+        // A LEAVE the driver had nothing to answer for: this is the new join
+        f->leaving = false;
+        if (f->phase != WIFI_CONN_FSM_CONNECTING)
+            return 0;
+        f->phase = WIFI_CONN_FSM_ASSOCIATED;
+        memcpy(f->bssid, ev->bssid, sizeof(f->bssid));
+        f->channel = ev->channel;
+        return arm(f, f->cfg.dhcp_timeout_us);
+
+    case WIFI_CONN_EV_DISCONNECTED:
+    {
+        // The end of the join left at its deadline, already counted
+        if (f->leaving)
+        {
+            f->leaving = false;
+            return 0;
+        }
+        // Only disconnects of a join or of the link count
+        if (f->phase != WIFI_CONN_FSM_GOT_IP && f->phase != WIFI_CONN_FSM_CONNECTING &&
+            f->phase != WIFI_CONN_FSM_ASSOCIATED)
+            return 0;
+        const wifi_conn_reason_class_t cls = wifi_conn_fsm_classify(ev->reason);
+        f->stats.reasons[cls]++;
+        f->last_reason = cls;
+        if (f->phase == WIFI_CONN_FSM_GOT_IP)
+        {
+            // Lost link: the access point it was on is the best guess, now
+            f->start_us = ev->now_us;
+            f->was_up = true;
+            return WIFI_CONN_ACT_LINK_LOST | join_first(f);
+        }
+        return on_join_failed(f, cls);
+    }
+
+    case WIFI_CONN_EV_GOT_IP:
+        // Renewals come on GOT_IP too
+        if (f->phase != WIFI_CONN_FSM_ASSOCIATED && f->phase != WIFI_CONN_FSM_GOT_IP)
+            return 0;
+        return on_got_ip(f, ev);
+
+    case WIFI_CONN_EV_TIMER:
+        if (!f->retry_at_us || ev->now_us < f->retry_at_us)
+            return 0;
+        if (f->phase == WIFI_CONN_FSM_BACKOFF)
+            return retry_now(f);
+        if (f->phase != WIFI_CONN_FSM_CONNECTING && f->phase != WIFI_CONN_FSM_ASSOCIATED)
+            return 0;
+        // No answer or no IP: whatever the driver still does, it must stop
+        f->stats.timeouts++;
+        f->last_reason = WIFI_CONN_REASON_OTHER;
+        f->leaving = true;
+        return WIFI_CONN_ACT_LEAVE | on_join_failed(f, WIFI_CONN_REASON_OTHER);
+
+    case WIFI_CONN_EV_JOIN_REFUSED:
+        if (f->phase != WIFI_CONN_FSM_CONNECTING)
+            return 0;
+        f->stats.refused++;
+        f->last_reason = WIFI_CONN_REASON_OTHER;
+        return on_join_failed(f, WIFI_CONN_REASON_OTHER);
+    }
+    return 0;
+}
+
+void wifi_conn_fsm_forget(wifi_conn_fsm_t *f)
+{
+    memset(&f->cache, 0, sizeof(f->cache));
+}
+
+wifi_conn_reason_class_t wifi_conn_fsm_classify(uint16_t reason)
+{
+    // Codes of esp_wifi_types.h (IEEE 802.11 below 200, Espressif above)
+    switch (reason)
+    {
+    case 201: // NO_AP_FOUND
+    case 210: // NO_AP_FOUND_W_COMPATIBLE_SECURITY
+    case 211: // NO_AP_FOUND_IN_AUTHMODE_THRESHOLD
+    case 212: // NO_AP_FOUND_IN_RSSI_THRESHOLD
+        return WIFI_CONN_REASON_NOT_FOUND;
+    case 14:  // MIC_FAILURE
+    case 15:  // 4WAY_HANDSHAKE_TIMEOUT
+    case 23:  // 802_1X_AUTH_FAILED
+    case 202: // AUTH_FAIL
+    case 204: // HANDSHAKE_TIMEOUT
+        return WIFI_CONN_REASON_AUTH;
+    case 3:   // AUTH_LEAVE
+    case 4:   // ASSOC_EXPIRE
+    case 8:   // ASSOC_LEAVE
+    case 34:  // MISSING_ACKS
+    case 200: // BEACON_TIMEOUT
+    case 206: // AP_TSF_RESET
+    case 209: // SA_QUERY_TIMEOUT
+        return WIFI_CONN_REASON_LINK_LOST;
+    default:
+        return WIFI_CONN_REASON_OTHER;
+    }
+}
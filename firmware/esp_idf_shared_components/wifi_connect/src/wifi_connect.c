@@ -7,7 +7,14 @@
 #include "esp_event.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "wifi_conn_fsm.h"
+#include "wifi_stack.h"
 
 #include "lwip/err.h"
 #include "lwip/sys.h"
@@ -20,110 +27,396 @@ static EventGroupHandle_t s_wifi_event_group;
 /*========== Event bits ==========*/
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT BIT1
+#define SUPERVISOR_DONE_BIT BIT2
 
 /*========== Static variables ==========*/
-static int s_retry_num = 0;
-static int s_max_retry_cfg = CONFIG_WIFI_CONN_MAX_RETRY;
 static wifi_conn_state_t s_state = WIFI_CONN_STATE_IDLE;
-static esp_netif_t *s_netif = NULL;
+static esp_netif_t *s_netif = NULL; // owned by wifi_stack
+static bool s_inited = false;
+static bool s_running = false; // between wifi_conn_start() and wifi_conn_stop()
+static esp_event_handler_instance_t s_wifi_handler = NULL;
+static esp_event_handler_instance_t s_ip_handler = NULL;
+static esp_event_handler_instance_t s_start_handler = NULL;
+
+/*========== Own event ==========*/
+// Starts go through the default event loop, queued behind the driver's
+// events of the last stop: a late disconnect of the old link reaches the
+// state machine before the start, while it is still idle
+ESP_EVENT_DEFINE_BASE(WIFI_CONN_EVENT);
+#define WIFI_CONN_EVENT_START 0
 
 /*========== Wi-Fi Configuration struct ==========*/
 static wifi_config_t s_wifi_cfg = {0};
 
-/*========== Wi-Fi Event Handler ==========*/
-static void wifi_event_handler(void *arg, esp_event_base_t event_base,
-                               int32_t event_id, void *event_data)
+/*========== Connection state machine (wifi_conn_fsm.c) ==========*/
+#if CONFIG_WIFI_CONN_FAST_RECONNECT
+#define FAST_TRIES CONFIG_WIFI_CONN_FAST_TRIES
+#define REUSE_LEASE CONFIG_WIFI_CONN_REUSE_LEASE
+#else
+#define FAST_TRIES 0
+#define REUSE_LEASE 0
+#endif
+
+static wifi_conn_fsm_t s_fsm;
+// s_fsm and the driver calls of its actions: supervisor task vs API
+// callers; kept with the stats across deinit
+static SemaphoreHandle_t s_fsm_lock;
+
+static wifi_conn_fallback_cb_t s_fallback_cb = NULL;
+static void *s_fallback_ctx = NULL;
+
+/*========== Supervisor task ==========*/
+// Runs the state machine on the Wi-Fi and IP events and its backoff timer,
+// so joins, NVS writes and waits stay off the system event loop
+#define SUPERVISOR_STACK 3072
+#define SUPERVISOR_PRIO 5
+#define SUPERVISOR_QUEUE_LEN 8
+
+static QueueHandle_t s_events = NULL;
+static TaskHandle_t s_supervisor = NULL;
+static volatile bool s_supervisor_run = false;
+static int64_t s_retry_at_us = 0; // armed backoff or deadline, 0: none (WAIT comes only from queued events)
+
+static const char *const s_reason_names[WIFI_CONN_REASON_COUNT] = {"other", "not found", "auth", "link lost"};
+
+/*========== Last access point in NVS ==========*/
+// One blob, rewritten only when the access point or the lease changes
+#define CACHE_NVS_NAMESPACE "wifi_conn"
+#define CACHE_NVS_KEY "last_ap"
+#define CACHE_VERSION 1
+
+typedef struct
+{
+    uint8_t version;
+    char ssid[33]; // the cache belongs to this network only
+    wifi_conn_cache_t ap;
+} cache_blob_t;
+
+static bool cache_load(const char *ssid, wifi_conn_cache_t *out)
+{
+    nvs_handle_t h;
+    if (nvs_open(CACHE_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK)
+        return false;
+    cache_blob_t b;
+    size_t len = sizeof(b);
+    const esp_err_t err = nvs_get_blob(h, CACHE_NVS_KEY, &b, &len);
+    nvs_close(h);
+    if (err != ESP_OK || len != sizeof(b) || b.version != CACHE_VERSION || strncmp(b.ssid, ssid, sizeof(b.ssid)) != 0)
+        return false;
+    *out = b.ap;
+    return true;
+}
+
+static void cache_save(const wifi_conn_cache_t *ap)
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
+    cache_blob_t b = {.version = CACHE_VERSION, .ap = *ap};
+    strncpy(b.ssid, (const char *)s_wifi_cfg.sta.ssid, sizeof(b.ssid) - 1);
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(CACHE_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK)
     {
-        s_state = WIFI_CONN_STATE_CONNECTING;
-        esp_wifi_connect();
+        err = nvs_set_blob(h, CACHE_NVS_KEY, &b, sizeof(b));
+        if (err == ESP_OK)
+            err = nvs_commit(h);
+        nvs_close(h);
     }
-    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "Saving the access point failed: %s", esp_err_to_name(err));
+}
+
+/*========== State machine actions ==========*/
+static void apply_static_ip(const wifi_conn_cache_t *ap)
+{
+    // The netif reports GOT_IP itself as soon as the link is up
+    esp_netif_dhcpc_stop(s_netif);
+    const esp_netif_ip_info_t ip = {.ip.addr = ap->ip, .netmask.addr = ap->netmask, .gw.addr = ap->gw};
+    esp_err_t err = esp_netif_set_ip_info(s_netif, &ip);
+    if (err == ESP_OK && ap->dns)
     {
-        s_state = WIFI_CONN_STATE_DISCONNECTED;
-        if (s_retry_num < s_max_retry_cfg)
+        esp_netif_dns_info_t dns = {.ip.type = ESP_IPADDR_TYPE_V4, .ip.u_addr.ip4.addr = ap->dns};
+        err = esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_MAIN, &dns);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Static IP failed (%s), using DHCP", esp_err_to_name(err));
+        esp_netif_dhcpc_start(s_netif);
+    }
+}
+
+static esp_err_t join(bool cached, const wifi_conn_cache_t *ap)
+{
+    if (cached)
+    {
+        // Straight to the access point: only its channel is probed
+        s_wifi_cfg.sta.bssid_set = true;
+        memcpy(s_wifi_cfg.sta.bssid, ap->bssid, sizeof(s_wifi_cfg.sta.bssid));
+        s_wifi_cfg.sta.channel = ap->channel;
+        s_wifi_cfg.sta.scan_method = WIFI_FAST_SCAN;
+        ESP_LOGI(TAG, "Joining " MACSTR " on channel %d", MAC2STR(ap->bssid), ap->channel);
+    }
+    else
+    {
+        // Every channel, then the strongest access point with the SSID
+        s_wifi_cfg.sta.bssid_set = false;
+        s_wifi_cfg.sta.channel = 0;
+        s_wifi_cfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        s_wifi_cfg.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    }
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &s_wifi_cfg);
+    if (err == ESP_OK)
+        err = esp_wifi_connect();
+    return err;
+}
+
+static void run_actions(uint32_t act, const wifi_conn_fsm_t *f)
+{
+    const wifi_conn_cache_t *ap = &f->cache;
+    if (act & WIFI_CONN_ACT_LINK_LOST)
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    if (act & WIFI_CONN_ACT_LEAVE)
+    {
+        ESP_LOGW(TAG, "No answer or no IP in time, leaving");
+        esp_wifi_disconnect();
+    }
+    if (act & WIFI_CONN_ACT_STATIC_IP)
+        apply_static_ip(ap);
+    if (act & WIFI_CONN_ACT_DHCP)
+        esp_netif_dhcpc_start(s_netif);
+    if (act & (WIFI_CONN_ACT_JOIN_CACHED | WIFI_CONN_ACT_JOIN_SCAN))
+    {
+        // Busy (a scan of wifi_config_ap) or stopped: no event would end it
+        const esp_err_t err = join(act & WIFI_CONN_ACT_JOIN_CACHED, ap);
+        if (err != ESP_OK)
         {
-            s_retry_num++;
-            ESP_LOGW(TAG, "Disconnected, retrying... (%d/%d)", s_retry_num, s_max_retry_cfg);
-            esp_wifi_connect();
+            const wifi_conn_ev_t ev = {.type = WIFI_CONN_EV_JOIN_REFUSED};
+            ESP_LOGW(TAG, "Join refused: %s", esp_err_to_name(err));
+            xQueueSend(s_events, &ev, 0); // if full, the join deadline ends it
         }
-        else
+    }
+    if (act & WIFI_CONN_ACT_SAVE_CACHE)
+        cache_save(ap);
+    if (act & WIFI_CONN_ACT_SIGNAL_IP)
+    {
+        xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    }
+    if (act & WIFI_CONN_ACT_SIGNAL_FAIL)
+    {
+        xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        ESP_LOGE(TAG, "No IP after %d retries (%s)", f->cfg.max_retry, s_reason_names[f->last_reason]);
+    }
+    if (act & WIFI_CONN_ACT_WAIT)
+    {
+        // A backoff, or the deadline of the join or of its IP
+        s_retry_at_us = f->retry_at_us;
+        if (f->phase == WIFI_CONN_FSM_BACKOFF)
+            ESP_LOGI(TAG, "Next join in %lld ms", (long long)(f->retry_at_us - f->now_us) / 1000);
+    }
+    if (act & WIFI_CONN_ACT_FALLBACK)
+    {
+        s_state = WIFI_CONN_STATE_FAILED;
+        ESP_LOGW(TAG, "Giving up (%s), falling back to the provisioning AP", s_reason_names[f->last_reason]);
+    }
+}
+
+// Feeds one event to the state machine and carries out its answer under
+// the same lock: a join decided before a wifi_conn_stop() or a new
+// configuration is done before it, never after. Only the fallback handler,
+// which may call back in, runs without it
+static void fsm_feed(wifi_conn_ev_t *ev)
+{
+    if (!ev->now_us)
+        ev->now_us = esp_timer_get_time();
+    xSemaphoreTake(s_fsm_lock, portMAX_DELAY);
+    if (ev->type == WIFI_CONN_EV_START && !s_running)
+    {
+        // Posted before a wifi_conn_stop() that got here first
+        xSemaphoreGive(s_fsm_lock);
+        return;
+    }
+    const uint32_t act = wifi_conn_fsm_handle(&s_fsm, ev);
+    run_actions(act, &s_fsm);
+    const wifi_conn_reason_class_t reason = s_fsm.last_reason;
+    xSemaphoreGive(s_fsm_lock);
+    if ((act & WIFI_CONN_ACT_FALLBACK) && s_running && s_fallback_cb)
+        s_fallback_cb(reason, s_fallback_ctx);
+}
+
+static void supervisor_task(void *arg)
+{
+    (void)arg;
+    while (s_supervisor_run)
+    {
+        TickType_t wait = portMAX_DELAY;
+        if (s_retry_at_us)
         {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-            s_state = WIFI_CONN_STATE_FAILED;
-            ESP_LOGE(TAG, "Failed to connect after %d retries", s_retry_num);
+            const int64_t left_us = s_retry_at_us - esp_timer_get_time();
+            wait = left_us > 0 ? pdMS_TO_TICKS((left_us + 999) / 1000) + 1 : 0;
         }
+        wifi_conn_ev_t ev;
+        if (xQueueReceive(s_events, &ev, wait) != pdTRUE)
+        {
+            s_retry_at_us = 0;
+            ev = (wifi_conn_ev_t){.type = WIFI_CONN_EV_TIMER};
+        }
+        fsm_feed(&ev);
+    }
+    xEventGroupSetBits(s_wifi_event_group, SUPERVISOR_DONE_BIT);
+    vTaskDelete(NULL);
+}
+
+/*========== Wi-Fi Event Handler ==========*/
+static void wifi_event_handler(void *arg, esp_event_base_t event_base,
+                               int32_t event_id, void *event_data)
+{
+    // No STA_START: WIFI_CONN_EVENT_START starts the state machine, the STA
+    // interface also comes up for the scans of wifi_config_ap
+    wifi_conn_ev_t ev = {.now_us = esp_timer_get_time()};
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+    {
+        const wifi_event_sta_connected_t *e = (const wifi_event_sta_connected_t *)event_data;
+        ev.type = WIFI_CONN_EV_CONNECTED;
+        memcpy(ev.bssid, e->bssid, sizeof(ev.bssid));
+        ev.channel = e->channel;
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        const wifi_event_sta_disconnected_t *e = (const wifi_event_sta_disconnected_t *)event_data;
+        if (s_state != WIFI_CONN_STATE_IDLE)
+            s_state = WIFI_CONN_STATE_DISCONNECTED;
+        ESP_LOGW(TAG, "Disconnected (reason %d, %s)", e->reason,
+                 s_reason_names[wifi_conn_fsm_classify(e->reason)]);
+        ev.type = WIFI_CONN_EV_DISCONNECTED;
+        ev.reason = e->reason;
+    }
+    else if (event_base == WIFI_CONN_EVENT && event_id == WIFI_CONN_EVENT_START)
+    {
+        ev.type = WIFI_CONN_EV_START;
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
         ip_event_got_ip_t *e = (ip_event_got_ip_t *)event_data;
-        s_retry_num = 0;
-        s_state = WIFI_CONN_STATE_GOT_IP;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        // Not the IP of a join that finished as wifi_conn_stop() came
+        if (s_running)
+            s_state = WIFI_CONN_STATE_GOT_IP;
         ESP_LOGI(TAG, "Got IPv4: " IPSTR, IP2STR(&e->ip_info.ip));
+        ev.type = WIFI_CONN_EV_GOT_IP;
+        ev.ip = e->ip_info.ip.addr;
+        ev.netmask = e->ip_info.netmask.addr;
+        ev.gw = e->ip_info.gw.addr;
+        esp_netif_dns_info_t dns;
+        if (esp_netif_get_dns_info(e->esp_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK &&
+            dns.ip.type == ESP_IPADDR_TYPE_V4)
+            ev.dns = dns.ip.u_addr.ip4.addr;
+    }
+    else
+    {
+        return;
     }
+    if (xQueueSend(s_events, &ev, 0) != pdTRUE)
+        ESP_LOGW(TAG, "Supervisor queue full, event %d dropped", ev.type);
 }
 
-/*========== NVS Storage Initialize ==========*/
-static esp_err_t ensure_nvs_init(void)
+// Gives back whatever owned_init() got, in reverse
+static esp_err_t teardown(void)
 {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    if (s_start_handler)
+    {
+        esp_event_handler_instance_unregister(WIFI_CONN_EVENT, WIFI_CONN_EVENT_START, s_start_handler);
+        s_start_handler = NULL;
+    }
+    if (s_ip_handler)
+    {
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, s_ip_handler);
+        s_ip_handler = NULL;
+    }
+    if (s_wifi_handler)
     {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, s_wifi_handler);
+        s_wifi_handler = NULL;
     }
-    return ret;
+    if (s_supervisor)
+    {
+        // Woken by an event that changes nothing, it leaves its loop and says so
+        s_supervisor_run = false;
+        const wifi_conn_ev_t ev = {.type = WIFI_CONN_EV_STOP};
+        xQueueSend(s_events, &ev, portMAX_DELAY);
+        xEventGroupWaitBits(s_wifi_event_group, SUPERVISOR_DONE_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
+        s_supervisor = NULL;
+    }
+    if (s_events)
+    {
+        vQueueDelete(s_events);
+        s_events = NULL;
+    }
+    if (s_wifi_event_group)
+    {
+        vEventGroupDelete(s_wifi_event_group);
+        s_wifi_event_group = NULL;
+    }
+    s_retry_at_us = 0;
+    s_netif = NULL;
+    return wifi_stack_release(WIFI_STACK_USER_STA);
 }
 
-/**========== Public Functions ==========*/
-esp_err_t wifi_conn_init(const wifi_conn_config_t *cfg)
+// Handles of the module, once until wifi_conn_deinit()
+static esp_err_t owned_init(void)
 {
+    if (!s_fsm_lock)
+        s_fsm_lock = xSemaphoreCreateMutex();
+    if (!s_fsm_lock)
+        return ESP_ERR_NO_MEM;
     s_wifi_event_group = xEventGroupCreate();
     if (!s_wifi_event_group)
         return ESP_ERR_NO_MEM;
+    s_events = xQueueCreate(SUPERVISOR_QUEUE_LEN, sizeof(wifi_conn_ev_t));
+    if (!s_events)
+        return ESP_ERR_NO_MEM;
 
-    /* Initilize Netif and NVS */
-    esp_err_t netif_err = esp_netif_init();
-    if (netif_err != ESP_OK)
-        return netif_err;
-
-    esp_err_t nvs_err = ensure_nvs_init();
-    if (nvs_err != ESP_OK)
-        return nvs_err;
-
-    esp_err_t evt_loop_err = esp_event_loop_create_default();
-    if (evt_loop_err != ESP_OK && evt_loop_err != ESP_ERR_INVALID_STATE)
-        return evt_loop_err;
+    /* esp_netif, NVS, event loop, driver: shared with wifi_config_ap */
+    esp_err_t err = wifi_stack_acquire(WIFI_STACK_USER_STA);
+    if (err != ESP_OK)
+        return err;
+    s_netif = wifi_stack_get_netif(WIFI_STACK_USER_STA);
 
-    if (!s_netif)
+    s_supervisor_run = true;
+    if (xTaskCreate(supervisor_task, "wifi_conn", SUPERVISOR_STACK, NULL, SUPERVISOR_PRIO, &s_supervisor) != pdPASS)
     {
-        s_netif = esp_netif_create_default_wifi_sta();
+        s_supervisor = NULL;
+        return ESP_ERR_NO_MEM;
     }
 
-    /* Initialize Wi-Fi */
-    wifi_init_config_t wicfg = WIFI_INIT_CONFIG_DEFAULT();
-    esp_err_t wifi_init_err = esp_wifi_init(&wicfg);
-    if (wifi_init_err != ESP_OK)
-        return wifi_init_err;
-
     /* Event instances register */
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &wifi_event_handler,
-                                                        NULL,
-                                                        &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &wifi_event_handler,
-                                                        NULL,
-                                                        &instance_got_ip));
-
-    // Set Wi-Fi mode to STA
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    err = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL,
+                                              &s_wifi_handler);
+    if (err != ESP_OK)
+        return err;
+    err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL,
+                                              &s_ip_handler);
+    if (err != ESP_OK)
+        return err;
+    return esp_event_handler_instance_register(WIFI_CONN_EVENT, WIFI_CONN_EVENT_START, &wifi_event_handler, NULL,
+                                               &s_start_handler);
+}
+
+/**========== Public Functions ==========*/
+esp_err_t wifi_conn_init(const wifi_conn_config_t *cfg)
+{
+    if (!s_inited)
+    {
+        esp_err_t err = owned_init();
+        if (err != ESP_OK)
+        {
+            teardown();
+            return err;
+        }
+        s_inited = true;
+    }
+    else if (s_running)
+    {
+        // Again: a new configuration, from the start
+        wifi_conn_stop();
+    }
 
     /* Select SSID, Password, Max Retry from cfg or Kconfig */
     const char *ssid = (cfg && cfg->ssid) ? cfg->ssid : CONFIG_WIFI_CONN_SSID;
@@ -147,10 +440,28 @@ esp_err_t wifi_conn_init(const wifi_conn_config_t *cfg)
         s_wifi_cfg.sta.pmf_cfg.required = false;
     }
 
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_cfg));
-
-    /* Initial static config variables */
-    s_max_retry_cfg = (cfg && cfg->max_retry >= 0) ? cfg->max_retry : CONFIG_WIFI_CONN_MAX_RETRY;
+    /* State machine, with the last access point of this SSID if any */
+    const wifi_conn_fsm_config_t fsm_cfg = {
+        .max_retry = (cfg && cfg->max_retry >= 0) ? cfg->max_retry : CONFIG_WIFI_CONN_MAX_RETRY,
+        .fast_tries = FAST_TRIES,
+        .reuse_lease = REUSE_LEASE,
+        .backoff_min_us = (int64_t)CONFIG_WIFI_CONN_BACKOFF_MIN_MS * 1000,
+        .backoff_max_us = (int64_t)CONFIG_WIFI_CONN_BACKOFF_MAX_MS * 1000,
+        .fallback_rounds = CONFIG_WIFI_CONN_FALLBACK_ROUNDS,
+        .auth_fallback = CONFIG_WIFI_CONN_AUTH_FALLBACK,
+        .join_timeout_us = (int64_t)CONFIG_WIFI_CONN_JOIN_TIMEOUT_MS * 1000,
+        .dhcp_timeout_us = (int64_t)CONFIG_WIFI_CONN_DHCP_TIMEOUT_MS * 1000,
+        .seed = esp_random(),
+    };
+    wifi_conn_cache_t ap;
+    const bool cached = FAST_TRIES > 0 && cache_load(ssid, &ap);
+    xSemaphoreTake(s_fsm_lock, portMAX_DELAY);
+    if (s_fsm.static_ip)
+        esp_netif_dhcpc_start(s_netif); // a static lease of the last round
+    wifi_conn_fsm_init(&s_fsm, &fsm_cfg, cached ? &ap : NULL, /*keep_stats=*/true);
+    xSemaphoreGive(s_fsm_lock);
+    if (cached)
+        ESP_LOGI(TAG, "Last access point " MACSTR " on channel %d", MAC2STR(ap.bssid), ap.channel);
     s_state = WIFI_CONN_STATE_IDLE;
 
     if (cfg && cfg->auto_start)
@@ -161,31 +472,44 @@ esp_err_t wifi_conn_init(const wifi_conn_config_t *cfg)
     return ESP_OK;
 }
 
+// New configuration: joins again from the start, the cached access point
+// only if it is on the same network
+static void rejoin(bool same_ssid)
+{
+    if (!s_fsm_lock)
+        return;
+    if (!same_ssid)
+    {
+        xSemaphoreTake(s_fsm_lock, portMAX_DELAY);
+        wifi_conn_fsm_forget(&s_fsm);
+        xSemaphoreGive(s_fsm_lock);
+    }
+    // Stopped first, so a join under way ends before the disconnect
+    wifi_conn_ev_t ev = {.type = WIFI_CONN_EV_STOP};
+    fsm_feed(&ev);
+    esp_wifi_disconnect();
+    s_state = WIFI_CONN_STATE_CONNECTING;
+    // After the disconnect above
+    esp_event_post(WIFI_CONN_EVENT, WIFI_CONN_EVENT_START, NULL, 0, portMAX_DELAY);
+}
+
 esp_err_t wifi_conn_set_wifi_config(const wifi_config_t *wifi_cfg)
 {
     if (!wifi_cfg)
         return ESP_ERR_INVALID_ARG;
 
+    const bool same_ssid = memcmp(s_wifi_cfg.sta.ssid, wifi_cfg->sta.ssid, sizeof(s_wifi_cfg.sta.ssid)) == 0;
     memcpy(&s_wifi_cfg, wifi_cfg, sizeof(s_wifi_cfg));
 
-    esp_err_t set_mode_err = esp_wifi_set_mode(WIFI_MODE_STA);
-    if (set_mode_err != ESP_OK)
-        return set_mode_err;
-
-    esp_err_t set_cfg_err = esp_wifi_set_config(WIFI_IF_STA, &s_wifi_cfg);
-    if (set_cfg_err != ESP_OK)
-        return set_cfg_err;
-
-    wifi_mode_t mode;
-    if (esp_wifi_get_mode(&mode) == ESP_OK && (mode & WIFI_MODE_STA))
+    if (s_running)
     {
-        // If Wi-Fi is already in STA mode, reconnect with new config
-        esp_wifi_disconnect();
-        s_retry_num = 0;
-        esp_wifi_connect();
+        // Reconnect with new config; the join sets it on the driver
+        rejoin(same_ssid);
+    }
+    else
+    {
+        s_state = WIFI_CONN_STATE_IDLE;
     }
-
-    s_state = WIFI_CONN_STATE_IDLE;
     return ESP_OK;
 }
 
@@ -200,6 +524,7 @@ esp_err_t wifi_conn_set_ssid_password(const char *ssid, const char *password)
         return ESP_ERR_INVALID_ARG;
 
     // Update internal wifi_config_t
+    const bool same_ssid = strncmp((const char *)s_wifi_cfg.sta.ssid, ssid, sizeof(s_wifi_cfg.sta.ssid)) == 0;
     memset(s_wifi_cfg.sta.ssid, 0, sizeof(s_wifi_cfg.sta.ssid));
     memset(s_wifi_cfg.sta.password, 0, sizeof(s_wifi_cfg.sta.password));
 
@@ -220,21 +545,15 @@ esp_err_t wifi_conn_set_ssid_password(const char *ssid, const char *password)
         s_wifi_cfg.sta.pmf_cfg.required = false;
     }
 
-    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &s_wifi_cfg);
-
-    if (err != ESP_OK)
-        return err;
-
-    wifi_mode_t mode;
-    if (esp_wifi_get_mode(&mode) == ESP_OK && (mode & WIFI_MODE_STA))
+    if (s_running)
     {
-        // If Wi-Fi is already in STA mode, reconnect with new config
-        esp_wifi_disconnect();
-        s_retry_num = 0;
-        esp_wifi_connect();
+        // Reconnect with new config; the join sets it on the driver
+        rejoin(same_ssid);
+    }
+    else
+    {
+        s_state = WIFI_CONN_STATE_IDLE;
     }
-
-    s_state = WIFI_CONN_STATE_IDLE;
 
     return ESP_OK;
 }
@@ -246,32 +565,46 @@ const wifi_config_t *wifi_conn_get_wifi_config(void)
 
 esp_err_t wifi_conn_start(void)
 {
-    // Reset retry counter
-    s_retry_num = 0;
-    // Ensure that Wi-Fi EvenGroup had been initialized
-    if (!s_wifi_event_group)
+    if (!s_inited)
         return ESP_ERR_INVALID_STATE;
-    esp_err_t start_err = esp_wifi_start();
+    // STA added to the driver's mode: started, or already up for the AP's scans
+    esp_err_t start_err = wifi_stack_start(WIFI_STACK_USER_STA, WIFI_MODE_STA, WIFI_IF_STA, &s_wifi_cfg);
     if (start_err != ESP_OK)
         return start_err;
-    // WIFI_EVENT_STA_START will call esp_wifi_connect() in handler
-    return ESP_OK;
+    s_running = true;
+    s_state = WIFI_CONN_STATE_CONNECTING;
+    return esp_event_post(WIFI_CONN_EVENT, WIFI_CONN_EVENT_START, NULL, 0, portMAX_DELAY);
 }
 
 esp_err_t wifi_conn_stop(void)
 {
-    if (!s_wifi_event_group)
+    if (!s_inited)
         return ESP_ERR_INVALID_STATE;
+    // Stopped first, so the disconnect below is no lost link
+    s_running = false;
+    wifi_conn_ev_t ev = {.type = WIFI_CONN_EV_STOP};
+    fsm_feed(&ev);
     esp_wifi_disconnect();
-    esp_err_t err = esp_wifi_stop();
-    if (err != ESP_OK && err != ESP_ERR_WIFI_NOT_INIT && err != ESP_ERR_WIFI_NOT_STARTED)
+    // Only the STA leaves the mode; the driver stops if nothing else runs
+    esp_err_t err = wifi_stack_stop(WIFI_STACK_USER_STA);
+    if (err != ESP_OK)
         return err;
     s_state = WIFI_CONN_STATE_IDLE;
-    s_retry_num = 0;
     xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
     return ESP_OK;
 }
 
+esp_err_t wifi_conn_deinit(void)
+{
+    if (!s_inited)
+        return ESP_OK;
+    wifi_conn_stop();
+    const esp_err_t err = teardown();
+    s_state = WIFI_CONN_STATE_IDLE;
+    s_inited = false;
+    return err;
+}
+
 wifi_conn_state_t wifi_conn_get_state(void)
 {
     return s_state;
@@ -279,6 +612,8 @@ wifi_conn_state_t wifi_conn_get_state(void)
 
 esp_err_t wifi_conn_wait_ip(int timeout_ms)
 {
+    if (!s_wifi_event_group)
+        return ESP_ERR_INVALID_STATE;
     EventBits_t bits = xEventGroupWaitBits(
         s_wifi_event_group,
         WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
@@ -304,3 +639,21 @@ bool wifi_conn_get_ipv4(uint32_t *ip_u32)
     }
     return false;
 }
+
+esp_err_t wifi_conn_get_stats(wifi_conn_stats_t *out)
+{
+    if (!out)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_fsm_lock)
+        return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_fsm_lock, portMAX_DELAY);
+    *out = s_fsm.stats;
+    xSemaphoreGive(s_fsm_lock);
+    return ESP_OK;
+}
+
+void wifi_conn_register_fallback_handler(wifi_conn_fallback_cb_t cb, void *ctx)
+{
+    s_fallback_cb = cb;
+    s_fallback_ctx = ctx;
+}
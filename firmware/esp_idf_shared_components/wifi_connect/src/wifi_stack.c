@@ -0,0 +1,209 @@
+#include "wifi_stack.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+
+static const char *TAG = "wifi_stack";
+
+static SemaphoreHandle_t s_lock = NULL; // for good, like esp_netif
+static bool s_base_up = false;          // esp_netif, NVS, default event loop
+static uint32_t s_held = 0;             // bit per user
+static wifi_mode_t s_modes[WIFI_STACK_USER_COUNT]; // of the users that run, WIFI_MODE_NULL: stopped
+static esp_netif_t *s_netifs[WIFI_STACK_USER_COUNT];
+static wifi_mode_t s_mode = WIFI_MODE_NULL; // set on the driver
+static bool s_started = false;
+
+#define USER_BIT(u) (1u << (u))
+
+/*========== NVS Storage Initialize ==========*/
+static esp_err_t ensure_nvs_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    return ret;
+}
+
+// What every user needs once, and no one can give back
+static esp_err_t base_init(void)
+{
+    if (s_base_up)
+        return ESP_OK;
+    esp_err_t err = esp_netif_init();
+    if (err != ESP_OK)
+        return err;
+    err = ensure_nvs_init();
+    if (err != ESP_OK)
+        return err;
+    err = esp_event_loop_create_default();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+        return err;
+    s_base_up = true;
+    return ESP_OK;
+}
+
+// Driver in the union of the running users' modes; `cfg` set on `ifx` before it starts
+static esp_err_t apply_mode(wifi_interface_t ifx, wifi_config_t *cfg)
+{
+    wifi_mode_t want = WIFI_MODE_NULL;
+    for (int i = 0; i < WIFI_STACK_USER_COUNT; i++)
+        want = (wifi_mode_t)(want | s_modes[i]);
+
+    esp_err_t err;
+    if (want == WIFI_MODE_NULL)
+    {
+        if (!s_started)
+            return ESP_OK;
+        err = esp_wifi_stop();
+        if (err != ESP_OK && err != ESP_ERR_WIFI_NOT_STARTED)
+            return err;
+        s_started = false;
+        ESP_LOGI(TAG, "Driver stopped");
+        return ESP_OK;
+    }
+    if (want != s_mode)
+    {
+        // Started or not: the interfaces come and go with their events
+        err = esp_wifi_set_mode(want);
+        if (err != ESP_OK)
+            return err;
+        s_mode = want;
+        ESP_LOGI(TAG, "Mode %s%s", (want & WIFI_MODE_STA) ? "STA" : "", (want & WIFI_MODE_AP) ? "AP" : "");
+    }
+    if (cfg)
+    {
+        err = esp_wifi_set_config(ifx, cfg);
+        if (err != ESP_OK)
+            return err;
+    }
+    if (!s_started)
+    {
+        err = esp_wifi_start();
+        if (err != ESP_OK)
+            return err;
+        s_started = true;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t hold(wifi_stack_user_t user)
+{
+    esp_err_t err = base_init();
+    if (err != ESP_OK)
+        return err;
+    if (!s_held)
+    {
+        wifi_init_config_t wicfg = WIFI_INIT_CONFIG_DEFAULT();
+        err = esp_wifi_init(&wicfg);
+        if (err != ESP_OK)
+            return err;
+        ESP_LOGI(TAG, "Driver initialised");
+    }
+    s_netifs[user] = user == WIFI_STACK_USER_STA ? esp_netif_create_default_wifi_sta()
+                                                 : esp_netif_create_default_wifi_ap();
+    if (!s_netifs[user])
+    {
+        if (!s_held)
+            esp_wifi_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    s_held |= USER_BIT(user);
+    return ESP_OK;
+}
+
+/*========== Public APIs ==========*/
+esp_err_t wifi_stack_acquire(wifi_stack_user_t user)
+{
+    if (user >= WIFI_STACK_USER_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        s_lock = xSemaphoreCreateMutex();
+    if (!s_lock)
+        return ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const esp_err_t err = (s_held & USER_BIT(user)) ? ESP_OK : hold(user);
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t wifi_stack_release(wifi_stack_user_t user)
+{
+    if (user >= WIFI_STACK_USER_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (s_held & USER_BIT(user))
+    {
+        s_modes[user] = WIFI_MODE_NULL;
+        err = apply_mode(WIFI_IF_STA, NULL);
+        esp_netif_destroy_default_wifi(s_netifs[user]);
+        s_netifs[user] = NULL;
+        s_held &= ~USER_BIT(user);
+        if (!s_held)
+        {
+            // Stopped above: no user held, so none ran
+            const esp_err_t deinit_err = esp_wifi_deinit();
+            if (err == ESP_OK)
+                err = deinit_err;
+            s_mode = WIFI_MODE_NULL;
+            ESP_LOGI(TAG, "Driver deinitialised");
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_netif_t *wifi_stack_get_netif(wifi_stack_user_t user)
+{
+    return user < WIFI_STACK_USER_COUNT ? s_netifs[user] : NULL;
+}
+
+esp_err_t wifi_stack_start(wifi_stack_user_t user, wifi_mode_t mode, wifi_interface_t ifx, wifi_config_t *cfg)
+{
+    if (user >= WIFI_STACK_USER_COUNT || mode == WIFI_MODE_NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (s_held & USER_BIT(user))
+    {
+        const wifi_mode_t was = s_modes[user];
+        s_modes[user] = mode;
+        err = apply_mode(ifx, cfg);
+        if (err != ESP_OK)
+            s_modes[user] = was;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t wifi_stack_stop(wifi_stack_user_t user)
+{
+    if (user >= WIFI_STACK_USER_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (s_modes[user] != WIFI_MODE_NULL)
+    {
+        s_modes[user] = WIFI_MODE_NULL;
+        err = apply_mode(WIFI_IF_STA, NULL);
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
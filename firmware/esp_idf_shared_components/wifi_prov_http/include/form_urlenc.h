@@ -0,0 +1,57 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental application/x-www-form-urlencoded parser. The body is fed
+// in pieces as httpd_req_recv() returns them and read once: the values of
+// the wanted keys are decoded ('+' and %XX) straight into the caller's
+// buffers, everything else is skipped. No allocation, no copy of the body.
+//
+// Same results as splitting the whole body at '&' and '=' and decoding
+// the names and values (the WHATWG rules): the first pair of a name wins,
+// a pair without '=' has an empty value, a '%' not followed by two hex
+// digits is kept as is. Plain C: wifi_prov_http uses it behind
+// esp_http_server, host_tools/form_urlenc fuzzes and times it.
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define FORM_URLENC_KEY_MAX 32 // longer keys match no field
+
+    typedef struct
+    {
+        const char *key;
+        char *out;       // NUL-terminated value, "" if absent
+        size_t out_size; // including the NUL, >= 1
+        size_t len;      // bytes in `out` (a %00 decodes to a NUL)
+        bool seen;
+        bool truncated;  // the value did not fit; `out` holds its start
+    } form_urlenc_field_t;
+
+    typedef struct
+    {
+        form_urlenc_field_t *fields;
+        size_t n_fields;
+        int field; // taking the value of this field, -1: none
+        bool in_value;
+        uint8_t pct;    // 1 after a '%', 2 after its first hex digit
+        char pct_hi;    // that digit
+        char key[FORM_URLENC_KEY_MAX];
+        size_t key_len; // may exceed FORM_URLENC_KEY_MAX: too long
+        size_t bytes;   // fed so far
+    } form_urlenc_t;
+
+    // `fields` is cleared and filled in as the body comes
+    void form_urlenc_init(form_urlenc_t *p, form_urlenc_field_t *fields, size_t n_fields);
+
+    void form_urlenc_feed(form_urlenc_t *p, const char *data, size_t len);
+
+    // Ends the body (a pending "%X" is kept as is)
+    void form_urlenc_finish(form_urlenc_t *p);
+
+#ifdef __cplusplus
+}
+#endif
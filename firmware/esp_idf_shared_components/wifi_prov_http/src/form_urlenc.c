@@ -0,0 +1,205 @@
+#include <string.h>
+
+#include "form_urlenc.h"
+
+// Byte classes: IN_NAME and IN_VALUE mark the bytes that are not copied
+// as they are in a name or a value
+#define IN_NAME 1
+#define IN_VALUE 2
+#define HEX 4
+static const uint8_t s_class[256] = {
+    ['&'] = IN_NAME | IN_VALUE, ['+'] = IN_NAME | IN_VALUE, ['%'] = IN_NAME | IN_VALUE, ['='] = IN_NAME,
+    ['0'] = HEX, ['1'] = HEX, ['2'] = HEX, ['3'] = HEX, ['4'] = HEX, ['5'] = HEX, ['6'] = HEX, ['7'] = HEX,
+    ['8'] = HEX, ['9'] = HEX, ['a'] = HEX, ['b'] = HEX, ['c'] = HEX, ['d'] = HEX, ['e'] = HEX, ['f'] = HEX,
+    ['A'] = HEX, ['B'] = HEX, ['C'] = HEX, ['D'] = HEX, ['E'] = HEX, ['F'] = HEX,
+};
+
+static bool is_hex(char c)
+{
+    return s_class[(uint8_t)c] & HEX;
+}
+
+// Of a hex digit: '0'-'9' are 0x3X, 'A'-'F' and 'a'-'f' 0x4X and 0x6X
+static uint8_t hex_digit(char c)
+{
+    return (uint8_t)((c & 0xF) + (c >> 6) * 9);
+}
+
+// Decoded bytes of the current name or value
+static void put(form_urlenc_t *p, const char *s, size_t n)
+{
+    if (!p->in_value)
+    {
+        if (p->key_len < FORM_URLENC_KEY_MAX)
+        {
+            const size_t room = FORM_URLENC_KEY_MAX - p->key_len;
+            memcpy(p->key + p->key_len, s, n < room ? n : room);
+        }
+        p->key_len += n;
+        return;
+    }
+    if (p->field < 0)
+        return;
+    form_urlenc_field_t *f = &p->fields[p->field];
+    const size_t room = f->out_size - 1 - f->len;
+    if (n > room)
+    {
+        f->truncated = true;
+        n = room;
+    }
+    memcpy(f->out + f->len, s, n);
+    f->len += n;
+}
+
+static void put_byte(form_urlenc_t *p, char c)
+{
+    put(p, &c, 1);
+}
+
+// A '%' that did not start an escape stays as typed
+static void flush_pct(form_urlenc_t *p)
+{
+    const uint8_t pct = p->pct;
+    p->pct = 0;
+    if (pct)
+        put_byte(p, '%');
+    if (pct == 2)
+        put_byte(p, p->pct_hi);
+}
+
+static void start_value(form_urlenc_t *p)
+{
+    p->in_value = true;
+    p->field = -1;
+    if (p->key_len >= FORM_URLENC_KEY_MAX)
+        return;
+    for (size_t i = 0; i < p->n_fields; i++)
+    {
+        form_urlenc_field_t *f = &p->fields[i];
+        if (!f->seen && strlen(f->key) == p->key_len && !memcmp(f->key, p->key, p->key_len))
+        {
+            f->seen = true;
+            p->field = (int)i;
+            return;
+        }
+    }
+}
+
+static void end_pair(form_urlenc_t *p)
+{
+    flush_pct(p);
+    // "name" alone is a pair with an empty value; "&&" is no pair
+    if (!p->in_value && p->key_len)
+        start_value(p);
+    if (p->field >= 0)
+        p->fields[p->field].out[p->fields[p->field].len] = 0;
+    p->field = -1;
+    p->in_value = false;
+    p->key_len = 0;
+}
+
+/*========== Public APIs ==========*/
+void form_urlenc_init(form_urlenc_t *p, form_urlenc_field_t *fields, size_t n_fields)
+{
+    memset(p, 0, sizeof(*p));
+    p->fields = fields;
+    p->n_fields = n_fields;
+    p->field = -1;
+    for (size_t i = 0; i < n_fields; i++)
+    {
+        fields[i].out[0] = 0;
+        fields[i].len = 0;
+        fields[i].seen = false;
+        fields[i].truncated = false;
+    }
+}
+
+void form_urlenc_feed(form_urlenc_t *p, const char *data, size_t len)
+{
+    p->bytes += len;
+    size_t i = 0;
+    while (i < len)
+    {
+        // The value of a key nobody asked for: on to the next pair
+        if (p->in_value && p->field < 0)
+        {
+            const char *amp = memchr(data + i, '&', len - i);
+            if (!amp)
+                return;
+            i = (size_t)(amp - data) + 1;
+            p->pct = 0;
+            end_pair(p);
+            continue;
+        }
+
+        // An escape split across pieces, a byte at a time
+        if (p->pct)
+        {
+            const char c = data[i];
+            if (is_hex(c))
+            {
+                i++;
+                if (p->pct == 1)
+                {
+                    p->pct_hi = c;
+                    p->pct = 2;
+                    continue;
+                }
+                p->pct = 0;
+                put_byte(p, (char)(hex_digit(p->pct_hi) << 4 | hex_digit(c)));
+                continue;
+            }
+            flush_pct(p);
+        }
+
+        // Bytes copied as they are, in one go
+        const uint8_t mask = p->in_value ? IN_VALUE : IN_NAME;
+        size_t j = i;
+        while (j < len && !(s_class[(uint8_t)data[j]] & mask))
+            j++;
+        if (j > i)
+        {
+            put(p, data + i, j - i);
+            i = j;
+            continue;
+        }
+
+        const char c = data[i++];
+        switch (c)
+        {
+        case '&':
+            end_pair(p);
+            break;
+        case '=':
+            start_value(p);
+            break;
+        case '+':
+            put_byte(p, ' ');
+            break;
+        default: // '%'
+        {
+            // Escapes in a row (UTF-8 names, symbols) decoded in one go
+            char dec[32];
+            size_t n = 0;
+            while (i + 1 < len && is_hex(data[i]) && is_hex(data[i + 1]))
+            {
+                dec[n++] = (char)(hex_digit(data[i]) << 4 | hex_digit(data[i + 1]));
+                i += 2;
+                if (n == sizeof(dec) || i == len || data[i] != '%')
+                    break;
+                i++;
+            }
+            put(p, dec, n);
+            // Stopped past a '%' with no whole escape behind it in this piece
+            if (data[i - 1] == '%')
+                p->pct = 1;
+            break;
+        }
+        }
+    }
+}
+
+void form_urlenc_finish(form_urlenc_t *p)
+{
+    end_pair(p);
+}
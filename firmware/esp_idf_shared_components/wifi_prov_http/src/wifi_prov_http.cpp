@@ -1,142 +1,147 @@
-#include <stdlib.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "wifi_prov_http.h"
 
 #include "esp_log.h"
 #include "esp_http_server.h"
+#include "esp_netif.h"
+#include "form_urlenc.h"
+#include "httpd_async.h"
+#include "wifi_config_ap.h"
 #include "wifi_nvs.h"
 
 static const char *TAG = "wifi_prov_http";
 
+// A client gets this long to send the whole form, however slowly it trickles
+static const uint32_t save_body_timeout_ms = 5000;
+// Bounds the time a worker spends on /save; the form needs under 300 bytes
+static const size_t max_content_len = 2048;
+
+// www/index.html as embedded by CMakeLists.txt
+extern const uint8_t index_html_start[] asm("_binary_index_html_start");
+extern const uint8_t index_html_end[] asm("_binary_index_html_end");
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+
+static char index_etag[12]; // hash of the page
+static char portal_url[24]; // http://<AP address>/
+static char hdr_buf[64];    // request headers, httpd task only
+
+// /scan.json, httpd task only
+static wifi_scan_ap_t scan_aps[CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS];
+static char scan_buf[2 * WIFI_SCAN_AP_JSON_MAX];
+
 static httpd_handle_t server_handle = NULL;
+static int save_route = -1;
 static wifi_prov_http_handle_save_t save_handler = NULL;
 static void *save_handler_user_ctx = NULL;
 
 /* ---------- Utils ---------- */
-// Decode a single hex character to its integer value
-static int hexval(char c)
+// Validate the lengths of SSID and password
+static bool creds_len_valid(const char *ssid, const char *pass)
 {
-    if (c >= '0' && c <= '9')
-        return c - '0';
-    if (c >= 'a' && c <= 'f')
-        return c - 'a' + 10;
-    if (c >= 'A' && c <= 'F')
-        return c - 'A' + 10;
-    return -1;
+    if (!ssid || !pass)
+        return false;
+    size_t sl = strlen(ssid), pl = strlen(pass);
+    if (sl == 0 || sl > 32)
+        return false;
+    if (pl > 64)
+        return false;
+    return true;
 }
 
-// URL-decode a string in place
-static size_t url_decode(char *s)
+/* ---------- HTTP Handlers ---------- */
+// Handler for the root path, serves the HTML form gzipped from flash
+static esp_err_t root_get_handler(httpd_req_t *req)
 {
-    char *o = s, *p = s;
-    while (*p)
+    // Only a firmware update changes the page: browsers revalidate hourly
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", hdr_buf, sizeof(hdr_buf)) == ESP_OK &&
+        strcmp(hdr_buf, index_etag) == 0)
     {
-        if (*p == '%')
-        {
-            int h1 = hexval(*(p + 1)), h2 = hexval(*(p + 2));
-            if (h1 >= 0 && h2 >= 0)
-            {
-                *o++ = (char)((h1 << 4) | h2);
-                p += 3;
-            }
-            else
-            {
-                *o++ = *p++;
-            }
-        }
-        else if (*p == '+')
-        {
-            *o++ = ' ';
-            p++;
-        }
-        else
-        {
-            *o++ = *p++;
-        }
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", index_etag);
+        return httpd_resp_send(req, NULL, 0);
     }
-    *o = 0;
-    return (size_t)(o - s);
+
+    httpd_resp_set_type(req, "text/html; charset=utf-8");
+    httpd_resp_set_hdr(req, "Cache-Control", "max-age=3600");
+    httpd_resp_set_hdr(req, "ETag", index_etag);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    // A long list is cut short, gzip is near its start
+    const esp_err_t ae = httpd_req_get_hdr_value_str(req, "Accept-Encoding", hdr_buf, sizeof(hdr_buf));
+    const bool gzip = (ae == ESP_OK || ae == ESP_ERR_HTTPD_RESULT_TRUNC) && strstr(hdr_buf, "gzip") != NULL;
+    if (!gzip)
+        return httpd_resp_send(req, (const char *)index_html_start, index_html_end - index_html_start);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)index_html_gz_start, index_html_gz_end - index_html_gz_start);
 }
 
-// Extract the value for a given key from URL-encoded form data
-static void form_get_kv(const char *body, const char *key, char *out, size_t outlen)
+// Handler for the networks in range, as the AP's background scans last saw
+// them; the page polls while the first scan runs (age_ms -1)
+static esp_err_t scan_get_handler(httpd_req_t *req)
 {
-    if (!out || outlen == 0)
-    {
-        return;
-    }
-    out[0] = 0;
-    const size_t klen = strlen(key);
-    const char *p = body;
-    while (p && *p)
+    size_t n = 0;
+    int32_t age_ms = -1;
+    if (wifi_config_ap_get_scan(scan_aps, CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS, &n, &age_ms) != ESP_OK)
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No scan");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    // Whole entries per chunk, strongest first
+    size_t len = (size_t)snprintf(scan_buf, sizeof(scan_buf), "{\"age_ms\":%ld,\"aps\":[", (long)age_ms);
+    for (size_t i = 0; i < n; i++)
     {
-        const char *eq = strchr(p, '=');
-        if (!eq)
-            break;
-        if ((size_t)(eq - p) == klen && strncmp(p, key, klen) == 0)
+        if (sizeof(scan_buf) - len < WIFI_SCAN_AP_JSON_MAX + 3)
         {
-            const char *val = eq + 1;
-            const char *amp = strchr(val, '&');
-            size_t len = amp ? (size_t)(amp - val) : strlen(val);
-            if (len >= outlen)
-                len = outlen - 1;
-            memcpy(out, val, len);
-            out[len] = 0;
-            url_decode(out);
-            return;
+            if (httpd_resp_send_chunk(req, scan_buf, len) != ESP_OK)
+                return ESP_FAIL;
+            len = 0;
         }
-        const char *amp = strchr(p, '&');
-        p = amp ? amp + 1 : NULL;
+        if (i > 0)
+            scan_buf[len++] = ',';
+        len += wifi_scan_ap_json(&scan_aps[i], scan_buf + len, sizeof(scan_buf) - len);
     }
+    memcpy(scan_buf + len, "]}", 2);
+    if (httpd_resp_send_chunk(req, scan_buf, len + 2) != ESP_OK)
+        return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
 }
 
-// Validate the lengths of SSID and password
-static bool creds_len_valid(const char *ssid, const char *pass)
+// Connectivity checks of the common OSes. Answered with a redirect to the
+// page, they make the phone show it as a sign-in screen at once instead of
+// flagging the network as having no internet.
+static const char *const probe_uris[] = {
+    "/generate_204",        // Android, ChromeOS
+    "/gen_204",             // Android
+    "/hotspot-detect.html", // iOS, macOS
+    "/connecttest.txt",     // Windows 10+
+    "/ncsi.txt",            // older Windows
+    "/redirect",            // Windows, after the test fails
+    "/canonical.html",      // Firefox
+    "/success.txt",         // Firefox
+};
+
+static esp_err_t redirect_to_portal(httpd_req_t *req)
 {
-    if (!ssid || !pass)
-        return false;
-    size_t sl = strlen(ssid), pl = strlen(pass);
-    if (sl == 0 || sl > 32)
-        return false;
-    if (pl > 64)
-        return false;
-    return true;
+    httpd_resp_set_status(req, "302 Found");
+    httpd_resp_set_hdr(req, "Location", portal_url);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, NULL, 0);
 }
 
-/* ---------- HTTP Handlers ---------- */
-// Handler for the root path, serves the HTML form
-static esp_err_t root_get_handler(httpd_req_t *req)
+// Handler for the probe URIs above
+static esp_err_t probe_get_handler(httpd_req_t *req)
 {
-    static const char html[] = R"rawliteral(
-        <!doctype html>
-        <html>
-            <head>
-                <meta charset="utf-8"/>
-                <meta name="viewport" content="width=device-width,initial-scale=1"/>
-                <title>Wi-Fi Provision</title>
-                <style>
-                    body { font-family: system-ui, Segoe UI, Arial; margin: 2rem; }
-                    label { display: block; margin-top: 1rem; }
-                    input { padding: .6rem; width: 22rem; max-width: 100%; }
-                    button { margin-top: 1rem; padding: .6rem 1rem; }
-                </style>
-            </head>
-            <body>
-                <h2>Configure Wi-Fi</h2>
-                <form method="POST" action="/save">
-                    <label>SSID</label>
-                    <input name="ssid" required maxlength="32">
-                    <label>Password</label>
-                    <input name="pass" type="password" maxlength="64">
-                    <button type="submit">Save</button>
-                </form>
-            </body>
-        </html>
-    )rawliteral";
+    return redirect_to_portal(req);
+}
 
-    httpd_resp_set_type(req, "text/html; charset=utf-8");
-    return httpd_resp_send(req, html, sizeof(html) - 1);
+// Any other path, asked of whatever name the captive DNS resolved to us
+static esp_err_t not_found_handler(httpd_req_t *req, httpd_err_code_t err)
+{
+    (void)err;
+    return redirect_to_portal(req);
 }
 
 // Saved credentials callback and context
@@ -150,37 +155,47 @@ static void deferred_save_callback(const char *ssid, const char *pass)
     }
 }
 
-// Handler for saving Wi-Fi credentials
-static esp_err_t save_post_handler(httpd_req_t *req)
+// Handler for saving Wi-Fi credentials, runs on an httpd_async worker
+static esp_err_t save_post_worker(httpd_req_t *req)
 {
-    const size_t max_content_len = 512;
     if (req->content_len <= 0 || req->content_len > max_content_len)
     {
         return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad content size");
     }
 
-    // Read the request body
-    char *buf = (char *)malloc(req->content_len + 1);
-    if (!buf)
-        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OOM");
+    // The form is decoded as it arrives, into the buffers below
+    char ssid[33], pass[65];
+    form_urlenc_field_t fields[] = {
+        {.key = "ssid", .out = ssid, .out_size = sizeof(ssid)},
+        {.key = "pass", .out = pass, .out_size = sizeof(pass)},
+    };
+    form_urlenc_t form;
+    form_urlenc_init(&form, fields, sizeof(fields) / sizeof(fields[0]));
 
-    int got = 0;
-    while (got < req->content_len)
+    const int64_t deadline = httpd_async_deadline(save_body_timeout_ms);
+    char chunk[64];
+    for (size_t left = req->content_len; left > 0;)
     {
-        int r = httpd_req_recv(req, buf + got, req->content_len - got);
-        if (r <= 0)
+        const size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+        const int got = httpd_async_recv_until(req, chunk, n, deadline);
+        if (got == HTTPD_ASYNC_TIMEOUT)
         {
-            free(buf);
-            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Recv failed");
+            ESP_LOGW(TAG, "Client too slow sending /save");
+            return httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Body timeout");
         }
-        got += r;
+        if (got < 0)
+            return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Recv failed");
+        form_urlenc_feed(&form, chunk, n);
+        left -= n;
     }
-    buf[got] = 0;
+    form_urlenc_finish(&form);
 
-    char ssid[33], pass[65];
-    form_get_kv(buf, "ssid", ssid, sizeof(ssid));
-    form_get_kv(buf, "pass", pass, sizeof(pass));
-    free(buf);
+    // A value cut short would save the wrong credentials
+    if (fields[0].truncated || fields[1].truncated || strlen(ssid) != fields[0].len ||
+        strlen(pass) != fields[1].len)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid ssid/pass length");
+    }
 
     if (!creds_len_valid(ssid, pass))
     {
@@ -210,6 +225,12 @@ static esp_err_t save_post_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// Hands /save to the worker pool so a slow form post does not block the server
+static esp_err_t save_post_handler(httpd_req_t *req)
+{
+    return httpd_async_submit(req, save_route, save_post_worker);
+}
+
 /* ---------- Public API ---------- */
 void wifi_prov_http_register_save_handler(wifi_prov_http_handle_save_t save_handler_cb, void *user_ctx)
 {
@@ -230,6 +251,14 @@ esp_err_t wifi_prov_http_init(void)
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
     config.lru_purge_enable = true;
+    // Bounds each wait of the httpd task on a client's headers
+    config.recv_wait_timeout = 2;
+    // /, /scan.json, /save and the probes
+    config.max_uri_handlers = 3 + sizeof(probe_uris) / sizeof(probe_uris[0]);
+
+    // One /save at a time; without workers it runs on the httpd task
+    if (httpd_async_init() == ESP_OK)
+        save_route = httpd_async_route("prov_save", 1);
 
     // Start the server
     esp_err_t e = httpd_start(&server_handle, &config);
@@ -239,6 +268,20 @@ esp_err_t wifi_prov_http_init(void)
         return e;
     }
 
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t *ap_netif = wifi_config_ap_get_netif();
+    if (ap_netif && esp_netif_get_ip_info(ap_netif, &ip_info) == ESP_OK && ip_info.ip.addr != 0)
+        snprintf(portal_url, sizeof(portal_url), "http://" IPSTR "/", IP2STR(&ip_info.ip));
+    else
+        strcpy(portal_url, "http://192.168.4.1/");
+
+    // Changes with the page only (the gzip header holds the build time), so
+    // a cached copy stays valid across reboots and rebuilds
+    uint32_t h = 2166136261u;
+    for (const uint8_t *p = index_html_start; p < index_html_end; p++)
+        h = (h ^ *p) * 16777619u;
+    snprintf(index_etag, sizeof(index_etag), "\"%08" PRIx32 "\"", h);
+
     // Register URI handlers
     httpd_uri_t root_get_uri = {
         .uri = "/",
@@ -247,6 +290,24 @@ esp_err_t wifi_prov_http_init(void)
         .user_ctx = NULL};
     httpd_register_uri_handler(server_handle, &root_get_uri);
 
+    httpd_uri_t scan_get_uri = {
+        .uri = "/scan.json",
+        .method = HTTP_GET,
+        .handler = scan_get_handler,
+        .user_ctx = NULL};
+    httpd_register_uri_handler(server_handle, &scan_get_uri);
+
+    for (const char *uri : probe_uris)
+    {
+        httpd_uri_t probe_uri = {
+            .uri = uri,
+            .method = HTTP_GET,
+            .handler = probe_get_handler,
+            .user_ctx = NULL};
+        httpd_register_uri_handler(server_handle, &probe_uri);
+    }
+    httpd_register_err_handler(server_handle, HTTPD_404_NOT_FOUND, not_found_handler);
+
     // Register the save handler
     httpd_uri_t save_post_uri = {
         .uri = "/save",
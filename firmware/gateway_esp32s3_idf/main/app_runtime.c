@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -20,7 +21,12 @@
 
 #include "dht11_reader.h"
 #include "i2c_oled_display.h"
-#include "global.h"
+#include "event_bus.h"
+#include "sensor_history.h"
+#include "sensor_hub.h"
+#include "sensor_registry.h"
+#include "telemetry_http.h"
+#include "telemetry_log.h"
 
 static const char *TAG = "APP_RUNTIME";
 
@@ -38,6 +44,18 @@ static void on_prov_saved(const char *ssid, const char *pass, void *ctx)
         xEventGroupSetBits(s_runtime_eg, EV_SAVED_BIT);
 }
 
+/*========== Helper: Wi-Fi state on the OLED status screen ==========*/
+static void show_connected(const uint32_t *ip)
+{
+    char line2[24] = "";
+    if (ip)
+    {
+        struct in_addr a = {.s_addr = *ip};
+        snprintf(line2, sizeof(line2), "IP %s", inet_ntoa(a));
+    }
+    oled_display_show_status("CONNECTED", line2);
+}
+
 /*========== Helper: Try to connect STA by creds in NVS ==========*/
 static bool try_sta_from_nvs(int wait_ip_timeout_ms)
 {
@@ -47,6 +65,7 @@ static bool try_sta_from_nvs(int wait_ip_timeout_ms)
         ESP_LOGW(TAG, "No Wi-Fi creds in NVS");
         return false;
     }
+    oled_display_show_status("CONNECTING", ssid);
 
     wifi_conn_config_t cfg = {
         .ssid = ssid,
@@ -69,10 +88,12 @@ static bool try_sta_from_nvs(int wait_ip_timeout_ms)
         {
             struct in_addr a = {.s_addr = ip};
             ESP_LOGI(TAG, "STA ready (NVS), IP: %s", inet_ntoa(a));
+            show_connected(&ip);
         }
         else
         {
             ESP_LOGI(TAG, "STA ready (NVS), IP obtained");
+            show_connected(NULL);
         }
         return true;
     }
@@ -98,6 +119,7 @@ static esp_err_t start_ap_and_http(const char *ap_ssid, const char *ap_pass, int
     ESP_RETURN_ON_ERROR(wifi_prov_http_init(), TAG, "HTTP start failed");
 
     ESP_LOGI(TAG, "AP up SSID:%s (pass:%s), browse http://192.168.4.1/", ap_ssid, ap_pass);
+    oled_display_show_status("AP MODE", ap_ssid);
     return ESP_OK;
 }
 
@@ -105,29 +127,39 @@ static esp_err_t start_ap_and_http(const char *ap_ssid, const char *ap_pass, int
 static void stop_ap_and_http(void)
 {
     wifi_prov_http_deinit();
-    (void)wifi_config_ap_stop();
+    // Handler, timer and netif go too: the next round inits them again
+    (void)wifi_config_ap_deinit();
 }
 
-/*========== LVGL ========== */
+/*========== Display ========== */
 // Handle display for "update_task"
-static lv_display_t *s_disp = NULL;
+static oled_display_t *s_disp = NULL;
+
+static event_bus_sub_handle_t s_ui_sub = NULL;
 
-// Update OLED screen every second
+// Consecutive failed reads before the display drops the stale values
+#define UI_STALE_AFTER_FAILS 3
+
+// Redraw the OLED as soon as a reading is published
 static void updater_task(void *arg)
 {
     (void)arg;
     while (1)
     {
-        int16_t t10 = global_temperature;
-        int16_t h10 = global_humidity;
-
-        bool valid = (t10 != INT16_MIN) && (h10 != INT16_MIN);
-        float temp_c = valid ? (float)t10 / 10.0f : NAN;
-        float hum_pct = valid ? (float)h10 / 10.0f : NAN;
+        event_bus_msg_t msg;
+        if (event_bus_receive(s_ui_sub, &msg, portMAX_DELAY) != ESP_OK)
+            continue;
 
-        oled_display_update(temp_c, hum_pct); // if NAN -> display “--.--” or similar
-
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        if (msg.topic == EVENT_TOPIC_CLIMATE)
+        {
+            oled_display_update((float)msg.data.climate.temp_dc / 10.0f,
+                                (float)msg.data.climate.hum_dpct / 10.0f);
+        }
+        else if (msg.topic == EVENT_TOPIC_SENSOR_ERROR &&
+                 msg.data.sensor_error.fail_count >= UI_STALE_AFTER_FAILS)
+        {
+            oled_display_update(NAN, NAN); // display “--.--” or similar
+        }
     }
 }
 
@@ -160,6 +192,7 @@ static esp_err_t start_wifi(void)
             .auto_start = true,
         };
 
+        oled_display_show_status("CONNECTING", "");
         if (wifi_conn_init(&wifi_cfg) == ESP_OK && wifi_conn_wait_ip(15000) == ESP_OK)
         {
             uint32_t ip;
@@ -167,6 +200,11 @@ static esp_err_t start_wifi(void)
             {
                 struct in_addr a = {.s_addr = ip};
                 ESP_LOGI(TAG, "Wi-Fi ready (menuconfig), IP: %s", inet_ntoa(a));
+                show_connected(&ip);
+            }
+            else
+            {
+                show_connected(NULL);
             }
             return ESP_OK; // connected ok
         }
@@ -211,26 +249,142 @@ static esp_err_t start_wifi(void)
     return ESP_FAIL;
 }
 
-/*========== Read DHT11 Data ==========*/
-static esp_err_t start_dht11_task(void)
+/*========== Provisioning on request ==========*/
+static volatile bool s_prov_running = false;
+
+// How long the AP of a STA fallback waits for new credentials before the
+// station tries the old ones again (the access point may just be down)
+#define FALLBACK_AP_WINDOW_MS (5 * 60 * 1000)
+
+// Back to STA with the saved credentials (NVS, else menuconfig), without
+// waiting: wifi_connect keeps retrying on its own
+static void resume_sta(void)
 {
-    static dht11_t dht11_sensor;
-    dht11_sensor = dht11_init(DHT11_PIN);
+    char ssid[33], pass[65];
+    const bool nvs = wifi_nvs_get_creds(ssid, sizeof(ssid), pass, sizeof(pass)) == ESP_OK;
+    wifi_conn_config_t cfg = {
+        .ssid = nvs ? ssid : NULL,
+        .password = nvs ? pass : NULL,
+        .max_retry = -1, // Use CONFIG_WIFI_CONN_MAX_RETRY
+        .auto_start = true,
+    };
+    oled_display_show_status("CONNECTING", nvs ? ssid : "");
+    const esp_err_t e = wifi_conn_init(&cfg);
+    if (e != ESP_OK && e != ESP_ERR_INVALID_STATE)
+        ESP_LOGE(TAG, "wifi_conn_init failed: %s", esp_err_to_name(e));
+}
 
-    BaseType_t ok = xTaskCreate(
-        read_dht11_and_update_globals_task,
-        "dht11_task",
-        3072,
-        &dht11_sensor,
-        5,
-        NULL);
-    if (ok != pdPASS)
+// Same AP + HTTP round as start_wifi() step 4-7, while the rest keeps running.
+// arg: how long to wait for /save in ms, 0 for as long as it takes
+static void provisioning_task(void *arg)
+{
+    const uint32_t window_ms = (uint32_t)(uintptr_t)arg;
+    (void)wifi_conn_stop();
+    (void)telemetry_http_stop(); // port 80 goes to the provisioning form
+    if (start_ap_and_http(CONFIG_WIFI_CONFIG_AP_SSID, CONFIG_WIFI_CONFIG_AP_PASSWORD,
+                          CONFIG_WIFI_CONFIG_AP_CHANNEL, CONFIG_WIFI_CONFIG_AP_MAX_CONNECTIONS) == ESP_OK)
+    {
+        xEventGroupClearBits(s_runtime_eg, EV_SAVED_BIT);
+        const EventBits_t bits = xEventGroupWaitBits(s_runtime_eg, EV_SAVED_BIT, pdTRUE, pdFALSE,
+                                                     window_ms ? pdMS_TO_TICKS(window_ms) : portMAX_DELAY);
+        stop_ap_and_http();
+        if (!(bits & EV_SAVED_BIT))
+        {
+            ESP_LOGW(TAG, "No new credentials; trying the saved ones again.");
+            resume_sta();
+        }
+        else if (!try_sta_from_nvs(15000))
+        {
+            ESP_LOGE(TAG, "Provisioning done but STA connect failed.");
+        }
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(telemetry_http_start());
+    s_prov_running = false;
+    vTaskDelete(NULL);
+}
+
+static esp_err_t start_provisioning(uint32_t window_ms)
+{
+    if (!s_runtime_eg)
+        return ESP_ERR_INVALID_STATE;
+    if (s_prov_running)
+        return ESP_ERR_INVALID_STATE;
+    s_prov_running = true;
+    if (xTaskCreate(provisioning_task, "provisioning", 4096, (void *)(uintptr_t)window_ms, 4, NULL) != pdPASS)
     {
-        ESP_LOGE(TAG, "Create dht11_task failed");
+        s_prov_running = false;
         return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "Provisioning requested");
+    return ESP_OK;
+}
+
+esp_err_t app_runtime_start_provisioning(void)
+{
+    return start_provisioning(0);
+}
+
+// wifi_connect gave up on the STA link: the provisioning AP for a while
+static void on_sta_fallback(wifi_conn_reason_class_t why, void *ctx)
+{
+    (void)ctx;
+    ESP_LOGW(TAG, "STA gave up (%s); provisioning AP for %d s", why == WIFI_CONN_REASON_AUTH ? "rejected" : "no IP",
+             FALLBACK_AP_WINDOW_MS / 1000);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(start_provisioning(FALLBACK_AP_WINDOW_MS));
+}
+
+/*========== Sensors ==========*/
+// Results of every sensor_hub read go to the registry and the event bus
+static void on_sensor_result(int id, const sensor_driver_t *drv, esp_err_t err, const int32_t *values,
+                             const sensor_stats_t *stats, void *ctx)
+{
+    (void)id;
+    (void)ctx;
+    // Cap bits are sensor ids, values come lowest bit first
+    sensor_id_t ids[SENSOR_MAX_VALUES];
+    size_t n = 0;
+    for (int i = 0; i < SENSOR_ID_COUNT && n < SENSOR_MAX_VALUES; i++)
+        if (drv->caps & SENSOR_CAP(i))
+            ids[n++] = (sensor_id_t)i;
+
+    if (err != ESP_OK)
+    {
+        sensor_registry_set_error(ids, n);
+        const event_sensor_error_t ev = {.err = err, .fail_count = stats->consecutive_failures};
+        event_bus_publish(EVENT_TOPIC_SENSOR_ERROR, &ev, sizeof(ev));
+        return;
+    }
+
+    // All values of one read as one update
+    sensor_registry_publish_many(ids, values, n);
+    for (size_t i = 0; i < n; i++)
+        sensor_history_add(ids[i], stats->last_ok_us, values[i]);
+
+    const uint32_t climate = SENSOR_CAP(SENSOR_ID_TEMPERATURE) | SENSOR_CAP(SENSOR_ID_HUMIDITY);
+    if ((drv->caps & climate) == climate)
+    {
+        // Temperature is the lower id, so it comes first
+        const event_climate_t ev = {
+            .temp_dc = values[0],
+            .hum_dpct = values[1],
+            .sample_us = stats->last_ok_us,
+        };
+        event_bus_publish_climate(&ev);
+    }
+}
 
-    ESP_LOGI(TAG, "DHT11 task created");
+static esp_err_t start_sensors(void)
+{
+    static dht11_t dht_sensor;
+    static sensor_driver_t dht_driver;
+    dht_sensor = dht11_init(DHT11_PIN);
+    dht_sensor_driver(&dht_sensor, &dht_driver);
+
+    // Without history the live values still work
+    ESP_ERROR_CHECK_WITHOUT_ABORT(sensor_history_init());
+    ESP_RETURN_ON_ERROR(sensor_hub_init(), TAG, "sensor_hub_init failed");
+    ESP_RETURN_ON_ERROR(sensor_hub_register(&dht_driver, NULL), TAG, "DHT register failed");
+    ESP_RETURN_ON_ERROR(sensor_hub_start(on_sensor_result, NULL), TAG, "sensor_hub_start failed");
     return ESP_OK;
 }
 
@@ -251,20 +405,37 @@ static esp_err_t init_oled_and_ui(void)
 // Public APIs
 esp_err_t app_runtime_init(void)
 {
-    // 1. Wi-Fi (still ok in offline mode)
+    // 1. OLED + UI first, so the Wi-Fi steps can show their state
+    const esp_err_t oled_err = init_oled_and_ui();
+
+    // 2. Wi-Fi (still ok in offline mode); later losses fall back to the AP by themselves
     ESP_ERROR_CHECK_WITHOUT_ABORT(start_wifi());
+    wifi_conn_register_fallback_handler(on_sta_fallback, NULL);
+
+    // 3. Event bus, the flash log (a subscriber), then the sensors (publishers)
+    ESP_RETURN_ON_ERROR(event_bus_init(), TAG, "event_bus_init failed");
+    ESP_ERROR_CHECK_WITHOUT_ABORT(telemetry_log_start()); // optional: needs the "tlog" partition
+    ESP_RETURN_ON_ERROR(start_sensors(), TAG, "start_sensors failed");
 
-    // 2. DHT11
-    ESP_RETURN_ON_ERROR(start_dht11_task(), TAG, "start_dht11_task failed");
+    // 4. Telemetry API over the STA link (still ok in offline mode)
+    ESP_ERROR_CHECK_WITHOUT_ABORT(telemetry_http_start());
 
-    // 3. OLED + UI
-    ESP_RETURN_ON_ERROR(init_oled_and_ui(), TAG, "init_oled_and_ui failed");
+    ESP_RETURN_ON_ERROR(oled_err, TAG, "init_oled_and_ui failed");
 
     return ESP_OK;
 }
 
 esp_err_t app_runtime_start(void)
 {
+    // Display only cares about the newest reading
+    const event_bus_sub_config_t sub_cfg = {
+        .name = "ui_update",
+        .topics = EVENT_TOPIC_BIT(EVENT_TOPIC_CLIMATE) | EVENT_TOPIC_BIT(EVENT_TOPIC_SENSOR_ERROR),
+        .depth = 1,
+        .policy = EVENT_BUS_OVERWRITE_OLDEST,
+    };
+    ESP_RETURN_ON_ERROR(event_bus_subscribe(&sub_cfg, &s_ui_sub), TAG, "subscribe failed");
+
     // Create task update UI
     BaseType_t ok = xTaskCreate(
         updater_task,
@@ -6,3 +6,8 @@ esp_err_t app_runtime_init(void);
 
 // Start tasks
 esp_err_t app_runtime_start(void);
+
+// Bring up the provisioning AP + HTTP form again (e.g. from the UART command
+// channel); reconnects with the new credentials once they are saved.
+// ESP_ERR_INVALID_STATE if a round is already running.
+esp_err_t app_runtime_start_provisioning(void);
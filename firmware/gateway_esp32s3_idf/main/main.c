@@ -2,6 +2,27 @@
 #include "esp_system.h"
 #include "app_runtime.h"
 #include "uart_bridge.h"
+#include "dht11_reader.h"
+#include "sensor_hub.h"
+
+/*========== UART command channel hooks ==========*/
+static esp_err_t set_sample_period(uint32_t period_ms, void *ctx)
+{
+    (void)ctx;
+    return sensor_hub_set_period_ms(sensor_hub_find(DHT_SENSOR_NAME), period_ms);
+}
+
+static uint32_t get_sample_period(void *ctx)
+{
+    (void)ctx;
+    return sensor_hub_get_period_ms(sensor_hub_find(DHT_SENSOR_NAME));
+}
+
+static esp_err_t start_provisioning(void *ctx)
+{
+    (void)ctx;
+    return app_runtime_start_provisioning();
+}
 
 void app_main(void)
 {
@@ -16,5 +37,11 @@ void app_main(void)
         // Stop when start fail
         // esp_restart();
     }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_bridge_start(2000)); // print JSON every 2s
+    const uart_bridge_cmd_hooks_t hooks = {
+        .set_sample_period = set_sample_period,
+        .get_sample_period = get_sample_period,
+        .start_provisioning = start_provisioning,
+    };
+    uart_bridge_set_cmd_hooks(&hooks);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_bridge_start(2000)); // JSON every 2s, or binary batches flushed within 2s
 }
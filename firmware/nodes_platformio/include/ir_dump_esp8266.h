@@ -8,7 +8,24 @@ enum class WaitMode
     WaitingForIr
 };
 
+// Output format of each capture on Serial
+enum class DumpFormat
+{
+    Json,  // one JSON line per capture (human readable, slow)
+    Binary // COBS-framed binary records, see lib/ir_wire/ir_wire.h
+};
+
+// How captures are collected
+enum class CaptureMode
+{
+    Step,      // WaitingForName -> WaitingForIr handshake per button
+    Continuous // every frame is timestamped and queued, labels added on the host
+};
+
 void setupIrDump();
 void loopIrDump();
 void setWaitMode(WaitMode m);
-void setPendingButton(String &s);
+void setPendingButton(const String &s);
+// Json leaves continuous mode, Continuous switches to Binary
+void setDumpFormat(DumpFormat f);
+void setCaptureMode(CaptureMode m);
@@ -0,0 +1,185 @@
+#include "capture_ring.h"
+
+#include <string.h>
+
+#include "ir_wire.h"
+
+static const size_t kNoSpace = (size_t)-1;
+
+CaptureRing::CaptureRing(uint8_t *arena, size_t size, OverflowPolicy policy)
+    : _arena(arena), _size(size & ~(size_t)3), _policy(policy)
+{
+}
+
+size_t CaptureRing::recordSize_(size_t bodyLen)
+{
+    // header + body + CRC, kept 4-byte aligned for the Record header
+    return (sizeof(Record) + bodyLen + 2 + 3) & ~(size_t)3;
+}
+
+bool CaptureRing::absorbRepeat(uint32_t hash, uint32_t tsMs, uint32_t windowMs)
+{
+    for (uint8_t i = 0; i < kRecentSize; i++)
+    {
+        Recent &r = _recent[i];
+        if (r.lastMs == 0 || r.hash != hash || (uint32_t)(tsMs - r.lastMs) > windowMs)
+            continue;
+
+        // Holding a button: slide the window so the whole burst folds
+        r.lastMs = tsMs ? tsMs : 1;
+        _stats.deduped++;
+
+        // Still queued: count it, otherwise it is only suppressed
+        if (_hasNewest && at_(_newest)->hash == hash && at_(_newest)->repeats < 0xFFFF)
+            at_(_newest)->repeats++;
+        return true;
+    }
+    return false;
+}
+
+size_t CaptureRing::findSpace_(size_t need, bool &wraps) const
+{
+    wraps = false;
+    if (need > _size)
+        return kNoSpace;
+    if (_count == 0)
+        return 0;
+
+    if (_wrapped)
+    {
+        // Data is [head, wrapAt) + [0, tail): free space is [tail, head)
+        return (need <= _head - _tail) ? _tail : kNoSpace;
+    }
+
+    // Data is [head, tail): free space is [tail, size) and [0, head)
+    if (need <= _size - _tail)
+        return _tail;
+    if (need <= _head)
+    {
+        wraps = true;
+        return 0;
+    }
+    return kNoSpace;
+}
+
+uint8_t *CaptureRing::reserve(size_t maxBody)
+{
+    const size_t need = recordSize_(maxBody);
+    bool wraps = false;
+    size_t at = findSpace_(need, wraps);
+
+    // Evicting cannot make room for more than the arena holds
+    while (at == kNoSpace && _policy == OverflowPolicy::DropOldest && _count > 0 && need <= _size)
+    {
+        discardHead_();
+        _stats.dropped++;
+        at = findSpace_(need, wraps);
+    }
+    if (at == kNoSpace)
+    {
+        _stats.dropped++;
+        _reserved = 0;
+        return nullptr;
+    }
+
+    _reserved = need;
+    _reservedAt = at;
+    _reservedWraps = wraps;
+    return _arena + at + sizeof(Record);
+}
+
+void CaptureRing::commit(size_t bodyLen, uint32_t hash, uint32_t tsMs)
+{
+    const size_t size = recordSize_(bodyLen);
+    if (_reserved == 0 || size > _reserved)
+        return;
+
+    if (_count == 0)
+    {
+        _head = 0;
+        _wrapped = false;
+    }
+    else if (_reservedWraps)
+    {
+        _wrapAt = _tail;
+        _wrapped = true;
+    }
+
+    Record *rec = at_(_reservedAt);
+    rec->bodyLen = (uint16_t)bodyLen;
+    rec->repeats = 0;
+    rec->hash = hash;
+
+    _tail = _reservedAt + size;
+    _count++;
+    _used += size;
+    if (_used > _stats.highWater)
+        _stats.highWater = _used;
+    _stats.committed++;
+
+    _newest = _reservedAt;
+    _hasNewest = true;
+    _reserved = 0;
+
+    remember_(hash, tsMs);
+}
+
+size_t CaptureRing::pop(uint8_t *out, size_t cap)
+{
+    if (_count == 0)
+        return 0;
+
+    Record *rec = at_(_head);
+    const size_t len = (size_t)rec->bodyLen + 2;
+    if (!out || cap < len)
+        return 0;
+
+    uint8_t *body = (uint8_t *)(rec + 1);
+    irWireSetRepeats(body, rec->repeats);
+    irWireSeal(body, rec->bodyLen);
+    memcpy(out, body, len);
+
+    discardHead_();
+    _stats.drained++;
+    return len;
+}
+
+void CaptureRing::discardHead_()
+{
+    const size_t size = recordSize_(at_(_head)->bodyLen);
+    if (_hasNewest && _newest == _head)
+        _hasNewest = false;
+
+    _head += size;
+    _used -= size;
+    _count--;
+
+    if (_count == 0)
+    {
+        _head = _tail = 0;
+        _wrapped = false;
+    }
+    else if (_wrapped && _head >= _wrapAt)
+    {
+        _head = 0;
+        _wrapped = false;
+    }
+}
+
+void CaptureRing::remember_(uint32_t hash, uint32_t tsMs)
+{
+    if (tsMs == 0)
+        tsMs = 1; // 0 marks an unused entry
+
+    for (uint8_t i = 0; i < kRecentSize; i++)
+    {
+        if (_recent[i].lastMs != 0 && _recent[i].hash == hash)
+        {
+            _recent[i].lastMs = tsMs;
+            return;
+        }
+    }
+    _recent[_recentNext].hash = hash;
+    _recent[_recentNext].lastMs = tsMs;
+    _recentNext = (_recentNext + 1) % kRecentSize;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// FIFO of encoded captures (ir_wire bodies) in a fixed byte arena.
+//
+// The IR side reserves space, builds a body in place and commits it; the
+// UART side pops the oldest record, sealed (CRC), into its TX buffer.
+// Records are variable-sized and stored contiguously, wrapping to the start
+// of the arena when the tail does not fit. No heap use.
+//
+// Identical repeats (same timing hash within a time window) are folded into
+// the newest record's repeat count instead of taking a slot. When the UART
+// cannot keep up the overflow policy decides which capture is lost.
+class CaptureRing
+{
+public:
+    enum class OverflowPolicy : uint8_t
+    {
+        DropNewest, // keep what is queued, reject the new capture
+        DropOldest  // evict the oldest queued captures
+    };
+
+    struct Stats
+    {
+        uint32_t committed = 0; // captures stored
+        uint32_t deduped = 0;   // repeats folded or suppressed
+        uint32_t dropped = 0;   // captures lost to overflow
+        uint32_t drained = 0;   // records handed to the UART
+        size_t highWater = 0;   // max arena bytes in use
+    };
+
+    CaptureRing(uint8_t *arena, size_t size, OverflowPolicy policy = OverflowPolicy::DropNewest);
+
+    void setPolicy(OverflowPolicy policy) { _policy = policy; }
+
+    // Returns true if `hash` repeats a capture seen less than `windowMs` ago;
+    // the capture must then be discarded by the caller.
+    bool absorbRepeat(uint32_t hash, uint32_t tsMs, uint32_t windowMs);
+
+    // Space for a body of up to `maxBody` bytes (+ CRC), or nullptr on
+    // overflow. Must be followed by commit() before the next reserve().
+    uint8_t *reserve(size_t maxBody);
+    void commit(size_t bodyLen, uint32_t hash, uint32_t tsMs);
+
+    // Moves the oldest record, sealed, into `out`. Returns the payload
+    // length, 0 if empty or `cap` is too small.
+    size_t pop(uint8_t *out, size_t cap);
+
+    bool empty() const { return _count == 0; }
+    size_t count() const { return _count; }
+    size_t used() const { return _used; }
+    size_t capacity() const { return _size; }
+    const Stats &stats() const { return _stats; }
+
+private:
+    struct Record
+    {
+        uint16_t bodyLen;
+        uint16_t repeats;
+        uint32_t hash;
+    };
+    struct Recent
+    {
+        uint32_t hash;
+        uint32_t lastMs;
+    };
+    static const uint8_t kRecentSize = 8;
+
+    static size_t recordSize_(size_t bodyLen);
+    Record *at_(size_t offset) const { return (Record *)(_arena + offset); }
+    void discardHead_();
+    size_t findSpace_(size_t need, bool &wraps) const;
+    void remember_(uint32_t hash, uint32_t tsMs);
+
+    uint8_t *_arena;
+    size_t _size;
+    OverflowPolicy _policy;
+
+    size_t _head = 0;   // oldest record
+    size_t _tail = 0;   // next free byte
+    size_t _wrapAt = 0; // end of data at the arena end when wrapped
+    bool _wrapped = false;
+    size_t _count = 0;
+    size_t _used = 0;
+
+    size_t _reserved = 0; // record size handed out by reserve()
+    size_t _reservedAt = 0;
+    bool _reservedWraps = false;
+    size_t _newest = 0; // offset of the last committed record
+    bool _hasNewest = false;
+
+    Recent _recent[kRecentSize] = {};
+    uint8_t _recentNext = 0;
+
+    Stats _stats;
+};
@@ -0,0 +1,314 @@
+#include "ir_wire.h"
+
+#include <string.h>
+
+// ===== Primitives =====
+uint16_t irWireCrc16(const uint8_t *data, size_t len, uint16_t crc)
+{
+    // CRC-16/CCITT-FALSE (poly 0x1021), bitwise: frames are small and this
+    // avoids a 512-byte table in ESP8266 RAM.
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+size_t irWirePutVarint(uint8_t *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+size_t irWireGetVarint(const uint8_t *in, size_t len, uint64_t &v)
+{
+    v = 0;
+    for (size_t i = 0; i < len && i < 10; i++)
+    {
+        v |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+        if ((in[i] & 0x80) == 0)
+            return i + 1;
+    }
+    return 0;
+}
+
+size_t irWireMaxPayloadSize(uint16_t count)
+{
+    // version + flags + repeats + seq + ts + proto + bits + value + label + count + crc
+    const size_t header = 1 + 1 + 2 + 5 + 5 + (1 + kIrWireMaxString) + 3 + 10 + (1 + kIrWireMaxString) + 3 + 2;
+    // uint16 ticks scaled by a small tick size always fit in 3 varint bytes
+    return header + (size_t)count * 3;
+}
+
+static size_t putString(uint8_t *out, const char *s)
+{
+    size_t n = s ? strlen(s) : 0;
+    if (n > kIrWireMaxString)
+        n = kIrWireMaxString;
+    out[0] = (uint8_t)n;
+    if (n)
+        memcpy(out + 1, s, n);
+    return n + 1;
+}
+
+size_t irWireBuildPayload(const IrWireHeader &hdr,
+                          const uint16_t *ticks, uint16_t count, uint16_t usPerTick,
+                          uint8_t *out, size_t cap)
+{
+    const size_t n = irWireBuildBody(hdr, ticks, count, usPerTick, out, cap);
+    return n ? irWireSeal(out, n) : 0;
+}
+
+size_t irWireBuildBody(const IrWireHeader &hdr,
+                       const uint16_t *ticks, uint16_t count, uint16_t usPerTick,
+                       uint8_t *out, size_t cap)
+{
+    if (!out || cap < irWireMaxPayloadSize(count))
+        return 0;
+
+    const bool hasLabel = hdr.label && hdr.label[0];
+    uint8_t flags = 0;
+    if (hdr.hasValue)
+        flags |= kIrWireHasValue;
+    if (hasLabel)
+        flags |= kIrWireHasLabel;
+    if (hdr.hasRepeats)
+        flags |= kIrWireHasRepeats;
+
+    size_t n = 0;
+    out[n++] = kIrWireVersion;
+    out[n++] = flags;
+    if (hdr.hasRepeats)
+    {
+        out[n++] = (uint8_t)(hdr.repeats & 0xFF);
+        out[n++] = (uint8_t)(hdr.repeats >> 8);
+    }
+    n += irWirePutVarint(out + n, hdr.seq);
+    n += irWirePutVarint(out + n, hdr.tsMs);
+    n += putString(out + n, hdr.protocol);
+    n += irWirePutVarint(out + n, hdr.bits);
+    if (hdr.hasValue)
+        n += irWirePutVarint(out + n, hdr.value);
+    if (hasLabel)
+        n += putString(out + n, hdr.label);
+    n += irWirePutVarint(out + n, count);
+    for (uint16_t i = 0; i < count; i++)
+        n += irWirePutVarint(out + n, (uint32_t)ticks[i] * usPerTick);
+    return n;
+}
+
+size_t irWireSeal(uint8_t *body, size_t bodyLen)
+{
+    const uint16_t crc = irWireCrc16(body, bodyLen);
+    body[bodyLen] = (uint8_t)(crc & 0xFF);
+    body[bodyLen + 1] = (uint8_t)(crc >> 8);
+    return bodyLen + 2;
+}
+
+void irWireSetRepeats(uint8_t *body, uint16_t repeats)
+{
+    if (!(body[1] & kIrWireHasRepeats))
+        return;
+    body[2] = (uint8_t)(repeats & 0xFF);
+    body[3] = (uint8_t)(repeats >> 8);
+}
+
+uint32_t irWireTimingHash(const uint16_t *ticks, uint16_t count)
+{
+    // FNV-1a over the count and a trit per duration; durations within 20%
+    // of the one two slots back (same kind: mark vs mark) count as equal.
+    uint32_t h = 2166136261UL;
+    h = (h ^ (count & 0xFF)) * 16777619UL;
+    h = (h ^ (count >> 8)) * 16777619UL;
+    for (uint16_t i = 3; i < count; i++)
+    {
+        const uint32_t prev = ticks[i - 2];
+        const uint32_t cur = ticks[i];
+        uint8_t trit = 1;
+        if (cur * 10 < prev * 8)
+            trit = 0;
+        else if (cur * 8 > prev * 10)
+            trit = 2;
+        h = (h ^ trit) * 16777619UL;
+    }
+    return h;
+}
+
+bool irWireParsePayload(const uint8_t *payload, size_t len, IrWireView &view)
+{
+    if (!payload || len < 4)
+        return false;
+
+    const size_t body = len - 2;
+    const uint16_t crc = (uint16_t)payload[body] | ((uint16_t)payload[body + 1] << 8);
+    if (irWireCrc16(payload, body) != crc)
+        return false;
+    if (payload[0] != kIrWireVersion)
+        return false;
+
+    size_t n = 1;
+    uint64_t v = 0;
+    size_t used = 0;
+
+#define IR_WIRE_TAKE_VARINT(dst)                                  \
+    do                                                            \
+    {                                                             \
+        used = irWireGetVarint(payload + n, body - n, v);         \
+        if (!used)                                                \
+            return false;                                         \
+        n += used;                                                \
+        dst = v;                                                  \
+    } while (0)
+
+#define IR_WIRE_TAKE_STRING(ptr, plen)                            \
+    do                                                            \
+    {                                                             \
+        if (n >= body || payload[n] > body - n - 1)               \
+            return false;                                         \
+        plen = payload[n];                                        \
+        ptr = (const char *)(payload + n + 1);                    \
+        n += 1 + plen;                                            \
+    } while (0)
+
+    view = IrWireView();
+    view.flags = payload[n++];
+    if (view.flags & kIrWireHasRepeats)
+    {
+        if (body - n < 2)
+            return false;
+        view.repeats = (uint16_t)payload[n] | ((uint16_t)payload[n + 1] << 8);
+        n += 2;
+    }
+    IR_WIRE_TAKE_VARINT(view.seq);
+    IR_WIRE_TAKE_VARINT(view.tsMs);
+    IR_WIRE_TAKE_STRING(view.protocol, view.protocolLen);
+    IR_WIRE_TAKE_VARINT(view.bits);
+    if (view.flags & kIrWireHasValue)
+        IR_WIRE_TAKE_VARINT(view.value);
+    if (view.flags & kIrWireHasLabel)
+        IR_WIRE_TAKE_STRING(view.label, view.labelLen);
+    IR_WIRE_TAKE_VARINT(view.count);
+
+#undef IR_WIRE_TAKE_VARINT
+#undef IR_WIRE_TAKE_STRING
+
+    view.timings = payload + n;
+    view.timingsLen = body - n;
+
+    // Walk the timings once so callers can trust count/timingsLen
+    IrWireTimingReader reader(view);
+    uint32_t us;
+    uint16_t seen = 0;
+    while (reader.next(us))
+        seen++;
+    return seen == view.count;
+}
+
+bool IrWireTimingReader::next(uint32_t &us)
+{
+    if (_remaining == 0)
+        return false;
+    uint64_t v = 0;
+    const size_t used = irWireGetVarint(_p, _left, v);
+    if (!used || v > 0xFFFFFFFFULL)
+        return false;
+    _p += used;
+    _left -= used;
+    _remaining--;
+    us = (uint32_t)v;
+    return true;
+}
+
+// ===== COBS =====
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t i = 0, o = 0;
+    while (i < len)
+    {
+        const uint8_t code = in[i++];
+        if (code == 0)
+            return 0;
+        for (uint8_t j = 1; j < code; j++)
+        {
+            if (i >= len || in[i] == 0)
+                return 0;
+            out[o++] = in[i++];
+        }
+        if (code < 0xFF && i < len)
+            out[o++] = 0;
+    }
+    return o;
+}
+
+void CobsStreamEncoder::begin(const uint8_t *payload, size_t len)
+{
+    _src = payload;
+    _len = len;
+    _pos = 0;
+    _runLeft = 0;
+    _zeroAfterRun = false;
+    _state = State::LeadingDelimiter;
+}
+
+size_t CobsStreamEncoder::read(uint8_t *out, size_t max)
+{
+    size_t n = 0;
+    while (n < max && _state != State::Done)
+    {
+        switch (_state)
+        {
+        case State::LeadingDelimiter:
+            out[n++] = kIrWireDelimiter;
+            _state = State::Code;
+            break;
+
+        case State::Code:
+        {
+            // Look ahead for the next zero, at most one full 254-byte block
+            uint8_t run = 0;
+            while (run < 254 && _pos + run < _len && _src[_pos + run] != 0)
+                run++;
+            _runLeft = run;
+            _zeroAfterRun = (run < 254) && (_pos + run < _len);
+            out[n++] = (uint8_t)(run + 1);
+            _state = State::Data;
+            break;
+        }
+
+        case State::Data:
+            if (_runLeft > 0)
+            {
+                out[n++] = _src[_pos++];
+                _runLeft--;
+                break;
+            }
+            if (_zeroAfterRun)
+            {
+                _pos++; // the zero is implied by the code byte
+                _state = State::Code;
+            }
+            else
+            {
+                _state = (_pos < _len) ? State::Code : State::TrailingDelimiter;
+            }
+            break;
+
+        case State::TrailingDelimiter:
+            out[n++] = kIrWireDelimiter;
+            _state = State::Done;
+            break;
+
+        case State::Done:
+            break;
+        }
+    }
+    return n;
+}
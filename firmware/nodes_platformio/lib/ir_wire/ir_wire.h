@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary dump format shared by ir_dump_esp8266 and the host decoder
+// (host_tools/ir_dump_decoder). Kept free of Arduino headers so it also
+// builds on the PC.
+//
+// On the wire every capture is sent as:  0x00 | COBS(payload) | 0x00
+// The leading delimiter lets the receiver resync after console text.
+//
+// Payload layout (varint = LEB128, little-endian CRC):
+//   u8      version (kIrWireVersion)
+//   u8      flags   (IrWireFlag)
+//   u16     repeats                (only if kIrWireHasRepeats, fixed width so
+//                                   it can be patched while queued)
+//   varint  seq
+//   varint  ts_ms
+//   u8+str  protocol name
+//   varint  bits
+//   varint  value                  (only if kIrWireHasValue)
+//   u8+str  label / button name    (only if kIrWireHasLabel)
+//   varint  count
+//   varint  timings[count]         (microseconds, first entry = leading gap)
+//   u16     crc16                  (CRC-16/CCITT-FALSE over everything above)
+
+static constexpr uint8_t kIrWireVersion = 1;
+static constexpr uint8_t kIrWireDelimiter = 0x00;
+static constexpr uint8_t kIrWireMaxString = 32;
+
+enum IrWireFlag : uint8_t
+{
+    kIrWireHasValue = 1 << 0,
+    kIrWireHasLabel = 1 << 1,
+    kIrWireHasRepeats = 1 << 2,
+};
+
+struct IrWireHeader
+{
+    uint32_t seq = 0;
+    uint32_t tsMs = 0;
+    const char *protocol = ""; // not owned
+    uint16_t bits = 0;
+    bool hasValue = false;
+    uint64_t value = 0;
+    const char *label = nullptr; // not owned, nullptr/"" = no label
+    bool hasRepeats = false;
+    uint16_t repeats = 0; // identical frames folded into this one
+};
+
+// Parsed view of a payload; strings point into the payload buffer and are
+// NOT null-terminated.
+struct IrWireView
+{
+    uint8_t flags = 0;
+    uint16_t repeats = 0;
+    uint32_t seq = 0;
+    uint32_t tsMs = 0;
+    const char *protocol = nullptr;
+    uint8_t protocolLen = 0;
+    uint16_t bits = 0;
+    uint64_t value = 0;
+    const char *label = nullptr;
+    uint8_t labelLen = 0;
+    uint16_t count = 0;
+    const uint8_t *timings = nullptr; // varint-encoded, use IrWireTimingReader
+    size_t timingsLen = 0;
+};
+
+// ===== Primitives =====
+uint16_t irWireCrc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
+size_t irWirePutVarint(uint8_t *out, uint64_t v);
+// Returns bytes consumed, 0 on malformed/truncated input
+size_t irWireGetVarint(const uint8_t *in, size_t len, uint64_t &v);
+
+// Worst-case payload size for a capture with `count` timings
+size_t irWireMaxPayloadSize(uint16_t count);
+
+// Builds the payload (incl. CRC) for one capture. Timings are given as raw
+// ticks and scaled by `usPerTick` while encoding, so the caller can feed
+// IRrecv's rawbuf directly. Returns payload size or 0 if `cap` is too small.
+size_t irWireBuildPayload(const IrWireHeader &hdr,
+                          const uint16_t *ticks, uint16_t count, uint16_t usPerTick,
+                          uint8_t *out, size_t cap);
+
+// Same as irWireBuildPayload() without the CRC, for records that are still
+// modified (repeat count) while queued. `cap` must leave 2 bytes for the CRC
+// added later by irWireSeal().
+size_t irWireBuildBody(const IrWireHeader &hdr,
+                       const uint16_t *ticks, uint16_t count, uint16_t usPerTick,
+                       uint8_t *out, size_t cap);
+// Appends the CRC to a body, returns the payload size
+size_t irWireSeal(uint8_t *body, size_t bodyLen);
+// Patches the repeat count of a body built with hasRepeats
+void irWireSetRepeats(uint8_t *body, uint16_t repeats);
+
+// Tolerance-insensitive hash of a capture: like IRrecv's decodeHash it only
+// looks at whether each mark (space) is shorter/equal/longer than the
+// previous mark (space), so two presses of the same button hash alike.
+uint32_t irWireTimingHash(const uint16_t *ticks, uint16_t count);
+
+// Verifies the CRC and splits a decoded payload into its fields
+bool irWireParsePayload(const uint8_t *payload, size_t len, IrWireView &view);
+
+// ===== COBS =====
+// Decodes one COBS block (without delimiters). Returns decoded length or
+// 0 if the input is malformed. `out` must hold at least `len` bytes.
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out);
+
+// Emits the COBS encoding of a payload in arbitrarily small pieces, so the
+// caller can push it out as fast as the UART drains without a second
+// full-size buffer. Includes the leading and trailing delimiters.
+class CobsStreamEncoder
+{
+public:
+    void begin(const uint8_t *payload, size_t len);
+    size_t read(uint8_t *out, size_t max);
+    bool done() const { return _state == State::Done; }
+    bool busy() const { return _state != State::Done; }
+
+private:
+    enum class State : uint8_t
+    {
+        LeadingDelimiter,
+        Code,
+        Data,
+        TrailingDelimiter,
+        Done
+    };
+
+    const uint8_t *_src = nullptr;
+    size_t _len = 0;
+    size_t _pos = 0;      // next payload byte to examine
+    uint8_t _runLeft = 0; // data bytes left in the current block
+    bool _zeroAfterRun = false;
+    State _state = State::Done;
+};
+
+// Iterates over the varint timings of a parsed view
+class IrWireTimingReader
+{
+public:
+    explicit IrWireTimingReader(const IrWireView &view)
+        : _p(view.timings), _left(view.timingsLen), _remaining(view.count) {}
+
+    bool next(uint32_t &us);
+
+private:
+    const uint8_t *_p;
+    size_t _left;
+    uint16_t _remaining;
+};
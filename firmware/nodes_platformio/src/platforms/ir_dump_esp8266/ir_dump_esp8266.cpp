@@ -2,6 +2,8 @@
 #include <ArduinoJson.h>
 
 #include "ir_dump_esp8266.h"
+#include "ir_wire.h"
+#include "capture_ring.h"
 
 #include <IRremoteESP8266.h>
 #include <IRrecv.h>
@@ -21,15 +23,186 @@ const uint8_t kTolerancePercentage = kTolerance;
 IRrecv irrecv(kRecvPin, kCaptureBufferSize, kTimeout, true);
 decode_results results; // Somewhere to store the results
 
-enum class WaitMode
-{
-    Idle,
-    WaitingForName,
-    WaitingForIr
-};
 static WaitMode waitMode = WaitMode::WaitingForName;
 static String pendingButton;
 
+#ifdef IR_DUMP_BINARY
+static DumpFormat dumpFormat = DumpFormat::Binary;
+#else
+static DumpFormat dumpFormat = DumpFormat::Json;
+#endif
+
+static CaptureMode captureMode = CaptureMode::Step;
+
+// ===== Binary dump: capture ring =====
+// A capture is encoded into the ring straight from rawbuf, then irrecv is
+// resumed immediately. Records drain to Serial in the background, only as
+// fast as the UART TX FIFO accepts bytes, so loopIrDump() never blocks on
+// printing and the next frame is not missed. In continuous mode bursts are
+// absorbed by the ring; identical repeats (button held) are folded.
+#ifndef IR_DUMP_RING_BYTES
+#define IR_DUMP_RING_BYTES 12288
+#endif
+const uint32_t kRepeatWindowMs = 250; // gap that still counts as the same press
+
+static uint8_t ringArena[IR_DUMP_RING_BYTES];
+static CaptureRing ring(ringArena, sizeof(ringArena), CaptureRing::OverflowPolicy::DropNewest);
+static uint8_t *txPayload = nullptr; // record currently being sent
+static size_t txPayloadSize = 0;
+static CobsStreamEncoder txEncoder;
+static uint32_t captureSeq = 0;
+
+static bool queueBinaryCapture(const decode_results &r, const String &label)
+{
+    const uint16_t count = r.rawlen > kCaptureBufferSize ? kCaptureBufferSize : r.rawlen;
+    const uint16_t *ticks = (const uint16_t *)r.rawbuf;
+    const uint32_t now = millis();
+    const uint32_t hash = irWireTimingHash(ticks, count);
+
+    if (captureMode == CaptureMode::Continuous && ring.absorbRepeat(hash, now, kRepeatWindowMs))
+        return true;
+
+    const size_t maxBody = irWireMaxPayloadSize(count);
+    uint8_t *body = ring.reserve(maxBody);
+    if (!body)
+        return false;
+
+    // typeToString() returns a temporary, keep it alive while encoding
+    const String protocol = typeToString(r.decode_type, false);
+
+    IrWireHeader hdr;
+    hdr.seq = captureSeq++;
+    hdr.tsMs = now;
+    hdr.protocol = protocol.c_str();
+    hdr.bits = r.bits;
+    hdr.hasValue = r.decode_type != decode_type_t::UNKNOWN;
+    hdr.value = r.value;
+    hdr.label = label.c_str();
+    hdr.hasRepeats = true;
+
+    const size_t len = irWireBuildBody(hdr, ticks, count, kRawTick, body, maxBody);
+    ring.commit(len, hash, now);
+    return len != 0;
+}
+
+// Push as many pending frame bytes as the UART can take right now
+static void pumpBinaryTx()
+{
+    uint8_t chunk[64];
+    int room = Serial.availableForWrite();
+    while (room > 0)
+    {
+        if (!txEncoder.busy())
+        {
+            const size_t len = ring.pop(txPayload, txPayloadSize);
+            if (!len)
+                return;
+            txEncoder.begin(txPayload, len);
+        }
+
+        const size_t want = (size_t)room < sizeof(chunk) ? (size_t)room : sizeof(chunk);
+        const size_t n = txEncoder.read(chunk, want);
+        Serial.write(chunk, n);
+        room -= (int)n;
+    }
+}
+
+// Console text must not land in the middle of a binary frame
+static void flushBinaryTx()
+{
+    while (!ring.empty() || txEncoder.busy())
+    {
+        pumpBinaryTx();
+        yield();
+    }
+}
+
+static void printStats()
+{
+    const CaptureRing::Stats &st = ring.stats();
+    Serial.printf("[INFO] captured=%lu deduped=%lu dropped=%lu sent=%lu ring_high=%u/%u\n",
+                  (unsigned long)st.committed, (unsigned long)st.deduped,
+                  (unsigned long)st.dropped, (unsigned long)st.drained,
+                  (unsigned)st.highWater, (unsigned)ring.capacity());
+}
+
+// ":" commands, accepted in both capture modes. Returns false if `s` is not one.
+static bool handleCommand(const String &s)
+{
+    if (!s.startsWith(":"))
+        return false;
+
+    flushBinaryTx();
+    if (s == ":json" && captureMode == CaptureMode::Continuous)
+    {
+        // Captures would pile up in the ring with nothing draining it
+        Serial.printf("[INFO] Continuous mode dumps binary only, send :step first.\n");
+    }
+    else if (s == ":bin" || s == ":json")
+    {
+        setDumpFormat(s == ":bin" ? DumpFormat::Binary : DumpFormat::Json);
+        Serial.printf("[INFO] Dump format: %s\n", s == ":bin" ? "binary" : "json");
+    }
+    else if (s == ":cont" || s == ":step")
+    {
+        setCaptureMode(s == ":cont" ? CaptureMode::Continuous : CaptureMode::Step);
+        Serial.printf("[INFO] Capture mode: %s\n", s == ":cont" ? "continuous" : "step");
+    }
+    else if (s == ":drop-oldest" || s == ":drop-newest")
+    {
+        ring.setPolicy(s == ":drop-oldest" ? CaptureRing::OverflowPolicy::DropOldest
+                                           : CaptureRing::OverflowPolicy::DropNewest);
+        Serial.printf("[INFO] Overflow policy: %s\n", s.c_str() + 1);
+    }
+    else if (s == ":stats")
+    {
+        printStats();
+    }
+    else
+    {
+        Serial.printf("[INFO] Commands: :bin :json :cont :step :drop-oldest :drop-newest :stats\n");
+    }
+    return true;
+}
+
+// Non-blocking line reader for continuous mode (readStringUntil() would
+// stall the capture loop for up to a second)
+static bool pollLine(String &line)
+{
+    static String partial;
+    while (Serial.available())
+    {
+        const char c = (char)Serial.read();
+        if (c == '\n')
+        {
+            line = partial;
+            line.trim();
+            partial = "";
+            return true;
+        }
+        if (partial.length() < 64)
+            partial += c;
+    }
+    return false;
+}
+
+static void loopContinuous()
+{
+    String line;
+    if (pollLine(line) && line.length() > 0 && !handleCommand(line))
+    {
+        // Labels are assigned on the host in this mode
+        flushBinaryTx();
+        Serial.printf("[INFO] Continuous mode: labels are ignored, send :step to leave.\n");
+    }
+
+    if (irrecv.decode(&results))
+    {
+        queueBinaryCapture(results, "");
+        irrecv.resume();
+    }
+}
+
 void setWaitMode(WaitMode m)
 {
     waitMode = m;
@@ -40,6 +213,29 @@ void setPendingButton(const String &s)
     pendingButton = s;
 }
 
+void setDumpFormat(DumpFormat f)
+{
+    flushBinaryTx();
+    // The reverse of setCaptureMode(): JSON is step mode only
+    if (f == DumpFormat::Json && captureMode == CaptureMode::Continuous)
+    {
+        captureMode = CaptureMode::Step;
+        waitMode = WaitMode::WaitingForName;
+        pendingButton = "";
+    }
+    dumpFormat = f;
+}
+
+void setCaptureMode(CaptureMode m)
+{
+    // Continuous capture only makes sense with the binary stream
+    if (m == CaptureMode::Continuous)
+        setDumpFormat(DumpFormat::Binary);
+    captureMode = m;
+    waitMode = WaitMode::WaitingForName;
+    pendingButton = "";
+}
+
 void setupIrDump()
 {
     Serial.begin(kBaudRate);
@@ -47,7 +243,15 @@ void setupIrDump()
         delay(1000);
 
     Serial.printf("\n[BOOT] IR recv on pin %u, timeout=%ums, buf=%u\n",
-                  kRecvPin, (unsigned)kTimeoutMs, (unsigned)kCaptureBufferSize);
+                  kRecvPin, (unsigned)kTimeout, (unsigned)kCaptureBufferSize);
+
+    // TX buffer for the record being sent, sized for a full rawbuf
+    txPayloadSize = irWireMaxPayloadSize(kCaptureBufferSize);
+    txPayload = new uint8_t[txPayloadSize];
+
+#ifdef IR_DUMP_CONTINUOUS
+    setCaptureMode(CaptureMode::Continuous);
+#endif
 
 #if DECODE_HASH
     // Ignore messages with less than minimum on or off pulses.
@@ -59,12 +263,24 @@ void setupIrDump()
 
 void loopIrDump()
 {
+    if (dumpFormat == DumpFormat::Binary)
+        pumpBinaryTx();
+
+    if (captureMode == CaptureMode::Continuous)
+    {
+        loopContinuous();
+        return;
+    }
+
     if (waitMode == WaitMode::WaitingForName)
     {
         if (Serial.available())
         {
             String s = Serial.readStringUntil('\n');
             s.trim();
+            flushBinaryTx();
+            if (handleCommand(s))
+                return;
             if (s.length() > 0)
             {
                 pendingButton = s;
@@ -83,6 +299,16 @@ void loopIrDump()
         // Check if the IR code has been received.
         if (irrecv.decode(&results))
         {
+            if (dumpFormat == DumpFormat::Binary)
+            {
+                // Copy out of rawbuf first, then receive the next frame right away
+                queueBinaryCapture(results, pendingButton);
+                irrecv.resume();
+                waitMode = WaitMode::WaitingForName;
+                pendingButton = "";
+                return;
+            }
+
             String valueHex;
             if (results.decode_type != decode_type_t::UNKNOWN)
             {
@@ -134,3 +360,13 @@ void loopIrDump()
         }
     }
 }
+
+void setup()
+{
+    setupIrDump();
+}
+
+void loop()
+{
+    loopIrDump();
+}
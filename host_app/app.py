@@ -5,21 +5,26 @@ import asyncio
 import serial
 import serial.tools.list_ports
 from pathlib import Path
-from fastapi import FastAPI, WebSocket
+from fastapi import FastAPI, HTTPException, WebSocket
 from fastapi.responses import HTMLResponse, FileResponse
-from datetime import datetime
+from datetime import datetime, timezone
 from contextlib import asynccontextmanager
 
 SERIAL_PORT = os.getenv(
     "SERIAL_PORT", "COM5"
 )  # "COM5" | "/dev/ttyUSB0" | "/dev/tty.SLAB_USBtoUART"
 BAUD = int(os.getenv("BAUD", "115200"))
+# "json": JSON lines from the console transport of uart_bridge
+# "binary": COBS frames of the binary transport, decoded by host_tools/telemetry_link
+# (library path from TELEMETRY_LINK_LIB, default host_tools/build/telemetry_link)
+LINK = os.getenv("LINK", "json")
 
 CSV_DIR = Path("./data")
 CSV_DIR.mkdir(parents=True, exist_ok=True)
 CSV_FILE = CSV_DIR / "telemetry.csv"
 
 clients: set[WebSocket] = set()
+link_client = None  # LinkClient while the binary link is open
 HTML = Path("index.html").read_text(encoding="utf-8")
 
 
@@ -60,37 +65,72 @@ async def serial_reader():
         print(f"[INFO] Auto-selected {port}")
 
     ser = serial.Serial(port=port, baudrate=BAUD, timeout=1)
-    print(f"[INFO] Opened serial {port} @ {BAUD}")
+    print(f"[INFO] Opened serial {port} @ {BAUD} ({LINK})")
+    try:
+        if LINK == "binary":
+            await read_binary(ser)
+        else:
+            await read_json_lines(ser)
+    finally:
+        ser.close()
+
+
+async def publish(data: dict):
+    # ghi CSV
+    with CSV_FILE.open("a", newline="", encoding="utf-8") as f:
+        csv.writer(f).writerow(
+            [
+                data.get("ts"),
+                data.get("device_id"),
+                data.get("temp_c"),
+                data.get("humidity"),
+            ]
+        )
+    # phát realtime
+    await broadcast(json.dumps(data))
+
+
+def utc_now() -> str:
+    return datetime.now(timezone.utc).strftime("%Y-%m-%dT%H:%M:%SZ")
+
+
+async def read_json_lines(ser: serial.Serial):
+    while True:
+        lineb = ser.readline()
+        if not lineb:
+            await asyncio.sleep(0.01)
+            continue
+        try:
+            data = json.loads(lineb.decode("utf-8", errors="ignore").strip())
+            # gắn timestamp hệ thống (UTC)
+            data["ts"] = utc_now()
+        except Exception as e:
+            print("[PARSE] skip:", lineb[:80], e)
+            continue
+        await publish(data)
+
+
+async def read_binary(ser: serial.Serial):
+    global link_client
+    from telemetry_link import TelemetryDecoder, LinkClient
+
+    decoder = TelemetryDecoder()
+    link_client = LinkClient(decoder, ser.write)
     try:
         while True:
-            lineb = ser.readline()
-            if not lineb:
-                await asyncio.sleep(0.01)
+            n = ser.in_waiting
+            if not n:
+                # short poll: keeps command round trips fast
+                await asyncio.sleep(0.005)
                 continue
-            try:
-                data = json.loads(lineb.decode("utf-8", errors="ignore").strip())
-                # gắn timestamp hệ thống (UTC)
-                from datetime import timezone
-
-                data["ts"] = datetime.now(timezone.utc).strftime("%Y-%m-%dT%H:%M:%SZ")
-            except Exception as e:
-                print("[PARSE] skip:", lineb[:80], e)
-                continue
-
-            # ghi CSV
-            with CSV_FILE.open("a", newline="", encoding="utf-8") as f:
-                csv.writer(f).writerow(
-                    [
-                        data.get("ts"),
-                        data.get("device_id"),
-                        data.get("temp_c"),
-                        data.get("humidity"),
-                    ]
-                )
-            # phát realtime
-            await broadcast(json.dumps(data))
+            for data in decoder.feed(ser.read(n)):
+                data["ts"] = utc_now()
+                await publish(data)
+            link_client.dispatch()
     finally:
-        ser.close()
+        link_client = None
+        print("[INFO] link stats:", decoder.stats())
+        decoder.close()
 
 
 @asynccontextmanager
@@ -125,6 +165,41 @@ async def ws(ws: WebSocket):
         clients.discard(ws)
 
 
+# Command channel (LINK=binary only): tune rates at runtime, e.g.
+#   curl -X POST "localhost:8000/link/rates?uart_interval_ms=500&sample_period_ms=1000"
+def require_link():
+    if link_client is None:
+        raise HTTPException(503, "command channel needs LINK=binary and an open port")
+    return link_client
+
+
+async def run_command(coro):
+    from telemetry_link import CommandError
+
+    try:
+        return await coro
+    except CommandError as e:
+        raise HTTPException(502, str(e))
+
+
+@app.post("/link/rates")
+async def link_rates(uart_interval_ms: int = 0, sample_period_ms: int = 0):
+    return await run_command(
+        require_link().set_rates(uart_interval_ms, sample_period_ms)
+    )
+
+
+@app.get("/link/stats")
+async def link_stats():
+    return await run_command(require_link().get_stats())
+
+
+@app.post("/link/provision")
+async def link_provision():
+    await run_command(require_link().start_provisioning())
+    return {"ok": True}
+
+
 @app.get("/download")
 def download():
     return FileResponse(CSV_FILE, filename="telemetry.csv", media_type="text/csv")
@@ -0,0 +1,227 @@
+"""ctypes binding of host_tools/telemetry_link (C ABI in telemetry_link_c.h).
+
+Decodes the binary frames of uart_bridge (CONFIG_UART_BRIDGE_TRANSPORT_BINARY).
+Build the library first:
+
+    cmake -S host_tools -B host_tools/build && cmake --build host_tools/build
+"""
+
+import asyncio
+import ctypes
+import os
+import random
+import sys
+from pathlib import Path
+
+# Commands and statuses of the command channel (firmware telemetry_cmd.h)
+CMD_PING = 0
+CMD_SET_RATES = 1
+CMD_GET_STATS = 2
+CMD_DUMP_HISTORY = 3
+CMD_START_PROVISIONING = 4
+
+STATUS_NAMES = ["ok", "unknown command", "bad arguments", "unavailable", "failed"]
+STAT_NAMES = [
+    "uptime_ms",
+    "frames",
+    "samples",
+    "bytes",
+    "dropped",
+    "requests",
+    "bad_requests",
+    "uart_interval_ms",
+    "sample_period_ms",
+]
+MAX_VALUES = 16
+
+
+class _Sample(ctypes.Structure):
+    _fields_ = [
+        ("device_id", ctypes.c_char * 32),
+        ("frame_seq", ctypes.c_uint32),
+        ("seq", ctypes.c_uint32),
+        ("ts_us", ctypes.c_int64),
+        ("temp_dc", ctypes.c_int32),
+        ("hum_dpct", ctypes.c_int32),
+    ]
+
+
+class _Stats(ctypes.Structure):
+    _fields_ = [
+        (name, ctypes.c_uint64)
+        for name in (
+            "bytes",
+            "frames",
+            "samples",
+            "bad_frames",
+            "text_bytes",
+            "frame_gaps",
+            "sample_gaps",
+            "responses",
+        )
+    ]
+
+
+class _Response(ctypes.Structure):
+    _fields_ = [
+        ("msg_id", ctypes.c_uint32),
+        ("cmd", ctypes.c_uint8),
+        ("status", ctypes.c_uint8),
+        ("n_values", ctypes.c_int32),
+        ("values", ctypes.c_uint64 * MAX_VALUES),
+    ]
+
+
+def _default_lib_path() -> Path:
+    if sys.platform == "win32":
+        name = "telemetry_link.dll"
+    elif sys.platform == "darwin":
+        name = "libtelemetry_link.dylib"
+    else:
+        name = "libtelemetry_link.so"
+    root = Path(__file__).resolve().parent.parent
+    return root / "host_tools" / "build" / "telemetry_link" / name
+
+
+def _load(path: str | None):
+    lib = ctypes.CDLL(str(path or os.getenv("TELEMETRY_LINK_LIB") or _default_lib_path()))
+    lib.tl_decoder_new.restype = ctypes.c_void_p
+    lib.tl_decoder_new.argtypes = []
+    lib.tl_decoder_free.restype = None
+    lib.tl_decoder_free.argtypes = [ctypes.c_void_p]
+    lib.tl_decoder_feed.restype = ctypes.c_size_t
+    lib.tl_decoder_feed.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+    lib.tl_decoder_next.restype = ctypes.c_int
+    lib.tl_decoder_next.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Sample)]
+    lib.tl_decoder_next_response.restype = ctypes.c_int
+    lib.tl_decoder_next_response.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Response)]
+    lib.tl_decoder_stats.restype = None
+    lib.tl_decoder_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Stats)]
+    lib.tl_encode_request.restype = ctypes.c_size_t
+    lib.tl_encode_request.argtypes = [
+        ctypes.c_uint32,
+        ctypes.c_uint8,
+        ctypes.POINTER(ctypes.c_uint64),
+        ctypes.c_size_t,
+        ctypes.c_char_p,
+        ctypes.c_size_t,
+    ]
+    return lib
+
+
+class TelemetryDecoder:
+    """Feed raw serial bytes, get readings as dicts in the JSON line format."""
+
+    def __init__(self, lib_path: str | None = None):
+        self._lib = _load(lib_path)
+        self._dec = self._lib.tl_decoder_new()
+
+    def close(self):
+        if self._dec:
+            self._lib.tl_decoder_free(self._dec)
+            self._dec = None
+
+    def __del__(self):
+        self.close()
+
+    def feed(self, data: bytes) -> list[dict]:
+        """Returns the samples; responses are kept for responses()."""
+        if not self._lib.tl_decoder_feed(self._dec, data, len(data)):
+            return []
+        out = []
+        s = _Sample()
+        while self._lib.tl_decoder_next(self._dec, ctypes.byref(s)):
+            out.append(
+                {
+                    "device_id": s.device_id.decode("utf-8", errors="replace"),
+                    "temp_c": s.temp_dc / 10,
+                    "humidity": s.hum_dpct / 10,
+                    "seq": s.seq,
+                    "ts_us": s.ts_us,
+                }
+            )
+        return out
+
+    def responses(self) -> list[tuple[int, int, list[int] | None]]:
+        """(msg_id, status, result values or None) of each new response."""
+        out = []
+        r = _Response()
+        while self._lib.tl_decoder_next_response(self._dec, ctypes.byref(r)):
+            values = list(r.values[: r.n_values]) if r.n_values >= 0 else None
+            out.append((r.msg_id, r.status, values))
+        return out
+
+    def encode_request(self, msg_id: int, cmd: int, args: list[int]) -> bytes:
+        arr = (ctypes.c_uint64 * max(1, len(args)))(*args)
+        buf = ctypes.create_string_buffer(256)
+        n = self._lib.tl_encode_request(msg_id, cmd, arr, len(args), buf, len(buf))
+        if not n:
+            raise ValueError("cannot encode request")
+        return buf.raw[:n]
+
+    def stats(self) -> dict:
+        st = _Stats()
+        self._lib.tl_decoder_stats(self._dec, ctypes.byref(st))
+        return {name: getattr(st, name) for name, _ in _Stats._fields_}
+
+
+class CommandError(Exception):
+    pass
+
+
+class LinkClient:
+    """Requests over the link (asyncio). The serial reader feeds responses in
+    through dispatch(); a request is resent with the same msg id until its
+    response arrives, the node answers resends from its cache."""
+
+    def __init__(self, decoder: TelemetryDecoder, write, timeout_s=0.3, attempts=4):
+        self._decoder = decoder
+        self._write = write  # bytes -> None
+        self._timeout_s = timeout_s
+        self._attempts = attempts
+        self._msg_id = random.randint(1, 0xFFFFFFFF)
+        self._pending: dict[int, asyncio.Future] = {}
+        self._lock = asyncio.Lock()  # one request in flight, like the node's cache
+
+    def dispatch(self):
+        for msg_id, status, values in self._decoder.responses():
+            fut = self._pending.get(msg_id)
+            if fut and not fut.done():
+                fut.set_result((status, values))
+
+    async def request(self, cmd: int, args: list[int] | None = None) -> list[int]:
+        async with self._lock:
+            self._msg_id = self._msg_id % 0xFFFFFFFF + 1
+            msg_id = self._msg_id
+            frame = self._decoder.encode_request(msg_id, cmd, args or [])
+            fut = asyncio.get_running_loop().create_future()
+            self._pending[msg_id] = fut
+            try:
+                for _ in range(self._attempts):
+                    self._write(frame)
+                    try:
+                        status, values = await asyncio.wait_for(
+                            asyncio.shield(fut), self._timeout_s
+                        )
+                        break
+                    except asyncio.TimeoutError:
+                        continue
+                else:
+                    raise CommandError(f"no response after {self._attempts} attempts")
+            finally:
+                del self._pending[msg_id]
+        if status != 0:
+            name = STATUS_NAMES[status] if status < len(STATUS_NAMES) else str(status)
+            raise CommandError(name)
+        return values or []
+
+    async def set_rates(self, uart_interval_ms: int = 0, sample_period_ms: int = 0) -> dict:
+        v = await self.request(CMD_SET_RATES, [uart_interval_ms, sample_period_ms])
+        return {"uart_interval_ms": v[0], "sample_period_ms": v[1]}
+
+    async def get_stats(self) -> dict:
+        v = await self.request(CMD_GET_STATS)
+        return {name: v[i] for i, name in enumerate(STAT_NAMES) if i < len(v)}
+
+    async def start_provisioning(self):
+        await self.request(CMD_START_PROVISIONING)
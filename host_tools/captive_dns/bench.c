@@ -0,0 +1,256 @@
+// captive_dns_bench: queries per second of the captive-portal DNS
+// (firmware/esp_idf_shared_components/wifi_config_ap/src/captive_dns.c).
+//
+//   captive_dns_bench [-t SECONDS] [-w WINDOW]
+//
+// First the reply builder alone: the lookups a phone makes on joining the
+// AP (A and AAAA for the probe hosts, with and without EDNS), each copied
+// into the receive buffer and answered in place, for SECONDS (1). Then
+// the same builder behind the loop of the firmware task on a loopback UDP
+// socket: non-blocking, select() with the 250 ms stop poll and bursts of
+// 16, with a client keeping WINDOW (32) queries in flight. Reports
+// queries per second and ns per query for both. Exits non-zero if a reply
+// is wrong.
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "captive_dns.h"
+
+#define DNS_POLL_MS 250 // as in wifi_config_ap.c
+#define DNS_BURST 16
+
+static const uint8_t s_ip[4] = {192, 168, 4, 1};
+
+typedef struct
+{
+    uint8_t b[CAPTIVE_DNS_MAX_PACKET];
+    size_t len;
+    size_t reply_len;
+    bool a; // answered with the AP address
+} query_t;
+
+static query_t s_queries[8];
+static volatile size_t s_sink;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_query(query_t *q, uint16_t id, const char *name, uint16_t qtype, bool edns)
+{
+    const uint8_t hdr[12] = {id >> 8, id & 0xFF, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, edns ? 1 : 0};
+    memcpy(q->b, hdr, sizeof(hdr));
+    q->len = sizeof(hdr);
+    while (*name)
+    {
+        const char *dot = strchr(name, '.');
+        const size_t n = dot ? (size_t)(dot - name) : strlen(name);
+        q->b[q->len++] = (uint8_t)n;
+        memcpy(q->b + q->len, name, n);
+        q->len += n;
+        name += n + (dot ? 1 : 0);
+    }
+    const uint8_t tail[5] = {0, qtype >> 8, qtype & 0xFF, 0, 1};
+    memcpy(q->b + q->len, tail, sizeof(tail));
+    q->len += sizeof(tail);
+    // A reply has the question and, for A, one 16-byte answer
+    q->a = qtype == 1;
+    q->reply_len = q->len + (q->a ? 16 : 0);
+    if (edns)
+    {
+        static const uint8_t opt[11] = {0, 0, 41, 0x10, 0, 0, 0, 0, 0, 0, 0};
+        memcpy(q->b + q->len, opt, sizeof(opt));
+        q->len += sizeof(opt);
+    }
+}
+
+static void make_queries(void)
+{
+    static const char *const hosts[] = {"connectivitycheck.gstatic.com", "captive.apple.com",
+                                        "www.msftconnecttest.com", "clients3.google.com"};
+    for (int i = 0; i < 8; i++)
+        make_query(&s_queries[i], (uint16_t)(0x100 + i), hosts[i / 2], i % 2 ? 28 : 1, i % 4 < 2);
+}
+
+static bool reply_ok(const query_t *q, const uint8_t *r, size_t n)
+{
+    return n == q->reply_len && memcmp(r, q->b, 2) == 0 && (r[2] & 0x80) &&
+           (!q->a || memcmp(r + n - 4, s_ip, 4) == 0);
+}
+
+/*========== Reply builder alone ==========*/
+static int bench_builder(double seconds)
+{
+    uint8_t buf[CAPTIVE_DNS_MAX_PACKET];
+    for (int i = 0; i < 8; i++)
+    {
+        memcpy(buf, s_queries[i].b, s_queries[i].len);
+        const size_t n = captive_dns_reply(buf, s_queries[i].len, s_ip, buf, sizeof(buf));
+        if (!reply_ok(&s_queries[i], buf, n))
+        {
+            printf("FAIL: reply %d: %zu bytes, want %zu\n", i, n, s_queries[i].reply_len);
+            return 1;
+        }
+    }
+
+    size_t reps = 0;
+    const double t0 = now_s();
+    double t;
+    do
+    {
+        for (int k = 0; k < 1024; k++)
+        {
+            const query_t *q = &s_queries[k & 7];
+            memcpy(buf, q->b, q->len); // recvfrom()
+            s_sink += captive_dns_reply(buf, q->len, s_ip, buf, sizeof(buf));
+        }
+        reps += 1024;
+        t = now_s() - t0;
+    } while (t < seconds);
+    printf("reply builder:        %10.0f queries/s %8.1f ns/query\n", (double)reps / t, t / (double)reps * 1e9);
+    return 0;
+}
+
+/*========== Behind the firmware loop, on loopback UDP ==========*/
+static volatile bool s_run;
+static int s_server_sock;
+
+static void *server_thread(void *arg)
+{
+    (void)arg;
+    static uint8_t buf[CAPTIVE_DNS_MAX_PACKET];
+    while (s_run)
+    {
+        fd_set rd;
+        FD_ZERO(&rd);
+        FD_SET(s_server_sock, &rd);
+        struct timeval tv = {.tv_sec = 0, .tv_usec = DNS_POLL_MS * 1000};
+        if (select(s_server_sock + 1, &rd, NULL, NULL, &tv) <= 0)
+            continue;
+        for (int i = 0; i < DNS_BURST; i++)
+        {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            const ssize_t n = recvfrom(s_server_sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+            if (n < 0)
+                break;
+            const size_t len = captive_dns_reply(buf, (size_t)n, s_ip, buf, sizeof(buf));
+            if (len)
+                sendto(s_server_sock, buf, len, 0, (struct sockaddr *)&from, from_len);
+        }
+    }
+    return NULL;
+}
+
+static int bench_udp(double seconds, int window)
+{
+    s_server_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t addr_len = sizeof(addr);
+    if (s_server_sock < 0 || bind(s_server_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(s_server_sock, (struct sockaddr *)&addr, &addr_len) != 0 ||
+        fcntl(s_server_sock, F_SETFL, O_NONBLOCK) != 0)
+    {
+        perror("server socket");
+        return 1;
+    }
+    const int client = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct timeval tmo = {.tv_sec = 0, .tv_usec = 100 * 1000};
+    if (client < 0 || connect(client, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tmo, sizeof(tmo)) != 0)
+    {
+        perror("client socket");
+        return 1;
+    }
+
+    s_run = true;
+    pthread_t th;
+    pthread_create(&th, NULL, server_thread, NULL);
+
+    size_t sent = 0, answered = 0, lost = 0, wrong = 0;
+    uint8_t r[CAPTIVE_DNS_MAX_PACKET];
+    const double t0 = now_s();
+    double t = 0;
+    while (t < seconds)
+    {
+        // Keep `window` queries in flight; a timeout counts the window as lost
+        while (sent - answered - lost < (size_t)window)
+        {
+            const query_t *q = &s_queries[sent & 7];
+            if (send(client, q->b, q->len, 0) < 0)
+                break;
+            sent++;
+        }
+        const ssize_t n = recv(client, r, sizeof(r), 0);
+        if (n < 0)
+        {
+            lost += sent - answered - lost;
+        }
+        else
+        {
+            // Replies carry the id of their query: 0x100 + index
+            const query_t *q = &s_queries[r[1] & 7];
+            if (!reply_ok(q, r, (size_t)n))
+                wrong++;
+            answered++;
+        }
+        t = now_s() - t0;
+    }
+    s_run = false;
+    pthread_join(th, NULL);
+    close(client);
+    close(s_server_sock);
+
+    printf("firmware loop on UDP: %10.0f queries/s %8.1f us/query, window %d, %zu lost\n",
+           (double)answered / t, t / (double)answered * 1e6, window, lost);
+    if (wrong)
+    {
+        printf("FAIL: %zu wrong replies\n", wrong);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 1.0;
+    int window = 32;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            window = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-t SECONDS] [-w WINDOW]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seconds <= 0 || window < 1)
+    {
+        fprintf(stderr, "usage: %s [-t SECONDS] [-w WINDOW]\n", argv[0]);
+        return 2;
+    }
+
+    make_queries();
+    int failures = bench_builder(seconds);
+    failures += bench_udp(seconds, window);
+    printf("%s\n", failures ? "FAILED" : "all replies checked");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,326 @@
+// captive_dns_check: host checks of the captive-portal DNS replies
+// (firmware/esp_idf_shared_components/wifi_config_ap/src/captive_dns.c).
+//
+//   captive_dns_check [-n PACKETS] [-s SEED]
+//
+// Fixed cases first: A, ANY, AAAA and non-IN questions, EDNS records
+// dropped, the RD bit echoed, the root name, 63-byte labels and 255-byte
+// names, replies that must not happen (answers, short headers), NOTIMP for
+// other opcodes, FORMERR for counts, long labels and names, compression
+// pointers and truncated questions, and a too small output buffer. Then
+// PACKETS (200000) random packets, valid queries with random mutations and
+// pure noise: the reply built in place must match the one built in a
+// separate buffer, stay inside `cap` and be a well-formed reply to the
+// query. Exits non-zero on the first failure.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "captive_dns.h"
+
+static const uint8_t s_ip[4] = {192, 168, 4, 1};
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        if (!(cond))                                                                                              \
+        {                                                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                                                  \
+            fprintf(stderr, __VA_ARGS__);                                                                         \
+            fputc('\n', stderr);                                                                                  \
+            s_failures++;                                                                                         \
+            return;                                                                                               \
+        }                                                                                                         \
+    } while (0)
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+/*========== Query builder ==========*/
+typedef struct
+{
+    uint8_t b[CAPTIVE_DNS_MAX_PACKET];
+    size_t len;
+} packet_t;
+
+// Header with one question for `name` (dotted, "" for the root)
+static void make_query(packet_t *p, uint16_t id, uint16_t flags, const char *name, uint16_t qtype, uint16_t qclass)
+{
+    const uint8_t hdr[12] = {id >> 8, id & 0xFF, flags >> 8, flags & 0xFF, 0, 1, 0, 0, 0, 0, 0, 0};
+    memcpy(p->b, hdr, sizeof(hdr));
+    p->len = sizeof(hdr);
+    while (*name)
+    {
+        const char *dot = strchr(name, '.');
+        const size_t n = dot ? (size_t)(dot - name) : strlen(name);
+        p->b[p->len++] = (uint8_t)n;
+        memcpy(p->b + p->len, name, n);
+        p->len += n;
+        name += n + (dot ? 1 : 0);
+    }
+    p->b[p->len++] = 0;
+    const uint8_t tail[4] = {qtype >> 8, qtype & 0xFF, qclass >> 8, qclass & 0xFF};
+    memcpy(p->b + p->len, tail, 4);
+    p->len += 4;
+}
+
+// The OPT pseudo-record most resolvers add
+static void add_edns(packet_t *p)
+{
+    static const uint8_t opt[11] = {0, 0, 41, 0x10, 0, 0, 0, 0, 0, 0, 0};
+    memcpy(p->b + p->len, opt, sizeof(opt));
+    p->len += sizeof(opt);
+    p->b[11] = 1; // ARCOUNT
+}
+
+static size_t reply(const packet_t *q, uint8_t *out, size_t cap)
+{
+    return captive_dns_reply(q->b, q->len, s_ip, out, cap);
+}
+
+// Length of the question section of a well-formed query
+static size_t question_len(const packet_t *q)
+{
+    size_t pos = 12;
+    while (q->b[pos])
+        pos += 1u + q->b[pos];
+    return pos + 5 - 12;
+}
+
+/*========== Fixed cases ==========*/
+static void check_answer(uint16_t qtype, bool edns)
+{
+    s_cases++;
+    packet_t q;
+    make_query(&q, 0xBEEF, 0x0100, "connectivitycheck.gstatic.com", qtype, 1);
+    if (edns)
+        add_edns(&q);
+    uint8_t r[CAPTIVE_DNS_MAX_PACKET];
+    const size_t n = reply(&q, r, sizeof(r));
+    const size_t qlen = question_len(&q);
+    CHECK(n == 12 + qlen + 16, "type %u edns %d: %zu bytes", qtype, edns, n);
+    CHECK(get16(r) == 0xBEEF, "id %04x", get16(r));
+    CHECK(get16(r + 2) == 0x8580, "flags %04x, want QR AA RD RA", get16(r + 2));
+    CHECK(get16(r + 4) == 1 && get16(r + 6) == 1 && get16(r + 8) == 0 && get16(r + 10) == 0,
+          "counts %u %u %u %u", get16(r + 4), get16(r + 6), get16(r + 8), get16(r + 10));
+    CHECK(memcmp(r + 12, q.b + 12, qlen) == 0, "question not copied");
+    const uint8_t *a = r + 12 + qlen;
+    static const uint8_t want[12] = {0xC0, 12, 0, 1, 0, 1, 0, 0, 0, CAPTIVE_DNS_TTL_S, 0, 4};
+    CHECK(memcmp(a, want, sizeof(want)) == 0, "answer record header");
+    CHECK(memcmp(a + 12, s_ip, 4) == 0, "answer address %u.%u.%u.%u", a[12], a[13], a[14], a[15]);
+}
+
+static void check_nodata(uint16_t qtype, uint16_t qclass)
+{
+    s_cases++;
+    packet_t q;
+    make_query(&q, 7, 0x0000, "captive.apple.com", qtype, qclass);
+    add_edns(&q);
+    uint8_t r[CAPTIVE_DNS_MAX_PACKET];
+    const size_t n = reply(&q, r, sizeof(r));
+    CHECK(n == 12 + question_len(&q), "type %u class %u: %zu bytes", qtype, qclass, n);
+    CHECK(get16(r + 2) == 0x8480, "flags %04x, want QR AA RA, no RD", get16(r + 2));
+    CHECK(get16(r + 6) == 0 && get16(r + 10) == 0, "ANCOUNT %u ARCOUNT %u", get16(r + 6), get16(r + 10));
+}
+
+static void check_names(void)
+{
+    s_cases++;
+    char name[300];
+    packet_t q;
+    uint8_t r[CAPTIVE_DNS_MAX_PACKET];
+
+    make_query(&q, 1, 0, "", 1, 1);
+    CHECK(reply(&q, r, sizeof(r)) == 12 + 5 + 16, "root name");
+
+    // 63-byte labels up to exactly 255 bytes of name
+    memset(name, 0, sizeof(name));
+    for (int i = 0; i < 4; i++)
+    {
+        memset(name + i * 64, 'a' + i, 63);
+        name[i * 64 + 63] = '.';
+    }
+    name[3 * 64 + 61] = 0; // 3 * 64 + 62 + 1 = 255 with the root label
+    make_query(&q, 1, 0, name, 1, 1);
+    CHECK(reply(&q, r, sizeof(r)) == 12 + 255 + 4 + 16, "255-byte name");
+
+    // One byte more
+    name[3 * 64 + 61] = 'd';
+    name[3 * 64 + 62] = 0;
+    make_query(&q, 1, 0, name, 1, 1);
+    CHECK(reply(&q, r, sizeof(r)) == 12 && (r[3] & 0xF) == 1, "256-byte name: FORMERR");
+
+    // 64-byte label
+    memset(name, 'x', 64);
+    name[64] = 0;
+    make_query(&q, 1, 0, name, 1, 1);
+    CHECK(reply(&q, r, sizeof(r)) == 12 && (r[3] & 0xF) == 1, "64-byte label: FORMERR");
+}
+
+static void check_errors(void)
+{
+    s_cases++;
+    packet_t q;
+    uint8_t r[CAPTIVE_DNS_MAX_PACKET];
+
+    make_query(&q, 0x1234, 0x8100, "example.com", 1, 1);
+    CHECK(reply(&q, r, sizeof(r)) == 0, "a reply got a reply");
+
+    make_query(&q, 0x1234, 0x0100, "example.com", 1, 1);
+    CHECK(captive_dns_reply(q.b, 11, s_ip, r, sizeof(r)) == 0, "11-byte packet");
+
+    // STATUS (2) and UPDATE (5): NOTIMP, opcode and RD echoed
+    make_query(&q, 0x1234, 0x1100, "example.com", 1, 1);
+    size_t n = reply(&q, r, sizeof(r));
+    CHECK(n == 12 && get16(r + 2) == 0x9184 && get16(r) == 0x1234, "opcode 2: %zu bytes flags %04x", n,
+          get16(r + 2));
+    make_query(&q, 0x1234, 0x2800, "example.com", 1, 1);
+    n = reply(&q, r, sizeof(r));
+    CHECK(n == 12 && get16(r + 2) == 0xA884, "opcode 5: flags %04x", get16(r + 2));
+
+    // Question counts other than one
+    make_query(&q, 9, 0x0100, "example.com", 1, 1);
+    q.b[5] = 0;
+    n = reply(&q, r, sizeof(r));
+    CHECK(n == 12 && get16(r + 2) == 0x8181 && get16(r + 4) == 0, "QDCOUNT 0: flags %04x", get16(r + 2));
+    q.b[5] = 2;
+    CHECK(reply(&q, r, sizeof(r)) == 12 && (r[3] & 0xF) == 1, "QDCOUNT 2");
+
+    // Compression pointer in the question
+    make_query(&q, 9, 0, "example.com", 1, 1);
+    q.b[12] = 0xC0;
+    CHECK(reply(&q, r, sizeof(r)) == 12 && (r[3] & 0xF) == 1, "pointer in question");
+
+    // Every truncation of a valid query
+    make_query(&q, 9, 0, "www.example.com", 1, 1);
+    for (size_t len = 12; len < q.len; len++)
+    {
+        n = captive_dns_reply(q.b, len, s_ip, r, sizeof(r));
+        CHECK(n == 12 && (r[3] & 0xF) == 1, "cut at %zu: %zu bytes", len, n);
+    }
+
+    // Output too small for the answer, then for the header
+    make_query(&q, 9, 0, "example.com", 1, 1);
+    const size_t full = reply(&q, r, sizeof(r));
+    CHECK(reply(&q, r, full - 1) == 0, "cap one short");
+    CHECK(reply(&q, r, full) == full, "cap exact");
+    q.b[5] = 0;
+    CHECK(reply(&q, r, 11) == 0, "error reply in 11 bytes");
+}
+
+/*========== Random packets ==========*/
+// Well-formed reply to `q`, `n` bytes
+static const char *reply_wrong(const uint8_t *q, size_t qlen, const uint8_t *r, size_t n)
+{
+    if (n == 0)
+        return (qlen >= 12 && !(q[2] & 0x80)) ? "no reply to a query" : NULL;
+    if (qlen < 12 || (q[2] & 0x80))
+        return "reply to a non-query";
+    if (n < 12 || memcmp(r, q, 2) != 0)
+        return "header or id";
+    if (!(r[2] & 0x80) || (r[2] & 0x01) != (q[2] & 0x01) || get16(r + 8) != 0 || get16(r + 10) != 0)
+        return "flags or counts";
+    const uint8_t rcode = r[3] & 0xF;
+    if (rcode != 0)
+        return n == 12 && get16(r + 4) == 0 && get16(r + 6) == 0 ? NULL : "error reply with records";
+    if (get16(r + 4) != 1 || n > qlen + 16)
+        return "question count or size";
+    const size_t q_end = n - (get16(r + 6) ? 16 : 0);
+    if (memcmp(r + 4, q + 4, 2) != 0 || memcmp(r + 12, q + 12, q_end - 12) != 0)
+        return "question not copied";
+    if (get16(r + 6) && (memcmp(r + q_end + 12, s_ip, 4) != 0 || get16(r + q_end) != 0xC00C))
+        return "answer";
+    return NULL;
+}
+
+static void check_random(long packets)
+{
+    static const char *const names[] = {"", "a", "example.com", "connectivitycheck.gstatic.com",
+                                        "www.msftconnecttest.com", "x.y.z.w.v"};
+    for (long k = 0; k < packets; k++)
+    {
+        s_cases++;
+        packet_t q;
+        if (rand() % 8 == 0)
+        {
+            q.len = (size_t)rand() % 64;
+            for (size_t i = 0; i < q.len; i++)
+                q.b[i] = (uint8_t)rand();
+        }
+        else
+        {
+            make_query(&q, (uint16_t)rand(), (uint16_t)(rand() & 0x0100), names[rand() % 6],
+                       (uint16_t)(rand() % 3 ? 1 : rand() % 300), (uint16_t)(rand() % 4 ? 1 : rand() % 5));
+            if (rand() % 2)
+                add_edns(&q);
+            for (int m = rand() % 4; m > 0; m--)
+                q.b[(size_t)rand() % q.len] ^= (uint8_t)(1u << (rand() % 8));
+            if (rand() % 4 == 0)
+                q.len = (size_t)rand() % (q.len + 1);
+        }
+
+        const size_t cap = rand() % 8 ? CAPTIVE_DNS_MAX_PACKET : (size_t)rand() % 80;
+        uint8_t out[CAPTIVE_DNS_MAX_PACKET + 16];
+        memset(out, 0xA5, sizeof(out));
+        const size_t n = captive_dns_reply(q.b, q.len, s_ip, out, cap);
+        CHECK(n <= cap, "packet %ld: %zu bytes in cap %zu", k, n, cap);
+        for (size_t i = cap; i < sizeof(out); i++)
+            CHECK(out[i] == 0xA5, "packet %ld: wrote byte %zu past cap %zu", k, i, cap);
+        if (cap == CAPTIVE_DNS_MAX_PACKET)
+        {
+            const char *why = reply_wrong(q.b, q.len, out, n);
+            CHECK(!why, "packet %ld (%zu bytes): %s", k, q.len, why);
+        }
+
+        // In place, as the firmware task does it
+        packet_t in_place = q;
+        const size_t n2 = captive_dns_reply(in_place.b, in_place.len, s_ip, in_place.b, cap);
+        CHECK(n2 == n && memcmp(in_place.b, out, n) == 0, "packet %ld: in place differs", k);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long packets = 200000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            packets = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n PACKETS] [-s SEED]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    check_answer(1, false);
+    check_answer(1, true);
+    check_answer(255, true);
+    check_nodata(28, 1);  // AAAA
+    check_nodata(65, 1);  // HTTPS
+    check_nodata(1, 3);   // CHAOS
+    check_names();
+    check_errors();
+    if (!s_failures)
+        check_random(packets);
+
+    if (s_failures)
+    {
+        fprintf(stderr, "%d of %d cases failed\n", s_failures, s_cases);
+        return 1;
+    }
+    printf("captive_dns_check: %d cases passed\n", s_cases);
+    return 0;
+}
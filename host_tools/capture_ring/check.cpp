@@ -0,0 +1,444 @@
+// capture_ring_check: host checks of the queue between the IR receiver and
+// the UART of ir_dump_esp8266
+// (firmware/nodes_platformio/lib/ir_wire/capture_ring.cpp).
+//
+//   capture_ring_check [-n CAPTURES] [-s SEED]
+//
+// Fixed cases first: overflow under DropNewest and DropOldest, a capture
+// larger than the arena, repeats folded inside the window, new captures
+// outside it, and repeats of a record already handed to the UART, which
+// are only suppressed. Then CAPTURES (20000) random captures and pops that
+// wrap the arena, checked record by record against what was queued. Last,
+// captures queued faster than 115200 baud drains, under both policies: the
+// bytes the UART would send go through the host decoder and must come back
+// intact, with the losses the ring reports and no others.
+// Exits non-zero on failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <random>
+#include <vector>
+
+#include "capture_ring.h"
+#include "ir_dump_decoder.h"
+#include "ir_wire.h"
+
+static const uint16_t kUsPerTick = 2; // kRawTick of IRremoteESP8266
+static const uint32_t kWindowMs = 250;
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        if (!(cond))                                                                                              \
+        {                                                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                                                  \
+            fprintf(stderr, __VA_ARGS__);                                                                         \
+            fputc('\n', stderr);                                                                                  \
+            s_failures++;                                                                                         \
+            return;                                                                                               \
+        }                                                                                                         \
+    } while (0)
+
+/*========== Captures ==========*/
+using Ticks = std::vector<uint16_t>;
+
+// `count` timings whose shape (longer/shorter than the one before) follows
+// `shape`'s bits, so one shape always hashes alike whatever the jitter
+static Ticks make_ticks(std::mt19937 &rng, uint16_t count, uint32_t shape)
+{
+    Ticks t(count);
+    std::uniform_int_distribution<int> jitter(-3, 3);
+    t[0] = 30000;
+    for (uint16_t i = 1; i < count; i++)
+    {
+        const bool longer = (shape >> (i % 32)) & 1;
+        t[i] = (uint16_t)((longer ? 840 : 280) + jitter(rng));
+    }
+    return t;
+}
+
+// What queueBinaryCapture() does, `seq` taken only when the ring has room
+static bool queue(CaptureRing &ring, uint32_t &seq, const Ticks &t, uint32_t nowMs, bool fold)
+{
+    const uint16_t count = (uint16_t)t.size();
+    const uint32_t hash = irWireTimingHash(t.data(), count);
+    if (fold && ring.absorbRepeat(hash, nowMs, kWindowMs))
+        return true;
+
+    const size_t maxBody = irWireMaxPayloadSize(count);
+    uint8_t *body = ring.reserve(maxBody);
+    if (!body)
+        return false;
+
+    IrWireHeader hdr;
+    hdr.seq = seq++;
+    hdr.tsMs = nowMs;
+    hdr.protocol = "NEC";
+    hdr.bits = 32;
+    hdr.hasRepeats = true;
+    const size_t len = irWireBuildBody(hdr, t.data(), count, kUsPerTick, body, maxBody);
+    ring.commit(len, hash, nowMs);
+    return len != 0;
+}
+
+struct Popped
+{
+    bool ok = false;
+    uint32_t seq = 0;
+    uint16_t repeats = 0;
+    std::vector<uint32_t> us;
+};
+
+static Popped pop(CaptureRing &ring)
+{
+    static uint8_t buf[8192];
+    Popped p;
+    const size_t len = ring.pop(buf, sizeof(buf));
+    IrWireView view;
+    if (!len || !irWireParsePayload(buf, len, view))
+        return p;
+    p.ok = true;
+    p.seq = view.seq;
+    p.repeats = view.repeats;
+    IrWireTimingReader reader(view);
+    uint32_t us;
+    while (reader.next(us))
+        p.us.push_back(us);
+    return p;
+}
+
+static bool same_timings(const std::vector<uint32_t> &us, const Ticks &t)
+{
+    if (us.size() != t.size())
+        return false;
+    for (size_t i = 0; i < t.size(); i++)
+        if (us[i] != (uint32_t)t[i] * kUsPerTick)
+            return false;
+    return true;
+}
+
+/*========== Fixed cases ==========*/
+static void check_drop_newest()
+{
+    s_cases++;
+    std::mt19937 rng(1);
+    static uint8_t arena[1024];
+    CaptureRing ring(arena, sizeof(arena), CaptureRing::OverflowPolicy::DropNewest);
+
+    uint32_t seq = 0;
+    int accepted = 0;
+    for (int i = 0; i < 40; i++)
+        accepted += queue(ring, seq, make_ticks(rng, 68, (uint32_t)i * 2654435761u), 1000 + i * 1000, false);
+    const CaptureRing::Stats &st = ring.stats();
+    CHECK(accepted > 0 && accepted < 40, "accepted %d of 40", accepted);
+    CHECK(st.dropped == (uint32_t)(40 - accepted), "dropped %u, rejected %d", (unsigned)st.dropped, 40 - accepted);
+    CHECK(ring.count() == (size_t)accepted && st.committed == (uint32_t)accepted, "queued %zu", ring.count());
+    CHECK(st.highWater <= ring.capacity(), "high water %zu over %zu", st.highWater, ring.capacity());
+
+    // The first captures are kept, in order
+    for (int i = 0; i < accepted; i++)
+    {
+        const Popped p = pop(ring);
+        CHECK(p.ok && p.seq == (uint32_t)i, "pop %d: seq %u", i, (unsigned)p.seq);
+    }
+    CHECK(ring.empty() && ring.used() == 0, "%zu bytes left", ring.used());
+}
+
+static void check_drop_oldest()
+{
+    s_cases++;
+    std::mt19937 rng(2);
+    static uint8_t arena[1024];
+    CaptureRing ring(arena, sizeof(arena), CaptureRing::OverflowPolicy::DropOldest);
+
+    uint32_t seq = 0;
+    for (int i = 0; i < 40; i++)
+    {
+        const uint16_t count = (uint16_t)(20 + rng() % 100);
+        CHECK(queue(ring, seq, make_ticks(rng, count, (uint32_t)i * 2654435761u), 1000 + i * 1000, false),
+              "capture %d rejected", i);
+    }
+    const CaptureRing::Stats &st = ring.stats();
+    const size_t kept = ring.count();
+    CHECK(st.committed == 40 && st.dropped == 40 - kept, "committed %u dropped %u kept %zu",
+          (unsigned)st.committed, (unsigned)st.dropped, kept);
+    CHECK(st.dropped > 0, "nothing evicted");
+
+    // The newest captures are kept, in order
+    for (size_t i = 0; i < kept; i++)
+    {
+        const Popped p = pop(ring);
+        CHECK(p.ok && p.seq == 40 - kept + i, "pop %zu: seq %u", i, (unsigned)p.seq);
+    }
+    CHECK(ring.empty() && ring.used() == 0, "%zu bytes left", ring.used());
+}
+
+// Larger than the whole arena: rejected, and under DropOldest it must not
+// take the queue down with it
+static void check_oversize()
+{
+    for (int policy = 0; policy < 2; policy++)
+    {
+        s_cases++;
+        std::mt19937 rng(3);
+        static uint8_t arena[512];
+        CaptureRing ring(arena, sizeof(arena),
+                         policy ? CaptureRing::OverflowPolicy::DropOldest : CaptureRing::OverflowPolicy::DropNewest);
+        uint32_t seq = 0;
+        CHECK(queue(ring, seq, make_ticks(rng, 20, 0x5555), 1000, false), "small capture rejected");
+        CHECK(!queue(ring, seq, make_ticks(rng, 400, 0x3333), 2000, false), "oversize capture accepted");
+        CHECK(ring.count() == 1 && ring.stats().dropped == 1, "policy %d: %zu queued, %u dropped", policy,
+              ring.count(), (unsigned)ring.stats().dropped);
+        const Popped p = pop(ring);
+        CHECK(p.ok && p.seq == 0, "policy %d: seq %u", policy, (unsigned)p.seq);
+    }
+}
+
+static void check_repeats()
+{
+    s_cases++;
+    std::mt19937 rng(4);
+    static uint8_t arena[2048];
+    CaptureRing ring(arena, sizeof(arena));
+    const Ticks a = make_ticks(rng, 68, 0xA5A5A5A5);
+    const Ticks b = make_ticks(rng, 68, 0x0F0F0F0F);
+    uint32_t seq = 0;
+
+    // Held for 2 s, one frame every 110 ms: the window slides with the press
+    uint32_t t = 1000;
+    CHECK(queue(ring, seq, a, t, true), "first press rejected");
+    for (int i = 0; i < 18; i++)
+        CHECK(ring.absorbRepeat(irWireTimingHash(a.data(), 68), t += 110, kWindowMs), "repeat %d not folded", i);
+    CHECK(ring.count() == 1 && ring.stats().deduped == 18, "queued %zu deduped %u", ring.count(),
+          (unsigned)ring.stats().deduped);
+
+    // Released, pressed again after the window: a capture of its own
+    t += kWindowMs + 1;
+    CHECK(!ring.absorbRepeat(irWireTimingHash(a.data(), 68), t, kWindowMs), "folded outside the window");
+    CHECK(queue(ring, seq, a, t, true) && ring.count() == 2, "second press not queued");
+
+    Popped p = pop(ring);
+    CHECK(p.ok && p.seq == 0 && p.repeats == 18 && same_timings(p.us, a), "first press: seq %u repeats %u",
+          (unsigned)p.seq, (unsigned)p.repeats);
+
+    // A repeat of a record the UART already has is suppressed, not counted
+    p = pop(ring);
+    CHECK(p.ok && p.seq == 1 && p.repeats == 0, "second press: seq %u repeats %u", (unsigned)p.seq,
+          (unsigned)p.repeats);
+    CHECK(ring.absorbRepeat(irWireTimingHash(a.data(), 68), t += 100, kWindowMs), "drained repeat not suppressed");
+    CHECK(ring.empty() && ring.stats().deduped == 19, "queued %zu deduped %u", ring.count(),
+          (unsigned)ring.stats().deduped);
+
+    // ... nor counted on another button's record queued since
+    CHECK(queue(ring, seq, b, t += 10, true), "other button rejected");
+    CHECK(ring.absorbRepeat(irWireTimingHash(a.data(), 68), t += 100, kWindowMs), "repeat not suppressed");
+    p = pop(ring);
+    CHECK(p.ok && p.seq == 2 && p.repeats == 0 && same_timings(p.us, b), "other button: seq %u repeats %u",
+          (unsigned)p.seq, (unsigned)p.repeats);
+}
+
+/*========== Random captures and pops ==========*/
+static void check_random(long captures, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    static uint8_t arena[4096];
+    for (int policy = 0; policy < 2; policy++)
+    {
+        s_cases++;
+        CaptureRing ring(arena, sizeof(arena),
+                         policy ? CaptureRing::OverflowPolicy::DropOldest : CaptureRing::OverflowPolicy::DropNewest);
+        std::map<uint32_t, Ticks> queued;
+        uint32_t seq = 0;
+        uint32_t lastPopped = 0;
+        bool popped = false;
+        long rejected = 0;
+
+        for (long i = 0; i < captures; i++)
+        {
+            const uint16_t count = (uint16_t)(1 + rng() % (rng() % 4 ? 120 : 600));
+            const Ticks t = make_ticks(rng, count, rng());
+            const uint32_t s = seq;
+            if (queue(ring, seq, t, (uint32_t)i * 1000, false))
+                queued[s] = t;
+            else
+                rejected++;
+            CHECK(ring.used() <= ring.capacity(), "%zu of %zu bytes used", ring.used(), ring.capacity());
+
+            // Drain at about the rate of the captures, in bursts
+            for (int n = (int)(rng() % 3); n > 0 && !ring.empty(); n--)
+            {
+                const Popped p = pop(ring);
+                CHECK(p.ok, "capture %ld: pop failed", i);
+                CHECK(!popped || p.seq > lastPopped, "seq %u after %u", (unsigned)p.seq, (unsigned)lastPopped);
+                // Under DropOldest the ones in between were evicted
+                while (!queued.empty() && queued.begin()->first < p.seq)
+                    queued.erase(queued.begin());
+                CHECK(!queued.empty() && queued.begin()->first == p.seq && same_timings(p.us, queued.begin()->second),
+                      "seq %u does not match what was queued", (unsigned)p.seq);
+                queued.erase(queued.begin());
+                popped = true;
+                lastPopped = p.seq;
+            }
+        }
+
+        const CaptureRing::Stats &st = ring.stats();
+        CHECK(st.committed == st.drained + ring.count() + (policy ? st.dropped : 0),
+              "policy %d: committed %u drained %u queued %zu dropped %u", policy, (unsigned)st.committed,
+              (unsigned)st.drained, ring.count(), (unsigned)st.dropped);
+        CHECK(policy || st.dropped == (uint32_t)rejected, "dropped %u, rejected %ld", (unsigned)st.dropped, rejected);
+        CHECK(st.dropped > 0 && st.highWater <= ring.capacity(), "policy %d: dropped %u high water %zu", policy,
+              (unsigned)st.dropped, st.highWater);
+    }
+}
+
+/*========== Faster than the UART ==========*/
+// 40 s of 64 distinct frames, TV-sized and AC-sized, one every 5-15 ms
+// (far faster than they could come on air, to keep the ring full), some
+// held with repeats every 110 ms, then quiet until the UART caught up. The UART
+// takes 115200 baud, 11.52 bytes a millisecond, pumped like pumpBinaryTx().
+static void check_uart(CaptureRing::OverflowPolicy policy, unsigned seed)
+{
+    s_cases++;
+    std::mt19937 rng(seed);
+    static uint8_t arena[12288]; // IR_DUMP_RING_BYTES
+    CaptureRing ring(arena, sizeof(arena), policy);
+    const bool dropOldest = policy == CaptureRing::OverflowPolicy::DropOldest;
+
+    std::vector<Ticks> buttons;
+    for (uint32_t i = 0; i < 64; i++)
+        buttons.push_back(make_ticks(rng, (uint16_t)(i % 4 ? 200 + 4 * i : 68), rng()));
+
+    std::map<uint32_t, size_t> sent; // seq -> button
+    std::map<uint32_t, IrCapture> received;
+    IrDumpStreamDecoder decoder([&](const IrCapture &c) { received[c.seq] = c; },
+                                [&](const std::string &) {});
+
+    std::vector<uint8_t> txPayload(irWireMaxPayloadSize(1024));
+    CobsStreamEncoder encoder;
+    uint32_t seq = 0;
+    long presses = 0, rejected = 0;
+    uint32_t next = 0, holdUntil = 0;
+    size_t held = 0;
+    uint64_t budget = 0; // in 1/100 bytes
+
+    for (uint32_t ms = 1; ms < 60000; ms++)
+    {
+        if (ms < 40000 && ms >= next)
+        {
+            size_t button;
+            if (ms < holdUntil)
+            {
+                button = held;
+                next = ms + 110;
+            }
+            else
+            {
+                button = rng() % buttons.size();
+                next = ms + 5 + rng() % 10;
+                if (rng() % 16 == 0)
+                {
+                    held = button;
+                    holdUntil = ms + 200 + rng() % 400;
+                }
+            }
+            presses++;
+            const uint32_t s = seq;
+            if (!queue(ring, seq, buttons[button], ms, true))
+                rejected++;
+            else if (seq != s)
+                sent[s] = button;
+        }
+
+        budget += 1152;
+        uint8_t chunk[64];
+        while (budget >= 100)
+        {
+            if (!encoder.busy())
+            {
+                const size_t len = ring.pop(txPayload.data(), txPayload.size());
+                if (!len)
+                    break;
+                encoder.begin(txPayload.data(), len);
+            }
+            const size_t room = (size_t)(budget / 100);
+            const size_t n = encoder.read(chunk, room < sizeof(chunk) ? room : sizeof(chunk));
+            decoder.feed(chunk, n);
+            budget -= n * 100;
+        }
+        if (ring.empty() && !encoder.busy())
+            budget = 0; // an idle UART does not save up
+    }
+    decoder.finish();
+
+    const CaptureRing::Stats &st = ring.stats();
+    const IrDumpStreamDecoder::Stats &ds = decoder.stats();
+    CHECK(ring.empty() && !encoder.busy(), "not drained: %zu queued", ring.count());
+    CHECK(st.dropped > 0 && st.deduped > 0, "the burst did not overflow (dropped %u deduped %u)",
+          (unsigned)st.dropped, (unsigned)st.deduped);
+    CHECK(ds.badFrames == 0 && ds.textBytes == 0, "%lu bad frames, %lu text bytes", (unsigned long)ds.badFrames,
+          (unsigned long)ds.textBytes);
+    CHECK(presses == (long)st.committed + (long)st.deduped + rejected, "presses %ld committed %u deduped %u rejected %ld",
+          presses, (unsigned)st.committed, (unsigned)st.deduped, rejected);
+    CHECK(ds.frames == st.drained && st.drained == (dropOldest ? st.committed - st.dropped : st.committed),
+          "frames %lu drained %u committed %u dropped %u", (unsigned long)ds.frames, (unsigned)st.drained,
+          (unsigned)st.committed, (unsigned)st.dropped);
+    // DropNewest never gives out a seq it then loses; DropOldest loses
+    // exactly the ones it reports
+    CHECK(ds.seqGaps == (dropOldest ? st.dropped : 0), "seq gaps %lu, dropped %u", (unsigned long)ds.seqGaps,
+          (unsigned)st.dropped);
+    CHECK(!dropOldest || rejected == 0, "DropOldest rejected %ld", rejected);
+
+    uint32_t repeats = 0;
+    for (const auto &r : received)
+    {
+        const auto it = sent.find(r.first);
+        CHECK(it != sent.end(), "seq %u was never queued", (unsigned)r.first);
+        const std::vector<uint32_t> &us = r.second.rawUs;
+        CHECK(same_timings(us, buttons[it->second]), "seq %u: timings differ", (unsigned)r.first);
+        repeats += r.second.repeats;
+    }
+    CHECK(repeats > 0 && repeats <= st.deduped, "%u repeats received, %u deduped", (unsigned)repeats,
+          (unsigned)st.deduped);
+    CHECK(st.highWater <= ring.capacity(), "high water %zu over %zu", st.highWater, ring.capacity());
+}
+
+int main(int argc, char **argv)
+{
+    long captures = 20000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            captures = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n CAPTURES] [-s SEED]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    check_drop_newest();
+    check_drop_oldest();
+    check_oversize();
+    check_repeats();
+    if (!s_failures)
+        check_random(captures, seed);
+    check_uart(CaptureRing::OverflowPolicy::DropNewest, seed);
+    check_uart(CaptureRing::OverflowPolicy::DropOldest, seed);
+
+    if (s_failures)
+    {
+        fprintf(stderr, "%d of %d cases failed\n", s_failures, s_cases);
+        return 1;
+    }
+    printf("capture_ring_check: %d cases passed\n", s_cases);
+    return 0;
+}
@@ -0,0 +1,251 @@
+// dht_decode_check: host checks of the DHT frame decoder of dht_reader
+// (firmware/esp_idf_shared_components/drivers/dht_reader/src/dht_decode.c).
+//
+//   dht_decode_check [-n FRAMES] [-s SEED]
+//
+// Builds the level spans an RMT capture of a DHT11 or DHT22 frame produces
+// (start pulse tail, response, 40 bits, closing low) and decodes them:
+// fixed readings of both encodings including negative temperatures,
+// checksum errors, truncated and late-started captures, split spans, bad
+// timing, then FRAMES random frames with jittered pulse widths. Exits
+// non-zero on the first mismatch.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dht_decode.h"
+
+#define MAX_SPANS 256
+
+typedef struct
+{
+    dht_span_t s[MAX_SPANS];
+    size_t n;
+} capture_t;
+
+typedef struct
+{
+    int jitter_us;       // +- on every pulse
+    bool skip_preamble;  // capture armed after the response
+    bool split_spans;    // long levels reported as two spans
+    int drop_last_bits;  // frame cut short
+    int stretch_bit;     // index of a bit whose high is made too long, -1 none
+} synth_opts_t;
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+static int jitter(int us, int j)
+{
+    return j ? us + (rand() % (2 * j + 1)) - j : us;
+}
+
+static void push(capture_t *c, int level, int us, bool split)
+{
+    if (split && us >= 40 && c->n + 2 <= MAX_SPANS)
+    {
+        c->s[c->n++] = (dht_span_t){.us = (uint16_t)(us / 2), .level = (uint8_t)level};
+        us -= us / 2;
+    }
+    if (c->n < MAX_SPANS)
+        c->s[c->n++] = (dht_span_t){.us = (uint16_t)us, .level = (uint8_t)level};
+}
+
+static void synth(capture_t *c, const uint8_t raw[5], const synth_opts_t *o)
+{
+    const int j = o->jitter_us;
+    c->n = 0;
+    if (!o->skip_preamble)
+    {
+        push(c, 0, 4, false);                        // our own start pulse, after arming
+        push(c, 1, jitter(30, j / 2), false);         // pull-up until the sensor answers
+        push(c, 0, jitter(80, j), o->split_spans);    // response
+        push(c, 1, jitter(80, j), o->split_spans);
+    }
+    const int bits = DHT_FRAME_BITS - o->drop_last_bits;
+    for (int b = 0; b < bits; b++)
+    {
+        const bool one = raw[b / 8] & (0x80 >> (b % 8));
+        push(c, 0, jitter(50, j), o->split_spans);
+        int high = one ? jitter(70, j) : jitter(27, j / 2);
+        if (b == o->stretch_bit)
+            high = 160;
+        push(c, 1, high, o->split_spans);
+    }
+    push(c, 0, jitter(50, j), false); // closing low; the idle high ends the capture
+}
+
+static void make_frame(uint8_t raw[5], uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3)
+{
+    raw[0] = b0;
+    raw[1] = b1;
+    raw[2] = b2;
+    raw[3] = b3;
+    raw[4] = (uint8_t)(b0 + b1 + b2 + b3);
+}
+
+static void expect(const char *name, const capture_t *c, dht_model_t model, dht_decode_result_t want_r,
+                   int want_t, int want_h)
+{
+    s_cases++;
+    dht_reading_t r = {0};
+    const dht_decode_result_t got = dht_decode_spans(c->s, c->n, model, &r, NULL);
+    bool ok = got == want_r;
+    if (ok && want_r == DHT_DECODE_OK)
+        ok = r.temp_dc == want_t && r.hum_dpct == want_h;
+    if (ok)
+        return;
+    fprintf(stderr, "FAIL %s: got %s", name, dht_decode_result_name(got));
+    if (got == DHT_DECODE_OK)
+        fprintf(stderr, " %d/%d", r.temp_dc, r.hum_dpct);
+    fprintf(stderr, ", want %s", dht_decode_result_name(want_r));
+    if (want_r == DHT_DECODE_OK)
+        fprintf(stderr, " %d/%d", want_t, want_h);
+    fprintf(stderr, "\n");
+    s_failures++;
+}
+
+static void fixed_cases(void)
+{
+    const synth_opts_t plain = {.jitter_us = 5, .stretch_bit = -1};
+    capture_t c;
+    uint8_t raw[5];
+
+    // DHT11: integer bytes with a tenths digit, sign in bit 7 of byte 3
+    make_frame(raw, 55, 0, 23, 4);
+    synth(&c, raw, &plain);
+    expect("dht11 23.4C 55%", &c, DHT_MODEL_DHT11, DHT_DECODE_OK, 234, 550);
+    make_frame(raw, 90, 0, 2, 0x80 | 5);
+    synth(&c, raw, &plain);
+    expect("dht11 -2.5C 90%", &c, DHT_MODEL_DHT11, DHT_DECODE_OK, -25, 900);
+
+    // DHT22: 16-bit tenths, sign in bit 15 of the temperature
+    make_frame(raw, 0x02, 0x8C, 0x00, 0xFB);
+    synth(&c, raw, &plain);
+    expect("dht22 25.1C 65.2%", &c, DHT_MODEL_DHT22, DHT_DECODE_OK, 251, 652);
+    make_frame(raw, 0x03, 0xE8, 0x80, 0x65);
+    synth(&c, raw, &plain);
+    expect("dht22 -10.1C 100.0%", &c, DHT_MODEL_DHT22, DHT_DECODE_OK, -101, 1000);
+    make_frame(raw, 0, 0, 0, 0);
+    synth(&c, raw, &plain);
+    expect("dht22 all zero", &c, DHT_MODEL_DHT22, DHT_DECODE_OK, 0, 0);
+
+    // Checksum: each bit of the checksum byte, then a data bit
+    make_frame(raw, 0x02, 0x8C, 0x00, 0xFB);
+    for (int b = 0; b < 8; b++)
+    {
+        uint8_t bad[5];
+        memcpy(bad, raw, 5);
+        bad[4] ^= (uint8_t)(1u << b);
+        synth(&c, bad, &plain);
+        expect("checksum bit", &c, DHT_MODEL_DHT22, DHT_DECODE_CHECKSUM, 0, 0);
+    }
+    {
+        uint8_t bad[5];
+        memcpy(bad, raw, 5);
+        bad[1] ^= 0x10;
+        synth(&c, bad, &plain);
+        expect("data bit flipped", &c, DHT_MODEL_DHT11, DHT_DECODE_CHECKSUM, 0, 0);
+
+        dht_reading_t r;
+        uint8_t got[5] = {0};
+        if (dht_decode_spans(c.s, c.n, DHT_MODEL_DHT22, &r, got) != DHT_DECODE_CHECKSUM || memcmp(got, bad, 5))
+        {
+            fprintf(stderr, "FAIL raw bytes not reported on checksum error\n");
+            s_failures++;
+        }
+    }
+
+    // Capture shapes
+    make_frame(raw, 0x01, 0xC2, 0x00, 0xD7); // 45.0%, 21.5 C
+    synth_opts_t o = plain;
+    o.skip_preamble = true;
+    synth(&c, raw, &o);
+    expect("no preamble", &c, DHT_MODEL_DHT22, DHT_DECODE_OK, 215, 450);
+    o = plain;
+    o.split_spans = true;
+    synth(&c, raw, &o);
+    expect("split spans", &c, DHT_MODEL_DHT22, DHT_DECODE_OK, 215, 450);
+    o = plain;
+    o.drop_last_bits = 3;
+    synth(&c, raw, &o);
+    expect("3 bits short", &c, DHT_MODEL_DHT22, DHT_DECODE_SHORT, 0, 0);
+    o.skip_preamble = true;
+    o.drop_last_bits = 1;
+    synth(&c, raw, &o);
+    expect("1 bit short, no preamble", &c, DHT_MODEL_DHT22, DHT_DECODE_SHORT, 0, 0);
+    o = plain;
+    o.stretch_bit = 17;
+    synth(&c, raw, &o);
+    expect("stretched high", &c, DHT_MODEL_DHT22, DHT_DECODE_BAD_TIMING, 0, 0);
+
+    c.n = 0;
+    expect("empty", &c, DHT_MODEL_DHT22, DHT_DECODE_NO_RESPONSE, 0, 0);
+    c.s[0] = (dht_span_t){.us = 4, .level = 0};
+    c.s[1] = (dht_span_t){.us = 30, .level = 1};
+    c.n = 2;
+    expect("line released, no answer", &c, DHT_MODEL_DHT22, DHT_DECODE_NO_RESPONSE, 0, 0);
+
+    // A trailing high of any length (idle before the capture timed out)
+    synth(&c, raw, &plain);
+    c.s[c.n++] = (dht_span_t){.us = 5000, .level = 1};
+    expect("trailing idle high", &c, DHT_MODEL_DHT22, DHT_DECODE_OK, 215, 450);
+}
+
+static int random_cases(int frames)
+{
+    const synth_opts_t o = {.jitter_us = 12, .stretch_bit = -1};
+    capture_t c;
+    for (int i = 0; i < frames; i++)
+    {
+        uint8_t raw[5];
+        make_frame(raw, (uint8_t)rand(), (uint8_t)rand(), (uint8_t)rand(), (uint8_t)rand());
+        const dht_model_t model = (i & 1) ? DHT_MODEL_DHT22 : DHT_MODEL_DHT11;
+        dht_reading_t want;
+        if (dht_decode_bytes(raw, model, &want) != DHT_DECODE_OK)
+        {
+            fprintf(stderr, "FAIL dht_decode_bytes rejected a valid frame\n");
+            s_failures++;
+            continue;
+        }
+        synth(&c, raw, &o);
+        expect("random frame", &c, model, DHT_DECODE_OK, want.temp_dc, want.hum_dpct);
+        if (s_failures)
+            break;
+    }
+    return frames;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 10000;
+    unsigned seed = (unsigned)time(NULL);
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned)strtoul(argv[++i], NULL, 0);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n FRAMES] [-s SEED]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    fixed_cases();
+    const int fixed = s_cases;
+    const int random = s_failures ? 0 : random_cases(frames);
+    if (s_failures)
+    {
+        fprintf(stderr, "%d failure(s), seed %u\n", s_failures, seed);
+        return 1;
+    }
+    printf("dht_decode: %d fixed cases, %d random frames (seed %u) OK\n", fixed, random, seed);
+    return 0;
+}
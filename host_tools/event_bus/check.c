@@ -0,0 +1,437 @@
+// event_bus_check: host checks of the event bus's queue policies and
+// subscriber stats (firmware/esp_idf_shared_components/event_bus/src/event_bus.c).
+//
+//   event_bus_check [-n ROUNDS] [-s SEED]
+//
+// Runs on one thread against the FreeRTOS stand-ins of mock_rtos.c, with a
+// clock the check sets. Fixed cases first: calls before event_bus_init()
+// and bad arguments are refused without counting a publish, a full queue
+// keeps its backlog under DROP_NEWEST and the latest events under
+// OVERWRITE_OLDEST (the seq gaps telling the subscriber what it missed),
+// topics reach only their subscribers, high_water is the fullest the queue
+// was at a publish, and the latency min/avg/max are those of the events
+// taken, not of the ones dropped or overwritten. Then ROUNDS (20000) random
+// mixes of subscribers, publishes, receives and time against a model of
+// the queues, comparing every event taken and every stat. No queue or
+// mutex may leak. Exits non-zero on failure.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "event_bus.h"
+#include "mock_rtos.h"
+
+#define SUBS_MAX 4
+#define DEPTH_MAX 8
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        if (!(cond))                                                                                              \
+        {                                                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                                                  \
+            fprintf(stderr, __VA_ARGS__);                                                                         \
+            fputc('\n', stderr);                                                                                  \
+            s_failures++;                                                                                         \
+            return;                                                                                               \
+        }                                                                                                         \
+    } while (0)
+
+static event_bus_sub_handle_t subscribe(uint32_t topics, size_t depth, event_bus_policy_t policy)
+{
+    const event_bus_sub_config_t cfg = {.name = "check", .topics = topics, .depth = depth, .policy = policy};
+    event_bus_sub_handle_t sub = NULL;
+    return event_bus_subscribe(&cfg, &sub) == ESP_OK ? sub : NULL;
+}
+
+static esp_err_t publish_climate(int32_t temp_dc)
+{
+    const event_climate_t c = {.temp_dc = temp_dc, .hum_dpct = 500, .sample_us = esp_timer_get_time()};
+    return event_bus_publish_climate(&c);
+}
+
+static esp_err_t publish_error(int32_t err)
+{
+    const event_sensor_error_t e = {.err = err, .fail_count = 1};
+    return event_bus_publish(EVENT_TOPIC_SENSOR_ERROR, &e, sizeof(e));
+}
+
+static event_bus_sub_stats_t stats_of(event_bus_sub_handle_t sub)
+{
+    event_bus_sub_stats_t st;
+    memset(&st, 0xA5, sizeof(st));
+    event_bus_get_stats(sub, &st);
+    return st;
+}
+
+/*========== Fixed cases ==========*/
+static void check_before_init(void)
+{
+    s_cases++;
+    const event_bus_sub_config_t cfg = {.name = "early", .topics = EVENT_TOPIC_ALL, .depth = 4};
+    event_bus_sub_handle_t sub = NULL;
+    CHECK(event_bus_subscribe(&cfg, &sub) == ESP_ERR_INVALID_STATE && !sub, "subscribed before init");
+    CHECK(publish_climate(1) == ESP_ERR_INVALID_STATE, "published before init");
+    CHECK(event_bus_published(EVENT_TOPIC_CLIMATE) == 0, "publish counted before init");
+    event_bus_sub_stats_t st;
+    CHECK(event_bus_get_stats(NULL, &st) == ESP_ERR_INVALID_ARG, "stats of no subscriber");
+    event_bus_log_stats();
+}
+
+static void check_args(void)
+{
+    s_cases++;
+    CHECK(event_bus_init() == ESP_OK && event_bus_init() == ESP_OK, "init");
+    mock_rtos_state_t ms;
+    mock_rtos_state(&ms);
+    CHECK(ms.mutexes == 1, "%d mutexes after two inits", ms.mutexes);
+
+    event_bus_sub_handle_t sub = NULL;
+    event_bus_sub_config_t cfg = {.name = "bad", .topics = EVENT_TOPIC_ALL, .depth = 0};
+    CHECK(event_bus_subscribe(&cfg, &sub) == ESP_ERR_INVALID_ARG, "depth 0 accepted");
+    cfg.depth = 4;
+    cfg.topics = EVENT_TOPIC_BIT(EVENT_TOPIC_COUNT);
+    CHECK(event_bus_subscribe(&cfg, &sub) == ESP_ERR_INVALID_ARG, "unknown topics only accepted");
+    cfg.topics = EVENT_TOPIC_ALL;
+    CHECK(event_bus_subscribe(&cfg, NULL) == ESP_ERR_INVALID_ARG, "no handle out accepted");
+    CHECK(event_bus_subscribe(NULL, &sub) == ESP_ERR_INVALID_ARG, "no config accepted");
+    mock_rtos_fail_next_queue();
+    CHECK(event_bus_subscribe(&cfg, &sub) == ESP_ERR_NO_MEM && !sub, "queue allocation failure");
+
+    const uint32_t before = event_bus_published(EVENT_TOPIC_CLIMATE);
+    const event_climate_t c = {0};
+    CHECK(event_bus_publish(EVENT_TOPIC_COUNT, &c, sizeof(c)) == ESP_ERR_INVALID_ARG, "unknown topic published");
+    CHECK(event_bus_publish(EVENT_TOPIC_CLIMATE, &c, sizeof(c) - 1) == ESP_ERR_INVALID_ARG, "short payload published");
+    CHECK(event_bus_publish(EVENT_TOPIC_SENSOR_ERROR, &c, sizeof(c)) == ESP_ERR_INVALID_ARG,
+          "payload of another topic published");
+    CHECK(event_bus_publish(EVENT_TOPIC_CLIMATE, NULL, sizeof(c)) == ESP_ERR_INVALID_ARG, "no payload published");
+    CHECK(event_bus_published(EVENT_TOPIC_CLIMATE) == before, "refused publish counted");
+    CHECK(event_bus_published(EVENT_TOPIC_COUNT) == 0, "count of an unknown topic");
+
+    int other;
+    CHECK(event_bus_unsubscribe((event_bus_sub_handle_t)(void *)&other) == ESP_ERR_NOT_FOUND, "unknown handle");
+    CHECK(event_bus_unsubscribe(NULL) == ESP_ERR_INVALID_ARG, "NULL handle");
+    event_bus_msg_t msg;
+    CHECK(event_bus_receive(NULL, &msg, 0) == ESP_ERR_INVALID_ARG, "receive without a subscriber");
+    mock_rtos_state(&ms);
+    CHECK(ms.queues == 0 && ms.errors == 0, "%d queues, %d errors", ms.queues, ms.errors);
+}
+
+// A slow subscriber of depth 4 misses 6 of 10 events
+static void check_policy(event_bus_policy_t policy)
+{
+    s_cases++;
+    const bool overwrite = policy == EVENT_BUS_OVERWRITE_OLDEST;
+    event_bus_sub_handle_t sub = subscribe(EVENT_TOPIC_BIT(EVENT_TOPIC_CLIMATE), 4, policy);
+    CHECK(sub, "subscribe");
+    const uint32_t seq0 = event_bus_published(EVENT_TOPIC_CLIMATE);
+    for (int i = 0; i < 10; i++)
+        CHECK(publish_climate(i) == ESP_OK, "publish %d", i);
+    CHECK(event_bus_published(EVENT_TOPIC_CLIMATE) == seq0 + 10, "published count");
+
+    event_bus_sub_stats_t st = stats_of(sub);
+    CHECK(st.dropped == (overwrite ? 0u : 6u) && st.overwritten == (overwrite ? 6u : 0u), "dropped %u, overwritten %u",
+          st.dropped, st.overwritten);
+    CHECK(st.high_water == 4 && st.delivered == 0, "high water %u, delivered %u", st.high_water, st.delivered);
+
+    // DROP_NEWEST keeps 0..3, OVERWRITE_OLDEST 6..9
+    const int first = overwrite ? 6 : 0;
+    for (int i = 0; i < 4; i++)
+    {
+        event_bus_msg_t msg;
+        CHECK(event_bus_receive(sub, &msg, 0) == ESP_OK, "receive %d", i);
+        CHECK(msg.topic == EVENT_TOPIC_CLIMATE && msg.data.climate.temp_dc == first + i, "event %d: temp %d", i,
+              (int)msg.data.climate.temp_dc);
+        CHECK(msg.seq == seq0 + 1 + (uint32_t)(first + i), "event %d: seq %u", i, msg.seq);
+    }
+    event_bus_msg_t msg;
+    CHECK(event_bus_receive(sub, &msg, 0) == ESP_ERR_TIMEOUT, "more than the queue held");
+
+    // The next one tells a DROP_NEWEST subscriber what it missed
+    CHECK(publish_climate(10) == ESP_OK && event_bus_receive(sub, &msg, 0) == ESP_OK, "publish after the drain");
+    const uint32_t missed = msg.seq - (seq0 + (uint32_t)first + 4) - 1;
+    CHECK(missed == (overwrite ? 0u : 6u), "gap of %u", missed);
+    st = stats_of(sub);
+    CHECK(st.delivered == 5 && st.dropped + st.overwritten == 6 && st.high_water == 4, "stats after the drain");
+
+    CHECK(event_bus_unsubscribe(sub) == ESP_OK, "unsubscribe");
+    mock_rtos_state_t ms;
+    mock_rtos_state(&ms);
+    CHECK(ms.queues == 0 && ms.errors == 0, "%d queues, %d errors", ms.queues, ms.errors);
+}
+
+// Subscribers of both policies and of other topics see the same publishes
+static void check_topics(void)
+{
+    s_cases++;
+    event_bus_sub_handle_t climate = subscribe(EVENT_TOPIC_BIT(EVENT_TOPIC_CLIMATE), 2, EVENT_BUS_DROP_NEWEST);
+    event_bus_sub_handle_t errors = subscribe(EVENT_TOPIC_BIT(EVENT_TOPIC_SENSOR_ERROR), 2, EVENT_BUS_DROP_NEWEST);
+    event_bus_sub_handle_t all = subscribe(EVENT_TOPIC_ALL | (1u << 31), 3, EVENT_BUS_OVERWRITE_OLDEST);
+    CHECK(climate && errors && all, "subscribe");
+    const uint32_t c0 = event_bus_published(EVENT_TOPIC_CLIMATE), e0 = event_bus_published(EVENT_TOPIC_SENSOR_ERROR);
+
+    CHECK(publish_climate(21) == ESP_OK && publish_error(-1) == ESP_OK && publish_climate(22) == ESP_OK &&
+              publish_error(-2) == ESP_OK,
+          "publish");
+    event_bus_sub_stats_t st = stats_of(climate);
+    CHECK(st.high_water == 2 && st.dropped == 0, "climate: high water %u", st.high_water);
+    st = stats_of(errors);
+    CHECK(st.high_water == 2 && st.dropped == 0, "errors: high water %u", st.high_water);
+    st = stats_of(all);
+    CHECK(st.high_water == 3 && st.overwritten == 1, "all: high water %u, overwritten %u", st.high_water,
+          st.overwritten);
+
+    event_bus_msg_t msg;
+    CHECK(event_bus_receive(errors, &msg, 0) == ESP_OK && msg.topic == EVENT_TOPIC_SENSOR_ERROR &&
+              msg.data.sensor_error.err == -1 && msg.seq == e0 + 1,
+          "errors: first event");
+    CHECK(event_bus_receive(climate, &msg, 0) == ESP_OK && msg.topic == EVENT_TOPIC_CLIMATE &&
+              msg.data.climate.temp_dc == 21 && msg.seq == c0 + 1,
+          "climate: first event");
+    // Seqs count per topic: the overwritten climate 21 shows as a gap of one
+    CHECK(event_bus_receive(all, &msg, 0) == ESP_OK && msg.topic == EVENT_TOPIC_SENSOR_ERROR && msg.seq == e0 + 1,
+          "all: first event");
+    CHECK(event_bus_receive(all, &msg, 0) == ESP_OK && msg.topic == EVENT_TOPIC_CLIMATE && msg.seq == c0 + 2,
+          "all: second event");
+
+    CHECK(event_bus_unsubscribe(climate) == ESP_OK && event_bus_unsubscribe(all) == ESP_OK, "unsubscribe");
+    CHECK(publish_climate(23) == ESP_OK && publish_error(-3) == ESP_OK && publish_error(-4) == ESP_OK,
+          "publish after unsubscribing");
+    st = stats_of(errors);
+    CHECK(st.dropped == 1 && st.high_water == 2, "errors: dropped %u", st.dropped);
+    CHECK(event_bus_unsubscribe(errors) == ESP_OK && event_bus_unsubscribe(errors) != ESP_OK, "unsubscribe");
+    mock_rtos_state_t ms;
+    mock_rtos_state(&ms);
+    CHECK(ms.queues == 0 && ms.errors == 0, "%d queues, %d errors", ms.queues, ms.errors);
+}
+
+// Latencies of the events taken only, and a fill that goes up and down
+static void check_latency(void)
+{
+    s_cases++;
+    mock_rtos_set_time(1000000);
+    event_bus_sub_handle_t sub = subscribe(EVENT_TOPIC_ALL, 3, EVENT_BUS_OVERWRITE_OLDEST);
+    CHECK(sub, "subscribe");
+    event_bus_sub_stats_t st = stats_of(sub);
+    CHECK(st.delivered == 0 && st.latency_min_us == 0 && st.latency_max_us == 0 && st.latency_avg_us == 0,
+          "stats before any event: min %u", st.latency_min_us);
+
+    event_bus_msg_t msg;
+    CHECK(publish_climate(1) == ESP_OK, "publish");
+    mock_rtos_advance(250);
+    CHECK(event_bus_receive(sub, &msg, 0) == ESP_OK && msg.publish_us == 1000000, "first event");
+    // 2 a millisecond before 3, 4 and 5, which overwrites it
+    mock_rtos_advance(1000);
+    CHECK(publish_climate(2) == ESP_OK, "publish");
+    mock_rtos_advance(1000);
+    CHECK(publish_error(3) == ESP_OK && publish_climate(4) == ESP_OK && publish_climate(5) == ESP_OK, "publish");
+    st = stats_of(sub);
+    CHECK(st.overwritten == 1 && st.high_water == 3, "overwritten %u, high water %u", st.overwritten,
+          st.high_water);
+    mock_rtos_advance(4000);
+    for (int i = 0; i < 3; i++)
+        CHECK(event_bus_receive(sub, &msg, 0) == ESP_OK, "receive %d", i);
+    // A wait with nothing queued passes time without an event
+    CHECK(event_bus_receive(sub, &msg, pdMS_TO_TICKS(20)) == ESP_ERR_TIMEOUT, "receive from an empty queue");
+    CHECK(esp_timer_get_time() == 1000000 + 250 + 2000 + 4000 + 20000, "timeout did not pass time");
+
+    st = stats_of(sub);
+    CHECK(st.delivered == 4 && st.overwritten == 1 && st.dropped == 0, "delivered %u", st.delivered);
+    CHECK(st.latency_min_us == 250 && st.latency_max_us == 4000, "latency %u..%u", st.latency_min_us,
+          st.latency_max_us);
+    CHECK(st.latency_avg_us == (250 + 4000 * 3) / 4, "latency avg %u", st.latency_avg_us);
+    CHECK(event_bus_unsubscribe(sub) == ESP_OK, "unsubscribe");
+}
+
+/*========== Random mixes ==========*/
+typedef struct
+{
+    event_bus_msg_t q[DEPTH_MAX];
+    size_t head, n, depth;
+    event_bus_policy_t policy;
+    uint32_t topics;
+    event_bus_sub_stats_t st;
+    uint64_t latency_sum_us;
+} model_sub_t;
+
+static uint32_t s_rng;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void model_publish(model_sub_t *m, const event_bus_msg_t *msg)
+{
+    if (!(m->topics & EVENT_TOPIC_BIT(msg->topic)))
+        return;
+    if (m->n == m->depth)
+    {
+        if (m->policy == EVENT_BUS_DROP_NEWEST)
+        {
+            m->st.dropped++;
+            return;
+        }
+        m->head = (m->head + 1) % m->depth;
+        m->n--;
+        m->st.overwritten++;
+    }
+    m->q[(m->head + m->n) % m->depth] = *msg;
+    m->n++;
+    if (m->n > m->st.high_water)
+        m->st.high_water = (uint32_t)m->n;
+}
+
+static void random_round(int round)
+{
+    s_cases++;
+    const int n_subs = 1 + (int)(rnd() % SUBS_MAX);
+    event_bus_sub_handle_t subs[SUBS_MAX];
+    model_sub_t model[SUBS_MAX];
+    uint32_t published[EVENT_TOPIC_COUNT];
+    for (int t = 0; t < EVENT_TOPIC_COUNT; t++)
+        published[t] = event_bus_published((event_topic_t)t);
+    for (int i = 0; i < n_subs; i++)
+    {
+        model_sub_t *m = &model[i];
+        memset(m, 0, sizeof(*m));
+        m->depth = 1 + rnd() % DEPTH_MAX;
+        m->policy = rnd() & 1 ? EVENT_BUS_OVERWRITE_OLDEST : EVENT_BUS_DROP_NEWEST;
+        m->topics = 1 + rnd() % EVENT_TOPIC_ALL;
+        m->st.latency_min_us = UINT32_MAX;
+        subs[i] = subscribe(m->topics, m->depth, m->policy);
+        CHECK(subs[i], "round %d: subscribe %d", round, i);
+    }
+
+    // Bursts of publishes against slow and fast subscribers
+    const uint32_t publish_odds = 1 + rnd() % 4;
+    for (int step = 0; step < 300; step++)
+    {
+        const uint32_t r = rnd() % 8;
+        if (r < publish_odds)
+        {
+            event_bus_msg_t msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.topic = rnd() % 3 ? EVENT_TOPIC_CLIMATE : EVENT_TOPIC_SENSOR_ERROR;
+            msg.seq = ++published[msg.topic];
+            msg.publish_us = esp_timer_get_time();
+            if (msg.topic == EVENT_TOPIC_CLIMATE)
+            {
+                msg.data.climate = (event_climate_t){
+                    .temp_dc = (int32_t)(rnd() % 800) - 200, .hum_dpct = (int32_t)(rnd() % 1000), .sample_us = step};
+                CHECK(event_bus_publish_climate(&msg.data.climate) == ESP_OK, "round %d: publish", round);
+            }
+            else
+            {
+                msg.data.sensor_error = (event_sensor_error_t){.err = (int32_t)rnd(), .fail_count = 1};
+                CHECK(publish_error(msg.data.sensor_error.err) == ESP_OK, "round %d: publish", round);
+            }
+            for (int i = 0; i < n_subs; i++)
+                model_publish(&model[i], &msg);
+        }
+        else if (r < 7)
+        {
+            const int i = (int)(rnd() % (uint32_t)n_subs);
+            model_sub_t *m = &model[i];
+            const TickType_t wait = rnd() % 4 == 0 ? (TickType_t)(rnd() % 3) : 0;
+            event_bus_msg_t msg;
+            const esp_err_t err = event_bus_receive(subs[i], &msg, wait);
+            if (!m->n)
+            {
+                CHECK(err == ESP_ERR_TIMEOUT, "round %d, step %d: event from an empty queue", round, step);
+                continue;
+            }
+            CHECK(err == ESP_OK, "round %d, step %d: no event, %zu queued", round, step, m->n);
+            const event_bus_msg_t *want = &m->q[m->head];
+            CHECK(msg.topic == want->topic && msg.seq == want->seq && msg.publish_us == want->publish_us &&
+                      !memcmp(&msg.data, &want->data, sizeof(msg.data)),
+                  "round %d, step %d: got topic %d seq %u, want topic %d seq %u", round, step, msg.topic, msg.seq,
+                  want->topic, want->seq);
+            m->head = (m->head + 1) % m->depth;
+            m->n--;
+            const uint32_t latency = (uint32_t)(esp_timer_get_time() - msg.publish_us);
+            m->st.delivered++;
+            m->latency_sum_us += latency;
+            if (latency < m->st.latency_min_us)
+                m->st.latency_min_us = latency;
+            if (latency > m->st.latency_max_us)
+                m->st.latency_max_us = latency;
+        }
+        else
+        {
+            mock_rtos_advance((int64_t)(rnd() % 5000));
+        }
+    }
+
+    for (int i = 0; i < n_subs; i++)
+    {
+        const model_sub_t *m = &model[i];
+        const event_bus_sub_stats_t st = stats_of(subs[i]);
+        const uint32_t avg = m->st.delivered ? (uint32_t)(m->latency_sum_us / m->st.delivered) : 0;
+        const uint32_t min = m->st.delivered ? m->st.latency_min_us : 0;
+        CHECK(st.delivered == m->st.delivered && st.dropped == m->st.dropped && st.overwritten == m->st.overwritten,
+              "round %d, sub %d: delivered/dropped/overwritten %u/%u/%u, want %u/%u/%u", round, i, st.delivered,
+              st.dropped, st.overwritten, m->st.delivered, m->st.dropped, m->st.overwritten);
+        CHECK(st.high_water == m->st.high_water, "round %d, sub %d: high water %u, want %u", round, i, st.high_water,
+              m->st.high_water);
+        CHECK(st.latency_min_us == min && st.latency_max_us == m->st.latency_max_us && st.latency_avg_us == avg,
+              "round %d, sub %d: latency %u/%u/%u, want %u/%u/%u", round, i, st.latency_min_us, st.latency_avg_us,
+              st.latency_max_us, min, avg, m->st.latency_max_us);
+        CHECK(m->policy == EVENT_BUS_DROP_NEWEST ? !st.overwritten : !st.dropped, "round %d, sub %d: policy mixed up",
+              round, i);
+        CHECK(event_bus_unsubscribe(subs[i]) == ESP_OK, "round %d: unsubscribe %d", round, i);
+    }
+    for (int t = 0; t < EVENT_TOPIC_COUNT; t++)
+        CHECK(event_bus_published((event_topic_t)t) == published[t], "round %d: topic %d published %u, want %u", round,
+              t, event_bus_published((event_topic_t)t), published[t]);
+    mock_rtos_state_t ms;
+    mock_rtos_state(&ms);
+    CHECK(ms.queues == 0 && ms.errors == 0, "round %d: %d queues, %d errors", round, ms.queues, ms.errors);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = 20000;
+    s_rng = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            s_rng = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n ROUNDS] [-s SEED]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!s_rng)
+        s_rng = 1;
+
+    check_before_init();
+    check_args();
+    check_policy(EVENT_BUS_DROP_NEWEST);
+    check_policy(EVENT_BUS_OVERWRITE_OLDEST);
+    check_topics();
+    check_latency();
+    for (int i = 0; i < rounds && !s_failures; i++)
+        random_round(i);
+
+    if (s_failures)
+    {
+        fprintf(stderr, "%d of %d cases failed\n", s_failures, s_cases);
+        return 1;
+    }
+    printf("event_bus_check: %d cases passed\n", s_cases);
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <stdio.h>
+// Silent: the check looks at the stats, not the log. The arguments are
+// still checked against the format, never evaluated
+#define MOCK_LOG(tag, fmt, ...) ((void)(tag), (void)sizeof(printf(fmt, ##__VA_ARGS__)))
+#define ESP_LOGE(tag, fmt, ...) MOCK_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) MOCK_LOG(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) MOCK_LOG(tag, fmt, ##__VA_ARGS__)
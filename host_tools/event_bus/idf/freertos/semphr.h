@@ -0,0 +1,9 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef struct mock_mutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t m);
+void vSemaphoreDelete(SemaphoreHandle_t m);
@@ -0,0 +1,2 @@
+#pragma once
+// event_bus reads no Kconfig; the target is the chip, time comes from esp_timer
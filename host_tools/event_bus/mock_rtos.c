@@ -0,0 +1,191 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "mock_rtos.h"
+
+#define MOCK_MAGIC 0x51554555u
+#define MOCK_DEAD 0xDEADDEADu
+
+static int64_t s_now_us = 0;
+static bool s_fail_queue = false;
+static mock_rtos_state_t s_state;
+
+static void violation(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "mock_rtos: ");
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+    s_state.errors++;
+}
+
+/*========== Time ==========*/
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+void mock_rtos_set_time(int64_t now_us)
+{
+    s_now_us = now_us;
+}
+
+void mock_rtos_advance(int64_t us)
+{
+    s_now_us += us;
+}
+
+/*========== Queues ==========*/
+// Deleted queues stay behind, marked, so a use after delete is caught
+struct mock_queue
+{
+    uint32_t magic;
+    uint8_t *items;
+    UBaseType_t len, size, head, n;
+};
+
+static bool queue_alive(QueueHandle_t q, const char *what)
+{
+    if (q && q->magic == MOCK_MAGIC)
+        return true;
+    violation("%s on a %s queue", what, q ? "deleted" : "NULL");
+    return false;
+}
+
+void mock_rtos_fail_next_queue(void)
+{
+    s_fail_queue = true;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    if (s_fail_queue || !length || !item_size)
+    {
+        s_fail_queue = false;
+        return NULL;
+    }
+    struct mock_queue *q = calloc(1, sizeof(*q));
+    q->magic = MOCK_MAGIC;
+    q->items = calloc(length, item_size);
+    q->len = length;
+    q->size = item_size;
+    s_state.queues++;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    if (!queue_alive(q, "xQueueSend"))
+        return pdFAIL;
+    if (q->n == q->len)
+    {
+        if (ticks == portMAX_DELAY)
+            violation("xQueueSend waits forever on a full queue");
+        else
+            s_now_us += (int64_t)ticks * 1000;
+        return pdFAIL;
+    }
+    memcpy(q->items + ((q->head + q->n) % q->len) * q->size, item, q->size);
+    q->n++;
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    if (!queue_alive(q, "xQueueReceive"))
+        return pdFAIL;
+    if (q->n == 0)
+    {
+        if (ticks == portMAX_DELAY)
+            violation("xQueueReceive waits forever on an empty queue");
+        else
+            s_now_us += (int64_t)ticks * 1000;
+        return pdFAIL;
+    }
+    memcpy(item, q->items + q->head * q->size, q->size);
+    q->head = (q->head + 1) % q->len;
+    q->n--;
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    return queue_alive(q, "uxQueueMessagesWaiting") ? q->n : 0;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!queue_alive(q, "vQueueDelete"))
+        return;
+    free(q->items);
+    q->items = NULL;
+    q->magic = MOCK_DEAD;
+    s_state.queues--;
+}
+
+/*========== Mutexes ==========*/
+struct mock_mutex
+{
+    uint32_t magic;
+    bool held;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct mock_mutex *m = calloc(1, sizeof(*m));
+    m->magic = MOCK_MAGIC;
+    s_state.mutexes++;
+    return m;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t ticks)
+{
+    if (!m || m->magic != MOCK_MAGIC)
+    {
+        violation("xSemaphoreTake on a %s mutex", m ? "deleted" : "NULL");
+        return pdFAIL;
+    }
+    if (m->held)
+    {
+        // No other task could give it back
+        if (ticks == portMAX_DELAY)
+            violation("xSemaphoreTake of a mutex the caller holds");
+        return pdFAIL;
+    }
+    m->held = true;
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t m)
+{
+    if (!m || m->magic != MOCK_MAGIC || !m->held)
+    {
+        violation("xSemaphoreGive of a mutex not held");
+        return pdFAIL;
+    }
+    m->held = false;
+    return pdPASS;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t m)
+{
+    if (!m || m->magic != MOCK_MAGIC)
+    {
+        violation("vSemaphoreDelete on a %s mutex", m ? "deleted" : "NULL");
+        return;
+    }
+    m->magic = MOCK_DEAD;
+    s_state.mutexes--;
+}
+
+void mock_rtos_state(mock_rtos_state_t *out)
+{
+    *out = s_state;
+}
@@ -0,0 +1,23 @@
+#pragma once
+// Host stand-ins for the FreeRTOS queues and mutexes and the esp_timer
+// clock that event_bus uses (idf/ has the headers). One thread: a receive
+// that would wait lets the clock run for its timeout instead, a wait
+// forever on an empty queue or a mutex already held counts as an error.
+// Queues and mutexes are counted, so a leak or a use after delete shows.
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    int queues;  // live
+    int mutexes; // live
+    int errors;  // misuse, each also logged
+} mock_rtos_state_t;
+
+void mock_rtos_set_time(int64_t now_us);
+void mock_rtos_advance(int64_t us);
+
+// The next xQueueCreate() returns NULL, as on a full heap
+void mock_rtos_fail_next_queue(void);
+
+void mock_rtos_state(mock_rtos_state_t *out);
@@ -0,0 +1,291 @@
+// form_urlenc_fuzz: the streaming form parser of the provisioning portal
+// (firmware/esp_idf_shared_components/wifi_prov_http/src/form_urlenc.c)
+// against a whole-body reference.
+//
+//   form_urlenc_fuzz [-n BODIES] [-s SEED]
+//
+// Generates BODIES (200000) bodies from pieces that hit the edges: wanted
+// and unwanted names, names spelled with %XX or '+', repeats, pairs
+// without '=', empty pairs, valid, broken and trailing escapes, %00,
+// values longer than their buffer, names longer than FORM_URLENC_KEY_MAX,
+// and runs of random bytes. The reference splits the whole body at '&'
+// and '=' and decodes each part; the parser gets the body in one piece,
+// byte by byte and in random splits. Exits non-zero on the first
+// difference, printing the body.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "form_urlenc.h"
+
+#define MAX_BODY 1024
+
+typedef struct
+{
+    const char *key;
+    size_t out_size;
+} field_spec_t;
+
+static const field_spec_t s_specs[] = {
+    {"ssid", 33}, {"pass", 65}, {"k", 4}, {"a b", 8}, {"", 6}, {"a=b", 8},
+};
+#define N_FIELDS (sizeof(s_specs) / sizeof(s_specs[0]))
+
+typedef struct
+{
+    bool seen, truncated;
+    size_t len;
+    char out[MAX_BODY];
+} ref_field_t;
+
+static uint64_t s_rng;
+
+static uint32_t rnd(uint32_t n)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)(s_rng % n);
+}
+
+/*========== Reference ==========*/
+static int hexval(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static size_t ref_decode(const char *s, size_t n, char *out)
+{
+    size_t o = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (s[i] == '%' && i + 2 < n && hexval(s[i + 1]) >= 0 && hexval(s[i + 2]) >= 0)
+        {
+            out[o++] = (char)(hexval(s[i + 1]) << 4 | hexval(s[i + 2]));
+            i += 2;
+        }
+        else
+        {
+            out[o++] = s[i] == '+' ? ' ' : s[i];
+        }
+    }
+    return o;
+}
+
+static void ref_parse(const char *body, size_t len, ref_field_t *f)
+{
+    memset(f, 0, N_FIELDS * sizeof(*f));
+    char name[MAX_BODY], value[MAX_BODY];
+    for (size_t pos = 0; pos <= len;)
+    {
+        const char *amp = memchr(body + pos, '&', len - pos);
+        const size_t end = amp ? (size_t)(amp - body) : len;
+        if (end > pos)
+        {
+            const char *eq = memchr(body + pos, '=', end - pos);
+            const size_t name_end = eq ? (size_t)(eq - body) : end;
+            const size_t name_len = ref_decode(body + pos, name_end - pos, name);
+            const size_t value_len = eq ? ref_decode(eq + 1, end - name_end - 1, value) : 0;
+            for (size_t i = 0; i < N_FIELDS; i++)
+            {
+                if (f[i].seen || strlen(s_specs[i].key) != name_len || memcmp(s_specs[i].key, name, name_len))
+                    continue;
+                f[i].seen = true;
+                f[i].len = value_len < s_specs[i].out_size - 1 ? value_len : s_specs[i].out_size - 1;
+                f[i].truncated = value_len > f[i].len;
+                memcpy(f[i].out, value, f[i].len);
+                break;
+            }
+        }
+        pos = end + 1;
+    }
+}
+
+/*========== Bodies ==========*/
+static size_t append(char *body, size_t len, const char *s)
+{
+    const size_t n = strlen(s);
+    if (len + n > MAX_BODY)
+        return len;
+    memcpy(body + len, s, n);
+    return len + n;
+}
+
+static size_t gen_name(char *body, size_t len)
+{
+    static const char *const names[] = {"ssid", "pass",  "k",   "a+b", "a%20b", "ss%69d", "SSID", "x",
+                                        "",     "%",     "k%",  "a=b", "a%3Db", "%73sid", "pas",  "passs",
+                                        "k%4",  "%6B",   "%6b"};
+    if (rnd(20) == 0)
+    {
+        // Longer than FORM_URLENC_KEY_MAX, starting like a wanted name
+        char longname[FORM_URLENC_KEY_MAX + 16];
+        memset(longname, 'k', sizeof(longname) - 1);
+        longname[sizeof(longname) - 1 - rnd(20)] = 0;
+        return append(body, len, longname);
+    }
+    return append(body, len, names[rnd(sizeof(names) / sizeof(names[0]))]);
+}
+
+static size_t gen_value(char *body, size_t len)
+{
+    static const char *const pieces[] = {"a", "Z", "0", "+", "%41", "%4", "%", "%zz", "%00", "=", "%26",
+                                         "%3d", "%%", "%2", "%2B", "%e2%82%ac", "~", " "};
+    const uint32_t n = rnd(4) == 0 ? rnd(80) : rnd(8);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (rnd(10) == 0)
+        {
+            const char raw[2] = {(char)(1 + rnd(255)), 0};
+            len = append(body, len, raw);
+        }
+        else
+        {
+            len = append(body, len, pieces[rnd(sizeof(pieces) / sizeof(pieces[0]))]);
+        }
+    }
+    return len;
+}
+
+static size_t gen_body(char *body)
+{
+    size_t len = 0;
+    if (rnd(20) == 0)
+    {
+        // Noise over the parser's own alphabet, NULs included
+        static const char alphabet[] = "&=%+k0aF4\0 ";
+        const uint32_t n = rnd(200);
+        for (uint32_t i = 0; i < n; i++)
+            body[len++] = alphabet[rnd(sizeof(alphabet) - 1)];
+        return len;
+    }
+    const uint32_t pairs = rnd(9);
+    for (uint32_t i = 0; i < pairs; i++)
+    {
+        len = gen_name(body, len);
+        if (rnd(8))
+        {
+            len = append(body, len, "=");
+            len = gen_value(body, len);
+        }
+        if (i + 1 < pairs || rnd(4) == 0)
+            len = append(body, len, rnd(10) ? "&" : "&&");
+    }
+    return len;
+}
+
+/*========== Checks ==========*/
+static void print_body(const char *body, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        const unsigned char c = (unsigned char)body[i];
+        if (c >= 0x20 && c < 0x7F && c != '\\')
+            putchar(c);
+        else
+            printf("\\x%02x", c);
+    }
+    putchar('\n');
+}
+
+// Parses `body` split as `mode` says; 0 if it matches the reference
+static int check(const char *body, size_t len, const ref_field_t *ref, int mode)
+{
+    char outs[N_FIELDS][MAX_BODY];
+    form_urlenc_field_t fields[N_FIELDS];
+    for (size_t i = 0; i < N_FIELDS; i++)
+        fields[i] = (form_urlenc_field_t){.key = s_specs[i].key, .out = outs[i], .out_size = s_specs[i].out_size};
+    form_urlenc_t p;
+    form_urlenc_init(&p, fields, N_FIELDS);
+    for (size_t pos = 0; pos < len;)
+    {
+        size_t n = len - pos;
+        if (mode == 1)
+            n = 1;
+        else if (mode == 2)
+            n = 1 + rnd((uint32_t)n);
+        form_urlenc_feed(&p, body + pos, n);
+        pos += n;
+    }
+    form_urlenc_finish(&p);
+
+    for (size_t i = 0; i < N_FIELDS; i++)
+    {
+        const form_urlenc_field_t *f = &fields[i];
+        if (f->seen != ref[i].seen || f->truncated != ref[i].truncated || f->len != ref[i].len ||
+            memcmp(f->out, ref[i].out, f->len) || f->out[f->len] != 0)
+        {
+            static const char *const modes[] = {"in one piece", "byte by byte", "in random pieces"};
+            printf("FAIL: field \"%s\" fed %s: seen %d/%d truncated %d/%d len %zu/%zu\nbody: ", s_specs[i].key,
+                   modes[mode], f->seen, ref[i].seen, f->truncated, ref[i].truncated, f->len, ref[i].len);
+            print_body(body, len);
+            printf("got:  ");
+            print_body(f->out, f->len);
+            printf("want: ");
+            print_body(ref[i].out, ref[i].len);
+            return 1;
+        }
+    }
+    if (p.bytes != len)
+    {
+        printf("FAIL: %zu bytes counted of %zu\n", p.bytes, len);
+        return 1;
+    }
+    return 0;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n BODIES] [-s SEED]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long bodies = 200000;
+    unsigned long long seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_arg = i + 1 < argc;
+        if (!strcmp(argv[i], "-n") && has_arg)
+            bodies = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-s") && has_arg)
+            seed = strtoull(argv[++i], NULL, 10);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    s_rng = seed * 0x9E3779B97F4A7C15ull + 1;
+
+    char body[MAX_BODY];
+    ref_field_t ref[N_FIELDS];
+    unsigned long found = 0, truncated = 0;
+    for (unsigned long b = 0; b < bodies; b++)
+    {
+        const size_t len = gen_body(body);
+        ref_parse(body, len, ref);
+        for (int mode = 0; mode < 3; mode++)
+        {
+            if (check(body, len, ref, mode))
+            {
+                printf("body %lu of seed %llu\n", b, seed);
+                return 1;
+            }
+        }
+        for (size_t i = 0; i < N_FIELDS; i++)
+        {
+            found += ref[i].seen;
+            truncated += ref[i].truncated;
+        }
+    }
+    printf("%lu bodies, 3 ways each: %lu values found, %lu truncated, all match\n", bodies, found, truncated);
+    return 0;
+}
@@ -0,0 +1,214 @@
+// history_bench: host benchmark of the sensor_history tiers
+// (firmware/esp_idf_shared_components/sensor_history/src/tseries.c).
+//
+//   history_bench [-d DAYS] [-p PERIOD_S] [-q QUERIES]
+//
+// Feeds DAYS (7) of synthetic temperature samples, one every PERIOD_S (2),
+// into a series sized like the PSRAM defaults and reports the ingest cost
+// per sample. Then runs dashboard-style queries (last 10 min ... whole
+// range) plus QUERIES random windows, reporting the resolution picked and
+// the latency, and checks every returned point against a brute-force
+// rollup of all samples. Exits non-zero on a mismatch.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tseries.h"
+
+#define MAX_POINTS 600 // a chart's width
+
+static const tseries_caps_t s_caps = {.raw = 3600, .minutes = 10080, .hours = 2160};
+
+static tseries_raw_t *s_all; // every sample, for the reference
+static size_t s_n_all;
+static int s_failures;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int32_t synth_temp(uint32_t t)
+{
+    // 24 h swing of +-3 C around 24 C, slow drift, sensor noise in tenths
+    const double day = 2.0 * M_PI * (t % 86400) / 86400.0;
+    const double v = 240.0 + 30.0 * sin(day) + 5.0 * sin(t / 20000.0) + (rand() % 5 - 2);
+    return (int32_t)lround(v);
+}
+
+// Reference rollup of all samples in [start, start + width)
+static bool reference(uint32_t start, uint32_t width, tseries_point_t *p)
+{
+    // Samples are in time order: binary search the first one
+    size_t lo = 0, hi = s_n_all;
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (s_all[mid].t_s < start)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    int64_t sum = 0;
+    uint32_t n = 0;
+    int32_t mn = INT32_MAX, mx = INT32_MIN;
+    for (size_t i = lo; i < s_n_all && s_all[i].t_s < start + width; i++)
+    {
+        const int32_t v = s_all[i].v;
+        sum += v;
+        n++;
+        if (v < mn)
+            mn = v;
+        if (v > mx)
+            mx = v;
+    }
+    if (n == 0)
+        return false;
+    *p = (tseries_point_t){start, mn, (int32_t)(sum >= 0 ? (sum + n / 2) / n : -((-sum + n / 2) / n)), mx, n};
+    return true;
+}
+
+static void verify(const tseries_point_t *pts, size_t n, tseries_res_t res, uint32_t t0, uint32_t t1)
+{
+    static const uint32_t width[TSERIES_RES_COUNT] = {1, TSERIES_MINUTE_S, TSERIES_HOUR_S};
+    for (size_t i = 0; i < n; i++)
+    {
+        const tseries_point_t *p = &pts[i];
+        tseries_point_t want;
+        if (p->t_s > t1 || p->t_s + width[res] <= t0 || (i && p->t_s <= pts[i - 1].t_s))
+        {
+            fprintf(stderr, "FAIL point %zu at %u outside [%u, %u] or out of order\n", i, p->t_s, t0, t1);
+            s_failures++;
+            return;
+        }
+        if (res == TSERIES_RES_RAW)
+        {
+            // Raw: the value must be one of the samples at that second
+            if (!reference(p->t_s, 1, &want) || p->avg != want.avg || p->count != 1)
+            {
+                fprintf(stderr, "FAIL raw point at %u: %d\n", p->t_s, p->avg);
+                s_failures++;
+                return;
+            }
+            continue;
+        }
+        if (!reference(p->t_s, width[res], &want) || memcmp(p, &want, sizeof(want)) != 0)
+        {
+            fprintf(stderr, "FAIL %s bucket at %u: got %d/%d/%d n=%u, want %d/%d/%d n=%u\n",
+                    tseries_res_name(res), p->t_s, p->min, p->avg, p->max, p->count, want.min, want.avg,
+                    want.max, want.count);
+            s_failures++;
+            return;
+        }
+    }
+}
+
+static void run_query(const tseries_t *ts, const char *name, uint32_t t0, uint32_t t1, int reps)
+{
+    static tseries_point_t pts[MAX_POINTS];
+    tseries_res_t res = TSERIES_RES_RAW;
+    size_t n = 0;
+    const double a = now_s();
+    for (int r = 0; r < reps; r++)
+        n = tseries_query(ts, t0, t1, pts, MAX_POINTS, &res);
+    const double us = (now_s() - a) * 1e6 / reps;
+    verify(pts, n, res, t0, t1);
+    printf("  %-14s %-5s %4zu points  %8.2f us\n", name, tseries_res_name(res), n, us);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t days = 7, period = 2;
+    int queries = 1000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            days = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            period = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+            queries = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-d DAYS] [-p PERIOD_S] [-q QUERIES]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (days == 0 || period == 0)
+        return 2;
+    srand(1);
+
+    const uint32_t t_start = 1000; // uptime at the first read
+    const size_t n = (size_t)days * 86400 / period;
+    s_all = malloc(n * sizeof(*s_all));
+    const size_t mem_size = tseries_mem_size(&s_caps);
+    void *mem = malloc(mem_size);
+    if (!s_all || !mem)
+        return 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint32_t t = t_start + (uint32_t)i * period;
+        s_all[i] = (tseries_raw_t){t, synth_temp(t)};
+    }
+
+    tseries_t ts;
+    tseries_init(&ts, &s_caps, mem);
+    const double a = now_s();
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i % 500 == 499)
+            continue; // a failed read leaves a gap
+        tseries_add(&ts, s_all[i].t_s, s_all[i].v);
+    }
+    const double ingest = now_s() - a;
+    // The reference only knows what was ingested
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++)
+        if (i % 500 != 499)
+            s_all[k++] = s_all[i];
+    s_n_all = k;
+
+    printf("history_bench: %u days at %u s = %zu samples, caps %u raw / %u min / %u h = %zu B\n", days, period,
+           s_n_all, s_caps.raw, s_caps.minutes, s_caps.hours, mem_size);
+    printf("ingest: %.1f ns/sample (%.1f ms total)\n", ingest * 1e9 / (double)s_n_all, ingest * 1e3);
+
+    const uint32_t now = s_all[s_n_all - 1].t_s;
+    printf("queries (max %d points):\n", MAX_POINTS);
+    run_query(&ts, "last 10 min", now - 600, now, 1000);
+    run_query(&ts, "last 2 h", now - 7200, now, 1000);
+    run_query(&ts, "last 24 h", now - 86400, now, 200);
+    run_query(&ts, "last 7 days", now > 7 * 86400 ? now - 7 * 86400 : 0, now, 200);
+    run_query(&ts, "everything", 0, UINT32_MAX, 200);
+
+    double total = 0;
+    for (int q = 0; q < queries && !s_failures; q++)
+    {
+        const uint32_t len = 60u * (1 + (uint32_t)rand() % (24 * 60));
+        const uint32_t t1 = t_start + (uint32_t)((uint64_t)rand() * (now - t_start) / RAND_MAX);
+        const uint32_t t0 = t1 > len ? t1 - len : 0;
+        tseries_point_t pts[MAX_POINTS];
+        tseries_res_t res;
+        const double b = now_s();
+        const size_t got = tseries_query(&ts, t0, t1, pts, MAX_POINTS, &res);
+        total += now_s() - b;
+        verify(pts, got, res, t0, t1);
+    }
+    printf("  %d random windows (1 min .. 24 h): %.2f us avg\n", queries, total * 1e6 / queries);
+
+    free(mem);
+    free(s_all);
+    if (s_failures)
+    {
+        fprintf(stderr, "%d mismatch(es)\n", s_failures);
+        return 1;
+    }
+    printf("all points match the brute-force rollup\n");
+    return 0;
+}
@@ -0,0 +1,868 @@
+// httpd_async_load: slow clients against the HTTP worker pool
+// (firmware/esp_idf_shared_components/httpd_async, admission by
+// src/req_gate.c).
+//
+//   httpd_async_load [-d SECONDS] [-n CLIENTS] [-s SLOW] [-w WORKERS] [-q QUEUE]
+//
+// A model of esp_http_server on loopback: one server thread polls the
+// sessions, reads a request's headers and runs its handler, every recv
+// waiting at most RECV_TIMEOUT_MS (recv_wait_timeout on the gateway).
+// CLIENTS (3) keep-alive clients alternate GET /status.json and GET
+// /history (5 ms of work), pausing 20 ms after a 503, while SLOW (3)
+// clients post /save and trickle its 40-byte body a byte every 250 ms,
+// reconnecting after each reply.
+// Runs SECONDS (5) in two modes:
+//   inline  every handler on the server thread, /save reading its body
+//           until it is complete, as wifi_prov_http did
+//   pool    /history and /save queued to WORKERS (2) threads through
+//           req_gate, as httpd_async_submit() does: /save at most 1 at a
+//           time and answered 408 when its body takes over 2 s, /history
+//           at most 2, QUEUE (4) waiting in all; more is answered 503
+// Reports the normal clients' requests per second, latency and requests
+// that waited over 1 s, the slow clients' replies and the gate counters.
+// Exits non-zero if, in pool mode, a normal request waits over 1 s or the
+// p99 exceeds 100 ms, a reply is malformed, or no slow post is cut off
+// with a 408.
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "req_gate.h"
+
+#define MAX_SESSIONS 7 // max_open_sockets of the gateway servers
+#define RECV_TIMEOUT_MS 500
+#define BODY_TIMEOUT_MS 2000
+#define HISTORY_WORK_US 5000
+#define SLOW_BODY_LEN 40
+#define SLOW_BYTE_MS 250
+#define SLOW_RETRY_MS 200
+#define BUSY_RETRY_MS 20 // normal clients, after a 503
+#define STALL_US 1000000
+#define P99_LIMIT_US 100000
+
+#define SOCK_TIMEOUT (-3) // HTTPD_SOCK_ERR_TIMEOUT
+#define RECV_DEADLINE (-100)
+
+static int s_failures = 0;
+static volatile bool s_stop_clients = false;
+static char s_history_body[2048]; // filled by main()
+
+// Set by async_recv() for the job of this worker
+static _Thread_local bool t_timed_out;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*========== Server model ==========*/
+typedef struct
+{
+    int fd;     // -1: free
+    bool busy;  // owned by a worker until its request completes
+    bool close; // closed when the request completes
+} sess_t;
+
+typedef struct
+{
+    sess_t *sess;
+    char method[8];
+    char path[64];
+    size_t content_len;
+    char pre[512]; // body bytes read with the headers
+    size_t pre_len, pre_pos;
+} req_t;
+
+typedef void (*handler_t)(req_t *req);
+
+typedef struct
+{
+    req_t *req;
+    handler_t handler;
+    int route;
+    int64_t queued_us;
+} job_t;
+
+typedef struct
+{
+    bool pool;
+    int workers;
+    uint16_t queue_cap;
+    int listen_fd;
+    uint16_t port;
+    int wake[2]; // a worker handed a session back
+    sess_t sess[MAX_SESSIONS];
+    pthread_mutex_t lock; // everything below, and sess[]
+    pthread_cond_t cond;
+    req_gate_t gate;
+    int route_save, route_history;
+    job_t *jobs; // queue_cap
+    size_t job_head, job_count;
+    bool stop;
+    pthread_t thread;
+    pthread_t *worker_threads;
+} server_t;
+
+static void send_all(int fd, const char *data, size_t len)
+{
+    while (len)
+    {
+        const ssize_t r = send(fd, data, len, MSG_NOSIGNAL);
+        if (r <= 0)
+            return;
+        data += r;
+        len -= (size_t)r;
+    }
+}
+
+static void reply(req_t *req, const char *status, const char *extra_headers, const char *body)
+{
+    char head[256];
+    const size_t body_len = strlen(body);
+    const int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n%s\r\n",
+                           status, body_len, extra_headers ? extra_headers : "");
+    send_all(req->sess->fd, head, (size_t)n);
+    send_all(req->sess->fd, body, body_len);
+}
+
+// httpd_req_recv(): body bytes read with the headers first, then one recv
+// bounded by the session's receive timeout
+static int req_recv(req_t *req, char *buf, size_t len)
+{
+    if (req->pre_pos < req->pre_len)
+    {
+        size_t n = req->pre_len - req->pre_pos;
+        if (n > len)
+            n = len;
+        memcpy(buf, req->pre + req->pre_pos, n);
+        req->pre_pos += n;
+        return (int)n;
+    }
+    const ssize_t r = recv(req->sess->fd, buf, len, 0);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return SOCK_TIMEOUT;
+    return r < 0 ? -1 : (int)r;
+}
+
+// httpd_async_recv(): the whole body within `timeout_ms`
+static int async_recv(req_t *req, char *buf, size_t len, uint32_t timeout_ms)
+{
+    const int64_t deadline = now_us() + (int64_t)timeout_ms * 1000;
+    size_t got = 0;
+    while (got < len)
+    {
+        const int r = req_recv(req, buf + got, len - got);
+        if (r > 0)
+            got += (size_t)r;
+        else if (r != SOCK_TIMEOUT)
+            return -1;
+        if (got < len && now_us() >= deadline)
+        {
+            t_timed_out = true;
+            req->sess->close = true;
+            return RECV_DEADLINE;
+        }
+    }
+    return (int)len;
+}
+
+static void handle_status(req_t *req)
+{
+    reply(req, "200 OK", NULL, "{\"temp\":25.3,\"hum\":60.1,\"ok\":true,\"t\":1234,\"seq\":617,"
+                               "\"wifi_state\":\"connected\"}");
+}
+
+static void handle_history(req_t *req)
+{
+    usleep(HISTORY_WORK_US); // building the reply
+    reply(req, "200 OK", NULL, s_history_body);
+}
+
+// wifi_prov_http before the worker pool: each recv may time out, but a
+// client sending a byte now and then holds the handler
+static void handle_save_inline(req_t *req)
+{
+    char body[513];
+    if (!req->content_len || req->content_len > 512)
+    {
+        reply(req, "400 Bad Request", NULL, "Bad content size");
+        return;
+    }
+    size_t got = 0;
+    while (got < req->content_len)
+    {
+        const int r = req_recv(req, body + got, req->content_len - got);
+        if (r <= 0)
+        {
+            req->sess->close = true;
+            reply(req, "500 Internal Server Error", NULL, "Recv failed");
+            return;
+        }
+        got += (size_t)r;
+    }
+    reply(req, "200 OK", NULL, "Saved.");
+}
+
+// wifi_prov_http on a worker: the body within BODY_TIMEOUT_MS
+static void handle_save_pool(req_t *req)
+{
+    char body[513];
+    if (!req->content_len || req->content_len > 512)
+    {
+        reply(req, "400 Bad Request", NULL, "Bad content size");
+        return;
+    }
+    const int r = async_recv(req, body, req->content_len, BODY_TIMEOUT_MS);
+    if (r == RECV_DEADLINE)
+        reply(req, "408 Request Timeout", NULL, "Body timeout");
+    else if (r < 0)
+        reply(req, "500 Internal Server Error", NULL, "Recv failed");
+    else
+        reply(req, "200 OK", NULL, "Saved.");
+}
+
+static void handle_not_found(req_t *req)
+{
+    reply(req, "404 Not Found", NULL, "Nothing here");
+}
+
+// Takes the session back from a request; server lock held
+static void sess_release(sess_t *sess)
+{
+    if (sess->close && sess->fd >= 0)
+    {
+        close(sess->fd);
+        sess->fd = -1;
+    }
+    sess->busy = false;
+    sess->close = false;
+}
+
+static void *worker_main(void *arg)
+{
+    server_t *s = arg;
+    pthread_mutex_lock(&s->lock);
+    for (;;)
+    {
+        while (!s->job_count && !s->stop)
+            pthread_cond_wait(&s->cond, &s->lock);
+        if (!s->job_count)
+            break;
+        const job_t job = s->jobs[s->job_head];
+        s->job_head = (s->job_head + 1) % s->queue_cap;
+        s->job_count--;
+        const int64_t t0 = now_us();
+        req_gate_start(&s->gate, job.route, (uint32_t)(t0 - job.queued_us));
+        pthread_mutex_unlock(&s->lock);
+
+        t_timed_out = false;
+        job.handler(job.req);
+
+        pthread_mutex_lock(&s->lock);
+        req_gate_done(&s->gate, job.route, (uint32_t)(now_us() - t0), t_timed_out);
+        sess_release(job.req->sess);
+        free(job.req);
+        const char one = 1;
+        if (write(s->wake[1], &one, 1) < 0)
+        {
+            // the server polls again within 50 ms anyway
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+// Reads one request's headers on the server thread. NULL if the session
+// was closed, by the client or for a 408.
+static req_t *read_request(sess_t *sess)
+{
+    char buf[1024];
+    size_t len = 0;
+    char *end = NULL;
+    while (!end)
+    {
+        const ssize_t r = recv(sess->fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (r <= 0 || len + (size_t)r >= sizeof(buf) - 1)
+        {
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                static const char timeout[] = "HTTP/1.1 408 Request Timeout\r\nContent-Length: 0\r\n\r\n";
+                send_all(sess->fd, timeout, sizeof(timeout) - 1);
+            }
+            return NULL;
+        }
+        len += (size_t)r;
+        buf[len] = 0;
+        end = strstr(buf, "\r\n\r\n");
+    }
+
+    req_t *req = calloc(1, sizeof(*req));
+    if (!req)
+        exit(1);
+    req->sess = sess;
+    if (sscanf(buf, "%7s %63s", req->method, req->path) != 2)
+    {
+        free(req);
+        return NULL;
+    }
+    const char *cl = strcasestr(buf, "\r\nContent-Length:");
+    if (cl && cl < end)
+        req->content_len = (size_t)strtoul(cl + 17, NULL, 10);
+    req->pre_len = len - (size_t)(end + 4 - buf);
+    if (req->pre_len > sizeof(req->pre))
+        req->pre_len = sizeof(req->pre);
+    memcpy(req->pre, end + 4, req->pre_len);
+    return req;
+}
+
+// The URI handler: inline, or handed to the workers like httpd_async_submit()
+static void dispatch(server_t *s, req_t *req)
+{
+    handler_t handler = handle_not_found;
+    int route = -1;
+    if (!strcmp(req->method, "GET") && !strcmp(req->path, "/status.json"))
+    {
+        handler = handle_status;
+    }
+    else if (!strcmp(req->method, "GET") && !strcmp(req->path, "/history"))
+    {
+        handler = handle_history;
+        route = s->route_history;
+    }
+    else if (!strcmp(req->method, "POST") && !strcmp(req->path, "/save"))
+    {
+        handler = s->pool ? handle_save_pool : handle_save_inline;
+        route = s->route_save;
+    }
+
+    if (s->pool && route >= 0)
+    {
+        pthread_mutex_lock(&s->lock);
+        if (req_gate_admit(&s->gate, route))
+        {
+            // Admission leaves room in the queue
+            const size_t tail = (s->job_head + s->job_count) % s->queue_cap;
+            s->jobs[tail] = (job_t){.req = req, .handler = handler, .route = route, .queued_us = now_us()};
+            s->job_count++;
+            req->sess->busy = true;
+            pthread_cond_signal(&s->cond);
+            pthread_mutex_unlock(&s->lock);
+            return;
+        }
+        pthread_mutex_unlock(&s->lock);
+        handler = NULL;
+        reply(req, "503 Service Unavailable", "Retry-After: 1\r\n", "busy\n");
+    }
+    if (handler)
+        handler(req);
+    pthread_mutex_lock(&s->lock);
+    sess_release(req->sess);
+    pthread_mutex_unlock(&s->lock);
+    free(req);
+}
+
+static void accept_session(server_t *s)
+{
+    const int fd = accept(s->listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    const struct timeval tv = {.tv_sec = RECV_TIMEOUT_MS / 1000, .tv_usec = (RECV_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    pthread_mutex_lock(&s->lock);
+    sess_t *free_sess = NULL;
+    for (int i = 0; i < MAX_SESSIONS && !free_sess; i++)
+        if (s->sess[i].fd < 0)
+            free_sess = &s->sess[i];
+    if (free_sess)
+        *free_sess = (sess_t){.fd = fd};
+    pthread_mutex_unlock(&s->lock);
+    if (!free_sess)
+        close(fd); // esp_http_server would purge the least recently used session
+}
+
+static void *server_main(void *arg)
+{
+    server_t *s = arg;
+    struct pollfd pfd[2 + MAX_SESSIONS];
+    int idx[2 + MAX_SESSIONS];
+    for (;;)
+    {
+        pthread_mutex_lock(&s->lock);
+        if (s->stop)
+        {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+        nfds_t n = 0;
+        pfd[n++] = (struct pollfd){.fd = s->listen_fd, .events = POLLIN};
+        pfd[n++] = (struct pollfd){.fd = s->wake[0], .events = POLLIN};
+        // Sessions a worker owns are left alone until it is done
+        for (int i = 0; i < MAX_SESSIONS; i++)
+        {
+            if (s->sess[i].fd >= 0 && !s->sess[i].busy)
+            {
+                idx[n] = i;
+                pfd[n++] = (struct pollfd){.fd = s->sess[i].fd, .events = POLLIN};
+            }
+        }
+        pthread_mutex_unlock(&s->lock);
+
+        if (poll(pfd, n, 50) <= 0)
+            continue;
+        if (pfd[1].revents)
+        {
+            char drain[64];
+            while (read(s->wake[0], drain, sizeof(drain)) > 0)
+                ;
+        }
+        if (pfd[0].revents)
+            accept_session(s);
+        // One request at a time, like the httpd task
+        for (nfds_t i = 2; i < n; i++)
+        {
+            if (!pfd[i].revents)
+                continue;
+            sess_t *sess = &s->sess[idx[i]];
+            req_t *req = read_request(sess);
+            if (req)
+            {
+                dispatch(s, req);
+                continue;
+            }
+            pthread_mutex_lock(&s->lock);
+            sess->close = true;
+            sess_release(sess);
+            pthread_mutex_unlock(&s->lock);
+        }
+    }
+    return NULL;
+}
+
+static bool server_start(server_t *s, bool pool, int workers, uint16_t queue_cap)
+{
+    memset(s, 0, sizeof(*s));
+    s->pool = pool;
+    s->workers = workers;
+    s->queue_cap = queue_cap;
+    for (int i = 0; i < MAX_SESSIONS; i++)
+        s->sess[i].fd = -1;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    req_gate_init(&s->gate, (uint16_t)workers, queue_cap);
+    // The limits of wifi_prov_http and telemetry_http
+    s->route_save = req_gate_add_route(&s->gate, "prov_save", 1);
+    s->route_history = req_gate_add_route(&s->gate, "telemetry", 2);
+    s->jobs = calloc(queue_cap, sizeof(job_t));
+    s->worker_threads = calloc((size_t)workers, sizeof(pthread_t));
+    if (!s->jobs || !s->worker_threads || pipe2(s->wake, O_NONBLOCK) != 0)
+        return false;
+
+    s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(s->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {.sin_family = AF_INET};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (bind(s->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s->listen_fd, 16) != 0 ||
+        getsockname(s->listen_fd, (struct sockaddr *)&addr, &alen) != 0)
+        return false;
+    s->port = ntohs(addr.sin_port);
+
+    for (int i = 0; pool && i < workers; i++)
+        pthread_create(&s->worker_threads[i], NULL, worker_main, s);
+    pthread_create(&s->thread, NULL, server_main, s);
+    return true;
+}
+
+static void server_stop(server_t *s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->stop = true;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+    for (int i = 0; s->pool && i < s->workers; i++)
+        pthread_join(s->worker_threads[i], NULL);
+    for (int i = 0; i < MAX_SESSIONS; i++)
+        if (s->sess[i].fd >= 0)
+            close(s->sess[i].fd);
+    close(s->listen_fd);
+    close(s->wake[0]);
+    close(s->wake[1]);
+    free(s->jobs);
+    free(s->worker_threads);
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+}
+
+/*========== Clients ==========*/
+typedef struct
+{
+    uint32_t *v;
+    size_t n, cap;
+} samples_t;
+
+typedef struct
+{
+    uint16_t port;
+    samples_t lat;
+    uint32_t ok, busy, stalled, bad;
+} normal_t;
+
+typedef struct
+{
+    uint16_t port;
+    uint32_t saved, timed_out, busy, closed;
+} slow_t;
+
+static void add_sample(samples_t *s, uint32_t v)
+{
+    if (s->n == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 4096;
+        s->v = realloc(s->v, s->cap * sizeof(uint32_t));
+        if (!s->v)
+            exit(1);
+    }
+    s->v[s->n++] = v;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int client_connect(uint16_t port, int recv_timeout_ms)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const struct timeval tv = {.tv_sec = recv_timeout_ms / 1000, .tv_usec = (recv_timeout_ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads one reply; its status code, 0 if the run ended first, -1 if the
+// connection failed or the reply is malformed
+static int read_reply(int fd, char *buf, size_t size)
+{
+    size_t len = 0, need = 0;
+    while (!need || len < need)
+    {
+        const ssize_t r = recv(fd, buf + len, size - 1 - len, 0);
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if (s_stop_clients)
+                return 0;
+            continue;
+        }
+        if (r <= 0)
+            return -1;
+        len += (size_t)r;
+        buf[len] = 0;
+        const char *end = strstr(buf, "\r\n\r\n");
+        const char *cl = strcasestr(buf, "\r\nContent-Length:");
+        if (!need && end && cl && cl < end)
+            need = (size_t)(end + 4 - buf) + strtoul(cl + 17, NULL, 10);
+        else if (!need && end)
+            return -1;
+        if (need >= size)
+            return -1;
+    }
+    int status = 0;
+    return sscanf(buf, "HTTP/1.1 %d ", &status) == 1 && len == need ? status : -1;
+}
+
+static void *normal_main(void *arg)
+{
+    normal_t *c = arg;
+    char buf[4096];
+    int fd = -1;
+    for (uint32_t k = 0; !s_stop_clients; k++)
+    {
+        if (fd < 0 && (fd = client_connect(c->port, 100)) < 0)
+        {
+            c->bad++;
+            usleep(10000);
+            continue;
+        }
+        char req[96];
+        const int n = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: gateway\r\n\r\n",
+                               k & 1 ? "/history" : "/status.json");
+        const int64_t t0 = now_us();
+        send_all(fd, req, (size_t)n);
+        const int status = read_reply(fd, buf, sizeof(buf));
+        const int64_t us = now_us() - t0;
+        if (us > STALL_US)
+            c->stalled++;
+        if (status == 0)
+        {
+            // Unanswered when the run ended: the wait so far is a lower bound
+            if (us > STALL_US)
+                add_sample(&c->lat, (uint32_t)us);
+            break;
+        }
+        if (status != 200 && status != 503)
+        {
+            c->bad++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        add_sample(&c->lat, (uint32_t)us);
+        if (status == 200)
+        {
+            c->ok++;
+        }
+        else
+        {
+            c->busy++;
+            usleep(BUSY_RETRY_MS * 1000);
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+    return NULL;
+}
+
+static void *slow_main(void *arg)
+{
+    slow_t *c = arg;
+    static const char head[] = "POST /save HTTP/1.1\r\nHost: gateway\r\n"
+                               "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: 40\r\n\r\n";
+    static const char body[SLOW_BODY_LEN + 1] = "ssid=slowloris&pass=aaaaaaaaaaaaaaaaaaaa";
+    char buf[512];
+    while (!s_stop_clients)
+    {
+        const int fd = client_connect(c->port, 100);
+        if (fd < 0)
+        {
+            usleep(10000);
+            continue;
+        }
+        send_all(fd, head, sizeof(head) - 1);
+        int status = 0;
+        for (size_t sent = 0; !s_stop_clients && !status;)
+        {
+            struct pollfd p = {.fd = fd, .events = POLLIN};
+            if (poll(&p, 1, SLOW_BYTE_MS) > 0)
+                status = read_reply(fd, buf, sizeof(buf));
+            else if (sent < SLOW_BODY_LEN)
+                send_all(fd, body + sent++, 1);
+        }
+        close(fd);
+        if (status == 200)
+            c->saved++;
+        else if (status == 408)
+            c->timed_out++;
+        else if (status == 503)
+            c->busy++;
+        else if (status < 0)
+            c->closed++;
+        if (status == 503)
+            usleep(SLOW_RETRY_MS * 1000);
+    }
+    return NULL;
+}
+
+/*========== Runs ==========*/
+typedef struct
+{
+    double req_per_s;
+    uint32_t p50, p99, max;
+    uint32_t busy, stalled, bad;
+    slow_t slow;
+    req_gate_t gate;
+} run_result_t;
+
+static run_result_t run(bool pool, int clients, int slow, int workers, uint16_t queue_cap, double seconds)
+{
+    run_result_t res = {0};
+    server_t *s = malloc(sizeof(*s));
+    if (!s || !server_start(s, pool, workers, queue_cap))
+    {
+        fprintf(stderr, "cannot start the server model\n");
+        exit(1);
+    }
+
+    normal_t *nc = calloc((size_t)clients, sizeof(normal_t));
+    slow_t *sc = calloc((size_t)slow, sizeof(slow_t));
+    pthread_t *threads = calloc((size_t)(clients + slow), sizeof(pthread_t));
+    if (!nc || !sc || !threads)
+        exit(1);
+    s_stop_clients = false;
+    // Slow clients first: they get hold of the server before the others
+    for (int i = 0; i < slow; i++)
+    {
+        sc[i].port = s->port;
+        pthread_create(&threads[clients + i], NULL, slow_main, &sc[i]);
+    }
+    usleep(100000);
+    const int64_t start = now_us();
+    for (int i = 0; i < clients; i++)
+    {
+        nc[i].port = s->port;
+        pthread_create(&threads[i], NULL, normal_main, &nc[i]);
+    }
+    usleep((useconds_t)(seconds * 1e6));
+    s_stop_clients = true;
+    for (int i = 0; i < clients + slow; i++)
+        pthread_join(threads[i], NULL);
+    const double elapsed = (double)(now_us() - start) / 1e6;
+
+    pthread_mutex_lock(&s->lock);
+    res.gate = s->gate;
+    pthread_mutex_unlock(&s->lock);
+    server_stop(s);
+
+    samples_t lat = {0};
+    uint32_t done = 0;
+    for (int i = 0; i < clients; i++)
+    {
+        for (size_t j = 0; j < nc[i].lat.n; j++)
+            add_sample(&lat, nc[i].lat.v[j]);
+        done += nc[i].ok + nc[i].busy;
+        res.busy += nc[i].busy;
+        res.stalled += nc[i].stalled;
+        res.bad += nc[i].bad;
+        free(nc[i].lat.v);
+    }
+    for (int i = 0; i < slow; i++)
+    {
+        res.slow.saved += sc[i].saved;
+        res.slow.timed_out += sc[i].timed_out;
+        res.slow.busy += sc[i].busy;
+        res.slow.closed += sc[i].closed;
+    }
+    qsort(lat.v, lat.n, sizeof(uint32_t), cmp_u32);
+    res.req_per_s = (double)done / elapsed;
+    res.p50 = lat.n ? lat.v[(lat.n - 1) / 2] : 0;
+    res.p99 = lat.n ? lat.v[(size_t)((double)(lat.n - 1) * 0.99)] : 0;
+    res.max = lat.n ? lat.v[lat.n - 1] : 0;
+    free(lat.v);
+    free(threads);
+    free(sc);
+    free(nc);
+    free(s);
+    return res;
+}
+
+static void print_run(const char *mode, const run_result_t *r)
+{
+    printf("%-7s %8.0f %8.1f %8.1f %8.1f %8u %6u %6u | %5u %5u %5u %6u\n", mode, r->req_per_s, r->p50 / 1000.0,
+           r->p99 / 1000.0, r->max / 1000.0, r->stalled, r->busy, r->bad, r->slow.saved, r->slow.timed_out,
+           r->slow.busy, r->slow.closed);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-d SECONDS] [-n CLIENTS] [-s SLOW] [-w WORKERS] [-q QUEUE]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 5;
+    int clients = 3, slow = 3, workers = 2, queue_cap = 4;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_arg = i + 1 < argc;
+        if (!strcmp(argv[i], "-d") && has_arg)
+            seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && has_arg)
+            clients = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && has_arg)
+            slow = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && has_arg)
+            workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-q") && has_arg)
+            queue_cap = atoi(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    // The route limits need a worker for /history next to the one of /save
+    if (seconds <= 0 || clients < 1 || slow < 0 || clients + slow > MAX_SESSIONS || workers < 2 || workers > 8 ||
+        queue_cap < 1 || queue_cap > 32)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    memset(s_history_body, '0', sizeof(s_history_body) - 1);
+
+    printf("%d normal clients, %d posting a byte every %d ms; %d sessions, %d ms recv timeout, %.0f s per mode\n",
+           clients, slow, SLOW_BYTE_MS, MAX_SESSIONS, RECV_TIMEOUT_MS, seconds);
+    printf("pool: %d workers, %d queued, /save 1 at a time with a %d ms body deadline, /history 2\n\n", workers,
+           queue_cap, BODY_TIMEOUT_MS);
+    printf("%-7s %8s %8s %8s %8s %8s %6s %6s | %5s %5s %5s %6s\n", "mode", "req/s", "p50 ms", "p99 ms", "max ms",
+           "over 1s", "503", "bad", "200", "408", "503", "closed");
+    printf("%-7s %53s | %s\n", "", "normal clients", "slow clients");
+
+    const run_result_t in = run(false, clients, slow, workers, (uint16_t)queue_cap, seconds);
+    print_run("inline", &in);
+    const run_result_t po = run(true, clients, slow, workers, (uint16_t)queue_cap, seconds);
+    print_run("pool", &po);
+
+    printf("\npool queue: %u of %u at most\n", po.gate.queued_max, po.gate.queue_cap);
+    printf("%-10s %8s %8s %8s %8s %12s %12s %12s\n", "route", "accepted", "rejected", "timeout", "inflight",
+           "wait avg ms", "wait max ms", "service max");
+    for (size_t i = 0; i < po.gate.n_routes; i++)
+    {
+        const req_gate_route_t *r = &po.gate.routes[i];
+        printf("%-10s %8u %8u %8u %8u %12.2f %12.2f %12.1f\n", r->name, r->accepted, r->rejected, r->timed_out,
+               r->inflight_max, r->accepted ? (double)r->wait_us / r->accepted / 1000.0 : 0.0, r->wait_us_max / 1000.0,
+               r->service_us_max / 1000.0);
+    }
+
+    if (in.bad || po.bad)
+    {
+        printf("FAIL: %u malformed replies or failed connections\n", in.bad + po.bad);
+        s_failures++;
+    }
+    if (po.stalled)
+    {
+        printf("FAIL: %u normal requests waited over 1 s with the pool\n", po.stalled);
+        s_failures++;
+    }
+    if (po.p99 > P99_LIMIT_US)
+    {
+        printf("FAIL: normal p99 %.1f ms with the pool\n", po.p99 / 1000.0);
+        s_failures++;
+    }
+    if (slow && !po.slow.timed_out)
+    {
+        printf("FAIL: no slow post was cut off with a 408\n");
+        s_failures++;
+    }
+    printf("%s\n", s_failures ? "FAILED" : "all checks passed");
+    return s_failures ? 1 : 0;
+}
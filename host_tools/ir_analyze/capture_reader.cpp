@@ -0,0 +1,407 @@
+#include "capture_reader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Nesting limit for skipped values; the formats we read are flat
+static const int kMaxSkipDepth = 32;
+
+CaptureReader::CaptureReader(FILE *in, std::string sourceName)
+    : _in(in), _name(std::move(sourceName))
+{
+}
+
+int CaptureReader::peek_()
+{
+    if (_pos == _len)
+    {
+        _len = fread(_buf, 1, sizeof(_buf), _in);
+        _pos = 0;
+        if (_len == 0)
+            return EOF;
+    }
+    return (unsigned char)_buf[_pos];
+}
+
+int CaptureReader::get_()
+{
+    const int c = peek_();
+    if (c != EOF)
+    {
+        _pos++;
+        if (c == '\n')
+            _line++;
+    }
+    return c;
+}
+
+void CaptureReader::skipWs_()
+{
+    for (;;)
+    {
+        const int c = peek_();
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            return;
+        get_();
+    }
+}
+
+bool CaptureReader::fail_(const std::string &what)
+{
+    _error = _name + ":" + std::to_string(_line) + ": " + what;
+    return false;
+}
+
+bool CaptureReader::expect_(char c)
+{
+    skipWs_();
+    if (get_() != c)
+        return fail_(std::string("expected '") + c + "'");
+    return true;
+}
+
+bool CaptureReader::parseString_(std::string &out)
+{
+    out.clear();
+    if (!expect_('"'))
+        return false;
+    for (;;)
+    {
+        int c = get_();
+        if (c == EOF)
+            return fail_("unterminated string");
+        if (c == '"')
+            return true;
+        if (c == '\\')
+        {
+            c = get_();
+            switch (c)
+            {
+            case 'n':
+                c = '\n';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'u':
+            {
+                // Labels are ASCII; keep escaped code points below 0x80 only
+                unsigned cp = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    const int h = get_();
+                    cp <<= 4;
+                    if (h >= '0' && h <= '9')
+                        cp |= h - '0';
+                    else if (h >= 'a' && h <= 'f')
+                        cp |= h - 'a' + 10;
+                    else if (h >= 'A' && h <= 'F')
+                        cp |= h - 'A' + 10;
+                    else
+                        return fail_("bad \\u escape");
+                }
+                c = cp < 0x80 ? (int)cp : '?';
+                break;
+            }
+            case EOF:
+                return fail_("unterminated string");
+            default:
+                break; // \" \\ \/
+            }
+        }
+        out += (char)c;
+    }
+}
+
+bool CaptureReader::parseNumber_(double &out)
+{
+    skipWs_();
+    char tmp[40];
+    size_t n = 0;
+    for (;;)
+    {
+        const int c = peek_();
+        if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+            break;
+        if (n + 1 >= sizeof(tmp))
+            return fail_("number too long");
+        tmp[n++] = (char)get_();
+    }
+    tmp[n] = '\0';
+    char *end = nullptr;
+    out = strtod(tmp, &end);
+    if (n == 0 || *end != '\0')
+        return fail_("bad number");
+    return true;
+}
+
+bool CaptureReader::parseNumberArray_(std::vector<uint32_t> &out)
+{
+    out.clear();
+    if (!expect_('['))
+        return false;
+    skipWs_();
+    if (peek_() == ']')
+    {
+        get_();
+        return true;
+    }
+    for (;;)
+    {
+        // Hot loop for multi-thousand entry arrays: plain unsigned integers
+        // are parsed in place, anything else falls back to strtod.
+        skipWs_();
+        int c = peek_();
+        if (c >= '0' && c <= '9')
+        {
+            uint64_t v = 0;
+            while (c >= '0' && c <= '9')
+            {
+                v = v * 10 + (uint64_t)(c - '0');
+                get_();
+                c = peek_();
+            }
+            if (c == '.' || c == 'e' || c == 'E')
+                return fail_("expected integer timing");
+            out.push_back(v > UINT32_MAX ? UINT32_MAX : (uint32_t)v);
+        }
+        else
+        {
+            double d;
+            if (!parseNumber_(d))
+                return false;
+            out.push_back(d <= 0 ? 0 : (uint32_t)d);
+        }
+        skipWs_();
+        c = get_();
+        if (c == ']')
+            return true;
+        if (c != ',')
+            return fail_("expected ',' or ']' in array");
+    }
+}
+
+bool CaptureReader::skipValue_(int depth)
+{
+    if (depth > kMaxSkipDepth)
+        return fail_("nesting too deep");
+    skipWs_();
+    const int c = peek_();
+    if (c == '"')
+    {
+        std::string dummy;
+        return parseString_(dummy);
+    }
+    if (c == '{' || c == '[')
+    {
+        const char close = c == '{' ? '}' : ']';
+        get_();
+        skipWs_();
+        if (peek_() == close)
+        {
+            get_();
+            return true;
+        }
+        for (;;)
+        {
+            if (close == '}')
+            {
+                std::string key;
+                if (!parseString_(key) || !expect_(':'))
+                    return false;
+            }
+            if (!skipValue_(depth + 1))
+                return false;
+            skipWs_();
+            const int d = get_();
+            if (d == close)
+                return true;
+            if (d != ',')
+                return fail_("expected ','");
+        }
+    }
+    if (c == 't' || c == 'f' || c == 'n')
+    {
+        while (peek_() >= 'a' && peek_() <= 'z')
+            get_();
+        return true;
+    }
+    double d;
+    return parseNumber_(d);
+}
+
+bool CaptureReader::parseObject_(Capture &out)
+{
+    if (!expect_('{'))
+        return false;
+    skipWs_();
+    if (peek_() == '}')
+    {
+        get_();
+        return true;
+    }
+
+    std::string key;
+    std::string str;
+    for (;;)
+    {
+        if (!parseString_(key) || !expect_(':'))
+            return false;
+        skipWs_();
+
+        if (key == "raw_us" || key == "raw")
+        {
+            if (!parseNumberArray_(out.rawUs))
+                return false;
+        }
+        else if (key == "btn" || key == "protocol" || (key == "value" && peek_() == '"'))
+        {
+            if (!parseString_(str))
+                return false;
+            if (key == "btn")
+                out.label = str;
+            else if (key == "protocol")
+                out.protocol = str;
+            else
+            {
+                out.hasValue = true;
+                out.value = strtoull(str.c_str(), nullptr, 0);
+            }
+        }
+        else if (key == "bits" || key == "frequency" || key == "value")
+        {
+            double d;
+            if (!parseNumber_(d))
+                return false;
+            if (key == "bits")
+                out.bits = (uint16_t)d;
+            else if (key == "frequency")
+                out.frequency = (uint32_t)d;
+            else
+            {
+                out.hasValue = true;
+                out.value = (uint64_t)d;
+            }
+        }
+        else if (!skipValue_())
+        {
+            return false;
+        }
+
+        skipWs_();
+        const int c = get_();
+        if (c == '}')
+            return true;
+        if (c != ',')
+            return fail_("expected ',' or '}'");
+    }
+}
+
+bool CaptureReader::next(Capture &out)
+{
+    for (;;)
+    {
+        skipWs_();
+        const int c = peek_();
+        if (c == EOF)
+            return false;
+        // Top-level array framing and separators between objects
+        if (c == '[' || c == ']' || c == ',')
+        {
+            get_();
+            continue;
+        }
+        if (c != '{')
+        {
+            // Console text mixed into a serial log: skip the line
+            while (peek_() != EOF && get_() != '\n')
+            {
+            }
+            continue;
+        }
+
+        out = Capture();
+        const size_t line = _line;
+        if (!parseObject_(out))
+            return false;
+        out.source = _name + ":" + std::to_string(line);
+        return true;
+    }
+}
+
+static bool readFile(const fs::path &path, std::vector<Capture> &out, std::string &error)
+{
+    FILE *f = fopen(path.string().c_str(), "rb");
+    if (!f)
+    {
+        error = "cannot open " + path.string();
+        return false;
+    }
+
+    CaptureReader reader(f, path.string());
+    Capture c;
+    size_t n = 0;
+    while (reader.next(c))
+    {
+        // Learned controller files carry no label of their own: the file
+        // name is the state (COOL_24.5.json)
+        if (c.label.empty())
+            c.label = path.stem().string();
+        out.push_back(std::move(c));
+        n++;
+    }
+    fclose(f);
+
+    if (!reader.error().empty())
+    {
+        error = reader.error();
+        return false;
+    }
+    // A single-capture file reports the file name alone
+    if (n == 1)
+        out.back().source = path.string();
+    return true;
+}
+
+bool readCaptures(const std::string &path, std::vector<Capture> &out, std::string &error)
+{
+    std::error_code ec;
+    if (!fs::is_directory(path, ec))
+        return readFile(path, out, error);
+
+    std::vector<fs::path> files;
+    for (const auto &entry : fs::recursive_directory_iterator(path, ec))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        const std::string ext = entry.path().extension().string();
+        if (ext == ".json" || ext == ".jsonl")
+            files.push_back(entry.path());
+    }
+    if (ec)
+    {
+        error = path + ": " + ec.message();
+        return false;
+    }
+
+    // Stable order regardless of directory iteration
+    std::sort(files.begin(), files.end());
+    for (const fs::path &file : files)
+        if (!readFile(file, out, error))
+            return false;
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// One IR capture as found in ir_dump_esp8266 JSON lines, ir_dump_decode
+// output or a learned /ac/*.json file of controller_node.
+struct Capture
+{
+    std::string source; // "file" or "file#index" for multi-capture files
+    std::string label;  // "btn", or the file name for /ac/*.json
+    std::string protocol;
+    uint16_t bits = 0;
+    bool hasValue = false;
+    uint64_t value = 0;
+    uint32_t frequency = 0;
+    std::vector<uint32_t> rawUs; // rawbuf order, [0] = leading gap
+};
+
+// Streaming reader: pulls one JSON object at a time from a FILE, so a
+// multi-megabyte dump is never held in memory as a document. Accepts JSON
+// lines, a top-level array of objects, or a single pretty-printed object.
+// Unknown keys and nested values are skipped.
+class CaptureReader
+{
+public:
+    CaptureReader(FILE *in, std::string sourceName);
+
+    // false at end of input or on a syntax error (see error())
+    bool next(Capture &out);
+    const std::string &error() const { return _error; }
+
+private:
+    int peek_();
+    int get_();
+    void skipWs_();
+    bool expect_(char c);
+    bool parseString_(std::string &out);
+    bool parseNumber_(double &out);
+    bool parseNumberArray_(std::vector<uint32_t> &out);
+    bool skipValue_(int depth = 0);
+    bool parseObject_(Capture &out);
+    bool fail_(const std::string &what);
+
+    FILE *_in;
+    std::string _name;
+    char _buf[1 << 16];
+    size_t _pos = 0;
+    size_t _len = 0;
+    size_t _line = 1;
+    std::string _error;
+};
+
+// Reads every capture from a file or, recursively, a directory of *.json /
+// *.jsonl files. Learned /ac files without "btn" are labelled by file stem.
+bool readCaptures(const std::string &path, std::vector<Capture> &out, std::string &error);
@@ -0,0 +1,624 @@
+#include "ir_analysis.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+// Lengths further apart than this never belong to the same protocol
+static const double kMaxLengthRatio = 1.10;
+// Two timings are "the same width" within this fraction of the larger one
+static const double kBinTolerance = 0.25;
+// A mark this many times the bit mark is a header
+static const double kHeaderFactor = 2.5;
+// Shapes per parallel clustering work item
+static const size_t kClusterChunk = 256;
+
+// ===== Clustering =====
+static double distanceBelow(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b, double limit)
+{
+    if (a.size() < 2 || b.size() < 2)
+        return 2.0;
+    const size_t na = a.size() - 1;
+    const size_t nb = b.size() - 1;
+    const size_t n = std::min(na, nb);
+    const size_t m = std::max(na, nb);
+    if ((double)m > (double)n * kMaxLengthRatio + 1)
+        return 2.0;
+
+    // The length difference counts as fully mismatched positions
+    const double budget = limit * (double)m;
+    double sum = (double)(m - n);
+    for (size_t i = 1; i <= n && sum <= budget; i++)
+    {
+        const double x = a[i];
+        const double y = b[i];
+        const double hi = std::max(std::max(x, y), 1.0);
+        sum += fabs(x - y) / hi;
+    }
+    return sum / (double)m;
+}
+
+double timingDistance(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b)
+{
+    return distanceBelow(a, b, 2.0);
+}
+
+// Timings quantised to ~6% wide log bins: captures of the same button hash
+// to the same key far more often than not, and a collision is only a
+// missed shortcut since every shape is still compared.
+static uint64_t shapeKey(const std::vector<uint32_t> &raw)
+{
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](uint64_t v)
+    {
+        h ^= v;
+        h *= 1099511628211ull;
+    };
+    mix(raw.size());
+    for (size_t i = 1; i < raw.size(); i++)
+        mix((uint64_t)lround(log((double)raw[i] + 1.0) * 16.0));
+    return h;
+}
+
+// Leader clustering over a range of shapes: each shape joins the nearest
+// leader within the threshold or becomes a leader itself. Leaders are kept
+// sorted by length so only the length window is scanned.
+static void leaderCluster(const std::vector<Capture> &captures, const std::vector<size_t> &shapeRep,
+                          const std::vector<uint32_t> &items, double threshold,
+                          std::vector<uint32_t> &leaders, std::vector<uint32_t> &leaderOf)
+{
+    auto len = [&](uint32_t s)
+    { return captures[shapeRep[s]].rawUs.size(); };
+
+    for (uint32_t s : items)
+    {
+        const std::vector<uint32_t> &a = captures[shapeRep[s]].rawUs;
+        const double lo = ((double)a.size() - 1) / kMaxLengthRatio;
+        auto it = std::lower_bound(leaders.begin(), leaders.end(), lo, [&](uint32_t l, double v)
+                                   { return (double)len(l) < v; });
+        uint32_t found = UINT32_MAX;
+        double best = threshold;
+        for (; it != leaders.end() && (double)len(*it) <= (double)a.size() * kMaxLengthRatio + 1; ++it)
+        {
+            const double d = distanceBelow(a, captures[shapeRep[*it]].rawUs, best);
+            if (d <= best)
+            {
+                best = d;
+                found = *it;
+            }
+        }
+        if (found == UINT32_MAX)
+        {
+            leaders.insert(std::upper_bound(leaders.begin(), leaders.end(), s, [&](uint32_t v, uint32_t l)
+                                            { return len(v) < len(l); }),
+                           s);
+            found = s;
+        }
+        leaderOf[s] = found;
+    }
+}
+
+std::vector<TimingCluster> clusterCaptures(const std::vector<Capture> &captures,
+                                           const AnalysisOptions &opt)
+{
+    // 1. Fold identical shapes
+    std::vector<size_t> shapeOf(captures.size());
+    std::vector<size_t> shapeRep; // capture index representing each shape
+    {
+        std::unordered_map<uint64_t, size_t> byKey;
+        byKey.reserve(captures.size());
+        for (size_t i = 0; i < captures.size(); i++)
+        {
+            const auto it = byKey.emplace(shapeKey(captures[i].rawUs), shapeRep.size());
+            if (it.second)
+                shapeRep.push_back(i);
+            shapeOf[i] = it.first->second;
+        }
+    }
+
+    // 2. Leader clustering of fixed-size chunks of shapes, in parallel. The
+    //    chunking does not depend on the thread count, so neither does the
+    //    result.
+    const size_t nShapes = shapeRep.size();
+    const size_t nChunks = (nShapes + kClusterChunk - 1) / kClusterChunk;
+    std::vector<std::vector<uint32_t>> chunkLeaders(nChunks);
+    std::vector<uint32_t> leaderOf(nShapes);
+    std::atomic<size_t> nextChunk{0};
+    auto worker = [&]()
+    {
+        std::vector<uint32_t> items;
+        for (;;)
+        {
+            const size_t c = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (c >= nChunks)
+                return;
+            items.clear();
+            for (size_t s = c * kClusterChunk; s < std::min(nShapes, (c + 1) * kClusterChunk); s++)
+                items.push_back((uint32_t)s);
+            leaderCluster(captures, shapeRep, items, opt.threshold, chunkLeaders[c], leaderOf);
+        }
+    };
+
+    unsigned threads = opt.threads ? opt.threads : std::thread::hardware_concurrency();
+    threads = std::max(1u, std::min<unsigned>(threads, (unsigned)nChunks));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread &t : pool)
+        t.join();
+
+    // 3. Merge: the chunk leaders are clustered once more, in chunk order
+    std::vector<uint32_t> localLeaders;
+    for (const std::vector<uint32_t> &l : chunkLeaders)
+        localLeaders.insert(localLeaders.end(), l.begin(), l.end());
+    std::sort(localLeaders.begin(), localLeaders.end());
+    std::vector<uint32_t> globalLeaders;
+    std::vector<uint32_t> globalOf(nShapes);
+    leaderCluster(captures, shapeRep, localLeaders, opt.threshold, globalLeaders, globalOf);
+
+    // 4. Collect, biggest cluster first
+    std::unordered_map<uint32_t, size_t> clusterOfLeader;
+    std::vector<TimingCluster> clusters;
+    for (size_t i = 0; i < captures.size(); i++)
+    {
+        const uint32_t leader = globalOf[leaderOf[shapeOf[i]]];
+        const auto it = clusterOfLeader.emplace(leader, clusters.size());
+        if (it.second)
+            clusters.emplace_back();
+        clusters[it.first->second].members.push_back(i);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const TimingCluster &a, const TimingCluster &b)
+                     { return a.members.size() > b.members.size(); });
+    return clusters;
+}
+
+// ===== Protocol timing inference =====
+struct WidthBin
+{
+    uint32_t center; // median
+    size_t count;
+};
+
+// 1-D clustering of pulse widths: sorted values split wherever the next one
+// is more than kBinTolerance wider. Bins are returned most populated first.
+static std::vector<WidthBin> binWidths(std::vector<uint32_t> v)
+{
+    std::vector<WidthBin> bins;
+    if (v.empty())
+        return bins;
+    std::sort(v.begin(), v.end());
+    size_t start = 0;
+    for (size_t i = 1; i <= v.size(); i++)
+    {
+        if (i == v.size() || (double)v[i] > (double)v[i - 1] * (1.0 + kBinTolerance) + 50)
+        {
+            bins.push_back({v[start + (i - start) / 2], i - start});
+            start = i;
+        }
+    }
+    std::stable_sort(bins.begin(), bins.end(), [](const WidthBin &a, const WidthBin &b)
+                     { return a.count > b.count; });
+    return bins;
+}
+
+static uint32_t median(std::vector<uint32_t> v)
+{
+    if (v.empty())
+        return 0;
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    return v[v.size() / 2];
+}
+
+// Two bins are a 0/1 pair when the runner-up is common enough to be data
+// and clearly wider or narrower than the leader.
+static bool isBitPair(const std::vector<WidthBin> &bins)
+{
+    if (bins.size() < 2 || bins[1].count * 8 < bins[0].count)
+        return false;
+    const double lo = std::min(bins[0].center, bins[1].center);
+    const double hi = std::max(bins[0].center, bins[1].center);
+    return hi > lo * 1.4;
+}
+
+static uint32_t gapLimit(const ProtocolTiming &t)
+{
+    return 3 * std::max(std::max(t.zeroSpace, t.oneSpace), t.bitMark);
+}
+
+struct DecodeResult
+{
+    std::vector<uint8_t> bits;
+    size_t frames = 0;
+};
+
+static DecodeResult decode(const std::vector<uint32_t> &raw, const ProtocolTiming &t)
+{
+    DecodeResult r;
+    if (t.encoding == BitEncoding::Unknown)
+        return r;
+    r.bits.reserve(raw.size() / 2);
+
+    const uint32_t limit = gapLimit(t);
+    bool inFrame = false;
+    // raw[0] is the gap before the capture; marks sit at odd indices
+    for (size_t i = 1; i < raw.size(); i += 2)
+    {
+        const uint32_t mark = raw[i];
+        const uint32_t space = i + 1 < raw.size() ? raw[i + 1] : 0;
+
+        if (t.headerMark && mark > t.bitMark * kHeaderFactor)
+        {
+            inFrame = false; // header of the next section
+            continue;
+        }
+        if (space == 0 || space > limit)
+        {
+            // Stop bit before a gap, or the trailing mark
+            inFrame = false;
+            continue;
+        }
+
+        bool one;
+        if (t.encoding == BitEncoding::PulseDistance)
+            one = fabs((double)space - t.oneSpace) * t.zeroSpace < fabs((double)space - t.zeroSpace) * t.oneSpace;
+        else
+            one = fabs((double)mark - t.oneSpace) * t.bitMark < fabs((double)mark - t.bitMark) * t.oneSpace;
+
+        if (!inFrame)
+        {
+            r.frames++;
+            inFrame = true;
+        }
+        r.bits.push_back(one ? 1 : 0);
+    }
+    return r;
+}
+
+ProtocolTiming inferTiming(const std::vector<const std::vector<uint32_t> *> &raws)
+{
+    ProtocolTiming t;
+    std::vector<uint32_t> marks;
+    std::vector<uint32_t> spaces;
+    for (const std::vector<uint32_t> *raw : raws)
+    {
+        for (size_t i = 1; i < raw->size(); i++)
+            (i & 1 ? marks : spaces).push_back((*raw)[i]);
+    }
+
+    const std::vector<WidthBin> markBins = binWidths(marks);
+    if (markBins.empty())
+        return t;
+    const uint32_t commonMark = markBins[0].center;
+
+    // Header: a leading mark well above the common one
+    std::vector<uint32_t> hdrMarks;
+    std::vector<uint32_t> hdrSpaces;
+    for (const std::vector<uint32_t> *raw : raws)
+    {
+        if (raw->size() > 2 && (*raw)[1] > commonMark * kHeaderFactor)
+        {
+            hdrMarks.push_back((*raw)[1]);
+            hdrSpaces.push_back((*raw)[2]);
+        }
+    }
+    if (hdrMarks.size() * 2 >= raws.size())
+    {
+        t.headerMark = median(hdrMarks);
+        t.headerSpace = median(hdrSpaces);
+    }
+
+    // Data widths: drop header pulses before binning so a short message's
+    // header does not win the space histogram
+    std::vector<uint32_t> dataMarks;
+    std::vector<uint32_t> dataSpaces;
+    for (const std::vector<uint32_t> *raw : raws)
+    {
+        for (size_t i = 1; i < raw->size(); i += 2)
+        {
+            const uint32_t mark = (*raw)[i];
+            if (t.headerMark && mark > commonMark * kHeaderFactor)
+                continue;
+            dataMarks.push_back(mark);
+            if (i + 1 < raw->size())
+                dataSpaces.push_back((*raw)[i + 1]);
+        }
+    }
+
+    const std::vector<WidthBin> spaceBins = binWidths(dataSpaces);
+    const std::vector<WidthBin> dataMarkBins = binWidths(dataMarks);
+    if (spaceBins.empty() || dataMarkBins.empty())
+        return t;
+
+    if (isBitPair(spaceBins))
+    {
+        t.encoding = BitEncoding::PulseDistance;
+        t.bitMark = dataMarkBins[0].center;
+        t.zeroSpace = std::min(spaceBins[0].center, spaceBins[1].center);
+        t.oneSpace = std::max(spaceBins[0].center, spaceBins[1].center);
+    }
+    else if (isBitPair(dataMarkBins))
+    {
+        t.encoding = BitEncoding::PulseWidth;
+        t.bitMark = std::min(dataMarkBins[0].center, dataMarkBins[1].center);
+        t.oneSpace = std::max(dataMarkBins[0].center, dataMarkBins[1].center);
+        t.zeroSpace = spaceBins[0].center;
+    }
+    else
+    {
+        return t;
+    }
+
+    const uint32_t limit = gapLimit(t);
+    std::vector<uint32_t> gaps;
+    for (uint32_t s : dataSpaces)
+        if (s > limit)
+            gaps.push_back(s);
+    t.gapSpace = median(gaps);
+
+    const DecodeResult first = decode(*raws[0], t);
+    t.frames = first.frames;
+    t.bitCount = first.bits.size();
+    return t;
+}
+
+ProtocolTiming inferTiming(const std::vector<uint32_t> &rawUs)
+{
+    return inferTiming(std::vector<const std::vector<uint32_t> *>{&rawUs});
+}
+
+std::vector<uint8_t> decodeBits(const std::vector<uint32_t> &rawUs, const ProtocolTiming &t)
+{
+    return decode(rawUs, t).bits;
+}
+
+std::string describeTiming(const ProtocolTiming &t)
+{
+    char buf[256];
+    switch (t.encoding)
+    {
+    case BitEncoding::PulseDistance:
+    {
+        int n = snprintf(buf, sizeof(buf), "pulse-distance:");
+        if (t.headerMark)
+            n += snprintf(buf + n, sizeof(buf) - n, " header %u/%u,", t.headerMark, t.headerSpace);
+        n += snprintf(buf + n, sizeof(buf) - n, " mark %u, zero %u, one %u",
+                      t.bitMark, t.zeroSpace, t.oneSpace);
+        if (t.gapSpace)
+            n += snprintf(buf + n, sizeof(buf) - n, ", gap %u", t.gapSpace);
+        snprintf(buf + n, sizeof(buf) - n, ", %zu section(s), %zu bits", t.frames, t.bitCount);
+        return buf;
+    }
+    case BitEncoding::PulseWidth:
+    {
+        int n = snprintf(buf, sizeof(buf), "pulse-width:");
+        if (t.headerMark)
+            n += snprintf(buf + n, sizeof(buf) - n, " header %u/%u,", t.headerMark, t.headerSpace);
+        n += snprintf(buf + n, sizeof(buf) - n, " zero mark %u, one mark %u, space %u",
+                      t.bitMark, t.oneSpace, t.zeroSpace);
+        if (t.gapSpace)
+            n += snprintf(buf + n, sizeof(buf) - n, ", gap %u", t.gapSpace);
+        snprintf(buf + n, sizeof(buf) - n, ", %zu section(s), %zu bits", t.frames, t.bitCount);
+        return buf;
+    }
+    default:
+        return "unknown encoding (no 0/1 width pair found)";
+    }
+}
+
+// ===== Temperature diff =====
+bool parseTemperatureLabel(const std::string &label, std::string &group, double &temp)
+{
+    size_t end = label.size();
+    while (end && (label[end - 1] == ' ' || label[end - 1] == 'C' || label[end - 1] == 'c'))
+        end--;
+    size_t start = end;
+    while (start && ((label[start - 1] >= '0' && label[start - 1] <= '9') || label[start - 1] == '.'))
+        start--;
+    if (start == end || label[start] == '.')
+        return false;
+
+    char *stop = nullptr;
+    const std::string num = label.substr(start, end - start);
+    temp = strtod(num.c_str(), &stop);
+    if (*stop != '\0')
+        return false;
+
+    while (start && (label[start - 1] == '_' || label[start - 1] == ' ' || label[start - 1] == '-'))
+        start--;
+    group = label.substr(0, start);
+    return true;
+}
+
+static double fieldValue(const std::vector<uint8_t> &bits, size_t start, size_t width, bool msbFirst)
+{
+    uint32_t v = 0;
+    for (size_t k = 0; k < width; k++)
+    {
+        const uint8_t b = bits[start + k];
+        if (msbFirst)
+            v = (v << 1) | b;
+        else
+            v |= (uint32_t)b << k;
+    }
+    return (double)v;
+}
+
+// Least-squares line through (x, value), worst residual in `maxError`
+static bool fitLine(const std::vector<double> &xs, const std::vector<double> &values,
+                    double &slope, double &offset, double &maxError)
+{
+    const double n = (double)xs.size();
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t k = 0; k < xs.size(); k++)
+    {
+        sx += xs[k];
+        sy += values[k];
+        sxx += xs[k] * xs[k];
+        sxy += xs[k] * values[k];
+    }
+    const double den = n * sxx - sx * sx;
+    if (fabs(den) < 1e-9)
+        return false;
+    slope = (n * sxy - sx * sy) / den;
+    offset = (sy - slope * sx) / n;
+    if (fabs(slope) < 1e-6)
+        return false;
+    maxError = 0;
+    for (size_t k = 0; k < xs.size(); k++)
+        maxError = std::max(maxError, fabs(slope * xs[k] + offset - values[k]));
+    return true;
+}
+
+TempDiffReport diffTemperatureSteps(std::vector<TempStep> steps)
+{
+    TempDiffReport r;
+    std::stable_sort(steps.begin(), steps.end(), [](const TempStep &a, const TempStep &b)
+                     { return a.temp < b.temp; });
+    steps.erase(std::unique(steps.begin(), steps.end(), [](const TempStep &a, const TempStep &b)
+                            { return a.temp == b.temp; }),
+                steps.end());
+    r.steps = steps.size();
+    if (steps.size() < 2)
+        return r;
+
+    r.bitCount = steps[0].bits.size();
+    for (const TempStep &s : steps)
+        r.bitCount = std::min(r.bitCount, s.bits.size());
+
+    std::vector<uint8_t> changing(r.bitCount, 0);
+    for (size_t i = 0; i < r.bitCount; i++)
+    {
+        for (const TempStep &s : steps)
+        {
+            if (s.bits[i] != steps[0].bits[i])
+            {
+                changing[i] = 1;
+                r.changingBits.push_back(i);
+                break;
+            }
+        }
+    }
+    if (r.changingBits.empty())
+        return r;
+
+    // Every window of up to 8 bits bounded by changing bits, both bit
+    // orders, fitted against the set point and against whole degrees (for
+    // remotes that carry the .5 in a separate flag). A fit is kept when the
+    // worst residual is under half a field step.
+    struct Candidate
+    {
+        TempField field;
+        size_t covered;
+        bool exact;
+        bool inTail; // overlaps the last byte, where checksums live
+    };
+    std::vector<Candidate> candidates;
+    std::vector<double> temps(steps.size());
+    std::vector<double> whole(steps.size());
+    for (size_t k = 0; k < steps.size(); k++)
+    {
+        temps[k] = steps[k].temp;
+        whole[k] = floor(steps[k].temp);
+    }
+    std::vector<double> values(steps.size());
+    const size_t first = r.changingBits.front();
+    const size_t last = r.changingBits.back();
+    for (size_t start = first; start <= last; start++)
+    {
+        if (!changing[start])
+            continue;
+        size_t covered = 0;
+        for (size_t width = 1; width <= 8 && start + width <= r.bitCount; width++)
+        {
+            covered += changing[start + width - 1];
+            if (!changing[start + width - 1])
+                continue;
+
+            for (int order = 0; order < 2; order++)
+            {
+                const bool msbFirst = order == 1;
+                if (width == 1 && msbFirst)
+                    continue;
+                for (size_t k = 0; k < steps.size(); k++)
+                    values[k] = fieldValue(steps[k].bits, start, width, msbFirst);
+                for (int x = 0; x < 2; x++)
+                {
+                    TempField f;
+                    f.start = start;
+                    f.width = width;
+                    f.msbFirst = msbFirst;
+                    f.wholeDegrees = x == 1;
+                    if (!fitLine(f.wholeDegrees ? whole : temps, values, f.slope, f.offset, f.maxError) ||
+                        f.maxError > 0.51)
+                        continue;
+                    candidates.push_back({f, covered, f.maxError < 0.01,
+                                          start + width + 8 > r.bitCount});
+                }
+            }
+        }
+    }
+
+    // Exact fits first; a sum checksum is linear in the set point too, so
+    // fields clear of the trailing byte beat equally good ones inside it
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+                     {
+                         if (a.exact != b.exact)
+                             return a.exact;
+                         if (a.inTail != b.inTail)
+                             return b.inTail;
+                         if (a.covered != b.covered)
+                             return a.covered > b.covered;
+                         if (a.field.width != b.field.width)
+                             return a.field.width < b.field.width;
+                         return a.field.maxError < b.field.maxError; });
+    for (size_t k = 0; k < candidates.size() && r.fields.size() < 3; k++)
+    {
+        // One entry per bit window
+        bool dup = false;
+        for (const TempField &f : r.fields)
+            dup |= f.start == candidates[k].field.start && f.width == candidates[k].field.width;
+        if (!dup)
+            r.fields.push_back(candidates[k].field);
+    }
+
+    const TempField *best = r.fields.empty() ? nullptr : &r.fields[0];
+    for (size_t i : r.changingBits)
+        if (!best || i < best->start || i >= best->start + best->width)
+            r.unexplained.push_back(i);
+    return r;
+}
+
+std::string formatBitRanges(const std::vector<size_t> &bits)
+{
+    std::string out;
+    for (size_t i = 0; i < bits.size();)
+    {
+        size_t j = i;
+        while (j + 1 < bits.size() && bits[j + 1] == bits[j] + 1)
+            j++;
+        if (!out.empty())
+            out += ',';
+        out += std::to_string(bits[i]);
+        if (j > i)
+            out += '-' + std::to_string(bits[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+// ===== Truncation =====
+const char *truncationReason(const Capture &c, uint16_t captureBufferSize)
+{
+    const size_t n = c.rawUs.size();
+    if (captureBufferSize && n + 1 >= captureBufferSize)
+        return "filled the capture buffer";
+    if (n >= 2 && (n & 1))
+        return "ends on a space";
+    return nullptr;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "capture_reader.h"
+
+struct AnalysisOptions
+{
+    double threshold = 0.20;           // max mean relative timing difference within a cluster
+    unsigned threads = 0;              // 0 = std::thread::hardware_concurrency()
+    uint16_t captureBufferSize = 1024; // kCaptureBufferSize of the capturing firmware
+};
+
+// ===== Clustering =====
+// Leader clustering: a capture joins the nearest cluster leader whose length
+// is within 10% and whose timings differ by less than the threshold (mean
+// relative difference). Identical timing shapes are folded together first,
+// so a dump full of repeated frames costs one comparison per distinct
+// shape; the rest is clustered in parallel chunks whose leaders are merged
+// in a final pass.
+struct TimingCluster
+{
+    std::vector<size_t> members; // indices into the capture vector, ascending
+};
+
+std::vector<TimingCluster> clusterCaptures(const std::vector<Capture> &captures,
+                                           const AnalysisOptions &opt);
+
+// Mean relative difference of the timings (leading gap excluded), or a
+// value > 1 when the lengths are too far apart to compare.
+double timingDistance(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+
+// ===== Protocol timing inference =====
+enum class BitEncoding
+{
+    Unknown,
+    PulseDistance, // constant mark, the space carries the bit (NEC, most AC remotes)
+    PulseWidth     // constant space, the mark carries the bit (Sony)
+};
+
+struct ProtocolTiming
+{
+    BitEncoding encoding = BitEncoding::Unknown;
+    uint32_t headerMark = 0; // 0 if the frame has no header
+    uint32_t headerSpace = 0;
+    uint32_t bitMark = 0; // PulseWidth: zero mark
+    uint32_t zeroSpace = 0;
+    uint32_t oneSpace = 0; // PulseWidth: the one mark
+    uint32_t gapSpace = 0; // space between sections of a multi-frame message, 0 if none
+    size_t frames = 0;     // sections per message
+    size_t bitCount = 0;   // data bits over all sections
+};
+
+// Infers the timing from the mark/space histograms of one or several
+// captures of the same protocol.
+ProtocolTiming inferTiming(const std::vector<const std::vector<uint32_t> *> &raws);
+ProtocolTiming inferTiming(const std::vector<uint32_t> &rawUs);
+
+// Data bits of one capture (all sections concatenated, first bit first).
+std::vector<uint8_t> decodeBits(const std::vector<uint32_t> &rawUs, const ProtocolTiming &t);
+
+std::string describeTiming(const ProtocolTiming &t);
+
+// ===== Temperature diff =====
+// Splits "COOL_24.5" / "heat 21" into the group ("COOL") and the set point.
+bool parseTemperatureLabel(const std::string &label, std::string &group, double &temp);
+
+struct TempStep
+{
+    double temp;
+    std::vector<uint8_t> bits;
+};
+
+struct TempField
+{
+    size_t start = 0; // first bit index in the payload
+    size_t width = 0;
+    bool msbFirst = false;     // bit `start` is the MSB of the field
+    bool wholeDegrees = false; // fitted against floor(temp), the .5 lives elsewhere
+    double slope = 0;          // field = slope * temp + offset
+    double offset = 0;
+    double maxError = 0; // worst residual over the steps, in field units
+};
+
+struct TempDiffReport
+{
+    size_t steps = 0;
+    size_t bitCount = 0;              // bits compared (shortest payload)
+    std::vector<size_t> changingBits; // positions that differ between steps
+    std::vector<TempField> fields;    // best linear encodings, best first
+    std::vector<size_t> unexplained;  // changing bits outside fields[0] (checksums, toggles)
+};
+
+// Steps are sorted by temperature; steps with equal temperature keep the
+// first payload.
+TempDiffReport diffTemperatureSteps(std::vector<TempStep> steps);
+
+// Compact "3-7,40,104-111" form of a sorted bit list
+std::string formatBitRanges(const std::vector<size_t> &bits);
+
+// ===== Truncation =====
+// IRrecv stops storing once rawbuf is full, so a capture that filled the
+// buffer lost its tail. A capture ending on a space (odd number of edges
+// after the leading gap) was cut off too.
+const char *truncationReason(const Capture &c, uint16_t captureBufferSize);
@@ -0,0 +1,314 @@
+// ir_analyze: offline analysis of IR captures (ir_dump_esp8266 JSON lines,
+// ir_dump_decode output, learned /ac/*.json files of controller_node).
+//
+//   ir_analyze [-t THRESHOLD] [-j THREADS] [-b BUFSIZE] [-n MAX_CLUSTERS] INPUT...
+//   ir_analyze bench [-p PROTOCOLS] [-r REPEATS] [-j THREADS]
+//
+// INPUT is a file or a directory searched for *.json / *.jsonl. The report
+// lists timing clusters with the inferred protocol timing, the payload
+// bits that follow the set point for labels like COOL_24.5, and captures
+// that look truncated against the firmware's kCaptureBufferSize (BUFSIZE).
+//
+// `bench` runs the same pipeline on a synthetic corpus and checks that the
+// known protocols and temperature fields are recovered.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "capture_reader.h"
+#include "ir_analysis.h"
+#include "synthetic_corpus.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Captures per cluster fed to timing inference
+static const size_t kMaxInferenceSamples = 64;
+
+static double msSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-t THRESHOLD] [-j THREADS] [-b BUFSIZE] [-n MAX_CLUSTERS] INPUT...\n"
+            "       %s bench [-p PROTOCOLS] [-r REPEATS] [-j THREADS]\n",
+            argv0, argv0);
+}
+
+struct ClusterAnalysis
+{
+    ProtocolTiming timing;
+    // group -> steps, for clusters holding a temperature sweep
+    std::map<std::string, TempDiffReport> diffs;
+};
+
+static ClusterAnalysis analyzeCluster(const std::vector<Capture> &captures, const TimingCluster &cluster)
+{
+    ClusterAnalysis a;
+
+    // Evenly spaced sample so a sweep is not inferred from one end only
+    std::vector<const std::vector<uint32_t> *> sample;
+    const size_t n = cluster.members.size();
+    const size_t take = std::min(n, kMaxInferenceSamples);
+    for (size_t k = 0; k < take; k++)
+        sample.push_back(&captures[cluster.members[k * n / take]].rawUs);
+    a.timing = inferTiming(sample);
+    if (a.timing.encoding == BitEncoding::Unknown)
+        return a;
+
+    std::map<std::string, std::vector<TempStep>> groups;
+    for (size_t idx : cluster.members)
+    {
+        std::string group;
+        double temp;
+        if (parseTemperatureLabel(captures[idx].label, group, temp))
+            groups[group].push_back({temp, decodeBits(captures[idx].rawUs, a.timing)});
+    }
+    for (auto &g : groups)
+    {
+        TempDiffReport r = diffTemperatureSteps(std::move(g.second));
+        if (r.steps >= 2)
+            a.diffs[g.first] = std::move(r);
+    }
+    return a;
+}
+
+static void printCluster(FILE *out, size_t no, const std::vector<Capture> &captures,
+                         const TimingCluster &cluster, const ClusterAnalysis &a)
+{
+    size_t totalLen = 0;
+    std::map<std::string, size_t> labels;
+    std::map<std::string, size_t> protocols;
+    for (size_t idx : cluster.members)
+    {
+        totalLen += captures[idx].rawUs.size();
+        labels[captures[idx].label]++;
+        if (!captures[idx].protocol.empty())
+            protocols[captures[idx].protocol]++;
+    }
+
+    fprintf(out, "#%zu  %zu capture(s), ~%zu edges", no, cluster.members.size(),
+            totalLen / cluster.members.size());
+    if (!protocols.empty())
+    {
+        auto best = protocols.begin();
+        for (auto it = protocols.begin(); it != protocols.end(); ++it)
+            if (it->second > best->second)
+                best = it;
+        fprintf(out, ", firmware says %s", best->first.c_str());
+    }
+    fprintf(out, "\n    labels: ");
+    size_t shown = 0;
+    for (const auto &l : labels)
+    {
+        if (shown == 6)
+        {
+            fprintf(out, " ... (%zu distinct)", labels.size());
+            break;
+        }
+        fprintf(out, "%s%s", shown ? ", " : "", l.first.empty() ? "<none>" : l.first.c_str());
+        shown++;
+    }
+    fprintf(out, "\n    timing: %s\n", describeTiming(a.timing).c_str());
+
+    for (const auto &d : a.diffs)
+    {
+        const TempDiffReport &r = d.second;
+        fprintf(out, "    temperature sweep '%s': %zu steps over %zu bits\n",
+                d.first.c_str(), r.steps, r.bitCount);
+        fprintf(out, "      changing bits: %s\n",
+                r.changingBits.empty() ? "none" : formatBitRanges(r.changingBits).c_str());
+        for (size_t k = 0; k < r.fields.size(); k++)
+        {
+            const TempField &f = r.fields[k];
+            fprintf(out, "      %s bits %zu-%zu %s: value = %.2f * %s %+.2f%s\n",
+                    k ? "alt " : "field", f.start, f.start + f.width - 1,
+                    f.msbFirst ? "MSB-first" : "LSB-first", f.slope,
+                    f.wholeDegrees ? "floor(T)" : "T", f.offset,
+                    f.maxError < 0.01 ? " (exact)" : " (approx.)");
+        }
+        if (!r.unexplained.empty())
+            fprintf(out, "      other changing bits: %s (checksum / half-degree flags?)\n",
+                    formatBitRanges(r.unexplained).c_str());
+    }
+}
+
+static int runReport(int argc, char **argv)
+{
+    AnalysisOptions opt;
+    size_t maxClusters = 20;
+    std::vector<const char *> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            opt.threshold = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            opt.threads = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            opt.captureBufferSize = (uint16_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            maxClusters = (size_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        else
+            inputs.push_back(argv[i]);
+    }
+    if (inputs.empty() || opt.threshold <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Clock::time_point t0 = Clock::now();
+    std::vector<Capture> captures;
+    for (const char *path : inputs)
+    {
+        std::string error;
+        if (!readCaptures(path, captures, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    const double parseMs = msSince(t0);
+
+    t0 = Clock::now();
+    const std::vector<TimingCluster> clusters = clusterCaptures(captures, opt);
+    const double clusterMs = msSince(t0);
+
+    printf("%zu capture(s) read in %.1f ms, %zu cluster(s) at threshold %.2f in %.1f ms\n\n",
+           captures.size(), parseMs, clusters.size(), opt.threshold, clusterMs);
+
+    for (size_t c = 0; c < clusters.size() && c < maxClusters; c++)
+    {
+        printCluster(stdout, c + 1, captures, clusters[c], analyzeCluster(captures, clusters[c]));
+        printf("\n");
+    }
+    if (clusters.size() > maxClusters)
+        printf("(%zu smaller cluster(s) not shown, see -n)\n\n", clusters.size() - maxClusters);
+
+    size_t truncated = 0;
+    for (const Capture &c : captures)
+    {
+        const char *why = truncationReason(c, opt.captureBufferSize);
+        if (!why)
+            continue;
+        if (truncated++ == 0)
+            printf("possibly truncated (capture buffer %u):\n", opt.captureBufferSize);
+        printf("  %s [%s] %zu edges: %s\n", c.source.c_str(), c.label.c_str(), c.rawUs.size(), why);
+    }
+    if (!truncated)
+        printf("no truncated captures (capture buffer %u)\n", opt.captureBufferSize);
+    return 0;
+}
+
+static int runBench(int argc, char **argv)
+{
+    SyntheticCorpusOptions corpus;
+    AnalysisOptions opt;
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            corpus.protocols = (size_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            corpus.repeatsPerStep = (size_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            opt.threads = (unsigned)atoi(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!corpus.protocols || !corpus.repeatsPerStep)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *f = tmpfile();
+    if (!f)
+    {
+        perror("tmpfile");
+        return 1;
+    }
+    std::vector<SyntheticProtocolInfo> info(corpus.protocols);
+    Clock::time_point t0 = Clock::now();
+    const size_t generated = writeSyntheticCorpus(f, corpus, info.data());
+    const long bytes = ftell(f);
+    const double genMs = msSince(t0);
+    rewind(f);
+
+    t0 = Clock::now();
+    std::vector<Capture> captures;
+    captures.reserve(generated);
+    CaptureReader reader(f, "synthetic");
+    Capture c;
+    while (reader.next(c))
+        captures.push_back(std::move(c));
+    fclose(f);
+    const double parseMs = msSince(t0);
+    if (!reader.error().empty() || captures.size() != generated)
+    {
+        fprintf(stderr, "bench: parse failed: %s\n", reader.error().c_str());
+        return 1;
+    }
+
+    t0 = Clock::now();
+    const std::vector<TimingCluster> clusters = clusterCaptures(captures, opt);
+    const double clusterMs = msSince(t0);
+
+    t0 = Clock::now();
+    std::vector<ClusterAnalysis> analyses;
+    for (const TimingCluster &cl : clusters)
+        analyses.push_back(analyzeCluster(captures, cl));
+    const double inferMs = msSince(t0);
+
+    // Each protocol should come back as one cluster whose sweep locates the
+    // temperature field (5 bits LSB-first at the generator's offset)
+    size_t recovered = 0;
+    for (const ClusterAnalysis &a : analyses)
+    {
+        for (const auto &d : a.diffs)
+        {
+            const size_t p = (size_t)atoi(d.first.c_str() + 1);
+            if (p < info.size() && !d.second.fields.empty() &&
+                d.second.fields[0].start == info[p].tempFieldStart && !d.second.fields[0].msbFirst)
+                recovered++;
+        }
+    }
+
+    const double totalMs = parseMs + clusterMs + inferMs;
+    printf("corpus:    %zu captures, %zu protocols, %.1f MB (generated in %.0f ms)\n",
+           generated, corpus.protocols, bytes / 1e6, genMs);
+    printf("parse:     %8.1f ms  (%.0f captures/s, %.0f MB/s)\n",
+           parseMs, generated / (parseMs / 1e3), bytes / 1e6 / (parseMs / 1e3));
+    printf("cluster:   %8.1f ms  (%zu clusters)\n", clusterMs, clusters.size());
+    printf("infer:     %8.1f ms\n", inferMs);
+    printf("total:     %8.1f ms  (%.0f captures/s)\n", totalMs, generated / (totalMs / 1e3));
+    printf("recovered: %zu/%zu temperature fields\n", recovered, corpus.protocols);
+    return clusters.size() == corpus.protocols && recovered == corpus.protocols ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "bench"))
+        return runBench(argc, argv);
+    return runReport(argc, argv);
+}
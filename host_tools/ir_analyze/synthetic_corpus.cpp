@@ -0,0 +1,117 @@
+#include "synthetic_corpus.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Protocol
+    {
+        uint32_t headerMark;
+        uint32_t headerSpace;
+        uint32_t bitMark;
+        uint32_t zeroSpace;
+        uint32_t oneSpace;
+        uint32_t gapSpace;
+        size_t sections;
+        size_t tempByte;
+        std::vector<uint8_t> bytes; // fixed part of the state, checksum last
+    };
+
+    uint32_t uniform(std::mt19937 &rng, uint32_t lo, uint32_t hi)
+    {
+        return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);
+    }
+}
+
+size_t writeSyntheticCorpus(FILE *out, const SyntheticCorpusOptions &opt, SyntheticProtocolInfo *info)
+{
+    std::mt19937 rng(opt.seed);
+    std::uniform_real_distribution<double> jitter(-opt.jitter, opt.jitter);
+
+    std::vector<Protocol> protocols(opt.protocols);
+    for (size_t p = 0; p < protocols.size(); p++)
+    {
+        Protocol &pr = protocols[p];
+        pr.headerMark = uniform(rng, 3000, 9000);
+        pr.headerSpace = pr.headerMark / 2;
+        pr.bitMark = uniform(rng, 400, 650);
+        pr.zeroSpace = pr.bitMark * uniform(rng, 90, 110) / 100;
+        pr.oneSpace = pr.zeroSpace * uniform(rng, 280, 320) / 100;
+        pr.gapSpace = uniform(rng, 20000, 40000);
+        pr.sections = 1 + p % 2;
+        pr.bytes.resize(uniform(rng, 6, 14));
+        for (uint8_t &b : pr.bytes)
+            b = (uint8_t)uniform(rng, 0, 255);
+        pr.tempByte = uniform(rng, 1, (uint32_t)pr.bytes.size() - 2);
+        if (info)
+            info[p].tempFieldStart = pr.tempByte * 8;
+    }
+
+    std::string line;
+    std::vector<uint32_t> raw;
+    size_t written = 0;
+    uint32_t tsMs = 0;
+    for (size_t p = 0; p < protocols.size(); p++)
+    {
+        const Protocol &pr = protocols[p];
+        for (int half = 0; half <= 32; half++)
+        {
+            const double temp = 16.0 + half * 0.5;
+
+            // bits 0-4: whole degrees above 16, bit 6: +0.5
+            std::vector<uint8_t> state = pr.bytes;
+            state[pr.tempByte] = (uint8_t)((state[pr.tempByte] & 0xA0) | (half / 2) | ((half & 1) << 6));
+            uint8_t sum = 0;
+            for (size_t i = 0; i + 1 < state.size(); i++)
+                sum = (uint8_t)(sum + state[i]);
+            state.back() = sum;
+
+            for (size_t rep = 0; rep < opt.repeatsPerStep; rep++)
+            {
+                auto jit = [&](uint32_t us)
+                { return (uint32_t)(us * (1.0 + jitter(rng))); };
+
+                raw.clear();
+                raw.push_back(uniform(rng, 30000, 65000)); // leading gap
+                const size_t perSection = (state.size() + pr.sections - 1) / pr.sections;
+                for (size_t s = 0; s < pr.sections; s++)
+                {
+                    raw.push_back(jit(pr.headerMark));
+                    raw.push_back(jit(pr.headerSpace));
+                    const size_t end = std::min(state.size(), (s + 1) * perSection);
+                    for (size_t i = s * perSection; i < end; i++)
+                    {
+                        for (int k = 0; k < 8; k++)
+                        {
+                            raw.push_back(jit(pr.bitMark));
+                            raw.push_back(jit((state[i] >> k) & 1 ? pr.oneSpace : pr.zeroSpace));
+                        }
+                    }
+                    raw.push_back(jit(pr.bitMark)); // stop mark
+                    if (s + 1 < pr.sections)
+                        raw.push_back(jit(pr.gapSpace));
+                }
+
+                char head[96];
+                snprintf(head, sizeof(head),
+                         "{\"btn\":\"P%zu_COOL_%.1f\",\"ts_ms\":%u,\"protocol\":\"UNKNOWN\",\"bits\":0,\"raw_us\":[",
+                         p, temp, tsMs);
+                tsMs += 180;
+                line = head;
+                for (size_t i = 0; i < raw.size(); i++)
+                {
+                    if (i)
+                        line += ',';
+                    line += std::to_string(raw[i]);
+                }
+                line += "]}\n";
+                fwrite(line.data(), 1, line.size(), out);
+                written++;
+            }
+        }
+    }
+    return written;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Synthetic AC remote captures for `ir_analyze bench`: each protocol has
+// its own header/bit timing, a 4-bit temperature field plus a half-degree
+// bit and a checksum byte, swept over 16.0..32.0 C in 0.5 steps with
+// timing jitter. Written as ir_dump_esp8266 JSON lines.
+struct SyntheticCorpusOptions
+{
+    size_t protocols = 8;
+    size_t repeatsPerStep = 12; // captures per (protocol, temperature)
+    double jitter = 0.06;       // max relative timing error
+    uint32_t seed = 1;
+};
+
+struct SyntheticProtocolInfo
+{
+    size_t tempFieldStart; // LSB-first, value = temp - 16
+};
+
+// Returns the number of captures written
+size_t writeSyntheticCorpus(FILE *out, const SyntheticCorpusOptions &opt,
+                            SyntheticProtocolInfo *info /* opt.protocols entries, may be null */);
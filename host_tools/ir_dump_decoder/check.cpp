@@ -0,0 +1,404 @@
+// ir_dump_decoder_check: round trips of the ir_dump_esp8266 binary dump
+// (firmware/nodes_platformio/lib/ir_wire/ir_wire.cpp) and the host stream
+// decoder next to it.
+//
+//   ir_dump_decoder_check [-n CAPTURES] [-s SEED]
+//
+// CAPTURES (5000) random captures, empty to 1024 timings, with and without
+// value, label and repeat count, and over-long strings: each is built with
+// irWireBuildPayload, COBS-encoded in random pieces by CobsStreamEncoder,
+// decoded by cobsDecode and parsed back field by field. A truncated payload
+// and single-bit flips must fail the parse. Then the same captures as
+// one stream, console text in between, fed to IrDumpStreamDecoder in random
+// chunks, and again with frames damaged on the way (bad CRC, cut short,
+// stray zero bytes, bytes lost): every damaged frame is rejected, every
+// other one comes back intact and the text is still text. Last, seqs that
+// skip and go back (the node rebooting mid-stream) against a model of the
+// gap and reset counts. Exits non-zero on failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ir_dump_decoder.h"
+#include "ir_wire.h"
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        if (!(cond))                                                                                              \
+        {                                                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                                                  \
+            fprintf(stderr, __VA_ARGS__);                                                                         \
+            fputc('\n', stderr);                                                                                  \
+            s_failures++;                                                                                         \
+            return;                                                                                               \
+        }                                                                                                         \
+    } while (0)
+
+/*========== Random captures ==========*/
+struct Capture
+{
+    IrWireHeader hdr;
+    std::string protocol;
+    std::string label;
+    uint16_t usPerTick = 2;
+    std::vector<uint16_t> ticks;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> frame; // 0x00 | COBS | 0x00
+};
+
+static std::string random_string(std::mt19937 &rng, size_t maxLen)
+{
+    std::string s(rng() % (maxLen + 1), ' ');
+    for (char &c : s)
+        c = (char)(rng() % 4 ? 'A' + rng() % 26 : 1 + rng() % 255); // zeros excluded: C strings
+    return s;
+}
+
+static Capture random_capture(std::mt19937 &rng, uint32_t seq)
+{
+    Capture c;
+    const uint16_t count = (uint16_t)(rng() % 8 == 0 ? rng() % 1025 : rng() % 200);
+    c.ticks.resize(count);
+    for (uint16_t &t : c.ticks)
+        t = (uint16_t)(rng() % 3 == 0 ? rng() : rng() % 2000); // zeros and 0xFFFF included
+    c.usPerTick = (uint16_t)(1 + rng() % 4);
+
+    c.protocol = random_string(rng, kIrWireMaxString + 8);
+    c.label = rng() % 2 ? random_string(rng, kIrWireMaxString + 8) : "";
+    c.hdr.seq = seq;
+    c.hdr.tsMs = (uint32_t)rng();
+    c.hdr.protocol = c.protocol.c_str();
+    c.hdr.bits = (uint16_t)rng();
+    c.hdr.hasValue = rng() % 2;
+    c.hdr.value = ((uint64_t)rng() << 32 | rng()) >> (rng() % 64);
+    c.hdr.label = c.label.c_str();
+    c.hdr.hasRepeats = rng() % 2;
+    c.hdr.repeats = c.hdr.hasRepeats ? (uint16_t)rng() : 0;
+
+    c.payload.resize(irWireMaxPayloadSize(count));
+    c.payload.resize(irWireBuildPayload(c.hdr, c.ticks.data(), count, c.usPerTick, c.payload.data(),
+                                        c.payload.size()));
+
+    // In pieces of 1 to 300 bytes, like pumpBinaryTx() against the UART
+    CobsStreamEncoder enc;
+    enc.begin(c.payload.data(), c.payload.size());
+    uint8_t piece[300];
+    while (enc.busy())
+    {
+        const size_t n = enc.read(piece, 1 + rng() % sizeof(piece));
+        c.frame.insert(c.frame.end(), piece, piece + n);
+    }
+    return c;
+}
+
+static bool same_string(const std::string &want, const char *p, size_t len)
+{
+    const size_t n = want.size() < kIrWireMaxString ? want.size() : kIrWireMaxString;
+    return len == n && memcmp(want.data(), p, n) == 0;
+}
+
+// The capture as the stream decoder should hand it over
+static bool same_capture(const Capture &want, const IrCapture &got)
+{
+    if (got.seq != want.hdr.seq || got.tsMs != want.hdr.tsMs || got.bits != want.hdr.bits ||
+        got.hasValue != want.hdr.hasValue || (want.hdr.hasValue && got.value != want.hdr.value) ||
+        got.repeats != want.hdr.repeats || !same_string(want.protocol, got.protocol.data(), got.protocol.size()) ||
+        !same_string(want.label, got.label.data(), got.label.size()) || got.rawUs.size() != want.ticks.size())
+        return false;
+    for (size_t i = 0; i < want.ticks.size(); i++)
+        if (got.rawUs[i] != (uint32_t)want.ticks[i] * want.usPerTick)
+            return false;
+    return true;
+}
+
+/*========== One capture at a time ==========*/
+static void check_round_trip(const Capture &c)
+{
+    s_cases++;
+    const uint16_t count = (uint16_t)c.ticks.size();
+    CHECK(!c.payload.empty() && c.payload.size() <= irWireMaxPayloadSize(count), "seq %u: payload of %zu bytes",
+          (unsigned)c.hdr.seq, c.payload.size());
+
+    // Delimited, and no zero inside
+    const std::vector<uint8_t> &f = c.frame;
+    CHECK(f.size() >= 3 && f.front() == 0 && f.back() == 0, "seq %u: frame not delimited", (unsigned)c.hdr.seq);
+    CHECK(f.size() - 2 <= c.payload.size() + c.payload.size() / 254 + 1, "seq %u: %zu COBS bytes for %zu",
+          (unsigned)c.hdr.seq, f.size() - 2, c.payload.size());
+    for (size_t i = 1; i + 1 < f.size(); i++)
+        CHECK(f[i] != 0, "seq %u: zero at %zu", (unsigned)c.hdr.seq, i);
+
+    std::vector<uint8_t> decoded(f.size());
+    const size_t n = cobsDecode(f.data() + 1, f.size() - 2, decoded.data());
+    CHECK(n == c.payload.size() && memcmp(decoded.data(), c.payload.data(), n) == 0, "seq %u: COBS round trip",
+          (unsigned)c.hdr.seq);
+
+    IrWireView view;
+    CHECK(irWireParsePayload(decoded.data(), n, view), "seq %u: parse failed", (unsigned)c.hdr.seq);
+    const uint8_t flags = (uint8_t)((c.hdr.hasValue ? kIrWireHasValue : 0) | (c.label.empty() ? 0 : kIrWireHasLabel) |
+                                    (c.hdr.hasRepeats ? kIrWireHasRepeats : 0));
+    CHECK(view.flags == flags && view.seq == c.hdr.seq && view.tsMs == c.hdr.tsMs && view.bits == c.hdr.bits &&
+              view.repeats == c.hdr.repeats && (!c.hdr.hasValue || view.value == c.hdr.value) &&
+              view.count == count,
+          "seq %u: header fields differ", (unsigned)c.hdr.seq);
+    CHECK(same_string(c.protocol, view.protocol, view.protocolLen) &&
+              (c.label.empty() ? view.labelLen == 0 : same_string(c.label, view.label, view.labelLen)),
+          "seq %u: strings differ", (unsigned)c.hdr.seq);
+    IrWireTimingReader reader(view);
+    uint32_t us;
+    for (uint16_t i = 0; i < count; i++)
+        CHECK(reader.next(us) && us == (uint32_t)c.ticks[i] * c.usPerTick, "seq %u: timing %u", (unsigned)c.hdr.seq,
+              (unsigned)i);
+    CHECK(!reader.next(us), "seq %u: timings past count", (unsigned)c.hdr.seq);
+
+    // CRC-16 catches any single-bit error and any cut; a sample of each
+    CHECK(!irWireParsePayload(decoded.data(), n - 1, view), "seq %u: truncated payload parsed", (unsigned)c.hdr.seq);
+    for (size_t bit = 0; bit < n * 8; bit += 1 + n / 8)
+    {
+        decoded[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+        CHECK(!irWireParsePayload(decoded.data(), n, view), "seq %u: flipped bit %zu parsed", (unsigned)c.hdr.seq,
+              bit);
+        decoded[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+    }
+}
+
+/*========== Streams ==========*/
+static const char *const kConsole[] = {
+    "[INFO] Ready to receive IR code for button name: 'POWER'\n",
+    "[INFO] captured=12 deduped=3 dropped=0 sent=12 ring_high=2048/12288\n",
+    "[INFO] Capture mode: continuous\n",
+};
+
+enum class Damage
+{
+    None,
+    BadCrc,    // a payload byte changed before encoding
+    Truncated, // the frame cut short, the next one starts right away
+    StrayZero, // zero bytes inside the frame
+    LostBytes, // bytes missing from the middle
+};
+
+struct Sent
+{
+    const Capture *capture;
+    bool intact;
+};
+
+// Feeds `captures` with console text in between to a decoder in random
+// chunks; with `damage`, about a third of the frames are damaged that way
+static void check_stream(const std::vector<Capture> &captures, Damage damage, std::mt19937 &rng)
+{
+    s_cases++;
+    std::vector<uint8_t> stream;
+    std::vector<Sent> sent;
+    std::vector<const char *> lines;
+    size_t damaged = 0;
+
+    for (const Capture &c : captures)
+    {
+        if (rng() % 10 == 0)
+        {
+            const char *line = kConsole[rng() % 3];
+            stream.insert(stream.end(), line, line + strlen(line));
+            lines.push_back(line);
+        }
+
+        std::vector<uint8_t> f = c.frame;
+        const bool hit = damage != Damage::None && rng() % 3 == 0;
+        if (hit)
+        {
+            switch (damage)
+            {
+            case Damage::BadCrc:
+            {
+                std::vector<uint8_t> p = c.payload;
+                p[rng() % p.size()] ^= (uint8_t)(1 + rng() % 255);
+                CobsStreamEncoder enc;
+                enc.begin(p.data(), p.size());
+                f.assign(p.size() + p.size() / 254 + 3, 0);
+                f.resize(enc.read(f.data(), f.size()));
+                break;
+            }
+            case Damage::Truncated:
+                f.resize(1 + rng() % (f.size() - 2)); // the trailing delimiter goes too
+                break;
+            case Damage::StrayZero:
+                // Not next to a delimiter, where a zero is only an empty chunk
+                for (int i = 1 + rng() % 3; i > 0; i--)
+                    f.insert(f.begin() + 2 + rng() % (f.size() - 3), 0);
+                break;
+            case Damage::LostBytes:
+            {
+                const size_t at = 1 + rng() % (f.size() - 2);
+                const size_t n = 1 + rng() % (f.size() - 1 - at);
+                f.erase(f.begin() + at, f.begin() + at + n);
+                break;
+            }
+            case Damage::None:
+                break;
+            }
+            damaged++;
+        }
+        stream.insert(stream.end(), f.begin(), f.end());
+        sent.push_back({&c, !hit});
+    }
+
+    std::vector<IrCapture> got;
+    std::string gotText;
+    IrDumpStreamDecoder decoder([&](const IrCapture &c) { got.push_back(c); },
+                                [&](const std::string &t) { gotText += t; });
+    for (size_t at = 0; at < stream.size();)
+    {
+        const size_t n = std::min(stream.size() - at, (size_t)(1 + rng() % (rng() % 8 ? 64 : 4096)));
+        decoder.feed(stream.data() + at, n);
+        at += n;
+    }
+    decoder.finish();
+
+    // Intact frames in order, damaged ones never
+    size_t g = 0;
+    for (const Sent &s : sent)
+    {
+        if (g < got.size() && got[g].seq == s.capture->hdr.seq)
+        {
+            CHECK(s.intact, "damage %d: damaged frame seq %u accepted", (int)damage, (unsigned)s.capture->hdr.seq);
+            CHECK(same_capture(*s.capture, got[g]), "damage %d: seq %u differs", (int)damage,
+                  (unsigned)s.capture->hdr.seq);
+            g++;
+        }
+        else
+            CHECK(!s.intact, "damage %d: intact frame seq %u lost", (int)damage, (unsigned)s.capture->hdr.seq);
+    }
+    const IrDumpStreamDecoder::Stats &st = decoder.stats();
+    CHECK(g == got.size() && st.frames == got.size(), "damage %d: %zu captures out of order", (int)damage,
+          got.size() - g);
+    CHECK(damage == Damage::None || (damaged > 0 && st.badFrames > 0), "damage %d: %zu damaged, %lu bad frames",
+          (int)damage, damaged, (unsigned long)st.badFrames);
+    CHECK(damage != Damage::None || (st.badFrames == 0 && st.seqGaps == 0), "%lu bad frames, %lu seq gaps",
+          (unsigned long)st.badFrames, (unsigned long)st.seqGaps);
+    // Every line, in order. A line right after a truncated frame shares its
+    // chunk and may go with it; pieces of a damaged frame that happen to be
+    // printable come out as text too
+    size_t at = 0;
+    for (const char *line : lines)
+    {
+        const size_t found = gotText.find(line, at);
+        CHECK(found != std::string::npos || damage == Damage::Truncated, "damage %d: console line lost",
+              (int)damage);
+        if (found != std::string::npos)
+            at = found + strlen(line);
+    }
+    CHECK(damage != Damage::None || at == gotText.size(), "console text differs");
+    CHECK(st.bytes == stream.size(), "damage %d: %lu bytes counted of %zu", (int)damage, (unsigned long)st.bytes,
+          stream.size());
+}
+
+/*========== Seq numbers ==========*/
+// Feeds one small capture per seq and checks the gap and reset counts
+static void check_seqs(const std::vector<uint32_t> &seqs, uint64_t gaps, uint64_t resets, std::mt19937 &rng)
+{
+    s_cases++;
+    std::vector<uint8_t> stream;
+    for (uint32_t seq : seqs)
+    {
+        const Capture c = random_capture(rng, seq);
+        stream.insert(stream.end(), c.frame.begin(), c.frame.end());
+    }
+
+    std::vector<uint32_t> got;
+    IrDumpStreamDecoder decoder([&](const IrCapture &c) { got.push_back(c.seq); });
+    decoder.feed(stream.data(), stream.size());
+    decoder.finish();
+    const IrDumpStreamDecoder::Stats &st = decoder.stats();
+    CHECK(got == seqs, "%zu of %zu captures", got.size(), seqs.size());
+    CHECK(st.seqGaps == gaps && st.seqResets == resets, "%lu gaps, %lu resets; want %lu, %lu",
+          (unsigned long)st.seqGaps, (unsigned long)st.seqResets, (unsigned long)gaps, (unsigned long)resets);
+}
+
+static void check_seq_resets(std::mt19937 &rng)
+{
+    // 7 missed; a reboot after 8 (0..2 missed) and after 4; 1..9 missed;
+    // 10 twice, a reboot that missed 0..9; a long run up near the top; a
+    // reboot there (0, 1 missed)
+    check_seqs({5, 6, 8, 3, 4, 0, 10, 10, 0xFFFFFFF0u, 0xFFFFFFFFu, 2},
+               1 + 3 + 9 + 10 + ((uint64_t)0xFFFFFFF0u - 11) + 14 + 2, 4, rng);
+    check_seqs({0, 1, 2}, 0, 0, rng);
+
+    // Random runs against a model: a seq that goes up misses the ones
+    // between, one that does not is a restart that missed the seqs below it
+    for (int round = 0; round < 50 && !s_failures; round++)
+    {
+        std::vector<uint32_t> seqs;
+        uint64_t gaps = 0;
+        uint64_t resets = 0;
+        uint32_t seq = rng() % 4;
+        for (int i = 0; i < 40; i++)
+        {
+            if (i && seq <= seqs.back())
+            {
+                resets++;
+                gaps += seq;
+            }
+            else if (i)
+                gaps += seq - seqs.back() - 1;
+            seqs.push_back(seq);
+            seq = rng() % 8 ? seq + 1 + (rng() % 4 ? 0 : rng() % 5) : rng() % 3;
+        }
+        check_seqs(seqs, gaps, resets, rng);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long n = 5000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            n = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n CAPTURES] [-s SEED]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<Capture> captures;
+    for (long i = 0; i < n; i++)
+        captures.push_back(random_capture(rng, (uint32_t)i));
+
+    for (const Capture &c : captures)
+    {
+        check_round_trip(c);
+        if (s_failures > 10)
+            break;
+    }
+    if (!s_failures)
+    {
+        check_stream(captures, Damage::None, rng);
+        check_stream(captures, Damage::BadCrc, rng);
+        check_stream(captures, Damage::Truncated, rng);
+        check_stream(captures, Damage::StrayZero, rng);
+        check_stream(captures, Damage::LostBytes, rng);
+        check_seq_resets(rng);
+    }
+
+    if (s_failures)
+    {
+        fprintf(stderr, "%d of %d cases failed\n", s_failures, s_cases);
+        return 1;
+    }
+    printf("ir_dump_decoder_check: %d cases passed\n", s_cases);
+    return 0;
+}
@@ -0,0 +1,317 @@
+#include "ir_dump_decoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+
+#include "ir_wire.h"
+
+// Slack over the largest payload the firmware can produce (COBS adds one
+// byte per 254). Anything longer without a delimiter is console text.
+static const uint16_t kMaxCaptureCount = 1024;
+
+IrDumpStreamDecoder::IrDumpStreamDecoder(CaptureHandler onCapture, TextHandler onText)
+    : _onCapture(std::move(onCapture)), _onText(std::move(onText))
+{
+    const size_t payload = irWireMaxPayloadSize(kMaxCaptureCount);
+    _maxChunk = payload + payload / 254 + 2;
+    _chunk.reserve(_maxChunk);
+    _decoded.resize(_maxChunk);
+}
+
+void IrDumpStreamDecoder::feed(const uint8_t *data, size_t len)
+{
+    _stats.bytes += len;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] == kIrWireDelimiter)
+        {
+            processChunk_();
+            continue;
+        }
+        _chunk.push_back(data[i]);
+        if (_chunk.size() > _maxChunk)
+        {
+            emitText_(_chunk);
+            _chunk.clear();
+        }
+    }
+}
+
+void IrDumpStreamDecoder::finish()
+{
+    processChunk_();
+}
+
+void IrDumpStreamDecoder::processChunk_()
+{
+    if (_chunk.empty())
+        return;
+
+    const size_t n = cobsDecode(_chunk.data(), _chunk.size(), _decoded.data());
+    IrWireView view;
+    if (!n || !irWireParsePayload(_decoded.data(), n, view))
+    {
+        emitText_(_chunk);
+        _chunk.clear();
+        return;
+    }
+    _chunk.clear();
+
+    IrCapture c;
+    c.seq = view.seq;
+    c.tsMs = view.tsMs;
+    c.protocol.assign(view.protocol, view.protocolLen);
+    c.bits = view.bits;
+    c.hasValue = (view.flags & kIrWireHasValue) != 0;
+    c.value = view.value;
+    if (view.labelLen)
+        c.label.assign(view.label, view.labelLen);
+    c.repeats = view.repeats;
+    c.rawUs.reserve(view.count);
+    IrWireTimingReader reader(view);
+    uint32_t us;
+    while (reader.next(us))
+        c.rawUs.push_back(us);
+
+    // The node counts from 0 again after a reboot: a seq that does not go
+    // up starts a new stream, missing the captures before it in that one
+    if (_haveSeq && c.seq <= _lastSeq)
+    {
+        _stats.seqResets++;
+        _stats.seqGaps += c.seq;
+    }
+    else if (_haveSeq)
+        _stats.seqGaps += c.seq - _lastSeq - 1;
+    _haveSeq = true;
+    _lastSeq = c.seq;
+    _stats.frames++;
+
+    if (_onCapture)
+        _onCapture(c);
+}
+
+void IrDumpStreamDecoder::emitText_(const std::vector<uint8_t> &bytes)
+{
+    // Frames only ever fail here when corrupted; printable chunks are the
+    // firmware's "[INFO] ..." lines.
+    size_t printable = 0;
+    for (uint8_t b : bytes)
+        if (b == '\n' || b == '\r' || b == '\t' || (b >= 0x20 && b < 0x7F))
+            printable++;
+
+    if (printable * 10 < bytes.size() * 9)
+    {
+        _stats.badFrames++;
+        return;
+    }
+
+    _stats.textBytes += bytes.size();
+    if (_onText)
+        _onText(std::string(bytes.begin(), bytes.end()));
+}
+
+// ===== Labels =====
+bool IrLabelMap::load(const std::string &path, std::string &error)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line))
+    {
+        lineNo++;
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos)
+            line.erase(hash);
+        const size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos)
+            continue;
+
+        const char *p = line.c_str() + start;
+        char *end = nullptr;
+        const unsigned long first = strtoul(p, &end, 10);
+        unsigned long last = first;
+        if (end == p)
+        {
+            error = path + ":" + std::to_string(lineNo) + ": expected <seq> or <first>-<last>";
+            return false;
+        }
+        if (*end == '-')
+        {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+            if (end == p || last < first)
+            {
+                error = path + ":" + std::to_string(lineNo) + ": bad range";
+                return false;
+            }
+        }
+
+        std::string label(end);
+        const size_t a = label.find_first_not_of(" \t");
+        const size_t b = label.find_last_not_of(" \t\r");
+        if (a == std::string::npos)
+        {
+            error = path + ":" + std::to_string(lineNo) + ": missing label";
+            return false;
+        }
+        add((uint32_t)first, (uint32_t)last, label.substr(a, b - a + 1));
+    }
+    return true;
+}
+
+void IrLabelMap::add(uint32_t first, uint32_t last, const std::string &label)
+{
+    _rules.push_back({first, last, label});
+}
+
+const std::string *IrLabelMap::find(uint32_t seq) const
+{
+    for (auto it = _rules.rbegin(); it != _rules.rend(); ++it)
+        if (seq >= it->first && seq <= it->last)
+            return &it->label;
+    return nullptr;
+}
+
+void IrLabelMap::apply(IrCapture &c) const
+{
+    if (!c.label.empty())
+        return;
+    if (const std::string *label = find(c.seq))
+        c.label = *label;
+}
+
+// ===== Output formatting =====
+static void appendJsonString(std::string &out, const std::string &s)
+{
+    out += '"';
+    for (unsigned char ch : s)
+    {
+        switch (ch)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (ch < 0x20)
+            {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                out += buf;
+            }
+            else
+            {
+                out += (char)ch;
+            }
+        }
+    }
+    out += '"';
+}
+
+static std::string hexValue(uint64_t v)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "0x%llX", (unsigned long long)v);
+    return buf;
+}
+
+std::string irCaptureToJson(const IrCapture &c)
+{
+    std::string out;
+    out.reserve(96 + c.rawUs.size() * 6);
+    out += "{\"seq\":";
+    out += std::to_string(c.seq);
+    out += ",\"btn\":";
+    appendJsonString(out, c.label);
+    out += ",\"ts_ms\":";
+    out += std::to_string(c.tsMs);
+    out += ",\"protocol\":";
+    appendJsonString(out, c.protocol);
+    out += ",\"bits\":";
+    out += std::to_string(c.bits);
+    if (c.repeats)
+    {
+        out += ",\"repeats\":";
+        out += std::to_string(c.repeats);
+    }
+    if (c.hasValue)
+    {
+        out += ",\"value\":\"";
+        out += hexValue(c.value);
+        out += '"';
+    }
+    out += ",\"raw_us\":[";
+    for (size_t i = 0; i < c.rawUs.size(); i++)
+    {
+        if (i)
+            out += ',';
+        out += std::to_string(c.rawUs[i]);
+    }
+    out += "]}";
+    return out;
+}
+
+const char *irCaptureCsvHeader()
+{
+    return "seq,ts_ms,btn,protocol,bits,value,repeats,count,raw_us";
+}
+
+std::string irCaptureToCsv(const IrCapture &c)
+{
+    // Labels are free text typed by the user: quote them
+    std::string label = "\"";
+    for (char ch : c.label)
+    {
+        if (ch == '"')
+            label += '"';
+        label += ch;
+    }
+    label += '"';
+
+    std::string out;
+    out.reserve(64 + c.rawUs.size() * 6);
+    out += std::to_string(c.seq);
+    out += ',';
+    out += std::to_string(c.tsMs);
+    out += ',';
+    out += label;
+    out += ',';
+    out += c.protocol;
+    out += ',';
+    out += std::to_string(c.bits);
+    out += ',';
+    if (c.hasValue)
+        out += hexValue(c.value);
+    out += ',';
+    out += std::to_string(c.repeats);
+    out += ',';
+    out += std::to_string(c.rawUs.size());
+    out += ',';
+    // Timings in one field, space separated
+    for (size_t i = 0; i < c.rawUs.size(); i++)
+    {
+        if (i)
+            out += ' ';
+        out += std::to_string(c.rawUs[i]);
+    }
+    return out;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// One capture decoded from the ir_dump_esp8266 binary stream
+struct IrCapture
+{
+    uint32_t seq = 0;
+    uint32_t tsMs = 0;
+    std::string protocol;
+    uint16_t bits = 0;
+    bool hasValue = false;
+    uint64_t value = 0;
+    std::string label;
+    uint16_t repeats = 0; // identical frames folded in by continuous mode
+    std::vector<uint32_t> rawUs;
+};
+
+// Labels assigned after a continuous-mode session. File format, one rule
+// per line ('#' starts a comment):
+//   <seq> <label>             e.g.  12 POWER_ON
+//   <first>-<last> <label>    e.g.  20-52 COOL_sweep
+// Captures that already carry a label keep it.
+class IrLabelMap
+{
+public:
+    bool load(const std::string &path, std::string &error);
+    void add(uint32_t first, uint32_t last, const std::string &label);
+    // nullptr if no rule covers `seq`
+    const std::string *find(uint32_t seq) const;
+    void apply(IrCapture &c) const;
+    bool empty() const { return _rules.empty(); }
+
+private:
+    struct Rule
+    {
+        uint32_t first;
+        uint32_t last;
+        std::string label;
+    };
+    std::vector<Rule> _rules; // later rules win
+};
+
+// Incremental decoder for the COBS-framed dump stream. Bytes can be fed in
+// any split (e.g. straight from a serial port); console text printed by the
+// firmware between frames is passed to the text handler instead of being
+// treated as corruption.
+class IrDumpStreamDecoder
+{
+public:
+    using CaptureHandler = std::function<void(const IrCapture &)>;
+    using TextHandler = std::function<void(const std::string &)>;
+
+    struct Stats
+    {
+        uint64_t bytes = 0;
+        uint64_t frames = 0;
+        uint64_t badFrames = 0; // COBS/CRC/format errors
+        uint64_t textBytes = 0;
+        uint64_t seqGaps = 0; // frames missing between two received seqs
+        uint64_t seqResets = 0; // seq went back: the node restarted
+    };
+
+    explicit IrDumpStreamDecoder(CaptureHandler onCapture, TextHandler onText = nullptr);
+
+    void feed(const uint8_t *data, size_t len);
+    // Flush whatever is buffered (end of file)
+    void finish();
+
+    const Stats &stats() const { return _stats; }
+
+private:
+    void processChunk_();
+    void emitText_(const std::vector<uint8_t> &bytes);
+
+    CaptureHandler _onCapture;
+    TextHandler _onText;
+    std::vector<uint8_t> _chunk;
+    std::vector<uint8_t> _decoded;
+    size_t _maxChunk;
+    bool _haveSeq = false;
+    uint32_t _lastSeq = 0;
+    Stats _stats;
+};
+
+// ===== Output formatting =====
+// JSON matches the line format of the firmware's JSON mode
+// ({"btn","ts_ms","protocol","bits","value","raw_us"}) plus "seq".
+std::string irCaptureToJson(const IrCapture &c);
+const char *irCaptureCsvHeader();
+std::string irCaptureToCsv(const IrCapture &c);
@@ -0,0 +1,110 @@
+// ir_dump_decode: convert the binary dump stream of ir_dump_esp8266 to JSON
+// lines or CSV.
+//
+//   ir_dump_decode [-f json|csv] [-o OUT] [-l LABELS] [INPUT]
+//
+// INPUT defaults to stdin and may be a serial device already configured with
+// stty (e.g. `stty -F /dev/ttyUSB0 115200 raw`). Console text from the
+// firmware is echoed to stderr. LABELS assigns button names to captures
+// taken in continuous mode, by seq (see IrLabelMap).
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "ir_dump_decoder.h"
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-f json|csv] [-o OUT] [-l LABELS] [INPUT]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    std::string format = "json";
+    const char *inPath = nullptr;
+    const char *outPath = nullptr;
+    IrLabelMap labels;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-f") && i + 1 < argc)
+            format = argv[++i];
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            outPath = argv[++i];
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+        {
+            std::string error;
+            if (!labels.load(argv[++i], error))
+            {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        else
+            inPath = argv[i];
+    }
+
+    const bool csv = format == "csv";
+    if (!csv && format != "json")
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *in = (inPath && strcmp(inPath, "-")) ? fopen(inPath, "rb") : stdin;
+    if (!in)
+    {
+        perror(inPath);
+        return 1;
+    }
+    FILE *out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out)
+    {
+        perror(outPath);
+        return 1;
+    }
+
+    if (csv)
+        fprintf(out, "%s\n", irCaptureCsvHeader());
+
+    IrDumpStreamDecoder decoder(
+        [&](const IrCapture &capture)
+        {
+            IrCapture c = capture;
+            labels.apply(c);
+            const std::string line = csv ? irCaptureToCsv(c) : irCaptureToJson(c);
+            fprintf(out, "%s\n", line.c_str());
+            fflush(out);
+        },
+        [](const std::string &text)
+        { fputs(text.c_str(), stderr); });
+
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        decoder.feed(buf, n);
+    decoder.finish();
+
+    const IrDumpStreamDecoder::Stats &st = decoder.stats();
+    fprintf(stderr, "[ir_dump_decode] frames=%llu bad=%llu seq_gaps=%llu seq_resets=%llu bytes=%llu\n",
+            (unsigned long long)st.frames, (unsigned long long)st.badFrames, (unsigned long long)st.seqGaps,
+            (unsigned long long)st.seqResets, (unsigned long long)st.bytes);
+
+    if (in != stdin)
+        fclose(in);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
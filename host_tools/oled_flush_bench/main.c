@@ -0,0 +1,296 @@
+// oled_flush_bench: host benchmark of the i2c_oled flush path
+// (firmware/esp_idf_shared_components/drivers/i2c_oled/src/oled_pack.c).
+//
+//   oled_flush_bench [-n ITERATIONS] [-u UPDATES]
+//
+// First checks the 8x8 transpose against the per-pixel conversion the flush
+// callback used before, on random frames and partial-render areas. Then
+// times both conversions on a 128x64 frame, and replays a run of
+// temperature/humidity label updates to count the I2C bytes sent per update:
+// full frame vs dirty spans only.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "oled_pack.h"
+
+#define W 128
+#define H 64
+#define STRIDE (W / 8)
+#define FB_SIZE (W * H / 8)
+
+// esp_lcd SSD1306 draw_bitmap: column range (3 cmd bytes) and page range
+// (3 cmd bytes), each with a control byte and address, then the data with
+// its own control byte and address
+#define I2C_OVERHEAD_BYTES 12
+#define I2C_HZ 400000
+#define I2C_BITS_PER_BYTE 9 // 8 data bits + ACK
+
+static uint64_t s_rng = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng_next(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return s_rng;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*========== Reference conversion ==========*/
+// The loop lvgl_flush_cb ran before oled_pack.c
+static void convert_naive(const uint8_t *px, uint8_t *fb)
+{
+    for (int y = 0; y < H; y++)
+    {
+        for (int x = 0; x < W; x++)
+        {
+            bool pixel_on = (px[STRIDE * y + (x >> 3)] & (1 << (7 - (x & 7)))) != 0;
+            uint8_t *dst = fb + W * (y >> 3) + x;
+            if (pixel_on)
+                (*dst) &= ~(1 << (y & 7));
+            else
+                (*dst) |= (1 << (y & 7));
+        }
+    }
+}
+
+static bool check_against_naive(int frames)
+{
+    static uint8_t px[STRIDE * H], ref[FB_SIZE], fb[FB_SIZE];
+    oled_shadow_t sh;
+    oled_shadow_init(&sh, W, H, fb);
+
+    for (int f = 0; f < frames; f++)
+    {
+        for (size_t i = 0; i < sizeof(px); i++)
+            px[i] = (uint8_t)rng_next();
+        convert_naive(px, ref);
+        oled_shadow_invalidate(&sh);
+        oled_shadow_update(&sh, px, STRIDE, 0, 0, W - 1, H - 1, (oled_dirty_span_t[OLED_PACK_MAX_PAGES]){0});
+        if (memcmp(ref, fb, FB_SIZE))
+        {
+            for (int i = 0; i < FB_SIZE; i++)
+            {
+                if (ref[i] != fb[i])
+                {
+                    fprintf(stderr, "frame %d: byte %d (page %d, x %d) is 0x%02x, expected 0x%02x\n", f, i,
+                            i / W, i % W, fb[i], ref[i]);
+                    break;
+                }
+            }
+            return false;
+        }
+
+        // A second update of the same frame must find nothing to send
+        oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES];
+        if (oled_shadow_update(&sh, px, STRIDE, 0, 0, W - 1, H - 1, dirty) != 0)
+        {
+            fprintf(stderr, "frame %d: unchanged frame reported dirty\n", f);
+            return false;
+        }
+
+        // Flipping one pixel must dirty exactly that column of that page
+        const int x = (int)(rng_next() % W), y = (int)(rng_next() % H);
+        px[STRIDE * y + (x >> 3)] ^= (uint8_t)(1 << (7 - (x & 7)));
+        if (oled_shadow_update(&sh, px, STRIDE, 0, 0, W - 1, H - 1, dirty) != 1 || dirty[y / 8].x0 != x ||
+            dirty[y / 8].x1 != x)
+        {
+            fprintf(stderr, "frame %d: pixel (%d,%d) flip not tracked\n", f, x, y);
+            return false;
+        }
+
+        // Partial render: a block aligned area in its own buffer, as LVGL
+        // hands it over, must land at its place in the shadow
+        static uint8_t area[STRIDE * H];
+        const int bx1 = (int)(rng_next() % (W / 8)), bx2 = bx1 + (int)(rng_next() % (W / 8 - bx1));
+        const int p1 = (int)(rng_next() % (H / 8)), p2 = p1 + (int)(rng_next() % (H / 8 - p1));
+        const size_t area_stride = (size_t)(bx2 - bx1 + 1);
+        for (int row = p1 * 8; row < p2 * 8 + 8; row++)
+        {
+            for (int b = bx1; b <= bx2; b++)
+            {
+                px[STRIDE * row + b] = (uint8_t)rng_next();
+                area[area_stride * (size_t)(row - p1 * 8) + (size_t)(b - bx1)] = px[STRIDE * row + b];
+            }
+        }
+        convert_naive(px, ref);
+        if (oled_shadow_update(&sh, area, area_stride, bx1 * 8, p1 * 8, bx2 * 8 + 7, p2 * 8 + 7, dirty) < 0 ||
+            memcmp(ref, fb, FB_SIZE))
+        {
+            fprintf(stderr, "frame %d: area (%d,%d)-(%d,%d) packed wrong\n", f, bx1 * 8, p1 * 8, bx2 * 8 + 7,
+                    p2 * 8 + 7);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*========== Label rendering ==========*/
+// Stand-in for the LVGL label: fixed 8x14 cells on a 16 px line pitch, each
+// glyph a hash pattern of its character so distinct characters differ
+#define CELL_W 8
+#define CELL_H 14
+#define LINE_H 16
+
+static void draw_text(uint8_t *px, const char *text)
+{
+    memset(px, 0, STRIDE * H);
+    int col = 0, line = 0;
+    for (const char *c = text; *c; c++)
+    {
+        if (*c == '\n')
+        {
+            col = 0;
+            line++;
+            continue;
+        }
+        if (*c != ' ' && (col + 1) * CELL_W <= W && line * LINE_H + CELL_H <= H)
+        {
+            for (int r = 0; r < CELL_H; r++)
+            {
+                uint32_t h = (uint32_t)(unsigned char)*c * 2654435761u ^ (uint32_t)r * 40503u;
+                h ^= h >> 15;
+                // Leave the right column blank as glyph spacing
+                px[STRIDE * (line * LINE_H + r) + col] = (uint8_t)(h & 0xFE);
+            }
+        }
+        col++;
+    }
+}
+
+/*========== Benchmarks ==========*/
+static void bench_convert(int iterations)
+{
+    static uint8_t px[STRIDE * H], fb[FB_SIZE];
+    oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES];
+    oled_shadow_t sh;
+    oled_shadow_init(&sh, W, H, fb);
+    for (size_t i = 0; i < sizeof(px); i++)
+        px[i] = (uint8_t)rng_next();
+
+    double t0 = now_s();
+    for (int i = 0; i < iterations; i++)
+    {
+        px[i % sizeof(px)] ^= 1; // keep the compiler from hoisting the work
+        convert_naive(px, fb);
+    }
+    const double naive = (now_s() - t0) / iterations;
+
+    t0 = now_s();
+    for (int i = 0; i < iterations; i++)
+    {
+        px[i % sizeof(px)] ^= 1;
+        oled_shadow_invalidate(&sh);
+        oled_shadow_update(&sh, px, STRIDE, 0, 0, W - 1, H - 1, dirty);
+    }
+    const double packed = (now_s() - t0) / iterations;
+
+    t0 = now_s();
+    for (int i = 0; i < iterations; i++)
+        oled_shadow_update(&sh, px, STRIDE, 0, 0, W - 1, H - 1, dirty);
+    const double unchanged = (now_s() - t0) / iterations;
+
+    printf("conversion of a %dx%d frame (%d iterations):\n", W, H, iterations);
+    printf("  per-pixel loop      %8.2f us\n", naive * 1e6);
+    printf("  8x8 transpose       %8.2f us  (x%.1f)\n", packed * 1e6, naive / packed);
+    printf("  transpose, no diff  %8.2f us\n", unchanged * 1e6);
+}
+
+static double i2c_ms(uint64_t bytes)
+{
+    return (double)bytes * I2C_BITS_PER_BYTE * 1e3 / I2C_HZ;
+}
+
+static void bench_label(int updates)
+{
+    static uint8_t px[STRIDE * H], fb[FB_SIZE];
+    oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES];
+    oled_shadow_t sh;
+    oled_shadow_init(&sh, W, H, fb);
+
+    // Same text layout as the display task
+    char text[64];
+    int temp_dc = 253, hum_dpct = 601;
+    snprintf(text, sizeof(text), "Temp: %d.%d C\nHum : %d.%d %%", temp_dc / 10, temp_dc % 10, hum_dpct / 10,
+             hum_dpct % 10);
+    draw_text(px, text);
+    oled_shadow_update(&sh, px, STRIDE, 0, 0, W - 1, H - 1, dirty); // initial full frame
+
+    const uint64_t full = I2C_OVERHEAD_BYTES + FB_SIZE;
+    uint64_t bytes = 0, transfers = 0, idle = 0;
+    for (int u = 0; u < updates; u++)
+    {
+        // DHT11-like random walk: most readings move the last digit or
+        // nothing at all
+        const int step = (int)(rng_next() % 5) - 2;
+        if (rng_next() & 1)
+            temp_dc += step;
+        else
+            hum_dpct += step;
+        snprintf(text, sizeof(text), "Temp: %d.%d C\nHum : %d.%d %%", temp_dc / 10, temp_dc % 10, hum_dpct / 10,
+                 hum_dpct % 10);
+        draw_text(px, text);
+
+        const int n = oled_shadow_update(&sh, px, STRIDE, 0, 0, W - 1, H - 1, dirty);
+        if (n == 0)
+            idle++;
+        for (int p = 0; p < H / 8; p++)
+        {
+            if (dirty[p].x0 < 0)
+                continue;
+            bytes += I2C_OVERHEAD_BYTES + (uint64_t)(dirty[p].x1 - dirty[p].x0 + 1);
+            transfers++;
+        }
+    }
+
+    const double avg = (double)bytes / updates;
+    printf("label updates (%d, %llu with no visible change):\n", updates, (unsigned long long)idle);
+    printf("  full frame          %8llu bytes  %6.2f ms at %d kHz\n", (unsigned long long)full, i2c_ms(full),
+           I2C_HZ / 1000);
+    printf("  dirty spans         %8.1f bytes  %6.2f ms  (%.2f transfers, %.1f%% of full)\n", avg,
+           avg * I2C_BITS_PER_BYTE * 1e3 / I2C_HZ, (double)transfers / updates, 100.0 * avg / (double)full);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 20000, updates = 1000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-u") && i + 1 < argc)
+            updates = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n ITERATIONS] [-u UPDATES]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations <= 0 || updates <= 0)
+    {
+        fprintf(stderr, "counts must be positive\n");
+        return 2;
+    }
+
+    if (!check_against_naive(200))
+    {
+        fprintf(stderr, "FAIL: transpose output differs from the per-pixel conversion\n");
+        return 1;
+    }
+    printf("transpose matches the per-pixel conversion (200 random frames)\n");
+
+    bench_convert(iterations);
+    bench_label(updates);
+    return 0;
+}
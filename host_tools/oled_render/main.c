@@ -0,0 +1,247 @@
+// oled_render: host build of the native i2c_oled renderer
+// (firmware/esp_idf_shared_components/drivers/i2c_oled/src/oled_text.c and
+// oled_screen.c).
+//
+//   oled_render [--check DIR | --update DIR | -o DIR]
+//
+// Draws every gateway screen on 128x64 and 128x32 canvases and writes each
+// as a PBM image (lit pixels black). By default the images are compared with
+// the golden ones in host_tools/oled_render/golden and the run fails on any
+// difference; --update rewrites them after an intended change. Also checks
+// that a one-digit change dirties only that digit and how readings are
+// formatted, and prints the renderer's RAM and flash footprint.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oled_screen.h"
+
+#define W 128
+#define MAX_FB (W * 64 / 8)
+
+typedef enum
+{
+    MODE_CHECK,
+    MODE_UPDATE,
+    MODE_WRITE,
+} mode_t_;
+
+typedef struct
+{
+    const char *name;
+    bool climate;
+    const char *line1, *line2; // status screen
+    float temp_c, hum_pct;     // climate screen
+} scene_t;
+
+// What app_runtime shows through the Wi-Fi states, then the readings
+static const scene_t s_scenes[] = {
+    {"connecting", false, "CONNECTING", "", 0, 0},
+    {"ap_mode", false, "AP MODE", "ESP_Config_AP", 0, 0},
+    {"connected", false, "CONNECTED", "IP 192.168.1.42", 0, 0},
+    {"climate", true, NULL, NULL, 25.3f, 60.1f},
+    {"climate_no_reading", true, NULL, NULL, NAN, NAN},
+};
+
+/*========== Screen driving ==========*/
+static void show_climate(oled_screen_t *s, float temp_c, float hum_pct)
+{
+    char temp[16], hum[16];
+    oled_screen_format_value(temp, sizeof(temp), temp_c, "C");
+    oled_screen_format_value(hum, sizeof(hum), hum_pct, "%");
+    oled_screen_set(s, OLED_FIELD_TEMP, temp);
+    oled_screen_set(s, OLED_FIELD_HUM, hum);
+    oled_screen_show(s, OLED_SCREEN_CLIMATE);
+}
+
+static void show_status(oled_screen_t *s, const char *line1, const char *line2)
+{
+    oled_screen_set(s, OLED_FIELD_LINE1, line1);
+    oled_screen_set(s, OLED_FIELD_LINE2, line2);
+    oled_screen_set(s, OLED_FIELD_FOOTER, line2);
+    oled_screen_show(s, OLED_SCREEN_STATUS);
+}
+
+/*========== PBM ==========*/
+// P4: rows of MSB-first bits, 1 = black
+static size_t to_pbm(const oled_canvas_t *cv, uint8_t *out, size_t cap)
+{
+    int n = snprintf((char *)out, cap, "P4\n%d %d\n", cv->width, cv->height);
+    size_t len = (size_t)n;
+    for (int y = 0; y < cv->height; y++)
+    {
+        for (int bx = 0; bx < cv->width / 8; bx++)
+        {
+            uint8_t b = 0;
+            for (int i = 0; i < 8; i++)
+                if (cv->fb[cv->width * (y / 8) + bx * 8 + i] & (1 << (y & 7)))
+                    b |= (uint8_t)(0x80 >> i);
+            if (len < cap)
+                out[len] = b;
+            len++;
+        }
+    }
+    return len;
+}
+
+static bool write_file(const char *path, const uint8_t *data, size_t len)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+    const bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+static bool matches_file(const char *path, const uint8_t *data, size_t len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    uint8_t buf[MAX_FB + 64];
+    const size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    return n == len && !memcmp(buf, data, len);
+}
+
+/*========== Checks ==========*/
+static bool render_scenes(int height, mode_t_ mode, const char *dir)
+{
+    static uint8_t fb[MAX_FB];
+    oled_canvas_t cv;
+    oled_screen_t screen;
+    oled_canvas_init(&cv, W, height, fb);
+    oled_screen_init(&screen, &cv);
+
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(s_scenes) / sizeof(s_scenes[0]); i++)
+    {
+        const scene_t *sc = &s_scenes[i];
+        if (sc->climate)
+            show_climate(&screen, sc->temp_c, sc->hum_pct);
+        else
+            show_status(&screen, sc->line1, sc->line2);
+
+        uint8_t pbm[MAX_FB + 64];
+        const size_t len = to_pbm(&cv, pbm, sizeof(pbm));
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s_%dx%d.pbm", dir, sc->name, W, height);
+        if (mode == MODE_CHECK)
+        {
+            if (!matches_file(path, pbm, len))
+            {
+                fprintf(stderr, "FAIL: %s differs from the rendered screen\n", path);
+                ok = false;
+            }
+        }
+        else if (!write_file(path, pbm, len))
+        {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// A new reading that changes one digit must send just that glyph's columns
+static bool check_dirty_spans(void)
+{
+    static uint8_t fb[MAX_FB];
+    oled_canvas_t cv;
+    oled_screen_t screen;
+    oled_dirty_span_t dirty[OLED_PACK_MAX_PAGES];
+    oled_canvas_init(&cv, W, 64, fb);
+    oled_screen_init(&screen, &cv);
+    show_climate(&screen, 25.3f, 60.1f);
+    oled_canvas_take_dirty(&cv, dirty);
+
+    show_climate(&screen, 25.3f, 60.1f);
+    if (oled_canvas_take_dirty(&cv, dirty) != 0)
+    {
+        fprintf(stderr, "FAIL: unchanged reading left dirty columns\n");
+        return false;
+    }
+
+    show_climate(&screen, 25.4f, 60.1f);
+    const int n = oled_canvas_take_dirty(&cv, dirty);
+    int bytes = 0;
+    for (int p = 0; p < OLED_PACK_MAX_PAGES; p++)
+        if (dirty[p].x0 >= 0)
+            bytes += dirty[p].x1 - dirty[p].x0 + 1;
+    // "25.3 C" -> "25.4 C": the 4th large cell, two pages of at most 12 columns
+    if (n != 2 || bytes > 2 * oled_font_cell_width(OLED_FONT_LARGE))
+    {
+        fprintf(stderr, "FAIL: one-digit change dirtied %d pages, %d bytes\n", n, bytes);
+        return false;
+    }
+    printf("one-digit temperature change: %d pages, %d bytes to send (full frame %d)\n", n, bytes, W * 64 / 8);
+    return true;
+}
+
+// Both backends show a reading through oled_screen_format_value()
+static bool check_format(void)
+{
+    static const struct
+    {
+        float v;
+        const char *want;
+    } cases[] = {
+        {25.3f, "25.3 C"}, {-4.2f, "-4.2 C"}, {0.0f, "0.0 C"},
+        {NAN, "--.- C"},   {-NAN, "--.- C"},  {INFINITY, "--.- C"},
+    };
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        char got[16];
+        oled_screen_format_value(got, sizeof(got), cases[i].v, "C");
+        if (strcmp(got, cases[i].want) != 0)
+        {
+            fprintf(stderr, "FAIL: %g shown as \"%s\", expected \"%s\"\n", cases[i].v, got, cases[i].want);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static void print_footprint(void)
+{
+    printf("native renderer footprint:\n");
+    printf("  flash: font atlases %zu B\n", oled_font_atlas_bytes());
+    printf("  RAM:   canvas %d B (128x64), screen state %zu B, canvas header %zu B\n", W * 64 / 8,
+           sizeof(oled_screen_t), sizeof(oled_canvas_t));
+}
+
+int main(int argc, char **argv)
+{
+    mode_t_ mode = MODE_CHECK;
+    const char *dir = OLED_RENDER_GOLDEN_DIR;
+    if (argc == 3 && !strcmp(argv[1], "--check"))
+    {
+        dir = argv[2];
+    }
+    else if (argc == 3 && (!strcmp(argv[1], "--update") || !strcmp(argv[1], "-o")))
+    {
+        mode = !strcmp(argv[1], "-o") ? MODE_WRITE : MODE_UPDATE;
+        dir = argv[2];
+    }
+    else if (argc != 1)
+    {
+        fprintf(stderr, "usage: %s [--check DIR | --update DIR | -o DIR]\n", argv[0]);
+        return 2;
+    }
+
+    bool ok = render_scenes(64, mode, dir) && render_scenes(32, mode, dir);
+    if (mode == MODE_CHECK && ok)
+        printf("all screens match %s\n", dir);
+    else if (mode != MODE_CHECK && ok)
+        printf("screens written to %s\n", dir);
+    ok = check_dirty_spans() && ok;
+    ok = check_format() && ok;
+    print_footprint();
+    return ok ? 0 : 1;
+}
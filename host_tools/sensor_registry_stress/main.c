@@ -0,0 +1,187 @@
+// sensor_registry_stress: pthread stress test of the sensor registry seqlock
+// (firmware/esp_idf_shared_components/global/include/sensor_seqlock.h).
+//
+//   sensor_registry_stress [-s SECONDS] [-r READERS] [-w WRITERS] [--naive]
+//
+// Writers publish a temperature/humidity pair as one update, every payload
+// word derived from a single counter. Readers check that each entry is
+// internally consistent and that both entries come from the same update;
+// any mismatch is a torn snapshot and fails the run. --naive copies the
+// words without the sequence check, to show the test does catch tearing.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sched.h>
+#define SENSOR_SEQLOCK_RELAX() sched_yield()
+#include "sensor_seqlock.h"
+
+#define MAX_THREADS 64
+
+static sensor_seqlock_t s_temp;
+static sensor_seqlock_t s_hum;
+static atomic_bool s_stop;
+static bool s_naive;
+
+typedef struct
+{
+    unsigned id;
+    uint64_t ops;
+    uint64_t retries;
+    uint64_t torn;
+    uint64_t seq_backwards;
+} worker_t;
+
+// All four words of both entries follow from `v`
+static void encode(uint32_t v, uint32_t temp[SENSOR_SEQLOCK_WORDS], uint32_t hum[SENSOR_SEQLOCK_WORDS])
+{
+    temp[0] = v;
+    temp[1] = v ^ 0xA5A5A5A5u;
+    temp[2] = v * 2654435761u;
+    temp[3] = ~v;
+    hum[0] = v + 1u;
+    hum[1] = (v + 1u) ^ 0x5A5A5A5Au;
+    hum[2] = (v + 1u) * 40503u;
+    hum[3] = ~(v + 1u);
+}
+
+static bool consistent(const uint32_t temp[SENSOR_SEQLOCK_WORDS], const uint32_t hum[SENSOR_SEQLOCK_WORDS])
+{
+    uint32_t t[SENSOR_SEQLOCK_WORDS], h[SENSOR_SEQLOCK_WORDS];
+    encode(temp[0], t, h);
+    return memcmp(t, temp, sizeof(t)) == 0 && memcmp(h, hum, sizeof(h)) == 0;
+}
+
+static void *writer_main(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    sensor_seqlock_t *const locks[2] = {&s_temp, &s_hum};
+    uint32_t words[2][SENSOR_SEQLOCK_WORDS];
+    // Writers interleave distinct values: id in the top byte
+    uint32_t v = w->id << 24;
+    while (!atomic_load_explicit(&s_stop, memory_order_relaxed))
+    {
+        encode(v++, words[0], words[1]);
+        sensor_seqlock_write_many(locks, 2, (const uint32_t(*)[SENSOR_SEQLOCK_WORDS])words);
+        w->ops++;
+    }
+    return NULL;
+}
+
+static void *reader_main(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    sensor_seqlock_t *const locks[2] = {&s_temp, &s_hum};
+    uint32_t words[2][SENSOR_SEQLOCK_WORDS];
+    uint32_t seqs[2];
+    uint32_t last_seq = 0;
+    while (!atomic_load_explicit(&s_stop, memory_order_relaxed))
+    {
+        if (s_naive)
+        {
+            sensor_seqlock_load(&s_temp, words[0]);
+            sensor_seqlock_load(&s_hum, words[1]);
+        }
+        else
+        {
+            w->retries += sensor_seqlock_read_many(locks, 2, words, seqs);
+            if (seqs[0] < last_seq)
+                w->seq_backwards++;
+            last_seq = seqs[0];
+        }
+        if (!consistent(words[0], words[1]))
+            w->torn++;
+        w->ops++;
+    }
+    return NULL;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-s SECONDS] [-r READERS] [-w WRITERS] [--naive]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 3.0;
+    unsigned readers = 4;
+    unsigned writers = 2;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            readers = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+            writers = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--naive"))
+            s_naive = true;
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!readers || !writers || readers + writers > MAX_THREADS || seconds <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Start from a consistent state
+    uint32_t init[2][SENSOR_SEQLOCK_WORDS];
+    encode(0, init[0], init[1]);
+    sensor_seqlock_store(&s_temp, init[0]);
+    sensor_seqlock_store(&s_hum, init[1]);
+
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    memset(workers, 0, sizeof(workers));
+    for (unsigned i = 0; i < writers + readers; i++)
+    {
+        workers[i].id = i + 1;
+        if (pthread_create(&threads[i], NULL, i < writers ? writer_main : reader_main, &workers[i]) != 0)
+        {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    struct timespec ts = {(time_t)seconds, (long)((seconds - (double)(time_t)seconds) * 1e9)};
+    nanosleep(&ts, NULL);
+    atomic_store(&s_stop, true);
+
+    uint64_t writes = 0, reads = 0, retries = 0, torn = 0, backwards = 0;
+    for (unsigned i = 0; i < writers + readers; i++)
+    {
+        pthread_join(threads[i], NULL);
+        if (i < writers)
+            writes += workers[i].ops;
+        else
+        {
+            reads += workers[i].ops;
+            retries += workers[i].retries;
+            torn += workers[i].torn;
+            backwards += workers[i].seq_backwards;
+        }
+    }
+
+    printf("%s: %u writer(s), %u reader(s), %.1f s\n", s_naive ? "naive" : "seqlock", writers, readers, seconds);
+    printf("writes:  %llu (%.2f M/s)\n", (unsigned long long)writes, writes / seconds / 1e6);
+    printf("reads:   %llu (%.2f M/s), %llu retries\n", (unsigned long long)reads, reads / seconds / 1e6,
+           (unsigned long long)retries);
+    printf("torn:    %llu\n", (unsigned long long)torn);
+    if (!s_naive)
+        printf("seq went backwards: %llu\n", (unsigned long long)backwards);
+
+    // In naive mode tearing is the expected outcome
+    if (s_naive)
+        return torn ? 0 : 1;
+    return torn || backwards ? 1 : 0;
+}
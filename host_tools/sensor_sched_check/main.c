@@ -0,0 +1,229 @@
+// sensor_sched_check: checks of the sensor_hub scheduler core
+// (firmware/esp_idf_shared_components/sensor_hub/src/sensor_sched.c) on a
+// simulated clock.
+//
+//   sensor_sched_check [-v]
+//
+// Runs fake sensors the way the hub task does (one read at a time, each
+// read taking the sensor's latency) and checks read counts per period,
+// minimum spacing between reads, runtime period changes, no catch-up
+// bursts after a slow read, failure statistics and the latency histogram.
+// -v prints every read. Exits non-zero on the first failed check.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sensor_sched.h"
+
+typedef struct
+{
+    uint32_t latency_us;
+    int fail_every; // every Nth read fails, 0 never
+    int calls;
+    int64_t last_start_us;
+    int64_t min_gap_us; // shortest start-to-start gap seen
+} fake_sensor_t;
+
+static int64_t s_now_us;
+static bool s_verbose;
+static int s_failures;
+
+#define CHECK(cond, ...)                                        \
+    do                                                          \
+    {                                                           \
+        if (!(cond))                                            \
+        {                                                       \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                       \
+            fprintf(stderr, "\n");                              \
+            s_failures++;                                       \
+        }                                                       \
+    } while (0)
+
+static int fake_read(void *ctx, int32_t *values)
+{
+    fake_sensor_t *f = (fake_sensor_t *)ctx;
+    if (f->calls > 0)
+    {
+        const int64_t gap = s_now_us - f->last_start_us;
+        if (f->min_gap_us == 0 || gap < f->min_gap_us)
+            f->min_gap_us = gap;
+    }
+    f->last_start_us = s_now_us;
+    f->calls++;
+    values[0] = f->calls;
+    s_now_us += f->latency_us;
+    return (f->fail_every && f->calls % f->fail_every == 0) ? 0x107 : 0;
+}
+
+static sensor_driver_t make_driver(const char *name, fake_sensor_t *f, uint32_t min_ms, uint32_t period_ms)
+{
+    return (sensor_driver_t){
+        .name = name,
+        .caps = SENSOR_CAP(0),
+        .min_period_ms = min_ms,
+        .default_period_ms = period_ms,
+        .read = fake_read,
+        .ctx = f,
+    };
+}
+
+// One hub task iteration per read, until `until_us`
+static void run_until(sensor_sched_t *s, int64_t until_us)
+{
+    int32_t values[SENSOR_MAX_VALUES];
+    while (1)
+    {
+        const int64_t wait = sensor_sched_wait_us(s, s_now_us);
+        if (wait < 0 || s_now_us + wait >= until_us)
+            break;
+        s_now_us += wait;
+        const int64_t t0 = s_now_us;
+        const int id = sensor_sched_take_due(s, t0);
+        if (id < 0)
+        {
+            CHECK(0, "nothing due after waiting %lld us", (long long)wait);
+            return;
+        }
+        const sensor_driver_t *drv = s->slots[id].drv;
+        const int err = drv->read(drv->ctx, values);
+        sensor_sched_complete(s, id, err, (uint32_t)(s_now_us - t0), s_now_us);
+        if (s_verbose)
+            printf("%8.3f s  %-6s err %d  %u us\n", t0 / 1e6, drv->name, err, (unsigned)(s_now_us - t0));
+    }
+    s_now_us = until_us;
+}
+
+static void check_rates(void)
+{
+    sensor_sched_t s;
+    fake_sensor_t dht = {.latency_us = 25000}, fast = {.latency_us = 300};
+    const sensor_driver_t d_dht = make_driver("dht", &dht, 1000, 2000);
+    const sensor_driver_t d_fast = make_driver("fast", &fast, 100, 500);
+    s_now_us = 0;
+    sensor_sched_init(&s);
+    CHECK(sensor_sched_add(&s, &d_dht, s_now_us) == 0, "add dht");
+    CHECK(sensor_sched_add(&s, &d_fast, s_now_us) == 1, "add fast");
+
+    run_until(&s, 60 * 1000000LL);
+    // Reads at t = 0, period, 2 * period, ... < 60 s
+    CHECK(dht.calls == 30, "dht: %d reads in 60 s at 2 s", dht.calls);
+    CHECK(fast.calls == 120, "fast: %d reads in 60 s at 500 ms", fast.calls);
+    CHECK(dht.min_gap_us >= 1000000, "dht read %lld us after the previous one", (long long)dht.min_gap_us);
+
+    // Runtime change: faster, slower, and refused values
+    CHECK(!sensor_sched_set_period(&s, 0, 999, s_now_us), "below the minimum accepted");
+    CHECK(!sensor_sched_set_period(&s, 0, SENSOR_MAX_PERIOD_MS + 1, s_now_us), "above the maximum accepted");
+    CHECK(!sensor_sched_set_period(&s, 2, 1000, s_now_us), "unknown id accepted");
+    CHECK(s.slots[0].period_ms == 2000, "refused change applied");
+
+    CHECK(sensor_sched_set_period(&s, 0, 5000, s_now_us), "5 s refused");
+    dht.calls = 0;
+    run_until(&s, s_now_us + 60 * 1000000LL);
+    CHECK(dht.calls == 12, "dht: %d reads in 60 s at 5 s", dht.calls);
+
+    // A shorter period applies from the last read, so it may be due at once
+    s_now_us += 4 * 1000000LL;
+    CHECK(sensor_sched_set_period(&s, 0, 1000, s_now_us), "1 s refused");
+    CHECK(sensor_sched_wait_us(&s, s_now_us) == 0, "shorter period not due right away");
+    dht.calls = 0;
+    dht.min_gap_us = 0;
+    run_until(&s, s_now_us + 10 * 1000000LL);
+    CHECK(dht.calls == 10, "dht: %d reads in 10 s at 1 s", dht.calls);
+    CHECK(dht.min_gap_us >= 1000000, "dht read %lld us after the previous one", (long long)dht.min_gap_us);
+}
+
+static void check_slow_read(void)
+{
+    // A read that takes longer than the period: the next one starts one
+    // period later, not in a burst to catch up
+    sensor_sched_t s;
+    fake_sensor_t slow = {.latency_us = 3500000};
+    const sensor_driver_t d = make_driver("slow", &slow, 1000, 1000);
+    s_now_us = 0;
+    sensor_sched_init(&s);
+    sensor_sched_add(&s, &d, s_now_us);
+    run_until(&s, 20 * 1000000LL);
+    CHECK(slow.min_gap_us >= 4500000, "slow sensor restarted after %lld us", (long long)slow.min_gap_us);
+    CHECK(slow.calls == 5, "slow: %d reads in 20 s", slow.calls);
+}
+
+static void check_stats(void)
+{
+    sensor_sched_t s;
+    fake_sensor_t flaky = {.latency_us = 12000, .fail_every = 3};
+    const sensor_driver_t d = make_driver("flaky", &flaky, 1000, 1000);
+    s_now_us = 0;
+    sensor_sched_init(&s);
+    sensor_sched_add(&s, &d, s_now_us);
+    run_until(&s, 300 * 1000000LL);
+
+    const sensor_stats_t *st = &s.slots[0].stats;
+    CHECK(st->reads == 300, "%u reads", (unsigned)st->reads);
+    CHECK(st->failures == 100, "%u failures", (unsigned)st->failures);
+    CHECK(sensor_stats_success_permille(st) == 666, "%u permille", (unsigned)sensor_stats_success_permille(st));
+    CHECK(st->last_error == 0x107, "last error 0x%x", (unsigned)st->last_error);
+    CHECK(st->consecutive_failures == 1, "%u in a row after read 300", (unsigned)st->consecutive_failures);
+    CHECK(st->latency_us_max == 12000 && st->latency_us_last == 12000, "latency %u/%u",
+          (unsigned)st->latency_us_last, (unsigned)st->latency_us_max);
+
+    uint32_t sum = 0;
+    for (int b = 0; b < SENSOR_LAT_BUCKETS; b++)
+        sum += st->latency_hist[b];
+    CHECK(sum == st->reads, "histogram holds %u of %u reads", (unsigned)sum, (unsigned)st->reads);
+    CHECK(st->latency_hist[3] == st->reads, "12 ms reads not in the 10-20 ms bucket");
+
+    // Bucket edges: a bound belongs to the bucket above it
+    sensor_sched_complete(&s, 0, 0, 999, s_now_us);
+    sensor_sched_complete(&s, 0, 0, 1000, s_now_us);
+    sensor_sched_complete(&s, 0, 0, 10000000, s_now_us);
+    CHECK(st->latency_hist[0] == 1 && st->latency_hist[1] == 1 && st->latency_hist[SENSOR_LAT_BUCKETS - 1] == 1,
+          "bucket edges");
+    CHECK(st->consecutive_failures == 0 && st->last_ok_us == s_now_us, "success does not reset the streak");
+}
+
+static void check_registration(void)
+{
+    sensor_sched_t s;
+    fake_sensor_t f = {0};
+    sensor_driver_t bad = make_driver("bad", &f, 2000, 1000); // default below minimum
+    sensor_sched_init(&s);
+    CHECK(sensor_sched_add(&s, &bad, 0) < 0, "default period below the minimum accepted");
+    bad = make_driver("bad", &f, 100, 1000);
+    bad.caps = 0;
+    CHECK(sensor_sched_add(&s, &bad, 0) < 0, "driver without caps accepted");
+    bad.caps = 0x1F; // 5 values
+    CHECK(sensor_sched_add(&s, &bad, 0) < 0, "more than SENSOR_MAX_VALUES accepted");
+    CHECK(sensor_sched_wait_us(&s, 0) < 0, "empty scheduler has something due");
+
+    const sensor_driver_t ok = make_driver("ok", &f, 100, 1000);
+    for (int i = 0; i < SENSOR_SCHED_MAX_DRIVERS; i++)
+        CHECK(sensor_sched_add(&s, &ok, 0) == i, "slot %d", i);
+    CHECK(sensor_sched_add(&s, &ok, 0) < 0, "table overflow accepted");
+    CHECK(sensor_caps_count(SENSOR_CAP(0) | SENSOR_CAP(1)) == 2, "caps count");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-v") == 0)
+        s_verbose = true;
+    else if (argc > 1)
+    {
+        fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+        return 2;
+    }
+
+    check_registration();
+    check_rates();
+    check_slow_read();
+    check_stats();
+    if (s_failures)
+    {
+        fprintf(stderr, "%d check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("sensor_sched: all checks passed\n");
+    return 0;
+}
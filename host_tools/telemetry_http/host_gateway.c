@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host_gateway.h"
+
+#define LOG_SIZE (2048u * 1024u)
+#define LOG_SECTOR 4096u
+#define LOG_BLOCK 512u    // CONFIG_TELEMETRY_LOG_BLOCK_SIZE
+#define LOG_FLUSH_EVERY 150 // CONFIG_TELEMETRY_LOG_FLUSH_S at 2 s readings
+#define READING_S 2u
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t next_rand(host_gateway_t *gw)
+{
+    gw->rng ^= gw->rng << 13;
+    gw->rng ^= gw->rng >> 17;
+    gw->rng ^= gw->rng << 5;
+    return gw->rng;
+}
+
+// Same path as the gateway's sensor sink and telemetry_log task
+static void take_reading(host_gateway_t *gw, uint32_t t_s)
+{
+    int32_t *v = gw->value;
+    if (next_rand(gw) % 8 == 0)
+        v[0] += (int32_t)(next_rand(gw) % 3) - 1 + (v[0] < 180) - (v[0] > 300);
+    if (next_rand(gw) % 5 == 0)
+        v[1] += 2 * ((int32_t)(next_rand(gw) % 3) - 1 + (v[1] < 400) - (v[1] > 700));
+    for (int c = 0; c < TELEMETRY_API_CHANNELS; c++)
+        tseries_add(&gw->series[c], t_s, v[c]);
+    tlog_append(&gw->log, HOST_GATEWAY_LOG_EPOCH + t_s, v);
+    if (gw->shim.push)
+    {
+        const int64_t now = now_us();
+        telemetry_push_reading(&gw->push, v, now, now);
+        http_shim_push_flush(&gw->shim);
+    }
+    if (++gw->since_flush >= LOG_FLUSH_EVERY)
+    {
+        tlog_flush(&gw->log);
+        gw->since_flush = 0;
+    }
+    gw->t_s = t_s;
+    gw->seq++;
+}
+
+/*========== telemetry_api source ==========*/
+static void src_status(telemetry_api_status_t *out, void *ctx)
+{
+    const host_gateway_t *gw = ctx;
+    out->valid = gw->seq > 0;
+    out->ok = out->valid;
+    memcpy(out->value, gw->value, sizeof(out->value));
+    out->t_s = gw->t_s;
+    out->seq = gw->seq;
+    out->wifi_state = "connected";
+}
+
+static size_t src_history(telemetry_api_channel_t ch, uint32_t t0_s, uint32_t t1_s, tseries_point_t *out,
+                          size_t max_points, tseries_res_t *res, void *ctx)
+{
+    host_gateway_t *gw = ctx;
+    return tseries_query(&gw->series[ch], t0_s, t1_s, out, max_points, res);
+}
+
+static size_t src_log_query(uint32_t t0_s, uint32_t t1_s, tlog_sample_cb_t cb, void *cb_ctx, void *ctx)
+{
+    host_gateway_t *gw = ctx;
+    return tlog_query(&gw->log, t0_s, t1_s, cb, cb_ctx, NULL);
+}
+
+static bool src_log_range(uint32_t *t_first, uint32_t *t_last, void *ctx)
+{
+    host_gateway_t *gw = ctx;
+    return tlog_range(&gw->log, t_first, t_last);
+}
+
+static void src_metrics(telemetry_api_t *api, void *ctx)
+{
+    host_gateway_t *gw = ctx;
+    telemetry_api_metric_help(api, "gateway_uptime_seconds", "counter", "Seconds since boot");
+    telemetry_api_metric(api, "gateway_uptime_seconds", NULL, gw->t_s);
+    telemetry_api_metric_help(api, "gateway_log_samples_total", "counter", "Flash log samples since boot");
+    telemetry_api_metric(api, "gateway_log_samples_total", NULL, gw->log.stats.samples_appended);
+    telemetry_api_metric(api, "gateway_log_samples_total", "kind=\"lost\"", gw->log.stats.samples_lost);
+    telemetry_api_metric_help(api, "gateway_log_flash_bytes_total", "counter", "Bytes written to the log");
+    telemetry_api_metric(api, "gateway_log_flash_bytes_total", NULL, gw->log.stats.bytes_written);
+    telemetry_api_metric_help(api, "gateway_http_connections_purged_total", "counter",
+                              "Connections closed to make room");
+    telemetry_api_metric(api, "gateway_http_connections_purged_total", NULL, gw->shim.purged);
+}
+
+static void handle(const char *uri, const char *if_none_match, const telemetry_api_transport_t *tr, void *ctx)
+{
+    host_gateway_t *gw = ctx;
+    telemetry_api_handle(&gw->api, uri, if_none_match, tr);
+}
+
+/*========== Public ==========*/
+bool host_gateway_open(host_gateway_t *gw, const host_gateway_config_t *cfg)
+{
+    memset(gw, 0, sizeof(*gw));
+    gw->cfg = *cfg;
+    gw->rng = 0x2545F491u;
+    gw->value[0] = 235;
+    gw->value[1] = 550;
+    gw->flash.fd = -1;
+
+    const tseries_caps_t caps = {.raw = 900, .minutes = 720, .hours = 168};
+    for (int c = 0; c < TELEMETRY_API_CHANNELS; c++)
+    {
+        gw->mem[c] = malloc(tseries_mem_size(&caps));
+        if (!gw->mem[c])
+            return false;
+        tseries_init(&gw->series[c], &caps, gw->mem[c]);
+    }
+
+    // The partition lives in an unlinked temporary file
+    char path[] = "/tmp/telemetry_http_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+        return false;
+    close(fd);
+    const bool opened = flash_file_open(&gw->flash, path, LOG_SIZE, LOG_SECTOR, false);
+    unlink(path);
+    if (!opened)
+        return false;
+    const tlog_flash_t dev = flash_file_dev(&gw->flash);
+    gw->mem[TELEMETRY_API_CHANNELS] = malloc(tlog_mem_size(&dev, LOG_BLOCK));
+    if (!gw->mem[TELEMETRY_API_CHANNELS] ||
+        tlog_mount(&gw->log, &dev, TELEMETRY_API_CHANNELS, LOG_BLOCK, gw->mem[TELEMETRY_API_CHANNELS]) != TLOG_OK)
+        return false;
+
+    const telemetry_api_config_t api_cfg = {
+        .buffer_size = cfg->buffer_size,
+        .max_points = cfg->max_points,
+        .max_samples = cfg->max_samples,
+        .source =
+            {
+                .status = src_status,
+                .history = src_history,
+                .log_query = src_log_query,
+                .log_range = src_log_range,
+                .metrics = src_metrics,
+                .ctx = gw,
+            },
+    };
+    gw->mem[TELEMETRY_API_CHANNELS + 1] = malloc(telemetry_api_mem_size(&api_cfg));
+    if (!gw->mem[TELEMETRY_API_CHANNELS + 1] ||
+        !telemetry_api_init(&gw->api, &api_cfg, gw->mem[TELEMETRY_API_CHANNELS + 1]))
+        return false;
+
+    const uint32_t preload = cfg->days * 86400u / READING_S;
+    for (uint32_t i = 0; i < preload; i++)
+        take_reading(gw, i * READING_S);
+    tlog_flush(&gw->log);
+    gw->since_flush = 0;
+    gw->flash.count = (flash_file_counters_t){0};
+
+    const telemetry_push_config_t push_cfg = {.max_clients = cfg->ws_clients, .depth = cfg->ws_depth};
+    if (cfg->ws_clients)
+    {
+        gw->mem[TELEMETRY_API_CHANNELS + 2] = malloc(telemetry_push_mem_size(&push_cfg));
+        if (!gw->mem[TELEMETRY_API_CHANNELS + 2] ||
+            !telemetry_push_init(&gw->push, &push_cfg, gw->mem[TELEMETRY_API_CHANNELS + 2]))
+            return false;
+    }
+
+    gw->start_us = now_us();
+    gw->start_t_s = gw->t_s;
+    gw->next_reading_us = gw->start_us + (int64_t)cfg->period_ms * 1000;
+    if (!http_shim_open(&gw->shim, cfg->port, cfg->max_conns, handle, gw))
+        return false;
+    gw->shim.push = cfg->ws_clients ? &gw->push : NULL;
+    return true;
+}
+
+void host_gateway_close(host_gateway_t *gw)
+{
+    http_shim_close(&gw->shim);
+    flash_file_close(&gw->flash);
+    for (size_t i = 0; i < sizeof(gw->mem) / sizeof(gw->mem[0]); i++)
+        free(gw->mem[i]);
+}
+
+void host_gateway_take_reading(host_gateway_t *gw)
+{
+    take_reading(gw, gw->t_s + READING_S);
+}
+
+void host_gateway_run(host_gateway_t *gw, const volatile bool *stop)
+{
+    while (!*stop)
+    {
+        int64_t now = now_us();
+        if (now >= gw->next_reading_us)
+        {
+            // The history clock advances with the host clock
+            const uint32_t t_s = gw->start_t_s + 1 + (uint32_t)((now - gw->start_us) / 1000000);
+            take_reading(gw, t_s > gw->t_s ? t_s : gw->t_s);
+            gw->next_reading_us += (int64_t)gw->cfg.period_ms * 1000;
+            now = now_us();
+        }
+        int wait_ms = (int)((gw->next_reading_us - now) / 1000);
+        if (wait_ms > 50)
+            wait_ms = 50; // notice *stop
+        http_shim_poll(&gw->shim, wait_ms < 0 ? 0 : wait_ms);
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "flash_file.h"
+#include "http_shim.h"
+#include "telemetry_api.h"
+#include "tlog.h"
+#include "tseries.h"
+
+// Stand-in for the gateway behind the telemetry API: the same tseries.c
+// tiers as sensor_history (menuconfig defaults without PSRAM) and tlog.c on
+// an emulated 2 MB log partition, preloaded with DAYS of 2 s readings, then
+// a new reading every `period_ms` while it serves, also pushed to /ws
+// clients through telemetry_push.c. Single-threaded like esp_http_server:
+// readings are taken between requests.
+
+#define HOST_GATEWAY_LOG_EPOCH 1700000000u // log clock = this + history clock
+
+typedef struct
+{
+    uint16_t port;        // 0: any free port
+    int max_conns;        // esp_http_server default: 7
+    uint32_t period_ms;   // between live readings
+    uint32_t days;        // preloaded history
+    size_t buffer_size;   // telemetry_api_config_t, Kconfig defaults
+    size_t max_points;
+    size_t max_samples;
+    size_t ws_clients;    // telemetry_push_config_t; 0: no /ws
+    uint32_t ws_depth;
+} host_gateway_config_t;
+
+typedef struct
+{
+    host_gateway_config_t cfg;
+    http_shim_t shim;
+    telemetry_api_t api;
+    telemetry_push_t push;
+    tseries_t series[TELEMETRY_API_CHANNELS];
+    flash_file_t flash;
+    tlog_t log;
+    void *mem[TELEMETRY_API_CHANNELS + 3];
+
+    int32_t value[TELEMETRY_API_CHANNELS];
+    uint32_t t_s; // history clock of the newest reading
+    uint32_t seq;
+    uint32_t since_flush;
+    int64_t start_us;
+    uint32_t start_t_s;
+    int64_t next_reading_us;
+    uint32_t rng;
+} host_gateway_t;
+
+bool host_gateway_open(host_gateway_t *gw, const host_gateway_config_t *cfg);
+void host_gateway_close(host_gateway_t *gw);
+
+// One reading now, 2 s after the previous one (between requests only)
+void host_gateway_take_reading(host_gateway_t *gw);
+
+// Serves and takes readings until *stop is set
+void host_gateway_run(host_gateway_t *gw, const volatile bool *stop);
@@ -0,0 +1,495 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "http_shim.h"
+
+// esp_http_server's send_wait_timeout
+#define SEND_TIMEOUT_S 5
+// lwIP's default TCP_SND_BUF: a slow reader backs up as soon as on the gateway
+#define SEND_BUFFER 5744
+
+typedef struct
+{
+    int fd;
+    telemetry_api_head_t head;
+    bool keep_alive;
+    bool chunked; // headers sent, body follows in chunks
+    bool failed;
+} reply_t;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool send_iov(int fd, struct iovec *iov, int n)
+{
+    while (n > 0)
+    {
+        const ssize_t w = writev(fd, iov, n);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        size_t left = (size_t)w;
+        while (n > 0 && left >= iov->iov_len)
+        {
+            left -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+// Status line and headers; `content_length` < 0 for chunked
+static size_t format_head(char *out, size_t cap, const reply_t *r, long content_length)
+{
+    int n = snprintf(out, cap, "HTTP/1.1 %s\r\n", r->head.status);
+    if (r->head.content_type)
+        n += snprintf(out + n, cap - (size_t)n, "Content-Type: %s\r\n", r->head.content_type);
+    if (r->head.etag)
+        n += snprintf(out + n, cap - (size_t)n, "ETag: %s\r\nCache-Control: no-cache\r\n", r->head.etag);
+    if (content_length < 0)
+        n += snprintf(out + n, cap - (size_t)n, "Transfer-Encoding: chunked\r\n");
+    else
+        n += snprintf(out + n, cap - (size_t)n, "Content-Length: %ld\r\n", content_length);
+    if (!r->keep_alive)
+        n += snprintf(out + n, cap - (size_t)n, "Connection: close\r\n");
+    n += snprintf(out + n, cap - (size_t)n, "\r\n");
+    return (size_t)n;
+}
+
+static int tr_head(const telemetry_api_head_t *h, void *ctx)
+{
+    ((reply_t *)ctx)->head = *h;
+    return 0;
+}
+
+// Same sends as the firmware's esp_http_server transport: one piece with
+// a Content-Length, or the headers and then every piece as a chunk
+static int tr_body(const char *data, size_t len, bool last, void *ctx)
+{
+    reply_t *r = ctx;
+    char head[512], size_line[16];
+    struct iovec iov[5];
+    int n = 0;
+    if (!r->chunked)
+    {
+        const size_t head_len = format_head(head, sizeof(head), r, last ? (long)len : -1);
+        iov[n++] = (struct iovec){head, head_len};
+        if (last)
+        {
+            if (len)
+                iov[n++] = (struct iovec){(void *)data, len};
+            r->failed = !send_iov(r->fd, iov, n);
+            return r->failed ? -1 : 0;
+        }
+        r->chunked = true;
+    }
+    if (len)
+    {
+        iov[n++] = (struct iovec){size_line, (size_t)snprintf(size_line, sizeof(size_line), "%zx\r\n", len)};
+        iov[n++] = (struct iovec){(void *)data, len};
+        iov[n++] = (struct iovec){"\r\n", 2};
+    }
+    if (last)
+        iov[n++] = (struct iovec){"0\r\n\r\n", 5};
+    r->failed = !send_iov(r->fd, iov, n);
+    return r->failed ? -1 : 0;
+}
+
+static void close_conn(http_shim_t *shim, http_shim_conn_t *c)
+{
+    if (c->ws)
+        telemetry_push_remove(shim->push, c->fd);
+    close(c->fd);
+    c->fd = -1;
+    c->ws = false;
+    c->len = 0;
+}
+
+static void reply_plain(int fd, const char *status)
+{
+    reply_t r = {.fd = fd, .head = {.status = status, .content_type = "text/plain"}};
+    tr_body(status, strlen(status), true, &r);
+}
+
+/*========== WebSocket ==========*/
+static uint32_t rol(uint32_t v, int n)
+{
+    return v << n | v >> (32 - n);
+}
+
+// SHA-1 of a message shorter than 56 + 64 bytes, for the handshake only
+static void sha1(const char *msg, size_t len, uint8_t out[20])
+{
+    uint8_t block[128] = {0};
+    memcpy(block, msg, len);
+    block[len] = 0x80;
+    const size_t total = len + 9 <= 64 ? 64 : 128;
+    const uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; i++)
+        block[total - 1 - i] = (uint8_t)(bits >> (8 * i));
+
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    for (size_t off = 0; off < total; off += 64)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)block[off + 4 * i] << 24 | (uint32_t)block[off + 4 * i + 1] << 16 |
+                   (uint32_t)block[off + 4 * i + 2] << 8 | block[off + 4 * i + 3];
+        for (int i = 16; i < 80; i++)
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+            if (i < 20)
+                f = (b & c) | (~b & d), k = 0x5A827999;
+            else if (i < 40)
+                f = b ^ c ^ d, k = 0x6ED9EBA1;
+            else if (i < 60)
+                f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+            else
+                f = b ^ c ^ d, k = 0xCA62C1D6;
+            const uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+    }
+    for (int i = 0; i < 20; i++)
+        out[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static void base64(const uint8_t *in, size_t len, char *out)
+{
+    static const char abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < len; i += 3)
+    {
+        const uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0) |
+                           (i + 2 < len ? in[i + 2] : 0);
+        *out++ = abc[v >> 18];
+        *out++ = abc[(v >> 12) & 63];
+        *out++ = i + 1 < len ? abc[(v >> 6) & 63] : '=';
+        *out++ = i + 2 < len ? abc[v & 63] : '=';
+    }
+    *out = 0;
+}
+
+static telemetry_push_client_t *push_client(http_shim_t *shim, int fd)
+{
+    for (size_t i = 0; i < shim->push->cfg.max_clients; i++)
+        if (shim->push->clients[i].fd == fd)
+            return &shim->push->clients[i];
+    return NULL;
+}
+
+// Non-blocking writes, as the gateway's push task does them; false once the
+// client is to be closed
+static bool push_flush_conn(http_shim_t *shim, http_shim_conn_t *c)
+{
+    telemetry_push_client_t *pc = push_client(shim, c->fd);
+    if (!pc || pc->closing)
+        return false;
+    const uint8_t *data;
+    size_t n;
+    while ((n = telemetry_push_pending(shim->push, pc, &data)) > 0)
+    {
+        const ssize_t w = send(c->fd, data, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (w <= 0)
+            return false;
+        telemetry_push_sent(shim->push, pc, (size_t)w, now_us());
+    }
+    return true;
+}
+
+// GET /ws with a WebSocket handshake: switches `c` over to shim->push
+static bool upgrade(http_shim_t *shim, http_shim_conn_t *c, const char *key, size_t key_len)
+{
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    char msg[128], accept[32], head[256];
+    uint8_t digest[20];
+    if (key_len > 64)
+        return false;
+    memcpy(msg, key, key_len);
+    memcpy(msg + key_len, guid, sizeof(guid) - 1);
+    sha1(msg, key_len + sizeof(guid) - 1, digest);
+    base64(digest, sizeof(digest), accept);
+    const int n = snprintf(head, sizeof(head),
+                           "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                           "Sec-WebSocket-Accept: %s\r\n\r\n",
+                           accept);
+    struct iovec iov = {head, (size_t)n};
+    if (!send_iov(c->fd, &iov, 1))
+        return false;
+    // esp_http_server has shaken hands before the handler can refuse
+    if (!telemetry_push_add(shim->push, c->fd))
+        return false;
+    c->ws = true;
+    c->len = 0;
+    return push_flush_conn(shim, c);
+}
+
+// Value of header `name` in the header block `h`, `len` bytes; NULL if absent
+static const char *find_header(const char *h, const char *name, size_t *len)
+{
+    const size_t n = strlen(name);
+    for (const char *line = h; line && *line;)
+    {
+        const char *eol = strstr(line, "\r\n");
+        if (!strncasecmp(line, name, n) && line[n] == ':')
+        {
+            const char *v = line + n + 1;
+            while (*v == ' ' || *v == '\t')
+                v++;
+            *len = eol ? (size_t)(eol - v) : strlen(v);
+            return v;
+        }
+        line = eol ? eol + 2 : NULL;
+    }
+    return NULL;
+}
+
+// Serves every complete request buffered on `c`; false to close it
+static bool serve(http_shim_t *shim, http_shim_conn_t *c)
+{
+    for (;;)
+    {
+        c->rx[c->len] = 0;
+        char *end = strstr(c->rx, "\r\n\r\n");
+        if (!end)
+        {
+            if (c->len >= sizeof(c->rx) - 1)
+            {
+                reply_plain(c->fd, "431 Request Header Fields Too Large");
+                return false;
+            }
+            return true;
+        }
+        end[2] = 0; // keeps the last header's CRLF
+        const size_t req_len = (size_t)(end + 4 - c->rx);
+
+        char *sp1 = strchr(c->rx, ' ');
+        char *sp2 = sp1 ? strchr(sp1 + 1, ' ') : NULL;
+        char *eol = strstr(c->rx, "\r\n");
+        if (!sp1 || !sp2 || sp2 > eol)
+        {
+            reply_plain(c->fd, "400 Bad Request");
+            return false;
+        }
+        *sp1 = *sp2 = *eol = 0;
+        const char *method = c->rx, *uri = sp1 + 1, *version = sp2 + 1;
+        const char *headers = eol + 2;
+
+        size_t conn_len = 0, length_len = 0, inm_len = 0, upgrade_len = 0, key_len = 0;
+        const char *conn_hdr = find_header(headers, "Connection", &conn_len);
+        const char *upgrade_hdr = find_header(headers, "Upgrade", &upgrade_len);
+        const char *key_hdr = find_header(headers, "Sec-WebSocket-Key", &key_len);
+        const char *length_hdr = find_header(headers, "Content-Length", &length_len);
+        const char *inm_hdr = find_header(headers, "If-None-Match", &inm_len);
+        bool keep_alive = strcmp(version, "HTTP/1.0") != 0;
+        if (conn_hdr)
+            keep_alive = strncasecmp(conn_hdr, "close", 5) != 0 &&
+                         (keep_alive || !strncasecmp(conn_hdr, "keep-alive", 10));
+        char inm[96];
+        if (inm_hdr)
+        {
+            // esp_http_server copies header values into a caller buffer too
+            if (inm_len >= sizeof(inm))
+                inm_hdr = NULL;
+            else
+            {
+                memcpy(inm, inm_hdr, inm_len);
+                inm[inm_len] = 0;
+            }
+        }
+
+        shim->requests++;
+        if (length_hdr && (length_len != 1 || length_hdr[0] != '0'))
+        {
+            reply_plain(c->fd, "413 Content Too Large");
+            return false;
+        }
+        if (shim->push && !strcmp(method, "GET") && !strcmp(uri, "/ws") && upgrade_hdr && key_hdr &&
+            !strncasecmp(upgrade_hdr, "websocket", 9))
+            return upgrade(shim, c, key_hdr, key_len);
+        reply_t r = {.fd = c->fd, .keep_alive = keep_alive};
+        const telemetry_api_transport_t tr = {.head = tr_head, .body = tr_body, .ctx = &r};
+        if (strcmp(method, "GET"))
+        {
+            r.head = (telemetry_api_head_t){.status = "405 Method Not Allowed", .content_type = "text/plain"};
+            tr_body("", 0, true, &r);
+        }
+        else
+        {
+            shim->handler(uri, inm_hdr ? inm : NULL, &tr, shim->ctx);
+        }
+        if (r.failed || !keep_alive)
+            return false;
+
+        memmove(c->rx, c->rx + req_len, c->len - req_len);
+        c->len -= req_len;
+    }
+}
+
+static void accept_conn(http_shim_t *shim)
+{
+    const int fd = accept(shim->listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    http_shim_conn_t *slot = NULL, *lru = NULL;
+    for (int i = 0; i < shim->max_conns && !slot; i++)
+    {
+        http_shim_conn_t *c = &shim->conns[i];
+        if (c->fd < 0)
+            slot = c;
+        else if (!lru || c->last_used_us < lru->last_used_us)
+            lru = c;
+    }
+    if (!slot)
+    {
+        close_conn(shim, lru);
+        shim->purged++;
+        slot = lru;
+    }
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    const struct timeval tv = {.tv_sec = SEND_TIMEOUT_S};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    const int sndbuf = SEND_BUFFER;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    slot->fd = fd;
+    slot->len = 0;
+    slot->last_used_us = now_us();
+}
+
+bool http_shim_open(http_shim_t *shim, uint16_t port, int max_conns, http_shim_handler_t handler, void *ctx)
+{
+    memset(shim, 0, sizeof(*shim));
+    if (max_conns < 1 || max_conns > HTTP_SHIM_MAX_CONNS || !handler)
+        return false;
+    shim->max_conns = max_conns;
+    shim->handler = handler;
+    shim->ctx = ctx;
+    for (int i = 0; i < HTTP_SHIM_MAX_CONNS; i++)
+        shim->conns[i].fd = -1;
+
+    shim->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (shim->listen_fd < 0)
+    {
+        perror("socket");
+        return false;
+    }
+    const int one = 1;
+    setsockopt(shim->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    if (bind(shim->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(shim->listen_fd, 64) != 0 ||
+        getsockname(shim->listen_fd, (struct sockaddr *)&addr, &alen) != 0)
+    {
+        perror("bind");
+        close(shim->listen_fd);
+        return false;
+    }
+    shim->port = ntohs(addr.sin_port);
+    return true;
+}
+
+void http_shim_close(http_shim_t *shim)
+{
+    for (int i = 0; i < shim->max_conns; i++)
+        if (shim->conns[i].fd >= 0)
+            close_conn(shim, &shim->conns[i]);
+    if (shim->listen_fd >= 0)
+        close(shim->listen_fd);
+    shim->listen_fd = -1;
+}
+
+void http_shim_poll(http_shim_t *shim, int timeout_ms)
+{
+    struct pollfd pfd[HTTP_SHIM_MAX_CONNS + 1];
+    int slot[HTTP_SHIM_MAX_CONNS + 1];
+    int n = 0;
+    pfd[n++] = (struct pollfd){.fd = shim->listen_fd, .events = POLLIN};
+    for (int i = 0; i < shim->max_conns; i++)
+    {
+        if (shim->conns[i].fd < 0)
+            continue;
+        // A /ws client with a frame left waits for room in its socket
+        const uint8_t *data;
+        telemetry_push_client_t *pc = shim->conns[i].ws ? push_client(shim, shim->conns[i].fd) : NULL;
+        const bool out = pc && telemetry_push_pending(shim->push, pc, &data) > 0;
+        slot[n] = i;
+        pfd[n++] = (struct pollfd){.fd = shim->conns[i].fd, .events = (short)(POLLIN | (out ? POLLOUT : 0))};
+    }
+    if (poll(pfd, (nfds_t)n, timeout_ms) <= 0)
+        return;
+
+    for (int k = 1; k < n; k++)
+    {
+        if (!pfd[k].revents)
+            continue;
+        http_shim_conn_t *c = &shim->conns[slot[k]];
+        if (c->ws && (pfd[k].revents & POLLOUT) && !push_flush_conn(shim, c))
+        {
+            close_conn(shim, c);
+            continue;
+        }
+        if (!(pfd[k].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+        const ssize_t r = recv(c->fd, c->rx + c->len, sizeof(c->rx) - 1 - c->len, MSG_DONTWAIT);
+        if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            close_conn(shim, c);
+            continue;
+        }
+        if (r < 0)
+            continue;
+        c->last_used_us = now_us();
+        if (c->ws)
+            continue; // the dashboard's pings
+        c->len += (size_t)r;
+        if (!serve(shim, c))
+            close_conn(shim, c);
+    }
+    if (pfd[0].revents & POLLIN)
+        accept_conn(shim);
+}
+
+void http_shim_push_flush(http_shim_t *shim)
+{
+    for (int i = 0; i < shim->max_conns && shim->push; i++)
+    {
+        http_shim_conn_t *c = &shim->conns[i];
+        if (c->fd >= 0 && c->ws && !push_flush_conn(shim, c))
+            close_conn(shim, c);
+    }
+}
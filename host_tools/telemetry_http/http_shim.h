@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry_api.h"
+#include "telemetry_push.h"
+
+// Just enough of an HTTP/1.1 server over POSIX sockets to run
+// telemetry_api.c the way esp_http_server does on the gateway: one thread
+// handles every request in turn, keep-alive connections up to a limit with
+// the least recently used one closed to make room (lru_purge_enable), and
+// each body piece written with blocking sends as it is produced. GET only.
+// With `push` set, GET /ws upgrades to a WebSocket client of it, written
+// without blocking like the gateway's push task does.
+
+typedef struct
+{
+    int fd;
+    int64_t last_used_us;
+    bool ws;    // a client of shim->push; what it sends is discarded
+    size_t len; // bytes of the request being received
+    char rx[2048];
+} http_shim_conn_t;
+
+#define HTTP_SHIM_MAX_CONNS 64
+
+typedef struct http_shim http_shim_t;
+
+// Handles one request. `uri` and `if_none_match` (NULL if absent) stay
+// valid during the call; reply through `tr`.
+typedef void (*http_shim_handler_t)(const char *uri, const char *if_none_match, const telemetry_api_transport_t *tr,
+                                    void *ctx);
+
+struct http_shim
+{
+    int listen_fd;
+    uint16_t port;
+    int max_conns;
+    http_shim_conn_t conns[HTTP_SHIM_MAX_CONNS];
+    http_shim_handler_t handler;
+    void *ctx;
+    telemetry_push_t *push; // NULL: no /ws
+    uint64_t requests;
+    uint32_t purged; // connections closed to make room
+};
+
+// Listens on 127.0.0.1:`port` (0: any free port, see shim->port).
+// `max_conns` <= HTTP_SHIM_MAX_CONNS; esp_http_server's default is 7.
+bool http_shim_open(http_shim_t *shim, uint16_t port, int max_conns, http_shim_handler_t handler, void *ctx);
+void http_shim_close(http_shim_t *shim);
+
+// Waits up to `timeout_ms` for sockets to get ready and serves what came in
+void http_shim_poll(http_shim_t *shim, int timeout_ms);
+
+// Writes what /ws clients can take without blocking and closes the ones
+// telemetry_push marked closing. Polling does it as sockets drain; call it
+// after a telemetry_push_publish().
+void http_shim_push_flush(http_shim_t *shim);
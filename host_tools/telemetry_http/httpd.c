@@ -0,0 +1,102 @@
+// telemetry_httpd: the gateway telemetry API on the host
+// (firmware/esp_idf_shared_components/telemetry_http/src/telemetry_api.c).
+//
+//   telemetry_httpd [-p PORT] [-c MAX_CONNS] [-i PERIOD_MS] [-D DAYS]
+//                   [-b BUFFER] [-m MAX_POINTS] [-s MAX_SAMPLES]
+//                   [-w WS_CLIENTS] [-q WS_DEPTH]
+//
+// Serves /status.json, /history, /metrics and /ws on 127.0.0.1:PORT (8080)
+// from DAYS (7) of preloaded readings plus a new one every PERIOD_MS
+// (2000), through the socket shim that stands in for esp_http_server, for
+// curl, a browser or any load generator; /ws pushes each new reading to
+// up to WS_CLIENTS WebSocket clients such as host_app's dashboard. Sizes
+// default to the firmware's menuconfig defaults. Runs until interrupted.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_gateway.h"
+
+static volatile bool s_stop = false;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    s_stop = true;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-p PORT] [-c MAX_CONNS] [-i PERIOD_MS] [-D DAYS] [-b BUFFER] [-m MAX_POINTS] "
+            "[-s MAX_SAMPLES] [-w WS_CLIENTS] [-q WS_DEPTH]\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    host_gateway_config_t cfg = {
+        .port = 8080,
+        .max_conns = 7,
+        .period_ms = 2000,
+        .days = 7,
+        .buffer_size = 1024,
+        .max_points = 240,
+        .max_samples = 1800,
+        .ws_clients = 4,
+        .ws_depth = 8,
+    };
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_arg = i + 1 < argc;
+        if (!strcmp(argv[i], "-p") && has_arg)
+            cfg.port = (uint16_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-c") && has_arg)
+            cfg.max_conns = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-i") && has_arg)
+            cfg.period_ms = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-D") && has_arg)
+            cfg.days = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && has_arg)
+            cfg.buffer_size = (size_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && has_arg)
+            cfg.max_points = (size_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && has_arg)
+            cfg.max_samples = (size_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && has_arg)
+            cfg.ws_clients = (size_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-q") && has_arg)
+            cfg.ws_depth = (uint32_t)atoi(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.period_ms == 0 || (cfg.ws_clients && cfg.ws_depth == 0))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    host_gateway_t *gw = malloc(sizeof(*gw));
+    if (!gw || !host_gateway_open(gw, &cfg))
+    {
+        fprintf(stderr, "cannot start the server\n");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    printf("http://127.0.0.1:%u/status.json  /history?sensor=temperature&last=3600  /history?source=log  "
+           "/metrics  ws://127.0.0.1:%u/ws\n",
+           gw->shim.port, gw->shim.port);
+    fflush(stdout);
+    host_gateway_run(gw, &s_stop);
+    printf("%llu requests\n", (unsigned long long)gw->shim.requests);
+    host_gateway_close(gw);
+    free(gw);
+    return 0;
+}
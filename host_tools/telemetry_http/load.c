@@ -0,0 +1,648 @@
+// telemetry_http_load: load test of the gateway telemetry API
+// (firmware/esp_idf_shared_components/telemetry_http/src/telemetry_api.c).
+//
+//   telemetry_http_load [-H HOST] [-p PORT] [-c CONNS] [-d SECONDS]
+//                       [-u URL]... [--no-etag]
+//
+// Without -H the host server (host_gateway.c: firmware buffer defaults, a
+// week of history, a reading every 2 s, 7 connections like
+// esp_http_server) runs in-process on a free port. Before the load it is
+// checked directly: /history?source=log paged with "next" must return
+// exactly the samples tlog_query() does, and /status.json must answer a
+// matching If-None-Match with a bodyless 304 until the next reading. It
+// also reports the device flash time the log replies cost, from the
+// emulator's counters. -H HOST -p PORT loads any server, e.g. the gateway.
+//
+// Each scenario keeps CONNS (4) keep-alive connections busy for SECONDS
+// (3): every connection sends its next request as soon as the previous
+// reply is in, with If-None-Match from the ETag it last got for the URL
+// where the scenario polls that way. -u runs only the given URLs, with
+// If-None-Match unless --no-etag. Reports requests per second, latency
+// percentiles and the share of 304s. Exits non-zero on a malformed reply,
+// a status other than 200/304, or a failed check.
+
+#define _GNU_SOURCE
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host_gateway.h"
+
+#define MAX_URLS 16
+#define MAX_CONNS 64
+
+typedef struct
+{
+    const char *name;
+    const char *urls[MAX_URLS];
+    int n_urls;
+    bool etag; // poll with If-None-Match
+} scenario_t;
+
+typedef struct
+{
+    char *data;
+    size_t len, cap;
+} body_t;
+
+typedef struct
+{
+    int fd;
+    size_t len, pos;
+    char buf[16384];
+} conn_t;
+
+typedef struct
+{
+    int status;
+    char etag[64];
+    bool close;
+} reply_t;
+
+typedef struct
+{
+    const scenario_t *sc;
+    const char *host;
+    const char *port;
+    int64_t deadline_us;
+    int index;
+
+    uint32_t *lat_us;
+    size_t n, cap;
+    uint64_t body_bytes;
+    uint32_t ok, not_modified, bad, io_errors;
+    char etags[MAX_URLS][64];
+} worker_t;
+
+static int s_failures = 0;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void body_put(body_t *b, const char *data, size_t len)
+{
+    if (b->len + len + 1 > b->cap)
+    {
+        b->cap = (b->len + len + 1) * 2;
+        b->data = realloc(b->data, b->cap);
+        if (!b->data)
+            exit(1);
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    b->data[b->len] = 0;
+}
+
+/*========== HTTP client ==========*/
+static int connect_to(const char *host, const char *port)
+{
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *res;
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+        return -1;
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0)
+    {
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        const struct timeval tv = {.tv_sec = 10};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    return fd;
+}
+
+static bool fill(conn_t *c)
+{
+    if (c->pos)
+    {
+        memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+        c->len -= c->pos;
+        c->pos = 0;
+    }
+    if (c->len == sizeof(c->buf))
+        return false;
+    const ssize_t r = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+    if (r <= 0)
+        return false;
+    c->len += (size_t)r;
+    return true;
+}
+
+// One CRLF-terminated line, without the CRLF
+static bool read_line(conn_t *c, char *out, size_t cap)
+{
+    for (;;)
+    {
+        char *eol = memmem(c->buf + c->pos, c->len - c->pos, "\r\n", 2);
+        if (eol)
+        {
+            const size_t n = (size_t)(eol - (c->buf + c->pos));
+            if (n >= cap)
+                return false;
+            memcpy(out, c->buf + c->pos, n);
+            out[n] = 0;
+            c->pos += n + 2;
+            return true;
+        }
+        if (!fill(c))
+            return false;
+    }
+}
+
+static bool read_bytes(conn_t *c, size_t n, body_t *body)
+{
+    while (n)
+    {
+        if (c->pos == c->len && !fill(c))
+            return false;
+        size_t k = c->len - c->pos;
+        if (k > n)
+            k = n;
+        if (body)
+            body_put(body, c->buf + c->pos, k);
+        c->pos += k;
+        n -= k;
+    }
+    return true;
+}
+
+// Status line, headers and the whole body (Content-Length or chunked)
+static bool read_reply(conn_t *c, reply_t *r, body_t *body)
+{
+    char line[512];
+    memset(r, 0, sizeof(*r));
+    body->len = 0;
+    if (!read_line(c, line, sizeof(line)) || sscanf(line, "HTTP/1.%*d %d", &r->status) != 1)
+        return false;
+    long length = -1;
+    bool chunked = false;
+    while (read_line(c, line, sizeof(line)))
+    {
+        if (!line[0])
+        {
+            if (chunked)
+            {
+                for (;;)
+                {
+                    if (!read_line(c, line, sizeof(line)))
+                        return false;
+                    const size_t n = strtoul(line, NULL, 16);
+                    if (n == 0)
+                        return read_line(c, line, sizeof(line)) && !line[0];
+                    if (!read_bytes(c, n, body) || !read_line(c, line, sizeof(line)) || line[0])
+                        return false;
+                }
+            }
+            return length < 0 ? r->status == 304 : read_bytes(c, (size_t)length, body);
+        }
+        if (!strncasecmp(line, "Content-Length:", 15))
+            length = strtol(line + 15, NULL, 10);
+        else if (!strncasecmp(line, "Transfer-Encoding:", 18))
+            chunked = strstr(line + 18, "chunked") != NULL;
+        else if (!strncasecmp(line, "ETag:", 5))
+            snprintf(r->etag, sizeof(r->etag), "%s", line + 5 + strspn(line + 5, " "));
+        else if (!strncasecmp(line, "Connection:", 11))
+            r->close = strstr(line + 11, "close") != NULL;
+    }
+    return false;
+}
+
+// Well-formed reply for `uri`: JSON with balanced brackets, or metrics text
+static bool body_ok(const char *uri, const reply_t *r, const body_t *b)
+{
+    if (r->status == 304)
+        return b->len == 0;
+    if (r->status != 200 || b->len < 2)
+        return false;
+    if (!strncmp(uri, "/metrics", 8))
+        return b->data[0] == '#' && b->data[b->len - 1] == '\n';
+    if (b->data[0] != '{' || strcmp(b->data + b->len - 2, "}\n"))
+        return false;
+    int depth = 0;
+    for (size_t i = 0; i < b->len && depth >= 0; i++)
+        depth += (b->data[i] == '{' || b->data[i] == '[') - (b->data[i] == '}' || b->data[i] == ']');
+    return depth == 0;
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    conn_t *c = malloc(sizeof(conn_t));
+    body_t body = {0};
+    c->fd = -1;
+    char req[512];
+    for (int k = w->index; now_us() < w->deadline_us; k++)
+    {
+        if (c->fd < 0)
+        {
+            c->fd = connect_to(w->host, w->port);
+            c->len = c->pos = 0;
+            if (c->fd < 0)
+            {
+                w->io_errors++;
+                usleep(10000);
+                continue;
+            }
+        }
+        const int u = k % w->sc->n_urls;
+        const char *uri = w->sc->urls[u];
+        int n = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s\r\n", uri, w->host);
+        if (w->sc->etag && w->etags[u][0])
+            n += snprintf(req + n, sizeof(req) - (size_t)n, "If-None-Match: %s\r\n", w->etags[u]);
+        n += snprintf(req + n, sizeof(req) - (size_t)n, "\r\n");
+
+        const int64_t t0 = now_us();
+        reply_t r;
+        if (send(c->fd, req, (size_t)n, MSG_NOSIGNAL) != n || !read_reply(c, &r, &body))
+        {
+            // Also what a connection purged to make room looks like
+            w->io_errors++;
+            close(c->fd);
+            c->fd = -1;
+            continue;
+        }
+        const uint32_t us = (uint32_t)(now_us() - t0);
+
+        if (!body_ok(uri, &r, &body))
+        {
+            if (w->bad++ < 3)
+                fprintf(stderr, "bad reply to %s: status %d, %zu B\n", uri, r.status, body.len);
+        }
+        else if (r.status == 304)
+        {
+            w->not_modified++;
+        }
+        else
+        {
+            w->ok++;
+            snprintf(w->etags[u], sizeof(w->etags[u]), "%s", r.etag);
+        }
+        w->body_bytes += body.len;
+        if (w->n == w->cap)
+        {
+            w->cap = w->cap ? 2 * w->cap : 4096;
+            w->lat_us = realloc(w->lat_us, w->cap * sizeof(uint32_t));
+            if (!w->lat_us)
+                exit(1);
+        }
+        w->lat_us[w->n++] = us;
+        if (r.close)
+        {
+            close(c->fd);
+            c->fd = -1;
+        }
+    }
+    if (c->fd >= 0)
+        close(c->fd);
+    free(c);
+    free(body.data);
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_scenario(const scenario_t *sc, const char *host, const char *port, int conns, double seconds)
+{
+    worker_t w[MAX_CONNS];
+    pthread_t th[MAX_CONNS];
+    const int64_t start = now_us();
+    for (int i = 0; i < conns; i++)
+    {
+        memset(&w[i], 0, sizeof(w[i]));
+        w[i].sc = sc;
+        w[i].host = host;
+        w[i].port = port;
+        w[i].index = i;
+        w[i].deadline_us = start + (int64_t)(seconds * 1e6);
+        pthread_create(&th[i], NULL, worker_main, &w[i]);
+    }
+    size_t total = 0;
+    for (int i = 0; i < conns; i++)
+    {
+        pthread_join(th[i], NULL);
+        total += w[i].n;
+    }
+    const double elapsed = (double)(now_us() - start) / 1e6;
+
+    uint32_t *all = malloc((total ? total : 1) * sizeof(uint32_t));
+    uint64_t bytes = 0;
+    uint32_t ok = 0, nm = 0, bad = 0, io = 0;
+    size_t k = 0;
+    for (int i = 0; i < conns; i++)
+    {
+        memcpy(all + k, w[i].lat_us, w[i].n * sizeof(uint32_t));
+        k += w[i].n;
+        bytes += w[i].body_bytes;
+        ok += w[i].ok;
+        nm += w[i].not_modified;
+        bad += w[i].bad;
+        io += w[i].io_errors;
+        free(w[i].lat_us);
+    }
+    qsort(all, total, sizeof(uint32_t), cmp_u32);
+#define PCT(p) (total ? all[(size_t)((double)(total - 1) * (p))] : 0)
+    printf("%-28s %8.0f %8u %8u %8u %8u %5.1f%% %9.1f\n", sc->name, (double)total / elapsed, PCT(0.5), PCT(0.9),
+           PCT(0.99), total ? all[total - 1] : 0, total ? 100.0 * nm / (double)total : 0.0,
+           total ? (double)bytes / (double)total : 0.0);
+#undef PCT
+    if (bad || io)
+        printf("  %u bad replies, %u connection errors\n", bad, io);
+    s_failures += bad != 0 || total == 0;
+    free(all);
+}
+
+/*========== Direct checks (in-process server) ==========*/
+typedef struct
+{
+    const char *status;
+    const char *etag;
+    char etag_copy[TELEMETRY_API_ETAG_MAX];
+    body_t body;
+} capture_t;
+
+static int cap_head(const telemetry_api_head_t *h, void *ctx)
+{
+    capture_t *c = ctx;
+    c->status = h->status;
+    c->etag = NULL;
+    if (h->etag)
+    {
+        snprintf(c->etag_copy, sizeof(c->etag_copy), "%s", h->etag);
+        c->etag = c->etag_copy;
+    }
+    return 0;
+}
+
+static int cap_body(const char *data, size_t len, bool last, void *ctx)
+{
+    (void)last;
+    body_put(&((capture_t *)ctx)->body, data, len);
+    return 0;
+}
+
+static const char *get(host_gateway_t *gw, capture_t *c, const char *uri, const char *if_none_match)
+{
+    const telemetry_api_transport_t tr = {.head = cap_head, .body = cap_body, .ctx = c};
+    c->body.len = 0;
+    body_put(&c->body, "", 0);
+    telemetry_api_handle(&gw->api, uri, if_none_match, &tr);
+    return c->status;
+}
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        s_failures++;
+    }
+}
+
+static bool count_sample(uint32_t t, const int32_t *v, void *ctx)
+{
+    (void)t;
+    (void)v;
+    (*(size_t *)ctx)++;
+    return true;
+}
+
+// Pages [t0, t1] of the log `max` samples at a time; false on a gap,
+// repeat or malformed page
+static bool page_log(host_gateway_t *gw, capture_t *c, uint32_t t0, uint32_t t1, unsigned max, size_t *count)
+{
+    char uri[128];
+    uint32_t from = t0;
+    int64_t prev = -1;
+    *count = 0;
+    for (int pages = 0; pages < 100000; pages++)
+    {
+        snprintf(uri, sizeof(uri), "/history?source=log&from=%u&to=%u&max=%u", from, t1, max);
+        if (strcmp(get(gw, c, uri, NULL), "200 OK"))
+            return false;
+        const char *p = strstr(c->body.data, "\"samples\":[");
+        if (!p)
+            return false;
+        p += 11;
+        size_t n = 0;
+        while (*p == '[' || *p == ',')
+        {
+            p += *p == ',';
+            if (*p != '[')
+                return false;
+            char *end;
+            const unsigned long t = strtoul(p + 1, &end, 10);
+            if ((int64_t)t <= prev || t < t0 || t > t1)
+                return false;
+            prev = (int64_t)t;
+            n++;
+            p = strchr(end, ']');
+            if (!p)
+                return false;
+            p++;
+        }
+        if (n > max)
+            return false;
+        *count += n;
+        const char *next = strstr(p, "\"next\":");
+        if (!next)
+            return true;
+        from = (uint32_t)strtoul(next + 7, NULL, 10);
+    }
+    return false;
+}
+
+static void run_checks(host_gateway_t *gw)
+{
+    capture_t c = {0};
+
+    // Conditional GET: 304 with no body until the next reading
+    check(!strcmp(get(gw, &c, "/status.json", NULL), "200 OK") && c.etag, "status.json has an ETag");
+    char etag[TELEMETRY_API_ETAG_MAX];
+    snprintf(etag, sizeof(etag), "%s", c.etag ? c.etag : "");
+    char list[96];
+    snprintf(list, sizeof(list), "\"x\", W/%s", etag);
+    check(!strcmp(get(gw, &c, "/status.json", etag), "304 Not Modified") && c.body.len == 0,
+          "same ETag gets a bodyless 304");
+    check(!strcmp(get(gw, &c, "/status.json", list), "304 Not Modified"), "weak ETag in a list matches");
+    host_gateway_take_reading(gw);
+    check(!strcmp(get(gw, &c, "/status.json", etag), "200 OK"), "new reading changes the ETag");
+    check(!strcmp(get(gw, &c, "/history?sensor=pressure", NULL), "400 Bad Request"), "unknown sensor is a 400");
+    check(!strcmp(get(gw, &c, "/history?source=log&from=10&to=5", NULL), "400 Bad Request"), "from > to is a 400");
+    check(!strcmp(get(gw, &c, "/nope", NULL), "404 Not Found"), "unknown path is a 404");
+
+    // Paging through the log with "next" returns exactly the stored samples
+    uint32_t first, last;
+    tlog_range(&gw->log, &first, &last);
+    const uint32_t ranges[][2] = {{last - 6 * 3600, last}, {first, first + 1000}, {last - 300, last}};
+    const unsigned maxes[] = {1, 63, 64, 65, 500, 1800};
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++)
+    {
+        size_t want = 0;
+        tlog_query(&gw->log, ranges[r][0], ranges[r][1], count_sample, &want, NULL);
+        for (size_t m = 0; m < sizeof(maxes) / sizeof(maxes[0]); m++)
+        {
+            if (maxes[m] == 1 && want > 400)
+                continue;
+            size_t got = 0;
+            const bool ok = page_log(gw, &c, ranges[r][0], ranges[r][1], maxes[m], &got);
+            if (!ok || got != want)
+            {
+                printf("FAIL: log %u..%u by %u: %zu of %zu samples%s\n", ranges[r][0], ranges[r][1], maxes[m], got,
+                       want, ok ? "" : ", bad page");
+                s_failures++;
+            }
+        }
+    }
+
+    // Device flash time of a log reply, from the emulator's counters
+    static const char *const log_uris[] = {"/history?source=log&last=600", "/history?source=log&last=3600"};
+    for (size_t i = 0; i < sizeof(log_uris) / sizeof(log_uris[0]); i++)
+    {
+        const flash_file_counters_t before = gw->flash.count;
+        get(gw, &c, log_uris[i], NULL);
+        flash_file_counters_t d = gw->flash.count;
+        d.reads -= before.reads;
+        d.bytes_read -= before.bytes_read;
+        d.writes = d.erases = 0;
+        d.bytes_written = 0;
+        printf("%-32s %6zu B body, %4u flash reads, %6llu B, ~%.1f ms device flash time\n", log_uris[i], c.body.len,
+               d.reads, (unsigned long long)d.bytes_read, flash_file_device_ms(&d));
+    }
+    free(c.body.data);
+    printf("checks: %s\n\n", s_failures ? "FAILED" : "ok");
+}
+
+/*========== Main ==========*/
+static volatile bool s_stop_server = false;
+
+static void *server_main(void *arg)
+{
+    host_gateway_run(arg, &s_stop_server);
+    return NULL;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-H HOST] [-p PORT] [-c CONNS] [-d SECONDS] [-u URL]... [--no-etag]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = NULL;
+    char port[8] = "80";
+    int conns = 4;
+    double seconds = 3;
+    scenario_t custom = {.name = "custom", .etag = true};
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_arg = i + 1 < argc;
+        if (!strcmp(argv[i], "-H") && has_arg)
+            host = argv[++i];
+        else if (!strcmp(argv[i], "-p") && has_arg)
+            snprintf(port, sizeof(port), "%s", argv[++i]);
+        else if (!strcmp(argv[i], "-c") && has_arg)
+            conns = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && has_arg)
+            seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-u") && has_arg && custom.n_urls < MAX_URLS)
+            custom.urls[custom.n_urls++] = argv[++i];
+        else if (!strcmp(argv[i], "--no-etag"))
+            custom.etag = false;
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (conns < 1 || conns > MAX_CONNS || seconds <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    host_gateway_t *gw = NULL;
+    pthread_t server;
+    if (!host)
+    {
+        const host_gateway_config_t cfg = {
+            .max_conns = 7,
+            .period_ms = 2000,
+            .days = 7,
+            .buffer_size = 1024,
+            .max_points = 240,
+            .max_samples = 1800,
+        };
+        gw = malloc(sizeof(*gw));
+        if (!gw || !host_gateway_open(gw, &cfg))
+        {
+            fprintf(stderr, "cannot start the host server\n");
+            return 1;
+        }
+        run_checks(gw);
+        host = "127.0.0.1";
+        snprintf(port, sizeof(port), "%u", gw->shim.port);
+        pthread_create(&server, NULL, server_main, gw);
+    }
+
+    static const scenario_t scenarios[] = {
+        {"status, If-None-Match", {"/status.json"}, 1, true},
+        {"status, unconditional", {"/status.json"}, 1, false},
+        {"history 400 s raw", {"/history?sensor=temperature&last=400"}, 1, false},
+        {"history 3 h by minute", {"/history?sensor=temperature&last=10800"}, 1, false},
+        {"history 7 d by hour", {"/history?sensor=humidity&last=604800"}, 1, false},
+        {"log 10 min", {"/history?source=log&last=600"}, 1, false},
+        {"log 1 h (chunked)", {"/history?source=log&last=3600"}, 1, false},
+        {"metrics", {"/metrics"}, 1, false},
+        {"dashboard mix, If-None-Match",
+         {"/status.json", "/status.json", "/status.json", "/status.json", "/status.json", "/status.json",
+          "/history?sensor=temperature&last=3600", "/metrics"},
+         8,
+         true},
+    };
+    printf("%s:%s, %d connections, %.0f s per scenario\n", host, port, conns, seconds);
+    printf("%-28s %8s %8s %8s %8s %8s %6s %9s\n", "scenario", "req/s", "p50 us", "p90 us", "p99 us", "max us", "304",
+           "B/reply");
+    if (custom.n_urls)
+    {
+        run_scenario(&custom, host, port, conns, seconds);
+    }
+    else
+    {
+        for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+            run_scenario(&scenarios[i], host, port, conns, seconds);
+    }
+
+    if (gw)
+    {
+        s_stop_server = true;
+        pthread_join(server, NULL);
+        printf("server: %llu requests, %u connections purged\n", (unsigned long long)gw->shim.requests,
+               gw->shim.purged);
+        host_gateway_close(gw);
+        free(gw);
+    }
+    return s_failures ? 1 : 0;
+}
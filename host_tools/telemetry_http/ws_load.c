@@ -0,0 +1,405 @@
+// telemetry_ws_load: fan-out of live readings to WebSocket clients
+// (firmware/esp_idf_shared_components/telemetry_http/src/telemetry_push.c).
+//
+//   telemetry_ws_load [-i PERIOD_MS] [-d SECONDS] [-q DEPTH] [-n MAX_CLIENTS]
+//
+// Runs the host server (host_gateway.c) in-process with a reading every
+// PERIOD_MS (5, far faster than the sensor, to load the push path) and
+// connects 1, 2, 4, ... MAX_CLIENTS (64) WebSocket clients to /ws, each
+// step for SECONDS (2). Every frame is checked and its latency taken from
+// the reading's sample_us to its arrival. Reports delivered frames per
+// second, latency percentiles, `seq` gaps (frames dropped for a client)
+// and the server's memory per client. A last step adds a client that
+// never reads to 4 others: it must be closed once DEPTH (8) frames are
+// queued and its socket is full, without gaps or delay for the others.
+// Exits non-zero on a malformed frame, a failed handshake, a client left
+// without frames, or a slow client that is not closed.
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host_gateway.h"
+
+typedef struct
+{
+    int fd;
+    bool slow;   // never reads
+    bool closed; // by the server
+    size_t len;
+    uint8_t buf[8192];
+    int64_t last_seq;
+    uint32_t frames, gaps;
+} client_t;
+
+typedef struct
+{
+    uint32_t *v;
+    size_t n, cap;
+} samples_t;
+
+static int s_failures = 0;
+static volatile bool s_stop_server = false;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void add_sample(samples_t *s, uint32_t v)
+{
+    if (s->n == s->cap)
+    {
+        s->cap = s->cap ? 2 * s->cap : 4096;
+        s->v = realloc(s->v, s->cap * sizeof(uint32_t));
+        if (!s->v)
+            exit(1);
+    }
+    s->v[s->n++] = v;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void *server_main(void *arg)
+{
+    host_gateway_run(arg, &s_stop_server);
+    return NULL;
+}
+
+/*========== Client ==========*/
+static bool client_open(client_t *c, uint16_t port, bool slow)
+{
+    memset(c, 0, sizeof(*c));
+    c->slow = slow;
+    c->last_seq = -1;
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0)
+        return false;
+    if (slow)
+    {
+        const int rcvbuf = 1; // the kernel minimum
+        setsockopt(c->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const struct timeval tv = {.tv_sec = 5};
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        return false;
+
+    static const char req[] = "GET /ws HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    if (send(c->fd, req, sizeof(req) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(req) - 1))
+        return false;
+    char *end = NULL;
+    while (!end)
+    {
+        const ssize_t r = recv(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len, 0);
+        if (r <= 0)
+            return false;
+        c->len += (size_t)r;
+        c->buf[c->len] = 0;
+        end = strstr((char *)c->buf, "\r\n\r\n");
+    }
+    // The accept value of RFC 6455's sample key
+    if (strncmp((char *)c->buf, "HTTP/1.1 101 ", 13) ||
+        !strstr((char *)c->buf, "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"))
+        return false;
+    const size_t head = (size_t)(end + 4 - (char *)c->buf);
+    memmove(c->buf, c->buf + head, c->len - head);
+    c->len -= head;
+    return true;
+}
+
+// Takes the complete frames in c->buf; false on a malformed one
+static bool client_parse(client_t *c, samples_t *lat)
+{
+    size_t pos = 0;
+    while (c->len - pos >= 2)
+    {
+        const uint8_t *f = c->buf + pos;
+        if (f[0] != 0x81 || (f[1] & 0x80))
+            return false; // not a final unmasked text frame
+        size_t h = 2, n = f[1] & 0x7F;
+        if (n == 126)
+        {
+            if (c->len - pos < 4)
+                break;
+            n = (size_t)f[2] << 8 | f[3];
+            h = 4;
+        }
+        else if (n == 127)
+        {
+            return false;
+        }
+        if (c->len - pos < h + n)
+            break;
+
+        char json[256];
+        if (n >= sizeof(json))
+            return false;
+        memcpy(json, f + h, n);
+        json[n] = 0;
+        unsigned long seq;
+        long long sample_us;
+        int used = 0;
+        if (sscanf(json, "{\"seq\":%lu,\"temp_c\":%*[-0-9.],\"humidity\":%*[-0-9.],\"sample_us\":%lld}%n", &seq,
+                   &sample_us, &used) != 2 ||
+            (size_t)used != n)
+            return false;
+        if ((int64_t)seq <= c->last_seq)
+            return false;
+        if (c->last_seq >= 0)
+            c->gaps += (uint32_t)((int64_t)seq - c->last_seq - 1);
+        c->last_seq = (int64_t)seq;
+        c->frames++;
+        add_sample(lat, (uint32_t)(now_us() - sample_us));
+        pos += h + n;
+    }
+    memmove(c->buf, c->buf + pos, c->len - pos);
+    c->len -= pos;
+    return true;
+}
+
+/*========== Steps ==========*/
+typedef struct
+{
+    double frames_per_s;
+    uint32_t p50, p99, max;
+    uint32_t gaps; // of the clients that read
+    uint32_t bad;
+    bool slow_closed;
+} step_result_t;
+
+// `n` clients (the first `slow` of them never read) for `seconds`
+static step_result_t run_step(host_gateway_t *gw, int n, int slow, double seconds)
+{
+    step_result_t res = {0};
+    client_t *cl = calloc((size_t)n, sizeof(client_t));
+    samples_t lat = {0};
+    if (!cl)
+        exit(1);
+
+    s_stop_server = false;
+    pthread_t server;
+    pthread_create(&server, NULL, server_main, gw);
+    usleep(50000); // closes from the last step are noticed first
+
+    for (int i = 0; i < n; i++)
+    {
+        if (!client_open(&cl[i], gw->shim.port, i < slow))
+        {
+            printf("FAIL: handshake of client %d\n", i + 1);
+            s_failures++;
+            cl[i].closed = true;
+        }
+    }
+
+    const int64_t start = now_us(), end = start + (int64_t)(seconds * 1e6);
+    struct pollfd *pfd = calloc((size_t)n, sizeof(struct pollfd));
+    uint64_t frames = 0;
+    while (now_us() < end)
+    {
+        for (int i = 0; i < n; i++)
+            pfd[i] = (struct pollfd){.fd = cl[i].slow || cl[i].closed ? -1 : cl[i].fd, .events = POLLIN};
+        if (poll(pfd, (nfds_t)n, 20) <= 0)
+            continue;
+        for (int i = 0; i < n; i++)
+        {
+            client_t *c = &cl[i];
+            if (!pfd[i].revents)
+                continue;
+            const ssize_t r = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, MSG_DONTWAIT);
+            if (r <= 0 && !(r < 0 && (errno == EAGAIN || errno == EINTR)))
+            {
+                c->closed = true;
+                continue;
+            }
+            if (r < 0)
+                continue;
+            c->len += (size_t)r;
+            const uint32_t before = c->frames;
+            if (!client_parse(c, &lat))
+            {
+                res.bad++;
+                c->closed = true;
+            }
+            frames += c->frames - before;
+        }
+    }
+    const double elapsed = (double)(now_us() - start) / 1e6;
+
+    s_stop_server = true;
+    pthread_join(server, NULL);
+
+    for (int i = 0; i < n; i++)
+    {
+        client_t *c = &cl[i];
+        if (c->slow)
+        {
+            // Drain what the server wrote; a closed client ends in EOF
+            int64_t seen = -1;
+            for (;;)
+            {
+                const ssize_t r = recv(c->fd, c->buf, sizeof(c->buf), MSG_DONTWAIT);
+                if (r == 0)
+                {
+                    res.slow_closed = true;
+                    break;
+                }
+                if (r < 0 && seen >= 0 && now_us() - seen > 200000)
+                    break;
+                if (r < 0)
+                {
+                    if (seen < 0)
+                        seen = now_us();
+                    usleep(1000);
+                }
+                else
+                {
+                    seen = now_us();
+                }
+            }
+        }
+        else
+        {
+            res.gaps += c->gaps;
+            if (!c->frames && !c->closed)
+            {
+                printf("FAIL: client %d got no frames\n", i + 1);
+                s_failures++;
+            }
+        }
+        close(c->fd);
+    }
+
+    qsort(lat.v, lat.n, sizeof(uint32_t), cmp_u32);
+    res.frames_per_s = (double)frames / elapsed;
+    res.p50 = lat.n ? lat.v[(lat.n - 1) / 2] : 0;
+    res.p99 = lat.n ? lat.v[(size_t)((double)(lat.n - 1) * 0.99)] : 0;
+    res.max = lat.n ? lat.v[lat.n - 1] : 0;
+    if (res.bad)
+    {
+        printf("FAIL: %u malformed frames\n", res.bad);
+        s_failures++;
+    }
+    free(lat.v);
+    free(pfd);
+    free(cl);
+    return res;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-i PERIOD_MS] [-d SECONDS] [-q DEPTH] [-n MAX_CLIENTS]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t period_ms = 5, depth = 8;
+    double seconds = 2;
+    int max_clients = HTTP_SHIM_MAX_CONNS;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_arg = i + 1 < argc;
+        if (!strcmp(argv[i], "-i") && has_arg)
+            period_ms = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && has_arg)
+            seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-q") && has_arg)
+            depth = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && has_arg)
+            max_clients = atoi(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!period_ms || !depth || seconds <= 0 || max_clients < 5 || max_clients > HTTP_SHIM_MAX_CONNS)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    const host_gateway_config_t cfg = {
+        .max_conns = max_clients,
+        .period_ms = period_ms,
+        .days = 0,
+        .buffer_size = 1024,
+        .max_points = 240,
+        .max_samples = 1800,
+        .ws_clients = (size_t)max_clients,
+        .ws_depth = depth,
+    };
+    host_gateway_t *gw = malloc(sizeof(*gw));
+    if (!gw || !host_gateway_open(gw, &cfg))
+    {
+        fprintf(stderr, "cannot start the host server\n");
+        return 1;
+    }
+
+    const telemetry_push_config_t one = {.max_clients = 1, .depth = depth};
+    printf("a reading every %u ms, %u frames queued per client, %.0f s per step\n", period_ms, depth, seconds);
+    printf("server memory: %zu B per client, %zu B of frames shared (host shim connection: %zu B, not on the "
+           "gateway)\n\n",
+           sizeof(telemetry_push_client_t), telemetry_push_mem_size(&one) - sizeof(telemetry_push_client_t),
+           sizeof(http_shim_conn_t));
+    printf("%8s %10s %10s %8s %8s %8s %6s %12s\n", "clients", "frames/s", "per client", "p50 us", "p99 us",
+           "max us", "gaps", "write avg us");
+
+    for (int n = 1;; n = n * 2 > max_clients && n < max_clients ? max_clients : n * 2)
+    {
+        const telemetry_push_stats_t before = gw->push.stats;
+        const step_result_t r = run_step(gw, n, 0, seconds);
+        const telemetry_push_stats_t *after = &gw->push.stats;
+        const uint32_t sent = after->frames_sent - before.frames_sent;
+        printf("%8d %10.0f %10.1f %8u %8u %8u %6u %12.1f\n", n, r.frames_per_s, r.frames_per_s / n, r.p50, r.p99,
+               r.max, r.gaps, sent ? (double)(after->latency_sum_us - before.latency_sum_us) / sent : 0.0);
+        if (n >= max_clients)
+            break;
+    }
+
+    // One client that never reads among 4 that do
+    const telemetry_push_stats_t before = gw->push.stats;
+    const double slow_s = seconds > 3 ? seconds : 3;
+    const step_result_t r = run_step(gw, 5, 1, slow_s);
+    const uint32_t closed = gw->push.stats.slow_closed - before.slow_closed;
+    const uint32_t dropped = gw->push.stats.dropped - before.dropped;
+    printf("\n4 + 1 not reading, %.0f s: %.0f frames/s, p99 %u us, max %u us, %u gaps; slow client %s, "
+           "%u frames dropped for it\n",
+           slow_s, r.frames_per_s, r.p99, r.max, r.gaps, r.slow_closed ? "closed" : "still open", dropped);
+    if (r.gaps)
+    {
+        printf("FAIL: the clients that read lost frames to the slow one\n");
+        s_failures++;
+    }
+    if (!closed || !r.slow_closed)
+    {
+        printf("FAIL: the client that never reads was not closed\n");
+        s_failures++;
+    }
+
+    host_gateway_close(gw);
+    free(gw);
+    printf("%s\n", s_failures ? "FAILED" : "all checks passed");
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+// telemetry_link_bench: throughput and round-trip check of the uart_bridge
+// binary link, using the firmware's frame encoder.
+//
+//   telemetry_link_bench [-n SAMPLES] [-b BATCH] [--baud BAUD]
+//
+// Encodes SAMPLES synthetic readings into frames of BATCH samples, mixes in
+// console lines and corrupts a few frames, decodes the stream in serial-sized
+// reads and checks every surviving sample against the original. Reports
+// wire bytes per sample against the JSON line transport and how many
+// samples/s each would fit into BAUD. Exits non-zero on any mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "telemetry_frame.h"
+#include "telemetry_link.h"
+
+static const char *kDeviceId = "esp32_1";
+static const size_t kCorruptEvery = 997; // frames
+static const size_t kTextEvery = 500;    // frames
+static const size_t kReadSize = 4096;    // bytes per read(), like a serial port
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n SAMPLES] [-b BATCH] [--baud BAUD]\n", argv0);
+}
+
+static std::vector<telemetry_sample_t> makeSamples(size_t n)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> step(-1, 1);
+    std::uniform_int_distribution<int> jitter(-800, 800);
+
+    std::vector<telemetry_sample_t> out(n);
+    int32_t temp = 253, hum = 601;
+    int64_t ts = 1500000;
+    for (size_t i = 0; i < n; i++)
+    {
+        temp += step(rng);
+        hum += 2 * step(rng);
+        ts += 2000000 + jitter(rng);
+        out[i] = {(uint32_t)(i + 1), ts, temp, hum};
+    }
+    return out;
+}
+
+static size_t jsonLineSize(const telemetry_sample_t &s)
+{
+    char line[128];
+    return (size_t)snprintf(line, sizeof(line), "{\"device_id\":\"%s\",\"temp_c\":%.1f,\"humidity\":%.1f}\n",
+                            kDeviceId, s.temp_dc / 10.0, s.hum_dpct / 10.0);
+}
+
+static bool sameSample(const TelemetrySample &got, const telemetry_sample_t &want)
+{
+    return got.deviceId == kDeviceId && got.seq == want.seq && got.tsUs == want.ts_us &&
+           got.tempDc == want.temp_dc && got.humDpct == want.hum_dpct;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = 1000000;
+    size_t batch = 8;
+    double baud = 921600;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            count = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            batch = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--baud") && i + 1 < argc)
+            baud = strtod(argv[++i], nullptr);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (count == 0 || batch == 0 || batch > TELEMETRY_FRAME_MAX_SAMPLES || baud <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const std::vector<telemetry_sample_t> samples = makeSamples(count);
+
+    // ----- Encode -----
+    std::vector<uint8_t> stream;
+    stream.reserve(count * 16);
+    std::vector<uint8_t> payload(TELEMETRY_FRAME_MAX_PAYLOAD(TELEMETRY_FRAME_MAX_SAMPLES));
+    std::vector<uint8_t> wire(TELEMETRY_FRAME_MAX_WIRE(payload.size()));
+    std::vector<bool> corrupted;
+    size_t frameBytes = 0, jsonBytes = 0;
+
+    const Clock::time_point t0 = Clock::now();
+    for (size_t first = 0; first < count; first += batch)
+    {
+        const size_t n = std::min(batch, count - first);
+        const size_t len = telemetry_frame_build_samples(kDeviceId, (uint32_t)corrupted.size(), &samples[first], n,
+                                                         payload.data(), payload.size());
+        const size_t w = telemetry_frame_cobs_encode(payload.data(), len, wire.data());
+        stream.insert(stream.end(), wire.begin(), wire.begin() + w);
+        frameBytes += w;
+        corrupted.push_back(false);
+    }
+    const double encodeS = secondsSince(t0);
+
+    // Damage the stream after timing the encoder: flip a byte inside some
+    // frames and put log lines between others
+    {
+        std::vector<uint8_t> mixed;
+        mixed.reserve(stream.size() + stream.size() / 8);
+        size_t frame = 0;
+        for (size_t i = 0; i < stream.size();)
+        {
+            // Each frame is 0x00 <cobs> 0x00
+            size_t end = i + 1;
+            while (stream[end] != TELEMETRY_FRAME_DELIMITER)
+                end++;
+            const size_t start = mixed.size();
+            mixed.insert(mixed.end(), stream.begin() + i, stream.begin() + end + 1);
+            if (frame % kCorruptEvery == kCorruptEvery - 1)
+            {
+                mixed[start + (end - i) / 2] ^= 0x5A;
+                if (mixed[start + (end - i) / 2] == 0)
+                    mixed[start + (end - i) / 2] = 0x33;
+                corrupted[frame] = true;
+            }
+            if (frame % kTextEvery == 0)
+            {
+                static const char line[] = "I (1234) UART_BRIDGE: log line on the same port\n";
+                mixed.insert(mixed.end(), line, line + sizeof(line) - 1);
+            }
+            frame++;
+            i = end + 1;
+        }
+        stream.swap(mixed);
+    }
+
+    for (const telemetry_sample_t &s : samples)
+        jsonBytes += jsonLineSize(s);
+
+    // ----- Decode -----
+    std::vector<TelemetrySample> decoded;
+    decoded.reserve(count);
+    TelemetryStreamDecoder decoder([&](const TelemetrySample &s) { decoded.push_back(s); });
+
+    const Clock::time_point t1 = Clock::now();
+    for (size_t i = 0; i < stream.size(); i += kReadSize)
+        decoder.feed(stream.data() + i, std::min(kReadSize, stream.size() - i));
+    decoder.finish();
+    const double decodeS = secondsSince(t1);
+
+    // ----- Check -----
+    size_t expected = 0, lost = 0, mismatches = 0, badExpected = 0;
+    size_t di = 0;
+    for (size_t f = 0; f < corrupted.size(); f++)
+    {
+        const size_t first = f * batch;
+        const size_t n = std::min(batch, count - first);
+        if (corrupted[f])
+        {
+            badExpected++;
+            lost += n;
+            continue;
+        }
+        for (size_t k = 0; k < n; k++, di++)
+        {
+            expected++;
+            if (di >= decoded.size() || !sameSample(decoded[di], samples[first + k]))
+                mismatches++;
+        }
+    }
+    if (decoded.size() != expected)
+        mismatches++;
+
+    const TelemetryStreamDecoder::Stats &st = decoder.stats();
+    const double binPerSample = (double)frameBytes / count;
+    const double jsonPerSample = (double)jsonBytes / count;
+    const double bytesPerSecond = baud / 10.0; // 8N1
+
+    printf("samples          %zu in %zu frames of %zu\n", count, corrupted.size(), batch);
+    printf("wire bytes/sample binary %.2f  json %.2f  (%.1fx smaller)\n", binPerSample, jsonPerSample,
+           jsonPerSample / binPerSample);
+    printf("link @ %.0f baud  binary %.0f samples/s  json %.0f samples/s\n", baud, bytesPerSecond / binPerSample,
+           bytesPerSecond / jsonPerSample);
+    printf("encode           %.1f ms  %.1f MB/s  %.2f Msamples/s\n", encodeS * 1e3, frameBytes / encodeS / 1e6,
+           count / encodeS / 1e6);
+    printf("decode           %.1f ms  %.1f MB/s  %.2f Msamples/s\n", decodeS * 1e3, stream.size() / decodeS / 1e6,
+           st.samples / decodeS / 1e6);
+    printf("stream           frames=%llu bad=%llu (expected %zu) text_bytes=%llu frame_gaps=%llu sample_gaps=%llu "
+           "(expected %zu)\n",
+           (unsigned long long)st.frames, (unsigned long long)st.badFrames, badExpected,
+           (unsigned long long)st.textBytes, (unsigned long long)st.frameGaps, (unsigned long long)st.sampleGaps,
+           lost);
+
+    const bool ok = mismatches == 0 && st.badFrames == badExpected && st.sampleGaps == lost;
+    printf("round trip       %s (%zu samples checked, %zu mismatches)\n", ok ? "OK" : "FAILED", expected,
+           mismatches);
+    return ok ? 0 : 1;
+}
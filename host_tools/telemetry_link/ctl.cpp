@@ -0,0 +1,507 @@
+// telemetry_ctl: command channel client for the uart_bridge binary link.
+//
+//   telemetry_ctl [-b BAUD] [-t TIMEOUT_MS] PORT ping|stats|listen|provision
+//   telemetry_ctl [-b BAUD] [-t TIMEOUT_MS] PORT rates UART_MS SAMPLE_MS
+//   telemetry_ctl [-b BAUD] [-t TIMEOUT_MS] PORT history [FROM_SEQ]
+//   telemetry_ctl selftest
+//
+// `rates` takes 0 for a rate to keep. `listen` prints samples as JSON lines
+// until interrupted. `selftest` runs the firmware's command server
+// (telemetry_cmd.c) as a simulated node on a pseudo-terminal pair and
+// drives it through the client: lost responses, garbage, a mute node and a
+// round-trip time measurement. Exits non-zero on any failed check.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "telemetry_client.h"
+#include "telemetry_cmd.h"
+#include "telemetry_frame.h"
+
+using Clock = std::chrono::steady_clock;
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-b BAUD] [-t TIMEOUT_MS] PORT ping|stats|listen|provision\n"
+            "       %s [-b BAUD] [-t TIMEOUT_MS] PORT rates UART_MS SAMPLE_MS\n"
+            "       %s [-b BAUD] [-t TIMEOUT_MS] PORT history [FROM_SEQ]\n"
+            "       %s selftest\n",
+            argv0, argv0, argv0, argv0);
+}
+
+static bool setRaw(int fd, long baud, std::string &error)
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        error = std::string("tcgetattr: ") + strerror(errno);
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (baud)
+    {
+        static const struct
+        {
+            long baud;
+            speed_t speed;
+        } kSpeeds[] = {
+            {9600, B9600},       {19200, B19200},     {38400, B38400},     {57600, B57600},
+            {115200, B115200},   {230400, B230400},   {460800, B460800},   {921600, B921600},
+            {1000000, B1000000}, {1500000, B1500000}, {2000000, B2000000}, {3000000, B3000000},
+            {4000000, B4000000},
+        };
+        speed_t speed = 0;
+        for (const auto &s : kSpeeds)
+            if (s.baud == baud)
+                speed = s.speed;
+        if (!speed)
+        {
+            error = "unsupported baud " + std::to_string(baud);
+            return false;
+        }
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+    if (tcsetattr(fd, TCSANOW, &tio) != 0)
+    {
+        error = std::string("tcsetattr: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+static void printStats(const std::vector<uint64_t> &v)
+{
+    static const char *kNames[TELEMETRY_STAT_COUNT] = {
+        "uptime_ms", "frames", "samples", "bytes", "dropped", "requests", "bad_requests", "uart_interval_ms",
+        "sample_period_ms",
+    };
+    for (size_t i = 0; i < v.size(); i++)
+        printf("%-17s %llu\n", i < TELEMETRY_STAT_COUNT ? kNames[i] : "?", (unsigned long long)v[i]);
+}
+
+// ===== Simulated node =====
+// The firmware's command server with handlers that mimic uart_bridge, on
+// the slave side of a pty. One thread: it also emits a sample every
+// sample_period_ms, so frames never interleave on the wire.
+class SimulatedNode
+{
+public:
+    explicit SimulatedNode(int fd) : _fd(fd)
+    {
+        const telemetry_cmd_server_config_t cfg = {
+            .device_id = "sim_node",
+            .handler = &SimulatedNode::handle_,
+            .handler_ctx = this,
+            .write = &SimulatedNode::write_,
+            .write_ctx = this,
+        };
+        telemetry_cmd_server_init(&_server, &cfg);
+    }
+
+    void start() { _thread = std::thread([this] { run_(); }); }
+    void stop()
+    {
+        _stop = true;
+        _thread.join();
+    }
+
+    std::atomic<bool> mute{false}; // swallow every response
+    std::atomic<int> dropEvery{0}; // lose the first response of every n-th request
+    std::atomic<uint32_t> setRatesRuns{0};
+
+    uint32_t badRequests() const { return _server.bad_requests; }
+    uint32_t duplicates() const { return _server.duplicates; }
+
+private:
+    static telemetry_status_t handle_(uint8_t cmd, const uint64_t *args, size_t nArgs, uint8_t *result,
+                                      size_t cap, size_t *resultLen, void *ctx)
+    {
+        SimulatedNode *self = (SimulatedNode *)ctx;
+        switch (cmd)
+        {
+        case TELEMETRY_CMD_PING:
+            *resultLen = telemetry_cmd_put_values(args, nArgs, result);
+            return TELEMETRY_STATUS_OK;
+        case TELEMETRY_CMD_SET_RATES:
+        {
+            if (nArgs != 2)
+                return TELEMETRY_STATUS_BAD_ARGS;
+            self->setRatesRuns++;
+            if (args[0])
+                self->_intervalMs = (uint32_t)args[0];
+            if (args[1])
+                self->_periodMs = (uint32_t)args[1];
+            const uint64_t applied[2] = {self->_intervalMs, self->_periodMs};
+            *resultLen = telemetry_cmd_put_values(applied, 2, result);
+            return TELEMETRY_STATUS_OK;
+        }
+        case TELEMETRY_CMD_GET_STATS:
+        {
+            uint64_t v[TELEMETRY_STAT_COUNT] = {};
+            v[TELEMETRY_STAT_UPTIME_MS] =
+                (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - self->_t0).count();
+            v[TELEMETRY_STAT_FRAMES] = self->_history.size();
+            v[TELEMETRY_STAT_SAMPLES] = self->_history.size();
+            v[TELEMETRY_STAT_REQUESTS] = self->_server.requests;
+            v[TELEMETRY_STAT_BAD_REQUESTS] = self->_server.bad_requests;
+            v[TELEMETRY_STAT_UART_INTERVAL_MS] = self->_intervalMs;
+            v[TELEMETRY_STAT_SAMPLE_PERIOD_MS] = self->_periodMs;
+            *resultLen = telemetry_cmd_put_values(v, TELEMETRY_STAT_COUNT, result);
+            return TELEMETRY_STATUS_OK;
+        }
+        case TELEMETRY_CMD_DUMP_HISTORY:
+        {
+            if (nArgs != 2)
+                return TELEMETRY_STATUS_BAD_ARGS;
+            const size_t max = std::min<uint64_t>(args[1], TELEMETRY_CMD_MAX_HISTORY);
+            telemetry_sample_t page[TELEMETRY_CMD_MAX_HISTORY];
+            size_t n = 0;
+            uint32_t next = (uint32_t)args[0];
+            for (const telemetry_sample_t &s : self->_history)
+            {
+                if (n == max)
+                    break;
+                if (s.seq < args[0])
+                    continue;
+                page[n++] = s;
+                next = s.seq + 1;
+            }
+            if (cap < TELEMETRY_CMD_HISTORY_RESULT_SIZE(n))
+                return TELEMETRY_STATUS_FAILED;
+            size_t len = telemetry_frame_put_varint(result, next);
+            *resultLen = len + telemetry_frame_put_samples(page, n, result + len);
+            return TELEMETRY_STATUS_OK;
+        }
+        case TELEMETRY_CMD_START_PROVISIONING:
+            if (self->_provisioning)
+                return TELEMETRY_STATUS_UNAVAILABLE; // a round is running
+            self->_provisioning = true;
+            return TELEMETRY_STATUS_OK;
+        default:
+            return TELEMETRY_STATUS_UNKNOWN_CMD;
+        }
+    }
+
+    static void write_(const uint8_t *data, size_t len, void *ctx)
+    {
+        SimulatedNode *self = (SimulatedNode *)ctx;
+        if (self->mute)
+            return;
+        const int every = self->dropEvery;
+        const uint32_t req = self->_server.requests;
+        if (every && req % every == 0 && req != self->_lastDropped)
+        {
+            self->_lastDropped = req; // the resend gets through
+            return;
+        }
+        self->writeAll_(data, len);
+    }
+
+    void writeAll_(const uint8_t *data, size_t len)
+    {
+        while (len)
+        {
+            const ssize_t n = write(_fd, data, len);
+            if (n <= 0)
+            {
+                if (n < 0 && (errno == EINTR || errno == EAGAIN))
+                    continue;
+                return;
+            }
+            data += n;
+            len -= (size_t)n;
+        }
+    }
+
+    void emitSample_()
+    {
+        telemetry_sample_t s;
+        s.seq = ++_seq;
+        s.ts_us = (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - _t0).count();
+        s.temp_dc = 250 + (int32_t)(_seq % 7) - 3;
+        s.hum_dpct = 600 + (int32_t)(_seq % 11);
+        _history.push_back(s);
+        if (_history.size() > 256)
+            _history.pop_front();
+
+        uint8_t payload[TELEMETRY_FRAME_MAX_PAYLOAD(1)];
+        uint8_t wire[TELEMETRY_FRAME_MAX_WIRE(sizeof(payload))];
+        const size_t len = telemetry_frame_build_samples("sim_node", _frameSeq++, &s, 1, payload, sizeof(payload));
+        writeAll_(wire, telemetry_frame_cobs_encode(payload, len, wire));
+    }
+
+    void run_()
+    {
+        Clock::time_point nextSample = Clock::now();
+        uint8_t buf[256];
+        while (!_stop)
+        {
+            struct pollfd pfd = {_fd, POLLIN, 0};
+            if (poll(&pfd, 1, 1) > 0)
+            {
+                const ssize_t n = read(_fd, buf, sizeof(buf));
+                if (n > 0)
+                    telemetry_cmd_server_feed(&_server, buf, (size_t)n);
+            }
+            if (_periodMs && Clock::now() >= nextSample)
+            {
+                emitSample_();
+                nextSample = Clock::now() + std::chrono::milliseconds(_periodMs);
+            }
+        }
+    }
+
+    int _fd;
+    telemetry_cmd_server_t _server;
+    std::thread _thread;
+    std::atomic<bool> _stop{false};
+    Clock::time_point _t0 = Clock::now();
+    uint32_t _intervalMs = 2000;
+    uint32_t _periodMs = 0; // no samples until SET_RATES
+    uint32_t _seq = 0;
+    uint32_t _frameSeq = 0;
+    uint32_t _lastDropped = 0;
+    bool _provisioning = false;
+    std::deque<telemetry_sample_t> _history;
+};
+
+static int g_failures = 0;
+
+static void check(bool ok, const char *what, const std::string &detail = "")
+{
+    printf("%-4s %s%s%s\n", ok ? "ok" : "FAIL", what, detail.empty() ? "" : ": ", detail.c_str());
+    if (!ok)
+        g_failures++;
+}
+
+static int selftest()
+{
+    int master, slave;
+    if (openpty(&master, &slave, nullptr, nullptr, nullptr) != 0)
+    {
+        perror("openpty");
+        return 1;
+    }
+    std::string error;
+    if (!setRaw(master, 0, error) || !setRaw(slave, 0, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    SimulatedNode node(slave);
+    node.start();
+
+    std::vector<TelemetrySample> received;
+    TelemetryClient::Options options;
+    options.timeoutMs = 50;
+    options.attempts = 4;
+    TelemetryClient client(master, [&](const TelemetrySample &s) { received.push_back(s); }, options);
+
+    check(client.ping({1, 2, 300000, UINT64_MAX}, error), "ping echoes its arguments", error);
+
+    uint32_t applied[2] = {};
+    const bool ratesOk = client.setRates(250, 5, applied, error);
+    check(ratesOk && applied[0] == 250 && applied[1] == 5, "set_rates applies both rates",
+          ratesOk ? std::to_string(applied[0]) + "/" + std::to_string(applied[1]) : error);
+
+    client.pump(300);
+    check(received.size() >= 20, "samples flow at the new rate", std::to_string(received.size()) + " in 300 ms");
+
+    // Every 2nd response is lost once: the client must resend, the node must
+    // answer from its cache instead of running the command again
+    node.dropEvery = 2;
+    const uint32_t runsBefore = node.setRatesRuns;
+    bool allOk = true;
+    for (int i = 0; i < 10; i++)
+        allOk &= client.setRates(0, 5, applied, error);
+    node.dropEvery = 0;
+    check(allOk, "requests survive lost responses", error);
+    check(node.setRatesRuns - runsBefore == 10, "resent requests run once",
+          std::to_string(node.setRatesRuns - runsBefore) + " runs, " + std::to_string(node.duplicates()) +
+              " answered from cache");
+    check(client.stats().resends >= 5, "client resent after timeouts",
+          std::to_string(client.stats().resends) + " resends");
+
+    std::vector<uint64_t> stats;
+    const bool statsOk = client.getStats(stats, error);
+    check(statsOk && stats[TELEMETRY_STAT_SAMPLE_PERIOD_MS] == 5 && stats[TELEMETRY_STAT_UART_INTERVAL_MS] == 250,
+          "get_stats reports the rates", error);
+
+    // Stop the stream so the history and the received samples line up
+    client.setRates(0, 3600000, applied, error);
+    client.pump(50);
+    std::vector<TelemetrySample> history;
+    const bool histOk = client.dumpHistory(received.empty() ? 0 : received.front().seq, history, error);
+    bool same = histOk && history.size() == received.size();
+    for (size_t i = 0; same && i < history.size(); i++)
+        same = history[i].seq == received[i].seq && history[i].tsUs == received[i].tsUs &&
+               history[i].tempDc == received[i].tempDc && history[i].humDpct == received[i].humDpct;
+    check(same, "dump_history matches the streamed samples",
+          histOk ? std::to_string(history.size()) + " vs " + std::to_string(received.size()) : error);
+
+    check(client.startProvisioning(error), "start_provisioning", error);
+    check(!client.startProvisioning(error) && error == "unavailable", "second provisioning is refused", error);
+
+    TelemetryResponse r;
+    check(!client.request(99, {}, r, error) && r.status == TELEMETRY_STATUS_UNKNOWN_CMD, "unknown command", error);
+
+    static const uint8_t garbage[] = {0x00, 0x13, 0x37, 0xFF, 0x02, 0x00, 'h', 'i', '\n', 0x00};
+    if (write(master, garbage, sizeof(garbage)) != (ssize_t)sizeof(garbage))
+        perror("write");
+    error.clear();
+    check(client.ping({7}, error), "link recovers after garbage", error);
+    check(node.badRequests() > 0, "node counted bad requests", std::to_string(node.badRequests()));
+
+    node.mute = true;
+    const Clock::time_point t0 = Clock::now();
+    const bool muteOk = client.ping({8}, error);
+    const long waited =
+        (long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+    node.mute = false;
+    check(!muteOk && client.stats().timeouts == 1, "mute node times out",
+          error + " after " + std::to_string(waited) + " ms");
+
+    const int kPings = 200;
+    const Clock::time_point p0 = Clock::now();
+    bool pingsOk = true;
+    for (int i = 0; i < kPings; i++)
+        pingsOk &= client.ping({(uint64_t)i}, error);
+    const double rttUs =
+        std::chrono::duration<double, std::micro>(Clock::now() - p0).count() / kPings;
+    check(pingsOk, "round trips over the pty", std::to_string((int)rttUs) + " us per request");
+
+    node.stop();
+    close(master);
+    close(slave);
+    printf("%s (%d failed)\n", g_failures ? "FAILED" : "PASSED", g_failures);
+    return g_failures ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    long baud = 921600;
+    int timeoutMs = 300;
+    std::vector<const char *> pos;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            baud = strtol(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            timeoutMs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else
+            pos.push_back(argv[i]);
+    }
+
+    if (pos.size() == 1 && !strcmp(pos[0], "selftest"))
+        return selftest();
+    if (pos.size() < 2 || timeoutMs <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const int fd = open(pos[0], O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(pos[0]);
+        return 1;
+    }
+    std::string error;
+    if (!setRaw(fd, baud, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    TelemetryClient::Options options;
+    options.timeoutMs = timeoutMs;
+    const bool listen = !strcmp(pos[1], "listen");
+    TelemetryClient client(
+        fd,
+        [listen](const TelemetrySample &s)
+        {
+            if (listen)
+                printf("%s\n", telemetrySampleToJson(s).c_str());
+        },
+        options);
+
+    const std::string cmd = pos[1];
+    bool ok = true;
+    if (cmd == "ping")
+    {
+        ok = client.ping({1}, error);
+        if (ok)
+            printf("pong\n");
+    }
+    else if (cmd == "stats")
+    {
+        std::vector<uint64_t> v;
+        ok = client.getStats(v, error);
+        if (ok)
+            printStats(v);
+    }
+    else if (cmd == "rates" && pos.size() == 4)
+    {
+        uint32_t applied[2];
+        ok = client.setRates((uint32_t)strtoul(pos[2], nullptr, 10), (uint32_t)strtoul(pos[3], nullptr, 10), applied,
+                             error);
+        if (ok)
+            printf("uart_interval_ms %u\nsample_period_ms %u\n", applied[0], applied[1]);
+    }
+    else if (cmd == "history")
+    {
+        std::vector<TelemetrySample> out;
+        ok = client.dumpHistory(pos.size() > 2 ? (uint32_t)strtoul(pos[2], nullptr, 10) : 0, out, error);
+        for (const TelemetrySample &s : out)
+            printf("%s\n", telemetrySampleToJson(s).c_str());
+    }
+    else if (cmd == "provision")
+    {
+        ok = client.startProvisioning(error);
+        if (ok)
+            printf("provisioning AP started\n");
+    }
+    else if (cmd == "listen")
+    {
+        while (true)
+        {
+            client.pump(1000);
+            fflush(stdout);
+        }
+    }
+    else
+    {
+        usage(argv[0]);
+        close(fd);
+        return 2;
+    }
+
+    if (!ok)
+        fprintf(stderr, "%s: %s\n", cmd.c_str(), error.c_str());
+    close(fd);
+    return ok ? 0 : 1;
+}
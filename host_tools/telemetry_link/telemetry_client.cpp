@@ -0,0 +1,245 @@
+#include "telemetry_client.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+static const char *kHostId = "host";
+
+TelemetryClient::TelemetryClient(int fd, TelemetryStreamDecoder::SampleHandler onSample)
+    : TelemetryClient(fd, std::move(onSample), Options())
+{
+}
+
+TelemetryClient::TelemetryClient(int fd, TelemetryStreamDecoder::SampleHandler onSample, Options options)
+    : _fd(fd), _options(options), _decoder(std::move(onSample))
+{
+    // Random start, so a restarted host does not reuse the msg id the node
+    // has cached a response for
+    _msgId = std::random_device()();
+    _decoder.setResponseHandler(
+        [this](const TelemetryResponse &r)
+        {
+            if (_waitingFor && r.msgId == _waitingFor)
+            {
+                _response = r;
+                _gotResponse = true;
+            }
+            else
+            {
+                _stats.staleResponses++;
+            }
+        });
+}
+
+uint32_t TelemetryClient::nextMsgId_()
+{
+    if (++_msgId == 0)
+        _msgId = 1;
+    return _msgId;
+}
+
+bool TelemetryClient::writeAll_(const std::vector<uint8_t> &data, std::string &error)
+{
+    size_t done = 0;
+    while (done < data.size())
+    {
+        const ssize_t n = write(_fd, data.data() + done, data.size() - done);
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            error = std::string("write: ") + strerror(errno);
+            return false;
+        }
+        done += (size_t)n;
+    }
+    return true;
+}
+
+void TelemetryClient::pump(int timeoutMs)
+{
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    uint8_t buf[4096];
+    while (!_gotResponse)
+    {
+        const int left =
+            (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (left <= 0)
+            return;
+        struct pollfd pfd = {_fd, POLLIN, 0};
+        const int r = poll(&pfd, 1, left);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return;
+        const ssize_t n = read(_fd, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            if (n < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            return;
+        }
+        _decoder.feed(buf, (size_t)n);
+    }
+}
+
+bool TelemetryClient::request(uint8_t cmd, const std::vector<uint64_t> &args, TelemetryResponse &out,
+                              std::string &error)
+{
+    const std::vector<uint8_t> frame =
+        telemetryEncodeRequest(kHostId, _frameSeq++, nextMsgId_(), cmd, args.data(), args.size());
+    if (frame.empty())
+    {
+        error = "too many arguments";
+        return false;
+    }
+
+    _stats.requests++;
+    _waitingFor = _msgId;
+    _gotResponse = false;
+    for (int attempt = 0; attempt < _options.attempts && !_gotResponse; attempt++)
+    {
+        if (attempt)
+            _stats.resends++;
+        if (!writeAll_(frame, error))
+        {
+            _waitingFor = 0;
+            return false;
+        }
+        pump(_options.timeoutMs);
+    }
+    _waitingFor = 0;
+
+    if (!_gotResponse)
+    {
+        _stats.timeouts++;
+        error = "no response after " + std::to_string(_options.attempts) + " attempts";
+        return false;
+    }
+    _gotResponse = false;
+    out = std::move(_response);
+    if (out.status != TELEMETRY_STATUS_OK)
+    {
+        error = telemetryStatusName(out.status);
+        return false;
+    }
+    return true;
+}
+
+// ===== Commands =====
+static bool resultValues(const TelemetryResponse &r, size_t expected, std::vector<uint64_t> &out,
+                         std::string &error)
+{
+    out.resize(TELEMETRY_CMD_MAX_ARGS * 2);
+    const int n = telemetry_cmd_get_values(r.data.data(), r.data.size(), out.data(), out.size());
+    if (n < 0 || (size_t)n < expected)
+    {
+        error = "malformed result";
+        return false;
+    }
+    out.resize((size_t)n);
+    return true;
+}
+
+bool TelemetryClient::ping(const std::vector<uint64_t> &values, std::string &error)
+{
+    TelemetryResponse r;
+    std::vector<uint64_t> echo;
+    if (!request(TELEMETRY_CMD_PING, values, r, error) || !resultValues(r, values.size(), echo, error))
+        return false;
+    if (echo != values)
+    {
+        error = "ping echo differs";
+        return false;
+    }
+    return true;
+}
+
+bool TelemetryClient::setRates(uint32_t uartIntervalMs, uint32_t samplePeriodMs, uint32_t applied[2],
+                               std::string &error)
+{
+    TelemetryResponse r;
+    std::vector<uint64_t> v;
+    if (!request(TELEMETRY_CMD_SET_RATES, {uartIntervalMs, samplePeriodMs}, r, error) ||
+        !resultValues(r, 2, v, error))
+        return false;
+    applied[0] = (uint32_t)v[0];
+    applied[1] = (uint32_t)v[1];
+    return true;
+}
+
+bool TelemetryClient::getStats(std::vector<uint64_t> &out, std::string &error)
+{
+    TelemetryResponse r;
+    if (!request(TELEMETRY_CMD_GET_STATS, {}, r, error))
+        return false;
+    // Newer firmware may append fields
+    return resultValues(r, TELEMETRY_STAT_COUNT, out, error);
+}
+
+bool TelemetryClient::dumpHistory(uint32_t fromSeq, std::vector<TelemetrySample> &out, std::string &error)
+{
+    while (true)
+    {
+        TelemetryResponse r;
+        if (!request(TELEMETRY_CMD_DUMP_HISTORY, {fromSeq, TELEMETRY_CMD_MAX_HISTORY}, r, error))
+            return false;
+
+        uint64_t next;
+        const size_t used = telemetry_frame_get_varint(r.data.data(), r.data.size(), &next);
+        telemetry_sample_t page[TELEMETRY_CMD_MAX_HISTORY];
+        const int n = used ? telemetry_frame_get_samples(r.data.data() + used, r.data.size() - used, page,
+                                                         TELEMETRY_CMD_MAX_HISTORY)
+                           : -1;
+        if (n < 0)
+        {
+            error = "malformed history page";
+            return false;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            TelemetrySample s;
+            s.deviceId = r.deviceId;
+            s.seq = page[i].seq;
+            s.tsUs = page[i].ts_us;
+            s.tempDc = page[i].temp_dc;
+            s.humDpct = page[i].hum_dpct;
+            out.push_back(s);
+        }
+        if (n < TELEMETRY_CMD_MAX_HISTORY)
+            return true;
+        fromSeq = (uint32_t)next;
+    }
+}
+
+bool TelemetryClient::startProvisioning(std::string &error)
+{
+    TelemetryResponse r;
+    return request(TELEMETRY_CMD_START_PROVISIONING, {}, r, error);
+}
+
+const char *telemetryStatusName(uint8_t status)
+{
+    switch (status)
+    {
+    case TELEMETRY_STATUS_OK:
+        return "ok";
+    case TELEMETRY_STATUS_UNKNOWN_CMD:
+        return "unknown command";
+    case TELEMETRY_STATUS_BAD_ARGS:
+        return "bad arguments";
+    case TELEMETRY_STATUS_UNAVAILABLE:
+        return "unavailable";
+    case TELEMETRY_STATUS_FAILED:
+        return "failed";
+    default:
+        return "unknown status";
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "telemetry_cmd.h"
+#include "telemetry_link.h"
+
+// Host end of the uart_bridge command channel over a file descriptor (serial
+// port or pty, already in raw mode). Samples that arrive while a request is
+// pending are passed to the sample handler as usual. Single threaded: all
+// reading happens inside request() and pump().
+class TelemetryClient
+{
+public:
+    struct Options
+    {
+        int timeoutMs = 300; // per attempt
+        int attempts = 4;    // first send + resends with the same msg id
+    };
+
+    struct Stats
+    {
+        uint64_t requests = 0;
+        uint64_t resends = 0;
+        uint64_t timeouts = 0;       // requests that got no response at all
+        uint64_t staleResponses = 0; // responses to an earlier msg id
+    };
+
+    TelemetryClient(int fd, TelemetryStreamDecoder::SampleHandler onSample = nullptr);
+    TelemetryClient(int fd, TelemetryStreamDecoder::SampleHandler onSample, Options options);
+
+    // Sends `cmd` and waits for its response. False with `error` set on a
+    // timeout, a write error or a non-OK status (the response is still
+    // stored in `out` for the latter).
+    bool request(uint8_t cmd, const std::vector<uint64_t> &args, TelemetryResponse &out, std::string &error);
+
+    // ===== Commands (telemetry_cmd.h) =====
+    bool ping(const std::vector<uint64_t> &values, std::string &error);
+    // 0 keeps a rate. `applied` gets {uart_interval_ms, sample_period_ms}.
+    bool setRates(uint32_t uartIntervalMs, uint32_t samplePeriodMs, uint32_t applied[2], std::string &error);
+    // Indexed by telemetry_cmd_stat_t
+    bool getStats(std::vector<uint64_t> &out, std::string &error);
+    // Pages through the node's history from `fromSeq`, appending to `out`
+    bool dumpHistory(uint32_t fromSeq, std::vector<TelemetrySample> &out, std::string &error);
+    bool startProvisioning(std::string &error);
+
+    // Reads and decodes whatever arrives within `timeoutMs`
+    void pump(int timeoutMs);
+
+    const Stats &stats() const { return _stats; }
+    const TelemetryStreamDecoder::Stats &linkStats() const { return _decoder.stats(); }
+
+private:
+    bool writeAll_(const std::vector<uint8_t> &data, std::string &error);
+    uint32_t nextMsgId_();
+
+    int _fd;
+    Options _options;
+    TelemetryStreamDecoder _decoder;
+    uint32_t _msgId;
+    uint32_t _frameSeq = 0;
+    uint32_t _waitingFor = 0;
+    bool _gotResponse = false;
+    TelemetryResponse _response;
+    Stats _stats;
+};
+
+const char *telemetryStatusName(uint8_t status);
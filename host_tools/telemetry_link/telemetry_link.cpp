@@ -0,0 +1,300 @@
+#include "telemetry_link.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+
+#include "telemetry_cmd.h"
+#include "telemetry_frame.h"
+#include "telemetry_link_c.h"
+
+TelemetryStreamDecoder::TelemetryStreamDecoder(SampleHandler onSample, TextHandler onText)
+    : _onSample(std::move(onSample)), _onText(std::move(onText))
+{
+    // Largest frame the firmware can send, without its delimiters
+    _maxChunk = TELEMETRY_FRAME_MAX_WIRE(TELEMETRY_FRAME_MAX_PAYLOAD(TELEMETRY_FRAME_MAX_SAMPLES));
+    _chunk.reserve(_maxChunk);
+    _decoded.resize(_maxChunk);
+}
+
+void TelemetryStreamDecoder::feed(const uint8_t *data, size_t len)
+{
+    _stats.bytes += len;
+    const uint8_t *end = data + len;
+    while (data < end)
+    {
+        // Frames are runs of non-zero bytes: copy each run in one go
+        const uint8_t *delim = (const uint8_t *)memchr(data, TELEMETRY_FRAME_DELIMITER, end - data);
+        const uint8_t *runEnd = delim ? delim : end;
+        while (data < runEnd)
+        {
+            const size_t room = _maxChunk + 1 - _chunk.size();
+            const size_t take = std::min(room, (size_t)(runEnd - data));
+            _chunk.insert(_chunk.end(), data, data + take);
+            data += take;
+            if (_chunk.size() > _maxChunk)
+            {
+                emitText_(_chunk);
+                _chunk.clear();
+            }
+        }
+        if (delim)
+        {
+            processChunk_();
+            data = delim + 1;
+        }
+    }
+}
+
+void TelemetryStreamDecoder::finish()
+{
+    processChunk_();
+}
+
+void TelemetryStreamDecoder::processChunk_()
+{
+    if (_chunk.empty())
+        return;
+
+    const size_t n = telemetry_frame_cobs_decode(_chunk.data(), _chunk.size(), _decoded.data());
+    telemetry_frame_view_t view;
+    telemetry_cmd_msg_t msg;
+    if (!n || !telemetry_frame_parse(_decoded.data(), n, &view))
+    {
+        emitText_(_chunk);
+        _chunk.clear();
+        return;
+    }
+
+    if (view.type == TELEMETRY_FRAME_SAMPLES)
+    {
+        handleSamples_(view);
+    }
+    else if (telemetry_cmd_parse_response(&view, &msg))
+    {
+        _stats.responses++;
+        if (_onResponse)
+        {
+            TelemetryResponse r;
+            r.deviceId = view.device_id;
+            r.msgId = msg.msg_id;
+            r.cmd = msg.cmd;
+            r.status = msg.status;
+            r.data.assign(msg.data, msg.data + msg.data_len);
+            _onResponse(r);
+        }
+    }
+    else
+    {
+        // Our own requests echoed back, or a newer frame type: skip it
+        _stats.badFrames++;
+    }
+    _chunk.clear();
+}
+
+void TelemetryStreamDecoder::handleSamples_(const telemetry_frame_view_t &view)
+{
+    telemetry_sample_t samples[TELEMETRY_FRAME_MAX_SAMPLES];
+    const int count = telemetry_frame_read_samples(&view, samples, TELEMETRY_FRAME_MAX_SAMPLES);
+    if (count <= 0)
+    {
+        _stats.badFrames++;
+        return;
+    }
+
+    TelemetrySample s;
+    s.deviceId = view.device_id;
+    s.frameSeq = view.frame_seq;
+
+    auto it = _sources.find(s.deviceId);
+    if (it != _sources.end())
+    {
+        // A seq that goes backwards is a node reboot, not a gap
+        const uint32_t frameDelta = view.frame_seq - it->second.lastFrame;
+        if (frameDelta > 1 && frameDelta < 0x80000000u)
+            _stats.frameGaps += frameDelta - 1;
+        const uint32_t sampleDelta = samples[0].seq - it->second.lastSample;
+        if (sampleDelta > 1 && sampleDelta < 0x80000000u)
+            _stats.sampleGaps += sampleDelta - 1;
+    }
+    else
+    {
+        it = _sources.emplace(s.deviceId, Source{}).first;
+    }
+    it->second.lastFrame = view.frame_seq;
+    it->second.lastSample = samples[count - 1].seq;
+
+    _stats.frames++;
+    _stats.samples += (uint64_t)count;
+    for (int i = 0; i < count; i++)
+    {
+        if (i && samples[i].seq - samples[i - 1].seq > 1)
+            _stats.sampleGaps += samples[i].seq - samples[i - 1].seq - 1;
+        s.seq = samples[i].seq;
+        s.tsUs = samples[i].ts_us;
+        s.tempDc = samples[i].temp_dc;
+        s.humDpct = samples[i].hum_dpct;
+        if (_onSample)
+            _onSample(s);
+    }
+}
+
+void TelemetryStreamDecoder::emitText_(const std::vector<uint8_t> &bytes)
+{
+    // A corrupted frame is mostly binary; log lines on a shared port are not
+    size_t printable = 0;
+    for (uint8_t b : bytes)
+        if (b == '\n' || b == '\r' || b == '\t' || (b >= 0x20 && b < 0x7F))
+            printable++;
+
+    if (printable * 10 < bytes.size() * 9)
+    {
+        _stats.badFrames++;
+        return;
+    }
+
+    _stats.textBytes += bytes.size();
+    if (_onText)
+        _onText(std::string(bytes.begin(), bytes.end()));
+}
+
+// ===== Output formatting =====
+static void appendDeci(std::string &out, int32_t v)
+{
+    const long long a = v < 0 ? -(long long)v : v;
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%s%lld.%lld", v < 0 ? "-" : "", a / 10, a % 10);
+    out += buf;
+}
+
+std::string telemetrySampleToJson(const TelemetrySample &s)
+{
+    std::string out = "{\"device_id\":\"";
+    out += s.deviceId;
+    out += "\",\"temp_c\":";
+    appendDeci(out, s.tempDc);
+    out += ",\"humidity\":";
+    appendDeci(out, s.humDpct);
+    out += ",\"seq\":" + std::to_string(s.seq);
+    out += ",\"ts_us\":" + std::to_string(s.tsUs);
+    out += "}";
+    return out;
+}
+
+std::vector<uint8_t> telemetryEncodeRequest(const char *hostId, uint32_t frameSeq, uint32_t msgId, uint8_t cmd,
+                                            const uint64_t *args, size_t nArgs)
+{
+    uint8_t payload[TELEMETRY_CMD_MAX_REQUEST_PAYLOAD];
+    uint8_t *body = payload + TELEMETRY_FRAME_BODY_OFFSET;
+    const size_t bodyLen = telemetry_cmd_put_request(msgId, cmd, args, nArgs, body,
+                                                     sizeof(payload) - TELEMETRY_FRAME_BODY_OFFSET);
+    if (!msgId || !bodyLen)
+        return {};
+    const size_t len =
+        telemetry_frame_build(TELEMETRY_FRAME_REQUEST, hostId, frameSeq, body, bodyLen, payload, sizeof(payload));
+    if (!len)
+        return {};
+    std::vector<uint8_t> wire(TELEMETRY_FRAME_MAX_WIRE(len));
+    wire.resize(telemetry_frame_cobs_encode(payload, len, wire.data()));
+    return wire;
+}
+
+// ===== C ABI =====
+struct tl_decoder
+{
+    std::deque<tl_sample_t> pending;
+    std::deque<tl_response_t> responses;
+    TelemetryStreamDecoder decoder;
+
+    tl_decoder()
+        : decoder([this](const TelemetrySample &s)
+                  {
+                      tl_sample_t out = {};
+                      strncpy(out.device_id, s.deviceId.c_str(), sizeof(out.device_id) - 1);
+                      out.frame_seq = s.frameSeq;
+                      out.seq = s.seq;
+                      out.ts_us = s.tsUs;
+                      out.temp_dc = s.tempDc;
+                      out.hum_dpct = s.humDpct;
+                      pending.push_back(out);
+                  })
+    {
+        decoder.setResponseHandler(
+            [this](const TelemetryResponse &r)
+            {
+                tl_response_t out = {};
+                out.msg_id = r.msgId;
+                out.cmd = r.cmd;
+                out.status = r.status;
+                out.n_values = telemetry_cmd_get_values(r.data.data(), r.data.size(), out.values, TL_MAX_VALUES);
+                responses.push_back(out);
+            });
+    }
+};
+
+extern "C"
+{
+    tl_decoder_t *tl_decoder_new(void)
+    {
+        return new tl_decoder();
+    }
+
+    void tl_decoder_free(tl_decoder_t *dec)
+    {
+        delete dec;
+    }
+
+    size_t tl_decoder_feed(tl_decoder_t *dec, const uint8_t *data, size_t len)
+    {
+        if (!dec)
+            return 0;
+        if (data && len)
+            dec->decoder.feed(data, len);
+        return dec->pending.size();
+    }
+
+    int tl_decoder_next(tl_decoder_t *dec, tl_sample_t *out)
+    {
+        if (!dec || !out || dec->pending.empty())
+            return 0;
+        *out = dec->pending.front();
+        dec->pending.pop_front();
+        return 1;
+    }
+
+    int tl_decoder_next_response(tl_decoder_t *dec, tl_response_t *out)
+    {
+        if (!dec || !out || dec->responses.empty())
+            return 0;
+        *out = dec->responses.front();
+        dec->responses.pop_front();
+        return 1;
+    }
+
+    void tl_decoder_stats(const tl_decoder_t *dec, tl_stats_t *out)
+    {
+        if (!dec || !out)
+            return;
+        const TelemetryStreamDecoder::Stats &st = dec->decoder.stats();
+        out->bytes = st.bytes;
+        out->frames = st.frames;
+        out->samples = st.samples;
+        out->bad_frames = st.badFrames;
+        out->text_bytes = st.textBytes;
+        out->frame_gaps = st.frameGaps;
+        out->sample_gaps = st.sampleGaps;
+        out->responses = st.responses;
+    }
+
+    size_t tl_encode_request(uint32_t msg_id, uint8_t cmd, const uint64_t *args, size_t n_args, uint8_t *out,
+                             size_t cap)
+    {
+        const std::vector<uint8_t> wire = telemetryEncodeRequest("host", 0, msg_id, cmd, args, n_args);
+        if (wire.empty() || wire.size() > cap || !out)
+            return 0;
+        memcpy(out, wire.data(), wire.size());
+        return wire.size();
+    }
+}
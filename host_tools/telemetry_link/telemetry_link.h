@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "telemetry_frame.h"
+
+// One reading decoded from the uart_bridge binary link
+struct TelemetrySample
+{
+    std::string deviceId;
+    uint32_t frameSeq = 0;
+    uint32_t seq = 0; // publish counter on the node
+    int64_t tsUs = 0; // node timestamp (esp_timer)
+    int32_t tempDc = 0;
+    int32_t humDpct = 0;
+};
+
+// Command response from the node (firmware telemetry_cmd.h)
+struct TelemetryResponse
+{
+    std::string deviceId;
+    uint32_t msgId = 0;
+    uint8_t cmd = 0;
+    uint8_t status = 0;        // telemetry_status_t
+    std::vector<uint8_t> data; // result, see telemetry_cmd.h per command
+};
+
+// Incremental decoder for the COBS-framed telemetry stream (firmware
+// telemetry_frame.h). Bytes can be fed in any split straight from the
+// serial port; bytes between frames that look like console text go to the
+// text handler, anything else counts as a bad frame.
+class TelemetryStreamDecoder
+{
+public:
+    using SampleHandler = std::function<void(const TelemetrySample &)>;
+    using TextHandler = std::function<void(const std::string &)>;
+    using ResponseHandler = std::function<void(const TelemetryResponse &)>;
+
+    struct Stats
+    {
+        uint64_t bytes = 0;
+        uint64_t frames = 0; // sample frames
+        uint64_t samples = 0;
+        uint64_t badFrames = 0; // COBS/CRC/format errors
+        uint64_t textBytes = 0;
+        uint64_t frameGaps = 0;  // frames missing between two received frame seqs
+        uint64_t sampleGaps = 0; // readings missing between two received sample seqs
+        uint64_t responses = 0;
+    };
+
+    explicit TelemetryStreamDecoder(SampleHandler onSample, TextHandler onText = nullptr);
+
+    void setResponseHandler(ResponseHandler onResponse) { _onResponse = std::move(onResponse); }
+
+    void feed(const uint8_t *data, size_t len);
+    // Flush whatever is buffered (end of file)
+    void finish();
+
+    const Stats &stats() const { return _stats; }
+
+private:
+    struct Source
+    {
+        uint32_t lastFrame;
+        uint32_t lastSample;
+    };
+
+    void processChunk_();
+    void handleSamples_(const telemetry_frame_view_t &view);
+    void emitText_(const std::vector<uint8_t> &bytes);
+
+    SampleHandler _onSample;
+    TextHandler _onText;
+    ResponseHandler _onResponse;
+    std::vector<uint8_t> _chunk;
+    std::vector<uint8_t> _decoded;
+    size_t _maxChunk;
+    std::unordered_map<std::string, Source> _sources; // gap tracking per device
+    Stats _stats;
+};
+
+// Complete request frame (COBS, both delimiters) for the node's command
+// server. Empty on invalid arguments (msgId 0, too many args).
+std::vector<uint8_t> telemetryEncodeRequest(const char *hostId, uint32_t frameSeq, uint32_t msgId, uint8_t cmd,
+                                            const uint64_t *args, size_t nArgs);
+
+// JSON line in the format of the firmware's console transport plus the
+// link fields: {"device_id","temp_c","humidity","seq","ts_us"}
+std::string telemetrySampleToJson(const TelemetrySample &s);
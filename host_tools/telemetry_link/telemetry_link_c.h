@@ -0,0 +1,69 @@
+#pragma once
+
+// C ABI of the telemetry_link library, for bindings (host_app loads it with
+// ctypes). Mirrors TelemetryStreamDecoder: feed raw serial bytes, then pop
+// decoded samples and command responses. Requests are encoded here too; the
+// binding owns msg ids, timeouts and resends (see TelemetryClient).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct tl_decoder tl_decoder_t;
+
+    typedef struct
+    {
+        char device_id[32];
+        uint32_t frame_seq;
+        uint32_t seq;
+        int64_t ts_us;
+        int32_t temp_dc;
+        int32_t hum_dpct;
+    } tl_sample_t;
+
+    typedef struct
+    {
+        uint64_t bytes;
+        uint64_t frames;
+        uint64_t samples;
+        uint64_t bad_frames;
+        uint64_t text_bytes;
+        uint64_t frame_gaps;
+        uint64_t sample_gaps;
+        uint64_t responses;
+    } tl_stats_t;
+
+#define TL_MAX_VALUES 16
+
+    typedef struct
+    {
+        uint32_t msg_id;
+        uint8_t cmd;
+        uint8_t status; // telemetry_status_t
+        // Result as a varint list; -1 when it is not one (DUMP_HISTORY)
+        int32_t n_values;
+        uint64_t values[TL_MAX_VALUES];
+    } tl_response_t;
+
+    tl_decoder_t *tl_decoder_new(void);
+    void tl_decoder_free(tl_decoder_t *dec);
+    // Returns the number of samples waiting to be popped
+    size_t tl_decoder_feed(tl_decoder_t *dec, const uint8_t *data, size_t len);
+    // Pops the oldest sample: 1 if one was returned, 0 if none is pending
+    int tl_decoder_next(tl_decoder_t *dec, tl_sample_t *out);
+    // Pops the oldest command response, same convention as tl_decoder_next
+    int tl_decoder_next_response(tl_decoder_t *dec, tl_response_t *out);
+    void tl_decoder_stats(const tl_decoder_t *dec, tl_stats_t *out);
+
+    // Encodes a complete request frame (COBS, delimiters) ready to write to
+    // the port. Returns its length, 0 on invalid arguments or small `cap`.
+    size_t tl_encode_request(uint32_t msg_id, uint8_t cmd, const uint64_t *args, size_t n_args, uint8_t *out,
+                             size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
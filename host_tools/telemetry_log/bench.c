@@ -0,0 +1,430 @@
+// tlog_bench: host benchmark and power-cut check of the gateway telemetry
+// log (firmware/esp_idf_shared_components/telemetry_log/src/tlog.c).
+//
+//   tlog_bench [-p PARTITION_KB] [-n SAMPLES] [-b BLOCK] [-F FLUSH_EVERY]
+//              [-k CUTS] [-o IMAGE]
+//
+// Runs the storage engine on the file-backed flash emulator (IMAGE, by
+// default a temporary file; tlog_extract reads it afterwards):
+//   - appends SAMPLES (5000000) 2 s readings, writing a block every
+//     FLUSH_EVERY (150) samples or when BLOCK (512) bytes fill up, enough to
+//     wrap a PARTITION_KB (2048) ring; reports host time and the flash time
+//     the same operations take on the device
+//   - range queries over the live log, checked sample by sample against
+//     the input, with the blocks read and skipped
+//   - remount (recovery) time, clean and after a torn block write
+//   - CUTS (300) power cuts at random points of a random workload on a
+//     small ring, checking after every remount that no flushed sample is
+//     missing or changed and that writing resumes
+// Exits non-zero on any mismatch.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "flash_file.h"
+#include "tlog.h"
+
+#define CHANNELS 2
+#define SECTOR 4096
+
+typedef struct
+{
+    uint32_t t;
+    int32_t v[CHANNELS];
+} sample_t;
+
+typedef struct
+{
+    sample_t *s;
+    size_t n, cap;
+} samples_t;
+
+static int s_failures = 0;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void push(samples_t *a, sample_t s)
+{
+    if (a->n == a->cap)
+    {
+        a->cap = a->cap ? 2 * a->cap : 4096;
+        a->s = realloc(a->s, a->cap * sizeof(sample_t));
+        if (!a->s)
+            exit(1);
+    }
+    a->s[a->n++] = s;
+}
+
+// Next reading after `prev`: 2 s cadence with missed reads, slow walk in
+// tenths kept around room values
+static sample_t next_sample(const sample_t *prev)
+{
+    sample_t s = *prev;
+    s.t += rand() % 200 ? 2 : 2 + 2 * (uint32_t)(rand() % 5);
+    if (rand() % 8 == 0)
+        s.v[0] += rand() % 3 - 1 + (s.v[0] < 180) - (s.v[0] > 300);
+    if (rand() % 5 == 0)
+        s.v[1] += 2 * (rand() % 3 - 1 + (s.v[1] < 400) - (s.v[1] > 700));
+    return s;
+}
+
+static bool collect(uint32_t t, const int32_t *v, void *ctx)
+{
+    samples_t *out = ctx;
+    sample_t s = {t, {v[0], v[1]}};
+    push(out, s);
+    return true;
+}
+
+// First index of `ref` with t >= t
+static size_t lower_bound(const samples_t *ref, uint32_t t)
+{
+    size_t lo = 0, hi = ref->n;
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (ref->s[mid].t < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*========== Append, query, remount ==========*/
+static void run_query(tlog_t *log, const samples_t *ref, const char *name, uint32_t t0, uint32_t t1,
+                      uint32_t used_bytes)
+{
+    samples_t got = {0};
+    tlog_query_stats_t qs;
+    const double a = now_s();
+    tlog_query(log, t0, t1, collect, &got, &qs);
+    const double us = (now_s() - a) * 1e6;
+
+    // Expected: the reference samples in the window that the ring still holds
+    uint32_t first, last;
+    tlog_range(log, &first, &last);
+    const size_t lo = lower_bound(ref, t0 > first ? t0 : first);
+    size_t hi = lower_bound(ref, t1);
+    while (hi < ref->n && ref->s[hi].t <= t1)
+        hi++;
+    const size_t want = hi > lo ? hi - lo : 0;
+    if (got.n != want || (want && memcmp(got.s, ref->s + lo, want * sizeof(sample_t)) != 0))
+    {
+        fprintf(stderr, "FAIL query %s: %zu samples, want %zu\n", name, got.n, want);
+        s_failures++;
+    }
+    printf("  %-12s %8zu samples  %4u blocks read %6u skipped  %8u B read (%4.1f%% of log)  %8.1f us\n", name,
+           got.n, qs.blocks_read, qs.blocks_skipped, qs.bytes_read, 100.0 * qs.bytes_read / used_bytes, us);
+    free(got.s);
+}
+
+static double mount_ms(flash_file_t *ff, tlog_t *log, void *mem, size_t block, double *device_ms)
+{
+    const tlog_flash_t dev = flash_file_dev(ff);
+    const flash_file_counters_t before = ff->count;
+    const double a = now_s();
+    if (tlog_mount(log, &dev, CHANNELS, block, mem) != TLOG_OK)
+    {
+        fprintf(stderr, "FAIL mount\n");
+        s_failures++;
+    }
+    const double ms = (now_s() - a) * 1e3;
+    flash_file_counters_t d = ff->count;
+    d.reads -= before.reads;
+    d.writes -= before.writes;
+    d.erases -= before.erases;
+    d.bytes_read -= before.bytes_read;
+    d.bytes_written -= before.bytes_written;
+    *device_ms = flash_file_device_ms(&d);
+    return ms;
+}
+
+static void bench(const char *path, uint32_t part_kb, size_t n, size_t block, size_t flush_every)
+{
+    flash_file_t ff;
+    if (!flash_file_open(&ff, path, part_kb * 1024, SECTOR, false))
+    {
+        s_failures++;
+        return;
+    }
+    memset(ff.mem, 0xFF, ff.size); // start from an erased partition
+    const tlog_flash_t dev = flash_file_dev(&ff);
+    void *mem = malloc(tlog_mem_size(&dev, block));
+    tlog_t log;
+    if (!mem || tlog_mount(&log, &dev, CHANNELS, block, mem) != TLOG_OK)
+    {
+        fprintf(stderr, "FAIL mount of an erased partition\n");
+        s_failures++;
+        return;
+    }
+
+    samples_t ref = {0};
+    sample_t s = {1700000000u, {231, 455}};
+    for (size_t i = 0; i < n; i++)
+    {
+        s = next_sample(&s);
+        push(&ref, s);
+    }
+
+    const double a = now_s();
+    for (size_t i = 0; i < n; i++)
+    {
+        if (tlog_append(&log, ref.s[i].t, ref.s[i].v) != TLOG_OK)
+        {
+            fprintf(stderr, "FAIL append %zu\n", i);
+            s_failures++;
+            return;
+        }
+        if (i % flush_every == flush_every - 1)
+            tlog_flush(&log);
+    }
+    const double append_s = now_s() - a;
+
+    uint32_t first, last, used_bytes = 0, sectors = 0;
+    tlog_range(&log, &first, &last);
+    for (uint32_t k = 0; k < log.sectors; k++)
+        if (log.index[k].seq)
+        {
+            used_bytes += TLOG_SECTOR_HEADER + log.index[k].used;
+            sectors++;
+        }
+    const size_t held = ref.n - lower_bound(&ref, first);
+    const double dev_ms = flash_file_device_ms(&ff.count);
+    printf("tlog_bench: %u KB ring (%u sectors), blocks <= %zu B, flush every %zu samples\n", part_kb, log.sectors,
+           block, flush_every);
+    printf("append: %zu samples in %.1f ms host (%.0f ns/sample); %u blocks, %u erases, %.2f flash B/sample\n", n,
+           append_s * 1e3, append_s * 1e9 / n, log.stats.blocks_written, log.stats.sectors_erased,
+           (double)log.stats.bytes_written / n);
+    printf("        device flash time %.1f s = %.1f us/sample (%.4f%% of a 2 s period)\n", dev_ms / 1e3,
+           dev_ms * 1e3 / n, dev_ms / n / 2000.0 * 100.0);
+    printf("held:   %zu samples = %.1f days at 2 s in %u sectors, %u lost to wrap-around\n", held,
+           (last - first) / 86400.0, sectors, log.stats.samples_lost);
+
+    printf("queries (checked against the input):\n");
+    run_query(&log, &ref, "last 10 min", last - 600, last, used_bytes);
+    run_query(&log, &ref, "last 1 h", last - 3600, last, used_bytes);
+    run_query(&log, &ref, "a day ago", last - 86400 - 3600, last - 86400, used_bytes);
+    run_query(&log, &ref, "last 24 h", last - 86400, last, used_bytes);
+    run_query(&log, &ref, "everything", 0, UINT32_MAX, used_bytes);
+
+    // Recovery: clean remount (staged samples are lost, as on a reset)
+    tlog_flush(&log);
+    double dev_mount;
+    double ms = mount_ms(&ff, &log, mem, block, &dev_mount);
+    printf("remount: %.2f ms host, %.1f ms device (headers + open sector scan), %u blocks rescanned\n", ms,
+           dev_mount, log.stats.recovered_blocks);
+
+    // Torn block write, then remount
+    for (int i = 0; i < 100; i++)
+    {
+        s = next_sample(&s);
+        tlog_append(&log, s.t, s.v);
+    }
+    flash_file_arm_cut(&ff, 40);
+    if (tlog_flush(&log) == TLOG_OK)
+    {
+        fprintf(stderr, "FAIL the armed cut did not hit the block write\n");
+        s_failures++;
+    }
+    flash_file_power_on(&ff);
+    ms = mount_ms(&ff, &log, mem, block, &dev_mount);
+    printf("remount after torn write: %.2f ms host, %.1f ms device, %u torn sector closed\n", ms, dev_mount,
+           log.stats.torn_sectors);
+    if (log.stats.torn_sectors != 1 || !tlog_last_time(&log, &last) || last != ref.s[ref.n - 1].t)
+    {
+        fprintf(stderr, "FAIL recovery after the torn write\n");
+        s_failures++;
+    }
+
+    free(ref.s);
+    free(mem);
+    flash_file_close(&ff);
+}
+
+/*========== Power cuts ==========*/
+// Every sample on flash after a remount must be the input sample of that
+// time, in order; from the second-oldest sector on (the oldest may be half
+// erased) none may be missing, and nothing confirmed written may be lost
+static bool check_recovered(tlog_t *log, samples_t *ref, size_t durable, int round)
+{
+    samples_t got = {0};
+    tlog_query(log, 0, UINT32_MAX, collect, &got, NULL);
+
+    uint32_t keep_from = 0; // t_first of the second-oldest sector
+    for (uint32_t k = 1, seen = 0; k <= log->sectors && log->head != TLOG_NO_SECTOR; k++)
+    {
+        const tlog_sector_t *e = &log->index[(log->head + k) % log->sectors];
+        if (e->seq && e->samples && ++seen == 2)
+        {
+            keep_from = e->t_first;
+            break;
+        }
+    }
+
+    bool ok = true;
+    size_t j = got.n ? lower_bound(ref, got.s[0].t) : 0;
+    for (size_t i = 0; i < got.n && ok; i++, j++)
+    {
+        while (j < ref->n && ref->s[j].t < got.s[i].t && ref->s[j].t < keep_from)
+            j++;
+        if (j >= ref->n || memcmp(&got.s[i], &ref->s[j], sizeof(sample_t)) != 0)
+        {
+            fprintf(stderr, "FAIL cut %d: sample %zu at t=%u differs or is out of place\n", round, i, got.s[i].t);
+            ok = false;
+        }
+    }
+    if (ok && j < durable)
+    {
+        fprintf(stderr, "FAIL cut %d: %zu of %zu confirmed samples recovered\n", round, j, durable);
+        ok = false;
+    }
+    // Unconfirmed samples are gone for good: continue the input after the last one kept
+    if (ok)
+        ref->n = j;
+    free(got.s);
+    return ok;
+}
+
+static void power_cuts(const char *path, int cuts)
+{
+    const uint32_t sectors = 8;
+    const size_t block = 256;
+    flash_file_t ff;
+    if (!flash_file_open(&ff, path, sectors * SECTOR, SECTOR, false))
+    {
+        s_failures++;
+        return;
+    }
+    memset(ff.mem, 0xFF, ff.size);
+    const tlog_flash_t dev = flash_file_dev(&ff);
+    void *mem = malloc(tlog_mem_size(&dev, block));
+    samples_t ref = {0};
+    sample_t s = {1000, {200, 500}};
+    uint32_t torn = 0, recovered = 0;
+    double mount_total = 0;
+
+    for (int round = 0; round < cuts && !s_failures; round++)
+    {
+        tlog_t log;
+        const double a = now_s();
+        if (tlog_mount(&log, &dev, CHANNELS, block, mem) != TLOG_OK)
+        {
+            fprintf(stderr, "FAIL cut %d: mount\n", round);
+            s_failures++;
+            break;
+        }
+        mount_total += now_s() - a;
+        if (round && !check_recovered(&log, &ref, ref.n, round))
+        {
+            s_failures++;
+            break;
+        }
+        if (ref.n)
+            s = ref.s[ref.n - 1];
+
+        // Random workload until the power goes
+        flash_file_arm_cut(&ff, rand() % 30000);
+        size_t durable = ref.n;
+        for (int i = 0; i < 20000; i++)
+        {
+            tlog_status_t st;
+            if (rand() % 97 == 0)
+            {
+                st = tlog_flush(&log);
+            }
+            else
+            {
+                const sample_t next = next_sample(&s);
+                st = tlog_append(&log, next.t, next.v);
+                if (st == TLOG_OK)
+                {
+                    s = next;
+                    push(&ref, s);
+                }
+            }
+            if (st != TLOG_OK)
+                break;
+            durable = ref.n - log.enc.count;
+        }
+        flash_file_power_on(&ff);
+
+        // What reached flash must be there; the staged tail may not
+        if (tlog_mount(&log, &dev, CHANNELS, block, mem) != TLOG_OK || !check_recovered(&log, &ref, durable, round))
+        {
+            s_failures++;
+            break;
+        }
+        torn += log.stats.torn_sectors;
+        recovered += log.stats.recovered_blocks;
+    }
+    printf("power cuts: %d rounds on a %u-sector ring, %u torn sectors closed, %u blocks rescanned, "
+           "%.1f us avg clean mount\n",
+           cuts, sectors, torn, recovered, mount_total * 1e6 / (cuts ? cuts : 1));
+
+    free(ref.s);
+    free(mem);
+    flash_file_close(&ff);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t part_kb = 2048;
+    size_t n = 5000000, block = 512, flush_every = 150;
+    int cuts = 300;
+    const char *image = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            part_kb = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            n = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            block = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-F") && i + 1 < argc)
+            flush_every = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+            cuts = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            image = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [-p PARTITION_KB] [-n SAMPLES] [-b BLOCK] [-F FLUSH_EVERY] [-k CUTS] [-o IMAGE]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (part_kb < 8 || part_kb % 4 || n < 1000 || flush_every == 0 || block < TLOG_MIN_BLOCK ||
+        block > SECTOR - TLOG_SECTOR_HEADER)
+        return 2;
+    srand(1);
+
+    char tmp[] = "/tmp/tlog_bench_XXXXXX";
+    const int fd = mkstemp(tmp);
+    if (fd < 0)
+        return 1;
+    close(fd);
+
+    bench(image ? image : tmp, part_kb, n, block, flush_every);
+    if (!s_failures)
+        power_cuts(tmp, cuts);
+    unlink(tmp);
+
+    if (s_failures)
+    {
+        fprintf(stderr, "%d failure(s)\n", s_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,108 @@
+// tlog_extract: dumps a gateway telemetry log partition as CSV
+// (firmware/esp_idf_shared_components/telemetry_log/src/tlog.c).
+//
+//   tlog_extract IMAGE [-s SECTOR_SIZE] [-d DEVICE_ID] [--from T] [--to T]
+//
+// IMAGE is the raw partition, e.g. from
+//   parttool.py --port PORT read_partition --partition-name tlog --output tlog.bin
+// The log is mounted read-only (a torn write is skipped, not repaired)
+// and every sample in [T_from, T_to] is printed in host_app's CSV format:
+// ts, device_id, temp_c, humidity. Timestamps the gateway took from a set
+// wall clock come out as ISO-8601 UTC, ones from its log clock (no time
+// source yet) as plain seconds. Recovery notes go to stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "flash_file.h"
+#include "tlog.h"
+
+#define CHANNELS 2            // temperature, humidity in tenths
+#define BLOCK_CAP 512         // only bounds staging; any stored block reads
+#define WALL_CLOCK_MIN 1000000000u // 2001-09-09: earlier values are log clock
+
+static const char *s_device = "esp32_1";
+
+static bool print_sample(uint32_t t, const int32_t *v, void *ctx)
+{
+    (void)ctx;
+    char ts[32];
+    if (t >= WALL_CLOCK_MIN)
+    {
+        const time_t tt = (time_t)t;
+        struct tm tm;
+        gmtime_r(&tt, &tm);
+        strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    }
+    else
+    {
+        snprintf(ts, sizeof(ts), "%u", t);
+    }
+    printf("%s,%s,%.1f,%.1f\n", ts, s_device, v[0] / 10.0, v[1] / 10.0);
+    return true;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s IMAGE [-s SECTOR_SIZE] [-d DEVICE_ID] [--from T] [--to T]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    uint32_t sector = 4096, from = 0, to = UINT32_MAX;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            sector = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            s_device = argv[++i];
+        else if (!strcmp(argv[i], "--from") && i + 1 < argc)
+            from = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--to") && i + 1 < argc)
+            to = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (argv[i][0] != '-' && !path)
+            path = argv[i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!path || sector < 256)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    flash_file_t ff;
+    if (!flash_file_open(&ff, path, 0, sector, true))
+        return 1;
+    const tlog_flash_t dev = flash_file_dev(&ff);
+    void *mem = malloc(tlog_mem_size(&dev, BLOCK_CAP));
+    tlog_t log;
+    const tlog_status_t st = mem ? tlog_mount(&log, &dev, CHANNELS, BLOCK_CAP, mem) : TLOG_ERR_ARG;
+    if (st != TLOG_OK)
+    {
+        fprintf(stderr, "%s: cannot mount: %s\n", path, tlog_status_name(st));
+        flash_file_close(&ff);
+        free(mem);
+        return 1;
+    }
+
+    uint32_t used = 0;
+    for (uint32_t s = 0; s < log.sectors; s++)
+        used += log.index[s].seq != 0;
+    fprintf(stderr, "%s: %u of %u sectors in use, %u blocks recovered from open sectors, %u torn\n", path, used,
+            log.sectors, log.stats.recovered_blocks, log.stats.torn_sectors);
+
+    printf("ts,device_id,temp_c,humidity\n");
+    const size_t n = tlog_query(&log, from, to, print_sample, NULL, NULL);
+    fprintf(stderr, "%zu samples\n", n);
+
+    flash_file_close(&ff);
+    free(mem);
+    return 0;
+}
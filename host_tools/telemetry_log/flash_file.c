@@ -0,0 +1,165 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "flash_file.h"
+
+// Typical 4 MB SPI NOR (ESP32-S3 module): 4 KB erase ~45 ms, page program
+// ~0.7 ms per 256 B, reads through esp_partition_read ~20 MB/s
+#define ERASE_MS 45.0
+#define PROGRAM_MS_PER_BYTE (0.7 / 256.0)
+#define READ_MS_PER_BYTE (1.0 / 20000.0)
+#define OP_OVERHEAD_MS 0.01
+
+static bool in_range(const flash_file_t *ff, uint32_t off, size_t len)
+{
+    return off <= ff->size && len <= ff->size - off;
+}
+
+// Bytes of the operation that still happen; turns the power off if the
+// budget runs out
+static size_t spend(flash_file_t *ff, size_t len)
+{
+    if (ff->cut_budget < 0)
+        return len;
+    if ((int64_t)len <= ff->cut_budget)
+    {
+        ff->cut_budget -= (int64_t)len;
+        return len;
+    }
+    const size_t done = (size_t)ff->cut_budget;
+    ff->cut_budget = 0;
+    ff->dead = true;
+    return done;
+}
+
+static int dev_read(void *ctx, uint32_t off, void *buf, size_t len)
+{
+    flash_file_t *ff = ctx;
+    if (ff->dead || !in_range(ff, off, len))
+        return -1;
+    memcpy(buf, ff->mem + off, len);
+    ff->count.reads++;
+    ff->count.bytes_read += len;
+    return 0;
+}
+
+static int dev_write(void *ctx, uint32_t off, const void *buf, size_t len)
+{
+    flash_file_t *ff = ctx;
+    if (ff->dead || ff->read_only || !in_range(ff, off, len))
+        return -1;
+    const uint8_t *src = buf;
+    const size_t n = spend(ff, len);
+    for (size_t i = 0; i < n; i++)
+        ff->mem[off + i] &= src[i];
+    if (n < len)
+    {
+        // The byte being programmed at the cut gets some of its bits
+        ff->mem[off + n] &= (uint8_t)(src[n] | (rand() & 0xFF));
+        return -1;
+    }
+    ff->count.writes++;
+    ff->count.bytes_written += len;
+    return 0;
+}
+
+static int dev_erase(void *ctx, uint32_t off)
+{
+    flash_file_t *ff = ctx;
+    if (ff->dead || ff->read_only || off % ff->sector_size || !in_range(ff, off, ff->sector_size))
+        return -1;
+    const size_t n = spend(ff, ff->sector_size);
+    if (n < ff->sector_size)
+    {
+        // An interrupted erase leaves anything from old data to 0xFF
+        for (size_t i = 0; i < ff->sector_size; i++)
+            if (rand() % ff->sector_size < n)
+                ff->mem[off + i] = 0xFF;
+        return -1;
+    }
+    memset(ff->mem + off, 0xFF, ff->sector_size);
+    ff->count.erases++;
+    return 0;
+}
+
+bool flash_file_open(flash_file_t *ff, const char *path, uint32_t size, uint32_t sector_size, bool read_only)
+{
+    memset(ff, 0, sizeof(*ff));
+    ff->cut_budget = -1;
+    ff->read_only = read_only;
+    ff->sector_size = sector_size;
+    ff->fd = open(path, read_only ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+    if (ff->fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    fstat(ff->fd, &st);
+    const bool fresh = st.st_size == 0;
+    if (size == 0)
+        size = (uint32_t)st.st_size;
+    if (size == 0 || (!read_only && ftruncate(ff->fd, size) != 0) || (read_only && (off_t)size > st.st_size))
+    {
+        fprintf(stderr, "%s: bad size\n", path);
+        close(ff->fd);
+        return false;
+    }
+    ff->size = size;
+    ff->mem = mmap(NULL, size, read_only ? PROT_READ : PROT_READ | PROT_WRITE, read_only ? MAP_PRIVATE : MAP_SHARED,
+                   ff->fd, 0);
+    if (ff->mem == MAP_FAILED)
+    {
+        perror("mmap");
+        close(ff->fd);
+        return false;
+    }
+    if (fresh && !read_only)
+        memset(ff->mem, 0xFF, size);
+    return true;
+}
+
+void flash_file_close(flash_file_t *ff)
+{
+    if (ff->mem && ff->mem != MAP_FAILED)
+        munmap(ff->mem, ff->size);
+    if (ff->fd >= 0)
+        close(ff->fd);
+    ff->mem = NULL;
+    ff->fd = -1;
+}
+
+tlog_flash_t flash_file_dev(flash_file_t *ff)
+{
+    return (tlog_flash_t){
+        .size = ff->size - ff->size % ff->sector_size,
+        .sector_size = ff->sector_size,
+        .read = dev_read,
+        .write = dev_write,
+        .erase = dev_erase,
+        .ctx = ff,
+    };
+}
+
+void flash_file_arm_cut(flash_file_t *ff, int64_t bytes)
+{
+    ff->cut_budget = bytes;
+}
+
+void flash_file_power_on(flash_file_t *ff)
+{
+    ff->dead = false;
+    ff->cut_budget = -1;
+}
+
+double flash_file_device_ms(const flash_file_counters_t *c)
+{
+    return c->erases * ERASE_MS + (double)c->bytes_written * PROGRAM_MS_PER_BYTE +
+           (double)c->bytes_read * READ_MS_PER_BYTE + (c->reads + c->writes) * OP_OVERHEAD_MS;
+}
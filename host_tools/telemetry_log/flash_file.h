@@ -0,0 +1,45 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tlog.h"
+
+// NOR flash emulated in a file (e.g. a partition image): writes can only
+// clear bits, erase sets a sector to 0xFF, and a power cut can be armed to
+// stop programming part way through an operation. Counts operations so a
+// run can be turned into flash time on the device.
+
+typedef struct
+{
+    uint32_t reads, writes, erases;
+    uint64_t bytes_read, bytes_written;
+} flash_file_counters_t;
+
+typedef struct
+{
+    int fd;
+    uint8_t *mem; // the mapped file
+    uint32_t size;
+    uint32_t sector_size;
+    bool read_only;
+    int64_t cut_budget; // bytes still programmed/erased before the cut, -1: none
+    bool dead;          // power is off: every operation fails
+    flash_file_counters_t count;
+} flash_file_t;
+
+// Opens (creating and erasing it, unless `read_only`) a file of `size`
+// bytes. An existing file keeps its content; `size` 0 takes its size.
+bool flash_file_open(flash_file_t *ff, const char *path, uint32_t size, uint32_t sector_size, bool read_only);
+void flash_file_close(flash_file_t *ff);
+
+// tlog_flash_t over `ff`
+tlog_flash_t flash_file_dev(flash_file_t *ff);
+
+// After `bytes` more bytes programmed or erased, power goes off in the
+// middle of the operation; flash_file_power_on() restores it.
+void flash_file_arm_cut(flash_file_t *ff, int64_t bytes);
+void flash_file_power_on(flash_file_t *ff);
+
+// Device time of the counted operations, from typical SPI NOR figures
+double flash_file_device_ms(const flash_file_counters_t *c);
@@ -0,0 +1,295 @@
+// ts_codec_bench: compression and throughput of the ts_codec block format
+// (firmware/esp_idf_shared_components/ts_codec/src/ts_codec.c).
+//
+//   ts_codec_bench [-f telemetry.csv] [-n SAMPLES] [-r REPS]
+//
+// Reads the CSV host_app records (ts, device_id, temp_c, humidity; one
+// series per device, timestamps in seconds, values in tenths) or, without
+// -f, SAMPLES (1000000) synthetic readings at the sensor_hub cadence with
+// failed reads and a daily swing. Encodes them with 2 channels into blocks
+// of several sizes and reports bytes per sample next to the CSV and JSON
+// line forms, then encode/decode throughput over REPS (5) passes. Every
+// decoded sample is compared with the input. Exits non-zero on a mismatch.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ts_codec.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample
+{
+    uint32_t t;
+    int32_t v[2]; // temp_c, humidity in tenths
+};
+
+struct Series
+{
+    std::string deviceId;
+    std::vector<Sample> samples;
+};
+
+static const size_t kBlockSizes[] = {128, 512, 2048, 8192};
+
+static double secondsSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-f telemetry.csv] [-n SAMPLES] [-r REPS]\n", argv0);
+}
+
+static size_t jsonLineSize(const std::string &deviceId, const Sample &s)
+{
+    char line[160];
+    return (size_t)snprintf(line, sizeof(line),
+                            "{\"ts\":\"2025-01-01T00:00:00Z\",\"device_id\":\"%s\",\"temp_c\":%.1f,\"humidity\":%.1f}\n",
+                            deviceId.c_str(), s.v[0] / 10.0, s.v[1] / 10.0);
+}
+
+static size_t csvLineSize(const std::string &deviceId, const Sample &s)
+{
+    char line[128];
+    return (size_t)snprintf(line, sizeof(line), "2025-01-01T00:00:00Z,%s,%.1f,%.1f\r\n", deviceId.c_str(),
+                            s.v[0] / 10.0, s.v[1] / 10.0);
+}
+
+// ----- Input -----
+static bool parseIsoUtc(const char *s, uint32_t *out)
+{
+    struct tm tm = {};
+    if (sscanf(s, "%4d-%2d-%2dT%2d:%2d:%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min,
+               &tm.tm_sec) != 6)
+        return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    const time_t t = timegm(&tm);
+    if (t < 0 || (uint64_t)t > UINT32_MAX)
+        return false;
+    *out = (uint32_t)t;
+    return true;
+}
+
+// Rows that do not parse (header, blank values) and rows older than the
+// previous one of the same device are skipped and counted
+static bool readCsv(const char *path, std::vector<Series> &out, size_t *fileBytes, size_t *skipped)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+    std::map<std::string, size_t> index;
+    char line[512];
+    *fileBytes = 0;
+    *skipped = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        *fileBytes += strlen(line);
+        char ts[64], dev[128];
+        double temp, hum;
+        uint32_t t;
+        if (sscanf(line, "%63[^,],%127[^,],%lf,%lf", ts, dev, &temp, &hum) != 4 || !parseIsoUtc(ts, &t))
+        {
+            (*skipped)++;
+            continue;
+        }
+        auto it = index.find(dev);
+        if (it == index.end())
+        {
+            it = index.emplace(dev, out.size()).first;
+            out.push_back({dev, {}});
+        }
+        std::vector<Sample> &s = out[it->second].samples;
+        if (!s.empty() && t < s.back().t)
+        {
+            (*skipped)++;
+            continue;
+        }
+        s.push_back({t, {(int32_t)lround(temp * 10), (int32_t)lround(hum * 10)}});
+    }
+    fclose(f);
+    return true;
+}
+
+static Series makeSeries(size_t n)
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> noise(-1, 1);
+    std::uniform_int_distribution<int> fail(0, 499);
+
+    Series out{"esp32_1", {}};
+    out.samples.reserve(n);
+    uint32_t t = 1735689600; // 2025-01-01
+    double drift = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        t += fail(rng) ? 2 : 4; // a failed read skips one period
+        drift += noise(rng) * 0.05;
+        const double day = 2.0 * M_PI * (t % 86400) / 86400.0;
+        const int32_t temp = (int32_t)lround(245 + 25 * sin(day) + drift) + (fail(rng) < 50 ? noise(rng) : 0);
+        const int32_t hum = (int32_t)lround(580 - 60 * sin(day) - 2 * drift) + (fail(rng) < 100 ? noise(rng) : 0);
+        out.samples.push_back({t, {temp, hum}});
+    }
+    return out;
+}
+
+// ----- Codec -----
+static size_t encodeSeries(const std::vector<Sample> &s, size_t blockSize, std::vector<uint8_t> &out)
+{
+    out.resize(s.size() * 24 + blockSize); // a worst-case sample is 28 bytes, well above real data
+    ts_codec_encoder_t enc;
+    size_t used = 0;
+    ts_codec_encoder_init(&enc, out.data(), blockSize, 2);
+    for (const Sample &x : s)
+    {
+        if (ts_codec_append(&enc, x.t, x.v) == TS_CODEC_OK)
+            continue;
+        used += ts_codec_finish(&enc);
+        if (out.size() - used < blockSize)
+            out.resize(out.size() * 2);
+        ts_codec_encoder_init(&enc, out.data() + used, blockSize, 2);
+        ts_codec_append(&enc, x.t, x.v);
+    }
+    if (enc.count)
+        used += ts_codec_finish(&enc);
+    out.resize(used);
+    return used;
+}
+
+// Decodes every block; returns the number of samples, `mismatches` counts
+// samples differing from `want`
+static size_t decodeSeries(const std::vector<uint8_t> &buf, const std::vector<Sample> *want, size_t *mismatches)
+{
+    size_t n = 0;
+    for (size_t off = 0; off < buf.size();)
+    {
+        ts_codec_decoder_t dec;
+        if (ts_codec_decoder_init(&dec, buf.data() + off, buf.size() - off) != TS_CODEC_OK)
+        {
+            (*mismatches)++;
+            return n;
+        }
+        Sample s;
+        while (ts_codec_next(&dec, &s.t, s.v) == TS_CODEC_OK)
+        {
+            if (want && (n >= want->size() || s.t != (*want)[n].t || s.v[0] != (*want)[n].v[0] ||
+                         s.v[1] != (*want)[n].v[1]))
+                (*mismatches)++;
+            n++;
+        }
+        off += TS_CODEC_HEADER_SIZE + dec.payload_bits / 8;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = nullptr;
+    size_t count = 1000000;
+    int reps = 5;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-f") && i + 1 < argc)
+            path = argv[++i];
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            count = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            reps = atoi(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (count == 0 || reps <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<Series> series;
+    size_t csvBytes = 0, skipped = 0, total = 0, jsonBytes = 0;
+    if (path)
+    {
+        if (!readCsv(path, series, &csvBytes, &skipped))
+            return 1;
+    }
+    else
+    {
+        series.push_back(makeSeries(count));
+        for (const Sample &s : series[0].samples)
+            csvBytes += csvLineSize(series[0].deviceId, s);
+    }
+    for (const Series &s : series)
+    {
+        total += s.samples.size();
+        for (const Sample &x : s.samples)
+            jsonBytes += jsonLineSize(s.deviceId, x);
+    }
+    if (total == 0)
+    {
+        fprintf(stderr, "no samples in %s\n", path);
+        return 1;
+    }
+
+    printf("input            %s: %zu samples, %zu series, %zu rows skipped\n", path ? path : "synthetic", total,
+           series.size(), skipped);
+    printf("bytes/sample     csv %.2f  json %.2f  raw struct %.2f\n", (double)csvBytes / total,
+           (double)jsonBytes / total, (double)sizeof(uint32_t) + 2 * sizeof(int32_t));
+
+    size_t mismatches = 0;
+    std::vector<uint8_t> buf;
+    for (size_t blockSize : kBlockSizes)
+    {
+        size_t bytes = 0, blocks = 0;
+        double encodeS = 0, decodeS = 0;
+        for (const Series &s : series)
+        {
+            size_t len = 0;
+            const Clock::time_point t0 = Clock::now();
+            for (int r = 0; r < reps; r++)
+                len = encodeSeries(s.samples, blockSize, buf);
+            encodeS += secondsSince(t0);
+            bytes += len;
+
+            // Check once, then time the plain decode
+            if (decodeSeries(buf, &s.samples, &mismatches) != s.samples.size())
+                mismatches++;
+            const Clock::time_point t1 = Clock::now();
+            for (int r = 0; r < reps; r++)
+                decodeSeries(buf, nullptr, &mismatches);
+            decodeS += secondsSince(t1);
+
+            for (size_t off = 0; off < buf.size(); blocks++)
+            {
+                ts_codec_block_info_t info;
+                if (ts_codec_block_info(buf.data() + off, buf.size() - off, &info) != TS_CODEC_OK)
+                    break;
+                off += info.size;
+            }
+        }
+        const double perSample = (double)bytes / total;
+        const double samples = (double)total * reps;
+        printf("block %5zu B     %6.3f B/sample (%5.1fx csv, %5.1fx json)  %zu blocks  "
+               "encode %6.1f Msamples/s  decode %6.1f Msamples/s (%.0f MB/s in)\n",
+               blockSize, perSample, (double)csvBytes / bytes, (double)jsonBytes / bytes, blocks,
+               samples / encodeS / 1e6, samples / decodeS / 1e6, (double)bytes * reps / decodeS / 1e6);
+    }
+
+    printf("round trip       %s (%zu mismatches)\n", mismatches ? "FAILED" : "OK", mismatches);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,427 @@
+// ts_codec_check: host round-trip checks of the time-series block codec
+// (firmware/esp_idf_shared_components/ts_codec/src/ts_codec.c).
+//
+//   ts_codec_check [-n STREAMS] [-s SEED]
+//
+// Fixed cases first: empty and single-sample blocks, int32 and uint32
+// extremes, the steady-cadence size bound, out-of-order timestamps, the
+// FULL rollback leaving the block byte-identical, finishing mid-stream,
+// every single-bit corruption and truncation. Then STREAMS random streams
+// (1..4 channels, steady/jittered/huge gaps, small walks and full-range
+// values) split into blocks of random capacity, decoded back, and searched
+// by time through the block headers alone. Exits non-zero on the first
+// mismatch.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ts_codec.h"
+
+#define MAX_SAMPLES 4096
+#define STREAM_BYTES (MAX_SAMPLES * 40)
+
+typedef struct
+{
+    uint32_t t;
+    int32_t v[TS_CODEC_MAX_CHANNELS];
+} sample_t;
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        if (!(cond))                                                                                              \
+        {                                                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                                                  \
+            fprintf(stderr, __VA_ARGS__);                                                                         \
+            fputc('\n', stderr);                                                                                  \
+            s_failures++;                                                                                         \
+            return;                                                                                               \
+        }                                                                                                         \
+    } while (0)
+
+static uint32_t rnd32(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/*========== Stream helpers ==========*/
+// Encodes `n` samples into consecutive blocks of at most `cap` bytes;
+// returns the stream size, 0 if a sample does not fit an empty block
+static size_t encode_stream(const sample_t *s, size_t n, int channels, size_t cap, uint8_t *out, size_t *blocks)
+{
+    ts_codec_encoder_t enc;
+    size_t used = 0;
+    *blocks = 0;
+    if (ts_codec_encoder_init(&enc, out, cap, channels) != TS_CODEC_OK)
+        return 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        ts_codec_status_t st = ts_codec_append(&enc, s[i].t, s[i].v);
+        if (st == TS_CODEC_FULL)
+        {
+            if (enc.count == 0)
+                return 0;
+            used += ts_codec_finish(&enc);
+            (*blocks)++;
+            ts_codec_encoder_init(&enc, out + used, cap, channels);
+            st = ts_codec_append(&enc, s[i].t, s[i].v);
+        }
+        if (st != TS_CODEC_OK)
+            return 0;
+    }
+    if (enc.count)
+    {
+        used += ts_codec_finish(&enc);
+        (*blocks)++;
+    }
+    return used;
+}
+
+// Decodes a whole stream and compares it with `s`; returns a description
+// of the first difference, or NULL
+static const char *decode_compare(const uint8_t *buf, size_t len, const sample_t *s, size_t n, int channels)
+{
+    static char why[128];
+    size_t i = 0;
+    for (size_t off = 0; off < len;)
+    {
+        ts_codec_decoder_t dec;
+        ts_codec_block_info_t info;
+        if (ts_codec_block_info(buf + off, len - off, &info) != TS_CODEC_OK ||
+            ts_codec_decoder_init(&dec, buf + off, len - off) != TS_CODEC_OK)
+            return "bad block";
+        if (info.channels != channels)
+            return "channel count";
+        if (info.count == 0 || i + info.count > n || info.t_first != s[i].t || info.t_last != s[i + info.count - 1].t)
+            return "header count or time range";
+        uint32_t t;
+        int32_t v[TS_CODEC_MAX_CHANNELS];
+        ts_codec_status_t st;
+        while ((st = ts_codec_next(&dec, &t, v)) == TS_CODEC_OK)
+        {
+            if (i >= n || t != s[i].t || memcmp(v, s[i].v, (size_t)channels * sizeof(int32_t)) != 0)
+            {
+                snprintf(why, sizeof(why), "sample %zu: t %u want %u, v0 %d want %d", i, t, i < n ? s[i].t : 0,
+                         v[0], i < n ? s[i].v[0] : 0);
+                return why;
+            }
+            i++;
+        }
+        if (st != TS_CODEC_END)
+            return ts_codec_status_name(st);
+        off += info.size;
+    }
+    return i == n ? NULL : "sample count";
+}
+
+/*========== Fixed cases ==========*/
+static void check_args(void)
+{
+    s_cases++;
+    uint8_t buf[64];
+    ts_codec_encoder_t enc;
+    CHECK(ts_codec_encoder_init(&enc, buf, sizeof(buf), 0) == TS_CODEC_ERR_ARG, "0 channels");
+    CHECK(ts_codec_encoder_init(&enc, buf, sizeof(buf), TS_CODEC_MAX_CHANNELS + 1) == TS_CODEC_ERR_ARG,
+          "too many channels");
+    CHECK(ts_codec_encoder_init(&enc, buf, TS_CODEC_HEADER_SIZE - 1, 1) == TS_CODEC_ERR_ARG, "cap below header");
+
+    // A header-only buffer takes no sample
+    CHECK(ts_codec_encoder_init(&enc, buf, TS_CODEC_HEADER_SIZE, 1) == TS_CODEC_OK, "header-only init");
+    const int32_t v = 1;
+    CHECK(ts_codec_append(&enc, 5, &v) == TS_CODEC_FULL, "header-only append");
+
+    ts_codec_block_info_t info;
+    memset(buf, 0, sizeof(buf));
+    CHECK(ts_codec_block_info(buf, sizeof(buf), &info) == TS_CODEC_ERR_FORMAT, "zeroes taken as a block");
+}
+
+static void check_empty_and_single(void)
+{
+    s_cases++;
+    uint8_t buf[64];
+    ts_codec_encoder_t enc;
+    ts_codec_decoder_t dec;
+    uint32_t t;
+    int32_t v[TS_CODEC_MAX_CHANNELS];
+
+    ts_codec_encoder_init(&enc, buf, sizeof(buf), 2);
+    size_t len = ts_codec_finish(&enc);
+    CHECK(len == TS_CODEC_HEADER_SIZE, "empty block is %zu B", len);
+    CHECK(ts_codec_decoder_init(&dec, buf, len) == TS_CODEC_OK, "empty block rejected");
+    CHECK(ts_codec_next(&dec, &t, v) == TS_CODEC_END, "empty block has a sample");
+
+    const sample_t extremes[] = {
+        {0, {INT32_MIN, INT32_MAX, 0, -1}},
+        {UINT32_MAX, {INT32_MAX, INT32_MIN, -1, 0}},
+    };
+    for (size_t k = 0; k < 2; k++)
+    {
+        ts_codec_encoder_init(&enc, buf, sizeof(buf), TS_CODEC_MAX_CHANNELS);
+        CHECK(ts_codec_append(&enc, extremes[k].t, extremes[k].v) == TS_CODEC_OK, "append extreme %zu", k);
+        len = ts_codec_finish(&enc);
+        const char *why = decode_compare(buf, len, &extremes[k], 1, TS_CODEC_MAX_CHANNELS);
+        CHECK(!why, "single extreme %zu: %s", k, why);
+    }
+
+    // Largest jumps both ways: 0 -> UINT32_MAX -> UINT32_MAX, full-range values
+    static const sample_t jumps[] = {
+        {0, {INT32_MIN}},
+        {UINT32_MAX, {INT32_MAX}},
+        {UINT32_MAX, {INT32_MIN}},
+    };
+    ts_codec_encoder_init(&enc, buf, sizeof(buf), 1);
+    for (size_t k = 0; k < 3; k++)
+        CHECK(ts_codec_append(&enc, jumps[k].t, jumps[k].v) == TS_CODEC_OK, "append jump %zu", k);
+    len = ts_codec_finish(&enc);
+    const char *why = decode_compare(buf, len, jumps, 3, 1);
+    CHECK(!why, "jumps: %s", why);
+}
+
+static void check_steady_size(void)
+{
+    s_cases++;
+    // 2 s cadence, unchanged values: 1 bit per timestamp and per channel
+    // after the first sample (values in full) and the second (whose delta
+    // is the first delta-of-delta)
+    static uint8_t buf[4096];
+    ts_codec_encoder_t enc;
+    const int32_t v[2] = {253, 601};
+    const size_t n = 1000;
+    ts_codec_encoder_init(&enc, buf, sizeof(buf), 2);
+    for (size_t i = 0; i < n; i++)
+        CHECK(ts_codec_append(&enc, 1000 + 2 * (uint32_t)i, v) == TS_CODEC_OK, "append %zu", i);
+    const size_t len = ts_codec_finish(&enc);
+    const size_t bound = TS_CODEC_HEADER_SIZE + (2 * 45 + 9 + 2 + 3 * (n - 2) + 7) / 8;
+    CHECK(len <= bound, "steady block %zu B, bound %zu B", len, bound);
+}
+
+static void check_order(void)
+{
+    s_cases++;
+    uint8_t buf[64];
+    ts_codec_encoder_t enc;
+    const int32_t v = 7;
+    ts_codec_encoder_init(&enc, buf, sizeof(buf), 1);
+    CHECK(ts_codec_append(&enc, 100, &v) == TS_CODEC_OK, "first");
+    CHECK(ts_codec_append(&enc, 100, &v) == TS_CODEC_OK, "equal timestamps rejected");
+    CHECK(ts_codec_append(&enc, 99, &v) == TS_CODEC_ERR_ORDER, "older timestamp accepted");
+    CHECK(enc.count == 2, "count after rejected sample: %u", enc.count);
+}
+
+static void check_full_rollback(void)
+{
+    s_cases++;
+    // Fill small blocks with noisy samples until FULL; the block must be
+    // exactly what finishing right before the failed append gave
+    for (size_t cap = TS_CODEC_HEADER_SIZE + 1; cap < 96; cap++)
+    {
+        uint8_t buf[96], before[96];
+        ts_codec_encoder_t enc;
+        ts_codec_encoder_init(&enc, buf, cap, 3);
+        uint32_t t = 50;
+        for (int i = 0;; i++)
+        {
+            const int32_t v[3] = {(int32_t)rnd32(), rand() % 9 - 4, 0};
+            ts_codec_finish(&enc);
+            memcpy(before, buf, cap);
+            const ts_codec_encoder_t saved = enc;
+            t += 1 + (uint32_t)rand() % 5000;
+            const ts_codec_status_t st = ts_codec_append(&enc, t, v);
+            if (st == TS_CODEC_OK)
+                continue;
+            CHECK(st == TS_CODEC_FULL, "cap %zu: %s", cap, ts_codec_status_name(st));
+            CHECK(memcmp(&saved, &enc, sizeof(enc)) == 0, "cap %zu: encoder state changed by FULL", cap);
+            ts_codec_finish(&enc);
+            CHECK(memcmp(before, buf, cap) == 0, "cap %zu: block changed by FULL after %d samples", cap, i);
+            break;
+        }
+    }
+}
+
+static void check_finish_midstream(void)
+{
+    s_cases++;
+    // finish() after every append must give a valid block of all samples so far
+    static sample_t s[200];
+    uint8_t buf[2048];
+    ts_codec_encoder_t enc;
+    ts_codec_encoder_init(&enc, buf, sizeof(buf), 2);
+    for (size_t i = 0; i < 200; i++)
+    {
+        s[i] = (sample_t){3000 + 2 * (uint32_t)i + (uint32_t)(rand() % 2), {250 + rand() % 3, 600 - rand() % 5}};
+        CHECK(ts_codec_append(&enc, s[i].t, s[i].v) == TS_CODEC_OK, "append %zu", i);
+        const size_t len = ts_codec_finish(&enc);
+        CHECK(len == ts_codec_size(&enc), "size %zu vs finish %zu", ts_codec_size(&enc), len);
+        const char *why = decode_compare(buf, len, s, i + 1, 2);
+        CHECK(!why, "after %zu samples: %s", i + 1, why);
+    }
+}
+
+static void check_corruption(void)
+{
+    s_cases++;
+    sample_t s[40];
+    uint8_t buf[512];
+    ts_codec_encoder_t enc;
+    ts_codec_encoder_init(&enc, buf, sizeof(buf), 2);
+    for (size_t i = 0; i < 40; i++)
+    {
+        s[i] = (sample_t){(uint32_t)i * 2, {240 + (int32_t)(i % 7), 550 - (int32_t)(i % 3)}};
+        ts_codec_append(&enc, s[i].t, s[i].v);
+    }
+    const size_t len = ts_codec_finish(&enc);
+
+    ts_codec_decoder_t dec;
+    for (size_t bit = 0; bit < len * 8; bit++)
+    {
+        buf[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+        const ts_codec_status_t st = ts_codec_decoder_init(&dec, buf, len);
+        buf[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+        CHECK(st == TS_CODEC_ERR_FORMAT, "flipped bit %zu accepted", bit);
+    }
+    for (size_t cut = 0; cut < len; cut++)
+        CHECK(ts_codec_decoder_init(&dec, buf, cut) == TS_CODEC_ERR_FORMAT, "truncated to %zu accepted", cut);
+    const char *why = decode_compare(buf, len, s, 40, 2);
+    CHECK(!why, "restored block: %s", why);
+}
+
+/*========== Random streams ==========*/
+static void make_stream(sample_t *s, size_t n, int channels)
+{
+    const int cadence = rand() % 4;
+    const int values = rand() % 3;
+    uint32_t t = rnd32() >> (rand() % 32);
+    int32_t v[TS_CODEC_MAX_CHANNELS];
+    for (int c = 0; c < channels; c++)
+        v[c] = (int32_t)rnd32() >> (rand() % 32);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t step;
+        switch (cadence)
+        {
+        case 0: // steady with rare gaps (failed reads)
+            step = rand() % 50 ? 2 : 2 * (1 + (uint32_t)rand() % 10);
+            break;
+        case 1: // ms timestamps with scheduling jitter
+            step = 2000 + (uint32_t)(rand() % 41) - 20;
+            break;
+        case 2: // bursts and long silences
+            step = rand() % 4 ? (uint32_t)rand() % 3 : (uint32_t)rand() % 100000;
+            break;
+        default: // anything that still fits
+            step = rnd32() >> (rand() % 32);
+            break;
+        }
+        t = UINT32_MAX - t < step ? UINT32_MAX : t + step;
+        s[i].t = t;
+        for (int c = 0; c < channels; c++)
+        {
+            if (values == 0) // sensor walk in tenths
+                v[c] += rand() % 5 ? rand() % 3 - 1 : rand() % 41 - 20;
+            else if (values == 1) // mostly unchanged
+                v[c] += rand() % 10 ? 0 : 1;
+            else // full range
+                v[c] = (int32_t)rnd32();
+            s[i].v[c] = v[c];
+        }
+    }
+}
+
+// Every time the first sample at or after `t` is found by skipping whole
+// blocks through their headers and decoding only the block that holds it
+static void check_seek(const uint8_t *buf, size_t len, const sample_t *s, size_t n)
+{
+    for (int q = 0; q < 20; q++)
+    {
+        const size_t want = (size_t)rand() % n;
+        const uint32_t t = s[want].t;
+        size_t first = want; // equal timestamps: the first of them
+        while (first > 0 && s[first - 1].t == t)
+            first--;
+
+        size_t off = 0, index = 0;
+        ts_codec_block_info_t info;
+        while (off < len && ts_codec_block_info(buf + off, len - off, &info) == TS_CODEC_OK && info.t_last < t)
+        {
+            off += info.size;
+            index += info.count;
+        }
+        CHECK(off < len, "seek to %u ran off the end", t);
+
+        ts_codec_decoder_t dec;
+        CHECK(ts_codec_decoder_init(&dec, buf + off, len - off) == TS_CODEC_OK, "seek block rejected");
+        uint32_t got;
+        int32_t v[TS_CODEC_MAX_CHANNELS];
+        while (ts_codec_next(&dec, &got, v) == TS_CODEC_OK && got < t)
+            index++;
+        CHECK(got == t && index == first, "seek to %u found sample %zu at %u, want %zu", t, index, got, first);
+    }
+}
+
+static void check_random(int streams)
+{
+    static sample_t s[MAX_SAMPLES];
+    static uint8_t buf[STREAM_BYTES];
+    for (int k = 0; k < streams; k++)
+    {
+        s_cases++;
+        const int channels = 1 + rand() % TS_CODEC_MAX_CHANNELS;
+        const size_t n = 1 + (size_t)rand() % MAX_SAMPLES;
+        // Room for at least one worst-case sample: 37 + channels * 45 bits
+        const size_t cap = TS_CODEC_HEADER_SIZE + 30 + (size_t)rand() % (rand() % 4 ? 512 : 8192);
+        make_stream(s, n, channels);
+
+        size_t blocks;
+        const size_t len = encode_stream(s, n, channels, cap, buf, &blocks);
+        CHECK(len > 0, "stream %d: encode failed", k);
+        const char *why = decode_compare(buf, len, s, n, channels);
+        CHECK(!why, "stream %d (%zu samples, %d ch, cap %zu, %zu blocks): %s", k, n, channels, cap, blocks, why);
+        check_seek(buf, len, s, n);
+        if (s_failures)
+            return;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int streams = 2000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            streams = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n STREAMS] [-s SEED]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(seed);
+
+    check_args();
+    check_empty_and_single();
+    check_steady_size();
+    check_order();
+    check_full_rollback();
+    check_finish_midstream();
+    check_corruption();
+    if (!s_failures)
+        check_random(streams);
+
+    if (s_failures)
+    {
+        fprintf(stderr, "%d of %d cases failed\n", s_failures, s_cases);
+        return 1;
+    }
+    printf("ts_codec_check: %d cases passed\n", s_cases);
+    return 0;
+}
@@ -0,0 +1,1053 @@
+// wifi_conn_fsm_check: host checks of the wifi_connect state machine
+// (firmware/esp_idf_shared_components/wifi_connect/src/wifi_conn_fsm.c).
+//
+//   wifi_conn_fsm_check [-n ROUNDS] [-s SEED]
+//
+// The state machine runs against a simulated driver standing in for the
+// Wi-Fi and IP events: access points with a BSSID, channel, signal and
+// DHCP server, and joins that take about as long as on an ESP32 (120 ms
+// per channel probed, 80 ms to associate, 400 ms of DHCP) and a backoff
+// timer fed back as WIFI_CONN_EV_TIMER. Fixed scenarios first: a cold boot
+// scans and saves the strongest access point, a warm boot joins it
+// directly (with and without the cached lease), a stale cache falls back
+// to the scan and back to DHCP, lost links reconnect at once and are
+// timed, an access point that is gone or a wrong password fails after the
+// retries, a second start changes nothing, a stop silences late events, a
+// renewal with a new address is saved. Then the backoff: an hour without
+// the access point keeps joining with capped, doubling waits and gets the
+// IP back when it returns, jitter spreads stations with other seeds,
+// rejected joins and failed rounds fall back to the provisioning AP by
+// policy, and the disconnect reasons are classified. Then the faults: joins
+// the driver refuses fail at once, joins it never answers and leases that
+// never come are left at their deadline, and the disconnect answering the
+// leave is not counted again. The simulated boot-to-IP times and the joins
+// and airtime of the outage (against retrying at once) are printed. Then
+// ROUNDS (20000) random worlds with access points coming and going, moving
+// channel, links dropping, stale timers, stop/start cycles, refused and
+// silent joins and dead DHCP servers, checking at every step that one join
+// is under way at a time, never when stopped, failed or backing off, that
+// waits and deadlines stay within bounds, that no phase is left waiting for
+// an event that never comes, that static leases only go with the cached
+// join, that the saved cache is the one in use and that the counters and
+// the airtime of failed joins add up. Exits non-zero on failure.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wifi_conn_fsm.h"
+
+#define PROBE_US 120000 // active scan of one channel
+#define CHANNELS 13
+#define ASSOC_US 80000 // authentication, association, 4-way handshake
+#define DHCP_US 400000
+#define BOOT_US 300000 // app start, as esp_timer sees it
+
+#define REASON_ASSOC_LEAVE 8
+#define REASON_HANDSHAKE_TIMEOUT 15
+#define REASON_BEACON_TIMEOUT 200
+#define REASON_NO_AP_FOUND 201
+
+#define SEC 1000000LL
+#define MAX_WAITS 512
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        if (!(cond))                                                                                              \
+        {                                                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                                                  \
+            fprintf(stderr, __VA_ARGS__);                                                                         \
+            fputc('\n', stderr);                                                                                  \
+            s_failures++;                                                                                         \
+            return;                                                                                               \
+        }                                                                                                         \
+    } while (0)
+
+/*========== Simulated driver ==========*/
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+    bool up;
+    uint32_t ip; // what its DHCP server hands out
+} sim_ap_t;
+
+typedef struct
+{
+    wifi_conn_ev_t ev;
+    int ap; // CONNECTED: the access point joined; DISCONNECTED: LEAVE_ANSWER
+} sim_event_t;
+
+#define LEAVE_ANSWER -2 // the disconnect of a LEAVE, not of a join
+
+typedef struct
+{
+    wifi_conn_fsm_t fsm;
+    sim_ap_t aps[4];
+    int n_aps;
+    bool wrong_password;
+    int refuse;     // joins the driver still refuses (busy scanning)
+    bool silent;    // joins never answered
+    bool dhcp_dead; // no lease ever comes
+    int64_t now_us;
+    // Driver and netif
+    bool static_ip; // DHCP client stopped, cached lease set
+    bool joining;   // a join is under way
+    int on;         // access point associated to, -1: none
+    sim_event_t queue[8];
+    int queued;
+    // What the glue did
+    wifi_conn_cache_t nvs;
+    int saves, ip_signals, fail_signals, fallbacks, links_lost, joins_cached, joins_scan, leaves, refusals;
+    int start_joins; // joins of a start; with links_lost, the joins that are no retry
+    int64_t join_at;        // start of the last join
+    int64_t airtime_us;     // in joins that failed
+    int64_t backoff_until;  // no join before
+    int64_t waits[MAX_WAITS]; // every backoff, in order
+    int n_waits;
+    const char *error; // first broken rule
+} sim_t;
+
+static uint32_t ip4(int a, int b, int c, int d)
+{
+    // Network order, as esp_netif keeps it on a little-endian chip
+    return (uint32_t)a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24;
+}
+
+static bool cache_same(const wifi_conn_cache_t *a, const wifi_conn_cache_t *b)
+{
+    return memcmp(a->bssid, b->bssid, 6) == 0 && a->channel == b->channel && a->ip == b->ip &&
+           a->netmask == b->netmask && a->gw == b->gw && a->dns == b->dns;
+}
+
+// No backoff, one round and FAILED: the joins alone
+static wifi_conn_fsm_config_t plain(int fast_tries, bool reuse_lease, int max_retry)
+{
+    return (wifi_conn_fsm_config_t){
+        .max_retry = max_retry, .fast_tries = fast_tries, .reuse_lease = reuse_lease, .fallback_rounds = 1};
+}
+
+// The Kconfig defaults, except where a scenario says otherwise
+static wifi_conn_fsm_config_t backoff(int fallback_rounds, int auth_fallback, uint32_t seed)
+{
+    return (wifi_conn_fsm_config_t){
+        .max_retry = 3,
+        .fast_tries = 1,
+        .backoff_min_us = 1 * SEC,
+        .backoff_max_us = 300 * SEC,
+        .fallback_rounds = fallback_rounds,
+        .auth_fallback = auth_fallback,
+        .join_timeout_us = 15 * SEC,
+        .dhcp_timeout_us = 30 * SEC,
+        .seed = seed,
+    };
+}
+
+static void sim_init(sim_t *s, const wifi_conn_fsm_config_t *cfg, const wifi_conn_cache_t *cache)
+{
+    memset(s, 0, sizeof(*s));
+    wifi_conn_fsm_init(&s->fsm, cfg, cache, false);
+    if (cache)
+        s->nvs = *cache;
+    s->on = -1;
+    s->now_us = BOOT_US;
+}
+
+static int add_ap(sim_t *s, uint8_t id, uint8_t channel, int8_t rssi, uint32_t ip)
+{
+    sim_ap_t *ap = &s->aps[s->n_aps];
+    const uint8_t bssid[6] = {0x24, 0x0a, 0xc4, 0x10, 0x20, id};
+    memcpy(ap->bssid, bssid, 6);
+    ap->channel = channel;
+    ap->rssi = rssi;
+    ap->up = true;
+    ap->ip = ip;
+    return s->n_aps++;
+}
+
+static void push_ev(sim_t *s, const wifi_conn_ev_t *ev, int ap)
+{
+    if (s->queued == (int)(sizeof(s->queue) / sizeof(s->queue[0])))
+    {
+        s->error = "driver queue full";
+        return;
+    }
+    int i = s->queued++;
+    while (i > 0 && s->queue[i - 1].ev.now_us > ev->now_us)
+    {
+        s->queue[i] = s->queue[i - 1];
+        i--;
+    }
+    s->queue[i] = (sim_event_t){.ev = *ev, .ap = ap};
+}
+
+static void push(sim_t *s, wifi_conn_ev_type_t type, int64_t at, int ap, uint16_t reason)
+{
+    wifi_conn_ev_t ev = {.type = type, .now_us = at, .reason = reason};
+    if (type == WIFI_CONN_EV_CONNECTED)
+    {
+        memcpy(ev.bssid, s->aps[ap].bssid, 6);
+        ev.channel = s->aps[ap].channel;
+    }
+    push_ev(s, &ev, ap);
+}
+
+static void rule(sim_t *s, bool ok, const char *what)
+{
+    if (!ok && !s->error)
+        s->error = what;
+}
+
+// The join just started fails before it reaches the air
+static bool refused(sim_t *s)
+{
+    if (s->refuse <= 0)
+        return false;
+    s->refuse--;
+    push(s, WIFI_CONN_EV_JOIN_REFUSED, s->now_us, -1, 0);
+    return true;
+}
+
+// Carries out the answer of the state machine as the glue and driver would
+static void apply(sim_t *s, uint32_t act)
+{
+    const bool cached = act & WIFI_CONN_ACT_JOIN_CACHED, scan = act & WIFI_CONN_ACT_JOIN_SCAN;
+    if (act & WIFI_CONN_ACT_LEAVE)
+    {
+        // esp_wifi_disconnect(): what the join had in flight is dropped, a
+        // disconnect answers it
+        rule(s, s->joining || s->on >= 0, "leave without a join");
+        rule(s, s->fsm.stats.timeouts == (uint32_t)s->leaves + 1, "leave without a timeout");
+        s->leaves++;
+        s->airtime_us += s->now_us - s->join_at;
+        int j = 0;
+        for (int i = 0; i < s->queued; i++)
+            if (s->queue[i].ev.type == WIFI_CONN_EV_TIMER)
+                s->queue[j++] = s->queue[i];
+        s->queued = j;
+        s->joining = false;
+        s->on = -1;
+        push(s, WIFI_CONN_EV_DISCONNECTED, s->now_us, LEAVE_ANSWER, REASON_ASSOC_LEAVE);
+    }
+    rule(s, !(cached && scan), "two joins at once");
+    rule(s, !((cached || scan) && s->joining), "join while one is under way");
+    rule(s, !(act & WIFI_CONN_ACT_STATIC_IP) || (cached && s->fsm.cfg.reuse_lease && s->fsm.cache.ip),
+         "static lease without the cached join");
+    if (act & WIFI_CONN_ACT_STATIC_IP)
+        s->static_ip = true;
+    if (act & WIFI_CONN_ACT_DHCP)
+        s->static_ip = false;
+    rule(s, !(scan && s->static_ip), "scan join on a static lease");
+    rule(s, !((cached || scan) && (s->fsm.phase == WIFI_CONN_FSM_IDLE || s->fsm.phase == WIFI_CONN_FSM_FAILED ||
+                                   s->fsm.phase == WIFI_CONN_FSM_BACKOFF)),
+         "join when stopped, failed or backing off");
+    rule(s, !((cached || scan) && s->now_us < s->backoff_until), "join before the backoff ended");
+    rule(s, !(act & WIFI_CONN_ACT_LINK_LOST) || cached || scan, "lost link without an immediate join");
+    if (act & WIFI_CONN_ACT_LINK_LOST)
+        s->links_lost++;
+    if (cached || scan)
+        s->join_at = s->now_us;
+
+    if (cached)
+    {
+        s->joins_cached++;
+        s->joining = true;
+        int hit = -1;
+        for (int i = 0; i < s->n_aps; i++)
+            if (s->aps[i].up && s->aps[i].channel == s->fsm.cache.channel &&
+                memcmp(s->aps[i].bssid, s->fsm.cache.bssid, 6) == 0)
+                hit = i;
+        if (refused(s) || s->silent)
+            ;
+        else if (hit < 0)
+            push(s, WIFI_CONN_EV_DISCONNECTED, s->now_us + PROBE_US, -1, REASON_NO_AP_FOUND);
+        else if (s->wrong_password)
+            push(s, WIFI_CONN_EV_DISCONNECTED, s->now_us + PROBE_US + ASSOC_US, -1, REASON_HANDSHAKE_TIMEOUT);
+        else
+            push(s, WIFI_CONN_EV_CONNECTED, s->now_us + PROBE_US + ASSOC_US, hit, 0);
+    }
+    if (scan)
+    {
+        s->joins_scan++;
+        s->joining = true;
+        int best = -1;
+        for (int i = 0; i < s->n_aps; i++)
+            if (s->aps[i].up && (best < 0 || s->aps[i].rssi > s->aps[best].rssi))
+                best = i;
+        const int64_t at = s->now_us + CHANNELS * PROBE_US;
+        if (refused(s) || s->silent)
+            ;
+        else if (best < 0)
+            push(s, WIFI_CONN_EV_DISCONNECTED, at, -1, REASON_NO_AP_FOUND);
+        else if (s->wrong_password)
+            push(s, WIFI_CONN_EV_DISCONNECTED, at + ASSOC_US, -1, REASON_HANDSHAKE_TIMEOUT);
+        else
+            push(s, WIFI_CONN_EV_CONNECTED, at + ASSOC_US, best, 0);
+    }
+    if (act & WIFI_CONN_ACT_SAVE_CACHE)
+    {
+        s->nvs = s->fsm.cache;
+        s->saves++;
+    }
+    rule(s, cache_same(&s->nvs, &s->fsm.cache), "cache in use is not the saved one");
+    if (act & WIFI_CONN_ACT_SIGNAL_IP)
+    {
+        s->ip_signals++;
+        rule(s, s->on >= 0 && memcmp(s->fsm.cache.bssid, s->aps[s->on].bssid, 6) == 0,
+             "IP cached for another access point");
+    }
+    if (act & WIFI_CONN_ACT_SIGNAL_FAIL)
+    {
+        s->fail_signals++;
+        rule(s, s->fsm.phase != WIFI_CONN_FSM_GOT_IP && s->fsm.phase != WIFI_CONN_FSM_IDLE, "failure signalled idle");
+    }
+    if (act & WIFI_CONN_ACT_WAIT)
+    {
+        // One timer, as the supervisor task keeps it: rearming replaces it
+        const int64_t wait = s->fsm.retry_at_us - s->now_us;
+        if (s->fsm.phase == WIFI_CONN_FSM_BACKOFF)
+        {
+            rule(s, !cached && !scan, "wait with a join");
+            rule(s, wait >= s->fsm.cfg.backoff_min_us / 2 && wait <= s->fsm.cfg.backoff_max_us, "wait out of bounds");
+            s->backoff_until = s->fsm.retry_at_us;
+            if (s->n_waits < MAX_WAITS)
+                s->waits[s->n_waits++] = wait;
+        }
+        else
+        {
+            rule(s, (s->fsm.phase == WIFI_CONN_FSM_CONNECTING && (cached || scan) && wait == s->fsm.cfg.join_timeout_us) ||
+                        (s->fsm.phase == WIFI_CONN_FSM_ASSOCIATED && wait == s->fsm.cfg.dhcp_timeout_us),
+                 "deadline out of place");
+        }
+        int j = 0;
+        for (int i = 0; i < s->queued; i++)
+            if (s->queue[i].ev.type != WIFI_CONN_EV_TIMER)
+                s->queue[j++] = s->queue[i];
+        s->queued = j;
+        push(s, WIFI_CONN_EV_TIMER, s->fsm.retry_at_us, -1, 0);
+    }
+    rule(s, !(cached || scan) || !s->fsm.cfg.join_timeout_us || (act & WIFI_CONN_ACT_WAIT), "join without a deadline");
+    if (act & WIFI_CONN_ACT_FALLBACK)
+    {
+        s->fallbacks++;
+        rule(s, s->fsm.phase == WIFI_CONN_FSM_FAILED, "fell back without failing");
+    }
+}
+
+// Airtime of a join that ends before its IP, as the driver would see it
+static void join_ended(sim_t *s)
+{
+    if (s->fsm.phase == WIFI_CONN_FSM_CONNECTING || s->fsm.phase == WIFI_CONN_FSM_ASSOCIATED)
+        s->airtime_us += s->now_us - s->join_at;
+}
+
+static void feed(sim_t *s, wifi_conn_ev_type_t type, uint16_t reason)
+{
+    const wifi_conn_ev_t ev = {.type = type, .now_us = s->now_us, .reason = reason};
+    if (type == WIFI_CONN_EV_DISCONNECTED)
+        join_ended(s);
+    const uint32_t act = wifi_conn_fsm_handle(&s->fsm, &ev);
+    if (type == WIFI_CONN_EV_START && (act & (WIFI_CONN_ACT_JOIN_CACHED | WIFI_CONN_ACT_JOIN_SCAN)))
+        s->start_joins++;
+    apply(s, act);
+}
+
+// Delivers the driver events due by `until_us`
+static void run(sim_t *s, int64_t until_us)
+{
+    while (s->queued && s->queue[0].ev.now_us <= until_us)
+    {
+        sim_event_t e = s->queue[0];
+        memmove(s->queue, s->queue + 1, (size_t)--s->queued * sizeof(s->queue[0]));
+        s->now_us = e.ev.now_us;
+        if (e.ev.type == WIFI_CONN_EV_CONNECTED)
+        {
+            s->joining = false;
+            s->on = e.ap;
+            // The netif reports a static address at once, DHCP takes a while
+            wifi_conn_ev_t ip = {.type = WIFI_CONN_EV_GOT_IP, .now_us = s->now_us};
+            if (s->static_ip)
+            {
+                ip.ip = s->fsm.cache.ip;
+                ip.netmask = s->fsm.cache.netmask;
+                ip.gw = s->fsm.cache.gw;
+                ip.dns = s->fsm.cache.dns;
+            }
+            else
+            {
+                ip.now_us += DHCP_US;
+                ip.ip = s->aps[e.ap].ip;
+                ip.netmask = ip4(255, 255, 255, 0);
+                ip.gw = (s->aps[e.ap].ip & 0x00FFFFFFu) | (1u << 24);
+                ip.dns = ip.gw;
+            }
+            if (s->static_ip || !s->dhcp_dead)
+                push_ev(s, &ip, e.ap);
+        }
+        else if (e.ev.type == WIFI_CONN_EV_DISCONNECTED && e.ap != LEAVE_ANSWER)
+        {
+            s->joining = false;
+            s->on = -1;
+            join_ended(s);
+        }
+        else if (e.ev.type == WIFI_CONN_EV_JOIN_REFUSED)
+        {
+            s->joining = false;
+            if (s->fsm.phase == WIFI_CONN_FSM_CONNECTING)
+                s->refusals++;
+            join_ended(s);
+        }
+        apply(s, wifi_conn_fsm_handle(&s->fsm, &e.ev));
+    }
+    if (until_us > s->now_us)
+        s->now_us = until_us;
+}
+
+// The link goes (beacons lost); what was queued for it never comes
+static void drop_link(sim_t *s)
+{
+    if (s->on < 0)
+        return;
+    s->queued = 0;
+    s->on = -1;
+    feed(s, WIFI_CONN_EV_DISCONNECTED, REASON_BEACON_TIMEOUT);
+}
+
+// wifi_conn_stop(): the state machine first, then the driver's disconnect
+static void stop(sim_t *s)
+{
+    feed(s, WIFI_CONN_EV_STOP, 0);
+    s->backoff_until = 0;
+    if (s->on >= 0)
+    {
+        s->on = -1;
+        feed(s, WIFI_CONN_EV_DISCONNECTED, REASON_ASSOC_LEAVE);
+    }
+}
+
+/*========== Fixed scenarios ==========*/
+static wifi_conn_cache_t s_learned; // cache of the cold boot, for the others
+static int64_t s_boot_scan_us, s_boot_fast_us, s_boot_lease_us;
+
+static void two_aps(sim_t *s)
+{
+    add_ap(s, 1, 6, -60, ip4(192, 168, 1, 50));
+    add_ap(s, 2, 11, -48, ip4(192, 168, 1, 51));
+}
+
+static void check_cold_boot(void)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = plain(1, false, 3);
+    sim_init(&s, &cfg, NULL);
+    two_aps(&s);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, 10000000);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP, "phase %d", s.fsm.phase);
+    CHECK(s.joins_scan == 1 && s.joins_cached == 0, "joins %d scan, %d cached", s.joins_scan, s.joins_cached);
+    CHECK(s.saves == 1, "%d saves", s.saves);
+    CHECK(memcmp(s.nvs.bssid, s.aps[1].bssid, 6) == 0 && s.nvs.channel == 11, "saved not the strongest AP");
+    CHECK(s.nvs.ip == s.aps[1].ip && s.nvs.dns != 0, "lease not saved");
+    const int64_t want = BOOT_US + CHANNELS * PROBE_US + ASSOC_US + DHCP_US;
+    CHECK(s.fsm.stats.boot_to_ip_us == want, "boot to IP %lld, want %lld", (long long)s.fsm.stats.boot_to_ip_us,
+          (long long)want);
+    CHECK(s.fsm.stats.scans == 1 && s.fsm.stats.reconnects == 0, "stats");
+    s_learned = s.nvs;
+    s_boot_scan_us = s.fsm.stats.boot_to_ip_us;
+}
+
+static void check_warm_boot(bool reuse_lease)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = plain(1, reuse_lease, 3);
+    sim_init(&s, &cfg, &s_learned);
+    two_aps(&s);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, 10000000);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP, "phase %d", s.fsm.phase);
+    CHECK(s.joins_cached == 1 && s.joins_scan == 0, "joins %d cached, %d scan", s.joins_cached, s.joins_scan);
+    CHECK(s.saves == 0, "unchanged cache saved again");
+    CHECK(s.static_ip == reuse_lease, "static lease %d", s.static_ip);
+    CHECK(s.fsm.stats.fast_hits == 1 && s.fsm.stats.fast_misses == 0, "stats");
+    const int64_t want = BOOT_US + PROBE_US + ASSOC_US + (reuse_lease ? 0 : DHCP_US);
+    CHECK(s.fsm.stats.boot_to_ip_us == want, "boot to IP %lld, want %lld", (long long)s.fsm.stats.boot_to_ip_us,
+          (long long)want);
+    if (reuse_lease)
+        s_boot_lease_us = want;
+    else
+        s_boot_fast_us = want;
+}
+
+static void check_stale_cache(void)
+{
+    s_cases++;
+    // The cached access point was replaced: other BSSID, other channel
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = plain(2, true, 3);
+    sim_init(&s, &cfg, &s_learned);
+    add_ap(&s, 7, 1, -55, ip4(10, 0, 0, 20));
+    feed(&s, WIFI_CONN_EV_START, 0);
+    CHECK(s.static_ip, "cached lease not set for the cached join");
+    run(&s, 10000000);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP, "phase %d", s.fsm.phase);
+    CHECK(s.joins_cached == 2 && s.joins_scan == 1, "joins %d cached, %d scan", s.joins_cached, s.joins_scan);
+    CHECK(!s.static_ip, "scan join kept the static lease");
+    CHECK(s.fsm.stats.fast_misses == 2 && s.fsm.stats.scans == 1, "stats");
+    // One retry for each miss: the second cached join and the scan
+    CHECK(s.fsm.stats.retries == 2, "%u retries for 2 misses", s.fsm.stats.retries);
+    CHECK(s.saves == 1 && s.nvs.channel == 1 && s.nvs.ip == ip4(10, 0, 0, 20), "new access point not saved");
+}
+
+static void check_lost_link(void)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = backoff(0, 3, 1); // a lost link rejoins at once all the same
+    sim_init(&s, &cfg, &s_learned);
+    two_aps(&s);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, 60000000);
+
+    // The access point reboots: back on the same channel
+    drop_link(&s);
+    run(&s, s.now_us + 10000000);
+    CHECK(!s.error, "%s", s.error);
+    const int64_t fast = PROBE_US + ASSOC_US + DHCP_US;
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP, "phase %d", s.fsm.phase);
+    CHECK(s.fsm.stats.reconnects == 1 && s.fsm.stats.reconnect_last_us == fast, "reconnect %lld, want %lld",
+          (long long)s.fsm.stats.reconnect_last_us, (long long)fast);
+    CHECK(s.joins_scan == 0, "reconnect scanned");
+
+    // It comes back on another channel: one miss, then the scan
+    run(&s, s.now_us + 60000000);
+    s.aps[1].channel = 3;
+    drop_link(&s);
+    run(&s, s.now_us + 10000000);
+    CHECK(!s.error, "%s", s.error);
+    const int64_t slow = PROBE_US + CHANNELS * PROBE_US + ASSOC_US + DHCP_US;
+    CHECK(s.fsm.stats.reconnects == 2 && s.fsm.stats.reconnect_last_us == slow &&
+              s.fsm.stats.reconnect_max_us == slow,
+          "reconnect %lld max %lld, want %lld", (long long)s.fsm.stats.reconnect_last_us,
+          (long long)s.fsm.stats.reconnect_max_us, (long long)slow);
+    CHECK(s.saves == 1 && s.nvs.channel == 3, "moved access point not saved");
+    CHECK(s.links_lost == 2 && s.n_waits == 0, "%d links lost, %d waits", s.links_lost, s.n_waits);
+    CHECK(s.fsm.stats.reasons[WIFI_CONN_REASON_LINK_LOST] == 2 && s.fsm.stats.reasons[WIFI_CONN_REASON_NOT_FOUND] == 1,
+          "reasons");
+    CHECK(s.fsm.stats.boot_to_ip_us == BOOT_US + PROBE_US + ASSOC_US + DHCP_US, "boot to IP changed");
+}
+
+static void check_gone(bool wrong_password)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = plain(1, false, 2);
+    sim_init(&s, &cfg, &s_learned);
+    if (wrong_password)
+    {
+        two_aps(&s);
+        s.wrong_password = true;
+    }
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, 60000000);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_FAILED, "phase %d", s.fsm.phase);
+    CHECK(s.joins_cached == 1 && s.joins_scan == 3, "joins %d cached, %d scan", s.joins_cached, s.joins_scan);
+    CHECK(s.fail_signals == 1 && s.fsm.stats.failures == 1, "fail signalled %d times", s.fail_signals);
+    CHECK(s.fallbacks == 1 && s.fsm.stats.fallbacks == 1, "%d fallbacks", s.fallbacks);
+    CHECK(s.queued == 0, "driver events left");
+
+    // Late events change nothing; a new start goes again
+    feed(&s, WIFI_CONN_EV_DISCONNECTED, REASON_NO_AP_FOUND);
+    CHECK(s.joins_scan == 3, "joined after failing");
+    if (!wrong_password)
+        two_aps(&s);
+    s.wrong_password = false;
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, s.now_us + 10000000);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP && s.fsm.stats.fast_hits == 1, "restart after failing");
+}
+
+static void check_stop(void)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = plain(1, false, 3);
+    sim_init(&s, &cfg, NULL);
+    two_aps(&s);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, s.now_us + PROBE_US); // scanning
+    feed(&s, WIFI_CONN_EV_START, 0); // again: nothing to do
+    stop(&s);
+    const int joins = s.joins_scan;
+    run(&s, s.now_us + 10000000); // the join finishes anyway
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_IDLE, "phase %d after stop", s.fsm.phase);
+    CHECK(s.ip_signals == 0 && s.saves == 0 && s.joins_scan == joins, "events after stop acted on");
+
+    // Connected, stopped, started: a start, not a reconnect
+    s.on = -1;
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, s.now_us + 10000000);
+    stop(&s);
+    run(&s, s.now_us + 5000000);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, s.now_us + 10000000);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP && s.fsm.stats.reconnects == 0, "restart counted as reconnect");
+    CHECK(s.fsm.stats.connect_us == PROBE_US + ASSOC_US + DHCP_US, "connect %lld", (long long)s.fsm.stats.connect_us);
+}
+
+static void check_renewal(void)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = plain(1, false, 3);
+    sim_init(&s, &cfg, &s_learned);
+    two_aps(&s);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, 10000000);
+    wifi_conn_ev_t ev = {.type = WIFI_CONN_EV_GOT_IP, .now_us = s.now_us, .ip = ip4(192, 168, 1, 77)};
+    ev.netmask = s.fsm.cache.netmask;
+    ev.gw = s.fsm.cache.gw;
+    ev.dns = s.fsm.cache.dns;
+    const uint32_t act = wifi_conn_fsm_handle(&s.fsm, &ev);
+    CHECK(act == WIFI_CONN_ACT_SAVE_CACHE, "renewal actions 0x%x", (unsigned)act);
+    CHECK(s.fsm.cache.ip == ev.ip && s.fsm.stats.fast_hits == 1, "renewal");
+    CHECK(wifi_conn_fsm_handle(&s.fsm, &ev) == 0, "same lease saved twice");
+}
+
+static void check_fast_off(void)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = plain(0, true, 3);
+    sim_init(&s, &cfg, &s_learned);
+    two_aps(&s);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, 10000000);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.joins_cached == 0 && s.joins_scan == 1 && !s.static_ip, "cache used with fast joins off");
+
+    wifi_conn_fsm_forget(&s.fsm);
+    CHECK(s.fsm.cache.channel == 0 && s.fsm.cache.ip == 0, "forget");
+}
+
+/*========== Backoff and fallback ==========*/
+static int s_outage_joins, s_outage_joins_now;
+static int64_t s_outage_air_us, s_outage_air_now_us;
+
+// Longest wait of the k-th backoff since the last IP
+static int64_t cap_of(const wifi_conn_fsm_config_t *cfg, int k)
+{
+    int64_t d = cfg->backoff_min_us;
+    for (int i = 0; i < k && d < cfg->backoff_max_us; i++)
+        d *= 2;
+    return d < cfg->backoff_max_us ? d : cfg->backoff_max_us;
+}
+
+// An hour without the access point, then it comes back
+static void check_outage(bool at_once)
+{
+    s_cases++;
+    sim_t s;
+    wifi_conn_fsm_config_t cfg = backoff(0, 3, 7);
+    if (at_once)
+        cfg.backoff_min_us = 0;
+    sim_init(&s, &cfg, &s_learned);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, BOOT_US + 3600 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase != WIFI_CONN_FSM_FAILED && s.fallbacks == 0, "gave up with fallback off");
+    CHECK(s.fail_signals == 1, "failure signalled %d times", s.fail_signals);
+    CHECK(s.airtime_us == s.fsm.stats.retry_airtime_us, "airtime %lld, counted %lld", (long long)s.airtime_us,
+          (long long)s.fsm.stats.retry_airtime_us);
+    const int joins = s.joins_cached + s.joins_scan;
+    CHECK((int)s.fsm.stats.retries == joins - 1, "%u retries, %d joins", s.fsm.stats.retries, joins);
+    if (at_once)
+    {
+        s_outage_joins_now = joins;
+        s_outage_air_now_us = s.airtime_us;
+        return;
+    }
+    CHECK(joins <= 60, "%d joins in the hour", joins);
+    for (int k = 0; k < s.n_waits; k++)
+    {
+        const int64_t d = cap_of(&cfg, k);
+        CHECK(s.waits[k] >= d - d / 2 && s.waits[k] <= d, "wait %d: %lld, want %lld..%lld", k, (long long)s.waits[k],
+              (long long)(d - d / 2), (long long)d);
+    }
+    CHECK(s.n_waits > 10 && s.waits[s.n_waits - 1] >= cfg.backoff_max_us / 2, "backoff never reached the cap");
+    int64_t waited = 0;
+    for (int k = 0; k < s.n_waits; k++)
+        waited += s.waits[k];
+    CHECK(waited == s.fsm.stats.backoff_us, "backoff %lld, counted %lld", (long long)waited,
+          (long long)s.fsm.stats.backoff_us);
+    s_outage_joins = joins;
+    s_outage_air_us = s.airtime_us;
+
+    // Back within one capped wait and a scan; the next outage starts short again
+    two_aps(&s);
+    run(&s, s.now_us + cfg.backoff_max_us + 10 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP && s.ip_signals == 1, "no IP after the access point came back");
+    CHECK(s.fsm.backoff_n == 0 && s.fsm.rounds_failed == 0, "backoff kept after the IP");
+    s.aps[0].up = s.aps[1].up = false;
+    const int n = s.n_waits;
+    drop_link(&s);
+    run(&s, s.now_us + 10 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.n_waits > n && s.waits[n] <= cfg.backoff_min_us, "first wait after the IP %lld", (long long)s.waits[n]);
+}
+
+// Stations that lost the same access point come back spread out
+static void check_jitter(void)
+{
+    s_cases++;
+    int64_t lo = INT64_MAX, hi = 0;
+    for (uint32_t seed = 1; seed <= 100; seed++)
+    {
+        sim_t s;
+        const wifi_conn_fsm_config_t cfg = backoff(0, 3, seed * 2654435761u);
+        sim_init(&s, &cfg, &s_learned);
+        feed(&s, WIFI_CONN_EV_START, 0);
+        run(&s, BOOT_US + 30 * SEC);
+        CHECK(!s.error, "seed %u: %s", seed, s.error);
+        CHECK(s.n_waits >= 3, "seed %u: %d waits", seed, s.n_waits);
+        if (s.waits[2] < lo)
+            lo = s.waits[2];
+        if (s.waits[2] > hi)
+            hi = s.waits[2];
+    }
+    // Third wait: 2 to 4 s
+    CHECK(lo >= 2 * SEC && hi <= 4 * SEC && hi - lo >= 3 * SEC / 2, "third wait %lld..%lld us", (long long)lo,
+          (long long)hi);
+}
+
+// A wrong password: rejected three times in a row, then the provisioning AP
+static void check_auth_fallback(void)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = backoff(0, 3, 1);
+    sim_init(&s, &cfg, &s_learned);
+    two_aps(&s);
+    s.wrong_password = true;
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, BOOT_US + 60 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_FAILED && s.fallbacks == 1 && s.fail_signals == 1, "no fallback");
+    CHECK(s.fsm.last_reason == WIFI_CONN_REASON_AUTH && s.fsm.stats.reasons[WIFI_CONN_REASON_AUTH] == 3,
+          "%u rejections", s.fsm.stats.reasons[WIFI_CONN_REASON_AUTH]);
+    CHECK(s.joins_cached == 1 && s.joins_scan == 2, "joins %d cached, %d scan", s.joins_cached, s.joins_scan);
+    CHECK(s.queued == 0, "driver events left");
+
+    // New credentials: a start clears the count
+    s.wrong_password = false;
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, s.now_us + 10 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP && s.fsm.auth_fails == 0, "restart after the fallback");
+}
+
+// Rounds: the first failed one is signalled, the second gives up
+static void check_round_fallback(void)
+{
+    s_cases++;
+    sim_t s;
+    wifi_conn_fsm_config_t cfg = backoff(2, 3, 1);
+    cfg.max_retry = 1;
+    sim_init(&s, &cfg, &s_learned);
+    feed(&s, WIFI_CONN_EV_START, 0);
+    while (!s.fail_signals && s.queued && !s.error)
+        run(&s, s.queue[0].ev.now_us);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_BACKOFF && s.fallbacks == 0, "first round: phase %d", s.fsm.phase);
+    CHECK(s.joins_cached == 1 && s.joins_scan == 2 && s.fsm.stats.failures == 1, "first round: joins");
+    run(&s, s.now_us + 600 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_FAILED && s.fallbacks == 1 && s.fail_signals == 1, "second round");
+    CHECK(s.joins_cached == 2 && s.joins_scan == 4 && s.fsm.stats.failures == 2, "joins %d cached, %d scan",
+          s.joins_cached, s.joins_scan);
+    CHECK(s.fsm.last_reason == WIFI_CONN_REASON_NOT_FOUND, "reason %d", s.fsm.last_reason);
+    CHECK(s.airtime_us == s.fsm.stats.retry_airtime_us && s.airtime_us == 2 * PROBE_US + 4 * CHANNELS * PROBE_US,
+          "airtime %lld", (long long)s.airtime_us);
+}
+
+/*========== Faults ==========*/
+// The driver is busy (a scan of the provisioning AP): the joins fail at once
+static void check_refused(void)
+{
+    s_cases++;
+    sim_t s;
+    const wifi_conn_fsm_config_t cfg = backoff(0, 3, 1);
+    sim_init(&s, &cfg, &s_learned);
+    two_aps(&s);
+    s.refuse = 2;
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, BOOT_US + 60 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP, "phase %d", s.fsm.phase);
+    CHECK(s.fsm.stats.refused == 2 && s.refusals == 2, "%u refused", s.fsm.stats.refused);
+    CHECK(s.joins_cached == 1 && s.joins_scan == 2, "joins %d cached, %d scan", s.joins_cached, s.joins_scan);
+    CHECK(s.n_waits == 1 && s.fail_signals == 0, "%d waits", s.n_waits);
+    CHECK(s.fsm.stats.timeouts == 0 && s.airtime_us == 0 && s.fsm.stats.retry_airtime_us == 0, "refusals took air");
+}
+
+// Joins the driver never answers: left at the deadline, backing off as usual
+static void check_join_silent(void)
+{
+    s_cases++;
+    sim_t s;
+    wifi_conn_fsm_config_t cfg = backoff(0, 3, 1);
+    cfg.join_timeout_us = 5 * SEC;
+    sim_init(&s, &cfg, &s_learned);
+    two_aps(&s);
+    s.silent = true;
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, BOOT_US + 60 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_CONNECTING || s.fsm.phase == WIFI_CONN_FSM_BACKOFF, "phase %d", s.fsm.phase);
+    const uint32_t timeouts = s.fsm.stats.timeouts;
+    CHECK(timeouts >= 4 && (int)timeouts == s.leaves && (int)timeouts == s.joins_cached + s.joins_scan - (s.joining ? 1 : 0),
+          "%u timeouts, %d leaves", timeouts, s.leaves);
+    CHECK(s.airtime_us == s.fsm.stats.retry_airtime_us && s.airtime_us == timeouts * cfg.join_timeout_us,
+          "airtime %lld", (long long)s.airtime_us);
+    CHECK(s.fsm.last_reason == WIFI_CONN_REASON_OTHER && s.fsm.stats.reasons[WIFI_CONN_REASON_LINK_LOST] == 0,
+          "the disconnect of a leave counted");
+    CHECK(s.n_waits >= 2 && s.fail_signals == 1, "%d waits", s.n_waits);
+
+    s.silent = false;
+    run(&s, s.now_us + 60 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP && s.fsm.stats.timeouts == timeouts, "no IP once answered");
+}
+
+// Associated, but the DHCP server is gone: left, the scan finds another way
+static void check_dhcp_dead(void)
+{
+    s_cases++;
+    sim_t s;
+    wifi_conn_fsm_config_t cfg = backoff(0, 3, 1);
+    cfg.dhcp_timeout_us = 10 * SEC;
+    sim_init(&s, &cfg, &s_learned);
+    two_aps(&s);
+    s.dhcp_dead = true;
+    feed(&s, WIFI_CONN_EV_START, 0);
+    run(&s, BOOT_US + PROBE_US + ASSOC_US + cfg.dhcp_timeout_us);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.stats.timeouts == 1 && s.leaves == 1 && s.on < 0, "%u timeouts", s.fsm.stats.timeouts);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_CONNECTING && s.joins_scan == 1, "phase %d", s.fsm.phase);
+
+    s.dhcp_dead = false;
+    run(&s, s.now_us + 60 * SEC);
+    CHECK(!s.error, "%s", s.error);
+    CHECK(s.fsm.phase == WIFI_CONN_FSM_GOT_IP && s.fsm.stats.timeouts == 1, "phase %d", s.fsm.phase);
+    CHECK(s.joins_cached == 1 && s.joins_scan == 1 && s.fsm.stats.fast_misses == 1, "joins %d cached, %d scan",
+          s.joins_cached, s.joins_scan);
+    uint32_t disconnects = 0;
+    for (int i = 0; i < WIFI_CONN_REASON_COUNT; i++)
+        disconnects += s.fsm.stats.reasons[i];
+    CHECK(disconnects == 0, "the disconnect of a leave counted");
+    CHECK(s.airtime_us == s.fsm.stats.retry_airtime_us && s.airtime_us == PROBE_US + ASSOC_US + cfg.dhcp_timeout_us,
+          "airtime %lld", (long long)s.airtime_us);
+}
+
+static void check_classify(void)
+{
+    static const struct
+    {
+        uint16_t reason;
+        wifi_conn_reason_class_t cls;
+    } table[] = {
+        {1, WIFI_CONN_REASON_OTHER},       {2, WIFI_CONN_REASON_OTHER},       {3, WIFI_CONN_REASON_LINK_LOST},
+        {4, WIFI_CONN_REASON_LINK_LOST},   {8, WIFI_CONN_REASON_LINK_LOST},   {14, WIFI_CONN_REASON_AUTH},
+        {15, WIFI_CONN_REASON_AUTH},       {23, WIFI_CONN_REASON_AUTH},       {34, WIFI_CONN_REASON_LINK_LOST},
+        {200, WIFI_CONN_REASON_LINK_LOST}, {201, WIFI_CONN_REASON_NOT_FOUND}, {202, WIFI_CONN_REASON_AUTH},
+        {203, WIFI_CONN_REASON_OTHER},     {204, WIFI_CONN_REASON_AUTH},      {205, WIFI_CONN_REASON_OTHER},
+        {206, WIFI_CONN_REASON_LINK_LOST}, {209, WIFI_CONN_REASON_LINK_LOST}, {210, WIFI_CONN_REASON_NOT_FOUND},
+        {211, WIFI_CONN_REASON_NOT_FOUND}, {212, WIFI_CONN_REASON_NOT_FOUND}, {0, WIFI_CONN_REASON_OTHER},
+        {65535, WIFI_CONN_REASON_OTHER},
+    };
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        s_cases++;
+        CHECK(wifi_conn_fsm_classify(table[i].reason) == table[i].cls, "reason %u", table[i].reason);
+    }
+}
+
+/*========== Random worlds ==========*/
+static uint32_t s_rng;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void random_round(int round)
+{
+    s_cases++;
+    sim_t s;
+    const int n_aps = (int)(rnd() % 4);
+    wifi_conn_cache_t cache = {0};
+    const uint32_t c = rnd() % 3;
+    if (c == 1)
+        cache = s_learned;
+    else if (c == 2 && n_aps)
+        cache = (wifi_conn_cache_t){.bssid = {0x24, 0x0a, 0xc4, 0x10, 0x20, 1}, .channel = 1, .ip = ip4(10, 0, 0, 9)};
+    wifi_conn_fsm_config_t cfg = plain((int)(rnd() % 4), rnd() & 1, (int)(rnd() % 6));
+    if (rnd() & 1)
+    {
+        cfg.backoff_min_us = (int64_t)(rnd() % 2000000);
+        cfg.backoff_max_us = cfg.backoff_min_us + (int64_t)(rnd() % 60000000);
+    }
+    cfg.fallback_rounds = (int)(rnd() % 4);
+    cfg.auth_fallback = (int)(rnd() % 4);
+    if (rnd() & 1)
+        cfg.join_timeout_us = 500000 + (int64_t)(rnd() % 3000000); // shorter than a scan, at times
+    if (rnd() & 1)
+        cfg.dhcp_timeout_us = 100000 + (int64_t)(rnd() % 1000000); // shorter than DHCP, at times
+    cfg.seed = rnd();
+    sim_init(&s, &cfg, c ? &cache : NULL);
+    for (int i = 0; i < n_aps; i++)
+        add_ap(&s, (uint8_t)(1 + i), (uint8_t)(1 + rnd() % CHANNELS), (int8_t)(-40 - (int)(rnd() % 50)),
+               ip4(192, 168, 1, 50 + i));
+    s.wrong_password = rnd() % 16 == 0;
+    // Only faults a deadline ends: none leaves a phase waiting forever
+    s.refuse = rnd() % 4 == 0 ? (int)(rnd() % 8) : 0;
+    s.silent = cfg.join_timeout_us && rnd() % 8 == 0;
+    s.dhcp_dead = cfg.dhcp_timeout_us && rnd() % 8 == 0;
+
+    feed(&s, WIFI_CONN_EV_START, 0);
+    bool stopped = false;
+    while (s.now_us < 120000000 && !s.error)
+    {
+        run(&s, s.now_us + 100000 + (int64_t)(rnd() % 5000000));
+        rule(&s, s.queued || (s.fsm.phase != WIFI_CONN_FSM_CONNECTING && s.fsm.phase != WIFI_CONN_FSM_ASSOCIATED &&
+                              s.fsm.phase != WIFI_CONN_FSM_BACKOFF),
+             "waiting for an event that never comes");
+        const uint32_t r = rnd() % 8;
+        if (r == 0 && n_aps)
+        {
+            sim_ap_t *ap = &s.aps[rnd() % (uint32_t)n_aps];
+            ap->up = !ap->up;
+            if (!ap->up && s.on >= 0 && &s.aps[s.on] == ap)
+                drop_link(&s);
+        }
+        else if (r == 1 && n_aps)
+        {
+            const int i = (int)(rnd() % (uint32_t)n_aps);
+            s.aps[i].channel = (uint8_t)(1 + rnd() % CHANNELS);
+            if (s.on == i)
+                drop_link(&s);
+        }
+        else if (r == 2)
+        {
+            drop_link(&s);
+        }
+        else if (r == 3 && !stopped)
+        {
+            stop(&s);
+            stopped = true;
+        }
+        else if (r == 4 && (stopped || s.fsm.phase == WIFI_CONN_FSM_FAILED))
+        {
+            s.queued = 0;
+            s.joining = false;
+            s.on = -1;
+            feed(&s, WIFI_CONN_EV_START, 0);
+            stopped = false;
+        }
+        else if (r == 5)
+        {
+            feed(&s, WIFI_CONN_EV_TIMER, 0); // a stale timer of an earlier backoff
+        }
+        else if (r == 6 && rnd() % 4 == 0)
+        {
+            s.refuse += (int)(rnd() % 3); // a provisioning scan comes along
+        }
+    }
+    CHECK(!s.error, "round %d: %s", round, s.error);
+    const wifi_conn_stats_t *st = &s.fsm.stats;
+    CHECK((int)(st->fast_hits + st->scans) == s.ip_signals, "round %d: %u + %u IPs counted, %d signalled", round,
+          st->fast_hits, st->scans, s.ip_signals);
+    CHECK(s.fail_signals <= (int)st->failures && (int)st->fallbacks == s.fallbacks, "round %d: failures", round);
+    CHECK(st->retry_airtime_us == s.airtime_us, "round %d: airtime %lld, counted %lld", round,
+          (long long)s.airtime_us, (long long)st->retry_airtime_us);
+    CHECK((int)st->retries == s.joins_cached + s.joins_scan - s.start_joins - s.links_lost,
+          "round %d: %u retries, %d joins, %d of a start, %d of a lost link", round, st->retries,
+          s.joins_cached + s.joins_scan, s.start_joins, s.links_lost);
+    CHECK((int)st->timeouts == s.leaves && (int)st->refused == s.refusals, "round %d: %u timeouts, %d leaves, %u refused, %d refusals",
+          round, st->timeouts, s.leaves, st->refused, s.refusals);
+    CHECK((int)st->fast_misses <= s.joins_cached && (int)st->reconnects <= s.ip_signals, "round %d: counters", round);
+    CHECK(s.fsm.cfg.reuse_lease || !s.static_ip, "round %d: static lease without reuse", round);
+    CHECK(!st->boot_to_ip_us || st->boot_to_ip_us >= BOOT_US + PROBE_US + ASSOC_US, "round %d: boot to IP", round);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = 20000;
+    s_rng = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            s_rng = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n ROUNDS] [-s SEED]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!s_rng)
+        s_rng = 1;
+
+    check_cold_boot();
+    check_warm_boot(false);
+    check_warm_boot(true);
+    check_stale_cache();
+    check_lost_link();
+    check_gone(false);
+    check_gone(true);
+    check_stop();
+    check_renewal();
+    check_fast_off();
+    check_outage(false);
+    check_outage(true);
+    check_jitter();
+    check_auth_fallback();
+    check_round_fallback();
+    check_refused();
+    check_join_silent();
+    check_dhcp_dead();
+    check_classify();
+    if (!s_failures)
+    {
+        printf("boot to IP (simulated): full scan %.2f s, cached AP %.2f s, cached AP and lease %.2f s\n",
+               s_boot_scan_us / 1e6, s_boot_fast_us / 1e6, s_boot_lease_us / 1e6);
+        printf("an hour without the access point: %d joins, %.1f s on air with backoff; %d joins, %.1f s at once\n",
+               s_outage_joins, s_outage_air_us / 1e6, s_outage_joins_now, s_outage_air_now_us / 1e6);
+    }
+
+    for (int i = 0; i < rounds; i++)
+        random_round(i);
+
+    printf("%d cases, %d failures\n", s_cases, s_failures);
+    return s_failures ? 1 : 0;
+}
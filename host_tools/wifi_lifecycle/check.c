@@ -0,0 +1,383 @@
+// wifi_lifecycle_check: init/stop/re-init cycles of the Wi-Fi components
+// (firmware/esp_idf_shared_components/wifi_connect/src/wifi_stack.c,
+// wifi_connect.c and wifi_config_ap/src/wifi_config_ap.c) on the host,
+// against the ESP-IDF stand-ins of mock_idf.c.
+//
+//   wifi_lifecycle_check [-n CYCLES] [-v]
+//
+// Goes through the gateway's Wi-Fi life over and over, the way app_runtime
+// does: the STA joins, is initialised again, gives way to the provisioning
+// AP (initialised twice too; the STA stops in the middle of a join), which
+// scans and runs its captive DNS, and is taken down again for the STA; every other cycle the STA joins while the
+// AP runs and keeps its IP when the AP goes; every third cycle everything
+// goes down, once in the middle of a backoff, and the next cycle starts
+// with the AP on a cold driver. After each step it compares what is alive
+// (tasks, queues, event groups, mutexes, handlers, timers, netifs, sockets,
+// NVS handles, the driver, scan records, and their heap bytes) with the
+// same step of the second cycle (the first creates what stays for good),
+// and at the end with nothing but that. Also checks that the driver is
+// initialised once per hold, that going between AP and STA is a mode
+// change and that no call breaks an ESP-IDF rule (mock_idf.h). Prints the
+// counts. -v logs the components. Exits non-zero on failure.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "mock_idf.h"
+#include "wifi_config_ap.h"
+#include "wifi_connect.h"
+
+#define IP_TIMEOUT_MS 2000
+#define POLL_MS 2
+#define POLL_TIMEOUT_MS 2000
+#define SLOW_JOIN_MS 10 // esp_wifi_set_config() of the join stopped in ap_up()
+
+// What stays for good: wifi_stack's lock, wifi_connect's state machine lock
+// (with the stats), wifi_config_ap's scan list lock
+#define MUTEXES_FOR_GOOD 3
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        s_cases++;                                                                                                \
+        if (!(cond))                                                                                              \
+        {                                                                                                         \
+            fprintf(stderr, "FAIL %s:%d (cycle %d): ", __func__, __LINE__, s_cycle);                              \
+            fprintf(stderr, __VA_ARGS__);                                                                         \
+            fputc('\n', stderr);                                                                                  \
+            s_failures++;                                                                                         \
+            return;                                                                                               \
+        }                                                                                                         \
+    } while (0)
+
+typedef enum
+{
+    STEP_AP_COLD = 0,
+    STEP_STA_UP,
+    STEP_STA_AGAIN,
+    STEP_AP_UP,
+    STEP_AP_AGAIN,
+    STEP_BOTH,
+    STEP_STA_BACK,
+    STEP_DOWN,
+    STEP_COUNT,
+} step_t;
+
+static const char *const s_step_names[STEP_COUNT] = {
+    "AP on a cold driver", "STA up", "STA init again", "STA to AP", "AP init again", "STA with the AP",
+    "AP to STA",           "down",
+};
+
+static int s_cycle = 0;
+static bool s_have[STEP_COUNT];
+static mock_usage_t s_at[STEP_COUNT]; // at each step of its first cycle after the first
+static mock_totals_t s_totals_at_sta_up;
+
+static const wifi_conn_config_t s_sta = {.ssid = "deepfocus", .password = "password", .max_retry = -1,
+                                         .auto_start = true};
+static wifi_config_ap_settings_t s_ap = {.ssid = "DeepFocus-Setup", .password = "", .channel = 1,
+                                         .max_connections = 4, .auto_start = true};
+
+static bool ap_started(void)
+{
+    for (int waited = 0; waited < POLL_TIMEOUT_MS; waited += POLL_MS)
+    {
+        if (wifi_config_ap_get_state() == WIFI_CONFIG_AP_STATE_STARTED)
+            return true;
+        usleep(POLL_MS * 1000);
+    }
+    return false;
+}
+
+static size_t scan_listed(void)
+{
+    wifi_scan_ap_t aps[CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS];
+    size_t n = 0;
+    int32_t age_ms;
+    for (int waited = 0; waited < POLL_TIMEOUT_MS; waited += POLL_MS)
+    {
+        if (wifi_config_ap_get_scan(aps, CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS, &n, &age_ms) == ESP_OK && age_ms >= 0)
+            return n;
+        usleep(POLL_MS * 1000);
+    }
+    return 0;
+}
+
+static void print_usage(FILE *f, const char *what, const mock_usage_t *u)
+{
+    fprintf(f, "  %s: %ld bytes;", what, u->heap);
+    for (int k = 0; k < MOCK_KIND_COUNT; k++)
+        if (u->live[k])
+            fprintf(f, " %s %d", mock_kind_name((mock_kind_t)k), u->live[k]);
+    fputc('\n', f);
+}
+
+// What is alive once events are dispatched and tasks that said they are
+// done have deleted themselves (the idle task's job on the chip)
+static void quiet_usage(mock_usage_t *out)
+{
+    mock_usage_t before;
+    mock_idf_settle();
+    mock_idf_usage(&before);
+    for (int i = 0; i < POLL_TIMEOUT_MS / POLL_MS; i++)
+    {
+        usleep(POLL_MS * 1000);
+        mock_idf_settle();
+        mock_idf_usage(out);
+        if (memcmp(out, &before, sizeof(*out)) == 0)
+            return;
+        before = *out;
+    }
+}
+
+// Same handles and bytes alive as at this step of the second cycle
+static void check_step(step_t step)
+{
+    mock_usage_t now;
+    quiet_usage(&now);
+    CHECK(mock_idf_errors() == 0, "ESP-IDF misuse at \"%s\"", s_step_names[step]);
+    if (s_cycle == 0)
+        return;
+    if (!s_have[step])
+    {
+        s_at[step] = now;
+        s_have[step] = true;
+        return;
+    }
+    const bool same = memcmp(now.live, s_at[step].live, sizeof(now.live)) == 0 && now.heap == s_at[step].heap;
+    if (!same)
+    {
+        print_usage(stderr, "now", &now);
+        print_usage(stderr, "before", &s_at[step]);
+    }
+    CHECK(same, "\"%s\" holds more or less than it did before", s_step_names[step]);
+}
+
+static void check_mode(wifi_mode_t want, bool started)
+{
+    bool is_started;
+    const wifi_mode_t mode = mock_wifi_mode(&is_started);
+    CHECK(mode == want && is_started == started, "driver in mode %d (%s), expected %d (%s)", mode,
+          is_started ? "started" : "stopped", want, started ? "started" : "stopped");
+}
+
+// A scan another component started: its records stay in the driver for it
+static void foreign_scan(void)
+{
+    // Once the AP's own scan is over: the driver runs one scan at a time
+    mock_idf_settle();
+    CHECK(esp_wifi_scan_start(NULL, false) == ESP_OK, "scan not started");
+    mock_idf_settle();
+    wifi_ap_record_t rec;
+    int n = 0;
+    while (esp_wifi_scan_get_ap_record(&rec) == ESP_OK)
+        n++;
+    CHECK(n == 3, "%d of 3 records left to the scan's owner", n);
+}
+
+/*========== Steps ==========*/
+// The provisioning AP from nothing, as on a boot with no network; let go again
+static void ap_cold(void)
+{
+    CHECK(wifi_config_ap_init(&s_ap) == ESP_OK, "wifi_config_ap_init failed");
+    CHECK(ap_started(), "AP not started");
+    check_mode(WIFI_MODE_APSTA, true);
+    CHECK(scan_listed() == 3, "scan list not published");
+    check_step(STEP_AP_COLD);
+    CHECK(wifi_config_ap_deinit() == ESP_OK, "wifi_config_ap_deinit failed");
+    check_mode(WIFI_MODE_NULL, false);
+    mock_usage_t u;
+    mock_idf_usage(&u);
+    CHECK(u.live[MOCK_DRIVER] == 0, "driver left initialised by the AP alone");
+}
+
+static void sta_up(void)
+{
+    CHECK(wifi_conn_init(&s_sta) == ESP_OK, "wifi_conn_init failed");
+    CHECK(wifi_conn_wait_ip(IP_TIMEOUT_MS) == ESP_OK, "no IP");
+    uint32_t ip;
+    CHECK(wifi_conn_get_ipv4(&ip) && ip, "no IPv4 on the STA netif");
+    check_mode(WIFI_MODE_STA, true);
+    check_step(STEP_STA_UP);
+    mock_idf_totals(&s_totals_at_sta_up);
+}
+
+// app_runtime calls wifi_conn_init() on every try: nothing twice
+static void sta_again(void)
+{
+    CHECK(wifi_conn_init(&s_sta) == ESP_OK, "wifi_conn_init again failed");
+    CHECK(wifi_conn_wait_ip(IP_TIMEOUT_MS) == ESP_OK, "no IP after init again");
+    check_mode(WIFI_MODE_STA, true);
+    check_step(STEP_STA_AGAIN);
+}
+
+// provisioning_task(): the STA stops, the AP comes up on the same driver.
+// The stop comes while a join of new credentials still sets the driver up:
+// that join ends before wifi_conn_stop() returns, nothing joins after it
+static void ap_up(void)
+{
+    mock_wifi_set_config_delay(SLOW_JOIN_MS);
+    CHECK(wifi_conn_set_ssid_password("deepfocus", "password") == ESP_OK, "rejoin failed");
+    usleep(SLOW_JOIN_MS / 2 * 1000);
+    CHECK(wifi_conn_stop() == ESP_OK, "wifi_conn_stop failed");
+    mock_totals_t stopped, later;
+    mock_idf_totals(&stopped);
+    usleep(2 * SLOW_JOIN_MS * 1000);
+    mock_idf_settle();
+    mock_idf_totals(&later);
+    mock_wifi_set_config_delay(0);
+    CHECK(later.connect_calls == stopped.connect_calls, "%d joins after wifi_conn_stop() returned",
+          later.connect_calls - stopped.connect_calls);
+    CHECK(wifi_conn_get_state() == WIFI_CONN_STATE_IDLE, "STA not idle after stop");
+    CHECK(wifi_config_ap_init(&s_ap) == ESP_OK, "wifi_config_ap_init failed");
+    CHECK(ap_started(), "AP not started");
+    check_mode(WIFI_MODE_APSTA, true);
+    CHECK(scan_listed() == 3, "scan list not published");
+    foreign_scan();
+    check_step(STEP_AP_UP);
+}
+
+static void ap_again(void)
+{
+    s_ap.channel = s_ap.channel == 1 ? 6 : 1;
+    CHECK(wifi_config_ap_init(&s_ap) == ESP_OK, "wifi_config_ap_init again failed");
+    CHECK(ap_started(), "AP not started again");
+    check_mode(WIFI_MODE_APSTA, true);
+    check_step(STEP_AP_AGAIN);
+}
+
+static void both(void)
+{
+    CHECK(wifi_conn_start() == ESP_OK, "wifi_conn_start with the AP failed");
+    CHECK(wifi_conn_wait_ip(IP_TIMEOUT_MS) == ESP_OK, "no IP with the AP up");
+    check_mode(WIFI_MODE_APSTA, true);
+    check_step(STEP_BOTH);
+}
+
+// stop_ap_and_http() and try_sta_from_nvs(); with the STA up it keeps its link
+static void sta_back(bool sta_running)
+{
+    CHECK(wifi_config_ap_deinit() == ESP_OK, "wifi_config_ap_deinit failed");
+    CHECK(wifi_config_ap_get_netif() == NULL, "AP netif still handed out");
+    if (sta_running)
+    {
+        CHECK(wifi_conn_get_state() == WIFI_CONN_STATE_GOT_IP, "STA lost its link when the AP went");
+    }
+    else
+    {
+        CHECK(wifi_conn_init(&s_sta) == ESP_OK, "wifi_conn_init after the AP failed");
+    }
+    CHECK(wifi_conn_wait_ip(IP_TIMEOUT_MS) == ESP_OK, "no IP after the AP");
+    check_mode(WIFI_MODE_STA, true);
+    check_step(STEP_STA_BACK);
+
+    mock_totals_t t;
+    mock_idf_totals(&t);
+    CHECK(t.driver_inits == s_totals_at_sta_up.driver_inits, "driver initialised again while held");
+    CHECK(t.netifs_created == s_totals_at_sta_up.netifs_created + 1, "%d netifs created for one AP round",
+          t.netifs_created - s_totals_at_sta_up.netifs_created);
+}
+
+// All the way down; every third time in the middle of a backoff
+static void down(bool mid_backoff)
+{
+    if (mid_backoff)
+    {
+        // The access point goes: the cached join misses, the scan misses,
+        // and the supervisor waits out the backoff when it is torn down
+        mock_wifi_set_ap_present(false);
+        CHECK(wifi_conn_set_ssid_password("deepfocus", "password") == ESP_OK, "rejoin failed");
+        usleep(20 * 1000);
+        CHECK(wifi_conn_get_state() == WIFI_CONN_STATE_DISCONNECTED, "not in backoff");
+    }
+    CHECK(wifi_conn_deinit() == ESP_OK, "wifi_conn_deinit failed");
+    mock_wifi_set_ap_present(true);
+    CHECK(wifi_conn_deinit() == ESP_OK, "wifi_conn_deinit twice failed");
+    CHECK(wifi_conn_wait_ip(0) == ESP_ERR_INVALID_STATE, "wait_ip after deinit");
+    CHECK(wifi_conn_start() == ESP_ERR_INVALID_STATE, "start after deinit");
+    check_mode(WIFI_MODE_NULL, false);
+    check_step(STEP_DOWN);
+}
+
+static void cycle(void)
+{
+    const bool cold = s_cycle % 3 == 0;
+    if (cold)
+    {
+        ap_cold();
+        if (s_failures)
+            return;
+    }
+    sta_up();
+    if (!s_failures)
+        sta_again();
+    if (!s_failures)
+        ap_up();
+    if (!s_failures)
+        ap_again();
+    const bool with_sta = s_cycle % 2 == 1;
+    if (!s_failures && with_sta)
+        both();
+    if (!s_failures)
+        sta_back(with_sta);
+    if (!s_failures && s_cycle % 3 == 2)
+        down(s_cycle % 9 == 8);
+}
+
+// Nothing left but what stays for good
+static void check_at_rest(void)
+{
+    CHECK(wifi_config_ap_deinit() == ESP_OK, "wifi_config_ap_deinit failed");
+    CHECK(wifi_conn_deinit() == ESP_OK, "wifi_conn_deinit failed");
+    mock_usage_t u;
+    quiet_usage(&u);
+    print_usage(stdout, "left at rest", &u);
+    for (int k = 0; k < MOCK_KIND_COUNT; k++)
+    {
+        const int want = k == MOCK_MUTEX ? MUTEXES_FOR_GOOD : 0;
+        CHECK(u.live[k] == want, "%d %s left, expected %d", u.live[k], mock_kind_name((mock_kind_t)k), want);
+    }
+    CHECK(mock_idf_errors() == 0, "ESP-IDF misuse");
+}
+
+int main(int argc, char **argv)
+{
+    int cycles = 300;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            cycles = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-v"))
+            mock_idf_log_level = 2;
+        else
+        {
+            fprintf(stderr, "usage: %s [-n CYCLES] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (s_cycle = 0; s_cycle < cycles && !s_failures; s_cycle++)
+        cycle();
+    if (!s_failures)
+        check_at_rest();
+
+    mock_totals_t t;
+    mock_idf_totals(&t);
+    printf("%d cycles: %d mode changes, %d driver starts, %d inits and %d deinits; %d netifs, %d tasks and "
+           "%d handlers created; %d joins, %d scans\n",
+           s_cycle, t.mode_changes, t.driver_starts, t.driver_inits, t.driver_deinits, t.netifs_created,
+           t.tasks_created, t.handlers_registered, t.connects, t.scans);
+    for (int s = 0; s < STEP_COUNT; s++)
+        if (s_have[s])
+            print_usage(stdout, s_step_names[s], &s_at[s]);
+    printf("%d cases, %d failures\n", s_cases, s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include <stdint.h>
+
+typedef uint8_t dhcps_offer_t;
+#define OFFER_ROUTER 0x00
+#define OFFER_DNS 0x02
@@ -0,0 +1,16 @@
+#pragma once
+#include <stdio.h>
+
+// 0: errors, 1: and warnings, 2: everything
+extern int mock_idf_log_level;
+
+#define MOCK_IDF_LOG(lvl, c, tag, fmt, ...)                                  \
+    do                                                                       \
+    {                                                                        \
+        if (mock_idf_log_level >= (lvl))                                     \
+            fprintf(stderr, c " (%s) " fmt "\n", tag, ##__VA_ARGS__);        \
+    } while (0)
+#define ESP_LOGE(tag, fmt, ...) MOCK_IDF_LOG(0, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) MOCK_IDF_LOG(1, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) MOCK_IDF_LOG(2, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) MOCK_IDF_LOG(3, "D", tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t addr; // network order
+} esp_ip4_addr_t;
+
+#define ESP_IPADDR_TYPE_V4 0
+#define ESP_IPADDR_TYPE_V6 6
+
+typedef struct
+{
+    union
+    {
+        esp_ip4_addr_t ip4;
+    } u_addr;
+    uint8_t type;
+} esp_ip_addr_t;
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(a) ((const uint8_t *)(a))[0], ((const uint8_t *)(a))[1], ((const uint8_t *)(a))[2], ((const uint8_t *)(a))[3]
@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+#define IP4_ADDR(ipaddr, a, b, c, d)                                                              \
+    ((ipaddr)->addr = ((uint32_t)(a)) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
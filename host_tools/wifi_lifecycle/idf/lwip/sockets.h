@@ -0,0 +1,25 @@
+#pragma once
+// The BSD names map to the lwip_* calls, as with LWIP_COMPAT_SOCKETS; the
+// host versions count the sockets and never see a packet
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int lwip_socket(int domain, int type, int protocol);
+int lwip_bind(int s, const struct sockaddr *name, socklen_t namelen);
+int lwip_fcntl(int s, int cmd, int val);
+int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset, struct timeval *timeout);
+int lwip_recvfrom(int s, void *mem, size_t len, int flags, struct sockaddr *from, socklen_t *fromlen);
+int lwip_sendto(int s, const void *data, size_t size, int flags, const struct sockaddr *to, socklen_t tolen);
+int lwip_close(int s);
+
+#define socket(d, t, p) lwip_socket(d, t, p)
+#define bind(s, n, l) lwip_bind(s, n, l)
+#define fcntl(s, c, v) lwip_fcntl(s, c, v)
+#define select(m, r, w, e, t) lwip_select(m, r, w, e, t)
+#define recvfrom(s, m, l, f, fr, fl) lwip_recvfrom(s, m, l, f, fr, fl)
+#define sendto(s, d, sz, f, to, tl) lwip_sendto(s, d, sz, f, to, tl)
+#define close(s) lwip_close(s)
@@ -0,0 +1,20 @@
+#pragma once
+// Kconfig of the gateway, as far as wifi_connect and wifi_config_ap read it
+#define CONFIG_WIFI_CONN_SSID "deepfocus"
+#define CONFIG_WIFI_CONN_PASSWORD "password"
+#define CONFIG_WIFI_CONN_MAX_RETRY 5
+#define CONFIG_WIFI_CONN_FAST_RECONNECT 1
+#define CONFIG_WIFI_CONN_FAST_TRIES 1
+#define CONFIG_WIFI_CONN_REUSE_LEASE 1
+#define CONFIG_WIFI_CONN_BACKOFF_MIN_MS 1000
+#define CONFIG_WIFI_CONN_BACKOFF_MAX_MS 300000
+#define CONFIG_WIFI_CONN_FALLBACK_ROUNDS 3
+#define CONFIG_WIFI_CONN_AUTH_FALLBACK 3
+#define CONFIG_WIFI_CONFIG_AP_SSID "DeepFocus-Setup"
+#define CONFIG_WIFI_CONFIG_AP_PASSWORD ""
+#define CONFIG_WIFI_CONFIG_AP_CHANNEL 1
+#define CONFIG_WIFI_CONFIG_AP_MAX_CONNECTIONS 4
+#define CONFIG_WIFI_CONFIG_AP_SCAN 1
+#define CONFIG_WIFI_CONFIG_AP_SCAN_INTERVAL_S 30
+#define CONFIG_WIFI_CONFIG_AP_SCAN_MAX_APS 16
+#define CONFIG_WIFI_CONFIG_AP_CAPTIVE_DNS 1
@@ -0,0 +1,1557 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mock_idf.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "lwip/ip4_addr.h"
+#include "lwip/sockets.h"
+#include "nvs_flash.h"
+
+int mock_idf_log_level = 0;
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+/*========== Accounting ==========*/
+// About what ESP-IDF 5.5 takes from the heap for each
+#define TASK_TCB_BYTES 352
+#define QUEUE_BYTES 80
+#define EVENT_GROUP_BYTES 32
+#define MUTEX_BYTES 80
+#define TIMER_BYTES 56
+#define HANDLER_BYTES 32
+#define NETIF_BYTES 440
+#define SOCKET_BYTES 128
+#define NVS_HANDLE_BYTES 48
+#define DRIVER_BYTES 38000 // buffers and control blocks of esp_wifi_init()
+#define EVENT_BYTES 24
+
+#define OBJ_MAGIC 0x1D50B1EC
+#define OBJ_DEAD 0xDEADDEAD
+
+typedef struct
+{
+    uint32_t magic;
+    mock_kind_t kind;
+    long bytes;
+} obj_t;
+
+static pthread_mutex_t s_acct_lock = PTHREAD_MUTEX_INITIALIZER;
+static mock_usage_t s_usage;
+static mock_totals_t s_totals;
+static int s_errors;
+
+static const char *const s_kind_names[MOCK_KIND_COUNT] = {
+    "tasks",   "queues",      "event groups", "mutexes",      "timers", "event handlers",
+    "netifs",  "sockets",     "NVS handles",  "Wi-Fi driver", "scan records", "queued events",
+};
+
+const char *mock_kind_name(mock_kind_t kind)
+{
+    return kind < MOCK_KIND_COUNT ? s_kind_names[kind] : "?";
+}
+
+static void violation(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "IDF MISUSE: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    pthread_mutex_lock(&s_acct_lock);
+    s_errors++;
+    pthread_mutex_unlock(&s_acct_lock);
+}
+
+// `size` bytes of struct, `bytes` counted as heap
+static void *obj_new(mock_kind_t kind, size_t size, long bytes)
+{
+    obj_t *o = calloc(1, size);
+    if (!o)
+        abort();
+    o->magic = OBJ_MAGIC;
+    o->kind = kind;
+    o->bytes = bytes;
+    pthread_mutex_lock(&s_acct_lock);
+    s_usage.live[kind]++;
+    s_usage.heap += bytes;
+    pthread_mutex_unlock(&s_acct_lock);
+    return o;
+}
+
+static bool obj_alive(const void *p, mock_kind_t kind, const char *what)
+{
+    const obj_t *o = p;
+    if (!o)
+    {
+        violation("%s on a NULL %s", what, mock_kind_name(kind));
+        return false;
+    }
+    if (o->magic == OBJ_DEAD)
+    {
+        violation("%s on a deleted %s", what, mock_kind_name(kind));
+        return false;
+    }
+    if (o->magic != OBJ_MAGIC || o->kind != kind)
+    {
+        violation("%s on something that is no %s", what, mock_kind_name(kind));
+        return false;
+    }
+    return true;
+}
+
+// The memory stays, marked, so later uses are caught
+static void obj_delete(void *p)
+{
+    obj_t *o = p;
+    o->magic = OBJ_DEAD;
+    pthread_mutex_lock(&s_acct_lock);
+    s_usage.live[o->kind]--;
+    s_usage.heap -= o->bytes;
+    pthread_mutex_unlock(&s_acct_lock);
+}
+
+static void count(int *total)
+{
+    pthread_mutex_lock(&s_acct_lock);
+    (*total)++;
+    pthread_mutex_unlock(&s_acct_lock);
+}
+
+void mock_idf_usage(mock_usage_t *out)
+{
+    pthread_mutex_lock(&s_acct_lock);
+    *out = s_usage;
+    pthread_mutex_unlock(&s_acct_lock);
+}
+
+void mock_idf_totals(mock_totals_t *out)
+{
+    pthread_mutex_lock(&s_acct_lock);
+    *out = s_totals;
+    pthread_mutex_unlock(&s_acct_lock);
+}
+
+int mock_idf_errors(void)
+{
+    pthread_mutex_lock(&s_acct_lock);
+    const int n = s_errors;
+    pthread_mutex_unlock(&s_acct_lock);
+    return n;
+}
+
+/*========== Time ==========*/
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void cond_init(pthread_cond_t *c)
+{
+    pthread_condattr_t a;
+    pthread_condattr_init(&a);
+    pthread_condattr_setclock(&a, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &a);
+    pthread_condattr_destroy(&a);
+}
+
+static struct timespec deadline_us(int64_t at_us)
+{
+    return (struct timespec){.tv_sec = at_us / 1000000, .tv_nsec = (at_us % 1000000) * 1000};
+}
+
+// Waits on `c` until `ticks` (ms) are over; false on timeout
+static bool cond_wait_ticks(pthread_cond_t *c, pthread_mutex_t *m, int64_t until_us)
+{
+    if (until_us < 0)
+        return pthread_cond_wait(c, m) == 0;
+    const struct timespec ts = deadline_us(until_us);
+    return pthread_cond_timedwait(c, m, &ts) != ETIMEDOUT;
+}
+
+static int64_t until_us(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? -1 : esp_timer_get_time() + (int64_t)ticks * 1000;
+}
+
+/*========== Tasks ==========*/
+struct mock_task
+{
+    obj_t obj;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static __thread struct mock_task *t_self;
+
+static void *task_main(void *p)
+{
+    t_self = p;
+    t_self->fn(t_self->arg);
+    violation("task returned instead of vTaskDelete(NULL)");
+    obj_delete(t_self);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out)
+{
+    (void)name;
+    (void)prio;
+    struct mock_task *t = obj_new(MOCK_TASK, sizeof(*t), TASK_TCB_BYTES + (long)stack_depth);
+    t->fn = fn;
+    t->arg = arg;
+    if (out)
+        *out = t;
+    count(&s_totals.tasks_created);
+    pthread_t th;
+    pthread_attr_t a;
+    pthread_attr_init(&a);
+    pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+    const int rc = pthread_create(&th, &a, task_main, t);
+    pthread_attr_destroy(&a);
+    if (rc != 0)
+    {
+        obj_delete(t);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task || !t_self)
+    {
+        violation("vTaskDelete of another task");
+        return;
+    }
+    obj_delete(t_self);
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
+
+/*========== Queues ==========*/
+struct mock_queue
+{
+    obj_t obj;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t *items;
+    UBaseType_t len, size, head, n;
+    int waiters;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct mock_queue *q = obj_new(MOCK_QUEUE, sizeof(*q), QUEUE_BYTES + (long)(length * item_size));
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init(&q->changed);
+    q->items = calloc(length, item_size);
+    q->len = length;
+    q->size = item_size;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    if (!obj_alive(q, MOCK_QUEUE, "xQueueSend"))
+        return pdFAIL;
+    const int64_t until = until_us(ticks);
+    pthread_mutex_lock(&q->lock);
+    q->waiters++;
+    while (q->n == q->len)
+    {
+        if (ticks == 0 || !cond_wait_ticks(&q->changed, &q->lock, until))
+        {
+            q->waiters--;
+            pthread_mutex_unlock(&q->lock);
+            return pdFAIL;
+        }
+    }
+    q->waiters--;
+    memcpy(q->items + ((q->head + q->n) % q->len) * q->size, item, q->size);
+    q->n++;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    if (!obj_alive(q, MOCK_QUEUE, "xQueueReceive"))
+        return pdFAIL;
+    const int64_t until = until_us(ticks);
+    pthread_mutex_lock(&q->lock);
+    q->waiters++;
+    while (q->n == 0)
+    {
+        if (ticks == 0 || !cond_wait_ticks(&q->changed, &q->lock, until))
+        {
+            q->waiters--;
+            pthread_mutex_unlock(&q->lock);
+            return pdFAIL;
+        }
+    }
+    q->waiters--;
+    memcpy(item, q->items + q->head * q->size, q->size);
+    q->head = (q->head + 1) % q->len;
+    q->n--;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdPASS;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!obj_alive(q, MOCK_QUEUE, "vQueueDelete"))
+        return;
+    pthread_mutex_lock(&q->lock);
+    if (q->waiters)
+        violation("queue deleted with a task blocked on it");
+    free(q->items);
+    q->items = NULL;
+    pthread_mutex_unlock(&q->lock);
+    obj_delete(q);
+}
+
+/*========== Mutexes ==========*/
+struct mock_mutex
+{
+    obj_t obj;
+    pthread_mutex_t lock;
+    pthread_cond_t released;
+    bool held;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct mock_mutex *m = obj_new(MOCK_MUTEX, sizeof(*m), MUTEX_BYTES);
+    pthread_mutex_init(&m->lock, NULL);
+    cond_init(&m->released);
+    return m;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t ticks)
+{
+    if (!obj_alive(m, MOCK_MUTEX, "xSemaphoreTake"))
+        return pdFAIL;
+    const int64_t until = until_us(ticks);
+    pthread_mutex_lock(&m->lock);
+    while (m->held)
+    {
+        if (ticks == 0 || !cond_wait_ticks(&m->released, &m->lock, until))
+        {
+            pthread_mutex_unlock(&m->lock);
+            return pdFAIL;
+        }
+    }
+    m->held = true;
+    pthread_mutex_unlock(&m->lock);
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t m)
+{
+    if (!obj_alive(m, MOCK_MUTEX, "xSemaphoreGive"))
+        return pdFAIL;
+    pthread_mutex_lock(&m->lock);
+    const bool was = m->held;
+    m->held = false;
+    pthread_cond_signal(&m->released);
+    pthread_mutex_unlock(&m->lock);
+    return was ? pdPASS : pdFAIL;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t m)
+{
+    if (obj_alive(m, MOCK_MUTEX, "vSemaphoreDelete"))
+        obj_delete(m);
+}
+
+/*========== Event groups ==========*/
+struct mock_event_group
+{
+    obj_t obj;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+    int waiters;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct mock_event_group *eg = obj_new(MOCK_EVENT_GROUP, sizeof(*eg), EVENT_GROUP_BYTES);
+    pthread_mutex_init(&eg->lock, NULL);
+    cond_init(&eg->changed);
+    return eg;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t eg, EventBits_t bits)
+{
+    if (!obj_alive(eg, MOCK_EVENT_GROUP, "xEventGroupSetBits"))
+        return 0;
+    pthread_mutex_lock(&eg->lock);
+    eg->bits |= bits;
+    const EventBits_t now = eg->bits;
+    pthread_cond_broadcast(&eg->changed);
+    pthread_mutex_unlock(&eg->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t eg, EventBits_t bits)
+{
+    if (!obj_alive(eg, MOCK_EVENT_GROUP, "xEventGroupClearBits"))
+        return 0;
+    pthread_mutex_lock(&eg->lock);
+    const EventBits_t was = eg->bits;
+    eg->bits &= ~bits;
+    pthread_mutex_unlock(&eg->lock);
+    return was;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t eg, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    if (!obj_alive(eg, MOCK_EVENT_GROUP, "xEventGroupWaitBits"))
+        return 0;
+    const int64_t until = until_us(ticks);
+    pthread_mutex_lock(&eg->lock);
+    eg->waiters++;
+    for (;;)
+    {
+        const EventBits_t got = eg->bits & bits;
+        if (wait_for_all ? got == bits : got != 0)
+            break;
+        if (ticks == 0 || !cond_wait_ticks(&eg->changed, &eg->lock, until))
+            break;
+    }
+    eg->waiters--;
+    const EventBits_t now = eg->bits;
+    const EventBits_t got = now & bits;
+    if (clear_on_exit && (wait_for_all ? got == bits : got != 0))
+        eg->bits &= ~bits;
+    pthread_mutex_unlock(&eg->lock);
+    return now;
+}
+
+void vEventGroupDelete(EventGroupHandle_t eg)
+{
+    if (!obj_alive(eg, MOCK_EVENT_GROUP, "vEventGroupDelete"))
+        return;
+    pthread_mutex_lock(&eg->lock);
+    if (eg->waiters)
+        violation("event group deleted with a task blocked on it");
+    pthread_mutex_unlock(&eg->lock);
+    obj_delete(eg);
+}
+
+/*========== Default event loop ==========*/
+struct mock_handler
+{
+    obj_t obj;
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t fn;
+    void *arg;
+    struct mock_handler *next;
+};
+
+typedef struct event
+{
+    obj_t obj;
+    esp_event_base_t base;
+    int32_t id;
+    struct event *next;
+    uint8_t data[64];
+} event_t;
+
+static bool s_loop_up = false;
+// Held while handlers run: unregistering waits for a running handler, as in ESP-IDF
+static pthread_mutex_t s_handlers_lock;
+static struct mock_handler *s_handlers = NULL;
+static pthread_mutex_t s_post_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_posted;
+static pthread_cond_t s_idle;
+static event_t *s_ev_head = NULL, *s_ev_tail = NULL;
+static bool s_dispatching = false;
+
+static void *loop_main(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&s_post_lock);
+        while (!s_ev_head)
+            pthread_cond_wait(&s_posted, &s_post_lock);
+        event_t *ev = s_ev_head;
+        s_ev_head = ev->next;
+        if (!s_ev_head)
+            s_ev_tail = NULL;
+        s_dispatching = true;
+        pthread_mutex_unlock(&s_post_lock);
+
+        pthread_mutex_lock(&s_handlers_lock);
+        for (struct mock_handler *h = s_handlers; h; h = h->next)
+        {
+            if (h->obj.magic == OBJ_MAGIC && h->base == ev->base && (h->id == ESP_EVENT_ANY_ID || h->id == ev->id))
+                h->fn(h->arg, ev->base, ev->id, ev->data);
+        }
+        pthread_mutex_unlock(&s_handlers_lock);
+        obj_delete(ev);
+        free(ev);
+
+        pthread_mutex_lock(&s_post_lock);
+        s_dispatching = false;
+        if (!s_ev_head)
+            pthread_cond_broadcast(&s_idle);
+        pthread_mutex_unlock(&s_post_lock);
+    }
+    return NULL;
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    if (s_loop_up)
+        return ESP_ERR_INVALID_STATE;
+    pthread_mutexattr_t a;
+    pthread_mutexattr_init(&a);
+    pthread_mutexattr_settype(&a, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s_handlers_lock, &a);
+    pthread_mutexattr_destroy(&a);
+    cond_init(&s_posted);
+    cond_init(&s_idle);
+    pthread_t th;
+    if (pthread_create(&th, NULL, loop_main, NULL) != 0)
+        return ESP_ERR_NO_MEM;
+    pthread_detach(th);
+    s_loop_up = true;
+    return ESP_OK;
+}
+
+static void post(esp_event_base_t base, int32_t id, const void *data, size_t len)
+{
+    if (!s_loop_up)
+        return;
+    event_t *ev = obj_new(MOCK_EVENT, sizeof(*ev), EVENT_BYTES + (long)len);
+    ev->base = base;
+    ev->id = id;
+    if (len > sizeof(ev->data))
+        abort();
+    if (data)
+        memcpy(ev->data, data, len);
+    pthread_mutex_lock(&s_post_lock);
+    if (s_ev_tail)
+        s_ev_tail->next = ev;
+    else
+        s_ev_head = ev;
+    s_ev_tail = ev;
+    pthread_cond_signal(&s_posted);
+    pthread_mutex_unlock(&s_post_lock);
+}
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t len, uint32_t ticks)
+{
+    (void)ticks;
+    if (!s_loop_up)
+        return ESP_ERR_INVALID_STATE;
+    post(base, id, data, len);
+    return ESP_OK;
+}
+
+void mock_idf_settle(void)
+{
+    if (!s_loop_up)
+        return;
+    pthread_mutex_lock(&s_post_lock);
+    while (s_ev_head || s_dispatching)
+        pthread_cond_wait(&s_idle, &s_post_lock);
+    pthread_mutex_unlock(&s_post_lock);
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler,
+                                              void *arg, esp_event_handler_instance_t *instance)
+{
+    if (!s_loop_up)
+        return ESP_ERR_INVALID_STATE;
+    if (!handler || !instance)
+        return ESP_ERR_INVALID_ARG;
+    struct mock_handler *h = obj_new(MOCK_HANDLER, sizeof(*h), HANDLER_BYTES);
+    h->base = base;
+    h->id = id;
+    h->fn = handler;
+    h->arg = arg;
+    pthread_mutex_lock(&s_handlers_lock);
+    // Appended: they run in the order they were registered
+    struct mock_handler **p = &s_handlers;
+    while (*p)
+        p = &(*p)->next;
+    *p = h;
+    pthread_mutex_unlock(&s_handlers_lock);
+    count(&s_totals.handlers_registered);
+    *instance = h;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_unregister(esp_event_base_t base, int32_t id,
+                                                esp_event_handler_instance_t instance)
+{
+    if (!obj_alive(instance, MOCK_HANDLER, "esp_event_handler_instance_unregister"))
+        return ESP_ERR_INVALID_ARG;
+    if (instance->base != base || instance->id != id)
+    {
+        violation("handler unregistered with another base or id");
+        return ESP_ERR_NOT_FOUND;
+    }
+    pthread_mutex_lock(&s_handlers_lock);
+    // Marked only: a dispatch walking the list goes on past it
+    obj_delete(instance);
+    pthread_mutex_unlock(&s_handlers_lock);
+    return ESP_OK;
+}
+
+/*========== esp_timer ==========*/
+struct mock_timer
+{
+    obj_t obj;
+    esp_timer_cb_t cb;
+    void *arg;
+    bool armed;
+    int64_t due_us;
+    struct mock_timer *next;
+};
+
+static pthread_mutex_t s_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_timer_changed;
+static struct mock_timer *s_timers = NULL;
+static bool s_timer_task_up = false;
+
+static void *timer_main(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&s_timer_lock);
+    for (;;)
+    {
+        struct mock_timer *due = NULL;
+        for (struct mock_timer *t = s_timers; t; t = t->next)
+            if (t->obj.magic == OBJ_MAGIC && t->armed && (!due || t->due_us < due->due_us))
+                due = t;
+        if (!due)
+        {
+            pthread_cond_wait(&s_timer_changed, &s_timer_lock);
+            continue;
+        }
+        if (esp_timer_get_time() < due->due_us)
+        {
+            cond_wait_ticks(&s_timer_changed, &s_timer_lock, due->due_us);
+            continue;
+        }
+        due->armed = false;
+        pthread_mutex_unlock(&s_timer_lock);
+        due->cb(due->arg);
+        pthread_mutex_lock(&s_timer_lock);
+    }
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (!args || !args->callback || !out)
+        return ESP_ERR_INVALID_ARG;
+    struct mock_timer *t = obj_new(MOCK_TIMER, sizeof(*t), TIMER_BYTES);
+    t->cb = args->callback;
+    t->arg = args->arg;
+    pthread_mutex_lock(&s_timer_lock);
+    if (!s_timer_task_up)
+    {
+        cond_init(&s_timer_changed);
+        pthread_t th;
+        pthread_create(&th, NULL, timer_main, NULL);
+        pthread_detach(th);
+        s_timer_task_up = true;
+    }
+    t->next = s_timers;
+    s_timers = t;
+    pthread_mutex_unlock(&s_timer_lock);
+    *out = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us)
+{
+    if (!obj_alive(t, MOCK_TIMER, "esp_timer_start_once"))
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_timer_lock);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (!t->armed)
+    {
+        t->armed = true;
+        t->due_us = esp_timer_get_time() + (int64_t)timeout_us;
+        pthread_cond_signal(&s_timer_changed);
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_timer_lock);
+    return err;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    if (!obj_alive(t, MOCK_TIMER, "esp_timer_stop"))
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_timer_lock);
+    const esp_err_t err = t->armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    t->armed = false;
+    pthread_mutex_unlock(&s_timer_lock);
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t)
+{
+    if (!obj_alive(t, MOCK_TIMER, "esp_timer_delete"))
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_timer_lock);
+    esp_err_t err = ESP_OK;
+    if (t->armed)
+    {
+        // ESP-IDF refuses, and the timer stays for good
+        violation("esp_timer_delete of an armed timer");
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        struct mock_timer **p = &s_timers;
+        while (*p != t)
+            p = &(*p)->next;
+        *p = t->next;
+        obj_delete(t);
+    }
+    pthread_mutex_unlock(&s_timer_lock);
+    return err;
+}
+
+/*========== esp_netif ==========*/
+struct esp_netif_obj
+{
+    obj_t obj;
+    bool ap;
+    bool dhcpc, dhcps;
+    esp_netif_ip_info_t ip;
+    esp_netif_dns_info_t dns;
+};
+
+static bool s_netif_up = false;
+static esp_netif_t *s_default_netif[2]; // STA, AP
+static uint8_t s_next_host = 50;
+
+esp_err_t esp_netif_init(void)
+{
+    if (s_netif_up)
+        violation("esp_netif_init twice");
+    s_netif_up = true;
+    return ESP_OK;
+}
+
+static esp_netif_t *create_default(bool ap)
+{
+    if (!s_netif_up || !s_loop_up)
+    {
+        violation("default Wi-Fi netif before esp_netif_init() and the event loop");
+        return NULL;
+    }
+    if (s_default_netif[ap])
+    {
+        // ESP-IDF: "if_key already exists", NULL
+        violation("second default %s netif", ap ? "AP" : "STA");
+        return NULL;
+    }
+    esp_netif_t *n = obj_new(MOCK_NETIF, sizeof(*n), NETIF_BYTES);
+    n->ap = ap;
+    n->dhcpc = !ap;
+    if (ap)
+    {
+        IP4_ADDR(&n->ip.ip, 192, 168, 4, 1);
+        IP4_ADDR(&n->ip.gw, 192, 168, 4, 1);
+        IP4_ADDR(&n->ip.netmask, 255, 255, 255, 0);
+    }
+    s_default_netif[ap] = n;
+    count(&s_totals.netifs_created);
+    return n;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    return create_default(false);
+}
+
+esp_netif_t *esp_netif_create_default_wifi_ap(void)
+{
+    return create_default(true);
+}
+
+void esp_netif_destroy_default_wifi(void *esp_netif)
+{
+    esp_netif_t *n = esp_netif;
+    if (!obj_alive(n, MOCK_NETIF, "esp_netif_destroy_default_wifi"))
+        return;
+    s_default_netif[n->ap] = NULL;
+    obj_delete(n);
+}
+
+#define NETIF_OR_FAIL(n, what)                     \
+    do                                             \
+    {                                              \
+        if (!obj_alive(n, MOCK_NETIF, what))       \
+            return ESP_ERR_ESP_NETIF_INVALID_PARAMS; \
+    } while (0)
+
+esp_err_t esp_netif_dhcpc_start(esp_netif_t *n)
+{
+    NETIF_OR_FAIL(n, "esp_netif_dhcpc_start");
+    if (n->dhcpc)
+        return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED;
+    n->dhcpc = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *n)
+{
+    NETIF_OR_FAIL(n, "esp_netif_dhcpc_stop");
+    if (!n->dhcpc)
+        return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED;
+    n->dhcpc = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcps_start(esp_netif_t *n)
+{
+    NETIF_OR_FAIL(n, "esp_netif_dhcps_start");
+    if (n->dhcps)
+        return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED;
+    n->dhcps = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcps_stop(esp_netif_t *n)
+{
+    NETIF_OR_FAIL(n, "esp_netif_dhcps_stop");
+    if (!n->dhcps)
+        return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED;
+    n->dhcps = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcps_option(esp_netif_t *n, esp_netif_dhcp_option_mode_t op, esp_netif_dhcp_option_id_t id,
+                                 void *val, uint32_t len)
+{
+    (void)op;
+    (void)id;
+    (void)len;
+    NETIF_OR_FAIL(n, "esp_netif_dhcps_option");
+    return val ? ESP_OK : ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *n, const esp_netif_ip_info_t *ip)
+{
+    NETIF_OR_FAIL(n, "esp_netif_set_ip_info");
+    n->ip = *ip;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *n, esp_netif_ip_info_t *ip)
+{
+    NETIF_OR_FAIL(n, "esp_netif_get_ip_info");
+    *ip = n->ip;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t *n, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns)
+{
+    (void)type;
+    NETIF_OR_FAIL(n, "esp_netif_set_dns_info");
+    n->dns = *dns;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t *n, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns)
+{
+    (void)type;
+    NETIF_OR_FAIL(n, "esp_netif_get_dns_info");
+    *dns = n->dns;
+    return ESP_OK;
+}
+
+/*========== Wi-Fi driver ==========*/
+#define SCAN_APS 3
+
+typedef struct
+{
+    obj_t obj;
+    wifi_ap_record_t rec;
+} scan_record_t;
+
+static pthread_mutex_t s_drv_lock = PTHREAD_MUTEX_INITIALIZER;
+static obj_t *s_driver = NULL;
+static wifi_mode_t s_mode = WIFI_MODE_NULL;
+static bool s_started = false;
+static bool s_sta_connected = false;
+static bool s_ap_present = true;
+static volatile int s_set_config_delay_ms = 0;
+static wifi_config_t s_cfg[2];
+static scan_record_t *s_scan[SCAN_APS];
+static int s_scan_n = 0;
+static const uint8_t s_bssid[6] = {0x24, 0x0a, 0xc4, 0x11, 0x22, 0x33};
+
+void mock_wifi_set_ap_present(bool present)
+{
+    s_ap_present = present;
+}
+
+void mock_wifi_set_config_delay(int ms)
+{
+    s_set_config_delay_ms = ms;
+}
+
+wifi_mode_t mock_wifi_mode(bool *started)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    const wifi_mode_t m = s_mode;
+    if (started)
+        *started = s_started;
+    pthread_mutex_unlock(&s_drv_lock);
+    return m;
+}
+
+static void scan_free(void)
+{
+    for (int i = 0; i < s_scan_n; i++)
+    {
+        obj_delete(s_scan[i]);
+        free(s_scan[i]);
+    }
+    s_scan_n = 0;
+}
+
+static void sta_disconnected(uint8_t reason)
+{
+    wifi_event_sta_disconnected_t e = {.reason = reason};
+    memcpy(e.bssid, s_bssid, sizeof(e.bssid));
+    s_sta_connected = false;
+    post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &e, sizeof(e));
+}
+
+// Interfaces of `from` that are not in `to` stop, the new ones start
+static void interfaces(wifi_mode_t from, wifi_mode_t to)
+{
+    if ((from & WIFI_MODE_STA) && !(to & WIFI_MODE_STA))
+    {
+        if (s_sta_connected)
+            sta_disconnected(8); // ASSOC_LEAVE
+        post(WIFI_EVENT, WIFI_EVENT_STA_STOP, NULL, 0);
+    }
+    if ((from & WIFI_MODE_AP) && !(to & WIFI_MODE_AP))
+        post(WIFI_EVENT, WIFI_EVENT_AP_STOP, NULL, 0);
+    if (!(from & WIFI_MODE_STA) && (to & WIFI_MODE_STA))
+        post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0);
+    if (!(from & WIFI_MODE_AP) && (to & WIFI_MODE_AP))
+        post(WIFI_EVENT, WIFI_EVENT_AP_START, NULL, 0);
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    if (!config)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&s_drv_lock);
+    if (s_driver)
+    {
+        // A second set of buffers on the real one
+        violation("esp_wifi_init while initialised");
+        s_driver->bytes += DRIVER_BYTES;
+        pthread_mutex_lock(&s_acct_lock);
+        s_usage.heap += DRIVER_BYTES;
+        pthread_mutex_unlock(&s_acct_lock);
+    }
+    else
+    {
+        s_driver = obj_new(MOCK_DRIVER, sizeof(*s_driver), DRIVER_BYTES);
+    }
+    s_mode = WIFI_MODE_NULL;
+    pthread_mutex_unlock(&s_drv_lock);
+    count(&s_totals.driver_inits);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_deinit(void)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    esp_err_t err = ESP_OK;
+    if (!s_driver)
+    {
+        err = ESP_ERR_WIFI_NOT_INIT;
+    }
+    else if (s_started)
+    {
+        violation("esp_wifi_deinit while started");
+        err = ESP_ERR_WIFI_NOT_STOPPED;
+    }
+    else
+    {
+        scan_free();
+        obj_delete(s_driver);
+        free(s_driver);
+        s_driver = NULL;
+        s_mode = WIFI_MODE_NULL;
+    }
+    pthread_mutex_unlock(&s_drv_lock);
+    if (err == ESP_OK)
+        count(&s_totals.driver_deinits);
+    return err;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    esp_err_t err = ESP_OK;
+    if (!s_driver)
+        err = ESP_ERR_WIFI_NOT_INIT;
+    else if (mode > WIFI_MODE_APSTA)
+        err = ESP_ERR_INVALID_ARG;
+    if (err == ESP_OK && mode != s_mode)
+    {
+        if (s_started)
+        {
+            interfaces(s_mode, mode);
+            count(&s_totals.mode_changes);
+        }
+        s_mode = mode;
+    }
+    pthread_mutex_unlock(&s_drv_lock);
+    return err;
+}
+
+esp_err_t esp_wifi_get_mode(wifi_mode_t *mode)
+{
+    *mode = mock_wifi_mode(NULL);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t ifx, wifi_config_t *conf)
+{
+    if (ifx == WIFI_IF_STA && s_set_config_delay_ms)
+        usleep(s_set_config_delay_ms * 1000);
+    pthread_mutex_lock(&s_drv_lock);
+    esp_err_t err = ESP_OK;
+    if (!s_driver)
+        err = ESP_ERR_WIFI_NOT_INIT;
+    else if (!conf || ifx > WIFI_IF_AP)
+        err = ESP_ERR_INVALID_ARG;
+    else if (!(s_mode & (ifx == WIFI_IF_STA ? WIFI_MODE_STA : WIFI_MODE_AP)))
+        err = ESP_ERR_WIFI_MODE;
+    else
+        s_cfg[ifx] = *conf;
+    pthread_mutex_unlock(&s_drv_lock);
+    return err;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    esp_err_t err = ESP_OK;
+    if (!s_driver)
+        err = ESP_ERR_WIFI_NOT_INIT;
+    else if (s_mode == WIFI_MODE_NULL)
+        err = ESP_ERR_WIFI_MODE;
+    else if (!s_started)
+    {
+        interfaces(WIFI_MODE_NULL, s_mode);
+        s_started = true;
+        count(&s_totals.driver_starts);
+    }
+    pthread_mutex_unlock(&s_drv_lock);
+    return err;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    esp_err_t err = ESP_OK;
+    if (!s_driver)
+        err = ESP_ERR_WIFI_NOT_INIT;
+    else if (s_started)
+    {
+        interfaces(s_mode, WIFI_MODE_NULL);
+        s_started = false;
+        count(&s_totals.driver_stops);
+    }
+    pthread_mutex_unlock(&s_drv_lock);
+    return err;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    count(&s_totals.connect_calls);
+    esp_err_t err = ESP_OK;
+    if (!s_driver)
+        err = ESP_ERR_WIFI_NOT_INIT;
+    else if (!s_started)
+        err = ESP_ERR_WIFI_NOT_STARTED;
+    else if (!(s_mode & WIFI_MODE_STA))
+        err = ESP_ERR_WIFI_MODE;
+    if (err != ESP_OK)
+    {
+        pthread_mutex_unlock(&s_drv_lock);
+        return err;
+    }
+    count(&s_totals.connects);
+    if (s_sta_connected)
+        sta_disconnected(8);
+    esp_netif_t *n = s_default_netif[0];
+    if (!s_ap_present)
+    {
+        sta_disconnected(201); // NO_AP_FOUND
+    }
+    else
+    {
+        const wifi_sta_config_t *sta = &s_cfg[WIFI_IF_STA].sta;
+        wifi_event_sta_connected_t c = {.channel = 6, .authmode = sta->threshold.authmode};
+        memcpy(c.bssid, s_bssid, sizeof(c.bssid));
+        memcpy(c.ssid, sta->ssid, sizeof(c.ssid));
+        c.ssid_len = (uint8_t)strnlen((const char *)sta->ssid, sizeof(sta->ssid));
+        s_sta_connected = true;
+        post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &c, sizeof(c));
+        if (n && n->obj.magic == OBJ_MAGIC)
+        {
+            if (n->dhcpc)
+            {
+                // A lease from the DHCP server of the access point
+                IP4_ADDR(&n->ip.ip, 192, 168, 1, s_next_host);
+                IP4_ADDR(&n->ip.gw, 192, 168, 1, 1);
+                IP4_ADDR(&n->ip.netmask, 255, 255, 255, 0);
+                IP4_ADDR(&n->dns.ip.u_addr.ip4, 192, 168, 1, 1);
+                n->dns.ip.type = ESP_IPADDR_TYPE_V4;
+            }
+            const ip_event_got_ip_t ip = {.esp_netif = n, .ip_info = n->ip};
+            post(IP_EVENT, IP_EVENT_STA_GOT_IP, &ip, sizeof(ip));
+        }
+    }
+    pthread_mutex_unlock(&s_drv_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    esp_err_t err = ESP_OK;
+    if (!s_driver)
+        err = ESP_ERR_WIFI_NOT_INIT;
+    else if (!s_started)
+        err = ESP_ERR_WIFI_NOT_STARTED;
+    else if (s_sta_connected)
+        sta_disconnected(8);
+    pthread_mutex_unlock(&s_drv_lock);
+    return err;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block)
+{
+    (void)config;
+    (void)block;
+    pthread_mutex_lock(&s_drv_lock);
+    esp_err_t err = ESP_OK;
+    if (!s_driver)
+        err = ESP_ERR_WIFI_NOT_INIT;
+    else if (!s_started)
+        err = ESP_ERR_WIFI_NOT_STARTED;
+    else if (!(s_mode & WIFI_MODE_STA))
+        err = ESP_ERR_WIFI_MODE;
+    if (err == ESP_OK)
+    {
+        // The list of the last scan goes with a new one
+        scan_free();
+        static const char *const names[SCAN_APS] = {"deepfocus", "neighbours", "cafe"};
+        for (int i = 0; i < SCAN_APS; i++)
+        {
+            scan_record_t *r = obj_new(MOCK_SCAN_RECORD, sizeof(*r), sizeof(r->rec) + 16);
+            strncpy((char *)r->rec.ssid, names[i], sizeof(r->rec.ssid) - 1);
+            r->rec.primary = (uint8_t)(1 + 5 * i);
+            r->rec.rssi = (int8_t)(-40 - 10 * i);
+            r->rec.authmode = i == 2 ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+            s_scan[s_scan_n++] = r;
+        }
+        count(&s_totals.scans);
+        const wifi_event_sta_scan_done_t done = {.status = 0, .number = SCAN_APS};
+        post(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &done, sizeof(done));
+    }
+    pthread_mutex_unlock(&s_drv_lock);
+    return err;
+}
+
+esp_err_t esp_wifi_scan_get_ap_record(wifi_ap_record_t *ap_record)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    esp_err_t err = ESP_FAIL;
+    if (s_scan_n > 0)
+    {
+        // Handed out from the front and freed, like the driver does
+        scan_record_t *r = s_scan[0];
+        *ap_record = r->rec;
+        memmove(&s_scan[0], &s_scan[1], (size_t)(s_scan_n - 1) * sizeof(s_scan[0]));
+        s_scan_n--;
+        obj_delete(r);
+        free(r);
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_drv_lock);
+    return err;
+}
+
+esp_err_t esp_wifi_clear_ap_list(void)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    scan_free();
+    pthread_mutex_unlock(&s_drv_lock);
+    return ESP_OK;
+}
+
+/*========== lwIP sockets ==========*/
+#define MAX_SOCKETS 8
+#define FIRST_FD 54 // after lwIP's reserved ones
+
+typedef struct
+{
+    obj_t obj;
+    int port;
+} sock_t;
+
+static pthread_mutex_t s_sock_lock = PTHREAD_MUTEX_INITIALIZER;
+static sock_t *s_socks[MAX_SOCKETS];
+
+static sock_t *sock_get(int s)
+{
+    if (s < FIRST_FD || s >= FIRST_FD + MAX_SOCKETS || !s_socks[s - FIRST_FD])
+    {
+        errno = EBADF;
+        return NULL;
+    }
+    return s_socks[s - FIRST_FD];
+}
+
+int lwip_socket(int domain, int type, int protocol)
+{
+    (void)domain;
+    (void)type;
+    (void)protocol;
+    pthread_mutex_lock(&s_sock_lock);
+    int fd = -1;
+    for (int i = 0; i < MAX_SOCKETS && fd < 0; i++)
+    {
+        if (!s_socks[i])
+        {
+            s_socks[i] = obj_new(MOCK_SOCKET, sizeof(sock_t), SOCKET_BYTES);
+            fd = FIRST_FD + i;
+        }
+    }
+    pthread_mutex_unlock(&s_sock_lock);
+    if (fd < 0)
+        errno = ENFILE;
+    return fd;
+}
+
+int lwip_bind(int s, const struct sockaddr *name, socklen_t namelen)
+{
+    (void)namelen;
+    const int port = ntohs(((const struct sockaddr_in *)name)->sin_port);
+    pthread_mutex_lock(&s_sock_lock);
+    sock_t *me = sock_get(s);
+    int rc = me ? 0 : -1;
+    for (int i = 0; i < MAX_SOCKETS && me; i++)
+    {
+        if (s_socks[i] && s_socks[i] != me && s_socks[i]->port == port)
+        {
+            errno = EADDRINUSE;
+            rc = -1;
+        }
+    }
+    if (rc == 0)
+        me->port = port;
+    pthread_mutex_unlock(&s_sock_lock);
+    return rc;
+}
+
+int lwip_fcntl(int s, int cmd, int val)
+{
+    (void)cmd;
+    (void)val;
+    pthread_mutex_lock(&s_sock_lock);
+    const int rc = sock_get(s) ? 0 : -1;
+    pthread_mutex_unlock(&s_sock_lock);
+    return rc;
+}
+
+int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset, struct timeval *timeout)
+{
+    (void)maxfdp1;
+    (void)readset;
+    (void)writeset;
+    (void)exceptset;
+    (void)timeout;
+    // No client ever asks; back early so stops do not wait out the poll
+    usleep(1000);
+    return 0;
+}
+
+int lwip_recvfrom(int s, void *mem, size_t len, int flags, struct sockaddr *from, socklen_t *fromlen)
+{
+    (void)s;
+    (void)mem;
+    (void)len;
+    (void)flags;
+    (void)from;
+    (void)fromlen;
+    errno = EWOULDBLOCK;
+    return -1;
+}
+
+int lwip_sendto(int s, const void *data, size_t size, int flags, const struct sockaddr *to, socklen_t tolen)
+{
+    (void)s;
+    (void)data;
+    (void)flags;
+    (void)to;
+    (void)tolen;
+    return (int)size;
+}
+
+int lwip_close(int s)
+{
+    pthread_mutex_lock(&s_sock_lock);
+    sock_t *me = sock_get(s);
+    if (me)
+    {
+        obj_delete(me);
+        free(me);
+        s_socks[s - FIRST_FD] = NULL;
+    }
+    pthread_mutex_unlock(&s_sock_lock);
+    return me ? 0 : -1;
+}
+
+/*========== NVS ==========*/
+#define NVS_ENTRIES 8
+#define NVS_BLOB_MAX 128
+#define MAX_NVS_HANDLES 8
+
+typedef struct
+{
+    char key[32]; // namespace/key
+    uint8_t blob[NVS_BLOB_MAX];
+    size_t len;
+} nvs_entry_t;
+
+typedef struct
+{
+    obj_t obj;
+    char ns[16];
+    bool rw;
+} nvs_open_t;
+
+static pthread_mutex_t s_nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool s_nvs_up = false;
+static nvs_entry_t s_nvs[NVS_ENTRIES];
+static nvs_open_t *s_nvs_handles[MAX_NVS_HANDLES];
+
+esp_err_t nvs_flash_init(void)
+{
+    s_nvs_up = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    memset(s_nvs, 0, sizeof(s_nvs));
+    pthread_mutex_unlock(&s_nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    if (!s_nvs_up)
+        return ESP_ERR_INVALID_STATE;
+    pthread_mutex_lock(&s_nvs_lock);
+    esp_err_t err = ESP_ERR_NO_MEM;
+    for (int i = 0; i < MAX_NVS_HANDLES; i++)
+    {
+        if (!s_nvs_handles[i])
+        {
+            nvs_open_t *h = obj_new(MOCK_NVS_HANDLE, sizeof(*h), NVS_HANDLE_BYTES);
+            strncpy(h->ns, ns, sizeof(h->ns) - 1);
+            h->rw = mode == NVS_READWRITE;
+            s_nvs_handles[i] = h;
+            *out = (nvs_handle_t)(i + 1);
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+static nvs_open_t *nvs_get(nvs_handle_t h)
+{
+    return h >= 1 && h <= MAX_NVS_HANDLES ? s_nvs_handles[h - 1] : NULL;
+}
+
+static nvs_entry_t *nvs_find(const nvs_open_t *h, const char *key, bool create)
+{
+    char full[32];
+    snprintf(full, sizeof(full), "%s/%s", h->ns, key);
+    nvs_entry_t *free_slot = NULL;
+    for (int i = 0; i < NVS_ENTRIES; i++)
+    {
+        if (strcmp(s_nvs[i].key, full) == 0)
+            return &s_nvs[i];
+        if (!s_nvs[i].key[0] && !free_slot)
+            free_slot = &s_nvs[i];
+    }
+    if (create && free_slot)
+        strcpy(free_slot->key, full);
+    return create ? free_slot : NULL;
+}
+
+void nvs_close(nvs_handle_t h)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    nvs_open_t *o = nvs_get(h);
+    if (o)
+    {
+        obj_delete(o);
+        free(o);
+        s_nvs_handles[h - 1] = NULL;
+    }
+    else
+    {
+        violation("nvs_close of a closed handle");
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    const esp_err_t err = nvs_get(h) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    esp_err_t err = ESP_ERR_NVS_INVALID_HANDLE;
+    const nvs_open_t *o = nvs_get(h);
+    if (o)
+    {
+        const nvs_entry_t *e = nvs_find(o, key, false);
+        if (!e)
+            err = ESP_ERR_NVS_NOT_FOUND;
+        else if (out && *len < e->len)
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        else
+        {
+            if (out)
+                memcpy(out, e->blob, e->len);
+            *len = e->len;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *val, size_t len)
+{
+    pthread_mutex_lock(&s_nvs_lock);
+    esp_err_t err = ESP_ERR_NVS_INVALID_HANDLE;
+    const nvs_open_t *o = nvs_get(h);
+    if (o && o->rw)
+    {
+        nvs_entry_t *e = nvs_find(o, key, true);
+        if (!e || len > NVS_BLOB_MAX)
+            err = ESP_ERR_NO_MEM;
+        else
+        {
+            memcpy(e->blob, val, len);
+            e->len = len;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+/*========== Misc ==========*/
+uint32_t esp_random(void)
+{
+    static uint32_t x = 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_WIFI_NOT_INIT:
+        return "ESP_ERR_WIFI_NOT_INIT";
+    case ESP_ERR_WIFI_NOT_STARTED:
+        return "ESP_ERR_WIFI_NOT_STARTED";
+    case ESP_ERR_WIFI_NOT_STOPPED:
+        return "ESP_ERR_WIFI_NOT_STOPPED";
+    case ESP_ERR_WIFI_MODE:
+        return "ESP_ERR_WIFI_MODE";
+    default:
+        return "ERROR";
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+// Host stand-ins for the parts of ESP-IDF that wifi_stack, wifi_connect and
+// wifi_config_ap use (idf/ has the headers): FreeRTOS on pthreads, a default
+// event loop with its own dispatch thread, esp_timer, esp_netif, NVS, lwIP
+// sockets and a Wi-Fi driver that posts the events the real one posts.
+//
+// Every handle they hand out is counted with about the heap ESP-IDF takes
+// for it, and is never really freed: a deleted handle stays behind, marked,
+// so a use after delete is caught. Calls the real ESP-IDF would refuse or
+// that leak there (esp_wifi_init twice, a second default STA netif,
+// esp_wifi_deinit while started, deleting an armed timer, ...) count as
+// errors and are logged where they happen.
+#include <stdbool.h>
+
+#include "esp_wifi.h"
+
+typedef enum
+{
+    MOCK_TASK = 0,
+    MOCK_QUEUE,
+    MOCK_EVENT_GROUP,
+    MOCK_MUTEX,
+    MOCK_TIMER,
+    MOCK_HANDLER,
+    MOCK_NETIF,
+    MOCK_SOCKET,
+    MOCK_NVS_HANDLE,
+    MOCK_DRIVER,
+    MOCK_SCAN_RECORD,
+    MOCK_EVENT, // posted, not dispatched yet
+    MOCK_KIND_COUNT,
+} mock_kind_t;
+
+typedef struct
+{
+    int live[MOCK_KIND_COUNT];
+    long heap; // bytes of all live handles
+} mock_usage_t;
+
+typedef struct
+{
+    int driver_inits;
+    int driver_deinits;
+    int driver_starts;
+    int driver_stops;
+    int mode_changes; // esp_wifi_set_mode() on a started driver
+    int netifs_created;
+    int tasks_created;
+    int handlers_registered;
+    int connects;
+    int connect_calls; // esp_wifi_connect(), refused ones too
+    int scans;
+} mock_totals_t;
+
+const char *mock_kind_name(mock_kind_t kind);
+
+// Waits until the event loop has dispatched everything posted so far
+void mock_idf_settle(void);
+
+void mock_idf_usage(mock_usage_t *out);
+void mock_idf_totals(mock_totals_t *out);
+int mock_idf_errors(void);
+
+wifi_mode_t mock_wifi_mode(bool *started);
+
+// Whether the STA finds the access point (default: yes)
+void mock_wifi_set_ap_present(bool present);
+
+// How long esp_wifi_set_config() takes for the STA (default: 0), to widen
+// the time between a join's decision and its esp_wifi_connect()
+void mock_wifi_set_config_delay(int ms);
@@ -0,0 +1,473 @@
+// wifi_scan_list_check: host checks of the provisioning AP's scan list and
+// its /scan.json entries
+// (firmware/esp_idf_shared_components/wifi_config_ap/src/wifi_scan_list.c).
+//
+//   wifi_scan_list_check [-n ROUNDS] [-s SEED]
+//
+// Fixed cases first: the BSSs of one SSID keep only the strongest (its
+// channel and auth with it), the list stays strongest first, a full list
+// drops the weakest for a stronger BSS and refuses a weaker one, hidden,
+// too long and ill-formed UTF-8 SSIDs (overlong forms, surrogates, past
+// U+10FFFF, cut sequences, NULs) are rejected while 4-byte characters pass,
+// and the JSON escapes `"`, `\` and control bytes, fits the worst SSID in
+// WIFI_SCAN_AP_JSON_MAX and returns 0 when it does not fit. Then ROUNDS
+// (20000) random scans of up to 40 BSSs against a naive model of the list,
+// every entry's JSON read back to its SSID. Exits non-zero on failure.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wifi_scan_list.h"
+
+#define CAP_MAX 16
+
+static int s_cases = 0;
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                          \
+    do                                                                                                            \
+    {                                                                                                             \
+        if (!(cond))                                                                                              \
+        {                                                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                                                  \
+            fprintf(stderr, __VA_ARGS__);                                                                         \
+            fputc('\n', stderr);                                                                                  \
+            s_failures++;                                                                                         \
+            return;                                                                                               \
+        }                                                                                                         \
+    } while (0)
+
+static bool add(wifi_scan_list_t *l, const char *ssid, int8_t rssi, uint8_t channel, const char *auth)
+{
+    return wifi_scan_list_add(l, (const uint8_t *)ssid, strlen(ssid), rssi, channel, auth);
+}
+
+static bool add_bytes(wifi_scan_list_t *l, const char *ssid, size_t len)
+{
+    return wifi_scan_list_add(l, (const uint8_t *)ssid, len, -50, 1, "wpa2");
+}
+
+// "a b c": the SSIDs of the list in order
+static void names(const wifi_scan_list_t *l, char *out, size_t cap)
+{
+    size_t o = 0;
+    out[0] = 0;
+    for (size_t i = 0; i < l->n && o < cap; i++)
+        o += (size_t)snprintf(out + o, cap - o, "%s%s", i ? " " : "", l->aps[i].ssid);
+}
+
+/*========== Fixed cases ==========*/
+static void check_dedupe(void)
+{
+    s_cases++;
+    wifi_scan_ap_t aps[8];
+    wifi_scan_list_t l;
+    wifi_scan_list_init(&l, aps, 8);
+    // A mesh: three nodes of one SSID, a dual-band router of another
+    CHECK(add(&l, "mesh", -70, 1, "wpa2"), "first BSS dropped");
+    CHECK(add(&l, "home", -65, 6, "wpa2"), "other SSID dropped");
+    CHECK(add(&l, "mesh", -52, 11, "wpa3"), "stronger BSS dropped");
+    CHECK(!add(&l, "mesh", -60, 6, "wpa2"), "weaker BSS kept");
+    CHECK(!add(&l, "mesh", -52, 1, "open"), "as strong BSS kept");
+    CHECK(add(&l, "home", -40, 36, "wpa2"), "stronger band dropped");
+    char got[128];
+    names(&l, got, sizeof(got));
+    CHECK(l.n == 2 && !strcmp(got, "home mesh"), "list \"%s\"", got);
+    CHECK(aps[0].rssi == -40 && aps[0].channel == 36, "home %d on %u", aps[0].rssi, aps[0].channel);
+    CHECK(aps[1].rssi == -52 && aps[1].channel == 11 && !strcmp(aps[1].auth, "wpa3"), "mesh %d on %u, %s",
+          aps[1].rssi, aps[1].channel, aps[1].auth);
+
+    // Prefixes and case are other SSIDs
+    CHECK(add(&l, "mes", -80, 1, "open") && add(&l, "Mesh", -81, 1, "open") && add(&l, "mesh2", -82, 1, "open"),
+          "SSID sharing a prefix dropped");
+    CHECK(l.n == 5, "%zu entries", l.n);
+}
+
+static void check_order(void)
+{
+    s_cases++;
+    wifi_scan_ap_t aps[8];
+    wifi_scan_list_t l;
+    wifi_scan_list_init(&l, aps, 8);
+    static const int8_t rssi[] = {-70, -30, -90, -50, -50, -10, -60};
+    for (size_t i = 0; i < sizeof(rssi); i++)
+    {
+        char ssid[8];
+        snprintf(ssid, sizeof(ssid), "n%zu", i);
+        CHECK(add(&l, ssid, rssi[i], 1, "open"), "%s dropped", ssid);
+    }
+    char got[128];
+    names(&l, got, sizeof(got));
+    // Equal signals keep the order they were heard in
+    CHECK(!strcmp(got, "n5 n1 n3 n4 n6 n0 n2"), "list \"%s\"", got);
+
+    // A stronger BSS of n2 moves it up, behind the one it ties with
+    CHECK(add(&l, "n2", -50, 1, "open"), "stronger n2 dropped");
+    names(&l, got, sizeof(got));
+    CHECK(!strcmp(got, "n5 n1 n3 n4 n2 n6 n0"), "list \"%s\"", got);
+}
+
+static void check_cap(void)
+{
+    s_cases++;
+    wifi_scan_ap_t aps[3];
+    wifi_scan_list_t l;
+    wifi_scan_list_init(&l, aps, 3);
+    CHECK(add(&l, "a", -40, 1, "open") && add(&l, "b", -60, 1, "open") && add(&l, "c", -80, 1, "open"), "fill");
+    CHECK(!add(&l, "d", -90, 1, "open"), "weaker than a full list kept");
+    CHECK(!add(&l, "d", -80, 1, "open"), "as weak as the weakest of a full list kept");
+    CHECK(add(&l, "e", -50, 1, "open"), "stronger than the weakest dropped");
+    char got[64];
+    names(&l, got, sizeof(got));
+    CHECK(l.n == 3 && !strcmp(got, "a e b"), "list \"%s\"", got);
+
+    // A stronger BSS of a listed SSID replaces it and evicts nothing
+    CHECK(add(&l, "b", -30, 1, "open"), "stronger b dropped");
+    names(&l, got, sizeof(got));
+    CHECK(l.n == 3 && !strcmp(got, "b a e"), "list \"%s\"", got);
+
+    // The evicted one comes back when strong enough
+    CHECK(add(&l, "c", -45, 1, "open"), "c dropped");
+    names(&l, got, sizeof(got));
+    CHECK(!strcmp(got, "b a c"), "list \"%s\"", got);
+
+    wifi_scan_list_t none;
+    wifi_scan_list_init(&none, aps, 0);
+    CHECK(!add(&none, "a", 0, 1, "open") && none.n == 0, "empty list took an entry");
+}
+
+static void check_reject(void)
+{
+    static const struct
+    {
+        const char *ssid;
+        size_t len;
+        bool ok;
+    } table[] = {
+        {"", 0, false},                                  // hidden
+        {"abcdefghijklmnopqrstuvwxyz012345", 32, true},  // longest
+        {"abcdefghijklmnopqrstuvwxyz0123456", 33, false}, // longer than 802.11 allows
+        {"a\0b", 3, false},                              // NUL
+        {"\x80", 1, false},                              // lone continuation
+        {"\xC0\xAF", 2, false},                          // overlong '/'
+        {"\xC1\xBF", 2, false},                          // overlong
+        {"\xC3\xA9t\xC3\xA9", 5, true},                  // été
+        {"\xC3", 1, false},                              // cut
+        {"\xC3(", 2, false},                             // no continuation
+        {"\xE0\x80\xAF", 3, false},                      // overlong
+        {"\xE0\xA0\x80", 3, true},                       // U+0800
+        {"\xE2\x82\xAC", 3, true},                       // €
+        {"\xE2\x82", 2, false},                          // cut
+        {"\xE2\x28\xAC", 3, false},                      // bad second byte
+        {"\xE2\x82\x28", 3, false},                      // bad third byte
+        {"\xED\x9F\xBF", 3, true},                       // U+D7FF
+        {"\xED\xA0\x80", 3, false},                      // surrogate U+D800
+        {"\xED\xBF\xBF", 3, false},                      // surrogate U+DFFF
+        {"\xEF\xBF\xBF", 3, true},                       // U+FFFF
+        {"\xF0\x80\x80\xAF", 4, false},                  // overlong
+        {"\xF0\x9F\x93\xB6", 4, true},                   // 📶
+        {"\xF0\x9F\x93", 3, false},                      // cut
+        {"\xF4\x8F\xBF\xBF", 4, true},                   // U+10FFFF
+        {"\xF4\x90\x80\x80", 4, false},                  // past U+10FFFF
+        {"\xF5\x80\x80\x80", 4, false},                  // never a lead byte
+        {"\xFF", 1, false},
+        {"\x01\x1F\x7F", 3, true}, // control bytes: valid, escaped in the JSON
+    };
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        s_cases++;
+        wifi_scan_ap_t aps[2];
+        wifi_scan_list_t l;
+        wifi_scan_list_init(&l, aps, 2);
+        const bool ok = add_bytes(&l, table[i].ssid, table[i].len);
+        CHECK(ok == table[i].ok && l.n == (ok ? 1u : 0u), "case %zu: %s", i, ok ? "kept" : "dropped");
+        if (ok)
+            CHECK(strlen(aps[0].ssid) == table[i].len && !memcmp(aps[0].ssid, table[i].ssid, table[i].len),
+                  "case %zu: SSID changed", i);
+    }
+}
+
+static void check_json(void)
+{
+    static const struct
+    {
+        const char *ssid;
+        const char *want;
+    } table[] = {
+        {"home", "{\"ssid\":\"home\",\"rssi\":-61,\"ch\":11,\"auth\":\"wpa2\"}"},
+        {"say \"hi\"", "{\"ssid\":\"say \\\"hi\\\"\",\"rssi\":-61,\"ch\":11,\"auth\":\"wpa2\"}"},
+        {"a\\b", "{\"ssid\":\"a\\\\b\",\"rssi\":-61,\"ch\":11,\"auth\":\"wpa2\"}"},
+        {"\t\n\x01\x1F\x7F", "{\"ssid\":\"\\u0009\\u000a\\u0001\\u001f\\u007f\",\"rssi\":-61,\"ch\":11,\"auth\":\"wpa2\"}"},
+        {"</script>", "{\"ssid\":\"</script>\",\"rssi\":-61,\"ch\":11,\"auth\":\"wpa2\"}"},
+        {"caf\xC3\xA9 \xF0\x9F\x93\xB6", "{\"ssid\":\"caf\xC3\xA9 \xF0\x9F\x93\xB6\",\"rssi\":-61,\"ch\":11,\"auth\":\"wpa2\"}"},
+    };
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    {
+        s_cases++;
+        wifi_scan_ap_t ap = {.rssi = -61, .channel = 11, .auth = "wpa2"};
+        snprintf(ap.ssid, sizeof(ap.ssid), "%s", table[i].ssid);
+        char out[WIFI_SCAN_AP_JSON_MAX];
+        const size_t n = wifi_scan_ap_json(&ap, out, sizeof(out));
+        CHECK(n == strlen(table[i].want) && !strcmp(out, table[i].want), "case %zu: %s", i, n ? out : "(none)");
+    }
+
+    s_cases++;
+    // The worst SSID: 32 bytes of \u00XX, the longest numbers
+    wifi_scan_ap_t ap = {.rssi = -128, .channel = 255, .auth = NULL};
+    memset(ap.ssid, 0x01, 32);
+    ap.ssid[32] = 0;
+    char out[WIFI_SCAN_AP_JSON_MAX + 1];
+    const size_t n = wifi_scan_ap_json(&ap, out, WIFI_SCAN_AP_JSON_MAX);
+    CHECK(n > 32 * 6 && n < WIFI_SCAN_AP_JSON_MAX, "worst SSID: %zu bytes", n);
+    CHECK(strstr(out, "\"rssi\":-128,\"ch\":255,\"auth\":\"other\"}"), "worst SSID: %s", out);
+    CHECK(wifi_scan_ap_json(&ap, out, n + 1) == n, "exact room refused");
+    CHECK(wifi_scan_ap_json(&ap, out, n) == 0, "no room for the NUL accepted");
+    CHECK(wifi_scan_ap_json(&ap, out, 0) == 0, "no room at all accepted");
+}
+
+/*========== Random scans ==========*/
+typedef struct
+{
+    char ssid[33];
+    int8_t rssi;
+    uint8_t channel;
+    unsigned seq; // when it was heard: ties keep it
+} model_ap_t;
+
+// By code points, independently of the firmware's byte ranges
+static bool model_valid(const uint8_t *s, size_t n)
+{
+    for (size_t i = 0; i < n;)
+    {
+        const uint8_t c = s[i];
+        size_t len;
+        uint32_t cp, min;
+        if (c == 0)
+            return false;
+        if (c < 0x80)
+        {
+            i++;
+            continue;
+        }
+        if ((c & 0xE0) == 0xC0)
+            len = 2, cp = c & 0x1F, min = 0x80;
+        else if ((c & 0xF0) == 0xE0)
+            len = 3, cp = c & 0x0F, min = 0x800;
+        else if ((c & 0xF8) == 0xF0)
+            len = 4, cp = c & 0x07, min = 0x10000;
+        else
+            return false;
+        if (i + len > n)
+            return false;
+        for (size_t k = 1; k < len; k++)
+        {
+            if ((s[i + k] & 0xC0) != 0x80)
+                return false;
+            cp = cp << 6 | (s[i + k] & 0x3F);
+        }
+        if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            return false;
+        i += len;
+    }
+    return true;
+}
+
+// Drops a duplicate no stronger, sorts the new one in behind its equals
+// and cuts the list at `cap`: kept if it is still there
+static bool model_add(model_ap_t *m, size_t *n, size_t cap, const uint8_t *ssid, size_t len, int8_t rssi,
+                      uint8_t channel, unsigned seq)
+{
+    if (len == 0 || len > 32 || !model_valid(ssid, len))
+        return false;
+    for (size_t i = 0; i < *n; i++)
+    {
+        if (strlen(m[i].ssid) == len && !memcmp(m[i].ssid, ssid, len))
+        {
+            if (rssi <= m[i].rssi)
+                return false;
+            m[i] = m[--*n];
+            break;
+        }
+    }
+    model_ap_t e = {.rssi = rssi, .channel = channel, .seq = seq};
+    memcpy(e.ssid, ssid, len);
+    m[(*n)++] = e;
+    for (size_t i = 1; i < *n; i++)
+    {
+        for (size_t j = i; j > 0; j--)
+        {
+            const model_ap_t *a = &m[j - 1], *b = &m[j];
+            if (a->rssi > b->rssi || (a->rssi == b->rssi && a->seq < b->seq))
+                break;
+            const model_ap_t t = m[j - 1];
+            m[j - 1] = m[j];
+            m[j] = t;
+        }
+    }
+    if (*n > cap)
+    {
+        --*n;
+        return m[*n].seq != seq;
+    }
+    return true;
+}
+
+// The SSID a browser would get from the JSON; false if it is not well formed
+static bool json_ssid(const char *json, char *ssid, size_t *len)
+{
+    const char *p = strstr(json, "{\"ssid\":\"");
+    if (p != json)
+        return false;
+    p += 9;
+    *len = 0;
+    while (*p != '"')
+    {
+        unsigned char c = (unsigned char)*p++;
+        if (c < 0x20 || c == 0x7F)
+            return false;
+        if (c == '\\')
+        {
+            c = (unsigned char)*p++;
+            if (c == 'u')
+            {
+                unsigned v;
+                if (sscanf(p, "%4x", &v) != 1 || v > 0xFF)
+                    return false;
+                c = (unsigned char)v;
+                p += 4;
+            }
+            else if (c != '"' && c != '\\')
+                return false;
+        }
+        if (*len == 32)
+            return false;
+        ssid[(*len)++] = (char)c;
+    }
+    return !strncmp(p, "\",\"rssi\":", 9);
+}
+
+static uint32_t s_rng;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void random_ssid(uint8_t *ssid, size_t *len)
+{
+    static const char *const pool[] = {"home", "office", "guest", "mesh", "Mesh", "cafe \"24\"", "a\\b", "x"};
+    static const char *const utf8[] = {"\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x93\xB6", "\xED\xA0\x80", "\xC0\xAF", "\xF4\x90\x80\x80"};
+    const uint32_t kind = rnd() % 8;
+    if (kind < 4)
+    {
+        // Often the same names: BSSs of one network
+        const char *s = pool[rnd() % (sizeof(pool) / sizeof(pool[0]))];
+        *len = strlen(s);
+        memcpy(ssid, s, *len);
+    }
+    else if (kind < 6)
+    {
+        // Characters, mostly well formed, maybe cut at 32 bytes
+        *len = 0;
+        const uint32_t chars = 1 + rnd() % 12;
+        for (uint32_t i = 0; i < chars; i++)
+        {
+            const char *c = rnd() % 3 ? "n" : utf8[rnd() % (sizeof(utf8) / sizeof(utf8[0]))];
+            const size_t cl = strlen(c);
+            if (*len + cl > 34)
+                break;
+            memcpy(ssid + *len, c, cl);
+            *len += cl;
+        }
+    }
+    else
+    {
+        // Raw bytes, control bytes and zero length too
+        *len = rnd() % 34;
+        for (size_t i = 0; i < *len; i++)
+            ssid[i] = (uint8_t)(rnd() % 2 ? 0x20 + rnd() % 0x60 : rnd());
+    }
+}
+
+static void random_round(int round)
+{
+    s_cases++;
+    const size_t cap = rnd() % (CAP_MAX + 1);
+    wifi_scan_ap_t aps[CAP_MAX];
+    wifi_scan_list_t l;
+    wifi_scan_list_init(&l, aps, cap);
+    model_ap_t model[CAP_MAX + 1];
+    size_t n = 0;
+
+    const unsigned bss = rnd() % 41;
+    for (unsigned k = 0; k < bss; k++)
+    {
+        uint8_t ssid[34];
+        size_t len;
+        random_ssid(ssid, &len);
+        const int8_t rssi = (int8_t)(-30 - (int)(rnd() % 30)); // narrow: many ties
+        const uint8_t channel = (uint8_t)(1 + rnd() % 13);
+        const bool kept = wifi_scan_list_add(&l, ssid, len, rssi, channel, "wpa2");
+        const bool want = model_add(model, &n, cap, ssid, len, rssi, channel, k);
+        CHECK(kept == want, "round %d, BSS %u: %s, want %s", round, k, kept ? "kept" : "dropped",
+              want ? "kept" : "dropped");
+        CHECK(l.n == n, "round %d, BSS %u: %zu entries, want %zu", round, k, l.n, n);
+        for (size_t i = 0; i < n; i++)
+            CHECK(!strcmp(aps[i].ssid, model[i].ssid) && aps[i].rssi == model[i].rssi &&
+                      aps[i].channel == model[i].channel,
+                  "round %d, BSS %u: entry %zu differs", round, k, i);
+    }
+
+    for (size_t i = 0; i < l.n; i++)
+    {
+        char out[WIFI_SCAN_AP_JSON_MAX], ssid[33];
+        size_t len;
+        const size_t jn = wifi_scan_ap_json(&aps[i], out, sizeof(out));
+        CHECK(jn && strlen(out) == jn, "round %d: entry %zu did not fit", round, i);
+        CHECK(json_ssid(out, ssid, &len), "round %d: bad JSON %s", round, out);
+        CHECK(len == strlen(aps[i].ssid) && !memcmp(ssid, aps[i].ssid, len), "round %d: SSID read back differs: %s",
+              round, out);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = 20000;
+    s_rng = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            s_rng = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n ROUNDS] [-s SEED]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!s_rng)
+        s_rng = 1;
+
+    check_dedupe();
+    check_order();
+    check_cap();
+    check_reject();
+    check_json();
+    for (int i = 0; i < rounds && !s_failures; i++)
+        random_round(i);
+
+    if (s_failures)
+    {
+        fprintf(stderr, "%d of %d cases failed\n", s_failures, s_cases);
+        return 1;
+    }
+    printf("wifi_scan_list_check: %d cases passed\n", s_cases);
+    return 0;
+}